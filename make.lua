@@ -133,6 +133,72 @@ do
 	} )
 end
 
+do
+	local platform_srcs
+	local platform_libs
+
+	if OS == "windows" then
+		platform_srcs = {
+			"source/win32/win_console.cpp",
+			"source/win32/win_fs.cpp",
+			"source/win32/win_lib.cpp",
+			"source/win32/win_net.cpp",
+			"source/win32/win_threads.cpp",
+			"source/win32/win_time.cpp",
+		}
+		platform_libs = { }
+	else
+		platform_srcs = {
+			"source/unix/unix_console.cpp",
+			"source/unix/unix_fs.cpp",
+			"source/unix/unix_lib.cpp",
+			"source/unix/unix_net.cpp",
+			"source/unix/unix_threads.cpp",
+			"source/unix/unix_time.cpp",
+		}
+		platform_libs = { "mbedtls" }
+	end
+
+	local function tool( name, extra_srcs, libs )
+		bin( name, {
+			srcs = {
+				"source/tools/" .. name .. ".cpp",
+				"source/tools/tool_stubs.cpp",
+				extra_srcs or { },
+				"source/gameshared/*.cpp",
+				"source/qalgo/*.cpp",
+				"source/qcommon/*.cpp",
+				"source/server/cl_stubs.cpp",
+				platform_srcs
+			},
+
+			libs = libs,
+
+			prebuilt_libs = {
+				"curl",
+				"zlib",
+				"zstd",
+				platform_libs
+			},
+
+			gcc_extra_ldflags = "-lm -lpthread -ldl -no-pie -static-libstdc++",
+			msvc_extra_ldflags = "ws2_32.lib crypt32.lib",
+		} )
+	end
+
+	tool( "pmovebench" )
+	tool( "pipebench" )
+	tool( "jobstress" )
+	tool( "pakindextest", { "source/tools/pk3writer.cpp" } )
+	tool( "assetbench", { "source/tools/pk3writer.cpp" } )
+	tool( "lookupbench", { "source/tools/pk3writer.cpp" } )
+	tool( "drawsortbench" )
+	tool( "shadercachetest", { "source/client/renderer/r_shader.cpp" } )
+	tool( "mipmapbench", { "source/client/renderer/r_mipmap.cpp" } )
+	tool( "animbench", { "source/cgame/cg_posecache.cpp", "source/client/renderer/r_skeleton.cpp" }, { "cgltf" } )
+	tool( "botswarm" )
+end
+
 dll( "game", {
 	srcs = {
 		"source/game/**.cpp",
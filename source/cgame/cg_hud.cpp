@@ -1154,6 +1154,7 @@ static opFunc_t CG_OperatorFuncForArgument( const char *token ) {
 
 static const char *CG_GetStringArg( struct cg_layoutnode_s **argumentsnode );
 static float CG_GetNumericArg( struct cg_layoutnode_s **argumentsnode );
+static struct shader_s *CG_GetShaderArg( struct cg_layoutnode_s **argumentsnode );
 
 //=============================================================================
 
@@ -1173,6 +1174,22 @@ static int layout_cursor_font_style;
 struct qfontface_s *(*layout_cursor_font_regfunc)( const char *, int, unsigned int );
 static bool layout_cursor_font_dirty = true;
 
+// fonts resolved by the current status bar, so switching between a few
+// families every frame doesn't go through the font registration path
+typedef struct
+{
+	struct qfontface_s *( *regfunc )( const char *, int, unsigned int );
+	char name[MAX_QPATH];
+	int style;
+	int size;
+	struct qfontface_s *font;
+} cg_layoutfont_t;
+
+#define MAX_LAYOUT_FONTS 16
+
+static cg_layoutfont_t layout_fonts[MAX_LAYOUT_FONTS];
+static int layout_num_fonts;
+
 enum
 {
 	LNODE_NUMERIC,
@@ -1396,7 +1413,7 @@ static bool CG_LFuncDrawPicByName( struct cg_layoutnode_s *commandnode, struct c
 
 	x = CG_HorizontalAlignForWidth( layout_cursor_x, layout_cursor_align, layout_cursor_width );
 	y = CG_VerticalAlignForHeight( layout_cursor_y, layout_cursor_align, layout_cursor_height );
-	trap_R_DrawStretchPic( x, y, layout_cursor_width, layout_cursor_height, 0, 0, 1, 1, layout_cursor_color, trap_R_RegisterPic( CG_GetStringArg( &argumentnode ) ) );
+	trap_R_DrawStretchPic( x, y, layout_cursor_width, layout_cursor_height, 0, 0, 1, 1, layout_cursor_color, CG_GetShaderArg( &argumentnode ) );
 	return true;
 }
 
@@ -1408,7 +1425,7 @@ static bool CG_LFuncDrawSubPicByName( struct cg_layoutnode_s *commandnode, struc
 	x = CG_HorizontalAlignForWidth( layout_cursor_x, layout_cursor_align, layout_cursor_width );
 	y = CG_VerticalAlignForHeight( layout_cursor_y, layout_cursor_align, layout_cursor_height );
 
-	shader = trap_R_RegisterPic( CG_GetStringArg( &argumentnode ) );
+	shader = CG_GetShaderArg( &argumentnode );
 
 	s1 = CG_GetNumericArg( &argumentnode );
 	t1 = CG_GetNumericArg( &argumentnode );
@@ -1427,7 +1444,7 @@ static bool CG_LFuncDrawRotatedPicByName( struct cg_layoutnode_s *commandnode, s
 	x = CG_HorizontalAlignForWidth( layout_cursor_x, layout_cursor_align, layout_cursor_width );
 	y = CG_VerticalAlignForHeight( layout_cursor_y, layout_cursor_align, layout_cursor_height );
 
-	shader = trap_R_RegisterPic( CG_GetStringArg( &argumentnode ) );
+	shader = CG_GetShaderArg( &argumentnode );
 
 	angle = CG_GetNumericArg( &argumentnode );
 
@@ -1575,13 +1592,32 @@ static struct qfontface_s *CG_GetLayoutCursorFont( void ) {
 		layout_cursor_font_regfunc = trap_SCR_RegisterFont;
 	}
 
+	layout_cursor_font_dirty = false;
+
+	for( int i = 0; i < layout_num_fonts; i++ ) {
+		const cg_layoutfont_t *cached = &layout_fonts[i];
+		if( cached->regfunc == layout_cursor_font_regfunc && cached->style == layout_cursor_font_style &&
+			cached->size == layout_cursor_font_size && !strcmp( cached->name, layout_cursor_font_name ) ) {
+			layout_cursor_font = cached->font;
+			return layout_cursor_font;
+		}
+	}
+
 	font = layout_cursor_font_regfunc( layout_cursor_font_name, layout_cursor_font_style, layout_cursor_font_size );
 	if( font ) {
 		layout_cursor_font = font;
 	} else {
 		layout_cursor_font = cgs.fontSystemSmall;
 	}
-	layout_cursor_font_dirty = false;
+
+	if( layout_num_fonts < MAX_LAYOUT_FONTS ) {
+		cg_layoutfont_t *cached = &layout_fonts[layout_num_fonts++];
+		cached->regfunc = layout_cursor_font_regfunc;
+		Q_strncpyz( cached->name, layout_cursor_font_name, sizeof( cached->name ) );
+		cached->style = layout_cursor_font_style;
+		cached->size = layout_cursor_font_size;
+		cached->font = layout_cursor_font;
+	}
 
 	return layout_cursor_font;
 }
@@ -1826,7 +1862,7 @@ static bool CG_LFuncDrawPicBar( struct cg_layoutnode_s *commandnode, struct cg_l
 
 	CG_DrawHUDRect( layout_cursor_x, layout_cursor_y, layout_cursor_align,
 					layout_cursor_width, layout_cursor_height, value, maxvalue,
-					layout_cursor_color, trap_R_RegisterPic( CG_GetStringArg( &argumentnode ) ) );
+					layout_cursor_color, CG_GetShaderArg( &argumentnode ) );
 	return true;
 }
 
@@ -1895,7 +1931,7 @@ static bool CG_LFuncDrawChat( struct cg_layoutnode_s *commandnode, struct cg_lay
 
 	padding_x = (int)( CG_GetNumericArg( &argumentnode ) ) * cgs.vidWidth / 800;
 	padding_y = (int)( CG_GetNumericArg( &argumentnode ) ) * cgs.vidHeight / 600;
-	shader = trap_R_RegisterPic( CG_GetStringArg( &argumentnode ) );
+	shader = CG_GetShaderArg( &argumentnode );
 
 	CG_DrawChat( &cg.chat, layout_cursor_x, layout_cursor_y, layout_cursor_font_name, CG_GetLayoutCursorFont(), layout_cursor_font_size,
 				 layout_cursor_width, layout_cursor_height, padding_x, padding_y, layout_cursor_color, shader );
@@ -2354,6 +2390,12 @@ typedef struct cg_layoutnode_s
 	struct cg_layoutnode_s *next;
 	struct cg_layoutnode_s *ifthread;
 	bool precache;
+
+	// filled in when the parsed tree is compiled into a flat program
+	const reference_numeric_t *reference;
+	cvar_t *cvar;
+	struct shader_s *shader;
+	int jump; // commands: where to continue when the command returns false
 } cg_layoutnode_t;
 
 /*
@@ -2367,10 +2409,24 @@ static const char *CG_GetStringArg( struct cg_layoutnode_s **argumentsnode ) {
 	}
 
 	// we can return anything as string
-	*argumentsnode = anode->next;
+	*argumentsnode = anode + 1;
 	return anode->string;
 }
 
+/*
+* CG_GetShaderArg
+* string argument naming a pic, registered once and cached in the program
+*/
+static struct shader_s *CG_GetShaderArg( struct cg_layoutnode_s **argumentsnode ) {
+	struct cg_layoutnode_s *anode = *argumentsnode;
+	const char *name = CG_GetStringArg( argumentsnode );
+
+	if( !anode->shader ) {
+		anode->shader = trap_R_RegisterPic( name );
+	}
+	return anode->shader;
+}
+
 /*
 * CG_GetNumericArg
 * can use recursion for mathematical operations
@@ -2387,9 +2443,11 @@ static float CG_GetNumericArg( struct cg_layoutnode_s **argumentsnode ) {
 		CG_Printf( "WARNING: 'CG_LayoutGetIntegerArg': arg %s is not numeric", anode->string );
 	}
 
-	*argumentsnode = anode->next;
-	if( anode->type == LNODE_REFERENCE_NUMERIC ) {
-		value = cg_numeric_references[anode->integer].func( cg_numeric_references[anode->integer].parameter );
+	*argumentsnode = anode + 1;
+	if( anode->cvar ) {
+		value = (int)anode->cvar->value;
+	} else if( anode->reference ) {
+		value = anode->reference->func( anode->reference->parameter );
 	} else {
 		value = anode->value;
 	}
@@ -2430,6 +2488,10 @@ static cg_layoutnode_t *CG_LayoutParseCommandNode( const char *token ) {
 	node->func = command->func;
 	node->ifthread = NULL;
 	node->precache = command->precache;
+	node->reference = NULL;
+	node->cvar = NULL;
+	node->shader = NULL;
+	node->jump = 0;
 
 	return node;
 }
@@ -2523,6 +2585,10 @@ static cg_layoutnode_t *CG_LayoutParseArgumentNode( const char *token ) {
 	node->func = NULL;
 	node->ifthread = NULL;
 	node->precache = false;
+	node->reference = NULL;
+	node->cvar = NULL;
+	node->shader = NULL;
+	node->jump = 0;
 
 	// return it
 	return node;
@@ -2637,7 +2703,6 @@ static bool CG_LayoutFixCommasInToken( char **ptr, char **backptr ) {
 */
 static cg_layoutnode_t *CG_RecurseParseLayoutScript( char **ptr, int level ) {
 	cg_layoutnode_t *command = NULL;
-	cg_layoutnode_t *argumentnode = NULL;
 	cg_layoutnode_t *node = NULL;
 	cg_layoutnode_t *rootnode = NULL;
 	int expecArgs = 0, numArgs = 0;
@@ -2765,7 +2830,6 @@ static cg_layoutnode_t *CG_RecurseParseLayoutScript( char **ptr, int level ) {
 
 				// move on into the new command
 				command = node;
-				argumentnode = NULL;
 				numArgs = 0;
 				expecArgs = command->integer;
 				add = true;
@@ -2776,27 +2840,11 @@ static cg_layoutnode_t *CG_RecurseParseLayoutScript( char **ptr, int level ) {
 		}
 
 		if( add == true ) {
-			if( command && command == rootnode ) {
-				if( !argumentnode ) {
-					argumentnode = node;
-				}
-			}
-
 			if( rootnode ) {
 				rootnode->next = node;
 			}
 			node->parent = rootnode;
 			rootnode = node;
-
-			// precache arguments by calling the function at load time
-			if( command && expecArgs == numArgs && command->func && command->precache ) {
-				Vector4Set( layout_cursor_color, 0, 0, 0, 0 );
-				layout_cursor_x = -layout_cursor_width - 1;
-				layout_cursor_y = -layout_cursor_height - 1;
-				layout_cursor_width = 0;
-				layout_cursor_height = 0;
-				command->func( command, argumentnode, numArgs );
-			}
 		}
 	}
 
@@ -2808,35 +2856,62 @@ static cg_layoutnode_t *CG_RecurseParseLayoutScript( char **ptr, int level ) {
 }
 
 /*
-* CG_ParseLayoutScript
+* CG_LayoutCountThreadNodes
 */
-static void CG_ParseLayoutScript( char *string, cg_layoutnode_t *rootnode ) {
+static int CG_LayoutCountThreadNodes( cg_layoutnode_t *rootnode ) {
+	cg_layoutnode_t *node;
+	int count = 0;
 
-	CG_RecurseFreeLayoutThread( cg.statusBar );
-	cg.statusBar = CG_RecurseParseLayoutScript( &string, 0 );
+	for( node = rootnode; node; node = node->parent ) {
+		count++;
+		if( node->ifthread ) {
+			count += CG_LayoutCountThreadNodes( node->ifthread );
+		}
+	}
+
+	return count;
 }
 
-//=============================================================================
+/*
+* CG_LayoutFoldConstants
+* operators chain to the right, so fold every constant tail of a chain into a single argument
+*/
+static int CG_LayoutFoldConstants( cg_layoutnode_t *program, int first, int end ) {
+	int i;
 
-//=============================================================================
+	for( i = end - 2; i >= first; i-- ) {
+		cg_layoutnode_t *a = &program[i];
+		cg_layoutnode_t *b = &program[i + 1];
+
+		if( !a->opFunc || b->opFunc || a->type != LNODE_NUMERIC || b->type != LNODE_NUMERIC ) {
+			continue;
+		}
+
+		a->value = a->opFunc( a->value, b->value );
+		a->integer = (int)a->value;
+		a->opFunc = NULL;
+
+		if( b->string ) {
+			CG_Free( b->string );
+		}
+		memmove( b, b + 1, sizeof( *b ) * ( end - i - 2 ) );
+		end--;
+	}
+
+	return end;
+}
 
 /*
-* CG_RecurseExecuteLayoutThread
-* Execution works like this: First node (on backwards) is expected to be the command, followed by arguments nodes.
-* we keep a pointer to the command and run the tree counting arguments until we reach the next command,
-* then we call the command function sending the pointer to first argument and the pointer to the command.
-* At return we advance one node (we stopped at last argument node) so it starts again from the next command (if any).
-*
-* When finding an "if" command with a subtree, we execute the "if" command. In the case it
-* returns any value, we recurse execute the subtree
+* CG_LayoutEmitThread
+* flattens a parsed thread into program. "if" subthreads are emitted inline right after
+* their command, and the command's jump skips over them
 */
-static void CG_RecurseExecuteLayoutThread( cg_layoutnode_t *rootnode ) {
-	cg_layoutnode_t *argumentnode = NULL;
-	cg_layoutnode_t *commandnode = NULL;
+static int CG_LayoutEmitThread( cg_layoutnode_t *rootnode, cg_layoutnode_t *program, int count ) {
+	cg_layoutnode_t *commandnode, *argumentnode, *nextnode;
 	int numArguments;
 
 	if( !rootnode ) {
-		return;
+		return count;
 	}
 
 	// run until the real root
@@ -2845,57 +2920,146 @@ static void CG_RecurseExecuteLayoutThread( cg_layoutnode_t *rootnode ) {
 		commandnode = commandnode->parent;
 	}
 
-	// now run backwards up to the next command node
 	while( commandnode ) {
-		argumentnode = commandnode->next;
-
-		// we could trust the parser, but I prefer counting the arguments here
 		numArguments = 0;
-		while( argumentnode ) {
-			if( argumentnode->type == LNODE_COMMAND ) {
-				break;
-			}
-
-			argumentnode = argumentnode->next;
+		for( nextnode = commandnode->next; nextnode && nextnode->type != LNODE_COMMAND; nextnode = nextnode->next ) {
 			numArguments++;
 		}
 
-		// reset
-		argumentnode = commandnode->next;
-
-		// Execute the command node
 		if( commandnode->integer != numArguments ) {
 			CG_Printf( "ERROR: Layout command %s: invalid argument count (expecting %i, found %i)\n", commandnode->string, commandnode->integer, numArguments );
-			return;
+			return count;
 		}
+
+		// commands without a function (endif) don't do anything at runtime
 		if( commandnode->func ) {
-			//special case for if commands
-			if( commandnode->func( commandnode, argumentnode, numArguments ) ) {
-				// execute the "if" thread when command returns a value
-				if( commandnode->ifthread ) {
-					CG_RecurseExecuteLayoutThread( commandnode->ifthread );
+			int command = count++;
+
+			program[command] = *commandnode;
+			commandnode->string = NULL;
+
+			for( argumentnode = commandnode->next; argumentnode != nextnode; argumentnode = argumentnode->next ) {
+				cg_layoutnode_t *arg = &program[count++];
+
+				*arg = *argumentnode;
+				argumentnode->string = NULL;
+				arg->parent = arg->next = arg->ifthread = NULL;
+
+				if( arg->type == LNODE_REFERENCE_NUMERIC ) {
+					arg->reference = &cg_numeric_references[arg->integer];
+					// cvars that don't exist yet keep going through CG_GetCvar
+					if( arg->reference->func == CG_GetCvar ) {
+						arg->cvar = trap_Cvar_Find( (const char *)arg->reference->parameter );
+					}
 				}
 			}
+
+			count = CG_LayoutFoldConstants( program, command + 1, count );
+			program[command].integer = count - command - 1;
+			program[command].parent = program[command].next = program[command].ifthread = NULL;
+
+			count = CG_LayoutEmitThread( commandnode->ifthread, program, count );
+			program[command].jump = count;
 		}
 
-		//move up to next command node
-		commandnode = argumentnode;
 		if( commandnode == rootnode ) {
-			return;
+			break;
 		}
+		commandnode = nextnode;
+	}
+
+	return count;
+}
+
+/*
+* CG_FreeLayoutProgram
+*/
+static void CG_FreeLayoutProgram( cg_layoutnode_t *program ) {
+	cg_layoutnode_t *node;
 
-		while( commandnode && commandnode->type != LNODE_COMMAND ) {
-			commandnode = commandnode->next;
+	if( !program ) {
+		return;
+	}
+
+	// the terminating node has no function and no string
+	for( node = program; node->func || node->type != LNODE_COMMAND; node++ ) {
+		if( node->string ) {
+			CG_Free( node->string );
 		}
 	}
+
+	CG_Free( program );
 }
 
+/*
+* CG_CompileLayoutProgram
+* turns the parsed tree into a flat array of commands, each followed by its arguments,
+* with references resolved and constant operations folded
+*/
+static cg_layoutnode_t *CG_CompileLayoutProgram( cg_layoutnode_t *rootnode ) {
+	cg_layoutnode_t *program, *node;
+	int count;
+
+	program = ( cg_layoutnode_t * )CG_Malloc( sizeof( cg_layoutnode_t ) * ( CG_LayoutCountThreadNodes( rootnode ) + 1 ) );
+	count = CG_LayoutEmitThread( rootnode, program, 0 );
+
+	memset( &program[count], 0, sizeof( program[count] ) );
+	program[count].type = LNODE_COMMAND;
+
+	// precache arguments by calling the function at load time
+	for( node = program; node->func; node += node->integer + 1 ) {
+		if( node->precache ) {
+			Vector4Set( layout_cursor_color, 0, 0, 0, 0 );
+			layout_cursor_x = -layout_cursor_width - 1;
+			layout_cursor_y = -layout_cursor_height - 1;
+			layout_cursor_width = 0;
+			layout_cursor_height = 0;
+			node->func( node, node + 1, node->integer );
+		}
+	}
+
+	return program;
+}
+
+/*
+* CG_ParseLayoutScript
+*/
+static void CG_ParseLayoutScript( char *string, cg_layoutnode_t *rootnode ) {
+	cg_layoutnode_t *tree;
+
+	CG_FreeLayoutProgram( cg.statusBar );
+	cg.statusBar = NULL;
+
+	tree = CG_RecurseParseLayoutScript( &string, 0 );
+	cg.statusBar = CG_CompileLayoutProgram( tree );
+	CG_RecurseFreeLayoutThread( tree );
+}
+
+//=============================================================================
+
 /*
 * CG_ExecuteLayoutProgram
+* commands are laid out back to back, each followed by its arguments. When a command
+* returns false we continue at its jump, which skips the "if" subthread if it has one
 */
-void CG_ExecuteLayoutProgram( struct cg_layoutnode_s *rootnode ) {
+void CG_ExecuteLayoutProgram( struct cg_layoutnode_s *program ) {
 	MICROPROFILE_SCOPEI( "Main", "CG_ExecuteLayoutProgram", 0xffffffff );
-	CG_RecurseExecuteLayoutThread( rootnode );
+
+	cg_layoutnode_t *commandnode;
+	int pc = 0;
+
+	if( !program ) {
+		return;
+	}
+
+	while( program[pc].func ) {
+		commandnode = &program[pc];
+		if( commandnode->func( commandnode, commandnode + 1, commandnode->integer ) ) {
+			pc += commandnode->integer + 1;
+		} else {
+			pc = commandnode->jump;
+		}
+	}
 }
 
 //=============================================================================
@@ -3113,6 +3277,7 @@ static void CG_LoadStatusBarFile( char *path ) {
 	layout_cursor_font_size = SYSTEM_FONT_SMALL_SIZE;
 	layout_cursor_font_dirty = true;
 	layout_cursor_font_regfunc = trap_SCR_RegisterFont;
+	layout_num_fonts = 0;
 }
 
 /*
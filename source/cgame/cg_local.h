@@ -582,7 +582,7 @@ void CG_ResetBombHUD();
 //
 void CG_SC_ResetObituaries( void );
 void CG_SC_Obituary( void );
-void CG_ExecuteLayoutProgram( struct cg_layoutnode_s *rootnode );
+void CG_ExecuteLayoutProgram( struct cg_layoutnode_s *program );
 void CG_ClearAwards( void );
 
 //
@@ -606,6 +606,7 @@ bool CG_IsScoreboardShown( void );
 //
 extern cvar_t *developer;
 extern cvar_t *cg_showClamp;
+extern cvar_t *cg_showPoseCache;
 
 // wsw
 extern cvar_t *cg_showObituaries;
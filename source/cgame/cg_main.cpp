@@ -85,6 +85,7 @@ cvar_t *cg_showObituaries;
 cvar_t *cg_damageNumbers;
 cvar_t *cg_particles;
 cvar_t *cg_showClamp;
+cvar_t *cg_showPoseCache;
 
 cvar_t *cg_damage_indicator;
 cvar_t *cg_damage_indicator_time;
@@ -537,6 +538,7 @@ static void CG_RegisterVariables( void ) {
 
 	// developer cvars
 	cg_showClamp = trap_Cvar_Get( "cg_showClamp", "0", CVAR_DEVELOPER );
+	cg_showPoseCache = trap_Cvar_Get( "cg_showPoseCache", "0", CVAR_DEVELOPER );
 
 	cg_allyColor = trap_Cvar_Get( "cg_allyColor", "0", CVAR_ARCHIVE );
 	cg_allyModel = trap_Cvar_Get( "cg_allyModel", "bigvic", CVAR_ARCHIVE );
@@ -31,11 +31,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "client/client.h"
 #include "cg_local.h"
+#include "cg_posecache.h"
 #include "client/renderer/r_local.h"
 
 pmodel_t cg_entPModels[MAX_EDICTS];
 PlayerModelMetadata *cg_PModelInfos;
 
+static PoseCache cg_poseCache;
+static int cg_poseCacheFrame;
+static int64_t cg_poseCacheReportTime;
+
 //======================================================================
 //						PlayerModel Registering
 //======================================================================
@@ -43,6 +48,12 @@ PlayerModelMetadata *cg_PModelInfos;
 void CG_PModelsInit() {
 	memset( cg_entPModels, 0, sizeof( cg_entPModels ) );
 	cg_PModelInfos = NULL;
+
+	CG_ClearPoseCache( &cg_poseCache );
+	cg_poseCache.lookups = 0;
+	cg_poseCache.hits = 0;
+	cg_poseCacheFrame = -1;
+	cg_poseCacheReportTime = 0;
 }
 
 void CG_PModelsShutdown() {
@@ -1000,6 +1011,30 @@ static orientation_t TransformTag( const model_t * model, const MatrixPalettes &
 	return o;
 }
 
+/*
+* CG_BeginPoseCacheFrame
+*
+* Poses live in the frame arena, so the cache is emptied once per frame
+*/
+static void CG_BeginPoseCacheFrame( void ) {
+	if( cg_poseCacheFrame == cg.frameCount ) {
+		return;
+	}
+
+	cg_poseCacheFrame = cg.frameCount;
+	CG_ClearPoseCache( &cg_poseCache );
+
+	if( cg_showPoseCache->integer && ( cg.time - cg_poseCacheReportTime >= 1000 || cg.time < cg_poseCacheReportTime ) ) {
+		if( cg_poseCache.lookups > 0 ) {
+			CG_Printf( "pose cache: %u/%u hits (%.1f%%)\n", cg_poseCache.hits, cg_poseCache.lookups,
+				100.0f * cg_poseCache.hits / cg_poseCache.lookups );
+		}
+		cg_poseCacheReportTime = cg.time;
+		cg_poseCache.lookups = 0;
+		cg_poseCache.hits = 0;
+	}
+}
+
 void CG_AddPModel( centity_t *cent ) {
 	pmodel_t * pmodel = &cg_entPModels[cent->current.number];
 	const PlayerModelMetadata * meta = pmodel->metadata;
@@ -1033,9 +1068,14 @@ void CG_AddPModel( centity_t *cent ) {
 
 	float lower_time, upper_time;
 	CG_GetAnimationTimes( pmodel, cg.time, &lower_time, &upper_time );
-	Span< TRS > lower = R_SampleAnimation( cls.frame_arena, meta->model, lower_time );
-	Span< TRS > upper = R_SampleAnimation( cls.frame_arena, meta->model, upper_time );
-	R_MergeLowerUpperPoses( lower, upper, meta->model, meta->upper_root_joint );
+
+	CG_BeginPoseCacheFrame();
+
+	// corpses are drawn as sampled, everyone else turns their spine and head
+	CachedPose * cached;
+	Span< TRS > lower = CG_SamplePlayerPose( cls.frame_arena, &cg_poseCache, R_ModelSkeleton( meta->model ), meta->upper_root_joint,
+		lower_time, upper_time, &pmodel->animationCursors[ LOWER ], &pmodel->animationCursors[ UPPER ],
+		cent->current.type != ET_CORPSE, &cached );
 
 	// add skeleton effects (pose is unmounted yet)
 	if( cent->current.type != ET_CORPSE ) {
@@ -1085,7 +1125,15 @@ void CG_AddPModel( centity_t *cent ) {
 	cent->ent.customShader = NULL;
 	cent->ent.customSkin = pmodel->skin;
 	cent->ent.renderfx |= RF_NOSHADOW;
-	cent->ent.pose = R_ComputeMatrixPalettes( cls.frame_arena, meta->model, lower );
+	if( cent->current.type == ET_CORPSE && cached != NULL ) {
+		if( cached->palettes.skinning_matrices.ptr == NULL ) {
+			cached->palettes = R_ComputeMatrixPalettes( cls.frame_arena, meta->model, lower );
+		}
+		cent->ent.pose = cached->palettes;
+	}
+	else {
+		cent->ent.pose = R_ComputeMatrixPalettes( cls.frame_arena, meta->model, lower );
+	}
 
 	if( !( cent->renderfx & RF_NOSHADOW ) ) {
 		CG_AllocPlayerShadow( cent->current.number, cent->ent.origin, playerbox_stand_mins, playerbox_stand_maxs );
@@ -150,6 +150,7 @@ typedef struct {
 
 	// dynamic
 	pmodel_animationstate_t animState;
+	AnimationCursor animationCursors[PMODEL_PARTS];
 
 	vec3_t angles[PMODEL_PARTS];                // for rotations
 	vec3_t oldangles[PMODEL_PARTS];             // for rotations
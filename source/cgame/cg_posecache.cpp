@@ -0,0 +1,108 @@
+#include "qcommon/qcommon.h"
+#include "qalgo/hash.h"
+#include "cgame/ref.h"
+#include "cgame/cg_posecache.h"
+#include "client/renderer/r_skeleton.h"
+
+STATIC_ASSERT( ( POSE_CACHE_SIZE & ( POSE_CACHE_SIZE - 1 ) ) == 0 );
+
+/*
+* CG_ClearPoseCache
+*
+* Empties the cache but keeps the hit counters
+*/
+void CG_ClearPoseCache( PoseCache * cache ) {
+	for( u32 i = 0; i < POSE_CACHE_SIZE; i++ ) {
+		cache->poses[ i ].model = NULL;
+	}
+	cache->num_poses = 0;
+}
+
+s32 CG_PoseCacheStep( float t ) {
+	return s32( floorf( t * POSE_CACHE_STEPS_PER_SECOND + 0.5f ) );
+}
+
+CachedPose * CG_FindCachedPose( PoseCache * cache, const void * model, s32 lower_step, s32 upper_step ) {
+	struct {
+		const void * model;
+		s32 lower_step, upper_step;
+	} key = { model, lower_step, upper_step };
+
+	cache->lookups++;
+
+	u32 mask = POSE_CACHE_SIZE - 1;
+	u32 i = Hash32( &key, sizeof( key ) ) & mask;
+	while( cache->poses[ i ].model != NULL ) {
+		CachedPose * pose = &cache->poses[ i ];
+		if( pose->model == model && pose->lower_step == lower_step && pose->upper_step == upper_step ) {
+			cache->hits++;
+			return pose;
+		}
+		i = ( i + 1 ) & mask;
+	}
+
+	// leave some slots free so misses stay cheap
+	if( cache->num_poses >= POSE_CACHE_SIZE / 2 ) {
+		return NULL;
+	}
+
+	CachedPose * pose = &cache->poses[ i ];
+	pose->model = model;
+	pose->lower_step = lower_step;
+	pose->upper_step = upper_step;
+	pose->lower_time = 0.0f;
+	pose->upper_time = 0.0f;
+	pose->pose = Span< TRS >();
+	pose->palettes = MatrixPalettes();
+	cache->num_poses++;
+
+	return pose;
+}
+
+/*
+* CG_SamplePlayerPose
+*
+* Reuses the pose of an earlier player with the same skeleton and times in
+* the same steps, or samples the exact times and leaves the pose for the
+* next one. Only reusing a pose moves a player's times, by less than a step.
+*
+* *cached is the cache entry, NULL if the cache is full. Set own_copy if the
+* caller changes the pose, otherwise it may be the shared one
+*/
+Span< TRS > CG_SamplePlayerPose( ArenaAllocator * a, PoseCache * cache, const Skeleton * skeleton, u8 upper_root_joint,
+	float lower_time, float upper_time, AnimationCursor * lower_cursor, AnimationCursor * upper_cursor,
+	bool own_copy, CachedPose ** cached ) {
+	CachedPose * entry = CG_FindCachedPose( cache, skeleton, CG_PoseCacheStep( lower_time ), CG_PoseCacheStep( upper_time ) );
+	*cached = entry;
+
+	if( entry != NULL && entry->pose.ptr != NULL ) {
+		if( !own_copy ) {
+			return entry->pose;
+		}
+
+		Span< TRS > pose = ALLOC_SPAN( a, TRS, entry->pose.n );
+		memcpy( pose.ptr, entry->pose.ptr, entry->pose.num_bytes() );
+		return pose;
+	}
+
+	Span< TRS > lower = SampleSkeleton( a, skeleton, lower_time, lower_cursor );
+	Span< TRS > upper = SampleSkeleton( a, skeleton, upper_time, upper_cursor );
+	MergeSkeletonPoses( lower, upper, skeleton, upper_root_joint );
+
+	if( entry == NULL ) {
+		return lower;
+	}
+
+	entry->lower_time = lower_time;
+	entry->upper_time = upper_time;
+	entry->pose = lower;
+
+	// the caller's changes mustn't reach the next player
+	if( own_copy ) {
+		Span< TRS > pose = ALLOC_SPAN( a, TRS, lower.n );
+		memcpy( pose.ptr, lower.ptr, lower.num_bytes() );
+		return pose;
+	}
+
+	return lower;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// players sharing a model and animation times share a pose, which happens a
+// lot when everyone spawns at once or idles together. the cache only lives
+// for one frame since the poses are allocated from the frame arena
+
+#define POSE_CACHE_SIZE 512 // power of two, twice MAX_CLIENTS keeps probes short
+
+// times within the same step share a pose, so nearly identical times do too.
+// 4-5 steps per keyframe at 24fps
+#define POSE_CACHE_STEPS_PER_SECOND 120
+
+struct Skeleton;
+
+struct CachedPose {
+	const void * model;
+	s32 lower_step, upper_step;
+
+	float lower_time, upper_time;   // what the pose was sampled at
+	Span< TRS > pose;           // lower and upper merged, before any per player changes
+	MatrixPalettes palettes;    // of the unchanged pose, computed by whoever needs them first
+};
+
+struct PoseCache {
+	CachedPose poses[ POSE_CACHE_SIZE ];
+	u32 num_poses;
+
+	u32 lookups;
+	u32 hits;
+};
+
+void CG_ClearPoseCache( PoseCache * cache );
+
+s32 CG_PoseCacheStep( float t );
+
+// returns the pose for the key, with a NULL pose.ptr if the caller has to fill
+// it in, or NULL if the cache is full
+CachedPose * CG_FindCachedPose( PoseCache * cache, const void * model, s32 lower_step, s32 upper_step );
+
+// the merged lower and upper body pose of a player, see CG_SamplePlayerPose
+Span< TRS > CG_SamplePlayerPose( ArenaAllocator * a, PoseCache * cache, const Skeleton * skeleton, u8 upper_root_joint,
+	float lower_time, float upper_time, AnimationCursor * lower_cursor, AnimationCursor * upper_cursor,
+	bool own_copy, CachedPose ** cached );
@@ -84,6 +84,7 @@ typedef struct {
 	cvar_t *( *Cvar_Set )( const char *name, const char *value );
 	void ( *Cvar_SetValue )( const char *name, float value );
 	cvar_t *( *Cvar_ForceSet )( const char *name, const char *value );      // will return 0 0 if not found
+	cvar_t *( *Cvar_Find )( const char *name );     // NULL if not found, never creates the cvar
 	float ( *Cvar_Value )( const char *name );
 	const char *( *Cvar_String )( const char *name );
 
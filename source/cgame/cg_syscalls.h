@@ -55,6 +55,10 @@ static inline cvar_t *trap_Cvar_ForceSet( const char *name, const char *value )
 	return CGAME_IMPORT.Cvar_ForceSet( name, value );
 }
 
+static inline cvar_t *trap_Cvar_Find( const char *name ) {
+	return CGAME_IMPORT.Cvar_Find( name );
+}
+
 static inline float trap_Cvar_Value( const char *name ) {
 	return CGAME_IMPORT.Cvar_Value( name );
 }
@@ -85,6 +85,15 @@ struct MatrixPalettes {
 	Span< Mat4 > skinning_matrices;
 };
 
+#define ANIMATION_CURSOR_TIMELINES 64
+
+// the keyframes R_SampleAnimation last used for each of a model's key time
+// tracks, so playing forward from there rarely has to search. starts zeroed
+struct AnimationCursor {
+	const void * skeleton;
+	u16 keyframes[ ANIMATION_CURSOR_TIMELINES ];
+};
+
 typedef struct entity_s {
 	refEntityType_t rtype;
 	union {
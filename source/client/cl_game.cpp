@@ -169,6 +169,7 @@ void CL_GameModule_Init( void ) {
 	import.Cvar_Set = Cvar_Set;
 	import.Cvar_SetValue = Cvar_SetValue;
 	import.Cvar_ForceSet = Cvar_ForceSet;
+	import.Cvar_Find = Cvar_Find;
 	import.Cvar_String = Cvar_String;
 	import.Cvar_Value = Cvar_Value;
 
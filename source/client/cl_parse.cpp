@@ -299,6 +299,71 @@ static size_t CL_WebDownloadReadCb( const void *buf, size_t numb, float percenta
 	return stop ? !numb : write;
 }
 
+#define DOWNLOAD_ACK_MSEC 16
+
+/*
+* CL_SendDownloadAck
+*
+* Tells the server how much of the file has been written, and which
+* blocks after that are waiting in cls.download.blocks
+*/
+static void CL_SendDownloadAck( void ) {
+	int base = cls.download.offset / DOWNLOAD_BLOCK_SIZE;
+	unsigned sack = 0;
+
+	for( int i = 1; i < DOWNLOAD_MAX_WINDOW; i++ ) {
+		if( cls.download.blockindex[( base + i ) % DOWNLOAD_MAX_WINDOW] == base + i ) {
+			sack |= 1u << i;
+		}
+	}
+
+	CL_AddReliableCommand( va( "nextdl \"%s\" %li %i %x", cls.download.name, cls.download.offset, DOWNLOAD_MAX_WINDOW, sack ) );
+	cls.download.ackpending = false;
+	cls.download.acktime = Sys_Milliseconds();
+}
+
+/*
+* CL_WriteDownloadData
+* Appends data starting at offset, which may overlap what a resumed download already has
+*/
+static void CL_WriteDownloadData( const uint8_t *data, size_t offset, size_t size ) {
+	size_t skip = cls.download.offset - offset;
+
+	FS_Write( data + skip, size - skip, cls.download.filenum );
+	cls.download.offset += size - skip;
+}
+
+/*
+* CL_FlushDownloadBlocks
+* Writes the blocks received ahead of the file that now continue it
+*/
+static void CL_FlushDownloadBlocks( void ) {
+	while( cls.download.offset < cls.download.size ) {
+		int block = cls.download.offset / DOWNLOAD_BLOCK_SIZE;
+		int slot = block % DOWNLOAD_MAX_WINDOW;
+		if( cls.download.blockindex[slot] != block ) {
+			break;
+		}
+
+		CL_WriteDownloadData( cls.download.blocks + slot * DOWNLOAD_BLOCK_SIZE, (size_t)block * DOWNLOAD_BLOCK_SIZE, cls.download.blocksize[slot] );
+		cls.download.blockindex[slot] = -1;
+	}
+}
+
+/*
+* CL_FinishServerDownload
+*/
+static void CL_FinishServerDownload( void ) {
+	Com_Printf( "Download complete: %s\n", cls.download.name );
+
+	CL_DownloadComplete();
+
+	// let the server know we're done
+	CL_AddReliableCommand( va( "nextdl \"%s\" %i", cls.download.name, -1 ) );
+
+	CL_DownloadDone();
+}
+
 /*
 * CL_InitDownload
 *
@@ -536,10 +601,22 @@ static void CL_InitServerDownload( const char *filename, int size, unsigned chec
 		return;
 	}
 
+	if( cls.download.offset == cls.download.size ) {
+		CL_FinishServerDownload();
+		return;
+	}
+
+	if( !cls.download.blocks ) {
+		cls.download.blocks = ( uint8_t * ) Mem_ZoneMalloc( DOWNLOAD_MAX_WINDOW * DOWNLOAD_BLOCK_SIZE );
+	}
+	for( int i = 0; i < DOWNLOAD_MAX_WINDOW; i++ ) {
+		cls.download.blockindex[i] = -1;
+	}
+
 	cls.download.timeout = Sys_Milliseconds() + 3000;
 	cls.download.retries = 0;
 
-	CL_AddReliableCommand( va( "nextdl \"%s\" %li", cls.download.name, cls.download.offset ) );
+	CL_SendDownloadAck();
 }
 
 /*
@@ -592,6 +669,10 @@ void CL_StopServerDownload( void ) {
 	Mem_ZoneFree( cls.download.web_url );
 	cls.download.web_url = NULL;
 
+	Mem_ZoneFree( cls.download.blocks );
+	cls.download.blocks = NULL;
+	cls.download.ackpending = false;
+
 	cls.download.offset = 0;
 	cls.download.size = 0;
 	cls.download.percent = 0;
@@ -617,15 +698,20 @@ static void CL_RetryDownload( void ) {
 		CL_DownloadDone();
 	} else {
 		cls.download.timeout = Sys_Milliseconds() + 3000;
-		CL_AddReliableCommand( va( "nextdl \"%s\" %li", cls.download.name, cls.download.offset ) );
+		CL_SendDownloadAck();
 	}
 }
 
 /*
 * CL_CheckDownloadTimeout
 * Retry downloading if too much time has passed since last download packet was received
+* Also sends the acks for blocks received since the last one
 */
 void CL_CheckDownloadTimeout( void ) {
+	if( cls.download.ackpending && Sys_Milliseconds() - cls.download.acktime >= DOWNLOAD_ACK_MSEC ) {
+		CL_SendDownloadAck();
+	}
+
 	if( !cls.download.timeout || cls.download.timeout > Sys_Milliseconds() ) {
 		return;
 	}
@@ -684,7 +770,8 @@ void CL_DownloadCancel_f( void ) {
 /*
 * CL_ParseDownload
 * Handles download message from the server.
-* Writes data to the file and requests next download block.
+* Writes data to the file, or holds on to blocks that arrive ahead of it.
+* The acks are sent from CL_CheckDownloadTimeout, at most every DOWNLOAD_ACK_MSEC.
 */
 static void CL_ParseDownload( msg_t *msg ) {
 	size_t size, offset;
@@ -725,16 +812,32 @@ static void CL_ParseDownload( msg_t *msg ) {
 		return;
 	}
 
-	if( cls.download.offset != offset ) {
-		Com_Printf( "Error: Download message for wrong position\n" );
-		msg->readcount += size;
-		CL_RetryDownload();
-		return;
-	}
+	if( offset > cls.download.offset ) {
+		// ahead of the file, keep it until the gap before it is filled
+		int base = cls.download.offset / DOWNLOAD_BLOCK_SIZE;
+		int block = offset / DOWNLOAD_BLOCK_SIZE;
+		int slot = block % DOWNLOAD_MAX_WINDOW;
 
-	FS_Write( msg->data + msg->readcount, size, cls.download.filenum );
+		if( offset % DOWNLOAD_BLOCK_SIZE || size != Min2( cls.download.size - offset, (size_t)DOWNLOAD_BLOCK_SIZE ) ) {
+			Com_Printf( "Error: Download message for wrong position\n" );
+			msg->readcount += size;
+			return;
+		}
+
+		if( block - base < DOWNLOAD_MAX_WINDOW && cls.download.blockindex[slot] != block ) {
+			memcpy( cls.download.blocks + slot * DOWNLOAD_BLOCK_SIZE, msg->data + msg->readcount, size );
+			cls.download.blockindex[slot] = block;
+			cls.download.blocksize[slot] = size;
+		}
+	} else if( offset + size > cls.download.offset ) {
+		CL_WriteDownloadData( msg->data + msg->readcount, offset, size );
+		CL_FlushDownloadBlocks();
+	}
 	msg->readcount += size;
-	cls.download.offset += size;
+
+	// acknowledge retransmits of data we already have too, so the server moves on
+	cls.download.ackpending = true;
+
 	cls.download.percent = (double)cls.download.offset / (double)cls.download.size;
 	clamp( cls.download.percent, 0, 1 );
 
@@ -743,17 +846,8 @@ static void CL_ParseDownload( msg_t *msg ) {
 	if( cls.download.offset < cls.download.size ) {
 		cls.download.timeout = Sys_Milliseconds() + 3000;
 		cls.download.retries = 0;
-
-		CL_AddReliableCommand( va( "nextdl \"%s\" %li", cls.download.name, cls.download.offset ) );
 	} else {
-		Com_Printf( "Download complete: %s\n", cls.download.name );
-
-		CL_DownloadComplete();
-
-		// let the server know we're done
-		CL_AddReliableCommand( va( "nextdl \"%s\" %i", cls.download.name, -1 ) );
-
-		CL_DownloadDone();
+		CL_FinishServerDownload();
 	}
 }
 
@@ -1,4 +1,6 @@
 #include "qcommon/qcommon.h"
+#include "qcommon/qthreads.h"
+#include "qalgo/hash.h"
 #include "sound.h"
 
 #define AL_LIBTYPE_STATIC
@@ -9,11 +11,41 @@
 #define STB_VORBIS_HEADER_ONLY
 #include "stb/stb_vorbis.h"
 
+#define S_PCM_CACHE_MAGIC "PCM1"
+#define S_PCM_CACHE_VERSION 1
+
+enum SoundAssetState {
+	SoundAssetState_Decoding,
+	SoundAssetState_Decoded,
+	SoundAssetState_Failed,
+	SoundAssetState_Uploaded,
+};
+
 typedef struct sfx_s {
 	char filename[ MAX_QPATH ];
+	uint32_t hash;
+	bool allow_stereo;
 	ALuint buffer;
+
+	// owned by the decode job until decoding drops to zero
+	volatile int decoding;
+	SoundAssetState state;
+	int16_t * samples;
+	int num_samples;
+	int channels;
+	int sample_rate;
+	bool from_cache;
 } SoundAsset;
 
+struct PCMCacheHeader {
+	char magic[ 4 ];
+	uint32_t version;
+	uint32_t key;
+	int32_t channels;
+	int32_t sample_rate;
+	int32_t num_samples;
+};
+
 enum SoundType {
 	SoundType_Global, // plays at max volume everywhere
 	SoundType_Fixed, // plays from some point in the world
@@ -50,6 +82,13 @@ static sfx_s sound_assets[ 4096 ];
 static size_t num_sound_assets;
 static sfx_s * menu_music_asset;
 
+// sounds are uploaded in registration order, everything before upload_cursor is done
+static size_t upload_cursor;
+
+static uint64_t decode_batch_start;
+static int decode_batch_cached;
+static int decode_batch_decoded;
+
 static PlayingSound playing_sounds[ 128 ];
 static size_t num_playing_sounds;
 
@@ -130,48 +169,234 @@ static bool S_InitAL() {
 	return true;
 }
 
-static SoundAsset * S_Register( const char * filename, bool allow_stereo ) {
-	MICROPROFILE_SCOPEI( "Assets", "S_Register", 0xffffffff );
+static void S_PCMCacheName( const SoundAsset * sfx, char * buf, size_t buf_size ) {
+	Q_snprintfz( buf, buf_size, "cache/sounds/%s", sfx->filename );
+	COM_ReplaceExtension( buf, ".pcm", buf_size );
+}
 
-	assert( num_sound_assets < ARRAY_COUNT( sound_assets ) );
-	SoundAsset * sfx = &sound_assets[ num_sound_assets ];
+static bool S_ReadPCMCache( SoundAsset * sfx, uint32_t key ) {
+	char cache_name[ MAX_QPATH ];
+	S_PCMCacheName( sfx, cache_name, sizeof( cache_name ) );
+
+	int file;
+	int len = FS_FOpenFile( cache_name, &file, FS_READ | FS_CACHE );
+	if( len == -1 )
+		return false;
+
+	PCMCacheHeader header;
+	bool ok = len >= int( sizeof( header ) ) && FS_Read( &header, sizeof( header ), file ) == sizeof( header );
+	ok = ok && memcmp( header.magic, S_PCM_CACHE_MAGIC, sizeof( header.magic ) ) == 0;
+	ok = ok && header.version == S_PCM_CACHE_VERSION && header.key == key;
+	ok = ok && ( header.channels == 1 || header.channels == 2 ) && header.num_samples >= 0;
+
+	size_t data_size = ok ? size_t( header.num_samples ) * header.channels * sizeof( int16_t ) : 0;
+	ok = ok && data_size == size_t( len ) - sizeof( header );
+
+	if( ok ) {
+		sfx->samples = ( int16_t * ) malloc( Max2( data_size, size_t( 1 ) ) );
+		if( FS_Read( sfx->samples, data_size, file ) != int( data_size ) ) {
+			free( sfx->samples );
+			sfx->samples = NULL;
+			ok = false;
+		}
+	}
+
+	FS_FCloseFile( file );
+
+	if( !ok )
+		return false;
+
+	sfx->channels = header.channels;
+	sfx->sample_rate = header.sample_rate;
+	sfx->num_samples = header.num_samples;
+	sfx->from_cache = true;
 
-	// TODO: maybe we need to dedupe this.
-	Q_strncpyz( sfx->filename, filename, sizeof( sfx->filename ) - 1 );
-	Q_strncatz( sfx->filename, ".ogg", sizeof( sfx->filename ) - 1 );
+	return true;
+}
+
+static void S_WritePCMCache( const SoundAsset * sfx, uint32_t key ) {
+	char cache_name[ MAX_QPATH ];
+	S_PCMCacheName( sfx, cache_name, sizeof( cache_name ) );
+
+	int file;
+	if( FS_FOpenFile( cache_name, &file, FS_WRITE | FS_CACHE ) == -1 )
+		return;
+
+	PCMCacheHeader header;
+	memcpy( header.magic, S_PCM_CACHE_MAGIC, sizeof( header.magic ) );
+	header.version = S_PCM_CACHE_VERSION;
+	header.key = key;
+	header.channels = sfx->channels;
+	header.sample_rate = sfx->sample_rate;
+	header.num_samples = sfx->num_samples;
+
+	FS_Write( &header, sizeof( header ), file );
+	FS_Write( sfx->samples, size_t( sfx->num_samples ) * sfx->channels * sizeof( int16_t ), file );
+	FS_FCloseFile( file );
+}
+
+/*
+* S_DecodeSound
+*
+* Runs as a job. Sounds that live in a pk3 are keyed on the pk3
+* checksum so a warm cache never touches the ogg, loose files are keyed on
+* a hash of their contents.
+*/
+static bool S_DecodeSound( SoundAsset * sfx ) {
+	uint32_t key = 0;
+	const char * pakname = FS_PakNameForFile( sfx->filename );
+	if( pakname != NULL ) {
+		key = Hash32( sfx->filename, strlen( sfx->filename ), FS_ChecksumBaseFile( pakname, false ) );
+		if( S_ReadPCMCache( sfx, key ) )
+			return true;
+	}
 
 	uint8_t * compressed_data;
 	int compressed_len = FS_LoadFile( sfx->filename, ( void ** ) &compressed_data, NULL, 0 );
 	if( compressed_data == NULL ) {
 		Com_Printf( S_COLOR_RED "Couldn't read file %s\n", sfx->filename );
-		return NULL;
+		return false;
+	}
+
+	if( pakname == NULL ) {
+		key = Hash32( compressed_data, compressed_len );
+		if( S_ReadPCMCache( sfx, key ) ) {
+			FS_FreeFile( compressed_data );
+			return true;
+		}
 	}
 
 	int channels, sample_rate;
 	int16_t * data;
 	int num_samples = stb_vorbis_decode_memory( compressed_data, compressed_len, &channels, &sample_rate, &data );
+	FS_FreeFile( compressed_data );
+
 	if( channels == -1 ) {
 		Com_Printf( S_COLOR_RED "Couldn't decode sound %s\n", sfx->filename );
-		FS_FreeFile( compressed_data );
-		return NULL;
+		return false;
 	}
 
-	if( !allow_stereo && channels != 1 ) {
+	sfx->samples = data;
+	sfx->num_samples = num_samples;
+	sfx->channels = channels;
+	sfx->sample_rate = sample_rate;
+	sfx->from_cache = false;
+
+	S_WritePCMCache( sfx, key );
+
+	return true;
+}
+
+static void S_DecodeJob( void * data ) {
+	SoundAsset * sfx = ( SoundAsset * ) data;
+	sfx->state = S_DecodeSound( sfx ) ? SoundAssetState_Decoded : SoundAssetState_Failed;
+}
+
+static void S_FinishDecodeJobs() {
+	for( size_t i = 0; i < num_sound_assets; i++ ) {
+		QJob_Wait( &sound_assets[ i ].decoding );
+		free( sound_assets[ i ].samples );
+		sound_assets[ i ].samples = NULL;
+	}
+}
+
+static void S_UploadSound( SoundAsset * sfx ) {
+	if( QAtomic_FetchAdd( &sfx->decoding, 0 ) != 0 || sfx->state != SoundAssetState_Decoded )
+		return;
+
+	if( !sfx->allow_stereo && sfx->channels != 1 ) {
 		Com_Printf( S_COLOR_RED "Couldn't load sound %s: needs to be a mono file!\n", sfx->filename );
-		FS_FreeFile( compressed_data );
-		free( data );
-		return NULL;
+		sfx->state = SoundAssetState_Failed;
+	} else {
+		ALenum format = sfx->channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+		alBufferData( sfx->buffer, format, sfx->samples, sfx->num_samples * sfx->channels * sizeof( int16_t ), sfx->sample_rate );
+		S_ALAssert();
+		sfx->state = SoundAssetState_Uploaded;
+
+		if( sfx->from_cache )
+			decode_batch_cached++;
+		else
+			decode_batch_decoded++;
+	}
+
+	free( sfx->samples );
+	sfx->samples = NULL;
+}
+
+/*
+* S_UploadDecodedSounds
+*
+* Hands finished decodes to OpenAL. Only this thread talks to OpenAL, the
+* decode jobs just produce PCM.
+*/
+static void S_UploadDecodedSounds() {
+	bool had_work = upload_cursor < num_sound_assets;
+
+	for( size_t i = upload_cursor; i < num_sound_assets; i++ ) {
+		SoundAsset * sfx = &sound_assets[ i ];
+		S_UploadSound( sfx );
+		if( i == upload_cursor && ( sfx->state == SoundAssetState_Uploaded || sfx->state == SoundAssetState_Failed ) )
+			upload_cursor++;
 	}
 
-	ALenum format = channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+	if( had_work && upload_cursor == num_sound_assets ) {
+		float ms = ( Sys_Microseconds() - decode_batch_start ) / 1000.0f;
+		Com_Printf( "Loaded %i sounds in %.2fms (%i from cache, %i decoded)\n",
+			decode_batch_cached + decode_batch_decoded, ms, decode_batch_cached, decode_batch_decoded );
+	}
+}
+
+/*
+* S_FinishSound
+*
+* Blocks until sfx has been decoded and uploaded. Returns false if it failed to load.
+*/
+static bool S_FinishSound( SoundAsset * sfx ) {
+	if( sfx->state == SoundAssetState_Uploaded )
+		return true;
+
+	QJob_Wait( &sfx->decoding );
+	S_UploadDecodedSounds();
+
+	return sfx->state == SoundAssetState_Uploaded;
+}
+
+static SoundAsset * S_Register( const char * filename, bool allow_stereo ) {
+	MICROPROFILE_SCOPEI( "Assets", "S_Register", 0xffffffff );
+
+	char ogg[ MAX_QPATH ];
+	Q_strncpyz( ogg, filename, sizeof( ogg ) - 1 );
+	Q_strncatz( ogg, ".ogg", sizeof( ogg ) - 1 );
+	uint32_t hash = Hash32( ogg );
+
+	for( size_t i = 0; i < num_sound_assets; i++ ) {
+		SoundAsset * sfx = &sound_assets[ i ];
+		if( sfx->hash == hash && strcmp( sfx->filename, ogg ) == 0 ) {
+			sfx->allow_stereo = sfx->allow_stereo || allow_stereo;
+			return sfx;
+		}
+	}
+
+	assert( num_sound_assets < ARRAY_COUNT( sound_assets ) );
+
+	if( upload_cursor == num_sound_assets ) {
+		decode_batch_start = Sys_Microseconds();
+		decode_batch_cached = 0;
+		decode_batch_decoded = 0;
+	}
+
+	SoundAsset * sfx = &sound_assets[ num_sound_assets ];
+	Q_strncpyz( sfx->filename, ogg, sizeof( sfx->filename ) );
+	sfx->hash = hash;
+	sfx->allow_stereo = allow_stereo;
+	sfx->state = SoundAssetState_Decoding;
+	sfx->decoding = 0;
+	sfx->samples = NULL;
 	alGenBuffers( 1, &sfx->buffer );
-	alBufferData( sfx->buffer, format, data, num_samples * channels * sizeof( int16_t ), sample_rate );
 	S_ALAssert();
 
-	free( data );
-	FS_FreeFile( compressed_data );
-
 	num_sound_assets++;
+	QJob_Submit( S_DecodeJob, sfx, &sfx->decoding );
 
 	return sfx;
 }
@@ -195,6 +420,8 @@ bool S_Init() {
 	if( !S_InitAL() )
 		return false;
 
+	upload_cursor = 0;
+
 	menu_music_asset = S_Register( "sounds/music/menu_1", true );
 	initialized = true;
 
@@ -207,6 +434,8 @@ void S_Shutdown() {
 
 	S_StopAllSounds( true );
 
+	S_FinishDecodeJobs();
+
 	for( size_t i = 0; i < ARRAY_COUNT( playing_sounds ); i++ ) {
 		alDeleteSources( 1, &playing_sounds[ i ].source );
 	}
@@ -240,6 +469,8 @@ void S_Update( const vec3_t origin, const vec3_t velocity, const mat3_t axis ) {
 	if( !initialized )
 		return;
 
+	S_UploadDecodedSounds();
+
 	if( s_muteinbackground->modified ) {
 		alListenerf( AL_GAIN, window_focused || s_muteinbackground->integer == 0 ? 1 : 0 );
 		s_muteinbackground->modified = false;
@@ -343,6 +574,9 @@ static bool S_StartSound( SoundAsset * sfx, const vec3_t origin, int ent_num, in
 	if( !initialized || sfx == NULL )
 		return false;
 
+	if( !S_FinishSound( sfx ) )
+		return false;
+
 	PlayingSound * ps = S_FindEmptyPlayingSound( ent_num, channel );
 	if( ps == NULL ) {
 		Com_Printf( S_COLOR_RED "Too many playing sounds!" );
@@ -442,6 +676,9 @@ void S_StartMenuMusic() {
 	if( !initialized || menu_music_asset == NULL )
 		return;
 
+	if( !S_FinishSound( menu_music_asset ) )
+		return;
+
 	alSourcefv( music_source, AL_POSITION, vec3_origin );
 	alSourcefv( music_source, AL_VELOCITY, vec3_origin );
 	alSourcef( music_source, AL_GAIN, s_volume->value * s_musicvolume->value );
@@ -126,6 +126,11 @@ typedef struct {
 	size_t offset;
 	int retries;
 	size_t baseoffset;              // for download speed calculation when resuming downloads
+	uint8_t *blocks;                // blocks received ahead of offset, see CL_ParseDownload
+	int blockindex[DOWNLOAD_MAX_WINDOW];    // -1 for free slots
+	int blocksize[DOWNLOAD_MAX_WINDOW];
+	bool ackpending;
+	int64_t acktime;
 
 	// web download
 	bool web;
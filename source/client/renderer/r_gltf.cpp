@@ -1,6 +1,6 @@
 #include "qcommon/base.h"
-#include "qalgo/hash.h"
 #include "r_local.h"
+#include "r_skeleton.h"
 
 #include "cgltf/cgltf.h"
 
@@ -20,40 +20,7 @@ struct GLTFModel {
 	GLTFMesh meshes[ 16 ];
 	u32 num_meshes;
 
-	template< typename T >
-	struct AnimationChannel {
-		T * samples;
-		float * times;
-		u32 num_samples;
-	};
-
-	struct Joint {
-		Mat4 joint_to_bind;
-		u8 parent;
-		u8 next;
-
-		// TODO: remove this with additive animations
-		u32 name;
-		u8 first_child;
-		u8 sibling;
-
-		AnimationChannel< Quaternion > rotations;
-		AnimationChannel< Vec3 > translations;
-		AnimationChannel< float > scales;
-	};
-
-	// struct AnimationClip {
-	//         float start_time;
-	//         float duration;
-	//         bool loop;
-	// };
-
-	Joint * joints;
-	u8 num_joints;
-	u8 root_joint;
-
-	// AnimationClip * clips;
-	// u32 num_clips;
+	Skeleton skeleton;
 };
 
 // like cgltf_load_buffers, but doesn't try to load URIs
@@ -87,70 +54,15 @@ static Span< const u8 > AccessorToSpan( const cgltf_accessor * accessor ) {
 	return Span< const u8 >( ( const u8 * ) accessor->buffer_view->buffer->data + offset, accessor->count * accessor->stride );
 }
 
-static u8 GetJointIdx( const cgltf_node * node ) {
-	return u8( uintptr_t( node->camera ) - 1 );
-}
-
-static void SetJointIdx( cgltf_node * node, u8 joint_idx ) {
-	node->camera = ( cgltf_camera * ) uintptr_t( joint_idx + 1 );
-}
-
-static void LoadJoint( GLTFModel * gltf, const cgltf_skin * skin, cgltf_node * node, u8 ** prev ) {
-	u8 joint_idx = GetJointIdx( node );
-	**prev = joint_idx;
-	*prev = &gltf->joints[ joint_idx ].next;
-
-	GLTFModel::Joint & joint = gltf->joints[ joint_idx ];
-	joint.parent = node->parent != NULL ? GetJointIdx( node->parent ) : U8_MAX;
-	joint.name = Hash32( node->name );
-
-	cgltf_bool ok = cgltf_accessor_read_float( skin->inverse_bind_matrices, joint_idx, joint.joint_to_bind.ptr(), 16 );
-	assert( ok != 0 );
-
-	for( size_t i = 0; i < node->children_count; i++ ) {
-		LoadJoint( gltf, skin, node->children[ i ], prev );
-	}
-
-	// TODO: remove with additive animations
-	if( node->children_count == 0 ) {
-		joint.first_child = U8_MAX;
-	}
-	else {
-		joint.first_child = GetJointIdx( node->children[ 0 ] );
-
-		for( size_t i = 0; i < node->children_count - 1; i++ ) {
-			gltf->joints[ GetJointIdx( node->children[ i ] ) ].sibling = GetJointIdx( node->children[ i + 1 ] );
-		}
-
-		gltf->joints[ GetJointIdx( node->children[ node->children_count - 1 ] ) ].sibling = U8_MAX;
-	}
-}
-
 static void LoadSkin( GLTFModel * gltf, const cgltf_skin * skin, mat4_t transform ) {
-	gltf->joints = ( GLTFModel::Joint * ) malloc( sizeof( GLTFModel::Joint ) * skin->joints_count );
-	gltf->num_joints = skin->joints_count;
-
 	if( skin->joints_count == 0 )
 		return;
 
-	for( size_t i = 0; i < skin->joints_count; i++ ) {
-		SetJointIdx( skin->joints[ i ], i );
+	const cgltf_node * root = LoadSkeleton( &gltf->skeleton, skin );
+	if( root == NULL ) {
+		ri.Com_Error( ERR_DROP, "Model skin has roots with different parents" );
 	}
 
-	cgltf_node * root = NULL;
-	for( size_t i = 0; i < skin->joints_count; i++ ) {
-		cgltf_node * joint = skin->joints[ i ];
-		if( joint->parent == NULL || GetJointIdx( joint->parent ) == U8_MAX ) {
-			if( root != NULL ) {
-				ri.Com_Error( ERR_DROP, "Model skin has multiple roots" );
-			}
-			root = joint;
-		}
-	}
-
-	u8 * prev_ptr = &gltf->root_joint;
-	LoadJoint( gltf, skin, root, &prev_ptr );
-
 	if( root->parent != NULL ) {
 		mat4_t root_transform;
 		cgltf_node_transform_local( root->parent, root_transform );
@@ -159,9 +71,6 @@ static void LoadSkin( GLTFModel * gltf, const cgltf_skin * skin, mat4_t transfor
 		Matrix4_Copy( transform, t );
 		Matrix4_Multiply( t, root_transform, transform );
 	}
-
-	// TODO: remove with additive animations
-	gltf->joints[ GetJointIdx( root ) ].sibling = U8_MAX;
 }
 
 static void LoadNode( model_t * mod, GLTFModel * gltf, const cgltf_node * node, bool animated, mat4_t transform ) {
@@ -290,63 +199,6 @@ static void LoadNode( model_t * mod, GLTFModel * gltf, const cgltf_node * node,
 	gltf_mesh.num_elems = mesh.numElems;
 }
 
-template< typename T >
-static void LoadChannel( const cgltf_animation_channel * chan, GLTFModel::AnimationChannel< T > * out_channel ) {
-	constexpr size_t lanes = sizeof( T ) / sizeof( float );
-	size_t n = chan->sampler->input->count;
-
-	float * memory = ( float * ) malloc( n * ( lanes + 1 ) * sizeof( float ) );
-	out_channel->times = memory;
-	out_channel->samples = ( T * ) ( memory + n );
-	out_channel->num_samples = n;
-
-	for( size_t i = 0; i < n; i++ ) {
-		cgltf_bool ok = cgltf_accessor_read_float( chan->sampler->input, i, &out_channel->times[ i ], 1 );
-		ok = ok && cgltf_accessor_read_float( chan->sampler->output, i, out_channel->samples[ i ].ptr(), lanes );
-		assert( ok != 0 );
-	}
-}
-
-static void LoadScaleChannel( const cgltf_animation_channel * chan, GLTFModel::AnimationChannel< float > * out_channel ) {
-	size_t n = chan->sampler->input->count;
-
-	float * memory = ( float * ) malloc( n * 2 * sizeof( float ) );
-	out_channel->times = memory;
-	out_channel->samples = memory + n;
-	out_channel->num_samples = n;
-
-	for( size_t i = 0; i < n; i++ ) {
-		cgltf_accessor_read_float( chan->sampler->input, i, &out_channel->times[ i ], 1 );
-
-		float scale[ 3 ];
-		cgltf_accessor_read_float( chan->sampler->output, i, scale, 3 );
-
-		assert( fabsf( scale[ 0 ] / scale[ 1 ] - 1.0f ) < 0.001f );
-		assert( fabsf( scale[ 0 ] / scale[ 2 ] - 1.0f ) < 0.001f );
-
-		out_channel->samples[ i ] = scale[ 0 ];
-	}
-}
-
-static void LoadAnimation( GLTFModel * gltf, const cgltf_animation * animation ) {
-	for( size_t i = 0; i < animation->channels_count; i++ ) {
-		const cgltf_animation_channel * chan = &animation->channels[ i ];
-
-		assert( chan->target_node->camera != NULL );
-		u8 joint_idx = GetJointIdx( chan->target_node );
-
-		if( chan->target_path == cgltf_animation_path_type_translation ) {
-			LoadChannel( chan, &gltf->joints[ joint_idx ].translations );
-		}
-		else if( chan->target_path == cgltf_animation_path_type_rotation ) {
-			LoadChannel( chan, &gltf->joints[ joint_idx ].rotations );
-		}
-		else if( chan->target_path == cgltf_animation_path_type_scale ) {
-			LoadScaleChannel( chan, &gltf->joints[ joint_idx ].scales );
-		}
-	}
-}
-
 void Mod_LoadGLTFModel( model_t * mod, void * buffer, int buffer_size, const bspFormatDesc_t * bsp_format ) {
 	MICROPROFILE_SCOPEI( "Assets", "Mod_LoadGLTFModel", 0xffffffff );
 
@@ -398,7 +250,7 @@ void Mod_LoadGLTFModel( model_t * mod, void * buffer, int buffer_size, const bsp
 	}
 
 	if( animated ) {
-		LoadAnimation( gltf, &data->animations[ 0 ] );
+		LoadSkeletonAnimation( &gltf->skeleton, &data->animations[ 0 ] );
 	}
 
 	mod->radius = RadiusFromBounds( mod->mins, mod->maxs );
@@ -437,126 +289,32 @@ void R_CacheGLTFModelEntity( const entity_t * e ) {
 		cache->radius *= 2;
 }
 
-static void FindSampleAndLerpFrac( const float * times, u32 n, float t, u32 * sample, float * lerp_frac ) {
-	t = Clamp( times[ 0 ], t, times[ n - 1 ] );
-
-	*sample = 0;
-	for( u32 i = 1; i < n; i++ ) {
-		if( times[ i ] >= t ) {
-			*sample = i - 1;
-			break;
-		}
-	}
-
-	*lerp_frac = ( t - times[ *sample ] ) / ( times[ *sample + 1 ] - times[ *sample ] );
-}
-
-Span< TRS > R_SampleAnimation( ArenaAllocator * a, const model_t * model, float t ) {
+Span< TRS > R_SampleAnimation( ArenaAllocator * a, const model_t * model, float t, AnimationCursor * cursor ) {
 	assert( model->type == ModelType_GLTF );
 	const GLTFModel * gltf = ( const GLTFModel * ) model->extradata;
-
-	Span< TRS > local_poses = ALLOC_SPAN( a, TRS, gltf->num_joints );
-
-	for( u8 i = 0; i < gltf->num_joints; i++ ) {
-		const GLTFModel::Joint & joint = gltf->joints[ i ];
-
-		u32 rotation_sample, translation_sample, scale_sample;
-		float rotation_lerp_frac, translation_lerp_frac, scale_lerp_frac;
-
-		FindSampleAndLerpFrac( joint.rotations.times, joint.rotations.num_samples, t, &rotation_sample, &rotation_lerp_frac );
-		FindSampleAndLerpFrac( joint.translations.times, joint.translations.num_samples, t, &translation_sample, &translation_lerp_frac );
-		FindSampleAndLerpFrac( joint.scales.times, joint.scales.num_samples, t, &scale_sample, &scale_lerp_frac );
-
-		local_poses[ i ].rotation = NLerp( joint.rotations.samples[ rotation_sample ], rotation_lerp_frac, joint.rotations.samples[ ( rotation_sample + 1 ) % joint.rotations.num_samples ] );
-		local_poses[ i ].translation = Lerp( joint.translations.samples[ translation_sample ], translation_lerp_frac, joint.translations.samples[ ( translation_sample + 1 ) % joint.translations. num_samples ] );
-		local_poses[ i ].scale = Lerp( joint.scales.samples[ scale_sample ], scale_lerp_frac, joint.scales.samples[ ( scale_sample + 1 ) % joint.scales.num_samples ] );
-	}
-
-	return local_poses;
-}
-
-static Mat4 TRSToMat4( const TRS & trs ) {
-        Quaternion q = trs.rotation;
-        Vec3 t = trs.translation;
-        float s = trs.scale;
-
-        // return t * q * s;
-        return Mat4(
-                ( 1.0f - 2 * q.y * q.y - 2.0f * q.z * q.z ) * s,
-                ( 2.0f * q.x * q.y - 2.0f * q.z * q.w ) * s,
-                ( 2.0f * q.x * q.z + 2.0f * q.y * q.w ) * s,
-                t.x,
-
-                ( 2.0f * q.x * q.y + 2.0f * q.z * q.w ) * s,
-                ( 1.0f - 2.0f * q.x * q.x - 2.0f * q.z * q.z ) * s,
-                ( 2.0f * q.y * q.z - 2.0f * q.x * q.w ) * s,
-                t.y,
-
-                ( 2.0f * q.x * q.z - 2.0f * q.y * q.w ) * s,
-                ( 2.0f * q.y * q.z + 2.0f * q.x * q.w ) * s,
-                ( 1.0f - 2.0f * q.x * q.x - 2.0f * q.y * q.y ) * s,
-                t.z,
-
-                0.0f, 0.0f, 0.0f, 1.0f
-        );
+	return SampleSkeleton( a, &gltf->skeleton, t, cursor );
 }
 
 MatrixPalettes R_ComputeMatrixPalettes( ArenaAllocator * a, const model_t * model, Span< TRS > local_poses ) {
 	assert( model->type == ModelType_GLTF );
 	const GLTFModel * gltf = ( const GLTFModel * ) model->extradata;
-	assert( local_poses.n == gltf->num_joints );
-
-	MatrixPalettes palettes;
-	palettes.joint_poses = ALLOC_SPAN( a, Mat4, gltf->num_joints );
-	palettes.skinning_matrices = ALLOC_SPAN( a, Mat4, gltf->num_joints );
-
-	u8 joint_idx = gltf->root_joint;
-	palettes.joint_poses[ joint_idx ] = TRSToMat4( local_poses[ joint_idx ] );
-	for( u8 i = 0; i < gltf->num_joints - 1; i++ ) {
-		joint_idx = gltf->joints[ joint_idx ].next;
-		u8 parent = gltf->joints[ joint_idx ].parent;
-		palettes.joint_poses[ joint_idx ] = palettes.joint_poses[ parent ] * TRSToMat4( local_poses[ joint_idx ] );
-	}
-
-	for( u8 i = 0; i < gltf->num_joints; i++ ) {
-		palettes.skinning_matrices[ i ] = palettes.joint_poses[ i ] * gltf->joints[ i ].joint_to_bind;
-	}
-
-	return palettes;
+	return ComputeSkeletonPalettes( a, &gltf->skeleton, local_poses );
 }
 
-bool R_FindJointByName( const model_t * model, const char * name, u8 * joint_idx ) {
+const Skeleton * R_ModelSkeleton( const model_t * model ) {
 	assert( model->type == ModelType_GLTF );
 	const GLTFModel * gltf = ( const GLTFModel * ) model->extradata;
-
-	u32 hash = Hash32( name );
-	for( u8 i = 0; i < gltf->num_joints; i++ ) {
-		if( gltf->joints[ i ].name == hash ) {
-			*joint_idx = i;
-			return true;
-		}
-	}
-
-	return false;
+	return &gltf->skeleton;
 }
 
-static void MergePosesRecursive( Span< TRS > lower, Span< const TRS > upper, const GLTFModel * gltf, u8 i ) {
-	lower[ i ] = upper[ i ];
-
-	const GLTFModel::Joint & joint = gltf->joints[ i ];
-	if( joint.sibling != U8_MAX )
-		MergePosesRecursive( lower, upper, gltf, joint.sibling );
-	if( joint.first_child != U8_MAX )
-		MergePosesRecursive( lower, upper, gltf, joint.first_child );
+bool R_FindJointByName( const model_t * model, const char * name, u8 * joint_idx ) {
+	assert( model->type == ModelType_GLTF );
+	const GLTFModel * gltf = ( const GLTFModel * ) model->extradata;
+	return FindSkeletonJoint( &gltf->skeleton, name, joint_idx );
 }
 
 void R_MergeLowerUpperPoses( Span< TRS > lower, Span< const TRS > upper, const model_t * model, u8 upper_root_joint ) {
 	assert( model->type == ModelType_GLTF );
 	const GLTFModel * gltf = ( const GLTFModel * ) model->extradata;
-
-	lower[ upper_root_joint ] = upper[ upper_root_joint ];
-
-	const GLTFModel::Joint & joint = gltf->joints[ upper_root_joint ];
-	if( joint.first_child != U8_MAX )
-		MergePosesRecursive( lower, upper, gltf, joint.first_child );
+	MergeSkeletonPoses( lower, upper, &gltf->skeleton, upper_root_joint );
 }
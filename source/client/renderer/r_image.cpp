@@ -19,6 +19,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "r_local.h"
 #include "r_imagelib.h"
+#include "r_mipmap.h"
 #include "qalgo/hash.h"
 
 #include "blue_noise.h"
@@ -215,7 +216,6 @@ TEMPORARY IMAGE BUFFERS
 enum {
 	TEXTURE_LOADING_BUF,
 	TEXTURE_RESAMPLING_BUF,
-	TEXTURE_LINE_BUF,
 
 	NUM_IMAGE_BUFFERS
 };
@@ -353,95 +353,6 @@ static void R_FlipTexture( const uint8_t *in, uint8_t *out, int width, int heigh
 	}
 }
 
-/*
-* R_ResampleTexture
-*/
-static void R_ResampleTexture( const uint8_t *in, int inwidth, int inheight, uint8_t *out,
-							   int outwidth, int outheight, int samples, int alignment ) {
-	int i, j, k;
-	int inwidthS, outwidthS;
-	unsigned int frac, fracstep;
-	const uint8_t *inrow, *inrow2, *pix1, *pix2, *pix3, *pix4;
-	unsigned *p1, *p2;
-	uint8_t *opix;
-
-	if( inwidth == outwidth && inheight == outheight ) {
-		memcpy( out, in, inheight * ALIGN( inwidth * samples, alignment ) );
-		return;
-	}
-
-	p1 = ( unsigned * )R_PrepareImageBuffer( TEXTURE_LINE_BUF, outwidth * sizeof( *p1 ) * 2 );
-	p2 = p1 + outwidth;
-
-	fracstep = inwidth * 0x10000 / outwidth;
-
-	frac = fracstep >> 2;
-	for( i = 0; i < outwidth; i++ ) {
-		p1[i] = samples * ( frac >> 16 );
-		frac += fracstep;
-	}
-
-	frac = 3 * ( fracstep >> 2 );
-	for( i = 0; i < outwidth; i++ ) {
-		p2[i] = samples * ( frac >> 16 );
-		frac += fracstep;
-	}
-
-	inwidthS = ALIGN( inwidth * samples, alignment );
-	outwidthS = ALIGN( outwidth * samples, alignment );
-	for( i = 0; i < outheight; i++, out += outwidthS ) {
-		inrow = in + inwidthS * (int)( ( i + 0.25 ) * inheight / outheight );
-		inrow2 = in + inwidthS * (int)( ( i + 0.75 ) * inheight / outheight );
-		for( j = 0; j < outwidth; j++ ) {
-			pix1 = inrow + p1[j];
-			pix2 = inrow + p2[j];
-			pix3 = inrow2 + p1[j];
-			pix4 = inrow2 + p2[j];
-			opix = out + j * samples;
-
-			for( k = 0; k < samples; k++ )
-				opix[k] = ( pix1[k] + pix2[k] + pix3[k] + pix4[k] ) >> 2;
-		}
-	}
-}
-
-/*
-* R_MipMap
-*
-* Operates in place, quartering the size of the texture
-*/
-static void R_MipMap( uint8_t *in, int width, int height, int samples, int alignment ) {
-	int i, j, k;
-	int instride = ALIGN( width * samples, alignment );
-	int outwidth, outheight, outpadding;
-	uint8_t *out = in;
-	uint8_t *next;
-	int inofs;
-
-	outwidth = width >> 1;
-	outheight = height >> 1;
-	if( !outwidth ) {
-		outwidth = 1;
-	}
-	if( !outheight ) {
-		outheight = 1;
-	}
-	outpadding = ALIGN( outwidth * samples, alignment ) - outwidth * samples;
-
-	for( i = 0; i < outheight; i++, in += instride * 2, out += outpadding ) {
-		next = ( ( ( i << 1 ) + 1 ) < height ) ? ( in + instride ) : in;
-		for( j = 0, inofs = 0; j < outwidth; j++, inofs += samples ) {
-			if( ( ( j << 1 ) + 1 ) < width ) {
-				for( k = 0; k < samples; ++k, ++inofs )
-					*( out++ ) = ( in[inofs] + in[inofs + samples] + next[inofs] + next[inofs + samples] ) >> 2;
-			} else {
-				for( k = 0; k < samples; ++k, ++inofs )
-					*( out++ ) = ( in[inofs] + next[inofs] ) >> 1;
-			}
-		}
-	}
-}
-
 /*
 * R_TextureInternalFormat
 */
@@ -602,7 +513,6 @@ static void R_Upload32( const uint8_t *data,
 						bool subImage, bool noScale ) {
 	int comp, format, type;
 	int target;
-	uint8_t *scaled = NULL;
 	int scaledWidth, scaledHeight;
 
 	assert( samples );
@@ -631,18 +541,21 @@ static void R_Upload32( const uint8_t *data,
 			glTexImage2D( target, 0, comp, scaledWidth, scaledHeight, 0, format, type, data );
 		}
 	} else {
-		uint8_t *mip;
-
-		if( !scaled ) {
-			scaled = R_PrepareImageBuffer( TEXTURE_RESAMPLING_BUF, scaledWidth * scaledHeight * samples );
-		}
+		const uint8_t *mip = NULL;
+		uint8_t *buffers[2] = { NULL, NULL };
+		size_t size = scaledWidth * scaledHeight * samples;
+		int mipflags = ( flags & IT_SRGB ) ? MIP_SRGB : 0;
 
-		// resample the texture
-		mip = scaled;
+		// resample the texture, mip levels go back and forth between the two halves of the buffer
 		if( data ) {
-			R_ResampleTexture( data, width, height, (uint8_t *)mip, scaledWidth, scaledHeight, samples, 1 );
-		} else {
-			mip = NULL;
+			buffers[0] = R_PrepareImageBuffer( TEXTURE_RESAMPLING_BUF, size * 2 );
+			buffers[1] = buffers[0] + size;
+
+			mip = data;
+			if( scaledWidth != width || scaledHeight != height ) {
+				R_ResampleImage( data, width, height, buffers[0], scaledWidth, scaledHeight, samples, 1, mipflags );
+				mip = buffers[0];
+			}
 		}
 
 		if( subImage ) {
@@ -657,7 +570,10 @@ static void R_Upload32( const uint8_t *data,
 			int w = scaledWidth;
 			int h = scaledHeight;
 			while( w > minmipsize || h > minmipsize ) {
-				R_MipMap( mip, w, h, samples, 1 );
+				uint8_t *next = mip == buffers[0] ? buffers[1] : buffers[0];
+
+				R_MipMapImage( mip, w, h, next, samples, 1, mipflags );
+				mip = next;
 
 				w >>= 1;
 				h >>= 1;
@@ -304,6 +304,8 @@ extern cvar_t *r_mode;
 extern cvar_t *r_polyblend;
 extern cvar_t *r_screenshot_fmtstr;
 
+extern cvar_t *r_shadercache;
+
 extern cvar_t *r_drawflat;
 extern cvar_t *r_wallcolor;
 extern cvar_t *r_floorcolor;
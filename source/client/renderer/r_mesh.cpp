@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // r_mesh.c: transformation and sorting
 
 #include "r_local.h"
+#include "qalgo/radix_sort.h"
 
 drawList_t r_worldlist;
 
@@ -137,16 +138,16 @@ static int R_PackDistKey( int renderFx, const shader_t *shader, float dist, unsi
 /*
 * R_PackSortKey
 */
-static uint64_t R_PackSortKey( unsigned int shaderNum, unsigned int entNum ) {
-	return ( (uint64_t)shaderNum & 0xFFF ) << 36 | ( entNum & 0xFFF ) << 8;
+static uint64_t R_PackSortKey( unsigned int distKey, unsigned int shaderNum, unsigned int entNum ) {
+	return (uint64_t)distKey << 32 | ( shaderNum & 0xFFF ) << 12 | ( entNum & 0xFFF );
 }
 
 /*
 * R_UnpackSortKey
 */
 static void R_UnpackSortKey( uint64_t sortKey, unsigned int *shaderNum, unsigned int *entNum ) {
-	*shaderNum = ( sortKey >> 36 ) & 0xFFF;
-	*entNum = ( sortKey >> 8 ) & 0xFFF;
+	*shaderNum = ( sortKey >> 12 ) & 0xFFF;
+	*entNum = sortKey & 0xFFF;
 }
 
 /*
@@ -179,52 +180,31 @@ void *R_AddSurfToDrawList( drawList_t *list, const entity_t *e, const shader_t *
 
 	sds = &list->drawSurfs[list->numDrawSurfs++];
 	sds->drawSurf = ( const drawSurfaceType_t * )drawSurf;
-	sds->sortKey = R_PackSortKey( shader->id, R_ENT2NUM( e ) );
-	sds->distKey = distKey;
+	sds->sortKey = R_PackSortKey( distKey, shader->id, R_ENT2NUM( e ) );
 
 	return sds;
 }
 
 /*
-* R_DrawSurfCompare
-*
-* Comparison callback function for R_SortDrawList
+* R_DrawSurfSortKey
 */
-static int R_DrawSurfCompare( const sortedDrawSurf_t *sbs1, const sortedDrawSurf_t *sbs2 ) {
-	if( sbs1->distKey > sbs2->distKey ) {
-		return 1;
-	}
-	if( sbs2->distKey > sbs1->distKey ) {
-		return -1;
-	}
-
-	if( sbs1->sortKey > sbs2->sortKey ) {
-		return 1;
-	}
-	if( sbs2->sortKey > sbs1->sortKey ) {
-		return -1;
-	}
-
-	if( sbs1->drawSurf > sbs2->drawSurf ) {
-		return 1;
-	}
-	if( sbs2->drawSurf > sbs1->drawSurf ) {
-		return -1;
-	}
-
-	return 0;
+static uint64_t R_DrawSurfSortKey( const sortedDrawSurf_t &sds ) {
+	return sds.sortKey;
 }
 
 /*
 * R_SortDrawList
 *
-* Regular quicksort. Note that for all kinds of transparent meshes
-* you probably want to set distance or draw order to prevent flickering
-* due to quicksort's unstable nature.
+* Stable radix sort on the packed keys, so surfaces with equal keys keep
+* the order they were added in and don't swap places between frames.
 */
 void R_SortDrawList( drawList_t *list ) {
-	qsort( list->drawSurfs, list->numDrawSurfs, sizeof( sortedDrawSurf_t ),
-		   ( int ( * )( const void *, const void * ) )R_DrawSurfCompare );
+	void *mark = R_FrameCache_SetMark();
+	sortedDrawSurf_t *scratch = ( sortedDrawSurf_t * ) R_FrameCache_Alloc( list->numDrawSurfs * sizeof( sortedDrawSurf_t ) );
+
+	RadixSort64( list->drawSurfs, scratch, list->numDrawSurfs, R_DrawSurfSortKey );
+
+	R_FrameCache_FreeToMark( mark );
 }
 
 static const drawSurf_cb r_drawSurfCb[ST_MAX_TYPES] =
@@ -312,7 +292,7 @@ static const flushBatchDrawSurf_cb r_flushBatchSurfCb[ST_MAX_TYPES] =
 */
 static void _R_DrawSurfaces( drawList_t *list, bool *depthCopied, int mode, int drawSurfTypeEq, int drawSurfTypeNeq, unsigned minSort, unsigned maxSort ) {
 	unsigned int i;
-	unsigned distKey, sortDist;
+	unsigned sortDist;
 	uint64_t sortKey;
 	unsigned int shaderNum = 0, prevShaderNum = MAX_SHADERS;
 	unsigned int entNum = 0, prevEntNum = MAX_REF_ENTITIES;
@@ -345,9 +325,8 @@ static void _R_DrawSurfaces( drawList_t *list, bool *depthCopied, int mode, int
 
 	for( i = 0; i < list->numDrawSurfs; i++ ) {
 		sds = list->drawSurfs + i;
-		distKey = sds->distKey;
 		sortKey = sds->sortKey;
-		sortDist = (distKey >> 26) & 31;
+		sortDist = ( sortKey >> 58 ) & 31;
 		drawSurfType = *(int *)sds->drawSurf;
 
 		assert( drawSurfType > ST_NONE && drawSurfType < ST_MAX_TYPES );
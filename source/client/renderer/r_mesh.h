@@ -41,8 +41,8 @@ typedef struct mesh_s {
 	uint8_t             *blendWeights;
 } mesh_t;
 
+// the distance key in the high 32 bits, then the shader and entity numbers
 typedef struct {
-	unsigned int distKey;
 	uint64_t sortKey;
 	const drawSurfaceType_t *drawSurf;
 } sortedDrawSurf_t;
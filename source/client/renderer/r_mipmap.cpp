@@ -0,0 +1,454 @@
+#include "qcommon/qcommon.h"
+#include "qcommon/qthreads.h"
+#include "r_mipmap.h"
+
+#include <emmintrin.h>
+
+#define MIP_JOB_PIXELS  16384   // output pixels per job, levels smaller than this aren't split
+
+typedef struct {
+	const uint8_t *in;
+	uint8_t *out;
+	int inwidth, inheight;
+	int outwidth, outheight;
+	int instride, outstride;
+	int samples;
+	int colorsamples;           // channels averaged in linear light, 0 unless MIP_SRGB
+	const unsigned *taps;       // resampling: byte offsets of the left and right taps of each column
+} imagescale_t;
+
+typedef struct {
+	uint16_t tolinear[256];
+	uint8_t tosrgb[65536];
+} srgbtables_t;
+
+/*
+* R_BuildSRGBTables
+*
+* Linear values are 16 bit so every sRGB value survives the round trip
+*/
+static srgbtables_t *R_BuildSRGBTables( void ) {
+	static srgbtables_t tables;
+
+	for( int i = 0; i < 256; i++ ) {
+		float c = i / 255.0f;
+		float l = c <= 0.04045f ? c / 12.92f : powf( ( c + 0.055f ) / 1.055f, 2.4f );
+		tables.tolinear[i] = (uint16_t)( l * 65535.0f + 0.5f );
+	}
+
+	for( int i = 0; i < 65536; i++ ) {
+		float l = i / 65535.0f;
+		float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf( l, 1.0f / 2.4f ) - 0.055f;
+		tables.tosrgb[i] = (uint8_t)Clamp( 0, (int)( c * 255.0f + 0.5f ), 255 );
+	}
+
+	return &tables;
+}
+
+static const srgbtables_t *R_SRGBTables( void ) {
+	static const srgbtables_t *tables = R_BuildSRGBTables();
+	return tables;
+}
+
+static inline uint8_t R_AverageSRGB4( const srgbtables_t *t, int a, int b, int c, int d ) {
+	return t->tosrgb[( t->tolinear[a] + t->tolinear[b] + t->tolinear[c] + t->tolinear[d] + 2 ) >> 2];
+}
+
+static inline uint8_t R_AverageSRGB2( const srgbtables_t *t, int a, int b ) {
+	return t->tosrgb[( t->tolinear[a] + t->tolinear[b] + 1 ) >> 1];
+}
+
+static inline __m128i R_Load32( const uint8_t *p ) {
+	int v;
+	memcpy( &v, p, sizeof( v ) );
+	return _mm_cvtsi32_si128( v );
+}
+
+/*
+* R_ScaleRows
+*
+* Runs a row kernel over every output row, in bands across the job pool when
+* the image is big enough to make it worthwhile
+*/
+static void R_ScaleRows( imagescale_t *s, void ( *kernel )( void *data, int begin, int end ), int flags ) {
+	int batch = Max2( 1, MIP_JOB_PIXELS / s->outwidth );
+
+	if( ( flags & MIP_SERIAL ) || s->outheight <= batch ) {
+		kernel( s, 0, s->outheight );
+		return;
+	}
+
+	QJob_ParallelFor( s->outheight, batch, kernel, s );
+}
+
+/*
+==============================================================================
+
+RESAMPLING
+
+==============================================================================
+*/
+
+/*
+* R_ResampleRows_Scalar
+*/
+static void R_ResampleRows_Scalar( void *data, int begin, int end ) {
+	const imagescale_t *s = ( const imagescale_t * )data;
+	const srgbtables_t *t = s->colorsamples ? R_SRGBTables() : NULL;
+	const unsigned *p1 = s->taps, *p2 = s->taps + s->outwidth;
+	int samples = s->samples;
+
+	for( int i = begin; i < end; i++ ) {
+		const uint8_t *inrow = s->in + s->instride * (int)( ( i + 0.25 ) * s->inheight / s->outheight );
+		const uint8_t *inrow2 = s->in + s->instride * (int)( ( i + 0.75 ) * s->inheight / s->outheight );
+		uint8_t *out = s->out + s->outstride * i;
+
+		for( int j = 0; j < s->outwidth; j++ ) {
+			const uint8_t *pix1 = inrow + p1[j];
+			const uint8_t *pix2 = inrow + p2[j];
+			const uint8_t *pix3 = inrow2 + p1[j];
+			const uint8_t *pix4 = inrow2 + p2[j];
+			uint8_t *opix = out + j * samples;
+			int k;
+
+			for( k = 0; k < s->colorsamples; k++ )
+				opix[k] = R_AverageSRGB4( t, pix1[k], pix2[k], pix3[k], pix4[k] );
+			for( ; k < samples; k++ )
+				opix[k] = ( pix1[k] + pix2[k] + pix3[k] + pix4[k] ) >> 2;
+		}
+	}
+}
+
+/*
+* R_ResampleRows_SSE2
+*
+* Gathers the taps of 4 RGBA pixels at a time, everything else goes to the scalar kernel
+*/
+static void R_ResampleRows_SSE2( void *data, int begin, int end ) {
+	const imagescale_t *s = ( const imagescale_t * )data;
+	const unsigned *p1 = s->taps, *p2 = s->taps + s->outwidth;
+	const __m128i zero = _mm_setzero_si128();
+
+	if( s->samples != 4 || s->colorsamples ) {
+		R_ResampleRows_Scalar( data, begin, end );
+		return;
+	}
+
+	for( int i = begin; i < end; i++ ) {
+		const uint8_t *inrow = s->in + s->instride * (int)( ( i + 0.25 ) * s->inheight / s->outheight );
+		const uint8_t *inrow2 = s->in + s->instride * (int)( ( i + 0.75 ) * s->inheight / s->outheight );
+		uint8_t *out = s->out + s->outstride * i;
+		int j;
+
+		for( j = 0; j + 4 <= s->outwidth; j += 4 ) {
+			__m128i a = _mm_unpacklo_epi32(
+				_mm_unpacklo_epi32( R_Load32( inrow + p1[j] ), R_Load32( inrow + p1[j + 2] ) ),
+				_mm_unpacklo_epi32( R_Load32( inrow + p1[j + 1] ), R_Load32( inrow + p1[j + 3] ) ) );
+			__m128i b = _mm_unpacklo_epi32(
+				_mm_unpacklo_epi32( R_Load32( inrow + p2[j] ), R_Load32( inrow + p2[j + 2] ) ),
+				_mm_unpacklo_epi32( R_Load32( inrow + p2[j + 1] ), R_Load32( inrow + p2[j + 3] ) ) );
+			__m128i c = _mm_unpacklo_epi32(
+				_mm_unpacklo_epi32( R_Load32( inrow2 + p1[j] ), R_Load32( inrow2 + p1[j + 2] ) ),
+				_mm_unpacklo_epi32( R_Load32( inrow2 + p1[j + 1] ), R_Load32( inrow2 + p1[j + 3] ) ) );
+			__m128i d = _mm_unpacklo_epi32(
+				_mm_unpacklo_epi32( R_Load32( inrow2 + p2[j] ), R_Load32( inrow2 + p2[j + 2] ) ),
+				_mm_unpacklo_epi32( R_Load32( inrow2 + p2[j + 1] ), R_Load32( inrow2 + p2[j + 3] ) ) );
+
+			__m128i lo = _mm_add_epi16( _mm_add_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) ),
+										_mm_add_epi16( _mm_unpacklo_epi8( c, zero ), _mm_unpacklo_epi8( d, zero ) ) );
+			__m128i hi = _mm_add_epi16( _mm_add_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) ),
+										_mm_add_epi16( _mm_unpackhi_epi8( c, zero ), _mm_unpackhi_epi8( d, zero ) ) );
+
+			_mm_storeu_si128( ( __m128i * )( out + j * 4 ), _mm_packus_epi16( _mm_srli_epi16( lo, 2 ), _mm_srli_epi16( hi, 2 ) ) );
+		}
+
+		for( ; j < s->outwidth; j++ ) {
+			const uint8_t *pix1 = inrow + p1[j];
+			const uint8_t *pix2 = inrow + p2[j];
+			const uint8_t *pix3 = inrow2 + p1[j];
+			const uint8_t *pix4 = inrow2 + p2[j];
+
+			for( int k = 0; k < 4; k++ )
+				out[j * 4 + k] = ( pix1[k] + pix2[k] + pix3[k] + pix4[k] ) >> 2;
+		}
+	}
+}
+
+/*
+* R_ResampleImage
+*/
+void R_ResampleImage( const uint8_t *in, int inwidth, int inheight, uint8_t *out,
+					  int outwidth, int outheight, int samples, int alignment, int flags ) {
+	imagescale_t s;
+	unsigned *taps;
+	unsigned int frac, fracstep;
+
+	if( inwidth == outwidth && inheight == outheight ) {
+		memcpy( out, in, inheight * ALIGN( inwidth * samples, alignment ) );
+		return;
+	}
+
+	taps = ( unsigned * )Q_malloc( outwidth * sizeof( *taps ) * 2 );
+
+	fracstep = inwidth * 0x10000 / outwidth;
+
+	frac = fracstep >> 2;
+	for( int i = 0; i < outwidth; i++ ) {
+		taps[i] = samples * ( frac >> 16 );
+		frac += fracstep;
+	}
+
+	frac = 3 * ( fracstep >> 2 );
+	for( int i = 0; i < outwidth; i++ ) {
+		taps[outwidth + i] = samples * ( frac >> 16 );
+		frac += fracstep;
+	}
+
+	s.in = in;
+	s.out = out;
+	s.inwidth = inwidth;
+	s.inheight = inheight;
+	s.outwidth = outwidth;
+	s.outheight = outheight;
+	s.instride = ALIGN( inwidth * samples, alignment );
+	s.outstride = ALIGN( outwidth * samples, alignment );
+	s.samples = samples;
+	s.colorsamples = ( flags & MIP_SRGB ) && samples >= 3 ? 3 : 0;
+	s.taps = taps;
+
+	R_ScaleRows( &s, ( flags & MIP_SCALAR ) ? R_ResampleRows_Scalar : R_ResampleRows_SSE2, flags );
+
+	Q_free( taps );
+}
+
+/*
+==============================================================================
+
+MIPMAPS
+
+==============================================================================
+*/
+
+/*
+* R_MipMapRows_Scalar
+*/
+static void R_MipMapRows_Scalar( void *data, int begin, int end ) {
+	const imagescale_t *s = ( const imagescale_t * )data;
+	const srgbtables_t *t = s->colorsamples ? R_SRGBTables() : NULL;
+	int samples = s->samples;
+
+	for( int i = begin; i < end; i++ ) {
+		const uint8_t *in = s->in + s->instride * 2 * i;
+		const uint8_t *next = ( ( i << 1 ) + 1 ) < s->inheight ? in + s->instride : in;
+		uint8_t *out = s->out + s->outstride * i;
+
+		// a single column can only be averaged vertically
+		if( s->inwidth < 2 ) {
+			int k;
+			for( k = 0; k < s->colorsamples; k++ )
+				out[k] = R_AverageSRGB2( t, in[k], next[k] );
+			for( ; k < samples; k++ )
+				out[k] = ( in[k] + next[k] ) >> 1;
+			continue;
+		}
+
+		for( int j = 0; j < s->outwidth; j++, in += samples * 2, next += samples * 2, out += samples ) {
+			int k;
+			for( k = 0; k < s->colorsamples; k++ )
+				out[k] = R_AverageSRGB4( t, in[k], in[k + samples], next[k], next[k + samples] );
+			for( ; k < samples; k++ )
+				out[k] = ( in[k] + in[k + samples] + next[k] + next[k + samples] ) >> 2;
+		}
+	}
+}
+
+/*
+* R_MipMapRow_SSE2_1
+*
+* 16 output pixels from 32 bytes of each row, returns how many it did
+*/
+static int R_MipMapRow_SSE2_1( const uint8_t *in, const uint8_t *next, uint8_t *out, int outwidth ) {
+	const __m128i lowbytes = _mm_set1_epi16( 0x00FF );
+	int j;
+
+	for( j = 0; j + 16 <= outwidth; j += 16 ) {
+		__m128i sums[2];
+
+		for( int h = 0; h < 2; h++ ) {
+			__m128i a = _mm_loadu_si128( ( const __m128i * )( in + j * 2 + h * 16 ) );
+			__m128i b = _mm_loadu_si128( ( const __m128i * )( next + j * 2 + h * 16 ) );
+			__m128i sum = _mm_add_epi16( _mm_and_si128( a, lowbytes ), _mm_srli_epi16( a, 8 ) );
+			sum = _mm_add_epi16( sum, _mm_add_epi16( _mm_and_si128( b, lowbytes ), _mm_srli_epi16( b, 8 ) ) );
+			sums[h] = _mm_srli_epi16( sum, 2 );
+		}
+
+		_mm_storeu_si128( ( __m128i * )( out + j ), _mm_packus_epi16( sums[0], sums[1] ) );
+	}
+
+	return j;
+}
+
+/*
+* R_MipMapRow_SSE2_2
+*
+* 8 output pixels from 32 bytes of each row, returns how many it did
+*/
+static int R_MipMapRow_SSE2_2( const uint8_t *in, const uint8_t *next, uint8_t *out, int outwidth ) {
+	const __m128i lowbytes = _mm_set1_epi16( 0x00FF );
+	const __m128i ones = _mm_set1_epi16( 1 );
+	int j;
+
+	for( j = 0; j + 8 <= outwidth; j += 8 ) {
+		__m128i sums[2];
+
+		for( int h = 0; h < 2; h++ ) {
+			__m128i a = _mm_loadu_si128( ( const __m128i * )( in + j * 4 + h * 16 ) );
+			__m128i b = _mm_loadu_si128( ( const __m128i * )( next + j * 4 + h * 16 ) );
+
+			// first channels in the low bytes, second in the high, summed across each pixel pair
+			__m128i first = _mm_add_epi32( _mm_madd_epi16( _mm_and_si128( a, lowbytes ), ones ),
+										   _mm_madd_epi16( _mm_and_si128( b, lowbytes ), ones ) );
+			__m128i second = _mm_add_epi32( _mm_madd_epi16( _mm_srli_epi16( a, 8 ), ones ),
+											_mm_madd_epi16( _mm_srli_epi16( b, 8 ), ones ) );
+			sums[h] = _mm_or_si128( _mm_srli_epi32( first, 2 ), _mm_slli_epi32( _mm_srli_epi32( second, 2 ), 16 ) );
+		}
+
+		_mm_storeu_si128( ( __m128i * )( out + j * 2 ), _mm_packus_epi16( sums[0], sums[1] ) );
+	}
+
+	return j;
+}
+
+/*
+* R_MipMapRow_SSE2_3
+*
+* 4 output pixels from 8 byte loads of each pixel pair, returns how many it did.
+* The loads and stores run a little past each pair, so the last pixel of the
+* row is always left to the scalar loop
+*/
+static int R_MipMapRow_SSE2_3( const uint8_t *in, const uint8_t *next, uint8_t *out, int outwidth ) {
+	const __m128i zero = _mm_setzero_si128();
+	int j;
+
+	for( j = 0; j + 4 < outwidth; j += 4 ) {
+		for( int h = 0; h < 2; h++ ) {
+			const uint8_t *a = in + ( j + h * 2 ) * 6;
+			const uint8_t *b = next + ( j + h * 2 ) * 6;
+			__m128i pa = _mm_unpacklo_epi64( _mm_loadl_epi64( ( const __m128i * )a ), _mm_loadl_epi64( ( const __m128i * )( a + 6 ) ) );
+			__m128i pb = _mm_unpacklo_epi64( _mm_loadl_epi64( ( const __m128i * )b ), _mm_loadl_epi64( ( const __m128i * )( b + 6 ) ) );
+
+			// one pixel pair in each half, the right pixel shifted onto the left
+			__m128i lo = _mm_add_epi16( _mm_unpacklo_epi8( pa, zero ), _mm_unpacklo_epi8( pb, zero ) );
+			__m128i hi = _mm_add_epi16( _mm_unpackhi_epi8( pa, zero ), _mm_unpackhi_epi8( pb, zero ) );
+			lo = _mm_srli_epi16( _mm_add_epi16( lo, _mm_srli_si128( lo, 6 ) ), 2 );
+			hi = _mm_srli_epi16( _mm_add_epi16( hi, _mm_srli_si128( hi, 6 ) ), 2 );
+
+			__m128i pixels = _mm_packus_epi16( lo, hi );
+			int left = _mm_cvtsi128_si32( pixels );
+			int right = _mm_cvtsi128_si32( _mm_srli_si128( pixels, 8 ) );
+			memcpy( out + ( j + h * 2 ) * 3, &left, sizeof( left ) );
+			memcpy( out + ( j + h * 2 ) * 3 + 3, &right, sizeof( right ) );
+		}
+	}
+
+	return j;
+}
+
+/*
+* R_MipMapRow_SSE2_4
+*
+* 4 output pixels from 32 bytes of each row, returns how many it did
+*/
+static int R_MipMapRow_SSE2_4( const uint8_t *in, const uint8_t *next, uint8_t *out, int outwidth ) {
+	const __m128i zero = _mm_setzero_si128();
+	int j;
+
+	for( j = 0; j + 4 <= outwidth; j += 4 ) {
+		__m128i sums[2];
+
+		for( int h = 0; h < 2; h++ ) {
+			__m128i a = _mm_loadu_si128( ( const __m128i * )( in + j * 8 + h * 16 ) );
+			__m128i b = _mm_loadu_si128( ( const __m128i * )( next + j * 8 + h * 16 ) );
+
+			// two pixel pairs, added vertically and then each pair across
+			__m128i lo = _mm_add_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) );
+			__m128i hi = _mm_add_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) );
+			__m128i sum = _mm_add_epi16( _mm_unpacklo_epi64( lo, hi ), _mm_unpackhi_epi64( lo, hi ) );
+			sums[h] = _mm_srli_epi16( sum, 2 );
+		}
+
+		_mm_storeu_si128( ( __m128i * )( out + j * 4 ), _mm_packus_epi16( sums[0], sums[1] ) );
+	}
+
+	return j;
+}
+
+/*
+* R_MipMapRows_SSE2
+*
+* The remaining pixels of each row, single columns and sRGB images go through
+* the scalar kernel
+*/
+static void R_MipMapRows_SSE2( void *data, int begin, int end ) {
+	const imagescale_t *s = ( const imagescale_t * )data;
+	int samples = s->samples;
+	int ( *row )( const uint8_t *in, const uint8_t *next, uint8_t *out, int outwidth );
+
+	if( s->colorsamples || s->inwidth < 2 ) {
+		R_MipMapRows_Scalar( data, begin, end );
+		return;
+	}
+
+	switch( samples ) {
+		case 1:
+			row = R_MipMapRow_SSE2_1;
+			break;
+		case 2:
+			row = R_MipMapRow_SSE2_2;
+			break;
+		case 3:
+			row = R_MipMapRow_SSE2_3;
+			break;
+		case 4:
+			row = R_MipMapRow_SSE2_4;
+			break;
+		default:
+			R_MipMapRows_Scalar( data, begin, end );
+			return;
+	}
+
+	for( int i = begin; i < end; i++ ) {
+		const uint8_t *in = s->in + s->instride * 2 * i;
+		const uint8_t *next = ( ( i << 1 ) + 1 ) < s->inheight ? in + s->instride : in;
+		uint8_t *out = s->out + s->outstride * i;
+		for( int j = row( in, next, out, s->outwidth ); j < s->outwidth; j++ ) {
+			const uint8_t *a = in + j * samples * 2;
+			const uint8_t *b = next + j * samples * 2;
+
+			for( int k = 0; k < samples; k++ )
+				out[j * samples + k] = ( a[k] + a[k + samples] + b[k] + b[k + samples] ) >> 2;
+		}
+	}
+}
+
+/*
+* R_MipMapImage
+*/
+void R_MipMapImage( const uint8_t *in, int width, int height, uint8_t *out,
+					int samples, int alignment, int flags ) {
+	imagescale_t s;
+
+	s.in = in;
+	s.out = out;
+	s.inwidth = width;
+	s.inheight = height;
+	s.outwidth = Max2( width >> 1, 1 );
+	s.outheight = Max2( height >> 1, 1 );
+	s.instride = ALIGN( width * samples, alignment );
+	s.outstride = ALIGN( s.outwidth * samples, alignment );
+	s.samples = samples;
+	s.colorsamples = ( flags & MIP_SRGB ) && samples >= 3 ? 3 : 0;
+	s.taps = NULL;
+
+	R_ScaleRows( &s, ( flags & MIP_SCALAR ) ? R_MipMapRows_Scalar : R_MipMapRows_SSE2, flags );
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "qcommon/types.h"
+
+enum {
+	MIP_SRGB    = 1 << 0,    // average the color channels of 3 and 4 sample images in linear light
+	MIP_SCALAR  = 1 << 1,    // use the plain C kernels the SIMD ones are checked against
+	MIP_SERIAL  = 1 << 2,    // don't split rows across the job pool
+};
+
+/*
+ * Both take rows that are padded to alignment bytes and never write outside
+ * out, which must not overlap in. Without MIP_SRGB the SIMD and scalar
+ * kernels give bit-exact results.
+ */
+
+// scales in to out, averaging 4 taps at the quarter points of every output pixel
+void R_ResampleImage( const uint8_t *in, int inwidth, int inheight, uint8_t *out,
+					  int outwidth, int outheight, int samples, int alignment, int flags );
+
+// writes the next mip level of in, which is half the size clamped to 1, to out
+void R_MipMapImage( const uint8_t *in, int width, int height, uint8_t *out,
+					int samples, int alignment, int flags );
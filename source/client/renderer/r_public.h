@@ -148,7 +148,8 @@ extern "C" QF_DLL_EXPORT ref_export_t *GetRefAPI( ref_import_t *import );
 void R_DrawDynamicPoly( const poly_t * poly );
 MinMax3 R_ModelBounds( const model_s *mod );
 
-Span< TRS > R_SampleAnimation( ArenaAllocator * a, const model_s * model, float t );
+Span< TRS > R_SampleAnimation( ArenaAllocator * a, const model_s * model, float t, AnimationCursor * cursor = NULL );
 MatrixPalettes R_ComputeMatrixPalettes( ArenaAllocator * a, const model_s * model, Span< TRS > local_poses );
+const struct Skeleton * R_ModelSkeleton( const model_s * model );
 bool R_FindJointByName( const model_s * model, const char * name, u8 * joint_idx );
 void R_MergeLowerUpperPoses( Span< TRS > lower, Span< const TRS > upper, const model_s * model, u8 upper_root_joint );
@@ -69,6 +69,8 @@ cvar_t *r_floorcolor;
 
 cvar_t *r_usenotexture;
 
+cvar_t *r_shadercache;
+
 static void R_FinalizeGLExtensions( void );
 static void R_GfxInfo_f( void );
 
@@ -270,6 +272,8 @@ static void R_Register() {
 
 	r_screenshot_fmtstr = ri.Cvar_Get( "r_screenshot_fmtstr", va_r( tmp, sizeof( tmp ), "%s%%y%%m%%d_%%H%%M%%S", APP_SCREENSHOTS_PREFIX ), CVAR_ARCHIVE );
 
+	r_shadercache = ri.Cvar_Get( "r_shadercache", "1", CVAR_ARCHIVE | CVAR_LATCH_VIDEO );
+
 	r_drawflat = ri.Cvar_Get( "r_drawflat", "1", CVAR_READONLY );
 	r_wallcolor = ri.Cvar_Get( "r_wallcolor", "8 8 8", CVAR_READONLY );
 	r_floorcolor = ri.Cvar_Get( "r_floorcolor", "32 32 32", CVAR_READONLY );
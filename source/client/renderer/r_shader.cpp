@@ -27,16 +27,71 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define SHADERS_HASH_SIZE   128
 #define SHADERCACHE_HASH_SIZE   128
 
+#define SHADERCACHE_FILE_NAME   "cache/shaders.cache.bin"
+#define SHADERCACHE_VERSION     1
+
+// compiled shader ops, see Shader_Compile
+enum {
+	SOP_END,
+	SOP_WARNING,                        // message
+	SOP_FLAGS,                          // shader flags to set
+	SOP_CULL,                           // cull flags
+	SOP_NOMIPMAPS,
+	SOP_NOFILTERING,
+	SOP_MINMIPSIZE,                     // size
+	SOP_SORT,                           // sort
+	SOP_DEFORM,                         // deformv_t, key
+	SOP_GLOSSINTENSITY,                 // intensity
+	SOP_GLOSSEXPONENT,                  // exponent
+	SOP_PASS,
+	SOP_ENDPASS,
+
+	POP_FLAGS,                          // pass flags to clear, pass flags to set
+	POP_RGBGEN,                         // type, COLORGEN bits, args[3], shaderfunc_t
+	POP_ALPHAGEN,                       // type, COLORGEN bits, args[3], shaderfunc_t
+	POP_TCMOD,                          // tcmod_t
+	POP_TCGEN,                          // tcgen, vec[8]
+	POP_MAP,                            // image flags, name
+	POP_ANIMMAP,                        // image flags, fps, names, ""
+	POP_MATERIAL,                       // diffuse name, names, ""
+};
+
+// what a POP_RGBGEN or POP_ALPHAGEN sets besides the type
+#define COLORGEN_ARGS       1
+#define COLORGEN_FUNC       2
+#define COLORGEN_FUNCNONE   4
+
+typedef struct {
+	uint8_t *data;
+	size_t size;
+	size_t maxSize;
+} shadercode_t;
+
+typedef struct {
+	const char *name;
+	shadercode_t *code;
+	unsigned int numpasses;
+	unsigned int numdeforms;
+	unsigned int numtcmods;
+} shadercompile_t;
+
 typedef struct {
 	const char *keyword;
-	void ( *func )( shader_t *shader, shaderpass_t *pass, const char **ptr );
+	void ( *func )( shadercompile_t *c, const char **ptr );
 } shaderkey_t;
 
+typedef struct {
+	char *filename;
+	char *buffer;
+	size_t size;
+} shaderscript_t;
+
 typedef struct shadercache_s {
 	char *name;
-	char *buffer;
-	char *filename;
+	shaderscript_t *script;
 	size_t offset;
+	const uint8_t *code;                // NULL when compiled at registration
+	size_t codeSize;
 	struct shadercache_s *hash_next;
 } shadercache_t;
 
@@ -45,6 +100,11 @@ static shader_t r_shaders[MAX_SHADERS];
 static shader_t r_shaders_hash_headnode[SHADERS_HASH_SIZE], *r_free_shaders;
 static shadercache_t *shadercache_hash[SHADERCACHE_HASH_SIZE];
 
+static mempool_t *r_shaderCachePool;
+static shaderscript_t *r_shaderScripts;
+static int r_numShaderScripts;
+static shadercode_t r_shaderCode;
+
 static deformv_t r_currentDeforms[MAX_SHADER_DEFORMVS];
 static shaderpass_t r_currentPasses[MAX_SHADER_PASSES];
 static float r_currentRGBgenArgs[MAX_SHADER_PASSES][3], r_currentAlphagenArgs[MAX_SHADER_PASSES][2];
@@ -64,8 +124,8 @@ static char *r_shaderTemplateBuf;
 static char *r_shortShaderName;
 static size_t r_shortShaderNameSize;
 
-static bool Shader_Parsetok( shader_t *shader, shaderpass_t *pass, const shaderkey_t *keys, const char *token, const char **ptr );
-static void Shader_MakeCache( const char *filename );
+static bool Shader_Parsetok( shadercompile_t *c, const shaderkey_t *keys, const char *token, const char **ptr );
+static void Shader_Compile( const char *name, const char *text, shadercode_t *code );
 static unsigned int Shader_GetCache( const char *name, shadercache_t **cache );
 
 //===========================================================================
@@ -183,6 +243,81 @@ static void Shader_SkipBlock( const char **ptr ) {
 
 //===========================================================================
 
+static void Shader_Emit( shadercode_t *code, const void *data, size_t size ) {
+	if( code->size + size > code->maxSize ) {
+		code->maxSize = max( max( code->size + size, code->maxSize * 2 ), (size_t)1024 );
+		if( !code->data ) {
+			code->data = ( uint8_t * ) R_Malloc( code->maxSize );
+		} else {
+			code->data = ( uint8_t * ) R_Realloc( code->data, code->maxSize );
+		}
+	}
+
+	memcpy( code->data + code->size, data, size );
+	code->size += size;
+}
+
+static void Shader_EmitOp( shadercode_t *code, int op ) {
+	uint8_t b = op;
+	Shader_Emit( code, &b, sizeof( b ) );
+}
+
+static void Shader_EmitInt( shadercode_t *code, int value ) {
+	Shader_Emit( code, &value, sizeof( value ) );
+}
+
+static void Shader_EmitFloat( shadercode_t *code, float value ) {
+	Shader_Emit( code, &value, sizeof( value ) );
+}
+
+static void Shader_EmitString( shadercode_t *code, const char *str ) {
+	int len = strlen( str ) + 1;
+	Shader_EmitInt( code, len );
+	Shader_Emit( code, str, len );
+}
+
+static void Shader_Read( const uint8_t **code, void *data, size_t size ) {
+	memcpy( data, *code, size );
+	*code += size;
+}
+
+static int Shader_ReadOp( const uint8_t **code ) {
+	return *( *code )++;
+}
+
+static int Shader_ReadInt( const uint8_t **code ) {
+	int value;
+	Shader_Read( code, &value, sizeof( value ) );
+	return value;
+}
+
+static float Shader_ReadFloat( const uint8_t **code ) {
+	float value;
+	Shader_Read( code, &value, sizeof( value ) );
+	return value;
+}
+
+static const char *Shader_ReadString( const uint8_t **code ) {
+	int len = Shader_ReadInt( code );
+	const char *str = ( const char * )*code;
+	*code += len;
+	return str;
+}
+
+static void Shader_CompileWarning( shadercompile_t *c, const char *format, ... ) {
+	va_list argptr;
+	char msg[1024];
+
+	va_start( argptr, format );
+	Q_vsnprintfz( msg, sizeof( msg ), format, argptr );
+	va_end( argptr );
+
+	Shader_EmitOp( c->code, SOP_WARNING );
+	Shader_EmitString( c->code, msg );
+}
+
+//===========================================================================
+
 static void Shader_ParseFunc( const char **ptr, shaderfunc_t *func ) {
 	const char *token = Shader_ParseString( ptr );
 	if( !strcmp( token, "sin" ) ) {
@@ -252,149 +387,160 @@ static image_t *Shader_FindImage( shader_t *shader, const char *name, int flags
 
 /****************** shader keyword functions ************************/
 
-static void Shader_Cull( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	shader->flags &= ~( SHADER_CULL_FRONT | SHADER_CULL_BACK );
+static void Shader_EmitFlags( shadercompile_t *c, int flags ) {
+	Shader_EmitOp( c->code, SOP_FLAGS );
+	Shader_EmitInt( c->code, flags );
+}
+
+static void Shader_Cull( shadercompile_t *c, const char **ptr ) {
+	int flags;
 
 	const char *token = Shader_ParseString( ptr );
 	if( !strcmp( token, "disable" ) || !strcmp( token, "none" ) || !strcmp( token, "twosided" ) ) {
+		flags = 0;
 	} else if( !strcmp( token, "back" ) || !strcmp( token, "backside" ) || !strcmp( token, "backsided" ) ) {
-		shader->flags |= SHADER_CULL_BACK;
+		flags = SHADER_CULL_BACK;
 	} else {
-		shader->flags |= SHADER_CULL_FRONT;
+		flags = SHADER_CULL_FRONT;
 	}
+
+	Shader_EmitOp( c->code, SOP_CULL );
+	Shader_EmitInt( c->code, flags );
 }
 
-static void Shader_Fog( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	shader->flags |= SHADER_FOG;
+static void Shader_Fog( shadercompile_t *c, const char **ptr ) {
+	Shader_EmitFlags( c, SHADER_FOG );
 }
 
-static void Shader_NoMipMaps( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	r_shaderNoMipMaps = true;
-	r_shaderMinMipSize = 1;
+static void Shader_NoMipMaps( shadercompile_t *c, const char **ptr ) {
+	Shader_EmitOp( c->code, SOP_NOMIPMAPS );
 }
 
-static void Shader_NoDrawFlat( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	shader->flags |= SHADER_NODRAWFLAT;
+static void Shader_NoDrawFlat( shadercompile_t *c, const char **ptr ) {
+	Shader_EmitFlags( c, SHADER_NODRAWFLAT );
 }
 
-static void Shader_NoFiltering( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	r_shaderNoFiltering = true;
-	shader->flags |= SHADER_NO_TEX_FILTERING;
+static void Shader_NoFiltering( shadercompile_t *c, const char **ptr ) {
+	Shader_EmitOp( c->code, SOP_NOFILTERING );
 }
 
-static void Shader_SmallestMipMapSize( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	int size = Shader_ParseInt( ptr );
-	if( !r_shaderNoMipMaps ) {
-		r_shaderMinMipSize = max( size, 1 );
-	}
+static void Shader_SmallestMipMapSize( shadercompile_t *c, const char **ptr ) {
+	Shader_EmitOp( c->code, SOP_MINMIPSIZE );
+	Shader_EmitInt( c->code, Shader_ParseInt( ptr ) );
 }
 
-static void Shader_DeformVertexes( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	char tmp[128];
-	deformv_t *deformv;
-	shaderfunc_t *func;
+static void Shader_DeformVertexes( shadercompile_t *c, const char **ptr ) {
+	char key[256], tmp[128];
+	deformv_t deformv;
+	shaderfunc_t *func = &deformv.func;
 
-	if( shader->numdeforms == MAX_SHADER_DEFORMVS ) {
-		Com_Printf( S_COLOR_YELLOW "WARNING: shader %s has too many deforms\n", shader->name );
+	if( c->numdeforms == MAX_SHADER_DEFORMVS ) {
+		Shader_CompileWarning( c, "shader %s has too many deforms", c->name );
 		Shader_SkipLine( ptr );
 		return;
 	}
 
-	deformv = &r_currentDeforms[shader->numdeforms];
-	func = &deformv->func;
+	memset( &deformv, 0, sizeof( deformv ) );
 
 	const char *token = Shader_ParseString( ptr );
-	Q_strncatz( r_shaderDeformvKey, token, sizeof( r_shaderDeformvKey ) );
+	Q_strncpyz( key, token, sizeof( key ) );
 
 	if( !strcmp( token, "wave" ) ) {
-		deformv->type = DEFORMV_WAVE;
-		deformv->args[0] = Shader_ParseFloat( ptr );
+		deformv.type = DEFORMV_WAVE;
+		deformv.args[0] = Shader_ParseFloat( ptr );
 		Shader_ParseFunc( ptr, func );
-		Q_strncatz( r_shaderDeformvKey,
+		Q_strncatz( key,
 					va_r( tmp, sizeof( tmp ), "%g%i%g%g%g%g",
-						  deformv->args[0], func->type, func->args[0], func->args[1], func->args[2], func->args[3] ),
-					sizeof( r_shaderDeformvKey ) );
-		deformv->args[0] = deformv->args[0] ? 1.0f / deformv->args[0] : 100.0f;
+						  deformv.args[0], func->type, func->args[0], func->args[1], func->args[2], func->args[3] ),
+					sizeof( key ) );
+		deformv.args[0] = deformv.args[0] ? 1.0f / deformv.args[0] : 100.0f;
 	} else if( !strcmp( token, "bulge" ) ) {
-		deformv->type = DEFORMV_BULGE;
-		Shader_ParseVector( ptr, deformv->args, 4 );
-		Q_strncatz( r_shaderDeformvKey,
+		deformv.type = DEFORMV_BULGE;
+		Shader_ParseVector( ptr, deformv.args, 4 );
+		Q_strncatz( key,
 					va_r( tmp, sizeof( tmp ), "%g%g%g%g",
-						  deformv->args[0], deformv->args[1], deformv->args[2], deformv->args[3] ),
-					sizeof( r_shaderDeformvKey ) );
+						  deformv.args[0], deformv.args[1], deformv.args[2], deformv.args[3] ),
+					sizeof( key ) );
 	} else if( !strcmp( token, "move" ) ) {
-		deformv->type = DEFORMV_MOVE;
-		Shader_ParseVector( ptr, deformv->args, 3 );
-		Shader_ParseFunc( ptr, &deformv->func );
-		Q_strncatz( r_shaderDeformvKey,
+		deformv.type = DEFORMV_MOVE;
+		Shader_ParseVector( ptr, deformv.args, 3 );
+		Shader_ParseFunc( ptr, func );
+		Q_strncatz( key,
 					va_r( tmp, sizeof( tmp ), "%g%g%g%i%g%g%g%g",
-						  deformv->args[0], deformv->args[1], deformv->args[2],
+						  deformv.args[0], deformv.args[1], deformv.args[2],
 						  func->type, func->args[0], func->args[1], func->args[2], func->args[3] ),
-					sizeof( r_shaderDeformvKey ) );
+					sizeof( key ) );
 	} else if( !strcmp( token, "autosprite" ) ) {
-		deformv->type = DEFORMV_AUTOSPRITE;
-		shader->flags |= SHADER_AUTOSPRITE;
-		r_shaderHasAutosprite = true;
+		deformv.type = DEFORMV_AUTOSPRITE;
 	} else if( !strcmp( token, "autosprite2" ) ) {
-		deformv->type = DEFORMV_AUTOSPRITE2;
-		shader->flags |= SHADER_AUTOSPRITE;
+		deformv.type = DEFORMV_AUTOSPRITE2;
 	} else if( !strcmp( token, "autoparticle" ) ) {
-		deformv->type = DEFORMV_AUTOPARTICLE;
-		shader->flags |= SHADER_AUTOSPRITE;
+		deformv.type = DEFORMV_AUTOPARTICLE;
 	} else {
+		// unknown deforms still go into the key
 		Shader_SkipLine( ptr );
-		return;
 	}
 
-	shader->numdeforms++;
+	Shader_EmitOp( c->code, SOP_DEFORM );
+	Shader_Emit( c->code, &deformv, sizeof( deformv ) );
+	Shader_EmitString( c->code, key );
+
+	if( deformv.type != DEFORMV_NONE ) {
+		c->numdeforms++;
+	}
 }
 
-static void Shader_Sort( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
+static void Shader_Sort( shadercompile_t *c, const char **ptr ) {
+	int sort;
+
 	const char *token = Shader_ParseString( ptr );
 	if( !strcmp( token, "sky" ) ) {
-		shader->sort = SHADER_SORT_SKY;
+		sort = SHADER_SORT_SKY;
 	} else if( !strcmp( token, "opaque" ) ) {
-		shader->sort = SHADER_SORT_OPAQUE;
+		sort = SHADER_SORT_OPAQUE;
 	} else if( !strcmp( token, "banner" ) ) {
-		shader->sort = SHADER_SORT_BANNER;
+		sort = SHADER_SORT_BANNER;
 	} else if( !strcmp( token, "underwater" ) ) {
-		shader->sort = SHADER_SORT_UNDERWATER;
+		sort = SHADER_SORT_UNDERWATER;
 	} else if( !strcmp( token, "additive" ) ) {
-		shader->sort = SHADER_SORT_ADDITIVE;
+		sort = SHADER_SORT_ADDITIVE;
 	} else if( !strcmp( token, "nearest" ) ) {
-		shader->sort = SHADER_SORT_NEAREST;
+		sort = SHADER_SORT_NEAREST;
 	} else {
-		shader->sort = atoi( token );
-		if( shader->sort > SHADER_SORT_NEAREST ) {
-			shader->sort = SHADER_SORT_NEAREST;
+		sort = atoi( token );
+		if( (unsigned)sort > SHADER_SORT_NEAREST ) {
+			sort = SHADER_SORT_NEAREST;
 		}
 	}
+
+	Shader_EmitOp( c->code, SOP_SORT );
+	Shader_EmitInt( c->code, sort );
 }
 
-static void Shader_PolygonOffset( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	shader->flags |= SHADER_POLYGONOFFSET;
+static void Shader_PolygonOffset( shadercompile_t *c, const char **ptr ) {
+	Shader_EmitFlags( c, SHADER_POLYGONOFFSET );
 }
 
-static void Shader_EntityMergable( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	shader->flags |= SHADER_ENTITY_MERGABLE;
+static void Shader_EntityMergable( shadercompile_t *c, const char **ptr ) {
+	Shader_EmitFlags( c, SHADER_ENTITY_MERGABLE );
 }
 
-static void Shader_GlossIntensity( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	shader->glossIntensity = Shader_ParseFloat( ptr );
-	if( shader->glossIntensity <= 0 ) {
-		shader->glossIntensity = 0;
-	}
+static void Shader_GlossIntensity( shadercompile_t *c, const char **ptr ) {
+	float intensity = Shader_ParseFloat( ptr );
+
+	Shader_EmitOp( c->code, SOP_GLOSSINTENSITY );
+	Shader_EmitFloat( c->code, intensity <= 0 ? 0 : intensity );
 }
 
-static void Shader_GlossExponent( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	shader->glossExponent = Shader_ParseFloat( ptr );
-	if( shader->glossExponent <= 0 ) {
-		shader->glossExponent = 0;
-	}
+static void Shader_GlossExponent( shadercompile_t *c, const char **ptr ) {
+	float exponent = Shader_ParseFloat( ptr );
+
+	Shader_EmitOp( c->code, SOP_GLOSSEXPONENT );
+	Shader_EmitFloat( c->code, exponent <= 0 ? 0 : exponent );
 }
 
 #define MAX_SHADER_TEMPLATE_ARGS    12
-static void Shader_Template( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
+static void Shader_Template( shadercompile_t *c, const char **ptr ) {
 	int i;
 	const char *tmpl;
 	char *buf, *out;
@@ -408,7 +554,7 @@ static void Shader_Template( shader_t *shader, shaderpass_t *pass, const char **
 
 	const char *token = Shader_ParseString( ptr );
 	if( !*token ) {
-		Com_Printf( S_COLOR_YELLOW "WARNING: missing template arguments in shader %s\n", shader->name );
+		Shader_CompileWarning( c, "missing template arguments in shader %s", c->name );
 		Shader_SkipLine( ptr );
 		return;
 	}
@@ -417,7 +563,7 @@ static void Shader_Template( shader_t *shader, shaderpass_t *pass, const char **
 	tmpl = token;
 	Shader_GetCache( tmpl, &cache );
 	if( !cache ) {
-		Com_Printf( S_COLOR_YELLOW "WARNING: shader template %s not found in cache\n", tmpl );
+		Shader_CompileWarning( c, "shader template %s not found in cache", tmpl );
 		Shader_SkipLine( ptr );
 		return;
 	}
@@ -425,14 +571,14 @@ static void Shader_Template( shader_t *shader, shaderpass_t *pass, const char **
 	// aha, found it
 
 	// find total length
-	buf = cache->buffer + cache->offset;
+	buf = cache->script->buffer + cache->offset;
 	ptr2 = buf;
 	Shader_SkipBlock( (const char **)&ptr2 );
 	length = ptr2 - buf;
 
 	// replace the following char with a EOF
-	backup = cache->buffer[ptr2 - cache->buffer];
-	cache->buffer[ptr2 - cache->buffer] = '\0';
+	backup = *ptr2;
+	*ptr2 = '\0';
 
 	// now count occurences of each argument in a template
 	ptr_backup = *ptr;
@@ -446,7 +592,7 @@ static void Shader_Template( shader_t *shader, shaderpass_t *pass, const char **
 		}
 
 		if( num_args == MAX_SHADER_TEMPLATE_ARGS ) {
-			Com_Printf( S_COLOR_YELLOW "WARNING: shader template %s has too many arguments\n", tmpl );
+			Shader_CompileWarning( c, "shader template %s has too many arguments", cache->name );
 			break;
 		}
 
@@ -508,19 +654,19 @@ static void Shader_Template( shader_t *shader, shaderpass_t *pass, const char **
 	COM_ParseExt( ptr, true );
 
 	// restore backup char
-	cache->buffer[ptr2 - cache->buffer] = backup;
+	*ptr2 = backup;
 }
 
-static void Shader_Skip( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
+static void Shader_Skip( shadercompile_t *c, const char **ptr ) {
 	Shader_SkipLine( ptr );
 }
 
-static void Shader_SoftParticle( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	shader->flags |= SHADER_SOFT_PARTICLE;
+static void Shader_SoftParticle( shadercompile_t *c, const char **ptr ) {
+	Shader_EmitFlags( c, SHADER_SOFT_PARTICLE );
 }
 
-static void Shader_ForceWorldOutlines( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	shader->flags |= SHADER_FORCE_OUTLINE_WORLD;
+static void Shader_ForceWorldOutlines( shadercompile_t *c, const char **ptr ) {
+	Shader_EmitFlags( c, SHADER_FORCE_OUTLINE_WORLD );
 }
 
 static const shaderkey_t shaderkeys[] =
@@ -571,202 +717,169 @@ static void Shaderpass_LoadMaterial( image_t **normalmap, image_t **glossmap, im
 	*decalmap = images[2];
 }
 
-static void Shaderpass_MapExt( shader_t *shader, shaderpass_t *pass, int addFlags, const char **ptr ) {
-	const char *token = Shader_ParseString( ptr );
-	int flags = Shader_SetImageFlags( shader ) | addFlags | IT_SRGB;
+static void Shaderpass_EmitFlags( shadercompile_t *c, int clear, int set ) {
+	Shader_EmitOp( c->code, POP_FLAGS );
+	Shader_EmitInt( c->code, clear );
+	Shader_EmitInt( c->code, set );
+}
 
-	pass->tcgen = TC_GEN_BASE;
-	pass->anim_fps = 0;
-	pass->images[0] = Shader_FindImage( shader, token, flags );
+static void Shaderpass_EmitColorgen( shadercompile_t *c, int op, int type, int set, const float *args, const shaderfunc_t *func ) {
+	Shader_EmitOp( c->code, op );
+	Shader_EmitInt( c->code, type );
+	Shader_EmitInt( c->code, set );
+	Shader_Emit( c->code, args, sizeof( float ) * 3 );
+	Shader_Emit( c->code, func, sizeof( *func ) );
 }
 
-static void Shaderpass_AnimMapExt( shader_t *shader, shaderpass_t *pass, int addFlags, const char **ptr ) {
-	int flags = Shader_SetImageFlags( shader ) | addFlags | IT_SRGB;
+static void Shaderpass_MapExt( shadercompile_t *c, int addFlags, const char **ptr ) {
+	Shader_EmitOp( c->code, POP_MAP );
+	Shader_EmitInt( c->code, addFlags );
+	Shader_EmitString( c->code, Shader_ParseString( ptr ) );
+}
 
-	pass->tcgen = TC_GEN_BASE;
-	pass->anim_fps = Shader_ParseFloat( ptr );
-	pass->anim_numframes = 0;
+static void Shaderpass_AnimMapExt( shadercompile_t *c, int addFlags, const char **ptr ) {
+	int numframes = 0;
+
+	Shader_EmitOp( c->code, POP_ANIMMAP );
+	Shader_EmitInt( c->code, addFlags );
+	Shader_EmitFloat( c->code, Shader_ParseFloat( ptr ) );
 
 	for( ;; ) {
 		const char *token = Shader_ParseString( ptr );
 		if( !token[0] ) {
 			break;
 		}
-		if( pass->anim_numframes < MAX_SHADER_IMAGES ) {
-			pass->images[pass->anim_numframes++] = Shader_FindImage( shader, token, flags );
+		if( numframes < MAX_SHADER_IMAGES ) {
+			Shader_EmitString( c->code, token );
+			numframes++;
 		}
 	}
 
-	if( pass->anim_numframes == 0 ) {
-		pass->anim_fps = 0;
-	}
+	Shader_EmitString( c->code, "" );
 }
 
-static void Shaderpass_Map( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	Shaderpass_MapExt( shader, pass, 0, ptr );
+static void Shaderpass_Map( shadercompile_t *c, const char **ptr ) {
+	Shaderpass_MapExt( c, 0, ptr );
 }
 
-static void Shaderpass_ClampMap( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	Shaderpass_MapExt( shader, pass, IT_CLAMP, ptr );
+static void Shaderpass_ClampMap( shadercompile_t *c, const char **ptr ) {
+	Shaderpass_MapExt( c, IT_CLAMP, ptr );
 }
 
-static void Shaderpass_AnimMap( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	Shaderpass_AnimMapExt( shader, pass, 0, ptr );
+static void Shaderpass_AnimMap( shadercompile_t *c, const char **ptr ) {
+	Shaderpass_AnimMapExt( c, 0, ptr );
 }
 
-static void Shaderpass_AlphaMaskClampMap( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	Shaderpass_MapExt( shader, pass, IT_CLAMP | IT_ALPHAMASK, ptr );
+static void Shaderpass_AlphaMaskClampMap( shadercompile_t *c, const char **ptr ) {
+	Shaderpass_MapExt( c, IT_CLAMP | IT_ALPHAMASK, ptr );
 }
 
-static void Shaderpass_AnimClampMap( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	Shaderpass_AnimMapExt( shader, pass, IT_CLAMP, ptr );
+static void Shaderpass_AnimClampMap( shadercompile_t *c, const char **ptr ) {
+	Shaderpass_AnimMapExt( c, IT_CLAMP, ptr );
 }
 
-static void Shaderpass_Material( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	int i, flags;
-	bool endl;
-
-	flags = Shader_SetImageFlags( shader );
+static void Shaderpass_Material( shadercompile_t *c, const char **ptr ) {
 	const char *token = Shader_ParseString( ptr );
+	bool endl = token[0] == '\0';
 
-	endl = token[0] == '\0';
-	if( endl ) {
-		// single-word syntax
-		token = shader->name;
-	}
-
-	pass->images[0] = Shader_FindImage( shader, token, flags | IT_SRGB );
-	if( !pass->images[0] ) {
-		ri.Com_DPrintf( S_COLOR_YELLOW "WARNING: failed to load base/diffuse image for material %s in shader %s.\n", token, shader->name );
-		return;
-	}
-
-	pass->images[1] = pass->images[2] = pass->images[3] = NULL;
-
-	pass->tcgen = TC_GEN_BASE;
-	if( pass->rgbgen.type == RGB_GEN_UNKNOWN ) {
-		pass->rgbgen.type = RGB_GEN_IDENTITY;
-	}
+	// an empty diffuse name is the single-word syntax
+	Shader_EmitOp( c->code, POP_MATERIAL );
+	Shader_EmitString( c->code, token );
 
 	while( !endl ) {
 		token = Shader_ParseString( ptr );
 		if( !*token ) {
 			break;
 		}
-
 		if( Q_isdigit( token ) ) {
 			continue;
-		} else if( !pass->images[1] ) {
-			image_t *normalmap;
-			normalmap = Shader_FindImage( shader, token, flags | IT_NORMALMAP );
-			pass->program_type = GLSL_PROGRAM_TYPE_MATERIAL;
-			pass->images[1] = normalmap;
-		} else if( !pass->images[2] ) {
-			if( strcmp( token, "-" ) && r_lighting_specular->integer ) {
-				pass->images[2] = Shader_FindImage( shader, token, flags );
-			} else {
-				// set gloss to rsh.blackTexture so we know we have already parsed the gloss image
-				pass->images[2] = rsh.blackTexture;
-			}
-		} else {
-			// parse decal images
-			for( i = 3; i < 5; i++ ) {
-				if( pass->images[i] ) {
-					continue;
-				}
-
-				if( strcmp( token, "-" ) ) {
-					pass->images[i] = Shader_FindImage( shader, token, flags | IT_SRGB );
-				} else {
-					pass->images[i] = rsh.whiteTexture;
-				}
-				break;
-			}
-		}
-	}
-
-	// black texture => no gloss, so don't waste time in the GLSL program
-	if( pass->images[2] == rsh.blackTexture ) {
-		pass->images[2] = NULL;
-	}
-
-	for( i = 3; i < 5; i++ ) {
-		if( pass->images[i] == rsh.whiteTexture ) {
-			pass->images[i] = NULL;
 		}
+		Shader_EmitString( c->code, token );
 	}
 
-	if( pass->images[1] ) {
-		return;
-	}
-
-	// load default images
-	pass->program_type = GLSL_PROGRAM_TYPE_MATERIAL;
-	Shaderpass_LoadMaterial( &pass->images[1], &pass->images[2], &pass->images[3],
-							 pass->images[0]->name, flags, shader->imagetags );
+	Shader_EmitString( c->code, "" );
 }
 
-static void Shaderpass_RGBGen( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	bool wave = false;
+static void Shaderpass_RGBGen( shadercompile_t *c, const char **ptr ) {
+	int type, set = 0;
+	float args[3] = { 0, 0, 0 };
+	shaderfunc_t func;
+
+	memset( &func, 0, sizeof( func ) );
 
 	const char *token = Shader_ParseString( ptr );
 	if( !strcmp( token, "identitylighting" ) ) {
-		pass->rgbgen.type = RGB_GEN_IDENTITY;
+		type = RGB_GEN_IDENTITY;
 	} else if( !strcmp( token, "identity" ) ) {
-		pass->rgbgen.type = RGB_GEN_IDENTITY;
+		type = RGB_GEN_IDENTITY;
 	} else if( !strcmp( token, "wave" ) ) {
-		pass->rgbgen.type = RGB_GEN_WAVE;
-		pass->rgbgen.args[0] = 1.0f;
-		pass->rgbgen.args[1] = 1.0f;
-		pass->rgbgen.args[2] = 1.0f;
-		Shader_ParseFunc( ptr, &pass->rgbgen.func );
-	} else if( ( wave = !strcmp( token, "colorwave" ) ? true : false ) ) {
-		pass->rgbgen.type = RGB_GEN_WAVE;
-		Shader_ParseVector( ptr, pass->rgbgen.args, 3 );
-		Shader_ParseFunc( ptr, &pass->rgbgen.func );
-	} else if( !strcmp( token, "entity" ) || ( wave = !strcmp( token, "entitycolorwave" ) ? true : false ) ) {
-		pass->rgbgen.type = RGB_GEN_ENTITYWAVE;
-		pass->rgbgen.func.type = SHADER_FUNC_NONE;
-		if( wave ) {
-			Shader_ParseVector( ptr, pass->rgbgen.args, 3 );
-			Shader_ParseFunc( ptr, &pass->rgbgen.func );
-		}
+		type = RGB_GEN_WAVE;
+		args[0] = 1.0f;
+		args[1] = 1.0f;
+		args[2] = 1.0f;
+		Shader_ParseFunc( ptr, &func );
+		set = COLORGEN_ARGS | COLORGEN_FUNC;
+	} else if( !strcmp( token, "colorwave" ) ) {
+		type = RGB_GEN_WAVE;
+		Shader_ParseVector( ptr, args, 3 );
+		Shader_ParseFunc( ptr, &func );
+		set = COLORGEN_ARGS | COLORGEN_FUNC;
+	} else if( !strcmp( token, "entity" ) ) {
+		type = RGB_GEN_ENTITYWAVE;
+		set = COLORGEN_FUNCNONE;
+	} else if( !strcmp( token, "entitycolorwave" ) ) {
+		type = RGB_GEN_ENTITYWAVE;
+		Shader_ParseVector( ptr, args, 3 );
+		Shader_ParseFunc( ptr, &func );
+		set = COLORGEN_ARGS | COLORGEN_FUNC;
 	} else if( !strcmp( token, "oneminusentity" ) ) {
-		pass->rgbgen.type = RGB_GEN_ONE_MINUS_ENTITY;
+		type = RGB_GEN_ONE_MINUS_ENTITY;
 	} else if( !strcmp( token, "vertex" ) ) {
-		pass->rgbgen.type = RGB_GEN_VERTEX;
+		type = RGB_GEN_VERTEX;
 	} else if( !strcmp( token, "lightingdiffuse" ) ) {
-		if( shader->type < SHADER_TYPE_DIFFUSE ) {
-			pass->rgbgen.type = RGB_GEN_VERTEX;
-		} else if( shader->type > SHADER_TYPE_DIFFUSE ) {
-			pass->rgbgen.type = RGB_GEN_IDENTITY;
-		} else {
-			pass->rgbgen.type = RGB_GEN_LIGHTING_DIFFUSE;
-		}
+		// depends on the shader type, resolved at registration
+		type = RGB_GEN_LIGHTING_DIFFUSE;
 	} else if( !strcmp( token, "exactvertex" ) ) {
-		pass->rgbgen.type = RGB_GEN_EXACT_VERTEX;
+		type = RGB_GEN_EXACT_VERTEX;
 	} else if( !strcmp( token, "const" ) || !strcmp( token, "constant" ) ) {
 		vec3_t color;
 
-		pass->rgbgen.type = RGB_GEN_CONST;
+		type = RGB_GEN_CONST;
 		Shader_ParseVector( ptr, color, 3 );
-		ColorNormalize( color, pass->rgbgen.args );
+		ColorNormalize( color, args );
+		set = COLORGEN_ARGS;
+	} else {
+		return;
 	}
+
+	Shaderpass_EmitColorgen( c, POP_RGBGEN, type, set, args, &func );
 }
 
-static void Shaderpass_AlphaGen( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
+static void Shaderpass_AlphaGen( shadercompile_t *c, const char **ptr ) {
+	int type, set = 0;
+	float args[3] = { 0, 0, 0 };
+	shaderfunc_t func;
+
+	memset( &func, 0, sizeof( func ) );
+
 	const char *token = Shader_ParseString( ptr );
 	if( !strcmp( token, "vertex" ) ) {
-		pass->alphagen.type = ALPHA_GEN_VERTEX;
+		type = ALPHA_GEN_VERTEX;
 	} else if( !strcmp( token, "entity" ) ) {
-		pass->alphagen.type = ALPHA_GEN_ENTITY;
+		type = ALPHA_GEN_ENTITY;
 	} else if( !strcmp( token, "wave" ) ) {
-		pass->alphagen.type = ALPHA_GEN_WAVE;
-		Shader_ParseFunc( ptr, &pass->alphagen.func );
+		type = ALPHA_GEN_WAVE;
+		Shader_ParseFunc( ptr, &func );
+		set = COLORGEN_FUNC;
 	} else if( !strcmp( token, "const" ) || !strcmp( token, "constant" ) ) {
-		pass->alphagen.type = ALPHA_GEN_CONST;
-		pass->alphagen.args[0] = fabs( Shader_ParseFloat( ptr ) );
+		type = ALPHA_GEN_CONST;
+		args[0] = fabs( Shader_ParseFloat( ptr ) );
+		set = COLORGEN_ARGS;
+	} else {
+		return;
 	}
+
+	Shaderpass_EmitColorgen( c, POP_ALPHAGEN, type, set, args, &func );
 }
 
 static inline int Shaderpass_SrcBlendBits( const char *token ) {
@@ -825,125 +938,143 @@ static inline int Shaderpass_DstBlendBits( const char *token ) {
 	return GLSTATE_DSTBLEND_ONE;
 }
 
-static void Shaderpass_BlendFunc( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	const char *token = Shader_ParseString( ptr );
+static void Shaderpass_BlendFunc( shadercompile_t *c, const char **ptr ) {
+	int bits;
 
-	pass->flags &= ~GLSTATE_BLEND_MASK;
+	const char *token = Shader_ParseString( ptr );
 	if( !strcmp( token, "blend" ) ) {
-		pass->flags |= GLSTATE_SRCBLEND_SRC_ALPHA | GLSTATE_DSTBLEND_ONE_MINUS_SRC_ALPHA;
+		bits = GLSTATE_SRCBLEND_SRC_ALPHA | GLSTATE_DSTBLEND_ONE_MINUS_SRC_ALPHA;
 	} else if( !strcmp( token, "filter" ) ) {
-		pass->flags |= GLSTATE_SRCBLEND_DST_COLOR | GLSTATE_DSTBLEND_ZERO;
+		bits = GLSTATE_SRCBLEND_DST_COLOR | GLSTATE_DSTBLEND_ZERO;
 	} else if( !strcmp( token, "add" ) ) {
-		pass->flags |= GLSTATE_SRCBLEND_ONE | GLSTATE_DSTBLEND_ONE;
+		bits = GLSTATE_SRCBLEND_ONE | GLSTATE_DSTBLEND_ONE;
 	} else {
-		pass->flags |= Shaderpass_SrcBlendBits( token );
-		pass->flags |= Shaderpass_DstBlendBits( Shader_ParseString( ptr ) );
+		bits = Shaderpass_SrcBlendBits( token );
+		bits |= Shaderpass_DstBlendBits( Shader_ParseString( ptr ) );
 	}
+
+	Shaderpass_EmitFlags( c, GLSTATE_BLEND_MASK, bits );
 }
 
-static void Shaderpass_AlphaFunc( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	const char *token = Shader_ParseString( ptr );
+static void Shaderpass_AlphaFunc( shadercompile_t *c, const char **ptr ) {
+	int bits = 0;
 
-	pass->flags &= ~( SHADERPASS_ALPHAFUNC | GLSTATE_ALPHATEST );
+	const char *token = Shader_ParseString( ptr );
 	if( !strcmp( token, "gt0" ) ) {
-		pass->flags |= SHADERPASS_AFUNC_GT0;
+		bits = SHADERPASS_AFUNC_GT0;
 	} else if( !strcmp( token, "lt128" ) ) {
-		pass->flags |= SHADERPASS_AFUNC_LT128;
+		bits = SHADERPASS_AFUNC_LT128;
 	} else if( !strcmp( token, "ge128" ) ) {
-		pass->flags |= SHADERPASS_AFUNC_GE128;
+		bits = SHADERPASS_AFUNC_GE128;
 	}
 
-	if( pass->flags & SHADERPASS_ALPHAFUNC ) {
-		pass->flags |= GLSTATE_ALPHATEST;
+	if( bits & SHADERPASS_ALPHAFUNC ) {
+		bits |= GLSTATE_ALPHATEST;
 	}
+
+	Shaderpass_EmitFlags( c, SHADERPASS_ALPHAFUNC | GLSTATE_ALPHATEST, bits );
 }
 
-static void Shaderpass_DepthFunc( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	const char *token = Shader_ParseString( ptr );
+static void Shaderpass_DepthFunc( shadercompile_t *c, const char **ptr ) {
+	int bits = 0;
 
-	pass->flags &= ~(GLSTATE_DEPTHFUNC_EQ|GLSTATE_DEPTHFUNC_GT);
+	const char *token = Shader_ParseString( ptr );
 	if( !strcmp( token, "equal" ) ) {
-		pass->flags |= GLSTATE_DEPTHFUNC_EQ;
+		bits = GLSTATE_DEPTHFUNC_EQ;
 	} else if( !strcmp( token, "greater" ) ) {
-		pass->flags |= GLSTATE_DEPTHFUNC_GT;
+		bits = GLSTATE_DEPTHFUNC_GT;
 	}
+
+	Shaderpass_EmitFlags( c, GLSTATE_DEPTHFUNC_EQ | GLSTATE_DEPTHFUNC_GT, bits );
 }
 
-static void Shaderpass_DepthWrite( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	pass->flags |= GLSTATE_DEPTHWRITE;
+static void Shaderpass_DepthWrite( shadercompile_t *c, const char **ptr ) {
+	Shaderpass_EmitFlags( c, 0, GLSTATE_DEPTHWRITE );
 }
 
-static void Shaderpass_TcMod( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
+static void Shaderpass_TcMod( shadercompile_t *c, const char **ptr ) {
 	int i;
-	tcmod_t *tcmod;
+	tcmod_t tcmod;
 
-	if( pass->numtcmods == MAX_SHADER_TCMODS ) {
-		Com_Printf( S_COLOR_YELLOW "WARNING: shader %s has too many tcmods\n", shader->name );
+	if( c->numtcmods == MAX_SHADER_TCMODS ) {
+		Shader_CompileWarning( c, "shader %s has too many tcmods", c->name );
 		Shader_SkipLine( ptr );
 		return;
 	}
 
-	tcmod = &pass->tcmods[pass->numtcmods];
+	memset( &tcmod, 0, sizeof( tcmod ) );
 
 	const char *token = Shader_ParseString( ptr );
 	if( !strcmp( token, "rotate" ) ) {
-		tcmod->args[0] = -Shader_ParseFloat( ptr ) / 360.0f;
-		if( !tcmod->args[0] ) {
+		tcmod.args[0] = -Shader_ParseFloat( ptr ) / 360.0f;
+		if( !tcmod.args[0] ) {
 			return;
 		}
-		tcmod->type = TC_MOD_ROTATE;
+		tcmod.type = TC_MOD_ROTATE;
 	} else if( !strcmp( token, "scale" ) ) {
-		Shader_ParseVector( ptr, tcmod->args, 2 );
-		tcmod->type = TC_MOD_SCALE;
+		Shader_ParseVector( ptr, tcmod.args, 2 );
+		tcmod.type = TC_MOD_SCALE;
 	} else if( !strcmp( token, "scroll" ) ) {
-		Shader_ParseVector( ptr, tcmod->args, 2 );
-		tcmod->type = TC_MOD_SCROLL;
+		Shader_ParseVector( ptr, tcmod.args, 2 );
+		tcmod.type = TC_MOD_SCROLL;
 	} else if( !strcmp( token, "stretch" ) ) {
 		shaderfunc_t func;
 
+		memset( &func, 0, sizeof( func ) );
 		Shader_ParseFunc( ptr, &func );
 
-		tcmod->args[0] = func.type;
+		tcmod.args[0] = func.type;
 		for( i = 1; i < 5; i++ )
-			tcmod->args[i] = func.args[i - 1];
-		tcmod->type = TC_MOD_STRETCH;
+			tcmod.args[i] = func.args[i - 1];
+		tcmod.type = TC_MOD_STRETCH;
 	} else if( !strcmp( token, "transform" ) ) {
-		Shader_ParseVector( ptr, tcmod->args, 6 );
-		//tcmod->args[4] = tcmod->args[4] - floor( tcmod->args[4] );
-		//tcmod->args[5] = tcmod->args[5] - floor( tcmod->args[5] );
-		tcmod->type = TC_MOD_TRANSFORM;
+		Shader_ParseVector( ptr, tcmod.args, 6 );
+		//tcmod.args[4] = tcmod.args[4] - floor( tcmod.args[4] );
+		//tcmod.args[5] = tcmod.args[5] - floor( tcmod.args[5] );
+		tcmod.type = TC_MOD_TRANSFORM;
 	} else if( !strcmp( token, "turb" ) ) {
-		Shader_ParseVector( ptr, tcmod->args, 4 );
-		tcmod->type = TC_MOD_TURB;
+		Shader_ParseVector( ptr, tcmod.args, 4 );
+		tcmod.type = TC_MOD_TURB;
 	} else {
 		Shader_SkipLine( ptr );
 		return;
 	}
 
-	r_currentPasses[shader->numpasses].numtcmods++;
+	Shader_EmitOp( c->code, POP_TCMOD );
+	Shader_Emit( c->code, &tcmod, sizeof( tcmod ) );
+	c->numtcmods++;
 }
 
-static void Shaderpass_TcGen( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
+static void Shaderpass_TcGen( shadercompile_t *c, const char **ptr ) {
+	int tcgen;
+	float vec[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
 	const char *token = Shader_ParseString( ptr );
 	if( !strcmp( token, "base" ) ) {
-		pass->tcgen = TC_GEN_BASE;
+		tcgen = TC_GEN_BASE;
 	} else if( !strcmp( token, "environment" ) ) {
-		pass->tcgen = TC_GEN_ENVIRONMENT;
+		tcgen = TC_GEN_ENVIRONMENT;
 	} else if( !strcmp( token, "vector" ) ) {
-		pass->tcgen = TC_GEN_VECTOR;
-		Shader_ParseVector( ptr, &pass->tcgenVec[0], 4 );
-		Shader_ParseVector( ptr, &pass->tcgenVec[4], 4 );
+		tcgen = TC_GEN_VECTOR;
+		Shader_ParseVector( ptr, &vec[0], 4 );
+		Shader_ParseVector( ptr, &vec[4], 4 );
+	} else {
+		return;
 	}
+
+	Shader_EmitOp( c->code, POP_TCGEN );
+	Shader_EmitInt( c->code, tcgen );
+	Shader_Emit( c->code, vec, sizeof( vec ) );
 }
 
-static void Shaderpass_Detail( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	pass->flags |= SHADERPASS_DETAIL;
+static void Shaderpass_Detail( shadercompile_t *c, const char **ptr ) {
+	Shaderpass_EmitFlags( c, 0, SHADERPASS_DETAIL );
 }
-static void Shaderpass_Greyscale( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
-	pass->flags |= SHADERPASS_GREYSCALE;
+static void Shaderpass_Greyscale( shadercompile_t *c, const char **ptr ) {
+	Shaderpass_EmitFlags( c, 0, SHADERPASS_GREYSCALE );
 }
 
-static void Shaderpass_Skip( shader_t *shader, shaderpass_t *pass, const char **ptr ) {
+static void Shaderpass_Skip( shadercompile_t *c, const char **ptr ) {
 	Shader_SkipLine( ptr );
 }
 
@@ -1016,30 +1147,29 @@ void R_PrintShaderCache( const char *name ) {
 		return;
 	}
 
-	start = cache->buffer + cache->offset;
+	start = cache->script->buffer + cache->offset;
 
 	// temporarily hack in the zero-char
 	ptr = start;
 	Shader_SkipBlock( &ptr );
-	backup = cache->buffer[ptr - cache->buffer];
-	cache->buffer[ptr - cache->buffer] = '\0';
+	backup = cache->script->buffer[ptr - cache->script->buffer];
+	cache->script->buffer[ptr - cache->script->buffer] = '\0';
 
-	Com_Printf( "Found in %s:\n\n", cache->filename );
+	Com_Printf( "Found in %s:\n\n", cache->script->filename );
 	Com_Printf( S_COLOR_YELLOW "%s%s\n", name, start );
 
-	cache->buffer[ptr - cache->buffer] = backup;
+	cache->script->buffer[ptr - cache->script->buffer] = backup;
 }
 
-static void Shader_MakeCache( const char *filename ) {
+/*
+* Shader_LoadScript
+*/
+static void Shader_LoadScript( const char *filename ) {
 	int size;
-	unsigned int key;
 	char *pathName = NULL;
 	size_t pathNameSize;
-	char *token, *buf, *temp = NULL;
-	const char *ptr;
-	shadercache_t *cache;
-	uint8_t *cacheMemBuf;
-	size_t cacheMemSize;
+	char *temp = NULL;
+	shaderscript_t *script;
 
 	pathNameSize = strlen( "scripts/" ) + strlen( filename ) + 1;
 	pathName = ( char * ) R_Malloc( pathNameSize );
@@ -1056,10 +1186,37 @@ static void Shader_MakeCache( const char *filename ) {
 		goto done;
 	}
 
-	buf = ( char * ) R_Malloc( size + 1 );
-	strcpy( buf, temp );
-	R_FreeFile( temp );
-	temp = NULL;
+	if( !( r_numShaderScripts & 63 ) ) {
+		size_t scriptsSize = ( r_numShaderScripts + 64 ) * sizeof( shaderscript_t );
+		if( !r_shaderScripts ) {
+			r_shaderScripts = ( shaderscript_t * ) R_MallocExt( r_shaderCachePool, scriptsSize, 0, 1 );
+		} else {
+			r_shaderScripts = ( shaderscript_t * ) R_Realloc( r_shaderScripts, scriptsSize );
+		}
+	}
+
+	script = &r_shaderScripts[r_numShaderScripts++];
+	script->filename = ( char * ) R_MallocExt( r_shaderCachePool, strlen( filename ) + 1, 0, 0 );
+	strcpy( script->filename, filename );
+	script->buffer = ( char * ) R_MallocExt( r_shaderCachePool, size + 1, 0, 0 );
+	strcpy( script->buffer, temp );
+	script->size = size;
+
+done:
+	if( temp ) {
+		R_FreeFile( temp );
+	}
+	R_Free( pathName );
+}
+
+static void Shader_MakeCache( shaderscript_t *script ) {
+	unsigned int key;
+	char *token;
+	const char *ptr;
+	shadercache_t *cache;
+	uint8_t *cacheMemBuf;
+	size_t cacheMemSize;
+	char *buf = script->buffer;
 
 	// calculate buffer size to allocate our cache objects all at once (we may leak
 	// insignificantly here because of duplicate entries)
@@ -1074,12 +1231,10 @@ static void Shader_MakeCache( const char *filename ) {
 	}
 
 	if( !cacheMemSize ) {
-		R_Free( buf );
-		goto done;
+		return;
 	}
 
-	cacheMemBuf = ( uint8_t * ) R_Malloc( cacheMemSize );
-	memset( cacheMemBuf, 0, cacheMemSize );
+	cacheMemBuf = ( uint8_t * ) R_MallocExt( r_shaderCachePool, cacheMemSize, 0, 1 );
 	for( ptr = buf; ptr; ) {
 		token = COM_ParseExt( &ptr, true );
 		if( !token[0] ) {
@@ -1095,26 +1250,15 @@ static void Shader_MakeCache( const char *filename ) {
 		cache = ( shadercache_t * )cacheMemBuf; cacheMemBuf += sizeof( shadercache_t ) + strlen( token ) + 1;
 		cache->hash_next = shadercache_hash[key];
 		cache->name = ( char * )( (uint8_t *)cache + sizeof( shadercache_t ) );
-		cache->filename = NULL;
 		strcpy( cache->name, token );
 		shadercache_hash[key] = cache;
 
 set_path_and_offset:
-		if( cache->filename ) {
-			R_Free( cache->filename );
-		}
-		cache->filename = R_CopyString( filename );
-		cache->buffer = buf;
+		cache->script = script;
 		cache->offset = ptr - buf;
 
 		Shader_SkipBlock( &ptr );
 	}
-
-done:
-	if( temp ) {
-		R_FreeFile( temp );
-	}
-	R_Free( pathName );
 }
 
 /*
@@ -1138,64 +1282,285 @@ static unsigned int Shader_GetCache( const char *name, shadercache_t **cache ) {
 }
 
 /*
-* R_PrecacheShaders
+* Shader_ScriptsHash
+*
+* The binary cache is only valid for the exact scripts it was compiled from
 */
-static void R_InitShadersCache( void ) {
-	int d;
-	int i, j, k, numfiles;
-	int numfiles_total;
-	const char *fileptr;
-	char shaderPaths[1024];
-	const char *dirs[3] = { "<scripts", ">scripts", "scripts" };
+static uint64_t Shader_ScriptsHash( void ) {
+	int i;
+	uint64_t hash = Hash64( APPLICATION );
 
-	r_shaderTemplateBuf = NULL;
+	for( i = 0; i < r_numShaderScripts; i++ ) {
+		hash = Hash64( r_shaderScripts[i].filename, strlen( r_shaderScripts[i].filename ) + 1, hash );
+		hash = Hash64( r_shaderScripts[i].buffer, r_shaderScripts[i].size, hash );
+	}
 
-	memset( shadercache_hash, 0, sizeof( shadercache_t * ) * SHADERCACHE_HASH_SIZE );
+	return hash;
+}
 
-	Com_Printf( "Initializing Shaders:\n" );
+static void Shader_CompileCache( void ) {
+	int i;
+	shadercache_t *cache;
 
-	numfiles_total = 0;
-	for( d = 0; d < 3; d++ ) {
-		if( d == 2 ) {
-			// this is a fallback case for older bins that do not support the '<>' prefixes
-			// since we got some files, the binary is sufficiently up to date
-			if( numfiles_total ) {
-				break;
+	for( i = 0; i < SHADERCACHE_HASH_SIZE; i++ ) {
+		for( cache = shadercache_hash[i]; cache; cache = cache->hash_next ) {
+			Shader_Compile( cache->name, cache->script->buffer + cache->offset, &r_shaderCode );
+			if( !r_shaderCode.size ) {
+				continue;
 			}
+
+			cache->code = ( uint8_t * ) R_MallocExt( r_shaderCachePool, r_shaderCode.size, 0, 0 );
+			cache->codeSize = r_shaderCode.size;
+			memcpy( ( uint8_t * )cache->code, r_shaderCode.data, r_shaderCode.size );
 		}
+	}
+}
 
-		// enumerate shaders
-		numfiles = ri.FS_GetFileList( dirs[d], ".shader", NULL, 0, 0, 0 );
-		numfiles_total += numfiles;
+/*
+* Shader_StoreCache
+*
+* Writes the compiled shaders as the script they came from, their offset in
+* it and their code, after a header with the version and the script hash
+*/
+static void Shader_StoreCache( uint64_t scriptsHash ) {
+	int i, handle;
+	int version = SHADERCACHE_VERSION;
+	int numEntries = 0;
+	shadercache_t *cache;
+	shadercode_t data;
 
-		// now load them all
-		for( i = 0; i < numfiles; i += k ) {
-			if( ( k = ri.FS_GetFileList( dirs[d], ".shader", shaderPaths, sizeof( shaderPaths ), i, numfiles ) ) == 0 ) {
-				k = 1; // advance by one file
-				continue;
-			}
+	memset( &data, 0, sizeof( data ) );
 
-			fileptr = shaderPaths;
-			for( j = 0; j < k; j++ ) {
-				Shader_MakeCache( fileptr );
+	for( i = 0; i < SHADERCACHE_HASH_SIZE; i++ ) {
+		for( cache = shadercache_hash[i]; cache; cache = cache->hash_next ) {
+			numEntries++;
+		}
+	}
 
-				fileptr += strlen( fileptr ) + 1;
-				if( !*fileptr ) {
-					break;
-				}
-			}
+	Shader_EmitInt( &data, numEntries );
+	for( i = 0; i < SHADERCACHE_HASH_SIZE; i++ ) {
+		for( cache = shadercache_hash[i]; cache; cache = cache->hash_next ) {
+			Shader_EmitString( &data, cache->name );
+			Shader_EmitInt( &data, cache->script - r_shaderScripts );
+			Shader_EmitInt( &data, cache->offset );
+			Shader_EmitInt( &data, cache->codeSize );
+			Shader_Emit( &data, cache->code, cache->codeSize );
 		}
 	}
 
-	if( !numfiles_total ) {
-		ri.Com_Error( ERR_DROP, "Could not find any shaders!" );
+	if( ri.FS_FOpenFile( SHADERCACHE_FILE_NAME, &handle, FS_WRITE | FS_CACHE ) == -1 ) {
+		Com_Printf( S_COLOR_YELLOW "Could not open %s for writing.\n", SHADERCACHE_FILE_NAME );
+	} else {
+		int dataSize = data.size;
+		uint64_t dataHash = Hash64( data.data, data.size );
+
+		ri.FS_Write( &version, sizeof( version ), handle );
+		ri.FS_Write( &scriptsHash, sizeof( scriptsHash ), handle );
+		ri.FS_Write( &dataSize, sizeof( dataSize ), handle );
+		ri.FS_Write( &dataHash, sizeof( dataHash ), handle );
+		ri.FS_Write( data.data, data.size, handle );
+		ri.FS_FCloseFile( handle );
 	}
 
-	Com_Printf( "--------------------------------------\n" );
+	R_Free( data.data );
 }
 
-/*
-* R_InitShaders
+static const void *Shader_ReadCacheData( const uint8_t **data, const uint8_t *end, size_t size ) {
+	const uint8_t *p = *data;
+
+	if( size > (size_t)( end - p ) ) {
+		return NULL;
+	}
+	*data = p + size;
+	return p;
+}
+
+static bool Shader_ReadCacheInt( const uint8_t **data, const uint8_t *end, int *value ) {
+	const void *p = Shader_ReadCacheData( data, end, sizeof( *value ) );
+	if( !p ) {
+		return false;
+	}
+	memcpy( value, p, sizeof( *value ) );
+	return true;
+}
+
+/*
+* Shader_LoadCache
+*
+* Links the shaders in the binary cache in place of indexing the scripts,
+* returns false if there is no cache for these scripts
+*/
+static bool Shader_LoadCache( uint64_t scriptsHash ) {
+	int i, handle;
+	int version, dataSize, numEntries;
+	uint64_t hash, dataHash;
+	uint8_t *data;
+	const uint8_t *p, *end;
+	shadercache_t *entries;
+
+	if( ri.FS_FOpenFile( SHADERCACHE_FILE_NAME, &handle, FS_READ | FS_CACHE ) == -1 ) {
+		return false;
+	}
+
+	if( ri.FS_Read( &version, sizeof( version ), handle ) != sizeof( version ) ||
+		ri.FS_Read( &hash, sizeof( hash ), handle ) != sizeof( hash ) ||
+		ri.FS_Read( &dataSize, sizeof( dataSize ), handle ) != sizeof( dataSize ) ||
+		ri.FS_Read( &dataHash, sizeof( dataHash ), handle ) != sizeof( dataHash ) ) {
+		ri.FS_FCloseFile( handle );
+		return false;
+	}
+
+	if( version != SHADERCACHE_VERSION ) {
+		ri.Com_DPrintf( "Ignoring shader cache: found version %i, expected %i\n", version, SHADERCACHE_VERSION );
+		ri.FS_FCloseFile( handle );
+		return false;
+	}
+	if( hash != scriptsHash ) {
+		ri.Com_DPrintf( "Ignoring shader cache: the shader scripts have changed\n" );
+		ri.FS_FCloseFile( handle );
+		return false;
+	}
+
+	data = ( uint8_t * ) R_MallocExt( r_shaderCachePool, max( dataSize, 1 ), 0, 0 );
+	if( dataSize <= 0 || ri.FS_Read( data, dataSize, handle ) != dataSize || Hash64( data, dataSize ) != dataHash ) {
+		ri.Com_DPrintf( "Ignoring shader cache: the file is corrupt\n" );
+		ri.FS_FCloseFile( handle );
+		return false;
+	}
+	ri.FS_FCloseFile( handle );
+
+	p = data;
+	end = data + dataSize;
+	if( !Shader_ReadCacheInt( &p, end, &numEntries ) || numEntries <= 0 ) {
+		return false;
+	}
+
+	entries = ( shadercache_t * ) R_MallocExt( r_shaderCachePool, numEntries * sizeof( shadercache_t ), 0, 1 );
+	for( i = 0; i < numEntries; i++ ) {
+		shadercache_t *cache = &entries[i];
+		int nameLength, scriptNum, offset, codeSize;
+		unsigned int key;
+
+		if( !Shader_ReadCacheInt( &p, end, &nameLength ) || nameLength <= 1 ) {
+			break;
+		}
+		cache->name = ( char * )Shader_ReadCacheData( &p, end, nameLength );
+		if( !cache->name || cache->name[nameLength - 1] != '\0' ) {
+			break;
+		}
+
+		if( !Shader_ReadCacheInt( &p, end, &scriptNum ) || !Shader_ReadCacheInt( &p, end, &offset ) ||
+			!Shader_ReadCacheInt( &p, end, &codeSize ) ) {
+			break;
+		}
+		if( scriptNum < 0 || scriptNum >= r_numShaderScripts || offset < 0 || (size_t)offset > r_shaderScripts[scriptNum].size ) {
+			break;
+		}
+		cache->script = &r_shaderScripts[scriptNum];
+		cache->offset = offset;
+
+		if( codeSize < 0 ) {
+			break;
+		}
+		if( codeSize ) {
+			cache->code = ( const uint8_t * )Shader_ReadCacheData( &p, end, codeSize );
+			if( !cache->code || cache->code[codeSize - 1] != SOP_END ) {
+				break;
+			}
+			cache->codeSize = codeSize;
+		}
+
+		key = Hash32( cache->name ) % SHADERCACHE_HASH_SIZE;
+		cache->hash_next = shadercache_hash[key];
+		shadercache_hash[key] = cache;
+	}
+
+	if( i < numEntries ) {
+		ri.Com_DPrintf( "Ignoring shader cache: the file is corrupt\n" );
+		memset( shadercache_hash, 0, sizeof( shadercache_hash ) );
+		return false;
+	}
+
+	return true;
+}
+
+/*
+* R_PrecacheShaders
+*/
+static void R_InitShadersCache( void ) {
+	int d;
+	int i, j, k, numfiles;
+	int numfiles_total;
+	const char *fileptr;
+	char shaderPaths[1024];
+	const char *dirs[3] = { "<scripts", ">scripts", "scripts" };
+	uint64_t scriptsHash;
+
+	r_shaderTemplateBuf = NULL;
+
+	r_shaderCachePool = R_AllocPool( r_mempool, "Shader Cache" );
+	r_shaderScripts = NULL;
+	r_numShaderScripts = 0;
+
+	memset( shadercache_hash, 0, sizeof( shadercache_t * ) * SHADERCACHE_HASH_SIZE );
+
+	Com_Printf( "Initializing Shaders:\n" );
+
+	numfiles_total = 0;
+	for( d = 0; d < 3; d++ ) {
+		if( d == 2 ) {
+			// this is a fallback case for older bins that do not support the '<>' prefixes
+			// since we got some files, the binary is sufficiently up to date
+			if( numfiles_total ) {
+				break;
+			}
+		}
+
+		// enumerate shaders
+		numfiles = ri.FS_GetFileList( dirs[d], ".shader", NULL, 0, 0, 0 );
+		numfiles_total += numfiles;
+
+		// now load them all
+		for( i = 0; i < numfiles; i += k ) {
+			if( ( k = ri.FS_GetFileList( dirs[d], ".shader", shaderPaths, sizeof( shaderPaths ), i, numfiles ) ) == 0 ) {
+				k = 1; // advance by one file
+				continue;
+			}
+
+			fileptr = shaderPaths;
+			for( j = 0; j < k; j++ ) {
+				Shader_LoadScript( fileptr );
+
+				fileptr += strlen( fileptr ) + 1;
+				if( !*fileptr ) {
+					break;
+				}
+			}
+		}
+	}
+
+	if( !numfiles_total ) {
+		ri.Com_Error( ERR_DROP, "Could not find any shaders!" );
+	}
+
+	// with r_shadercache 0 the shaders are compiled from the scripts as they're registered
+	scriptsHash = Shader_ScriptsHash();
+	if( !r_shadercache->integer || !Shader_LoadCache( scriptsHash ) ) {
+		for( i = 0; i < r_numShaderScripts; i++ ) {
+			Shader_MakeCache( &r_shaderScripts[i] );
+		}
+
+		if( r_shadercache->integer ) {
+			Shader_CompileCache();
+			Shader_StoreCache( scriptsHash );
+		}
+	}
+
+	Com_Printf( "--------------------------------------\n" );
+}
+
+/*
+* R_InitShaders
 */
 void R_InitShaders( void ) {
 	int i;
@@ -1337,22 +1702,25 @@ void R_ShutdownShaders( void ) {
 
 	R_Free( r_shaderTemplateBuf );
 	R_Free( r_shortShaderName );
+	R_Free( r_shaderCode.data );
 
 	r_shaderTemplateBuf = NULL;
 	r_shortShaderName = NULL;
 	r_shortShaderNameSize = 0;
+	memset( &r_shaderCode, 0, sizeof( r_shaderCode ) );
 
 	memset( shadercache_hash, 0, sizeof( shadercache_hash ) );
+
+	R_FreePool( &r_shaderCachePool );
+	r_shaderScripts = NULL;
+	r_numShaderScripts = 0;
 }
 
-static void Shader_Readpass( shader_t *shader, const char **ptr ) {
-	int n = shader->numpasses;
-	int blendmask;
+static void Shader_CompilePass( shadercompile_t *c, const char **ptr ) {
 	const char *token;
-	shaderpass_t *pass;
 
-	if( n == MAX_SHADER_PASSES ) {
-		Com_Printf( S_COLOR_YELLOW "WARNING: shader %s has too many passes\n", shader->name );
+	if( c->numpasses == MAX_SHADER_PASSES ) {
+		Shader_CompileWarning( c, "shader %s has too many passes", c->name );
 
 		while( ptr ) { // skip
 			token = COM_ParseExt( ptr, true );
@@ -1363,16 +1731,8 @@ static void Shader_Readpass( shader_t *shader, const char **ptr ) {
 		return;
 	}
 
-	// Set defaults
-	pass = &r_currentPasses[n];
-	memset( pass, 0, sizeof( shaderpass_t ) );
-	pass->rgbgen.type = RGB_GEN_UNKNOWN;
-	pass->rgbgen.args = r_currentRGBgenArgs[n];
-	pass->alphagen.type = ALPHA_GEN_UNKNOWN;
-	pass->alphagen.args = r_currentAlphagenArgs[n];
-	pass->tcgenVec = r_currentTcGen[n][0];
-	pass->tcgen = TC_GEN_BASE;
-	pass->tcmods = r_currentTcmods[n];
+	Shader_EmitOp( c->code, SOP_PASS );
+	c->numtcmods = 0;
 
 	while( ptr ) {
 		token = COM_ParseExt( ptr, true );
@@ -1381,12 +1741,99 @@ static void Shader_Readpass( shader_t *shader, const char **ptr ) {
 			break;
 		} else if( token[0] == '}' ) {
 			break;
-		} else if( Shader_Parsetok( shader, pass, shaderpasskeys, token, ptr ) ) {
+		} else if( Shader_Parsetok( c, shaderpasskeys, token, ptr ) ) {
 			break;
 		}
 	}
 
-	blendmask = ( pass->flags & GLSTATE_BLEND_MASK );
+	Shader_EmitOp( c->code, SOP_ENDPASS );
+	c->numpasses++;
+}
+
+static bool Shader_Parsetok( shadercompile_t *c, const shaderkey_t *keys, const char *token, const char **ptr ) {
+	const shaderkey_t *key;
+
+	for( key = keys; key->keyword != NULL; key++ ) {
+		if( !Q_stricmp( token, key->keyword ) ) {
+			if( key->func ) {
+				key->func( c, ptr );
+			}
+			if( *ptr && **ptr == '}' ) {
+				*ptr = *ptr + 1;
+				return true;
+			}
+			return false;
+		}
+	}
+
+	Shader_SkipLine( ptr );
+
+	return false;
+}
+
+/*
+* Shader_Compile
+*
+* Parses shader text into ops for Shader_Apply. Only what depends on the text
+* alone is worked out here, images are looked up and anything that depends on
+* the shader type or cvars is left to registration, so the ops can be cached
+* across runs. Text that doesn't open a block compiles to nothing, which makes
+* a default shader.
+*/
+static void Shader_Compile( const char *name, const char *text, shadercode_t *code ) {
+	const char *ptr, *token;
+	shadercompile_t c;
+
+	code->size = 0;
+
+	memset( &c, 0, sizeof( c ) );
+	c.name = name;
+	c.code = code;
+
+	ptr = text;
+	token = COM_ParseExt( &ptr, true );
+
+	if( !ptr || token[0] != '{' ) {
+		return;
+	}
+
+	while( ptr ) {
+		token = COM_ParseExt( &ptr, true );
+
+		if( !token[0] ) {
+			break;
+		} else if( token[0] == '}' ) {
+			break;
+		} else if( token[0] == '{' ) {
+			Shader_CompilePass( &c, &ptr );
+		} else if( Shader_Parsetok( &c, shaderkeys, token, &ptr ) ) {
+			break;
+		}
+	}
+
+	Shader_EmitOp( code, SOP_END );
+}
+
+static shaderpass_t *Shader_BeginPass( shader_t *shader ) {
+	int n = shader->numpasses;
+	shaderpass_t *pass;
+
+	// Set defaults
+	pass = &r_currentPasses[n];
+	memset( pass, 0, sizeof( shaderpass_t ) );
+	pass->rgbgen.type = RGB_GEN_UNKNOWN;
+	pass->rgbgen.args = r_currentRGBgenArgs[n];
+	pass->alphagen.type = ALPHA_GEN_UNKNOWN;
+	pass->alphagen.args = r_currentAlphagenArgs[n];
+	pass->tcgenVec = r_currentTcGen[n][0];
+	pass->tcgen = TC_GEN_BASE;
+	pass->tcmods = r_currentTcmods[n];
+
+	return pass;
+}
+
+static void Shader_EndPass( shader_t *shader, shaderpass_t *pass ) {
+	int blendmask = ( pass->flags & GLSTATE_BLEND_MASK );
 
 	if( pass->rgbgen.type == RGB_GEN_UNKNOWN ) {
 		pass->rgbgen.type = RGB_GEN_IDENTITY;
@@ -1407,25 +1854,260 @@ static void Shader_Readpass( shader_t *shader, const char **ptr ) {
 	shader->numpasses++;
 }
 
-static bool Shader_Parsetok( shader_t *shader, shaderpass_t *pass, const shaderkey_t *keys, const char *token, const char **ptr ) {
-	const shaderkey_t *key;
+static void Shaderpass_ApplyColorgen( colorgen_t *colorgen, int type, int numargs, const uint8_t **code ) {
+	int set = Shader_ReadInt( code );
+	float args[3];
+	shaderfunc_t func;
 
-	for( key = keys; key->keyword != NULL; key++ ) {
-		if( !Q_stricmp( token, key->keyword ) ) {
-			if( key->func ) {
-				key->func( shader, pass, ptr );
+	Shader_Read( code, args, sizeof( args ) );
+	Shader_Read( code, &func, sizeof( func ) );
+
+	colorgen->type = type;
+	if( set & COLORGEN_ARGS ) {
+		memcpy( colorgen->args, args, numargs * sizeof( float ) );
+	}
+	if( set & COLORGEN_FUNC ) {
+		colorgen->func = func;
+	} else if( set & COLORGEN_FUNCNONE ) {
+		colorgen->func.type = SHADER_FUNC_NONE;
+	}
+}
+
+static void Shaderpass_ApplyAnimMap( shader_t *shader, shaderpass_t *pass, const uint8_t **code ) {
+	int flags = Shader_SetImageFlags( shader ) | Shader_ReadInt( code ) | IT_SRGB;
+
+	pass->tcgen = TC_GEN_BASE;
+	pass->anim_fps = Shader_ReadFloat( code );
+	pass->anim_numframes = 0;
+
+	for( ;; ) {
+		const char *name = Shader_ReadString( code );
+		if( !name[0] ) {
+			break;
+		}
+		pass->images[pass->anim_numframes++] = Shader_FindImage( shader, name, flags );
+	}
+
+	if( pass->anim_numframes == 0 ) {
+		pass->anim_fps = 0;
+	}
+}
+
+static void Shaderpass_ApplyMaterial( shader_t *shader, shaderpass_t *pass, const uint8_t **code ) {
+	int i, flags;
+	const char *token;
+
+	flags = Shader_SetImageFlags( shader );
+	token = Shader_ReadString( code );
+
+	if( !token[0] ) {
+		// single-word syntax
+		token = shader->name;
+	}
+
+	pass->images[0] = Shader_FindImage( shader, token, flags | IT_SRGB );
+	if( !pass->images[0] ) {
+		ri.Com_DPrintf( S_COLOR_YELLOW "WARNING: failed to load base/diffuse image for material %s in shader %s.\n", token, shader->name );
+		while( Shader_ReadString( code )[0] )
+			;
+		return;
+	}
+
+	pass->images[1] = pass->images[2] = pass->images[3] = NULL;
+
+	pass->tcgen = TC_GEN_BASE;
+	if( pass->rgbgen.type == RGB_GEN_UNKNOWN ) {
+		pass->rgbgen.type = RGB_GEN_IDENTITY;
+	}
+
+	for( ;; ) {
+		token = Shader_ReadString( code );
+		if( !*token ) {
+			break;
+		}
+
+		if( !pass->images[1] ) {
+			image_t *normalmap;
+			normalmap = Shader_FindImage( shader, token, flags | IT_NORMALMAP );
+			pass->program_type = GLSL_PROGRAM_TYPE_MATERIAL;
+			pass->images[1] = normalmap;
+		} else if( !pass->images[2] ) {
+			if( strcmp( token, "-" ) && r_lighting_specular->integer ) {
+				pass->images[2] = Shader_FindImage( shader, token, flags );
+			} else {
+				// set gloss to rsh.blackTexture so we know we have already parsed the gloss image
+				pass->images[2] = rsh.blackTexture;
 			}
-			if( *ptr && **ptr == '}' ) {
-				*ptr = *ptr + 1;
-				return true;
+		} else {
+			// parse decal images
+			for( i = 3; i < 5; i++ ) {
+				if( pass->images[i] ) {
+					continue;
+				}
+
+				if( strcmp( token, "-" ) ) {
+					pass->images[i] = Shader_FindImage( shader, token, flags | IT_SRGB );
+				} else {
+					pass->images[i] = rsh.whiteTexture;
+				}
+				break;
 			}
-			return false;
 		}
 	}
 
-	Shader_SkipLine( ptr );
+	// black texture => no gloss, so don't waste time in the GLSL program
+	if( pass->images[2] == rsh.blackTexture ) {
+		pass->images[2] = NULL;
+	}
 
-	return false;
+	for( i = 3; i < 5; i++ ) {
+		if( pass->images[i] == rsh.whiteTexture ) {
+			pass->images[i] = NULL;
+		}
+	}
+
+	if( pass->images[1] ) {
+		return;
+	}
+
+	// load default images
+	pass->program_type = GLSL_PROGRAM_TYPE_MATERIAL;
+	Shaderpass_LoadMaterial( &pass->images[1], &pass->images[2], &pass->images[3],
+							 pass->images[0]->name, flags, shader->imagetags );
+}
+
+/*
+* Shader_Apply
+*
+* Runs compiled shader ops into r_currentPasses and friends, like parsing the
+* text the ops came from would have, ready for Shader_Finish
+*/
+static void Shader_Apply( shader_t *s, const uint8_t *code ) {
+	shaderpass_t *pass = NULL;
+
+	for( ;; ) {
+		int op = Shader_ReadOp( &code );
+
+		switch( op ) {
+			case SOP_END:
+				return;
+			case SOP_WARNING:
+				Com_Printf( S_COLOR_YELLOW "WARNING: %s\n", Shader_ReadString( &code ) );
+				break;
+			case SOP_FLAGS:
+				s->flags |= Shader_ReadInt( &code );
+				break;
+			case SOP_CULL:
+				s->flags &= ~( SHADER_CULL_FRONT | SHADER_CULL_BACK );
+				s->flags |= Shader_ReadInt( &code );
+				break;
+			case SOP_NOMIPMAPS:
+				r_shaderNoMipMaps = true;
+				r_shaderMinMipSize = 1;
+				break;
+			case SOP_NOFILTERING:
+				r_shaderNoFiltering = true;
+				s->flags |= SHADER_NO_TEX_FILTERING;
+				break;
+			case SOP_MINMIPSIZE: {
+				int size = Shader_ReadInt( &code );
+				if( !r_shaderNoMipMaps ) {
+					r_shaderMinMipSize = max( size, 1 );
+				}
+				break;
+			}
+			case SOP_SORT:
+				s->sort = Shader_ReadInt( &code );
+				break;
+			case SOP_DEFORM: {
+				deformv_t deformv;
+
+				Shader_Read( &code, &deformv, sizeof( deformv ) );
+				Q_strncatz( r_shaderDeformvKey, Shader_ReadString( &code ), sizeof( r_shaderDeformvKey ) );
+
+				if( deformv.type == DEFORMV_NONE || s->numdeforms == MAX_SHADER_DEFORMVS ) {
+					break;
+				}
+				if( deformv.type == DEFORMV_AUTOSPRITE ) {
+					r_shaderHasAutosprite = true;
+				}
+				if( deformv.type == DEFORMV_AUTOSPRITE || deformv.type == DEFORMV_AUTOSPRITE2 || deformv.type == DEFORMV_AUTOPARTICLE ) {
+					s->flags |= SHADER_AUTOSPRITE;
+				}
+				r_currentDeforms[s->numdeforms++] = deformv;
+				break;
+			}
+			case SOP_GLOSSINTENSITY:
+				s->glossIntensity = Shader_ReadFloat( &code );
+				break;
+			case SOP_GLOSSEXPONENT:
+				s->glossExponent = Shader_ReadFloat( &code );
+				break;
+			case SOP_PASS:
+				pass = Shader_BeginPass( s );
+				break;
+			case SOP_ENDPASS:
+				Shader_EndPass( s, pass );
+				pass = NULL;
+				break;
+
+			case POP_FLAGS: {
+				int clear = Shader_ReadInt( &code );
+				pass->flags = ( pass->flags & ~clear ) | Shader_ReadInt( &code );
+				break;
+			}
+			case POP_RGBGEN: {
+				int type = Shader_ReadInt( &code );
+				if( type == RGB_GEN_LIGHTING_DIFFUSE ) {
+					if( s->type < SHADER_TYPE_DIFFUSE ) {
+						type = RGB_GEN_VERTEX;
+					} else if( s->type > SHADER_TYPE_DIFFUSE ) {
+						type = RGB_GEN_IDENTITY;
+					}
+				}
+				Shaderpass_ApplyColorgen( &pass->rgbgen, type, 3, &code );
+				break;
+			}
+			case POP_ALPHAGEN:
+				Shaderpass_ApplyColorgen( &pass->alphagen, Shader_ReadInt( &code ), 1, &code );
+				break;
+			case POP_TCMOD: {
+				tcmod_t tcmod;
+
+				Shader_Read( &code, &tcmod, sizeof( tcmod ) );
+				if( pass->numtcmods < MAX_SHADER_TCMODS ) {
+					pass->tcmods[pass->numtcmods++] = tcmod;
+				}
+				break;
+			}
+			case POP_TCGEN:
+				pass->tcgen = Shader_ReadInt( &code );
+				if( pass->tcgen == TC_GEN_VECTOR ) {
+					Shader_Read( &code, pass->tcgenVec, sizeof( vec4_t ) * 2 );
+				} else {
+					code += sizeof( vec4_t ) * 2;
+				}
+				break;
+			case POP_MAP: {
+				int flags = Shader_SetImageFlags( s ) | Shader_ReadInt( &code ) | IT_SRGB;
+
+				pass->tcgen = TC_GEN_BASE;
+				pass->anim_fps = 0;
+				pass->images[0] = Shader_FindImage( s, Shader_ReadString( &code ), flags );
+				break;
+			}
+			case POP_ANIMMAP:
+				Shaderpass_ApplyAnimMap( s, pass, &code );
+				break;
+			case POP_MATERIAL:
+				Shaderpass_ApplyMaterial( s, pass, &code );
+				break;
+
+			default:
+				assert( 0 );
+				return;
+		}
+	}
 }
 
 static void Shader_SetVertexAttribs( shader_t *s ) {
@@ -1694,7 +2376,7 @@ static size_t R_ShaderCleanName( const char *name, char *shortname, size_t short
 * R_LoadShaderReal
 */
 static void R_LoadShaderReal( shader_t *s, const char *shortname,
-							  size_t shortname_length, const char *longname, shaderType_e type, const char *text ) {
+							  size_t shortname_length, const char *longname, shaderType_e type, const uint8_t *code ) {
 	void *data;
 	shaderpass_t *pass;
 	image_t *materialImages[MAX_SHADER_IMAGES];
@@ -1723,33 +2405,10 @@ static void R_LoadShaderReal( shader_t *s, const char *shortname,
 		r_defaultImage = rsh.noTexture;
 	}
 
-	if( text ) {
-		const char *ptr, *token;
-
-		ptr = text;
-		token = COM_ParseExt( &ptr, true );
-
-		if( !ptr || token[0] != '{' ) {
-			goto create_default;
-		}
-
-		while( ptr ) {
-			token = COM_ParseExt( &ptr, true );
-
-			if( !token[0] ) {
-				break;
-			} else if( token[0] == '}' ) {
-				break;
-			} else if( token[0] == '{' ) {
-				Shader_Readpass( s, &ptr );
-			} else if( Shader_Parsetok( s, NULL, shaderkeys, token, &ptr ) ) {
-				break;
-			}
-		}
-
+	if( code ) {
+		Shader_Apply( s, code );
 		Shader_Finish( s );
 	} else {
-create_default:
 		// make default shader
 		switch( type ) {
 			case SHADER_TYPE_VERTEX:
@@ -1931,6 +2590,7 @@ shader_t *R_LoadShader( const char *name, shaderType_e type, bool forceDefault,
 	shader_t *s;
 	shader_t *hnode, *prev, *next;
 	shadercache_t *cache = NULL;
+	const uint8_t *code = NULL;
 
 	if( !name || !name[0] ) {
 		return NULL;
@@ -1986,8 +2646,19 @@ shader_t *R_LoadShader( const char *name, shaderType_e type, bool forceDefault,
 
 		// shader is in the shader scripts
 		if( cache ) {
-			text = cache->buffer + cache->offset;
 			ri.Com_DPrintf( "Loading shader %s from cache...\n", shortname );
+			if( cache->code ) {
+				code = cache->code;
+			} else {
+				text = cache->script->buffer + cache->offset;
+			}
+		}
+	}
+
+	if( text ) {
+		Shader_Compile( shortname, text, &r_shaderCode );
+		if( r_shaderCode.size ) {
+			code = r_shaderCode.data;
 		}
 	}
 
@@ -2000,7 +2671,7 @@ shader_t *R_LoadShader( const char *name, shaderType_e type, bool forceDefault,
 	s->next = next;
 	s->prev = prev;
 	s->id = s - r_shaders;
-	R_LoadShaderReal( s, shortname, nameLength, name, type, text );
+	R_LoadShaderReal( s, shortname, nameLength, name, type, code );
 
 	// add to linked lists
 	s->prev = hnode;
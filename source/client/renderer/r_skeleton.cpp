@@ -0,0 +1,435 @@
+#include "qcommon/qcommon.h"
+#include "qalgo/hash.h"
+#include "cgame/ref.h"
+#include "r_skeleton.h"
+
+#include "cgltf/cgltf.h"
+
+#include <xmmintrin.h>
+
+STATIC_ASSERT( offsetof( TRS, scale ) == offsetof( TRS, translation ) + sizeof( Vec3 ) );
+
+static u8 GetJointIdx( const cgltf_node * node ) {
+	return u8( uintptr_t( node->camera ) - 1 );
+}
+
+static void SetJointIdx( cgltf_node * node, u8 joint_idx ) {
+	node->camera = ( cgltf_camera * ) uintptr_t( joint_idx + 1 );
+}
+
+// unreadable samples load as zeros instead of leaving malloc garbage
+static void ReadFloats( const cgltf_accessor * accessor, size_t idx, float * out, size_t n ) {
+	if( cgltf_accessor_read_float( accessor, idx, out, n ) == 0 ) {
+		memset( out, 0, n * sizeof( float ) );
+	}
+}
+
+static void LoadJoint( Skeleton * skeleton, const cgltf_skin * skin, cgltf_node * node, u8 * num_ordered ) {
+	u8 joint_idx = GetJointIdx( node );
+	skeleton->order[ *num_ordered ] = joint_idx;
+	( *num_ordered )++;
+
+	skeleton->parents[ joint_idx ] = node->parent != NULL ? GetJointIdx( node->parent ) : U8_MAX;
+	skeleton->names[ joint_idx ] = Hash32( node->name );
+
+	ReadFloats( skin->inverse_bind_matrices, joint_idx, skeleton->joints_to_bind[ joint_idx ].ptr(), 16 );
+
+	for( size_t i = 0; i < node->children_count; i++ ) {
+		LoadJoint( skeleton, skin, node->children[ i ], num_ordered );
+	}
+
+	if( node->children_count == 0 ) {
+		skeleton->first_children[ joint_idx ] = U8_MAX;
+	}
+	else {
+		skeleton->first_children[ joint_idx ] = GetJointIdx( node->children[ 0 ] );
+
+		for( size_t i = 0; i < node->children_count - 1; i++ ) {
+			skeleton->siblings[ GetJointIdx( node->children[ i ] ) ] = GetJointIdx( node->children[ i + 1 ] );
+		}
+
+		skeleton->siblings[ GetJointIdx( node->children[ node->children_count - 1 ] ) ] = U8_MAX;
+	}
+}
+
+const cgltf_node * LoadSkeleton( Skeleton * skeleton, const cgltf_skin * skin ) {
+	size_t n = skin->joints_count;
+
+	skeleton->num_joints = n;
+	skeleton->order = ( u8 * ) malloc( n * sizeof( u8 ) );
+	skeleton->parents = ( u8 * ) malloc( n * sizeof( u8 ) );
+	skeleton->first_children = ( u8 * ) malloc( n * sizeof( u8 ) );
+	skeleton->siblings = ( u8 * ) malloc( n * sizeof( u8 ) );
+	skeleton->names = ( u32 * ) malloc( n * sizeof( u32 ) );
+	skeleton->joints_to_bind = ( Mat4 * ) malloc( n * sizeof( Mat4 ) );
+	skeleton->rotations = ( Skeleton::AnimationChannel< Quaternion > * ) calloc( n, sizeof( Skeleton::AnimationChannel< Quaternion > ) );
+	skeleton->translations = ( Skeleton::AnimationChannel< Vec3 > * ) calloc( n, sizeof( Skeleton::AnimationChannel< Vec3 > ) );
+	skeleton->scales = ( Skeleton::AnimationChannel< float > * ) calloc( n, sizeof( Skeleton::AnimationChannel< float > ) );
+
+	for( size_t i = 0; i < n; i++ ) {
+		SetJointIdx( skin->joints[ i ], i );
+	}
+
+	// exporters can put helper nodes next to the real root, which is fine as
+	// long as they all hang off the same node
+	cgltf_node * root = NULL;
+	u8 prev_root = U8_MAX;
+	u8 num_ordered = 0;
+	for( size_t i = 0; i < n; i++ ) {
+		cgltf_node * joint = skin->joints[ i ];
+		if( joint->parent != NULL && GetJointIdx( joint->parent ) != U8_MAX )
+			continue;
+
+		if( root == NULL ) {
+			root = joint;
+			skeleton->root_joint = i;
+		}
+		else if( joint->parent != root->parent ) {
+			return NULL;
+		}
+		else {
+			skeleton->siblings[ prev_root ] = i;
+		}
+
+		LoadJoint( skeleton, skin, joint, &num_ordered );
+		prev_root = i;
+	}
+
+	skeleton->siblings[ prev_root ] = U8_MAX;
+
+	return root;
+}
+
+static u32 LoadTimeline( Skeleton * skeleton, const cgltf_accessor ** inputs, const cgltf_accessor * input ) {
+	for( u32 i = 0; i < skeleton->num_timelines; i++ ) {
+		if( inputs[ i ] == input ) {
+			return i;
+		}
+	}
+
+	assert( skeleton->num_timelines < SKELETON_MAX_TIMELINES );
+
+	Skeleton::Timeline * timeline = &skeleton->timelines[ skeleton->num_timelines ];
+	timeline->num_samples = input->count;
+	timeline->times = ( float * ) malloc( input->count * sizeof( float ) );
+
+	for( size_t i = 0; i < input->count; i++ ) {
+		ReadFloats( input, i, &timeline->times[ i ], 1 );
+	}
+
+	inputs[ skeleton->num_timelines ] = input;
+	skeleton->num_timelines++;
+
+	return skeleton->num_timelines - 1;
+}
+
+template< typename T >
+static void LoadChannel( const cgltf_animation_channel * chan, Skeleton::AnimationChannel< T > * out_channel ) {
+	constexpr size_t lanes = sizeof( T ) / sizeof( float );
+	size_t n = chan->sampler->input->count;
+
+	out_channel->samples = ( T * ) malloc( n * sizeof( T ) );
+
+	for( size_t i = 0; i < n; i++ ) {
+		ReadFloats( chan->sampler->output, i, out_channel->samples[ i ].ptr(), lanes );
+	}
+}
+
+static void LoadScaleChannel( const cgltf_animation_channel * chan, Skeleton::AnimationChannel< float > * out_channel ) {
+	size_t n = chan->sampler->input->count;
+
+	out_channel->samples = ( float * ) malloc( n * sizeof( float ) );
+
+	for( size_t i = 0; i < n; i++ ) {
+		float scale[ 3 ];
+		ReadFloats( chan->sampler->output, i, scale, 3 );
+
+		assert( fabsf( scale[ 0 ] / scale[ 1 ] - 1.0f ) < 0.001f );
+		assert( fabsf( scale[ 0 ] / scale[ 2 ] - 1.0f ) < 0.001f );
+
+		out_channel->samples[ i ] = scale[ 0 ];
+	}
+}
+
+void LoadSkeletonAnimation( Skeleton * skeleton, const cgltf_animation * animation ) {
+	size_t max_timelines = Min2( animation->channels_count, size_t( SKELETON_MAX_TIMELINES ) );
+	const cgltf_accessor ** inputs = ( const cgltf_accessor ** ) malloc( max_timelines * sizeof( *inputs ) );
+
+	skeleton->timelines = ( Skeleton::Timeline * ) malloc( max_timelines * sizeof( Skeleton::Timeline ) );
+	skeleton->num_timelines = 0;
+
+	for( size_t i = 0; i < animation->channels_count; i++ ) {
+		const cgltf_animation_channel * chan = &animation->channels[ i ];
+
+		assert( chan->target_node->camera != NULL );
+		u8 joint_idx = GetJointIdx( chan->target_node );
+		u32 timeline = LoadTimeline( skeleton, inputs, chan->sampler->input );
+
+		if( chan->target_path == cgltf_animation_path_type_translation ) {
+			LoadChannel( chan, &skeleton->translations[ joint_idx ] );
+			skeleton->translations[ joint_idx ].timeline = timeline;
+		}
+		else if( chan->target_path == cgltf_animation_path_type_rotation ) {
+			LoadChannel( chan, &skeleton->rotations[ joint_idx ] );
+			skeleton->rotations[ joint_idx ].timeline = timeline;
+		}
+		else if( chan->target_path == cgltf_animation_path_type_scale ) {
+			LoadScaleChannel( chan, &skeleton->scales[ joint_idx ] );
+			skeleton->scales[ joint_idx ].timeline = timeline;
+		}
+	}
+
+	free( inputs );
+}
+
+/*
+ * FindKeyframe
+ *
+ * Returns the keyframe before t, which is the one before the first key time
+ * >= t. The hint and the keyframe after it are tried before searching
+ */
+static u32 FindKeyframe( const float * times, u32 n, float t, u32 hint ) {
+	if( hint + 1 < n ) {
+		if( times[ hint + 1 ] >= t && ( hint == 0 || times[ hint ] < t ) )
+			return hint;
+		if( hint + 2 < n && times[ hint + 2 ] >= t && times[ hint + 1 ] < t )
+			return hint + 1;
+	}
+
+	u32 lo = 1;
+	u32 hi = n - 1;
+	while( lo < hi ) {
+		u32 mid = ( lo + hi ) / 2;
+		if( times[ mid ] >= t ) {
+			hi = mid;
+		}
+		else {
+			lo = mid + 1;
+		}
+	}
+
+	return lo - 1;
+}
+
+Span< TRS > SampleSkeleton( ArenaAllocator * a, const Skeleton * skeleton, float t, AnimationCursor * cursor ) {
+	u32 keyframes[ SKELETON_MAX_TIMELINES ];
+	float lerp_fracs[ SKELETON_MAX_TIMELINES ];
+
+	if( cursor != NULL && cursor->skeleton != skeleton ) {
+		cursor->skeleton = skeleton;
+		memset( cursor->keyframes, 0, sizeof( cursor->keyframes ) );
+	}
+
+	// every channel sharing a timeline shares its keyframe
+	for( u32 i = 0; i < skeleton->num_timelines; i++ ) {
+		const Skeleton::Timeline & timeline = skeleton->timelines[ i ];
+		bool cached = cursor != NULL && i < ANIMATION_CURSOR_TIMELINES;
+
+		if( timeline.num_samples < 2 ) {
+			keyframes[ i ] = 0;
+			lerp_fracs[ i ] = 0.0f;
+			continue;
+		}
+
+		const float * times = timeline.times;
+		float clamped = Clamp( times[ 0 ], t, times[ timeline.num_samples - 1 ] );
+		u32 keyframe = FindKeyframe( times, timeline.num_samples, clamped, cached ? cursor->keyframes[ i ] : 0 );
+
+		if( cached ) {
+			cursor->keyframes[ i ] = u16( Min2( keyframe, u32( U16_MAX ) ) );
+		}
+
+		keyframes[ i ] = keyframe;
+		lerp_fracs[ i ] = ( clamped - times[ keyframe ] ) / ( times[ keyframe + 1 ] - times[ keyframe ] );
+	}
+
+	Span< TRS > local_poses = ALLOC_SPAN( a, TRS, skeleton->num_joints );
+
+	for( u8 i = 0; i < skeleton->num_joints; i++ ) {
+		const Skeleton::AnimationChannel< Quaternion > & rotations = skeleton->rotations[ i ];
+		const Skeleton::AnimationChannel< Vec3 > & translations = skeleton->translations[ i ];
+		const Skeleton::AnimationChannel< float > & scales = skeleton->scales[ i ];
+
+		u32 rotation_sample = keyframes[ rotations.timeline ];
+		u32 translation_sample = keyframes[ translations.timeline ];
+		u32 scale_sample = keyframes[ scales.timeline ];
+		u32 num_rotations = skeleton->timelines[ rotations.timeline ].num_samples;
+		u32 num_translations = skeleton->timelines[ translations.timeline ].num_samples;
+		u32 num_scales = skeleton->timelines[ scales.timeline ].num_samples;
+
+		local_poses[ i ].rotation = NLerp( rotations.samples[ rotation_sample ], lerp_fracs[ rotations.timeline ], rotations.samples[ ( rotation_sample + 1 ) % num_rotations ] );
+		local_poses[ i ].translation = Lerp( translations.samples[ translation_sample ], lerp_fracs[ translations.timeline ], translations.samples[ ( translation_sample + 1 ) % num_translations ] );
+		local_poses[ i ].scale = Lerp( scales.samples[ scale_sample ], lerp_fracs[ scales.timeline ], scales.samples[ ( scale_sample + 1 ) % num_scales ] );
+	}
+
+	return local_poses;
+}
+
+static Mat4 TRSToMat4( const TRS & trs ) {
+	Quaternion q = trs.rotation;
+	Vec3 t = trs.translation;
+	float s = trs.scale;
+
+	// return t * q * s;
+	return Mat4(
+		( 1.0f - 2 * q.y * q.y - 2.0f * q.z * q.z ) * s,
+		( 2.0f * q.x * q.y - 2.0f * q.z * q.w ) * s,
+		( 2.0f * q.x * q.z + 2.0f * q.y * q.w ) * s,
+		t.x,
+
+		( 2.0f * q.x * q.y + 2.0f * q.z * q.w ) * s,
+		( 1.0f - 2.0f * q.x * q.x - 2.0f * q.z * q.z ) * s,
+		( 2.0f * q.y * q.z - 2.0f * q.x * q.w ) * s,
+		t.y,
+
+		( 2.0f * q.x * q.z - 2.0f * q.y * q.w ) * s,
+		( 2.0f * q.y * q.z + 2.0f * q.x * q.w ) * s,
+		( 1.0f - 2.0f * q.x * q.x - 2.0f * q.y * q.y ) * s,
+		t.z,
+
+		0.0f, 0.0f, 0.0f, 1.0f
+	);
+}
+
+/*
+ * TRSToMat4x4
+ *
+ * TRSToMat4 for 4 joints at once, transposed so each lane works on one joint
+ */
+static void TRSToMat4x4( const TRS * trs, Mat4 * out ) {
+	__m128 x = _mm_loadu_ps( &trs[ 0 ].rotation.x );
+	__m128 y = _mm_loadu_ps( &trs[ 1 ].rotation.x );
+	__m128 z = _mm_loadu_ps( &trs[ 2 ].rotation.x );
+	__m128 w = _mm_loadu_ps( &trs[ 3 ].rotation.x );
+	_MM_TRANSPOSE4_PS( x, y, z, w );
+
+	__m128 tx = _mm_loadu_ps( &trs[ 0 ].translation.x );
+	__m128 ty = _mm_loadu_ps( &trs[ 1 ].translation.x );
+	__m128 tz = _mm_loadu_ps( &trs[ 2 ].translation.x );
+	__m128 s = _mm_loadu_ps( &trs[ 3 ].translation.x );
+	_MM_TRANSPOSE4_PS( tx, ty, tz, s );
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps( 1.0f );
+	const __m128 two = _mm_set1_ps( 2.0f );
+	__m128 x2 = _mm_mul_ps( two, x );
+	__m128 y2 = _mm_mul_ps( two, y );
+	__m128 z2 = _mm_mul_ps( two, z );
+
+	__m128 m00 = _mm_mul_ps( _mm_sub_ps( _mm_sub_ps( one, _mm_mul_ps( y2, y ) ), _mm_mul_ps( z2, z ) ), s );
+	__m128 m01 = _mm_mul_ps( _mm_sub_ps( _mm_mul_ps( x2, y ), _mm_mul_ps( z2, w ) ), s );
+	__m128 m02 = _mm_mul_ps( _mm_add_ps( _mm_mul_ps( x2, z ), _mm_mul_ps( y2, w ) ), s );
+	__m128 m10 = _mm_mul_ps( _mm_add_ps( _mm_mul_ps( x2, y ), _mm_mul_ps( z2, w ) ), s );
+	__m128 m11 = _mm_mul_ps( _mm_sub_ps( _mm_sub_ps( one, _mm_mul_ps( x2, x ) ), _mm_mul_ps( z2, z ) ), s );
+	__m128 m12 = _mm_mul_ps( _mm_sub_ps( _mm_mul_ps( y2, z ), _mm_mul_ps( x2, w ) ), s );
+	__m128 m20 = _mm_mul_ps( _mm_sub_ps( _mm_mul_ps( x2, z ), _mm_mul_ps( y2, w ) ), s );
+	__m128 m21 = _mm_mul_ps( _mm_add_ps( _mm_mul_ps( y2, z ), _mm_mul_ps( x2, w ) ), s );
+	__m128 m22 = _mm_mul_ps( _mm_sub_ps( _mm_sub_ps( one, _mm_mul_ps( x2, x ) ), _mm_mul_ps( y2, y ) ), s );
+
+	// back to one column of one joint per register
+	__m128 w0 = zero, w1 = zero, w2 = zero, w3 = one;
+	_MM_TRANSPOSE4_PS( m00, m10, m20, w0 );
+	_MM_TRANSPOSE4_PS( m01, m11, m21, w1 );
+	_MM_TRANSPOSE4_PS( m02, m12, m22, w2 );
+	_MM_TRANSPOSE4_PS( tx, ty, tz, w3 );
+
+	_mm_storeu_ps( out[ 0 ].col0.ptr(), m00 );
+	_mm_storeu_ps( out[ 1 ].col0.ptr(), m10 );
+	_mm_storeu_ps( out[ 2 ].col0.ptr(), m20 );
+	_mm_storeu_ps( out[ 3 ].col0.ptr(), w0 );
+	_mm_storeu_ps( out[ 0 ].col1.ptr(), m01 );
+	_mm_storeu_ps( out[ 1 ].col1.ptr(), m11 );
+	_mm_storeu_ps( out[ 2 ].col1.ptr(), m21 );
+	_mm_storeu_ps( out[ 3 ].col1.ptr(), w1 );
+	_mm_storeu_ps( out[ 0 ].col2.ptr(), m02 );
+	_mm_storeu_ps( out[ 1 ].col2.ptr(), m12 );
+	_mm_storeu_ps( out[ 2 ].col2.ptr(), m22 );
+	_mm_storeu_ps( out[ 3 ].col2.ptr(), w2 );
+	_mm_storeu_ps( out[ 0 ].col3.ptr(), tx );
+	_mm_storeu_ps( out[ 1 ].col3.ptr(), ty );
+	_mm_storeu_ps( out[ 2 ].col3.ptr(), tz );
+	_mm_storeu_ps( out[ 3 ].col3.ptr(), w3 );
+}
+
+/*
+ * Mat4Multiply
+ *
+ * lhs * rhs, summing in the same order as operator*. out may be rhs but not lhs
+ */
+static void Mat4Multiply( const Mat4 & lhs, const Mat4 & rhs, Mat4 * out ) {
+	__m128 c0 = _mm_loadu_ps( &lhs.col0.x );
+	__m128 c1 = _mm_loadu_ps( &lhs.col1.x );
+	__m128 c2 = _mm_loadu_ps( &lhs.col2.x );
+	__m128 c3 = _mm_loadu_ps( &lhs.col3.x );
+
+	const Vec4 * rhs_cols[] = { &rhs.col0, &rhs.col1, &rhs.col2, &rhs.col3 };
+	Vec4 * out_cols[] = { &out->col0, &out->col1, &out->col2, &out->col3 };
+
+	for( int i = 0; i < 4; i++ ) {
+		__m128 col = _mm_loadu_ps( &rhs_cols[ i ]->x );
+		__m128 r = _mm_mul_ps( c0, _mm_shuffle_ps( col, col, _MM_SHUFFLE( 0, 0, 0, 0 ) ) );
+		r = _mm_add_ps( r, _mm_mul_ps( c1, _mm_shuffle_ps( col, col, _MM_SHUFFLE( 1, 1, 1, 1 ) ) ) );
+		r = _mm_add_ps( r, _mm_mul_ps( c2, _mm_shuffle_ps( col, col, _MM_SHUFFLE( 2, 2, 2, 2 ) ) ) );
+		r = _mm_add_ps( r, _mm_mul_ps( c3, _mm_shuffle_ps( col, col, _MM_SHUFFLE( 3, 3, 3, 3 ) ) ) );
+		_mm_storeu_ps( out_cols[ i ]->ptr(), r );
+	}
+}
+
+MatrixPalettes ComputeSkeletonPalettes( ArenaAllocator * a, const Skeleton * skeleton, Span< const TRS > local_poses ) {
+	u8 n = skeleton->num_joints;
+	assert( local_poses.n == n );
+
+	MatrixPalettes palettes;
+	palettes.joint_poses = ALLOC_SPAN( a, Mat4, n );
+	palettes.skinning_matrices = ALLOC_SPAN( a, Mat4, n );
+
+	// local transforms first, then each is moved into its parent's space in hierarchy order
+	u8 i = 0;
+	for( ; i + 4 <= n; i += 4 ) {
+		TRSToMat4x4( &local_poses[ i ], &palettes.joint_poses[ i ] );
+	}
+	for( ; i < n; i++ ) {
+		palettes.joint_poses[ i ] = TRSToMat4( local_poses[ i ] );
+	}
+
+	for( u8 j = 1; j < n; j++ ) {
+		u8 joint_idx = skeleton->order[ j ];
+		if( skeleton->parents[ joint_idx ] == U8_MAX )
+			continue;
+		Mat4Multiply( palettes.joint_poses[ skeleton->parents[ joint_idx ] ], palettes.joint_poses[ joint_idx ], &palettes.joint_poses[ joint_idx ] );
+	}
+
+	for( u8 j = 0; j < n; j++ ) {
+		Mat4Multiply( palettes.joint_poses[ j ], skeleton->joints_to_bind[ j ], &palettes.skinning_matrices[ j ] );
+	}
+
+	return palettes;
+}
+
+bool FindSkeletonJoint( const Skeleton * skeleton, const char * name, u8 * joint_idx ) {
+	u32 hash = Hash32( name );
+	for( u8 i = 0; i < skeleton->num_joints; i++ ) {
+		if( skeleton->names[ i ] == hash ) {
+			*joint_idx = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void MergePosesRecursive( Span< TRS > lower, Span< const TRS > upper, const Skeleton * skeleton, u8 i ) {
+	lower[ i ] = upper[ i ];
+
+	if( skeleton->siblings[ i ] != U8_MAX )
+		MergePosesRecursive( lower, upper, skeleton, skeleton->siblings[ i ] );
+	if( skeleton->first_children[ i ] != U8_MAX )
+		MergePosesRecursive( lower, upper, skeleton, skeleton->first_children[ i ] );
+}
+
+void MergeSkeletonPoses( Span< TRS > lower, Span< const TRS > upper, const Skeleton * skeleton, u8 upper_root_joint ) {
+	lower[ upper_root_joint ] = upper[ upper_root_joint ];
+
+	if( skeleton->first_children[ upper_root_joint ] != U8_MAX )
+		MergePosesRecursive( lower, upper, skeleton, skeleton->first_children[ upper_root_joint ] );
+}
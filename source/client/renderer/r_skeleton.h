@@ -0,0 +1,51 @@
+#pragma once
+
+#include "qcommon/types.h"
+
+struct cgltf_node;
+struct cgltf_skin;
+struct cgltf_animation;
+
+#define SKELETON_MAX_TIMELINES ( 3 * 256 )
+
+struct Skeleton {
+	template< typename T >
+	struct AnimationChannel {
+		T * samples;
+		u32 timeline;
+	};
+
+	// key times, shared by every channel that was exported with the same ones
+	struct Timeline {
+		float * times;
+		u32 num_samples;
+	};
+
+	// joints are stored as parallel arrays so each pass only touches what it reads
+	u8 num_joints;
+	u8 root_joint;
+	u8 * order;                 // parents come before their children
+	u8 * parents;
+	u8 * first_children;        // TODO: remove first_children and siblings with additive animations
+	u8 * siblings;
+	u32 * names;
+	Mat4 * joints_to_bind;
+
+	AnimationChannel< Quaternion > * rotations;
+	AnimationChannel< Vec3 > * translations;
+	AnimationChannel< float > * scales;
+
+	Timeline * timelines;
+	u32 num_timelines;
+};
+
+// returns the skin's first root joint, or NULL if its roots have different parents
+const cgltf_node * LoadSkeleton( Skeleton * skeleton, const cgltf_skin * skin );
+void LoadSkeletonAnimation( Skeleton * skeleton, const cgltf_animation * animation );
+
+// cursor is optional, see AnimationCursor
+Span< TRS > SampleSkeleton( ArenaAllocator * a, const Skeleton * skeleton, float t, AnimationCursor * cursor );
+MatrixPalettes ComputeSkeletonPalettes( ArenaAllocator * a, const Skeleton * skeleton, Span< const TRS > local_poses );
+
+bool FindSkeletonJoint( const Skeleton * skeleton, const char * name, u8 * joint_idx );
+void MergeSkeletonPoses( Span< TRS > lower, Span< const TRS > upper, const Skeleton * skeleton, u8 upper_root_joint );
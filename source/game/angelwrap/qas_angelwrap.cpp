@@ -27,8 +27,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "addon/addon_cvar.h"
 #include "addon/addon_stringutils.h"
 
+#include "qalgo/hash.h"
+#include "qcommon/version.h"
+
 #include <list>
 #include <map>
+#include <vector>
 
 static void *qasAlloc( size_t size ) {
 	return G_Malloc( size );
@@ -40,8 +44,15 @@ static void qasFree( void *mem ) {
 
 // ============================================================================
 
+// a pooled context and the function it was last prepared with, so hot
+// callbacks get a context that can skip most of Prepare's setup
+typedef struct {
+	asIScriptContext *ctx;
+	asIScriptFunction *func;
+} qasPooledContext_t;
+
 // list of contexts in the same engine
-typedef std::list<asIScriptContext *> qasContextList;
+typedef std::list<qasPooledContext_t> qasContextList;
 
 // engine -> contexts key/value pairs
 typedef std::map<asIScriptEngine *, qasContextList> qasEngineContextMap;
@@ -419,11 +430,13 @@ void qasReleaseEngine( asIScriptEngine *engine ) {
 		return;
 	}
 
+	// profiled functions hold references into the engine
+	qasResetProfile();
+
 	// release all contexts linked to this engine
 	qasContextList &ctxList = contexts[engine];
 	for( qasContextList::iterator it = ctxList.begin(); it != ctxList.end(); it++ ) {
-		asIScriptContext *ctx = *it;
-		ctx->Release();
+		it->ctx->Release();
 	}
 	ctxList.clear();
 
@@ -461,8 +474,13 @@ static asIScriptContext *qasCreateContext( asIScriptEngine *engine ) {
 		return NULL;
 	}
 
+	if( qasIsProfiling() ) {
+		qasProfileAttach( ctx );
+	}
+
+	qasPooledContext_t pooled = { ctx, NULL };
 	qasContextList &ctxList = contexts[engine];
-	ctxList.push_back( ctx );
+	ctxList.push_back( pooled );
 
 	return ctx;
 }
@@ -474,11 +492,27 @@ void qasReleaseContext( asIScriptContext *ctx ) {
 
 	asIScriptEngine *engine = ctx->GetEngine();
 	qasContextList &ctxList = contexts[engine];
-	ctxList.remove( ctx );
+	for( qasContextList::iterator it = ctxList.begin(); it != ctxList.end(); it++ ) {
+		if( it->ctx == ctx ) {
+			ctxList.erase( it );
+			break;
+		}
+	}
 
 	ctx->Release();
 }
 
+/*
+* qasContextIsIdle
+*
+* Nested callbacks (e.g. a die callback fired from inside a think function)
+* must never be handed a context that is still running or waiting to run.
+*/
+static bool qasContextIsIdle( asIScriptContext *ctx ) {
+	asEContextState state = ctx->GetState();
+	return state != asEXECUTION_ACTIVE && state != asEXECUTION_SUSPENDED && state != asEXECUTION_PREPARED;
+}
+
 asIScriptContext *qasAcquireContext( asIScriptEngine *engine ) {
 	if( !engine ) {
 		return NULL;
@@ -487,9 +521,9 @@ asIScriptContext *qasAcquireContext( asIScriptEngine *engine ) {
 	// try to reuse any context linked to this engine
 	qasContextList &ctxList = contexts[engine];
 	for( qasContextList::iterator it = ctxList.begin(); it != ctxList.end(); it++ ) {
-		asIScriptContext *ctx = *it;
-		if( ctx->GetState() == asEXECUTION_FINISHED ) {
-			return ctx;
+		if( qasContextIsIdle( it->ctx ) ) {
+			it->func = NULL;
+			return it->ctx;
 		}
 	}
 
@@ -497,6 +531,60 @@ asIScriptContext *qasAcquireContext( asIScriptEngine *engine ) {
 	return qasCreateContext( engine );
 }
 
+/*
+* qasAcquirePreparedContext
+*
+* Returns an idle context prepared for func, or NULL if Prepare failed.
+* Contexts that last ran the same function are preferred, AngelScript only
+* resets the stack for those instead of setting up the call from scratch.
+*/
+asIScriptContext *qasAcquirePreparedContext( asIScriptEngine *engine, asIScriptFunction *func ) {
+	if( !engine || !func ) {
+		return NULL;
+	}
+
+	qasContextList &ctxList = contexts[engine];
+	qasPooledContext_t *pooled = NULL;
+	for( qasContextList::iterator it = ctxList.begin(); it != ctxList.end(); it++ ) {
+		if( !qasContextIsIdle( it->ctx ) ) {
+			continue;
+		}
+		if( it->func == func ) {
+			pooled = &*it;
+			break;
+		}
+		if( !pooled ) {
+			pooled = &*it;
+		}
+	}
+
+	if( !pooled ) {
+		if( !qasCreateContext( engine ) ) {
+			return NULL;
+		}
+		pooled = &ctxList.back();
+	}
+
+	pooled->func = NULL;
+	if( pooled->ctx->Prepare( func ) < 0 ) {
+		return NULL;
+	}
+	pooled->func = func;
+
+	return pooled->ctx;
+}
+
+/*
+* qasAttachProfilerToContexts
+*/
+void qasAttachProfilerToContexts( void ) {
+	for( qasEngineContextMap::iterator it = contexts.begin(); it != contexts.end(); it++ ) {
+		for( qasContextList::iterator ctxIt = it->second.begin(); ctxIt != it->second.end(); ctxIt++ ) {
+			qasProfileAttach( ctxIt->ctx );
+		}
+	}
+}
+
 asIScriptContext *qasGetActiveContext( void ) {
 	return asGetActiveContext();
 }
@@ -546,6 +634,228 @@ static char *qasLoadScriptSection( const char *rootDir, const char *dir, const c
 	return (char *)data;
 }
 
+/*************************************
+* Bytecode cache
+**************************************/
+
+#define QAS_BYTECODE_MAGIC      "ASBC"
+#define QAS_BYTECODE_VERSION    2
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t engine;        // qasHashEngineDeclarations when the cache was written
+	uint32_t key;
+	uint32_t size;
+} qasByteCodeHeader_t;
+
+class qasByteCodeWriter : public asIBinaryStream {
+public:
+	std::vector<uint8_t> data;
+
+	void Write( const void *ptr, asUINT size ) {
+		const uint8_t *bytes = ( const uint8_t * )ptr;
+		data.insert( data.end(), bytes, bytes + size );
+	}
+
+	void Read( void *ptr, asUINT size ) {
+	}
+};
+
+class qasByteCodeReader : public asIBinaryStream {
+public:
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	bool overrun;
+
+	qasByteCodeReader( const uint8_t *data_, size_t size_ ) : data( data_ ), size( size_ ), pos( 0 ), overrun( false ) { }
+
+	void Write( const void *ptr, asUINT size ) {
+	}
+
+	void Read( void *ptr, asUINT len ) {
+		if( overrun || len > size - pos ) {
+			// the loader doesn't check for short reads, hand it zeros and fail afterwards
+			memset( ptr, 0, len );
+			overrun = true;
+			return;
+		}
+		memcpy( ptr, data + pos, len );
+		pos += len;
+	}
+};
+
+/*
+* qasHashString
+*/
+static uint32_t qasHashString( const char *str, uint32_t hash ) {
+	if( !str ) {
+		return hash;
+	}
+	return Hash32( str, strlen( str ) + 1, hash );
+}
+
+/*
+* qasHashEngineDeclarations
+*
+* Bytecode refers to the application interface by declaration, so a cache
+* written by a build that registered anything differently can't be loaded.
+*/
+static uint32_t qasHashEngineDeclarations( asIScriptEngine *asEngine ) {
+	uint32_t hash = Hash32( APP_VERSION );
+	hash = qasHashString( ANGELSCRIPT_VERSION_STRING, hash );
+
+	for( asUINT i = 0; i < asEngine->GetObjectTypeCount(); i++ ) {
+		asIObjectType *type = asEngine->GetObjectTypeByIndex( i );
+		hash = qasHashString( type->GetNamespace(), hash );
+		hash = qasHashString( type->GetName(), hash );
+		asQWORD layout = ( asQWORD( type->GetFlags() ) << 32 ) | type->GetSize();
+		hash = Hash32( &layout, sizeof( layout ), hash );
+
+		for( asUINT j = 0; j < type->GetFactoryCount(); j++ ) {
+			hash = qasHashString( type->GetFactoryByIndex( j )->GetDeclaration( true, true ), hash );
+		}
+		for( asUINT j = 0; j < type->GetBehaviourCount(); j++ ) {
+			asEBehaviours behaviour;
+			asIScriptFunction *func = type->GetBehaviourByIndex( j, &behaviour );
+			hash = Hash32( &behaviour, sizeof( behaviour ), hash );
+			hash = qasHashString( func->GetDeclaration( true, true ), hash );
+		}
+		for( asUINT j = 0; j < type->GetMethodCount(); j++ ) {
+			hash = qasHashString( type->GetMethodByIndex( j )->GetDeclaration( true, true ), hash );
+		}
+		for( asUINT j = 0; j < type->GetPropertyCount(); j++ ) {
+			hash = qasHashString( type->GetPropertyDeclaration( j, true ), hash );
+		}
+	}
+
+	for( asUINT i = 0; i < asEngine->GetEnumCount(); i++ ) {
+		int typeId;
+		const char *nameSpace;
+		hash = qasHashString( asEngine->GetEnumByIndex( i, &typeId, &nameSpace ), hash );
+		hash = qasHashString( nameSpace, hash );
+
+		for( int j = 0; j < asEngine->GetEnumValueCount( typeId ); j++ ) {
+			int value;
+			hash = qasHashString( asEngine->GetEnumValueByIndex( typeId, j, &value ), hash );
+			hash = Hash32( &value, sizeof( value ), hash );
+		}
+	}
+
+	for( asUINT i = 0; i < asEngine->GetFuncdefCount(); i++ ) {
+		hash = qasHashString( asEngine->GetFuncdefByIndex( i )->GetDeclaration( true, true ), hash );
+	}
+
+	for( asUINT i = 0; i < asEngine->GetTypedefCount(); i++ ) {
+		int typeId;
+		const char *nameSpace;
+		hash = qasHashString( asEngine->GetTypedefByIndex( i, &typeId, &nameSpace ), hash );
+		hash = qasHashString( nameSpace, hash );
+		hash = qasHashString( asEngine->GetTypeDeclaration( typeId, true ), hash );
+	}
+
+	for( asUINT i = 0; i < asEngine->GetGlobalFunctionCount(); i++ ) {
+		hash = qasHashString( asEngine->GetGlobalFunctionByIndex( i )->GetDeclaration( true, true ), hash );
+	}
+
+	for( asUINT i = 0; i < asEngine->GetGlobalPropertyCount(); i++ ) {
+		const char *name, *nameSpace;
+		int typeId;
+		bool isConst;
+		asEngine->GetGlobalPropertyByIndex( i, &name, &nameSpace, &typeId, &isConst );
+		hash = qasHashString( nameSpace, hash );
+		hash = qasHashString( name, hash );
+		hash = qasHashString( asEngine->GetTypeDeclaration( typeId, true ), hash );
+		hash = Hash32( &isConst, sizeof( isConst ), hash );
+	}
+
+	return hash;
+}
+
+/*
+* qasByteCodeCacheName
+*/
+static void qasByteCodeCacheName( const char *scriptName, char *cacheName, size_t cacheNameSize ) {
+	Q_snprintfz( cacheName, cacheNameSize, "cache/scripts/%s", scriptName );
+	COM_StripExtension( cacheName );
+	Q_strncatz( cacheName, ".asb", cacheNameSize );
+}
+
+/*
+* qasLoadByteCode
+*
+* Loads the module from the bytecode cache if it was compiled from the same sources
+* against the same application interface.
+*/
+static bool qasLoadByteCode( asIScriptModule *asModule, const char *cacheName, uint32_t engine, uint32_t key ) {
+	int length, filenum;
+	qasByteCodeHeader_t header;
+	uint8_t *data;
+	bool ok;
+
+	length = trap_FS_FOpenFile( cacheName, &filenum, FS_READ | FS_CACHE );
+	if( length == -1 ) {
+		return false;
+	}
+
+	if( length < ( int )sizeof( header ) || trap_FS_Read( &header, sizeof( header ), filenum ) != sizeof( header ) ) {
+		trap_FS_FCloseFile( filenum );
+		return false;
+	}
+
+	if( memcmp( header.magic, QAS_BYTECODE_MAGIC, sizeof( header.magic ) ) || header.version != QAS_BYTECODE_VERSION
+		|| header.engine != engine || header.key != key || header.size != length - sizeof( header ) ) {
+		trap_FS_FCloseFile( filenum );
+		return false;
+	}
+
+	data = ( uint8_t * )qasAlloc( header.size + 1 );
+	ok = trap_FS_Read( data, header.size, filenum ) == ( int )header.size;
+	trap_FS_FCloseFile( filenum );
+
+	if( ok ) {
+		qasByteCodeReader stream( data, header.size );
+		ok = asModule->LoadByteCode( &stream ) >= 0 && !stream.overrun;
+	}
+
+	qasFree( data );
+
+	if( !ok ) {
+		Com_Printf( S_COLOR_YELLOW "* Bytecode cache '%s' is stale, recompiling\n", cacheName );
+	}
+
+	return ok;
+}
+
+/*
+* qasSaveByteCode
+*/
+static void qasSaveByteCode( asIScriptModule *asModule, const char *cacheName, uint32_t engine, uint32_t key ) {
+	int filenum;
+	qasByteCodeHeader_t header;
+	qasByteCodeWriter stream;
+
+	// keep debug info so runtime errors still report sections and lines
+	if( asModule->SaveByteCode( &stream ) < 0 || stream.data.empty() ) {
+		return;
+	}
+
+	if( trap_FS_FOpenFile( cacheName, &filenum, FS_WRITE | FS_CACHE ) == -1 ) {
+		return;
+	}
+
+	memcpy( header.magic, QAS_BYTECODE_MAGIC, sizeof( header.magic ) );
+	header.version = QAS_BYTECODE_VERSION;
+	header.engine = engine;
+	header.key = key;
+	header.size = stream.data.size();
+
+	trap_FS_Write( &header, sizeof( header ), filenum );
+	trap_FS_Write( &stream.data[0], stream.data.size(), filenum );
+	trap_FS_FCloseFile( filenum );
+}
+
 /*
 * qasBuildScriptProject
 */
@@ -553,6 +863,10 @@ static asIScriptModule *qasBuildScriptProject( asIScriptEngine *asEngine, const
 	int error;
 	int numSections, sectionNum;
 	char *section;
+	char **sections;
+	char cacheName[MAX_QPATH];
+	uint32_t engine, key;
+	int64_t startTime;
 	asIScriptModule *asModule;
 
 	if( asEngine == NULL ) {
@@ -568,29 +882,82 @@ static asIScriptModule *qasBuildScriptProject( asIScriptEngine *asEngine, const
 		return NULL;
 	}
 
-	// load up the script sections
+	startTime = trap_Milliseconds();
+
+	// load up the script sections, the bytecode cache is keyed by their names and contents
+	// on top of the registered application interface
+	sections = QAS_NEWARRAY( char *, numSections );
+	engine = qasHashEngineDeclarations( asEngine );
+	key = engine;
+	for( sectionNum = 0; sectionNum < numSections; sectionNum++ ) {
+		section = qasLoadScriptSection( rootDir, dir, script, sectionNum );
+		if( !section ) {
+			break;
+		}
+
+		const char *sectionName = COM_ListNameForPosition( script, sectionNum, QAS_SECTIONS_SEPARATOR );
+		key = Hash32( sectionName, strlen( sectionName ), key );
+		key = Hash32( section, strlen( section ), key );
+		sections[sectionNum] = section;
+	}
+
+	if( sectionNum != numSections ) {
+		Com_Printf( S_COLOR_RED "* Error: couldn't load all script sections.\n" );
+		while( sectionNum-- ) {
+			qasFree( sections[sectionNum] );
+		}
+		QAS_DELETEARRAY( sections );
+		return NULL;
+	}
 
-	asModule = asEngine->GetModule( moduleName, asGM_CREATE_IF_NOT_EXISTS );
+	asModule = asEngine->GetModule( moduleName, asGM_ALWAYS_CREATE );
 	if( asModule == NULL ) {
 		Com_Printf( S_COLOR_RED "qasBuildGameScript: GetModule '%s' failed\n", moduleName );
+		for( sectionNum = 0; sectionNum < numSections; sectionNum++ ) {
+			qasFree( sections[sectionNum] );
+		}
+		QAS_DELETEARRAY( sections );
 		return NULL;
 	}
 
-	for( sectionNum = 0; ( section = qasLoadScriptSection( rootDir, dir, script, sectionNum ) ) != NULL; sectionNum++ ) {
-		const char *sectionName = COM_ListNameForPosition( script, sectionNum, QAS_SECTIONS_SEPARATOR );
-		error = asModule->AddScriptSection( sectionName, section, strlen( section ) );
+	qasByteCodeCacheName( scriptName, cacheName, sizeof( cacheName ) );
+	if( qasLoadByteCode( asModule, cacheName, engine, key ) ) {
+		for( sectionNum = 0; sectionNum < numSections; sectionNum++ ) {
+			qasFree( sections[sectionNum] );
+		}
+		QAS_DELETEARRAY( sections );
 
-		qasFree( section );
+		if( developer->integer ) {
+			Com_Printf( "* Loaded script '%s' from bytecode in %" PRIi64 "ms\n", scriptName, trap_Milliseconds() - startTime );
+		}
+		return asModule;
+	}
 
-		if( error ) {
-			Com_Printf( S_COLOR_RED "* Failed to add the script section %s with error %i\n", sectionName, error );
-			asEngine->DiscardModule( moduleName );
-			return NULL;
+	// a failed load may leave a partially filled module behind
+	asModule = asEngine->GetModule( moduleName, asGM_ALWAYS_CREATE );
+	if( asModule == NULL ) {
+		Com_Printf( S_COLOR_RED "qasBuildGameScript: GetModule '%s' failed\n", moduleName );
+		for( sectionNum = 0; sectionNum < numSections; sectionNum++ ) {
+			qasFree( sections[sectionNum] );
+		}
+		QAS_DELETEARRAY( sections );
+		return NULL;
+	}
+
+	error = 0;
+	for( sectionNum = 0; sectionNum < numSections; sectionNum++ ) {
+		const char *sectionName = COM_ListNameForPosition( script, sectionNum, QAS_SECTIONS_SEPARATOR );
+		if( !error ) {
+			error = asModule->AddScriptSection( sectionName, sections[sectionNum], strlen( sections[sectionNum] ) );
+			if( error ) {
+				Com_Printf( S_COLOR_RED "* Failed to add the script section %s with error %i\n", sectionName, error );
+			}
 		}
+		qasFree( sections[sectionNum] );
 	}
+	QAS_DELETEARRAY( sections );
 
-	if( sectionNum != numSections ) {
-		Com_Printf( S_COLOR_RED "* Error: couldn't load all script sections.\n" );
+	if( error ) {
 		asEngine->DiscardModule( moduleName );
 		return NULL;
 	}
@@ -602,6 +969,11 @@ static asIScriptModule *qasBuildScriptProject( asIScriptEngine *asEngine, const
 		return NULL;
 	}
 
+	qasSaveByteCode( asModule, cacheName, engine, key );
+
+	if( developer->integer ) {
+		Com_Printf( "* Compiled script '%s' in %" PRIi64 "ms\n", scriptName, trap_Milliseconds() - startTime );
+	}
 	return asModule;
 }
 
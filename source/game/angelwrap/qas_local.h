@@ -53,9 +53,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 /******* C++ objects *******/
 asIScriptEngine *qasCreateEngine( bool *asMaxPortability );
 asIScriptContext *qasAcquireContext( asIScriptEngine *engine );
+asIScriptContext *qasAcquirePreparedContext( asIScriptEngine *engine, asIScriptFunction *func );
 void qasReleaseContext( asIScriptContext *ctx );
 void qasReleaseEngine( asIScriptEngine *engine );
 asIScriptContext *qasGetActiveContext( void );
+void qasAttachProfilerToContexts( void );
 void qasWriteEngineDocsToFile( asIScriptEngine *engine, const char *path, bool singleFile, bool markdown, unsigned andMask, unsigned notMask );
 
 // array tools
@@ -67,5 +69,13 @@ asstring_t *qasStringFactoryBuffer( const char *buffer, unsigned int length );
 void qasStringRelease( asstring_t *str );
 asstring_t *qasStringAssignString( asstring_t *self, const char *string, unsigned int strlen );
 
+// profiler
+void qasProfileAttach( asIScriptContext * ctx );
+bool qasIsProfiling();
+void qasSetProfiling( bool enable );
+int qasExecuteContext( asIScriptContext * ctx );
+void qasResetProfile();
+void qasDumpProfile( const char * filename, int maxLines );
+
 // projects / bundles
 asIScriptModule *qasLoadScriptProject( asIScriptEngine *engine, const char *moduleName, const char *rootDir, const char *dir, const char *filename, const char *ext );
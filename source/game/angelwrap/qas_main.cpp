@@ -28,8 +28,14 @@ struct angelwrap_api_s *QAS_GetAngelExport() {
 	angelExport.asWriteEngineDocsToFile = qasWriteEngineDocsToFile;
 
 	angelExport.asAcquireContext = qasAcquireContext;
+	angelExport.asAcquirePreparedContext = qasAcquirePreparedContext;
 	angelExport.asReleaseContext = qasReleaseContext;
 	angelExport.asGetActiveContext = qasGetActiveContext;
+	angelExport.asExecuteContext = qasExecuteContext;
+
+	angelExport.asSetProfiling = qasSetProfiling;
+	angelExport.asResetProfile = qasResetProfile;
+	angelExport.asDumpProfile = qasDumpProfile;
 
 	angelExport.asStringFactoryBuffer = qasStringFactoryBuffer;
 	angelExport.asStringRelease = qasStringRelease;
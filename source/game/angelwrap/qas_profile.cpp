@@ -0,0 +1,265 @@
+#include "qas_local.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * The profiler is driven by the context line callback, which is only
+ * installed while profiling is enabled, so scripts run untouched otherwise.
+ *
+ * Every line cue reads the microsecond clock and charges the time since the
+ * previous event to the previous call stack. Statements shorter than a clock
+ * tick are charged whenever they straddle one, which makes the collapsed
+ * stacks an unbiased sample of where script time goes. Calls and inclusive
+ * times come from diffing the call stack between events, so two calls to the
+ * same function within one statement of the caller count as one call.
+ */
+
+struct ProfileFunc {
+	uint64_t calls;
+	uint64_t self;
+	uint64_t inclusive;
+};
+
+struct ProfileFrame {
+	asIScriptFunction * func;
+	uint64_t enter_time;
+};
+
+typedef std::vector< asIScriptFunction * > ProfileStackKey;
+
+static bool profiling;
+
+static std::map< asIScriptFunction *, ProfileFunc > profile_funcs;
+static std::map< ProfileStackKey, uint64_t > profile_stacks;
+
+static std::vector< ProfileFrame > stack;
+static std::vector< size_t > execute_bases;
+static ProfileStackKey new_stack;
+static ProfileStackKey stack_key;
+static uint64_t last_time;
+
+static ProfileFunc * GetProfileFunc( asIScriptFunction * func ) {
+	std::map< asIScriptFunction *, ProfileFunc >::iterator it = profile_funcs.find( func );
+	if( it != profile_funcs.end() ) {
+		return &it->second;
+	}
+
+	// keep the function alive so the pointer can't be reused after its module is discarded
+	func->AddRef();
+	ProfileFunc pf = { 0, 0, 0 };
+	return &profile_funcs.insert( std::make_pair( func, pf ) ).first->second;
+}
+
+static bool StackContains( asIScriptFunction * func ) {
+	for( size_t i = 0; i < stack.size(); i++ ) {
+		if( stack[ i ].func == func ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Charge the time since the last event to the current stack, then make
+ * new_stack the current stack.
+ */
+static void UpdateStack() {
+	uint64_t now = trap_Microseconds();
+
+	if( !stack.empty() && now > last_time ) {
+		uint64_t dt = now - last_time;
+
+		stack_key.resize( stack.size() );
+		for( size_t i = 0; i < stack.size(); i++ ) {
+			stack_key[ i ] = stack[ i ].func;
+		}
+		profile_stacks[ stack_key ] += dt;
+		GetProfileFunc( stack.back().func )->self += dt;
+	}
+
+	size_t common = 0;
+	while( common < stack.size() && common < new_stack.size() && stack[ common ].func == new_stack[ common ] ) {
+		common++;
+	}
+
+	while( stack.size() > common ) {
+		ProfileFrame frame = stack.back();
+		stack.pop_back();
+
+		// recursive calls are only counted once towards inclusive time
+		if( !StackContains( frame.func ) ) {
+			GetProfileFunc( frame.func )->inclusive += now - frame.enter_time;
+		}
+	}
+
+	for( size_t i = common; i < new_stack.size(); i++ ) {
+		GetProfileFunc( new_stack[ i ] )->calls++;
+		ProfileFrame frame = { new_stack[ i ], now };
+		stack.push_back( frame );
+	}
+
+	last_time = now;
+}
+
+static void CopyBaseStack( size_t base ) {
+	new_stack.clear();
+	for( size_t i = 0; i < base && i < stack.size(); i++ ) {
+		new_stack.push_back( stack[ i ].func );
+	}
+}
+
+static void LineCallback( asIScriptContext * ctx ) {
+	CopyBaseStack( execute_bases.empty() ? 0 : execute_bases.back() );
+	for( asUINT level = ctx->GetCallstackSize(); level > 0; level-- ) {
+		asIScriptFunction * func = ctx->GetFunction( level - 1 );
+		if( func != NULL ) {
+			new_stack.push_back( func );
+		}
+	}
+	UpdateStack();
+}
+
+void qasProfileAttach( asIScriptContext * ctx ) {
+	if( profiling ) {
+		ctx->SetLineCallback( asFUNCTION( LineCallback ), NULL, asCALL_CDECL );
+	} else {
+		ctx->ClearLineCallback();
+	}
+}
+
+bool qasIsProfiling() {
+	return profiling;
+}
+
+void qasSetProfiling( bool enable ) {
+	if( profiling == enable ) {
+		return;
+	}
+
+	profiling = enable;
+	qasAttachProfilerToContexts();
+
+	if( enable ) {
+		Com_Printf( "Script profiling enabled\n" );
+	} else {
+		Com_Printf( "Script profiling disabled\n" );
+	}
+}
+
+/*
+ * qasExecuteContext
+ */
+int qasExecuteContext( asIScriptContext * ctx ) {
+	if( !profiling ) {
+		return ctx->Execute();
+	}
+
+	// the time until the first line cue belongs to the prepared function
+	size_t base = stack.size();
+	CopyBaseStack( base );
+	asIScriptFunction * func = ctx->GetFunction();
+	if( func != NULL ) {
+		new_stack.push_back( func );
+	}
+	UpdateStack();
+	execute_bases.push_back( base );
+
+	int error = ctx->Execute();
+
+	execute_bases.pop_back();
+	CopyBaseStack( base );
+	UpdateStack();
+
+	return error;
+}
+
+void qasResetProfile() {
+	for( std::map< asIScriptFunction *, ProfileFunc >::iterator it = profile_funcs.begin(); it != profile_funcs.end(); it++ ) {
+		it->first->Release();
+	}
+
+	profile_funcs.clear();
+	profile_stacks.clear();
+	stack.clear();
+	execute_bases.clear();
+}
+
+static std::string FunctionName( asIScriptFunction * func ) {
+	std::string name;
+	const char * ns = func->GetNamespace();
+	if( ns != NULL && ns[ 0 ] != '\0' ) {
+		name += ns;
+		name += "::";
+	}
+	if( func->GetObjectName() != NULL ) {
+		name += func->GetObjectName();
+		name += "::";
+	}
+	name += func->GetName();
+	return name;
+}
+
+struct FlatEntry {
+	asIScriptFunction * func;
+	ProfileFunc pf;
+};
+
+static bool FlatEntryBySelfTime( const FlatEntry & a, const FlatEntry & b ) {
+	return a.pf.self > b.pf.self;
+}
+
+/*
+ * qasDumpProfile
+ *
+ * Prints the flat profile sorted by self time and writes the collapsed
+ * stacks, one "a;b;c microseconds" line per stack, ready for flamegraph.pl
+ */
+void qasDumpProfile( const char * filename, int maxLines ) {
+	if( profile_funcs.empty() ) {
+		Com_Printf( "No script profile data%s\n", profiling ? "" : ", set g_asProfile 1 to collect some" );
+		return;
+	}
+
+	std::vector< FlatEntry > flat;
+	uint64_t total = 0;
+	for( std::map< asIScriptFunction *, ProfileFunc >::iterator it = profile_funcs.begin(); it != profile_funcs.end(); it++ ) {
+		FlatEntry e = { it->first, it->second };
+		flat.push_back( e );
+		total += it->second.self;
+	}
+	std::sort( flat.begin(), flat.end(), FlatEntryBySelfTime );
+
+	Com_Printf( "%10s %10s %6s %10s  %s\n", "calls", "self ms", "self%", "incl ms", "function" );
+	for( size_t i = 0; i < flat.size() && int( i ) < maxLines; i++ ) {
+		const FlatEntry & e = flat[ i ];
+		Com_Printf( "%10" PRIu64 " %10.2f %6.2f %10.2f  %s\n", e.pf.calls, e.pf.self / 1000.0,
+			total > 0 ? 100.0 * e.pf.self / total : 0.0, e.pf.inclusive / 1000.0, FunctionName( e.func ).c_str() );
+	}
+	Com_Printf( "%.2f ms in scripts\n", total / 1000.0 );
+
+	int filenum;
+	if( trap_FS_FOpenFile( filename, &filenum, FS_WRITE ) == -1 ) {
+		Com_Printf( S_COLOR_RED "Couldn't write %s\n", filename );
+		return;
+	}
+
+	std::string line;
+	for( std::map< ProfileStackKey, uint64_t >::iterator it = profile_stacks.begin(); it != profile_stacks.end(); it++ ) {
+		line.clear();
+		for( size_t i = 0; i < it->first.size(); i++ ) {
+			if( i > 0 ) {
+				line += ';';
+			}
+			line += FunctionName( it->first[ i ] );
+		}
+		line += va( " %" PRIu64 "\n", it->second );
+		trap_FS_Write( line.c_str(), line.size(), filenum );
+	}
+
+	trap_FS_FCloseFile( filenum );
+
+	Com_Printf( "Wrote %s\n", filename );
+}
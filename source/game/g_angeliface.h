@@ -125,8 +125,15 @@ typedef struct angelwrap_api_s {
 
 	// context
 	asIScriptContext *( *asAcquireContext )( asIScriptEngine * engine );
+	asIScriptContext *( *asAcquirePreparedContext )( asIScriptEngine * engine, asIScriptFunction * func );
 	void ( *asReleaseContext )( asIScriptContext *context );
 	asIScriptContext *( *asGetActiveContext )( void );
+	int ( *asExecuteContext )( asIScriptContext *context );
+
+	// profiler
+	void ( *asSetProfiling )( bool enable );
+	void ( *asResetProfile )( void );
+	void ( *asDumpProfile )( const char *filename, int maxLines );
 
 	// strings
 	asstring_t *( *asStringFactoryBuffer )( const char *buffer, unsigned int length );
@@ -68,14 +68,12 @@ void GT_asCallSpawn( void ) {
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.spawnFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.spawnFunc ) );
+	if( !ctx ) {
 		return;
 	}
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -90,14 +88,12 @@ void GT_asCallMatchStateStarted( void ) {
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.matchStateStartedFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.matchStateStartedFunc ) );
+	if( !ctx ) {
 		return;
 	}
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -113,17 +109,15 @@ bool GT_asCallMatchStateFinished( int incomingMatchState ) {
 		return true;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.matchStateFinishedFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.matchStateFinishedFunc ) );
+	if( !ctx ) {
 		return true;
 	}
 
 	// Now we need to pass the parameters to the script function.
 	ctx->SetArgDWord( 0, incomingMatchState );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -143,14 +137,12 @@ void GT_asCallThinkRules( void ) {
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.thinkRulesFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.thinkRulesFunc ) );
+	if( !ctx ) {
 		return;
 	}
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -165,10 +157,8 @@ void GT_asCallPlayerRespawn( edict_t *ent, int old_team, int new_team ) {
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.playerRespawnFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.playerRespawnFunc ) );
+	if( !ctx ) {
 		return;
 	}
 
@@ -177,7 +167,7 @@ void GT_asCallPlayerRespawn( edict_t *ent, int old_team, int new_team ) {
 	ctx->SetArgDWord( 1, old_team );
 	ctx->SetArgDWord( 2, new_team );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -201,10 +191,8 @@ void GT_asCallScoreEvent( gclient_t *client, const char *score_event, const char
 		args = "";
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.scoreEventFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.scoreEventFunc ) );
+	if( !ctx ) {
 		return;
 	}
 
@@ -216,7 +204,7 @@ void GT_asCallScoreEvent( gclient_t *client, const char *score_event, const char
 	ctx->SetArgObject( 1, s1 );
 	ctx->SetArgObject( 2, s2 );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -238,17 +226,15 @@ void GT_asCallScoreboardMessage( unsigned int maxlen ) {
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.scoreboardMessageFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.scoreboardMessageFunc ) );
+	if( !ctx ) {
 		return;
 	}
 
 	// Now we need to pass the parameters to the script function.
 	ctx->SetArgDWord( 0, maxlen );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -269,17 +255,15 @@ edict_t *GT_asCallSelectSpawnPoint( edict_t *ent ) {
 	if( !level.gametype.selectSpawnPointFunc ) {
 		return NULL;
 	}
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.selectSpawnPointFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.selectSpawnPointFunc ) );
+	if( !ctx ) {
 		return NULL;
 	}
 
 	// Now we need to pass the parameters to the script function.
 	ctx->SetArgObject( 0, ent );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -303,10 +287,8 @@ bool GT_asCallGameCommand( gclient_t *client, const char *cmd, const char *args,
 		return false;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.clientCommandFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.clientCommandFunc ) );
+	if( !ctx ) {
 		return false;
 	}
 
@@ -319,7 +301,7 @@ bool GT_asCallGameCommand( gclient_t *client, const char *cmd, const char *args,
 	ctx->SetArgObject( 2, s2 );
 	ctx->SetArgDWord( 3, argc );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -340,14 +322,12 @@ void GT_asCallShutdown( void ) {
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.shutdownFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.shutdownFunc ) );
+	if( !ctx ) {
 		return;
 	}
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -475,14 +455,12 @@ static bool G_asInitializeGametypeScript( asIScriptModule *asModule ) {
 	// execute the GT_InitGametype function
 	//
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( static_cast<asIScriptFunction *>( level.gametype.initFunc ) );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, static_cast<asIScriptFunction *>( level.gametype.initFunc ) );
+	if( !ctx ) {
 		return false;
 	}
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		return false;
 	}
@@ -2624,16 +2624,15 @@ bool G_asCallMapEntitySpawnScript( const char *classname, edict_t *ent ) {
 	G_asClearEntityBehaviors( ent );
 
 	// call the spawn function
-	asContext = game.asExport->asAcquireContext( asEngine );
-	error = asContext->Prepare( asSpawnFunc );
-	if( error < 0 ) {
+	asContext = game.asExport->asAcquirePreparedContext( asEngine, asSpawnFunc );
+	if( !asContext ) {
 		return false;
 	}
 
 	// Now we need to pass the parameters to the script function.
 	asContext->SetArgObject( 0, ent );
 
-	error = asContext->Execute();
+	error = game.asExport->asExecuteContext( asContext );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 		ent->asScriptModule = NULL;
@@ -2710,17 +2709,15 @@ void G_asCallMapEntityThink( edict_t *ent ) {
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( ent->asThinkFunc );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, ent->asThinkFunc );
+	if( !ctx ) {
 		return;
 	}
 
 	// Now we need to pass the parameters to the script function.
 	ctx->SetArgObject( 0, ent );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -2736,10 +2733,8 @@ void G_asCallMapEntityTouch( edict_t *ent, edict_t *other, cplane_t *plane, int
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( ent->asTouchFunc );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, ent->asTouchFunc );
+	if( !ctx ) {
 		return;
 	}
 
@@ -2755,7 +2750,7 @@ void G_asCallMapEntityTouch( edict_t *ent, edict_t *other, cplane_t *plane, int
 	ctx->SetArgObject( 2, &normal );
 	ctx->SetArgDWord( 3, surfFlags );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -2770,10 +2765,8 @@ void G_asCallMapEntityUse( edict_t *ent, edict_t *other, edict_t *activator ) {
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( ent->asUseFunc );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, ent->asUseFunc );
+	if( !ctx ) {
 		return;
 	}
 
@@ -2782,7 +2775,7 @@ void G_asCallMapEntityUse( edict_t *ent, edict_t *other, edict_t *activator ) {
 	ctx->SetArgObject( 1, other );
 	ctx->SetArgObject( 2, activator );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -2797,10 +2790,8 @@ void G_asCallMapEntityPain( edict_t *ent, edict_t *other, float kick, float dama
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( ent->asPainFunc );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, ent->asPainFunc );
+	if( !ctx ) {
 		return;
 	}
 
@@ -2810,7 +2801,7 @@ void G_asCallMapEntityPain( edict_t *ent, edict_t *other, float kick, float dama
 	ctx->SetArgFloat( 2, kick );
 	ctx->SetArgFloat( 3, damage );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -2825,10 +2816,8 @@ void G_asCallMapEntityDie( edict_t *ent, edict_t *inflicter, edict_t *attacker,
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( ent->asDieFunc );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, ent->asDieFunc );
+	if( !ctx ) {
 		return;
 	}
 
@@ -2837,7 +2826,7 @@ void G_asCallMapEntityDie( edict_t *ent, edict_t *inflicter, edict_t *attacker,
 	ctx->SetArgObject( 1, inflicter );
 	ctx->SetArgObject( 2, attacker );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -2852,17 +2841,15 @@ void G_asCallMapEntityStop( edict_t *ent ) {
 		return;
 	}
 
-	ctx = game.asExport->asAcquireContext( game.asEngine );
-
-	error = ctx->Prepare( ent->asStopFunc );
-	if( error < 0 ) {
+	ctx = game.asExport->asAcquirePreparedContext( game.asEngine, ent->asStopFunc );
+	if( !ctx ) {
 		return;
 	}
 
 	// Now we need to pass the parameters to the script function.
 	ctx->SetArgObject( 0, ent );
 
-	error = ctx->Execute();
+	error = game.asExport->asExecuteContext( ctx );
 	if( G_ExecutionErrorReport( error ) ) {
 		GT_asShutdownScript();
 	}
@@ -3198,6 +3185,37 @@ void G_asGarbageCollect( bool force ) {
 	}
 }
 
+/*
+* G_asUpdateProfiler
+*/
+void G_asUpdateProfiler( void ) {
+	if( !g_asProfile->modified || !game.asExport ) {
+		return;
+	}
+
+	game.asExport->asSetProfiling( g_asProfile->integer != 0 );
+	g_asProfile->modified = false;
+}
+
+/*
+* G_asProfile_f
+*
+* Print the script profile and write the collapsed stacks, or reset it
+*/
+void G_asProfile_f( void ) {
+	if( !game.asExport ) {
+		return;
+	}
+
+	if( !Q_stricmp( trap_Cmd_Argv( 1 ), "reset" ) ) {
+		game.asExport->asResetProfile();
+		G_Printf( "Script profile reset\n" );
+		return;
+	}
+
+	game.asExport->asDumpProfile( "asprofile.folded", 30 );
+}
+
 /*
 * G_asDumpAPIToFile
 *
@@ -49,15 +49,69 @@ typedef struct
 	vec3_t mins;
 	vec3_t maxs;
 	vec3_t size;
-	int marknumber;
 
-	// since the areagrid can have multiple references to one entity,
-	// we should avoid extensive checking on entities already encountered
-	int entmarknumber[MAX_EDICTS];
+	// the cells each entity was linked into and when, links are appended to
+	// the cell lists so two entities sharing cells are in link order in all of them
+	int entgridmins[MAX_EDICTS][2];
+	int entgridmaxs[MAX_EDICTS][2];
+	bool entoutside[MAX_EDICTS];
+	int64_t entlinkseq[MAX_EDICTS];
+	int64_t linkseq;
 } areagrid_t;
 
 static areagrid_t g_areagrid;
 
+// since the areagrid can have multiple references to one entity, we should
+// avoid extensive checking on entities already encountered. the marks are
+// per thread so client moves can query the grid concurrently, and the mark
+// number only ever goes up so they never need clearing
+static thread_local int g_areamarknumber;
+static thread_local int g_areaentmarknumber[MAX_EDICTS];
+
+// the bounds of every area query made on this thread since
+// GClip_BeginQueryRecord, see G_RunClients
+typedef struct {
+	bool active;
+	bool any;
+	vec3_t mins, maxs;
+} areaqueryrecord_t;
+
+static thread_local areaqueryrecord_t g_areaqueryrecord;
+
+// linked solid triggers are also kept in a small bounding volume tree, so
+// touch queries only look at triggers instead of every entity in the cells
+// they cover. relinking a trigger refits its entry and the nodes above it,
+// the tree is only rebuilt by the first query after the set of triggers
+// changed, which past spawn is mostly items being picked up and respawning
+#define TRIGGER_LEAF_SIZE   4
+#define TRIGGER_MAX_DEPTH   32
+
+typedef struct {
+	int entNum;
+	vec3_t mins, maxs;      // absmin and absmax when it was linked
+} triggerent_t;
+
+typedef struct {
+	vec3_t mins, maxs;
+	int firstent, numents;  // range of ents below this node
+	int skip;               // node to continue at when the box misses
+} triggernode_t;
+
+typedef struct {
+	bool member[MAX_EDICTS];    // linked as SOLID_TRIGGER
+	int slot[MAX_EDICTS];       // 1 + position in ents, 0 if not in the tree
+	int mismatched;             // entities whose member and slot disagree
+	int numbuilds;
+
+	int numents;
+	triggerent_t ents[MAX_EDICTS];
+
+	int numnodes;
+	triggernode_t nodes[MAX_EDICTS * 2];
+} triggerindex_t;
+
+static triggerindex_t g_triggerindex;
+
 #define CFRAME_UPDATE_BACKUP    64  // copies of entity_state_t to keep buffered (1 second of backup at 62 fps).
 #define CFRAME_UPDATE_MASK  ( CFRAME_UPDATE_BACKUP - 1 )
 
@@ -78,6 +132,20 @@ typedef struct c4frame_s {
 c4frame_t sv_collisionframes[CFRAME_UPDATE_BACKUP];
 static int64_t sv_collisionFrameNum = 0;
 
+/*
+* GClip_SetTriggerMember
+*/
+static void GClip_SetTriggerMember( triggerindex_t *index, int entNum, bool member ) {
+	if( index->member[entNum] == member ) {
+		return;
+	}
+
+	// an unlink followed by a link leaves the set as it was
+	bool indexed = index->slot[entNum] != 0;
+	index->mismatched += member != indexed ? 1 : -1;
+	index->member[entNum] = member;
+}
+
 void GClip_BackUpCollisionFrame( void ) {
 	c4frame_t *cframe;
 	edict_t *svedict;
@@ -96,6 +164,9 @@ void GClip_BackUpCollisionFrame( void ) {
 	for( i = 0; i < game.numentities; i++ ) {
 		svedict = &game.edicts[i];
 
+		// catch solid changes that weren't followed by a relink
+		GClip_SetTriggerMember( &g_triggerindex, i, svedict->linked && svedict->r.solid == SOLID_TRIGGER );
+
 		cframe->clipEdicts[i].r.inuse = svedict->r.inuse;
 		cframe->clipEdicts[i].r.solid = svedict->r.solid;
 		if( !svedict->r.inuse || svedict->r.solid == SOLID_NOT
@@ -109,11 +180,11 @@ void GClip_BackUpCollisionFrame( void ) {
 	cframe->numedicts = game.numentities;
 }
 
-static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime ) {
-	static int index = 0;
-	static c4clipedict_t clipEnts[8];
-	static c4clipedict_t *clipent;
-	static c4clipedict_t clipentNewer; // for interpolation
+static c4clipedict_t *GClip_ResolveClipEdictForDeltaTime( int entNum, int deltaTime ) {
+	static thread_local int index = 0;
+	static thread_local c4clipedict_t clipEnts[8];
+	c4clipedict_t *clipent;
+	c4clipedict_t clipentNewer; // for interpolation
 	c4frame_t *cframe = NULL;
 	int64_t backTime, cframenum;
 	unsigned bf, i;
@@ -217,6 +288,48 @@ static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime
 	return clipent;
 }
 
+// traces made between GClip_BeginTraceBatch and GClip_EndTraceBatch resolve
+// every entity once for the batch time delta, find their entities among the
+// ones gathered from the grid when the batch began, start their world descent
+// at the deepest node that holds the batch box, and skip the exact clip
+// against boxes beyond what they already hit
+typedef struct {
+	bool active;
+	int timeDelta;
+	vec3_t mins, maxs;
+	int headnode;
+
+	int stamp;
+	int entstamp[MAX_EDICTS];
+	c4clipedict_t clipEdicts[MAX_EDICTS];
+
+	// solid entities linked where the batch traces can look, so their area
+	// queries don't have to walk the grid again
+	vec3_t areamins, areamaxs;
+	int numareaents;
+	int areaents[MAX_EDICTS];
+} c4tracebatch_t;
+
+static c4tracebatch_t sv_tracebatch;
+
+/*
+* GClip_GetClipEdictForDeltaTime
+*/
+static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime ) {
+	c4tracebatch_t *batch = &sv_tracebatch;
+
+	if( !batch->active || deltaTime != batch->timeDelta ) {
+		return GClip_ResolveClipEdictForDeltaTime( entNum, deltaTime );
+	}
+
+	if( batch->entstamp[entNum] != batch->stamp ) {
+		batch->clipEdicts[entNum] = *GClip_ResolveClipEdictForDeltaTime( entNum, deltaTime );
+		batch->entstamp[entNum] = batch->stamp;
+	}
+
+	return &batch->clipEdicts[entNum];
+}
+
 // ClearLink is used for new headnodes
 static void GClip_ClearLink( link_t *l ) {
 	l->prev = l->next = l;
@@ -243,11 +356,6 @@ static void GClip_InsertLinkBefore( link_t *l, link_t *before, int entNum ) {
 static void GClip_Init_AreaGrid( areagrid_t *areagrid, const vec3_t world_mins, const vec3_t world_maxs ) {
 	int i;
 
-	// the areagrid_marknumber is not allowed to be 0
-	if( areagrid->marknumber < 1 ) {
-		areagrid->marknumber = 1;
-	}
-
 	// choose either the world box size, or a larger box to ensure the grid isn't too fine
 	areagrid->size[0] = max( world_maxs[0] - world_mins[0], AREA_GRID * AREA_GRIDMINSIZE );
 	areagrid->size[1] = max( world_maxs[1] - world_mins[1], AREA_GRID * AREA_GRIDMINSIZE );
@@ -272,8 +380,6 @@ static void GClip_Init_AreaGrid( areagrid_t *areagrid, const vec3_t world_mins,
 		GClip_ClearLink( &areagrid->grid[i] );
 	}
 
-	memset( areagrid->entmarknumber, 0, sizeof( areagrid->entmarknumber ) );
-
 	if( developer->integer ) {
 		Com_Printf( "areagrid settings: divisions %ix%ix1 : box %f %f %f "
 					": %f %f %f size %f %f %f grid %f %f %f (mingrid %f)\n",
@@ -322,14 +428,23 @@ static void GClip_LinkEntity_AreaGrid( areagrid_t *areagrid, edict_t *ent ) {
 	igridmaxs[1] = (int) floor( ( ent->r.absmax[1] + areagrid->bias[1] ) * areagrid->scale[1] ) + 1;
 
 	//igridmaxs[2] = (int) floor( (ent->r.absmax[2] + areagrid->bias[2]) * areagrid->scale[2] ) + 1;
+	areagrid->entlinkseq[entitynumber] = ++areagrid->linkseq;
+
 	if( igridmins[0] < 0 || igridmaxs[0] > AREA_GRID
 		|| igridmins[1] < 0 || igridmaxs[1] > AREA_GRID
 		|| ( ( igridmaxs[0] - igridmins[0] ) * ( igridmaxs[1] - igridmins[1] ) ) > MAX_ENT_AREAS ) {
 		// wow, something outside the grid, store it as such
 		GClip_InsertLinkBefore( &ent->areagrid[0], &areagrid->outside, entitynumber );
+		areagrid->entoutside[entitynumber] = true;
 		return;
 	}
 
+	areagrid->entoutside[entitynumber] = false;
+	areagrid->entgridmins[entitynumber][0] = igridmins[0];
+	areagrid->entgridmins[entitynumber][1] = igridmins[1];
+	areagrid->entgridmaxs[entitynumber][0] = igridmaxs[0];
+	areagrid->entgridmaxs[entitynumber][1] = igridmaxs[1];
+
 	gridnum = 0;
 	for( igrid[1] = igridmins[1]; igrid[1] < igridmaxs[1]; igrid[1]++ ) {
 		grid = areagrid->grid + igrid[1] * AREA_GRID + igridmins[0];
@@ -338,6 +453,70 @@ static void GClip_LinkEntity_AreaGrid( areagrid_t *areagrid, edict_t *ent ) {
 	}
 }
 
+/*
+* GClip_BoundsInside
+*/
+static bool GClip_BoundsInside( const vec3_t mins, const vec3_t maxs, const vec3_t outermins, const vec3_t outermaxs ) {
+	return mins[0] >= outermins[0] && mins[1] >= outermins[1] && mins[2] >= outermins[2]
+		   && maxs[0] <= outermaxs[0] && maxs[1] <= outermaxs[1] && maxs[2] <= outermaxs[2];
+}
+
+/*
+* GClip_EntitiesInBox_TraceBatch
+*
+* Lists the batch entities that GClip_EntitiesInBox_AreaGrid would find for
+* an AREA_SOLID query, in the same order: the outside list first, then by the
+* first cell of the query rect each entity was met in, then by link order
+*/
+static int GClip_EntitiesInBox_TraceBatch( areagrid_t *areagrid, const vec3_t mins, const vec3_t maxs,
+										   int *list, int maxcount ) {
+	const c4tracebatch_t *batch = &sv_tracebatch;
+	int64_t keys[MAX_EDICTS];
+	int igridmins[2], igridmaxs[2], cell[2];
+	int i, j, entNum, numlist;
+	int64_t key;
+
+	igridmins[0] = max( 0, (int) floor( ( mins[0] + areagrid->bias[0] ) * areagrid->scale[0] ) );
+	igridmins[1] = max( 0, (int) floor( ( mins[1] + areagrid->bias[1] ) * areagrid->scale[1] ) );
+	igridmaxs[0] = min( AREA_GRID, (int) floor( ( maxs[0] + areagrid->bias[0] ) * areagrid->scale[0] ) + 1 );
+	igridmaxs[1] = min( AREA_GRID, (int) floor( ( maxs[1] + areagrid->bias[1] ) * areagrid->scale[1] ) + 1 );
+
+	numlist = 0;
+	for( i = 0; i < batch->numareaents; i++ ) {
+		entNum = batch->areaents[i];
+
+		if( areagrid->entoutside[entNum] ) {
+			key = 0;
+		} else {
+			cell[0] = max( igridmins[0], areagrid->entgridmins[entNum][0] );
+			cell[1] = max( igridmins[1], areagrid->entgridmins[entNum][1] );
+			if( cell[0] >= min( igridmaxs[0], areagrid->entgridmaxs[entNum][0] )
+				|| cell[1] >= min( igridmaxs[1], areagrid->entgridmaxs[entNum][1] ) ) {
+				continue;
+			}
+			key = 1 + cell[1] * AREA_GRID + cell[0];
+		}
+
+		const c4clipedict_t *clipEnt = &batch->clipEdicts[entNum];
+		if( !BoundsOverlap( mins, maxs, clipEnt->r.absmin, clipEnt->r.absmax ) ) {
+			continue;
+		}
+
+		key = ( key << 40 ) | areagrid->entlinkseq[entNum];
+
+		// insertion sort, the lists are short
+		for( j = numlist; j > 0 && keys[j - 1] > key; j-- ) {
+			keys[j] = keys[j - 1];
+			list[j] = list[j - 1];
+		}
+		keys[j] = key;
+		list[j] = entNum;
+		numlist++;
+	}
+
+	return min( numlist, maxcount );
+}
+
 /*
 * GClip_EntitiesInBox_AreaGrid
 */
@@ -353,9 +532,15 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 	VectorCopy( mins, paddedmins );
 	VectorCopy( maxs, paddedmaxs );
 
-	// FIXME: if areagrid_marknumber wraps, all entities need their
-	// ent->priv.server->areagridmarknumber reset
-	areagrid->marknumber++;
+	if( sv_tracebatch.active && areatype == AREA_SOLID && timeDelta == sv_tracebatch.timeDelta
+		&& maxcount >= sv_tracebatch.numareaents
+		&& GClip_BoundsInside( mins, maxs, sv_tracebatch.areamins, sv_tracebatch.areamaxs ) ) {
+		return GClip_EntitiesInBox_TraceBatch( areagrid, mins, maxs, list, maxcount );
+	}
+
+	// FIXME: if g_areamarknumber wraps, all entities need their
+	// mark reset
+	g_areamarknumber++;
 
 	igridmins[0] = (int) floor( ( paddedmins[0] + areagrid->bias[0] ) * areagrid->scale[0] );
 	igridmins[1] = (int) floor( ( paddedmins[1] + areagrid->bias[1] ) * areagrid->scale[1] );
@@ -386,10 +571,10 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 		for( l = grid->next; l != grid; l = l->next ) {
 			clipEnt = GClip_GetClipEdictForDeltaTime( l->entNum, timeDelta );
 
-			if( areagrid->entmarknumber[l->entNum] == areagrid->marknumber ) {
+			if( g_areaentmarknumber[l->entNum] == g_areamarknumber ) {
 				continue;
 			}
-			areagrid->entmarknumber[l->entNum] = areagrid->marknumber;
+			g_areaentmarknumber[l->entNum] = g_areamarknumber;
 
 			if( !clipEnt->r.inuse ) {
 				continue; // deactivated
@@ -423,10 +608,10 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 			for( l = grid->next; l != grid; l = l->next ) {
 				clipEnt = GClip_GetClipEdictForDeltaTime( l->entNum, timeDelta );
 
-				if( areagrid->entmarknumber[l->entNum] == areagrid->marknumber ) {
+				if( g_areaentmarknumber[l->entNum] == g_areamarknumber ) {
 					continue;
 				}
-				areagrid->entmarknumber[l->entNum] = areagrid->marknumber;
+				g_areaentmarknumber[l->entNum] = g_areamarknumber;
 
 				if( !clipEnt->r.inuse ) {
 					continue; // deactivated
@@ -452,6 +637,346 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 	return numlist;
 }
 
+static int trigger_sortaxis;
+
+/*
+* GClip_CompareTriggerEnts
+*/
+static int GClip_CompareTriggerEnts( const void *a, const void *b ) {
+	const triggerent_t *ta = (const triggerent_t *)a;
+	const triggerent_t *tb = (const triggerent_t *)b;
+	float ca = ta->mins[trigger_sortaxis] + ta->maxs[trigger_sortaxis];
+	float cb = tb->mins[trigger_sortaxis] + tb->maxs[trigger_sortaxis];
+
+	if( ca != cb ) {
+		return ca < cb ? -1 : 1;
+	}
+	return ta->entNum - tb->entNum;
+}
+
+/*
+* GClip_BuildTriggerNode
+*
+* Builds the subtree for a range of triggers in depth first order, splitting
+* at the median along the axis their centers spread the most on
+*/
+static void GClip_BuildTriggerNode( triggerindex_t *index, int firstent, int numents ) {
+	triggernode_t *node = &index->nodes[index->numnodes++];
+	vec3_t cmins, cmaxs;
+	int i, axis;
+
+	node->firstent = firstent;
+	node->numents = numents;
+	ClearBounds( node->mins, node->maxs );
+	ClearBounds( cmins, cmaxs );
+	for( i = firstent; i < firstent + numents; i++ ) {
+		const triggerent_t *te = &index->ents[i];
+		vec3_t center;
+
+		AddPointToBounds( te->mins, node->mins, node->maxs );
+		AddPointToBounds( te->maxs, node->mins, node->maxs );
+		VectorAdd( te->mins, te->maxs, center );
+		AddPointToBounds( center, cmins, cmaxs );
+	}
+
+	if( numents > TRIGGER_LEAF_SIZE ) {
+		axis = 0;
+		for( i = 1; i < 3; i++ ) {
+			if( cmaxs[i] - cmins[i] > cmaxs[axis] - cmins[axis] ) {
+				axis = i;
+			}
+		}
+
+		trigger_sortaxis = axis;
+		qsort( index->ents + firstent, numents, sizeof( *index->ents ), GClip_CompareTriggerEnts );
+
+		GClip_BuildTriggerNode( index, firstent, numents / 2 );
+		GClip_BuildTriggerNode( index, firstent + numents / 2, numents - numents / 2 );
+	}
+
+	// the node pointer is still valid, the nodes array is never reallocated
+	node->skip = index->numnodes;
+}
+
+/*
+* GClip_ClearTriggerIndex
+*/
+static void GClip_ClearTriggerIndex( triggerindex_t *index ) {
+	memset( index->member, 0, sizeof( index->member ) );
+	memset( index->slot, 0, sizeof( index->slot ) );
+	index->mismatched = 0;
+	index->numents = 0;
+	index->numnodes = 0;
+}
+
+/*
+* GClip_BuildTriggerIndex
+*/
+static void GClip_BuildTriggerIndex( triggerindex_t *index ) {
+	for( int i = 0; i < index->numents; i++ ) {
+		index->slot[index->ents[i].entNum] = 0;
+	}
+
+	index->numents = 0;
+	index->numnodes = 0;
+	index->mismatched = 0;
+	index->numbuilds++;
+
+	for( int i = 1; i < game.numentities; i++ ) {
+		const edict_t *ent = EDICT_NUM( i );
+		triggerent_t *te;
+
+		if( !index->member[i] ) {
+			continue;
+		}
+
+		te = &index->ents[index->numents++];
+		te->entNum = i;
+		VectorCopy( ent->r.absmin, te->mins );
+		VectorCopy( ent->r.absmax, te->maxs );
+	}
+
+	if( index->numents ) {
+		GClip_BuildTriggerNode( index, 0, index->numents );
+	}
+
+	// the build sorts the ents
+	for( int i = 0; i < index->numents; i++ ) {
+		index->slot[index->ents[i].entNum] = i + 1;
+	}
+}
+
+/*
+* GClip_UpdateTriggerIndex
+*/
+static void GClip_UpdateTriggerIndex( triggerindex_t *index ) {
+	if( index->mismatched > 0 ) {
+		GClip_BuildTriggerIndex( index );
+	}
+}
+
+/*
+* GClip_RefitTrigger
+*
+* Moves a trigger that's already in the tree to its new bounds, and refits
+* the nodes above it from the bottom up
+*/
+static void GClip_RefitTrigger( triggerindex_t *index, int entNum, const vec3_t mins, const vec3_t maxs ) {
+	int path[TRIGGER_MAX_DEPTH];
+	int depth = 0;
+	int slot = index->slot[entNum] - 1;
+	triggerent_t *te = &index->ents[slot];
+
+	if( VectorCompare( te->mins, mins ) && VectorCompare( te->maxs, maxs ) ) {
+		return;
+	}
+	VectorCopy( mins, te->mins );
+	VectorCopy( maxs, te->maxs );
+
+	// the left child follows its parent and the right one follows the left's subtree
+	for( int n = 0; ; ) {
+		const triggernode_t *node = &index->nodes[n];
+
+		path[depth++] = n;
+		if( node->numents <= TRIGGER_LEAF_SIZE ) {
+			break;
+		}
+
+		const triggernode_t *left = node + 1;
+		n = slot < left->firstent + left->numents ? n + 1 : left->skip;
+	}
+
+	while( depth-- ) {
+		triggernode_t *node = &index->nodes[path[depth]];
+
+		ClearBounds( node->mins, node->maxs );
+		if( node->numents <= TRIGGER_LEAF_SIZE ) {
+			for( int i = node->firstent; i < node->firstent + node->numents; i++ ) {
+				AddPointToBounds( index->ents[i].mins, node->mins, node->maxs );
+				AddPointToBounds( index->ents[i].maxs, node->mins, node->maxs );
+			}
+		} else {
+			const triggernode_t *left = node + 1;
+			const triggernode_t *right = &index->nodes[left->skip];
+
+			AddPointToBounds( left->mins, node->mins, node->maxs );
+			AddPointToBounds( left->maxs, node->mins, node->maxs );
+			AddPointToBounds( right->mins, node->mins, node->maxs );
+			AddPointToBounds( right->maxs, node->mins, node->maxs );
+		}
+	}
+}
+
+/*
+* GClip_EntitiesInBox_TriggerIndex
+*
+* Lists the triggers that GClip_EntitiesInBox_AreaGrid would find for an
+* AREA_TRIGGERS query at the current time, in the same order
+*/
+static int GClip_EntitiesInBox_TriggerIndex( areagrid_t *areagrid, triggerindex_t *index, const vec3_t mins, const vec3_t maxs,
+											 int *list, int maxcount ) {
+	int64_t keys[MAX_EDICTS];
+	int igridmins[2], igridmaxs[2], cell[2];
+	int i, j, entNum, numlist;
+	int64_t key;
+
+	igridmins[0] = max( 0, (int) floor( ( mins[0] + areagrid->bias[0] ) * areagrid->scale[0] ) );
+	igridmins[1] = max( 0, (int) floor( ( mins[1] + areagrid->bias[1] ) * areagrid->scale[1] ) );
+	igridmaxs[0] = min( AREA_GRID, (int) floor( ( maxs[0] + areagrid->bias[0] ) * areagrid->scale[0] ) + 1 );
+	igridmaxs[1] = min( AREA_GRID, (int) floor( ( maxs[1] + areagrid->bias[1] ) * areagrid->scale[1] ) + 1 );
+
+	numlist = 0;
+	for( int n = 0; n < index->numnodes; ) {
+		const triggernode_t *node = &index->nodes[n];
+
+		if( !BoundsOverlap( mins, maxs, node->mins, node->maxs ) ) {
+			n = node->skip;
+			continue;
+		}
+		if( node->numents > TRIGGER_LEAF_SIZE ) {
+			n++;
+			continue;
+		}
+
+		for( i = node->firstent; i < node->firstent + node->numents; i++ ) {
+			const edict_t *ent;
+
+			if( !BoundsOverlap( mins, maxs, index->ents[i].mins, index->ents[i].maxs ) ) {
+				continue;
+			}
+
+			entNum = index->ents[i].entNum;
+			ent = EDICT_NUM( entNum );
+			if( !ent->r.inuse || ent->r.solid != SOLID_TRIGGER ) {
+				continue;
+			}
+
+			if( areagrid->entoutside[entNum] ) {
+				key = 0;
+			} else {
+				cell[0] = max( igridmins[0], areagrid->entgridmins[entNum][0] );
+				cell[1] = max( igridmins[1], areagrid->entgridmins[entNum][1] );
+				if( cell[0] >= min( igridmaxs[0], areagrid->entgridmaxs[entNum][0] )
+					|| cell[1] >= min( igridmaxs[1], areagrid->entgridmaxs[entNum][1] ) ) {
+					continue;
+				}
+				key = 1 + cell[1] * AREA_GRID + cell[0];
+			}
+
+			if( !BoundsOverlap( mins, maxs, ent->r.absmin, ent->r.absmax ) ) {
+				continue;
+			}
+
+			key = ( key << 40 ) | areagrid->entlinkseq[entNum];
+
+			// insertion sort, the lists are short
+			for( j = numlist; j > 0 && keys[j - 1] > key; j-- ) {
+				keys[j] = keys[j - 1];
+				list[j] = list[j - 1];
+			}
+			keys[j] = key;
+			list[j] = entNum;
+			numlist++;
+		}
+
+		n = node->skip;
+	}
+
+	return min( numlist, maxcount );
+}
+
+
+/*
+* GClip_GatherTraceBatchLinks
+*/
+static int GClip_GatherTraceBatchLinks( areagrid_t *areagrid, link_t *grid, int *list, int numlist, int timeDelta ) {
+	link_t *l;
+	const c4clipedict_t *clipEnt;
+
+	if( !grid->next ) {
+		return numlist;
+	}
+
+	for( l = grid->next; l != grid; l = l->next ) {
+		if( g_areaentmarknumber[l->entNum] == g_areamarknumber ) {
+			continue;
+		}
+		g_areaentmarknumber[l->entNum] = g_areamarknumber;
+
+		clipEnt = GClip_GetClipEdictForDeltaTime( l->entNum, timeDelta );
+		if( !clipEnt->r.inuse || clipEnt->r.solid == SOLID_TRIGGER || clipEnt->r.solid == SOLID_NOT ) {
+			continue;
+		}
+
+		list[numlist++] = l->entNum;
+	}
+
+	return numlist;
+}
+
+/*
+* GClip_GatherTraceBatch
+*
+* Every solid entity linked into the outside list or the cells of the box,
+* whether it overlaps the box or not
+*/
+static int GClip_GatherTraceBatch( areagrid_t *areagrid, const vec3_t mins, const vec3_t maxs, int *list, int timeDelta ) {
+	int igrid[2], igridmins[2], igridmaxs[2];
+	int numlist;
+
+	g_areamarknumber++;
+
+	igridmins[0] = max( 0, (int) floor( ( mins[0] + areagrid->bias[0] ) * areagrid->scale[0] ) );
+	igridmins[1] = max( 0, (int) floor( ( mins[1] + areagrid->bias[1] ) * areagrid->scale[1] ) );
+	igridmaxs[0] = min( AREA_GRID, (int) floor( ( maxs[0] + areagrid->bias[0] ) * areagrid->scale[0] ) + 1 );
+	igridmaxs[1] = min( AREA_GRID, (int) floor( ( maxs[1] + areagrid->bias[1] ) * areagrid->scale[1] ) + 1 );
+
+	numlist = GClip_GatherTraceBatchLinks( areagrid, &areagrid->outside, list, 0, timeDelta );
+	for( igrid[1] = igridmins[1]; igrid[1] < igridmaxs[1]; igrid[1]++ ) {
+		for( igrid[0] = igridmins[0]; igrid[0] < igridmaxs[0]; igrid[0]++ ) {
+			numlist = GClip_GatherTraceBatchLinks( areagrid, areagrid->grid + igrid[1] * AREA_GRID + igrid[0], list, numlist, timeDelta );
+		}
+	}
+
+	return numlist;
+}
+
+/*
+* GClip_BeginTraceBatch
+*
+* Nothing may move, relink or change solidity until the batch ends, so end it
+* around anything that can, like G_Damage. Traces that leave the box are still
+* correct, they just descend the world from the root.
+*/
+void GClip_BeginTraceBatch( const vec3_t mins, const vec3_t maxs, int timeDelta ) {
+	c4tracebatch_t *batch = &sv_tracebatch;
+
+	assert( !batch->active );
+
+	batch->stamp++;
+	if( batch->stamp <= 0 ) {
+		memset( batch->entstamp, 0, sizeof( batch->entstamp ) );
+		batch->stamp = 1;
+	}
+
+	batch->active = true;
+	batch->timeDelta = timeDelta;
+	VectorCopy( mins, batch->mins );
+	VectorCopy( maxs, batch->maxs );
+	batch->headnode = trap_CM_BoxHeadnode( mins, maxs );
+
+	// area queries pad trace bounds by one unit
+	VectorSet( batch->areamins, mins[0] - 1, mins[1] - 1, mins[2] - 1 );
+	VectorSet( batch->areamaxs, maxs[0] + 1, maxs[1] + 1, maxs[2] + 1 );
+	batch->numareaents = GClip_GatherTraceBatch( &g_areagrid, batch->areamins, batch->areamaxs, batch->areaents, timeDelta );
+}
+
+/*
+* GClip_EndTraceBatch
+*/
+void GClip_EndTraceBatch( void ) {
+	sv_tracebatch.active = false;
+}
 
 /*
 * GClip_ClearWorld
@@ -465,6 +990,8 @@ void GClip_ClearWorld( void ) {
 	trap_CM_InlineModelBounds( world_model, world_mins, world_maxs );
 
 	GClip_Init_AreaGrid( &g_areagrid, world_mins, world_maxs );
+
+	GClip_ClearTriggerIndex( &g_triggerindex );
 }
 
 /*
@@ -478,6 +1005,8 @@ void GClip_UnlinkEntity( edict_t *ent ) {
 	}
 	GClip_UnlinkEntity_AreaGrid( ent );
 	ent->linked = false;
+
+	GClip_SetTriggerMember( &g_triggerindex, ENTNUM( ent ), false );
 }
 
 /*
@@ -631,6 +1160,13 @@ void GClip_LinkEntity( edict_t *ent ) {
 	ent->linked = true;
 
 	GClip_LinkEntity_AreaGrid( &g_areagrid, ent );
+
+	if( ent->r.solid == SOLID_TRIGGER ) {
+		GClip_SetTriggerMember( &g_triggerindex, ENTNUM( ent ), true );
+		if( g_triggerindex.slot[ENTNUM( ent )] != 0 ) {
+			GClip_RefitTrigger( &g_triggerindex, ENTNUM( ent ), ent->r.absmin, ent->r.absmax );
+		}
+	}
 }
 
 /*
@@ -662,14 +1198,80 @@ void GClip_SetAreaPortalState( edict_t *ent, bool open ) {
 */
 int GClip_AreaEdicts( const vec3_t mins, const vec3_t maxs,
 					  int *list, int maxcount, int areatype, int timeDelta ) {
+	areaqueryrecord_t *record = &g_areaqueryrecord;
 	int count;
 
+	if( record->active ) {
+		AddPointToBounds( mins, record->mins, record->maxs );
+		AddPointToBounds( maxs, record->mins, record->maxs );
+		record->any = true;
+	}
+
+	if( areatype == AREA_TRIGGERS && timeDelta == 0 ) {
+		GClip_UpdateTriggerIndex( &g_triggerindex );
+		if( maxcount >= g_triggerindex.numents ) {
+			return GClip_EntitiesInBox_TriggerIndex( &g_areagrid, &g_triggerindex, mins, maxs, list, maxcount );
+		}
+	}
+
 	count = GClip_EntitiesInBox_AreaGrid( &g_areagrid, mins, maxs,
 										  list, maxcount, areatype, timeDelta );
 
 	return min( count, maxcount );
 }
 
+/*
+* GClip_BeginQueryRecord
+*
+* Starts gathering the bounds of the area queries made on this thread
+*/
+void GClip_BeginQueryRecord( void ) {
+	areaqueryrecord_t *record = &g_areaqueryrecord;
+
+	record->active = true;
+	record->any = false;
+	ClearBounds( record->mins, record->maxs );
+}
+
+/*
+* GClip_EndQueryRecord
+*
+* Returns false if no area was queried since GClip_BeginQueryRecord
+*/
+bool GClip_EndQueryRecord( vec3_t mins, vec3_t maxs ) {
+	areaqueryrecord_t *record = &g_areaqueryrecord;
+
+	record->active = false;
+	VectorCopy( record->mins, mins );
+	VectorCopy( record->maxs, maxs );
+
+	return record->any;
+}
+
+/*
+* GClip_SaveEntity
+*
+* Everything about an entity an area query or a clip against it can see,
+* including where it is in the link order of the grid cells
+*/
+void GClip_SaveEntity( int entNum, gclipentity_t *saved ) {
+	const edict_t *ent = EDICT_NUM( entNum );
+
+	memcpy( &saved->s, &ent->s, sizeof( saved->s ) );
+	memcpy( &saved->r, &ent->r, sizeof( saved->r ) );
+	saved->linkseq = g_areagrid.entlinkseq[entNum];
+}
+
+/*
+* GClip_EntityChanged
+*/
+bool GClip_EntityChanged( int entNum, const gclipentity_t *saved ) {
+	const edict_t *ent = EDICT_NUM( entNum );
+
+	return memcmp( &saved->s, &ent->s, sizeof( saved->s ) ) != 0 || memcmp( &saved->r, &ent->r, sizeof( saved->r ) ) != 0
+		|| saved->linkseq != g_areagrid.entlinkseq[entNum];
+}
+
 /*
 * GClip_CollisionModelForEntity
 *
@@ -749,6 +1351,9 @@ typedef struct {
 	int contentmask;
 } moveclip_t;
 
+static void GClip_TraceBounds( const vec3_t start, const vec3_t mins, const vec3_t maxs,
+							   const vec3_t end, vec3_t boxmins, vec3_t boxmaxs );
+
 /*
 * GClip_ClipMoveToEntities
 */
@@ -759,6 +1364,8 @@ typedef struct {
 	trace_t trace;
 	struct cmodel_s *cmodel;
 	const float *angles;
+	vec3_t hitend, hitmins, hitmaxs, entmins, entmaxs;
+	float hitfraction = -1;
 
 	num = GClip_AreaEdicts( clip->boxmins, clip->boxmaxs, touchlist, MAX_EDICTS, AREA_SOLID, timeDelta );
 
@@ -798,6 +1405,22 @@ typedef struct {
 			}
 		}
 
+		if( sv_tracebatch.active && !ISBRUSHMODEL( touch->s.modelindex ) ) {
+			// a box the move can't reach before what it already hit can't change
+			// the result, only strictly nearer hits or starting inside count
+			if( hitfraction != clip->trace->fraction ) {
+				hitfraction = clip->trace->fraction;
+				VectorLerp( clip->start, hitfraction, clip->end, hitend );
+				GClip_TraceBounds( clip->start, clip->mins, clip->maxs, hitend, hitmins, hitmaxs );
+			}
+
+			VectorAdd( touch->s.origin, touch->r.mins, entmins );
+			VectorAdd( touch->s.origin, touch->r.maxs, entmaxs );
+			if( !BoundsOverlap( hitmins, hitmaxs, entmins, entmaxs ) ) {
+				continue;
+			}
+		}
+
 		// might intersect, so do an exact clip
 		cmodel = GClip_CollisionModelForEntity( &touch->s, &touch->r );
 
@@ -842,6 +1465,29 @@ static void GClip_TraceBounds( const vec3_t start, const vec3_t mins, const vec3
 	}
 }
 
+/*
+* GClip_TraceWorld
+*/
+static void GClip_TraceWorld( trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs,
+							  const vec3_t end, int contentmask ) {
+	const c4tracebatch_t *batch = &sv_tracebatch;
+	vec3_t movemins, movemaxs;
+
+	if( batch->active ) {
+		for( int i = 0; i < 3; i++ ) {
+			movemins[i] = min( start[i], end[i] ) + mins[i];
+			movemaxs[i] = max( start[i], end[i] ) + maxs[i];
+		}
+
+		if( GClip_BoundsInside( movemins, movemaxs, batch->mins, batch->maxs ) ) {
+			trap_CM_HeadnodeBoxTrace( tr, start, end, mins, maxs, contentmask, batch->headnode );
+			return;
+		}
+	}
+
+	trap_CM_TransformedBoxTrace( tr, start, end, mins, maxs, NULL, contentmask, NULL, NULL );
+}
+
 /*
 * G_Trace
 *
@@ -880,7 +1526,7 @@ static void GClip_Trace( trace_t *tr, const vec3_t start, const vec3_t mins, con
 		tr->ent = -1;
 	} else {
 		// clip to world
-		trap_CM_TransformedBoxTrace( tr, start, end, mins, maxs, NULL, contentmask, NULL, NULL );
+		GClip_TraceWorld( tr, start, mins, maxs, end, contentmask );
 		tr->ent = tr->fraction < 1.0 ? world->s.number : -1;
 		if( tr->fraction == 0 ) {
 			return; // blocked by the world
@@ -1100,6 +1746,109 @@ void G_PMoveTouchTriggers( pmove_t *pm, vec3_t previous_origin ) {
 	}
 }
 
+typedef struct {
+	vec3_t mins, maxs;
+	int lists[2][MAX_EDICTS];   // areagrid, trigger index
+	int counts[2];
+} triggertest_t;
+
+static bool G_TriggerTestPlayer( const edict_t *ent ) {
+	return ent->linked;
+}
+
+static void G_TriggerTestPass( void *data, bool indexed ) {
+	triggertest_t *t = ( triggertest_t * )data;
+
+	if( indexed ) {
+		t->counts[1] = GClip_AreaEdicts( t->mins, t->maxs, t->lists[1], MAX_EDICTS, AREA_TRIGGERS, 0 );
+	} else {
+		t->counts[0] = GClip_EntitiesInBox_AreaGrid( &g_areagrid, t->mins, t->maxs, t->lists[0], MAX_EDICTS, AREA_TRIGGERS, 0 );
+	}
+}
+
+/*
+* G_TriggerTest_f
+*
+* Runs the touch queries of every player against the trigger index and the
+* areagrid and compares them, along with boxes dropped on random triggers
+* so the lists aren't all empty. Every other round a random trigger is moved
+* and relinked first, and put back afterwards, which has to refit the tree
+* without rebuilding it
+*/
+void G_TriggerTest_f( void ) {
+	static triggertest_t t;
+	comparetest_t test;
+	int queries = 0, hits = 0, moves = 0;
+
+	if( !G_CompareTest_Begin( &test, "triggertest", "indexed", G_TriggerTestPlayer ) ) {
+		return;
+	}
+
+	GClip_UpdateTriggerIndex( &g_triggerindex );
+	int numbuilds = g_triggerindex.numbuilds;
+
+	for( int n = 0; n < test.count; n++ ) {
+		edict_t *moved = NULL;
+		vec3_t oldorigin;
+
+		if( ( n & 1 ) && g_triggerindex.numents > 0 ) {
+			moved = EDICT_NUM( g_triggerindex.ents[rand() % g_triggerindex.numents].entNum );
+			VectorCopy( moved->s.origin, oldorigin );
+			moved->s.origin[0] += crandom() * 256;
+			moved->s.origin[1] += crandom() * 256;
+			moved->s.origin[2] += crandom() * 64;
+			GClip_LinkEntity( moved );
+			moves++;
+		}
+
+		for( int p = 0; p < test.numplayers; p++ ) {
+			const edict_t *ent = PLAYERENT( test.players[p] );
+
+			// the player, a random trigger, and the moved trigger
+			for( int b = 0; b < 3; b++ ) {
+				if( b == 0 ) {
+					VectorCopy( ent->r.absmin, t.mins );
+					VectorCopy( ent->r.absmax, t.maxs );
+				} else {
+					vec3_t center;
+
+					if( b == 1 && g_triggerindex.numents > 0 ) {
+						const triggerent_t *te = &g_triggerindex.ents[rand() % g_triggerindex.numents];
+						VectorAdd( te->mins, te->maxs, center );
+					} else if( b == 2 && moved != NULL ) {
+						VectorAdd( moved->r.absmin, moved->r.absmax, center );
+					} else {
+						continue;
+					}
+
+					VectorScale( center, 0.5f, center );
+					VectorAdd( center, ent->r.mins, t.mins );
+					VectorAdd( center, ent->r.maxs, t.maxs );
+				}
+
+				G_CompareTest_Run( &test, n, G_TriggerTestPass, &t );
+
+				queries++;
+				hits += t.counts[0];
+				if( t.counts[0] != t.counts[1] || memcmp( t.lists[0], t.lists[1], t.counts[0] * sizeof( int ) ) ) {
+					test.mismatches++;
+					G_Printf( "triggertest: box %s %s: plain %i, indexed %i\n", vtos( t.mins ), vtos( t.maxs ), t.counts[0], t.counts[1] );
+				}
+			}
+		}
+
+		if( moved != NULL ) {
+			VectorCopy( oldorigin, moved->s.origin );
+			GClip_LinkEntity( moved );
+		}
+	}
+
+	G_Printf( "triggertest: %i players, %i triggers in %i nodes\n", test.numplayers, g_triggerindex.numents, g_triggerindex.numnodes );
+	G_Printf( "triggertest: %i triggers moved, %i rebuilds\n", moves, g_triggerindex.numbuilds - numbuilds );
+	G_Printf( "triggertest: %i queries, %i triggers found, %i mismatches\n", queries, hits, test.mismatches );
+	G_CompareTest_Report( &test, queries, "queries" );
+}
+
 /*
 * GClip_FindInRadius4D
 * Returns entities that have their boxes within a spherical area
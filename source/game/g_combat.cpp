@@ -47,6 +47,48 @@ int G_ModToAmmo( int mod ) {
 	}
 }
 
+/*
+* G_SplashOrigin
+*/
+static void G_SplashOrigin( const edict_t *inflictor, const cplane_t *plane, vec3_t origin ) {
+	if( plane ) {
+		// up by 9 units to account for stairs
+		VectorMA( inflictor->s.origin, 9, plane->normal, origin );
+	} else {
+		VectorCopy( inflictor->s.origin, origin );
+	}
+}
+
+/*
+* G_SplashTraceBounds
+*
+* Box holding every trace G_CanSplashDamage can make against the touched entities
+*/
+static void G_SplashTraceBounds( const edict_t *inflictor, const cplane_t *plane, const int *touch, int numtouch,
+								 vec3_t mins, vec3_t maxs ) {
+	vec3_t origin, entmins, entmaxs;
+	const edict_t *ent;
+
+	G_SplashOrigin( inflictor, plane, origin );
+
+	ClearBounds( mins, maxs );
+	AddPointToBounds( origin, mins, maxs );
+
+	for( int i = 0; i < numtouch; i++ ) {
+		ent = game.edicts + touch[i];
+		if( !ent->takedamage ) {
+			continue;
+		}
+
+		// players are traced to their origin and 15 units around it
+		VectorSet( entmins, ent->r.absmin[0] - 16, ent->r.absmin[1] - 16, ent->r.absmin[2] );
+		VectorSet( entmaxs, ent->r.absmax[0] + 16, ent->r.absmax[1] + 16, ent->r.absmax[2] );
+		AddPointToBounds( entmins, mins, maxs );
+		AddPointToBounds( entmaxs, mins, maxs );
+		AddPointToBounds( ent->s.origin, mins, maxs );
+	}
+}
+
 /*
 * G_CanSplashDamage
 */
@@ -60,9 +102,7 @@ static bool G_CanSplashDamage( edict_t *targ, edict_t *inflictor, cplane_t *plan
 		return false;
 	}
 
-	if( !plane ) {
-		VectorCopy( inflictor->s.origin, origin );
-	}
+	G_SplashOrigin( inflictor, plane, origin );
 
 	// bmodels need special checking because their origin is 0,0,0
 	if( targ->movetype == MOVETYPE_PUSH ) {
@@ -77,11 +117,6 @@ static bool G_CanSplashDamage( edict_t *targ, edict_t *inflictor, cplane_t *plan
 		return false;
 	}
 
-	if( plane ) {
-		// up by 9 units to account for stairs
-		VectorMA( inflictor->s.origin, 9, plane->normal, origin );
-	}
-
 	// This is for players
 	G_Trace4D( &trace, origin, vec3_origin, vec3_origin, targ->s.origin, inflictor, solidmask, inflictor->timeDelta );
 	if( trace.fraction >= 1.0 - SPLASH_DAMAGE_TRACE_FRAC_EPSILON || trace.ent == ENTNUM( targ ) ) {
@@ -504,6 +539,7 @@ void G_RadiusDamage( edict_t *inflictor, edict_t *attacker, cplane_t *plane, edi
 	edict_t *ent = NULL;
 	float frac, damage, knockback;
 	vec3_t pushDir;
+	vec3_t tracemins, tracemaxs;
 	int timeDelta;
 
 	assert( inflictor );
@@ -522,6 +558,13 @@ void G_RadiusDamage( edict_t *inflictor, edict_t *attacker, cplane_t *plane, edi
 	clamp_high( minknockback, maxknockback );
 
 	numtouch = GClip_FindInRadius4D( inflictor->s.origin, radius, touch, MAX_EDICTS, inflictor->timeDelta );
+	numtouch = min( numtouch, MAX_EDICTS );
+
+	// all the visibility traces start at the explosion, so they share their
+	// antilagged entities and world descent until something takes damage
+	G_SplashTraceBounds( inflictor, plane, touch, numtouch, tracemins, tracemaxs );
+	GClip_BeginTraceBatch( tracemins, tracemaxs, inflictor->timeDelta );
+
 	for( i = 0; i < numtouch; i++ ) {
 		ent = game.edicts + touch[i];
 		if( ent == ignore || !ent->takedamage ) {
@@ -549,7 +592,111 @@ void G_RadiusDamage( edict_t *inflictor, edict_t *attacker, cplane_t *plane, edi
 		}
 
 		if( G_CanSplashDamage( ent, inflictor, plane ) ) {
+			// damage can kill, move or unlink entities
+			GClip_EndTraceBatch();
 			G_Damage( ent, inflictor, attacker, pushDir, inflictor->velocity, inflictor->s.origin, damage, knockback, DAMAGE_RADIUS, mod );
+			GClip_BeginTraceBatch( tracemins, tracemaxs, inflictor->timeDelta );
+		}
+	}
+
+	GClip_EndTraceBatch();
+}
+
+typedef struct {
+	edict_t *inflictor;
+	cplane_t *splashplane;
+	int touch[MAX_EDICTS];
+	int numtouch;
+	bool decisions[2][MAX_EDICTS];  // plain, batched
+} splashtest_t;
+
+static bool G_SplashTestPlayer( const edict_t *ent ) {
+	return ent->takedamage != DAMAGE_NO;
+}
+
+static void G_SplashTestPass( void *data, bool batch ) {
+	splashtest_t *t = ( splashtest_t * )data;
+	bool *decisions = t->decisions[batch ? 1 : 0];
+
+	if( batch ) {
+		vec3_t tracemins, tracemaxs;
+		G_SplashTraceBounds( t->inflictor, t->splashplane, t->touch, t->numtouch, tracemins, tracemaxs );
+		GClip_BeginTraceBatch( tracemins, tracemaxs, t->inflictor->timeDelta );
+	}
+	for( int i = 0; i < t->numtouch; i++ ) {
+		edict_t *ent = game.edicts + t->touch[i];
+		decisions[i] = ent != t->inflictor && ent->takedamage && G_CanSplashDamage( ent, t->inflictor, t->splashplane );
+	}
+	if( batch ) {
+		GClip_EndTraceBatch();
+	}
+}
+
+/*
+* G_SplashTest_f
+*
+* Sets off explosions around the players without doing any damage and checks
+* that the batched visibility traces make the same decisions as plain ones
+*/
+void G_SplashTest_f( void ) {
+	static const int timeDeltas[] = { 0, -50, -100, -250 };
+	static splashtest_t t;
+	comparetest_t test;
+	cplane_t plane;
+	int traced = 0, visible = 0;
+
+	if( !G_CompareTest_Begin( &test, "splashtest", "batched", G_SplashTestPlayer ) ) {
+		return;
+	}
+
+	float radius = trap_Cmd_Argc() > 2 ? atof( trap_Cmd_Argv( 2 ) ) : 250;
+
+	edict_t *inflictor = t.inflictor = G_Spawn();
+
+	for( int n = 0; n < test.count; n++ ) {
+		const edict_t *player = PLAYERENT( test.players[rand() % test.numplayers] );
+
+		inflictor->s.origin[0] = player->s.origin[0] + crandom() * radius;
+		inflictor->s.origin[1] = player->s.origin[1] + crandom() * radius;
+		inflictor->s.origin[2] = player->s.origin[2] + crandom() * 64;
+		if( G_PointContents( inflictor->s.origin ) & MASK_SOLID ) {
+			continue;
+		}
+
+		inflictor->timeDelta = timeDeltas[n % ARRAY_COUNT( timeDeltas )];
+
+		t.splashplane = NULL;
+		if( n & 1 ) {
+			VectorSet( plane.normal, crandom(), crandom(), crandom() );
+			if( VectorNormalize( plane.normal ) == 0 ) {
+				VectorSet( plane.normal, 0, 0, 1 );
+			}
+			t.splashplane = &plane;
+		}
+
+		t.numtouch = GClip_FindInRadius4D( inflictor->s.origin, radius, t.touch, MAX_EDICTS, inflictor->timeDelta );
+		t.numtouch = min( t.numtouch, MAX_EDICTS );
+
+		G_CompareTest_Run( &test, n, G_SplashTestPass, &t );
+
+		for( int i = 0; i < t.numtouch; i++ ) {
+			edict_t *ent = game.edicts + t.touch[i];
+			if( ent == inflictor || !ent->takedamage ) {
+				continue;
+			}
+
+			traced++;
+			visible += t.decisions[0][i];
+			if( t.decisions[1][i] != t.decisions[0][i] ) {
+				test.mismatches++;
+				G_Printf( "splashtest: %s (%i) from %s: plain %i, batched %i\n", ent->classname, t.touch[i],
+						  vtos( inflictor->s.origin ), t.decisions[0][i], t.decisions[1][i] );
+			}
 		}
 	}
+
+	G_FreeEdict( inflictor );
+
+	G_Printf( "splashtest: %i explosions, %i targets, %i visible, %i mismatches\n", test.count, traced, visible, test.mismatches );
+	G_CompareTest_Report( &test, traced, "targets" );
 }
@@ -533,6 +533,8 @@ static void G_RunEntities( void ) {
 * G_RunClients
 */
 static void G_RunClients( void ) {
+	G_RunClientMoves();
+
 	for( int i = 0; i < gs.maxclients; i++ ) {
 		edict_t *ent = game.edicts + 1 + i;
 		if( !ent->r.inuse ) {
@@ -547,6 +549,8 @@ static void G_RunClients( void ) {
 			ent->s.effects &= ~EF_TAKEDAMAGE;
 		}
 	}
+
+	G_EndClientMoves();
 }
 
 /*
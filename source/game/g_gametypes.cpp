@@ -972,6 +972,7 @@ void G_RunGametype( void ) {
 	G_Match_ScoreAnnouncement();
 
 	G_asGarbageCollect( false );
+	G_asUpdateProfiler();
 }
 
 //======================================================
@@ -264,6 +264,7 @@ extern cvar_t *g_allow_spectator_voting;
 
 extern cvar_t *g_asGC_stats;
 extern cvar_t *g_asGC_interval;
+extern cvar_t *g_asProfile;
 
 edict_t **G_Teams_ChallengersQueue( void );
 void G_Teams_Join_Cmd( edict_t *ent );
@@ -382,6 +383,8 @@ void G_asInitGameModuleEngine( void );
 void G_asShutdownGameModuleEngine( void );
 void G_asGarbageCollect( bool force );
 void G_asDumpAPI_f( void );
+void G_asUpdateProfiler( void );
+void G_asProfile_f( void );
 
 #define world game.edicts
 
@@ -458,6 +461,21 @@ const char *_G_RegisterLevelString( const char *string, const char *filename, in
 
 char *G_AllocCreateNamesList( const char *path, const char *extension, const char separator );
 
+// harness for the console commands that check a fast path against the plain one
+typedef struct {
+	const char *name;           // the command, prefixes everything printed
+	const char *fastname;
+	int count;                  // iterations, the first argument
+	int players[MAX_CLIENTS];
+	int numplayers;
+	uint64_t time[2];           // microseconds spent in the plain and fast passes
+	int mismatches;
+} comparetest_t;
+
+bool G_CompareTest_Begin( comparetest_t *test, const char *name, const char *fastname, bool ( *usable )( const edict_t *ent ) );
+void G_CompareTest_Run( comparetest_t *test, int iteration, void ( *pass )( void *data, bool fast ), void *data );
+void G_CompareTest_Report( const comparetest_t *test, int ops, const char *unit );
+
 char *_G_CopyString( const char *in, const char *filename, int fileline );
 #define G_CopyString( in ) _G_CopyString( in, __FILE__, __LINE__ )
 
@@ -565,6 +583,8 @@ void G_Trace( trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t m
 int G_PointContents4D( const vec3_t p, int timeDelta );
 void G_Trace4D( trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, edict_t *passedict, int contentmask, int timeDelta );
 void GClip_BackUpCollisionFrame( void );
+void GClip_BeginTraceBatch( const vec3_t mins, const vec3_t maxs, int timeDelta );
+void GClip_EndTraceBatch( void );
 int GClip_FindInRadius4D( vec3_t org, float rad, int *list, int maxcount, int timeDelta );
 void G_SplashFrac4D( const edict_t *ent, vec3_t hitpoint, float maxradius, vec3_t pushdir, float *frac, int timeDelta, bool selfdamage );
 void GClip_ClearWorld( void );
@@ -585,6 +605,18 @@ int GClip_FindInRadius( vec3_t org, float rad, int *list, int maxcount );
 int GClip_AreaEdicts( const vec3_t mins, const vec3_t maxs, int *list, int maxcount, int areatype, int timeDelta );
 bool GClip_EntityContact( const vec3_t mins, const vec3_t maxs, edict_t *ent );
 
+typedef struct {
+	entity_state_t s;
+	entity_shared_t r;
+	int64_t linkseq;
+} gclipentity_t;
+
+void GClip_BeginQueryRecord( void );
+bool GClip_EndQueryRecord( vec3_t mins, vec3_t maxs );
+void GClip_SaveEntity( int entNum, gclipentity_t *saved );
+bool GClip_EntityChanged( int entNum, const gclipentity_t *saved );
+void G_TriggerTest_f( void );
+
 //
 // g_combat.c
 //
@@ -593,6 +625,7 @@ int G_ModToAmmo( int mod );
 void G_SplashFrac( const entity_state_t *s, const entity_shared_t *r, const vec3_t point, float maxradius, vec3_t pushdir, float *frac, bool selfdamage );
 void G_Damage( edict_t *targ, edict_t *inflictor, edict_t *attacker, const vec3_t pushdir, const vec3_t dmgdir, const vec3_t point, float damage, float knockback, int dflags, int mod );
 void G_RadiusDamage( edict_t *inflictor, edict_t *attacker, cplane_t *plane, edict_t *ignore, int mod );
+void G_SplashTest_f( void );
 
 // damage flags
 #define DAMAGE_RADIUS 0x00000001  // damage was indirect
@@ -625,6 +658,7 @@ void G_HideLaser( edict_t *ent );
 void W_Fire_Blade( edict_t *self, int range, vec3_t start, vec3_t angles, float damage, int knockback, int timeDelta );
 void W_Fire_MG( edict_t *self, vec3_t start, vec3_t angles, int seed, int range, int hspread, int vspread, float damage, int knockback, int timeDelta );
 void W_Fire_Riotgun( edict_t *self, vec3_t start, vec3_t angles, int range, int hspread, int vspread, int count, float damage, int knockback, int timeDelta );
+void G_PelletTest_f( void );
 edict_t *W_Fire_Grenade( edict_t *self, vec3_t start, vec3_t angles, int speed, float damage, int minKnockback, int maxKnockback, int minDamage, float radius, int timeout, int timeDelta, bool aim_up );
 edict_t *W_Fire_Rocket( edict_t *self, vec3_t start, vec3_t angles, int speed, float damage, int minKnockback, int maxKnockback, int minDamage, int radius, int timeout, int timeDelta );
 edict_t *W_Fire_Plasma( edict_t *self, vec3_t start, vec3_t angles, float damage, int minKnockback, int maxKnockback, int minDamage, int radius, int speed, int timeout, int timeDelta );
@@ -657,6 +691,7 @@ void G_ClientRespawn( edict_t *self, bool ghost );
 void G_ClientClearStats( edict_t *ent );
 void G_GhostClient( edict_t *self );
 bool ClientMultiviewChanged( edict_t *ent, bool multiview );
+void ClientSetupMove( const edict_t *ent, player_state_t *ps );
 void ClientThink( edict_t *ent, usercmd_t *cmd, int timeDelta );
 void G_ClientThink( edict_t *ent );
 void G_CheckClientRespawnClick( edict_t *ent );
@@ -668,6 +703,15 @@ void G_PredictedEvent( int entNum, int ev, int parm );
 void G_TeleportPlayer( edict_t *player, edict_t *dest );
 bool G_PlayerCanTeleport( edict_t *player );
 
+//
+// p_move.c
+//
+void G_RunClientMoves( void );
+bool G_TakeClientMove( edict_t *ent, const usercmd_t *ucmd, pmove_t *pm, pmove_tail_t *tail );
+bool G_RecordMoveEvent( int entNum, int ev, int parm );
+void G_EndClientMoves( void );
+void G_ThinkTest_f( void );
+
 //
 // g_player.c
 //
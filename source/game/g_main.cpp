@@ -75,6 +75,7 @@ cvar_t *g_allow_spectator_voting;
 
 cvar_t *g_asGC_stats;
 cvar_t *g_asGC_interval;
+cvar_t *g_asProfile;
 
 static char *map_rotation_s = NULL;
 static char **map_rotation_p = NULL;
@@ -248,6 +249,7 @@ void G_Init( unsigned int seed, unsigned int framemsec ) {
 
 	g_asGC_stats = trap_Cvar_Get( "g_asGC_stats", "0", CVAR_ARCHIVE );
 	g_asGC_interval = trap_Cvar_Get( "g_asGC_interval", "10", CVAR_ARCHIVE );
+	g_asProfile = trap_Cvar_Get( "g_asProfile", "0", 0 );
 
 	// initialize all entities for this game
 	g_maxentities = trap_Cvar_Get( "sv_maxentities", "4096", CVAR_LATCH );
@@ -20,7 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 // g_public.h -- game dll information visible to server
 
-#define GAME_API_VERSION    51
+#define GAME_API_VERSION    53
 
 //===============================================================
 
@@ -98,6 +98,10 @@ typedef struct {
 	int ( *SkinIndex )( const char *name );
 
 	int64_t ( *Milliseconds )( void );
+	uint64_t ( *Microseconds )( void );
+
+	// runs func over [0, count) in batches on the job pool and waits for it
+	void ( *ParallelFor )( int count, int batch, void ( *func )( void *data, int begin, int end ), void *data );
 
 	bool ( *inPVS )( const vec3_t p1, const vec3_t p2 );
 
@@ -105,6 +109,8 @@ typedef struct {
 	struct cmodel_s *( *CM_InlineModel )( int num );
 	int ( *CM_TransformedPointContents )( const vec3_t p, struct cmodel_s *cmodel, const vec3_t origin, const vec3_t angles );
 	void ( *CM_TransformedBoxTrace )( trace_t *tr, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, struct cmodel_s *cmodel, int brushmask, const vec3_t origin, const vec3_t angles );
+	int ( *CM_BoxHeadnode )( const vec3_t mins, const vec3_t maxs );
+	void ( *CM_HeadnodeBoxTrace )( trace_t *tr, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, int brushmask, int headnode );
 	void ( *CM_InlineModelBounds )( struct cmodel_s *cmodel, vec3_t mins, vec3_t maxs );
 	struct cmodel_s *( *CM_ModelForBBox )( vec3_t mins, vec3_t maxs );
 	struct cmodel_s *( *CM_OctagonModelForBBox )( vec3_t mins, vec3_t maxs );
@@ -167,6 +173,7 @@ typedef struct {
 	int ( *FakeClientConnect )( const char *fakeUserinfo, const char *fakeSocketType, const char *fakeIP );
 	void ( *DropClient )( struct edict_s *ent, int type, const char *message );
 	int ( *GetClientState )( int numClient );
+	bool ( *PeekClientThink )( int clientNum, usercmd_t *ucmd );
 	void ( *ExecuteClientThinks )( int clientNum );
 
 	// The edict array is allocated in the game dll so it
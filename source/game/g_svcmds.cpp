@@ -356,6 +356,11 @@ void G_AddServerCommands( void ) {
 	trap_Cmd_AddCommand( "writeip", Cmd_WriteIP_f );
 
 	trap_Cmd_AddCommand( "dumpASapi", G_asDumpAPI_f );
+	trap_Cmd_AddCommand( "asprofile", G_asProfile_f );
+	trap_Cmd_AddCommand( "splashtest", G_SplashTest_f );
+	trap_Cmd_AddCommand( "pellettest", G_PelletTest_f );
+	trap_Cmd_AddCommand( "triggertest", G_TriggerTest_f );
+	trap_Cmd_AddCommand( "thinktest", G_ThinkTest_f );
 }
 
 /*
@@ -377,4 +382,9 @@ void G_RemoveCommands( void ) {
 	trap_Cmd_RemoveCommand( "writeip" );
 
 	trap_Cmd_RemoveCommand( "dumpASapi" );
+	trap_Cmd_RemoveCommand( "asprofile" );
+	trap_Cmd_RemoveCommand( "splashtest" );
+	trap_Cmd_RemoveCommand( "pellettest" );
+	trap_Cmd_RemoveCommand( "triggertest" );
+	trap_Cmd_RemoveCommand( "thinktest" );
 }
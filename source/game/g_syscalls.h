@@ -78,6 +78,14 @@ static inline int64_t trap_Milliseconds( void ) {
 	return GAME_IMPORT.Milliseconds();
 }
 
+static inline uint64_t trap_Microseconds( void ) {
+	return GAME_IMPORT.Microseconds();
+}
+
+static inline void trap_ParallelFor( int count, int batch, void ( *func )( void *data, int begin, int end ), void *data ) {
+	GAME_IMPORT.ParallelFor( count, batch, func, data );
+}
+
 static inline bool trap_inPVS( const vec3_t p1, const vec3_t p2 ) {
 	return GAME_IMPORT.inPVS( p1, p2 ) == true;
 }
@@ -90,6 +98,14 @@ static inline void trap_CM_TransformedBoxTrace( trace_t *tr, const vec3_t start,
 	GAME_IMPORT.CM_TransformedBoxTrace( tr, start, end, mins, maxs, cmodel, brushmask, origin, angles );
 }
 
+static inline int trap_CM_BoxHeadnode( const vec3_t mins, const vec3_t maxs ) {
+	return GAME_IMPORT.CM_BoxHeadnode( mins, maxs );
+}
+
+static inline void trap_CM_HeadnodeBoxTrace( trace_t *tr, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, int brushmask, int headnode ) {
+	GAME_IMPORT.CM_HeadnodeBoxTrace( tr, start, end, mins, maxs, brushmask, headnode );
+}
+
 static inline int trap_CM_NumInlineModels( void ) {
 	return GAME_IMPORT.CM_NumInlineModels();
 }
@@ -261,6 +277,10 @@ static inline int trap_GetClientState( int numClient ) {
 	return GAME_IMPORT.GetClientState( numClient );
 }
 
+static inline bool trap_PeekClientThink( int clientNum, usercmd_t *ucmd ) {
+	return GAME_IMPORT.PeekClientThink( clientNum, ucmd );
+}
+
 static inline void trap_ExecuteClientThinks( int clientNum ) {
 	GAME_IMPORT.ExecuteClientThinks( clientNum );
 }
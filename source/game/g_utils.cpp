@@ -1748,3 +1748,55 @@ void G_PrecacheWeapondef( int weapon, firedef_t *firedef ) {
 
 	trap_ConfigString( CS_WEAPONDEFS + weapon, cstring );
 }
+
+/*
+* G_CompareTest_Begin
+*
+* Reads the iteration count and collects the players usable() accepts,
+* returns false if there are none
+*/
+bool G_CompareTest_Begin( comparetest_t *test, const char *name, const char *fastname, bool ( *usable )( const edict_t *ent ) ) {
+	memset( test, 0, sizeof( *test ) );
+	test->name = name;
+	test->fastname = fastname;
+	test->count = trap_Cmd_Argc() > 1 ? atoi( trap_Cmd_Argv( 1 ) ) : 1000;
+
+	for( int i = 0; i < gs.maxclients; i++ ) {
+		const edict_t *ent = PLAYERENT( i );
+		if( ent->r.inuse && ent->r.client != NULL && usable( ent ) ) {
+			test->players[test->numplayers++] = i;
+		}
+	}
+
+	if( test->numplayers == 0 ) {
+		G_Printf( "%s: no players to test with\n", name );
+		return false;
+	}
+
+	return true;
+}
+
+/*
+* G_CompareTest_Run
+*
+* Times one plain and one fast pass over the same data
+*/
+void G_CompareTest_Run( comparetest_t *test, int iteration, void ( *pass )( void *data, bool fast ), void *data ) {
+	// alternate which goes first so neither always runs with warm caches
+	for( int i = 0; i < 2; i++ ) {
+		bool fast = ( i ^ iteration ) & 1;
+
+		uint64_t t0 = trap_Microseconds();
+		pass( data, fast );
+		test->time[fast ? 1 : 0] += trap_Microseconds() - t0;
+	}
+}
+
+/*
+* G_CompareTest_Report
+*/
+void G_CompareTest_Report( const comparetest_t *test, int ops, const char *unit ) {
+	G_Printf( "%s: plain %.2f ms (%.0f %s/s), %s %.2f ms (%.0f %s/s)\n", test->name,
+			  test->time[0] / 1000.0, ops * 1000000.0 / Max2( test->time[0], uint64_t( 1 ) ), unit, test->fastname,
+			  test->time[1] / 1000.0, ops * 1000000.0 / Max2( test->time[1], uint64_t( 1 ) ), unit );
+}
@@ -236,27 +236,69 @@ void W_Fire_MG( edict_t *self, vec3_t start, vec3_t angles, int seed, int range,
 }
 
 // Sunflower spiral with Fibonacci numbers
+static void G_SunflowerOffset( int i, int hspread, int vspread, float *r, float *u ) {
+	float fi = i * 2.4f; //magic value creating Fibonacci numbers
+	*r = cosf( fi ) * hspread * sqrtf( fi );
+	*u = sinf( fi ) * vspread * sqrtf( fi );
+}
+
+/*
+* G_SunflowerBounds
+*
+* Box holding every pellet trace of a pattern, built the way GS_TraceBullet
+* builds the end points
+*/
+static void G_SunflowerBounds( const vec3_t start, const vec3_t dir, const vec3_t right, const vec3_t up, int count,
+							   int hspread, int vspread, int range, vec3_t mins, vec3_t maxs ) {
+	vec3_t end;
+	float r, u;
+
+	ClearBounds( mins, maxs );
+	AddPointToBounds( start, mins, maxs );
+
+	for( int i = 0; i < count; i++ ) {
+		G_SunflowerOffset( i, hspread, vspread, &r, &u );
+
+		VectorMA( start, range, dir, end );
+		if( r ) {
+			VectorMA( end, r, right, end );
+		}
+		if( u ) {
+			VectorMA( end, u, up, end );
+		}
+		AddPointToBounds( end, mins, maxs );
+	}
+}
+
 static void G_Fire_SunflowerPattern( edict_t *self, vec3_t start, vec3_t dir, int count,
 									 int hspread, int vspread, int range, float damage, int kick, int dflags, int timeDelta ) {
 	vec3_t right, up;
+	vec3_t mins, maxs;
 	ViewVectors( dir, right, up );
 
+	// the pellets share their antilagged entities and world descent until one does damage
+	G_SunflowerBounds( start, dir, right, up, count, hspread, vspread, range, mins, maxs );
+	GClip_BeginTraceBatch( mins, maxs, timeDelta );
+
 	int hits[MAX_CLIENTS + 1] = { };
 	for( int i = 0; i < count; i++ ) {
-		float fi = i * 2.4f; //magic value creating Fibonacci numbers
-		float r = cosf( fi ) * hspread * sqrtf( fi );
-		float u = sinf( fi ) * vspread * sqrtf( fi );
+		float r, u;
+		G_SunflowerOffset( i, hspread, vspread, &r, &u );
 
 		trace_t trace;
 		GS_TraceBullet( &trace, start, dir, right, up, r, u, range, ENTNUM( self ), timeDelta );
 		if( trace.ent != -1 && game.edicts[trace.ent].takedamage ) {
+			GClip_EndTraceBatch();
 			G_Damage( &game.edicts[trace.ent], self, self, dir, dir, trace.endpos, damage, kick, dflags, MOD_RIOTGUN );
+			GClip_BeginTraceBatch( mins, maxs, timeDelta );
 			if( trace.ent <= MAX_CLIENTS ) {
 				hits[trace.ent]++;
 			}
 		}
 	}
 
+	GClip_EndTraceBatch();
+
 	for( int i = 1; i <= MAX_CLIENTS; i++ ) {
 		if( hits[i] == 0 )
 			continue;
@@ -268,6 +310,98 @@ static void G_Fire_SunflowerPattern( edict_t *self, vec3_t start, vec3_t dir, in
 	}
 }
 
+typedef struct {
+	const firedef_t *firedef;
+	edict_t *self;
+	vec3_t start, dir, right, up;
+	int timeDelta;
+	int numpellets;
+	trace_t traces[2][64];      // plain, batched
+	bool water[2][64];
+} pellettest_t;
+
+static bool G_PelletTestPlayer( const edict_t *ent ) {
+	return ent->r.solid != SOLID_NOT;
+}
+
+static void G_PelletTestPass( void *data, bool batch ) {
+	pellettest_t *t = ( pellettest_t * )data;
+	const firedef_t *firedef = t->firedef;
+	trace_t *traces = t->traces[batch ? 1 : 0];
+	bool *water = t->water[batch ? 1 : 0];
+
+	if( batch ) {
+		vec3_t mins, maxs;
+		G_SunflowerBounds( t->start, t->dir, t->right, t->up, t->numpellets, firedef->spread, firedef->v_spread, firedef->timeout, mins, maxs );
+		GClip_BeginTraceBatch( mins, maxs, t->timeDelta );
+	}
+	for( int i = 0; i < t->numpellets; i++ ) {
+		float r, u;
+		G_SunflowerOffset( i, firedef->spread, firedef->v_spread, &r, &u );
+		water[i] = GS_TraceBullet( &traces[i], t->start, t->dir, t->right, t->up, r, u, firedef->timeout, ENTNUM( t->self ), t->timeDelta ) != NULL;
+	}
+	if( batch ) {
+		GClip_EndTraceBatch();
+	}
+}
+
+/*
+* G_PelletTest_f
+*
+* Fires riotgun patterns from the players in random directions without doing
+* any damage, and checks that batched pellet traces match plain ones
+*/
+void G_PelletTest_f( void ) {
+	static const int timeDeltas[] = { 0, -50, -100, -250 };
+	static pellettest_t t;
+	comparetest_t test;
+	int pellets = 0, hits = 0;
+
+	if( !G_CompareTest_Begin( &test, "pellettest", "batched", G_PelletTestPlayer ) ) {
+		return;
+	}
+
+	t.firedef = &GS_GetWeaponDef( WEAP_RIOTGUN )->firedef;
+	t.numpellets = Min2( t.firedef->projectile_count, int( ARRAY_COUNT( t.traces[0] ) ) );
+
+	for( int n = 0; n < test.count; n++ ) {
+		vec3_t angles;
+
+		t.self = PLAYERENT( test.players[rand() % test.numplayers] );
+		t.timeDelta = timeDeltas[n % ARRAY_COUNT( timeDeltas )];
+
+		VectorCopy( t.self->s.origin, t.start );
+		t.start[2] += t.self->viewheight;
+		VectorSet( angles, crandom() * 30, random() * 360, 0 );
+		AngleVectors( angles, t.dir, NULL, NULL );
+		ViewVectors( t.dir, t.right, t.up );
+
+		G_CompareTest_Run( &test, n, G_PelletTestPass, &t );
+
+		for( int i = 0; i < t.numpellets; i++ ) {
+			const trace_t *a = &t.traces[0][i];
+			const trace_t *b = &t.traces[1][i];
+
+			pellets++;
+			if( a->ent > 0 && game.edicts[a->ent].takedamage ) {
+				hits++;
+			}
+
+			if( a->fraction != b->fraction || a->ent != b->ent || !VectorCompare( a->endpos, b->endpos )
+				|| a->contents != b->contents || a->surfFlags != b->surfFlags || a->allsolid != b->allsolid
+				|| a->startsolid != b->startsolid || !VectorCompare( a->plane.normal, b->plane.normal )
+				|| t.water[0][i] != t.water[1][i] ) {
+				test.mismatches++;
+				G_Printf( "pellettest: pellet %i from %s: plain %i %f, batched %i %f\n", i, vtos( t.start ),
+						  a->ent, a->fraction, b->ent, b->fraction );
+			}
+		}
+	}
+
+	G_Printf( "pellettest: %i shots, %i pellets, %i hit something damageable, %i mismatches\n", test.count, pellets, hits, test.mismatches );
+	G_CompareTest_Report( &test, pellets, "pellets" );
+}
+
 void W_Fire_Riotgun( edict_t *self, vec3_t start, vec3_t angles, int range, int hspread, int vspread,
 					 int count, float damage, int knockback, int timeDelta ) {
 	vec3_t dir;
@@ -1120,6 +1120,10 @@ void G_PredictedEvent( int entNum, int ev, int parm ) {
 	edict_t *ent;
 	vec3_t upDir = { 0, 0, 1 };
 
+	if( G_RecordMoveEvent( entNum, ev, parm ) ) {
+		return;
+	}
+
 	ent = &game.edicts[entNum];
 	switch( ev ) {
 		case EV_FALL:
@@ -1210,20 +1214,47 @@ bool ClientMultiviewChanged( edict_t *ent, bool multiview ) {
 	return true;
 }
 
+/*
+* ClientSetupMove
+*
+* Refreshes the player state a move starts from with the entity
+*/
+void ClientSetupMove( const edict_t *ent, player_state_t *ps ) {
+	ps->POVnum = ENTNUM( ent );
+	ps->playerNum = PLAYERNUM( ent );
+
+	// (is this really needed?:only if not cared enough about ps in the rest of the code)
+	// refresh player state position from the entity
+	VectorCopy( ent->s.origin, ps->pmove.origin );
+	VectorCopy( ent->velocity, ps->pmove.velocity );
+	VectorCopy( ent->s.angles, ps->viewangles );
+
+	ps->pmove.gravity = level.gravity;
+
+	if( GS_MatchState() >= MATCH_STATE_POSTMATCH || GS_MatchPaused()
+		|| ( ent->movetype != MOVETYPE_PLAYER && ent->movetype != MOVETYPE_NOCLIP ) ) {
+		ps->pmove.pm_type = PM_FREEZE;
+	} else if( ent->s.type == ET_GIB ) {
+		ps->pmove.pm_type = PM_GIB;
+	} else if( ent->movetype == MOVETYPE_NOCLIP ) {
+		ps->pmove.pm_type = PM_SPECTATOR;
+	} else {
+		ps->pmove.pm_type = PM_NORMAL;
+	}
+}
+
 /*
 * ClientThink
 */
 void ClientThink( edict_t *ent, usercmd_t *ucmd, int timeDelta ) {
 	gclient_t *client;
 	int i, j;
-	static pmove_t pm;
+	pmove_t pm;
+	pmove_tail_t tail;
 	int delta, count;
 
 	client = ent->r.client;
 
-	client->ps.POVnum = ENTNUM( ent );
-	client->ps.playerNum = PLAYERNUM( ent );
-
 	// anti-lag
 	if( ent->r.svflags & SVF_FAKECLIENT ) {
 		client->timeDelta = 0;
@@ -1269,32 +1300,18 @@ void ClientThink( edict_t *ent, usercmd_t *ucmd, int timeDelta ) {
 
 	client->ucmd = *ucmd;
 
-	// (is this really needed?:only if not cared enough about ps in the rest of the code)
-	// refresh player state position from the entity
-	VectorCopy( ent->s.origin, client->ps.pmove.origin );
-	VectorCopy( ent->velocity, client->ps.pmove.velocity );
-	VectorCopy( ent->s.angles, client->ps.viewangles );
+	ClientSetupMove( ent, &client->ps );
 
-	client->ps.pmove.gravity = level.gravity;
+	// perform a pmove, unless it already ran on the job pool
+	if( !G_TakeClientMove( ent, ucmd, &pm, &tail ) ) {
+		memset( &pm, 0, sizeof( pmove_t ) );
+		pm.playerState = &client->ps;
+		pm.cmd = *ucmd;
 
-	if( GS_MatchState() >= MATCH_STATE_POSTMATCH || GS_MatchPaused()
-		|| ( ent->movetype != MOVETYPE_PLAYER && ent->movetype != MOVETYPE_NOCLIP ) ) {
-		client->ps.pmove.pm_type = PM_FREEZE;
-	} else if( ent->s.type == ET_GIB ) {
-		client->ps.pmove.pm_type = PM_GIB;
-	} else if( ent->movetype == MOVETYPE_NOCLIP ) {
-		client->ps.pmove.pm_type = PM_SPECTATOR;
-	} else {
-		client->ps.pmove.pm_type = PM_NORMAL;
+		Pmove_Move( &pm, &tail );
 	}
 
-	// set up for pmove
-	memset( &pm, 0, sizeof( pmove_t ) );
-	pm.playerState = &client->ps;
-	pm.cmd = *ucmd;
-
-	// perform a pmove
-	Pmove( &pm );
+	Pmove_Finish( &pm, &tail );
 
 	// save results of pmove
 	client->old_pmove = client->ps.pmove;
@@ -0,0 +1,351 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "g_local.h"
+
+//====================================================================
+// CONCURRENT CLIENT MOVES
+//
+// At the start of G_RunClients the move for the first pending usercmd of
+// every human client runs on the job pool, while nothing writes the world.
+// The thinks then run serially in client order as they always have, and a
+// think takes the result of its move only if the move would come out the
+// same right then: same usercmd, player state and game state, and the same
+// entities, unchanged, wherever its area queries looked. Otherwise the move
+// runs again in place, so the outcome is always that of a serial frame.
+//====================================================================
+
+#define MAX_MOVE_ENTS   32
+#define MAX_MOVE_EVENTS 8
+
+typedef struct {
+	int entNum;
+	int ev;
+	int parm;
+} moveevent_t;
+
+typedef struct {
+	bool valid;                 // ran this frame and not taken yet
+	usercmd_t cmd;
+	player_state_t startps;     // what the move started from
+	player_state_t ps;
+	pmove_t pm;
+	pmove_tail_t tail;
+
+	// predicted events are applied when the move is taken
+	int numevents;
+	moveevent_t events[MAX_MOVE_EVENTS];
+	bool overflow;
+
+	// everything the area queries of the move looked at
+	bool queried;
+	vec3_t mins, maxs;
+	int numents;
+	int ents[MAX_MOVE_ENTS + 1];
+} clientmove_t;
+
+static clientmove_t g_clientmoves[MAX_CLIENTS];
+static int g_movingclients[MAX_CLIENTS];
+static int g_nummovingclients;
+
+// the entities the moves looked at, as they were when the moves ran
+static gclipentity_t g_movesaved[MAX_EDICTS];
+static int g_movesavedframe[MAX_EDICTS];
+static int g_moveframe;
+static game_state_t g_movegamestate;
+
+static thread_local clientmove_t *g_recordingmove;
+
+typedef struct {
+	int frames;                 // left to run
+	int moves;
+	int concurrent;
+	int redone;
+	int mismatches;
+} thinktest_t;
+
+static thinktest_t g_thinktest;
+
+/*
+* G_RecordMoveEvent
+*
+* Holds on to the predicted events of a move running on the job pool
+*/
+bool G_RecordMoveEvent( int entNum, int ev, int parm ) {
+	clientmove_t *move = g_recordingmove;
+
+	if( move == NULL ) {
+		return false;
+	}
+
+	if( move->numevents == MAX_MOVE_EVENTS ) {
+		move->overflow = true;
+	} else {
+		moveevent_t *event = &move->events[move->numevents++];
+		event->entNum = entNum;
+		event->ev = ev;
+		event->parm = parm;
+	}
+
+	return true;
+}
+
+/*
+* G_RunClientMove
+*/
+static void G_RunClientMove( clientmove_t *move ) {
+	memcpy( &move->ps, &move->startps, sizeof( move->ps ) );
+	memset( &move->pm, 0, sizeof( move->pm ) );
+	move->pm.playerState = &move->ps;
+	move->pm.cmd = move->cmd;
+	move->numevents = 0;
+	move->overflow = false;
+
+	g_recordingmove = move;
+	GClip_BeginQueryRecord();
+
+	Pmove_Move( &move->pm, &move->tail );
+
+	move->queried = GClip_EndQueryRecord( move->mins, move->maxs );
+	g_recordingmove = NULL;
+}
+
+/*
+* G_ClientMovesJob
+*/
+static void G_ClientMovesJob( void *data, int begin, int end ) {
+	for( int i = begin; i < end; i++ ) {
+		int playerNum = g_movingclients[i];
+		const edict_t *ent = PLAYERENT( playerNum );
+		clientmove_t *move = &g_clientmoves[playerNum];
+
+		memcpy( &move->startps, &ent->r.client->ps, sizeof( move->startps ) );
+		ClientSetupMove( ent, &move->startps );
+
+		G_RunClientMove( move );
+
+		move->numents = 0;
+		if( move->queried ) {
+			move->numents = GClip_AreaEdicts( move->mins, move->maxs, move->ents, MAX_MOVE_ENTS + 1, AREA_ALL, 0 );
+		}
+
+		move->valid = !move->overflow && move->numents <= MAX_MOVE_ENTS;
+	}
+}
+
+/*
+* G_SaveMoveEntity
+*/
+static void G_SaveMoveEntity( int entNum ) {
+	if( g_movesavedframe[entNum] != g_moveframe ) {
+		GClip_SaveEntity( entNum, &g_movesaved[entNum] );
+		g_movesavedframe[entNum] = g_moveframe;
+	}
+}
+
+/*
+* G_RunClientMoves
+*
+* Runs the first move of every human client with usercmds to execute on
+* the job pool, for ClientThink to take
+*/
+void G_RunClientMoves( void ) {
+	g_moveframe++;
+	g_nummovingclients = 0;
+
+	for( int i = 0; i < gs.maxclients; i++ ) {
+		const edict_t *ent = PLAYERENT( i );
+		clientmove_t *move = &g_clientmoves[i];
+
+		move->valid = false;
+
+		if( !ent->r.inuse || !ent->r.client || ( ent->r.svflags & SVF_FAKECLIENT ) ) {
+			continue;
+		}
+
+		if( trap_GetClientState( i ) < CS_SPAWNED || !trap_PeekClientThink( i, &move->cmd ) ) {
+			continue;
+		}
+
+		g_movingclients[g_nummovingclients++] = i;
+	}
+
+	// nothing to run side by side
+	if( g_nummovingclients < 2 ) {
+		return;
+	}
+
+	trap_ParallelFor( g_nummovingclients, 1, G_ClientMovesJob, NULL );
+
+	// nothing has changed since the moves ran
+	memcpy( &g_movegamestate, &gs.gameState, sizeof( g_movegamestate ) );
+
+	for( int i = 0; i < g_nummovingclients; i++ ) {
+		const clientmove_t *move = &g_clientmoves[g_movingclients[i]];
+
+		if( !move->valid ) {
+			continue;
+		}
+
+		G_SaveMoveEntity( ENTNUM( PLAYERENT( g_movingclients[i] ) ) );
+		for( int j = 0; j < move->numents; j++ ) {
+			G_SaveMoveEntity( move->ents[j] );
+		}
+	}
+}
+
+/*
+* G_ClientMoveStillValid
+*
+* Whether the move would come out the same if it ran now
+*/
+static bool G_ClientMoveStillValid( const edict_t *ent, const clientmove_t *move, const usercmd_t *ucmd ) {
+	int ents[MAX_MOVE_ENTS + 1];
+
+	if( memcmp( &move->cmd, ucmd, sizeof( move->cmd ) ) || memcmp( &move->startps, &ent->r.client->ps, sizeof( move->startps ) )
+		|| memcmp( &g_movegamestate, &gs.gameState, sizeof( g_movegamestate ) ) ) {
+		return false;
+	}
+
+	// the mover itself is looked at whether it's linked or not
+	if( GClip_EntityChanged( ENTNUM( ent ), &g_movesaved[ENTNUM( ent )] ) ) {
+		return false;
+	}
+
+	if( !move->queried ) {
+		return true;
+	}
+
+	// the same entities in the same order, so every query inside the
+	// bounds finds the same ones
+	int numents = GClip_AreaEdicts( move->mins, move->maxs, ents, MAX_MOVE_ENTS + 1, AREA_ALL, 0 );
+	if( numents != move->numents || memcmp( ents, move->ents, numents * sizeof( int ) ) ) {
+		return false;
+	}
+
+	for( int i = 0; i < numents; i++ ) {
+		if( GClip_EntityChanged( ents[i], &g_movesaved[ents[i]] ) ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+* G_CheckClientMove
+*
+* Runs the move serially from where the player is now and compares the
+* results with the ones about to be taken
+*/
+static bool G_CheckClientMove( const edict_t *ent, const clientmove_t *move, const usercmd_t *ucmd ) {
+	static clientmove_t check;
+	pmove_t pm[2];
+
+	memcpy( &check.cmd, ucmd, sizeof( check.cmd ) );
+	memcpy( &check.startps, &ent->r.client->ps, sizeof( check.startps ) );
+	G_RunClientMove( &check );
+
+	pm[0] = move->pm;
+	pm[1] = check.pm;
+	pm[0].playerState = pm[1].playerState = NULL;
+
+	return memcmp( &move->ps, &check.ps, sizeof( check.ps ) ) == 0 && memcmp( &pm[0], &pm[1], sizeof( pm[0] ) ) == 0
+		&& memcmp( &move->tail, &check.tail, sizeof( check.tail ) ) == 0 && move->numevents == check.numevents
+		&& memcmp( move->events, check.events, check.numevents * sizeof( check.events[0] ) ) == 0;
+}
+
+/*
+* G_TakeClientMove
+*
+* Hands ClientThink the result of the move that ran on the job pool for
+* this usercmd, if it is still valid, and applies its predicted events
+*/
+bool G_TakeClientMove( edict_t *ent, const usercmd_t *ucmd, pmove_t *pm, pmove_tail_t *tail ) {
+	gclient_t *client = ent->r.client;
+	clientmove_t *move = &g_clientmoves[PLAYERNUM( ent )];
+
+	if( g_thinktest.frames > 0 ) {
+		g_thinktest.moves++;
+	}
+
+	if( !move->valid ) {
+		return false;
+	}
+
+	// only ever the first usercmd of the frame
+	move->valid = false;
+
+	if( !G_ClientMoveStillValid( ent, move, ucmd ) ) {
+		if( g_thinktest.frames > 0 ) {
+			g_thinktest.redone++;
+		}
+		return false;
+	}
+
+	if( g_thinktest.frames > 0 ) {
+		g_thinktest.concurrent++;
+		if( !G_CheckClientMove( ent, move, ucmd ) ) {
+			g_thinktest.mismatches++;
+			G_Printf( "thinktest: move of %s doesn't match\n", client->netname );
+		}
+	}
+
+	memcpy( &client->ps, &move->ps, sizeof( client->ps ) );
+	*pm = move->pm;
+	pm->playerState = &client->ps;
+	*tail = move->tail;
+
+	for( int i = 0; i < move->numevents; i++ ) {
+		G_PredictedEvent( move->events[i].entNum, move->events[i].ev, move->events[i].parm );
+	}
+
+	return true;
+}
+
+/*
+* G_EndClientMoves
+*/
+void G_EndClientMoves( void ) {
+	for( int i = 0; i < g_nummovingclients; i++ ) {
+		g_clientmoves[g_movingclients[i]].valid = false;
+	}
+	g_nummovingclients = 0;
+
+	if( g_thinktest.frames > 0 && --g_thinktest.frames == 0 ) {
+		G_Printf( "thinktest: %i client moves, %i run concurrently, %i redone, %i mismatches\n",
+				  g_thinktest.moves, g_thinktest.concurrent, g_thinktest.redone, g_thinktest.mismatches );
+	}
+}
+
+/*
+* G_ThinkTest_f
+*
+* For the given number of frames, runs every move taken from the job pool
+* again serially and compares the results
+*/
+void G_ThinkTest_f( void ) {
+	int frames = trap_Cmd_Argc() >= 2 ? atoi( trap_Cmd_Argv( 1 ) ) : 100;
+
+	memset( &g_thinktest, 0, sizeof( g_thinktest ) );
+	g_thinktest.frames = max( frames, 1 );
+
+	G_Printf( "thinktest: checking %i frames\n", g_thinktest.frames );
+}
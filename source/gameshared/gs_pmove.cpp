@@ -41,6 +41,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // all of the locals will be zeroed before each
 // pmove, just to make damn sure we don't have
 // any differences when running on client or server
+// they are passed to every function along with the pmove_t,
+// there is no global pmove state
 
 typedef struct {
 	vec3_t origin;          // full float precision
@@ -67,8 +69,6 @@ typedef struct {
 	float dashPlayerSpeed;
 } pml_t;
 
-pmove_t *pm;
-pml_t pml;
 
 // movement parameters
 
@@ -98,7 +98,7 @@ const float pm_wjupspeed = ( 330.0f * GRAVITY_COMPENSATE );
 const float pm_failedwjupspeed = ( 50.0f * GRAVITY_COMPENSATE );
 const float pm_wjbouncefactor = 0.3f;
 const float pm_failedwjbouncefactor = 0.1f;
-#define pm_wjminspeed ( ( pml.maxWalkSpeed + pml.maxPlayerSpeed ) * 0.5f )
+#define pm_wjminspeed ( ( pml->maxWalkSpeed + pml->maxPlayerSpeed ) * 0.5f )
 
 //
 // Kurim : some functions/defines that can be useful to work on the horizontal movement of player :
@@ -122,7 +122,7 @@ static vec_t VectorNormalize2D( vec3_t v ) { // ByMiK : normalize horizontally (
 // nbTestDir is the number of directions to test around the player
 // maxZnormal is the max Z value of the normal of a poly to consider it a wall
 // normal becomes a pointer to the normal of the most appropriate wall
-static void PlayerTouchWall( int nbTestDir, float maxZnormal, vec3_t *normal ) {
+static void PlayerTouchWall( pmove_t *pm, pml_t *pml, int nbTestDir, float maxZnormal, vec3_t *normal ) {
 	vec3_t min, max, dir;
 	int i, j;
 	trace_t trace;
@@ -130,9 +130,9 @@ static void PlayerTouchWall( int nbTestDir, float maxZnormal, vec3_t *normal ) {
 	entity_state_t *state;
 
 	for( i = 0; i < nbTestDir; i++ ) {
-		dir[0] = pml.origin[0] + ( pm->maxs[0]*cos( ( M_TWOPI/nbTestDir )*i ) + pml.velocity[0] * 0.015f );
-		dir[1] = pml.origin[1] + ( pm->maxs[1]*sin( ( M_TWOPI/nbTestDir )*i ) + pml.velocity[1] * 0.015f );
-		dir[2] = pml.origin[2];
+		dir[0] = pml->origin[0] + ( pm->maxs[0]*cos( ( M_TWOPI/nbTestDir )*i ) + pml->velocity[0] * 0.015f );
+		dir[1] = pml->origin[1] + ( pm->maxs[1]*sin( ( M_TWOPI/nbTestDir )*i ) + pml->velocity[1] * 0.015f );
+		dir[2] = pml->origin[2];
 
 		for( j = 0; j < 2; j++ ) {
 			min[j] = pm->mins[j];
@@ -140,7 +140,7 @@ static void PlayerTouchWall( int nbTestDir, float maxZnormal, vec3_t *normal ) {
 		}
 		min[2] = max[2] = 0;
 
-		gs.api.Trace( &trace, pml.origin, min, max, dir, pm->playerState->POVnum, pm->contentmask, 0 );
+		gs.api.Trace( &trace, pml->origin, min, max, dir, pm->playerState->POVnum, pm->contentmask, 0 );
 
 		if( trace.allsolid ) return;
 
@@ -178,7 +178,7 @@ static void PlayerTouchWall( int nbTestDir, float maxZnormal, vec3_t *normal ) {
 
 #define MAX_CLIP_PLANES 5
 
-static void PM_AddTouchEnt( int entNum ) {
+static void PM_AddTouchEnt( pmove_t *pm, pml_t *pml, int entNum ) {
 	int i;
 
 	if( pm->numtouch >= MAXTOUCH || entNum < 0 ) {
@@ -198,7 +198,7 @@ static void PM_AddTouchEnt( int entNum ) {
 }
 
 
-static int PM_SlideMove( void ) {
+static int PM_SlideMove( pmove_t *pm, pml_t *pml ) {
 	vec3_t end, dir;
 	vec3_t last_valid_origin;
 	float value;
@@ -207,36 +207,36 @@ static int PM_SlideMove( void ) {
 	trace_t trace;
 	int moves, i, j, k;
 	int maxmoves = 4;
-	float remainingTime = pml.frametime;
+	float remainingTime = pml->frametime;
 	int blockedmask = 0;
 
 	if( pm->groundentity != -1 ) { // clip velocity to ground, no need to wait
 		// if the ground is not horizontal (a ramp) clipping will slow the player down
-		if( pml.groundplane.normal[2] == 1.0f && pml.velocity[2] < 0.0f ) {
-			pml.velocity[2] = 0.0f;
+		if( pml->groundplane.normal[2] == 1.0f && pml->velocity[2] < 0.0f ) {
+			pml->velocity[2] = 0.0f;
 		}
 	}
 
 	// Do a shortcut in this case
 	if( pm->skipCollision ) {
-		VectorMA( pml.origin, remainingTime, pml.velocity, pml.origin );
+		VectorMA( pml->origin, remainingTime, pml->velocity, pml->origin );
 		return blockedmask;
 	}
 
-	VectorCopy( pml.origin, last_valid_origin );
+	VectorCopy( pml->origin, last_valid_origin );
 
 	numplanes = 0; // clean up planes count for checking
 
 	for( moves = 0; moves < maxmoves; moves++ ) {
-		VectorMA( pml.origin, remainingTime, pml.velocity, end );
-		gs.api.Trace( &trace, pml.origin, pm->mins, pm->maxs, end, pm->playerState->POVnum, pm->contentmask, 0 );
+		VectorMA( pml->origin, remainingTime, pml->velocity, end );
+		gs.api.Trace( &trace, pml->origin, pm->mins, pm->maxs, end, pm->playerState->POVnum, pm->contentmask, 0 );
 		if( trace.allsolid ) { // trapped into a solid
-			VectorCopy( last_valid_origin, pml.origin );
+			VectorCopy( last_valid_origin, pml->origin );
 			return SLIDEMOVEFLAG_TRAPPED;
 		}
 
 		if( trace.fraction > 0 ) { // actually covered some distance
-			VectorCopy( trace.endpos, pml.origin );
+			VectorCopy( trace.endpos, pml->origin );
 			VectorCopy( trace.endpos, last_valid_origin );
 		}
 
@@ -245,7 +245,7 @@ static int PM_SlideMove( void ) {
 
 		}
 		// save touched entity for return output
-		PM_AddTouchEnt( trace.ent );
+		PM_AddTouchEnt( pm, pml, trace.ent );
 
 		// at this point we are blocked but not trapped.
 
@@ -262,7 +262,7 @@ static int PM_SlideMove( void ) {
 		// the velocity along it's normal and repeat.
 		for( i = 0; i < numplanes; i++ ) {
 			if( DotProduct( trace.plane.normal, planes[i] ) > ( 1.0f - SLIDEMOVE_PLANEINTERACT_EPSILON ) ) {
-				VectorAdd( trace.plane.normal, pml.velocity, pml.velocity );
+				VectorAdd( trace.plane.normal, pml->velocity, pml->velocity );
 				break;
 			}
 		}
@@ -272,7 +272,7 @@ static int PM_SlideMove( void ) {
 
 		// security check: we can't store more planes
 		if( numplanes >= MAX_CLIP_PLANES ) {
-			VectorClear( pml.velocity );
+			VectorClear( pml->velocity );
 			return SLIDEMOVEFLAG_TRAPPED;
 		}
 
@@ -285,43 +285,43 @@ static int PM_SlideMove( void ) {
 		//
 
 		for( i = 0; i < numplanes; i++ ) {
-			if( DotProduct( pml.velocity, planes[i] ) >= SLIDEMOVE_PLANEINTERACT_EPSILON ) { // would not touch it
+			if( DotProduct( pml->velocity, planes[i] ) >= SLIDEMOVE_PLANEINTERACT_EPSILON ) { // would not touch it
 				continue;
 			}
 
-			GS_ClipVelocity( pml.velocity, planes[i], pml.velocity, PM_OVERBOUNCE );
+			GS_ClipVelocity( pml->velocity, planes[i], pml->velocity, PM_OVERBOUNCE );
 			// see if we enter a second plane
 			for( j = 0; j < numplanes; j++ ) {
 				if( j == i ) { // it's the same plane
 					continue;
 				}
-				if( DotProduct( pml.velocity, planes[j] ) >= SLIDEMOVE_PLANEINTERACT_EPSILON ) {
+				if( DotProduct( pml->velocity, planes[j] ) >= SLIDEMOVE_PLANEINTERACT_EPSILON ) {
 					continue; // not with this one
 
 				}
 				//there was a second one. Try to slide along it too
-				GS_ClipVelocity( pml.velocity, planes[j], pml.velocity, PM_OVERBOUNCE );
+				GS_ClipVelocity( pml->velocity, planes[j], pml->velocity, PM_OVERBOUNCE );
 
 				// check if the slide sent it back to the first plane
-				if( DotProduct( pml.velocity, planes[i] ) >= SLIDEMOVE_PLANEINTERACT_EPSILON ) {
+				if( DotProduct( pml->velocity, planes[i] ) >= SLIDEMOVE_PLANEINTERACT_EPSILON ) {
 					continue;
 				}
 
 				// bad luck: slide the original velocity along the crease
 				CrossProduct( planes[i], planes[j], dir );
 				VectorNormalize( dir );
-				value = DotProduct( dir, pml.velocity );
-				VectorScale( dir, value, pml.velocity );
+				value = DotProduct( dir, pml->velocity );
+				VectorScale( dir, value, pml->velocity );
 
 				// check if there is a third plane, in that case we're trapped
 				for( k = 0; k < numplanes; k++ ) {
 					if( j == k || i == k ) { // it's the same plane
 						continue;
 					}
-					if( DotProduct( pml.velocity, planes[k] ) >= SLIDEMOVE_PLANEINTERACT_EPSILON ) {
+					if( DotProduct( pml->velocity, planes[k] ) >= SLIDEMOVE_PLANEINTERACT_EPSILON ) {
 						continue; // not with this one
 					}
-					VectorClear( pml.velocity );
+					VectorClear( pml->velocity );
 					break;
 				}
 			}
@@ -337,7 +337,7 @@ static int PM_SlideMove( void ) {
 * Each intersection will try to step over the obstruction instead of
 * sliding along it.
 */
-static void PM_StepSlideMove( void ) {
+static void PM_StepSlideMove( pmove_t *pm, pml_t *pml ) {
 	vec3_t start_o, start_v;
 	vec3_t down_o, down_v;
 	trace_t trace;
@@ -346,10 +346,10 @@ static void PM_StepSlideMove( void ) {
 	vec3_t up, down;
 	int blocked;
 
-	VectorCopy( pml.origin, start_o );
-	VectorCopy( pml.velocity, start_v );
+	VectorCopy( pml->origin, start_o );
+	VectorCopy( pml->velocity, start_v );
 
-	blocked = PM_SlideMove();
+	blocked = PM_SlideMove( pm, pml );
 
 	// We have modified the origin in PM_SlideMove() in this case.
 	// No further computations are required.
@@ -357,8 +357,8 @@ static void PM_StepSlideMove( void ) {
 		return;
 	}
 
-	VectorCopy( pml.origin, down_o );
-	VectorCopy( pml.velocity, down_v );
+	VectorCopy( pml->origin, down_o );
+	VectorCopy( pml->velocity, down_v );
 
 	VectorCopy( start_o, up );
 	up[2] += STEPSIZE;
@@ -369,20 +369,20 @@ static void PM_StepSlideMove( void ) {
 
 	}
 	// try sliding above
-	VectorCopy( up, pml.origin );
-	VectorCopy( start_v, pml.velocity );
+	VectorCopy( up, pml->origin );
+	VectorCopy( start_v, pml->velocity );
 
-	PM_SlideMove();
+	PM_SlideMove( pm, pml );
 
 	// push down the final amount
-	VectorCopy( pml.origin, down );
+	VectorCopy( pml->origin, down );
 	down[2] -= STEPSIZE;
-	gs.api.Trace( &trace, pml.origin, pm->mins, pm->maxs, down, pm->playerState->POVnum, pm->contentmask, 0 );
+	gs.api.Trace( &trace, pml->origin, pm->mins, pm->maxs, down, pm->playerState->POVnum, pm->contentmask, 0 );
 	if( !trace.allsolid ) {
-		VectorCopy( trace.endpos, pml.origin );
+		VectorCopy( trace.endpos, pml->origin );
 	}
 
-	VectorCopy( pml.origin, up );
+	VectorCopy( pml->origin, up );
 
 	// decide which one went farther
 	down_dist = ( down_o[0] - start_o[0] ) * ( down_o[0] - start_o[0] )
@@ -391,24 +391,24 @@ static void PM_StepSlideMove( void ) {
 			  + ( up[1] - start_o[1] ) * ( up[1] - start_o[1] );
 
 	if( down_dist >= up_dist || trace.allsolid || ( trace.fraction != 1.0 && !ISWALKABLEPLANE( &trace.plane ) ) ) {
-		VectorCopy( down_o, pml.origin );
-		VectorCopy( down_v, pml.velocity );
+		VectorCopy( down_o, pml->origin );
+		VectorCopy( down_v, pml->velocity );
 		return;
 	}
 
 	// only add the stepping output when it was a vertical step (second case is at the exit of a ramp)
 	if( ( blocked & SLIDEMOVEFLAG_WALL_BLOCKED ) || trace.plane.normal[2] == 1.0f - SLIDEMOVE_PLANEINTERACT_EPSILON ) {
-		pm->step = ( pml.origin[2] - pml.previous_origin[2] );
+		pm->step = ( pml->origin[2] - pml->previous_origin[2] );
 	}
 
 	// Preserve speed when sliding up ramps
 	hspeed = sqrt( start_v[0] * start_v[0] + start_v[1] * start_v[1] );
 	if( hspeed && ISWALKABLEPLANE( &trace.plane ) ) {
 		if( trace.plane.normal[2] >= 1.0f - SLIDEMOVE_PLANEINTERACT_EPSILON ) {
-			VectorCopy( start_v, pml.velocity );
+			VectorCopy( start_v, pml->velocity );
 		} else {
-			VectorNormalize2D( pml.velocity );
-			VectorScale2D( pml.velocity, hspeed, pml.velocity );
+			VectorNormalize2D( pml->velocity );
+			VectorScale2D( pml->velocity, hspeed, pml->velocity );
 		}
 	}
 
@@ -416,7 +416,7 @@ static void PM_StepSlideMove( void ) {
 
 	//!! Special case
 	// if we were walking along a plane, then we need to copy the Z over
-	pml.velocity[2] = down_v[2];
+	pml->velocity[2] = down_v[2];
 }
 
 /*
@@ -424,13 +424,13 @@ static void PM_StepSlideMove( void ) {
 *
 * Handles both ground friction and water friction
 */
-static void PM_Friction( void ) {
+static void PM_Friction( pmove_t *pm, pml_t *pml ) {
 	float *vel;
 	float speed, newspeed, control;
 	float friction;
 	float drop;
 
-	vel = pml.velocity;
+	vel = pml->velocity;
 
 	speed = vel[0] * vel[0] + vel[1] * vel[1] + vel[2] * vel[2];
 	if( speed < 1 ) {
@@ -443,18 +443,18 @@ static void PM_Friction( void ) {
 	drop = 0;
 
 	// apply ground friction
-	if( ( ( ( ( pm->groundentity != -1 ) && !( pml.groundsurfFlags & SURF_SLICK ) ) )
-		  && ( pm->waterlevel < 2 ) ) || pml.ladder ) {
+	if( ( ( ( ( pm->groundentity != -1 ) && !( pml->groundsurfFlags & SURF_SLICK ) ) )
+		  && ( pm->waterlevel < 2 ) ) || pml->ladder ) {
 		if( pm->playerState->pmove.stats[PM_STAT_KNOCKBACK] <= 0 ) {
 			friction = pm_friction;
 			control = speed < pm_decelerate ? pm_decelerate : speed;
-			drop += control * friction * pml.frametime;
+			drop += control * friction * pml->frametime;
 		}
 	}
 
 	// apply water friction
-	if( ( pm->waterlevel >= 2 ) && !pml.ladder ) {
-		drop += speed * pm_waterfriction * pm->waterlevel * pml.frametime;
+	if( ( pm->waterlevel >= 2 ) && !pml->ladder ) {
+		drop += speed * pm_waterfriction * pm->waterlevel * pml->frametime;
 	}
 
 	// scale the velocity
@@ -473,25 +473,25 @@ static void PM_Friction( void ) {
 *
 * Handles user intended acceleration
 */
-static void PM_Accelerate( vec3_t wishdir, float wishspeed, float accel ) {
+static void PM_Accelerate( pmove_t *pm, pml_t *pml, vec3_t wishdir, float wishspeed, float accel ) {
 	float addspeed, accelspeed, currentspeed;
 
-	currentspeed = DotProduct( pml.velocity, wishdir );
+	currentspeed = DotProduct( pml->velocity, wishdir );
 	addspeed = wishspeed - currentspeed;
 	if( addspeed <= 0 ) {
 		return;
 	}
 
-	accelspeed = accel * pml.frametime * wishspeed;
+	accelspeed = accel * pml->frametime * wishspeed;
 	if( accelspeed > addspeed ) {
 		accelspeed = addspeed;
 	}
 
-	VectorMA( pml.velocity, accelspeed, wishdir, pml.velocity );
+	VectorMA( pml->velocity, accelspeed, wishdir, pml->velocity );
 }
 
 // when using +strafe convert the inertia to forward speed.
-static void PM_Aircontrol( vec3_t wishdir, float wishspeed ) {
+static void PM_Aircontrol( pmove_t *pm, pml_t *pml, vec3_t wishdir, float wishspeed ) {
 	int i;
 	float zspeed, speed, dot, k;
 	float smove;
@@ -501,50 +501,50 @@ static void PM_Aircontrol( vec3_t wishdir, float wishspeed ) {
 	}
 
 	// accelerate
-	smove = pml.sidePush;
+	smove = pml->sidePush;
 
 	if( ( smove > 0 || smove < 0 ) || ( wishspeed == 0.0 ) ) {
 		return; // can't control movement if not moving forward or backward
 
 	}
-	zspeed = pml.velocity[2];
-	pml.velocity[2] = 0;
-	speed = VectorNormalize( pml.velocity );
+	zspeed = pml->velocity[2];
+	pml->velocity[2] = 0;
+	speed = VectorNormalize( pml->velocity );
 
 
-	dot = DotProduct( pml.velocity, wishdir );
-	k = 32.0f * pm_aircontrol * dot * dot * pml.frametime;
+	dot = DotProduct( pml->velocity, wishdir );
+	k = 32.0f * pm_aircontrol * dot * dot * pml->frametime;
 
 	if( dot > 0 ) {
 		// we can't change direction while slowing down
 		for( i = 0; i < 2; i++ )
-			pml.velocity[i] = pml.velocity[i] * speed + wishdir[i] * k;
+			pml->velocity[i] = pml->velocity[i] * speed + wishdir[i] * k;
 
-		VectorNormalize( pml.velocity );
+		VectorNormalize( pml->velocity );
 	}
 
 	for( i = 0; i < 2; i++ )
-		pml.velocity[i] *= speed;
+		pml->velocity[i] *= speed;
 
-	pml.velocity[2] = zspeed;
+	pml->velocity[2] = zspeed;
 }
 
 /*
 * PM_AddCurrents
 */
-static void PM_AddCurrents( vec3_t wishvel ) {
+static void PM_AddCurrents( pmove_t *pm, pml_t *pml, vec3_t wishvel ) {
 	//
 	// account for ladders
 	//
 
-	if( pml.ladder && fabs( pml.velocity[2] ) <= DEFAULT_LADDERSPEED ) {
-		if( ( pm->playerState->viewangles[PITCH] <= -15 ) && ( pml.forwardPush > 0 ) ) {
+	if( pml->ladder && fabs( pml->velocity[2] ) <= DEFAULT_LADDERSPEED ) {
+		if( ( pm->playerState->viewangles[PITCH] <= -15 ) && ( pml->forwardPush > 0 ) ) {
 			wishvel[2] = DEFAULT_LADDERSPEED;
-		} else if( ( pm->playerState->viewangles[PITCH] >= 15 ) && ( pml.forwardPush > 0 ) ) {
+		} else if( ( pm->playerState->viewangles[PITCH] >= 15 ) && ( pml->forwardPush > 0 ) ) {
 			wishvel[2] = -DEFAULT_LADDERSPEED;
-		} else if( pml.upPush > 0 ) {
+		} else if( pml->upPush > 0 ) {
 			wishvel[2] = DEFAULT_LADDERSPEED;
-		} else if( pml.upPush < 0 ) {
+		} else if( pml->upPush < 0 ) {
 			wishvel[2] = -DEFAULT_LADDERSPEED;
 		} else {
 			wishvel[2] = 0;
@@ -560,7 +560,7 @@ static void PM_AddCurrents( vec3_t wishvel ) {
 * PM_WaterMove
 *
 */
-static void PM_WaterMove( void ) {
+static void PM_WaterMove( pmove_t *pm, pml_t *pml ) {
 	int i;
 	vec3_t wishvel;
 	float wishspeed;
@@ -568,35 +568,35 @@ static void PM_WaterMove( void ) {
 
 	// user intentions
 	for( i = 0; i < 3; i++ )
-		wishvel[i] = pml.forward[i] * pml.forwardPush + pml.right[i] * pml.sidePush;
+		wishvel[i] = pml->forward[i] * pml->forwardPush + pml->right[i] * pml->sidePush;
 
-	if( !pml.forwardPush && !pml.sidePush && !pml.upPush ) {
+	if( !pml->forwardPush && !pml->sidePush && !pml->upPush ) {
 		wishvel[2] -= 60; // drift towards bottom
 	} else {
-		wishvel[2] += pml.upPush;
+		wishvel[2] += pml->upPush;
 	}
 
-	PM_AddCurrents( wishvel );
+	PM_AddCurrents( pm, pml, wishvel );
 
 	VectorCopy( wishvel, wishdir );
 	wishspeed = VectorNormalize( wishdir );
 
-	if( wishspeed > pml.maxPlayerSpeed ) {
-		wishspeed = pml.maxPlayerSpeed / wishspeed;
+	if( wishspeed > pml->maxPlayerSpeed ) {
+		wishspeed = pml->maxPlayerSpeed / wishspeed;
 		VectorScale( wishvel, wishspeed, wishvel );
-		wishspeed = pml.maxPlayerSpeed;
+		wishspeed = pml->maxPlayerSpeed;
 	}
 	wishspeed *= 0.5;
 
-	PM_Accelerate( wishdir, wishspeed, pm_wateraccelerate );
-	PM_StepSlideMove();
+	PM_Accelerate( pm, pml, wishdir, wishspeed, pm_wateraccelerate );
+	PM_StepSlideMove( pm, pml );
 }
 
 /*
 * PM_Move -- Kurim
 *
 */
-static void PM_Move( void ) {
+static void PM_Move( pmove_t *pm, pml_t *pml ) {
 	int i;
 	vec3_t wishvel;
 	float fmove, smove;
@@ -606,14 +606,14 @@ static void PM_Move( void ) {
 	float accel;
 	float wishspeed2;
 
-	fmove = pml.forwardPush;
-	smove = pml.sidePush;
+	fmove = pml->forwardPush;
+	smove = pml->sidePush;
 
 	for( i = 0; i < 2; i++ )
-		wishvel[i] = pml.forward[i] * fmove + pml.right[i] * smove;
+		wishvel[i] = pml->forward[i] * fmove + pml->right[i] * smove;
 	wishvel[2] = 0;
 
-	PM_AddCurrents( wishvel );
+	PM_AddCurrents( pm, pml, wishvel );
 
 	VectorCopy( wishvel, wishdir );
 	wishspeed = VectorNormalize( wishdir );
@@ -621,11 +621,11 @@ static void PM_Move( void ) {
 	// clamp to server defined max speed
 
 	if( pm->playerState->pmove.stats[PM_STAT_CROUCHTIME] ) {
-		maxspeed = pml.maxCrouchedSpeed;
+		maxspeed = pml->maxCrouchedSpeed;
 	} else if( ( pm->cmd.buttons & BUTTON_WALK ) && ( pm->playerState->pmove.stats[PM_STAT_FEATURES] & PMFEAT_WALK ) ) {
-		maxspeed = pml.maxWalkSpeed;
+		maxspeed = pml->maxWalkSpeed;
 	} else {
-		maxspeed = pml.maxPlayerSpeed;
+		maxspeed = pml->maxPlayerSpeed;
 	}
 
 	if( wishspeed > maxspeed ) {
@@ -634,50 +634,50 @@ static void PM_Move( void ) {
 		wishspeed = maxspeed;
 	}
 
-	if( pml.ladder ) {
-		PM_Accelerate( wishdir, wishspeed, pm_accelerate );
+	if( pml->ladder ) {
+		PM_Accelerate( pm, pml, wishdir, wishspeed, pm_accelerate );
 
 		if( !wishvel[2] ) {
-			if( pml.velocity[2] > 0 ) {
-				pml.velocity[2] -= pm->playerState->pmove.gravity * pml.frametime;
-				if( pml.velocity[2] < 0 ) {
-					pml.velocity[2]  = 0;
+			if( pml->velocity[2] > 0 ) {
+				pml->velocity[2] -= pm->playerState->pmove.gravity * pml->frametime;
+				if( pml->velocity[2] < 0 ) {
+					pml->velocity[2]  = 0;
 				}
 			} else {
-				pml.velocity[2] += pm->playerState->pmove.gravity * pml.frametime;
-				if( pml.velocity[2] > 0 ) {
-					pml.velocity[2]  = 0;
+				pml->velocity[2] += pm->playerState->pmove.gravity * pml->frametime;
+				if( pml->velocity[2] > 0 ) {
+					pml->velocity[2]  = 0;
 				}
 			}
 		}
 
-		PM_StepSlideMove();
+		PM_StepSlideMove( pm, pml );
 	} else if( pm->groundentity != -1 ) {
 		// walking on ground
-		if( pml.velocity[2] > 0 ) {
-			pml.velocity[2] = 0; //!!! this is before the accel
+		if( pml->velocity[2] > 0 ) {
+			pml->velocity[2] = 0; //!!! this is before the accel
 
 		}
-		PM_Accelerate( wishdir, wishspeed, pm_accelerate );
+		PM_Accelerate( pm, pml, wishdir, wishspeed, pm_accelerate );
 
 		// fix for negative trigger_gravity fields
 		if( pm->playerState->pmove.gravity > 0 ) {
-			if( pml.velocity[2] > 0 ) {
-				pml.velocity[2] = 0;
+			if( pml->velocity[2] > 0 ) {
+				pml->velocity[2] = 0;
 			}
 		} else {
-			pml.velocity[2] -= pm->playerState->pmove.gravity * pml.frametime;
+			pml->velocity[2] -= pm->playerState->pmove.gravity * pml->frametime;
 		}
 
-		if( !pml.velocity[0] && !pml.velocity[1] ) {
+		if( !pml->velocity[0] && !pml->velocity[1] ) {
 			return;
 		}
 
-		PM_StepSlideMove();
+		PM_StepSlideMove( pm, pml );
 	} else {
 		// Air Control
 		wishspeed2 = wishspeed;
-		if( DotProduct( pml.velocity, wishdir ) < 0
+		if( DotProduct( pml->velocity, wishdir ) < 0
 			&& !( pm->playerState->pmove.pm_flags & PMF_WALLJUMPING )
 			&& ( pm->playerState->pmove.stats[PM_STAT_KNOCKBACK] <= 0 ) ) {
 			accel = pm_airdecelerate;
@@ -696,14 +696,14 @@ static void PM_Move( void ) {
 		}
 
 		// Air control
-		PM_Accelerate( wishdir, wishspeed, accel );
+		PM_Accelerate( pm, pml, wishdir, wishspeed, accel );
 		if( pm_aircontrol && !( pm->playerState->pmove.pm_flags & PMF_WALLJUMPING ) && ( pm->playerState->pmove.stats[PM_STAT_KNOCKBACK] <= 0 ) ) { // no air ctrl while wjing
-			PM_Aircontrol( wishdir, wishspeed2 );
+			PM_Aircontrol( pm, pml, wishdir, wishspeed2 );
 		}
 
 		// add gravity
-		pml.velocity[2] -= pm->playerState->pmove.gravity * pml.frametime;
-		PM_StepSlideMove();
+		pml->velocity[2] -= pm->playerState->pmove.gravity * pml->frametime;
+		PM_StepSlideMove( pm, pml );
 	}
 }
 
@@ -712,7 +712,7 @@ static void PM_Move( void ) {
 *
 * If the player hull point one-quarter unit down is solid, the player is on ground
 */
-static void PM_GroundTrace( trace_t *trace ) {
+static void PM_GroundTrace( pmove_t *pm, pml_t *pml, trace_t *trace ) {
 	vec3_t point;
 
 	if( pm->skipCollision ) {
@@ -722,17 +722,17 @@ static void PM_GroundTrace( trace_t *trace ) {
 	}
 
 	// see if standing on something solid
-	point[0] = pml.origin[0];
-	point[1] = pml.origin[1];
-	point[2] = pml.origin[2] - 0.25;
+	point[0] = pml->origin[0];
+	point[1] = pml->origin[1];
+	point[2] = pml->origin[2] - 0.25;
 
-	gs.api.Trace( trace, pml.origin, pm->mins, pm->maxs, point, pm->playerState->POVnum, pm->contentmask, 0 );
+	gs.api.Trace( trace, pml->origin, pm->mins, pm->maxs, point, pm->playerState->POVnum, pm->contentmask, 0 );
 }
 
 /*
 * PM_GoodPosition
 */
-static bool PM_GoodPosition( vec3_t origin, trace_t *trace ) {
+static bool PM_GoodPosition( pmove_t *pm, pml_t *pml, vec3_t origin, trace_t *trace ) {
 	if( pm->playerState->pmove.pm_type == PM_SPECTATOR ) {
 		return true;
 	}
@@ -745,57 +745,57 @@ static bool PM_GoodPosition( vec3_t origin, trace_t *trace ) {
 /*
 * PM_UnstickPosition
 */
-static void PM_UnstickPosition( trace_t *trace ) {
+static void PM_UnstickPosition( pmove_t *pm, pml_t *pml, trace_t *trace ) {
 	int j;
 	vec3_t origin;
 
-	VectorCopy( pml.origin, origin );
+	VectorCopy( pml->origin, origin );
 
 	// try all combinations
 	for( j = 0; j < 8; j++ ) {
-		VectorCopy( pml.origin, origin );
+		VectorCopy( pml->origin, origin );
 
 		origin[0] += ( ( j & 1 ) ? -1 : 1 );
 		origin[1] += ( ( j & 2 ) ? -1 : 1 );
 		origin[2] += ( ( j & 4 ) ? -1 : 1 );
 
-		if( PM_GoodPosition( origin, trace ) ) {
-			VectorCopy( origin, pml.origin );
-			PM_GroundTrace( trace );
+		if( PM_GoodPosition( pm, pml, origin, trace ) ) {
+			VectorCopy( origin, pml->origin );
+			PM_GroundTrace( pm, pml, trace );
 			return;
 		}
 	}
 
 	// go back to the last position
-	VectorCopy( pml.previous_origin, pml.origin );
+	VectorCopy( pml->previous_origin, pml->origin );
 }
 
 /*
 * PM_CategorizePosition
 */
-static void PM_CategorizePosition( void ) {
+static void PM_CategorizePosition( pmove_t *pm, pml_t *pml ) {
 	vec3_t point;
 	int cont;
 	int sample1;
 	int sample2;
 
-	if( pml.velocity[2] > 180 ) { // !!ZOID changed from 100 to 180 (ramp accel)
+	if( pml->velocity[2] > 180 ) { // !!ZOID changed from 100 to 180 (ramp accel)
 		pm->playerState->pmove.pm_flags &= ~PMF_ON_GROUND;
 		pm->groundentity = -1;
 	} else {
 		trace_t trace;
 
 		// see if standing on something solid
-		PM_GroundTrace( &trace );
+		PM_GroundTrace( pm, pml, &trace );
 
 		if( trace.allsolid ) {
 			// try to unstick position
-			PM_UnstickPosition( &trace );
+			PM_UnstickPosition( pm, pml, &trace );
 		}
 
-		pml.groundplane = trace.plane;
-		pml.groundsurfFlags = trace.surfFlags;
-		pml.groundcontents = trace.contents;
+		pml->groundplane = trace.plane;
+		pml->groundsurfFlags = trace.surfFlags;
+		pml->groundcontents = trace.contents;
 
 		if( ( trace.fraction == 1 ) || ( !ISWALKABLEPLANE( &trace.plane ) && !trace.startsolid ) ) {
 			pm->groundentity = -1;
@@ -832,19 +832,19 @@ static void PM_CategorizePosition( void ) {
 	sample2 = pm->playerState->viewheight - pm->mins[2];
 	sample1 = sample2 / 2;
 
-	point[0] = pml.origin[0];
-	point[1] = pml.origin[1];
-	point[2] = pml.origin[2] + pm->mins[2] + 1;
+	point[0] = pml->origin[0];
+	point[1] = pml->origin[1];
+	point[2] = pml->origin[2] + pm->mins[2] + 1;
 	cont = gs.api.PointContents( point, 0 );
 
 	if( cont & MASK_WATER ) {
 		pm->watertype = cont;
 		pm->waterlevel = 1;
-		point[2] = pml.origin[2] + pm->mins[2] + sample1;
+		point[2] = pml->origin[2] + pm->mins[2] + sample1;
 		cont = gs.api.PointContents( point, 0 );
 		if( cont & MASK_WATER ) {
 			pm->waterlevel = 2;
-			point[2] = pml.origin[2] + pm->mins[2] + sample2;
+			point[2] = pml->origin[2] + pm->mins[2] + sample2;
 			cont = gs.api.PointContents( point, 0 );
 			if( cont & MASK_WATER ) {
 				pm->waterlevel = 3;
@@ -853,12 +853,12 @@ static void PM_CategorizePosition( void ) {
 	}
 }
 
-static void PM_ClearDash( void ) {
+static void PM_ClearDash( pmove_t *pm, pml_t *pml ) {
 	pm->playerState->pmove.pm_flags &= ~PMF_DASHING;
 	pm->playerState->pmove.stats[PM_STAT_DASHTIME] = 0;
 }
 
-static void PM_ClearWallJump( void ) {
+static void PM_ClearWallJump( pmove_t *pm, pml_t *pml ) {
 	pm->playerState->pmove.pm_flags &= ~PMF_WALLJUMPING;
 	pm->playerState->pmove.pm_flags &= ~PMF_WALLJUMPCOUNT;
 	pm->playerState->pmove.stats[PM_STAT_WJTIME] = 0;
@@ -867,8 +867,8 @@ static void PM_ClearWallJump( void ) {
 /*
 * PM_CheckJump
 */
-static void PM_CheckJump( void ) {
-	if( pml.upPush < 10 ) {
+static void PM_CheckJump( pmove_t *pm, pml_t *pml ) {
+	if( pml->upPush < 10 ) {
 		return;
 	}
 
@@ -892,31 +892,31 @@ static void PM_CheckJump( void ) {
 	pm->groundentity = -1;
 
 	// clip against the ground when jumping if moving that direction
-	if( pml.groundplane.normal[2] > 0 && pml.velocity[2] < 0 && DotProduct2D( pml.groundplane.normal, pml.velocity ) > 0 ) {
-		GS_ClipVelocity( pml.velocity, pml.groundplane.normal, pml.velocity, PM_OVERBOUNCE );
+	if( pml->groundplane.normal[2] > 0 && pml->velocity[2] < 0 && DotProduct2D( pml->groundplane.normal, pml->velocity ) > 0 ) {
+		GS_ClipVelocity( pml->velocity, pml->groundplane.normal, pml->velocity, PM_OVERBOUNCE );
 	}
 
-	if( pml.velocity[2] > 100 ) {
+	if( pml->velocity[2] > 100 ) {
 		gs.api.PredictedEvent( pm->playerState->POVnum, EV_DOUBLEJUMP, 0 );
-		pml.velocity[2] += pml.jumpPlayerSpeed;
-	} else if( pml.velocity[2] > 0 ) {
+		pml->velocity[2] += pml->jumpPlayerSpeed;
+	} else if( pml->velocity[2] > 0 ) {
 		gs.api.PredictedEvent( pm->playerState->POVnum, EV_JUMP, 0 );
-		pml.velocity[2] += pml.jumpPlayerSpeed;
+		pml->velocity[2] += pml->jumpPlayerSpeed;
 	} else {
 		gs.api.PredictedEvent( pm->playerState->POVnum, EV_JUMP, 0 );
-		pml.velocity[2] = pml.jumpPlayerSpeed;
+		pml->velocity[2] = pml->jumpPlayerSpeed;
 	}
 
 	// remove wj count
 	pm->playerState->pmove.pm_flags &= ~PMF_JUMPPAD_TIME;
-	PM_ClearDash();
-	PM_ClearWallJump();
+	PM_ClearDash( pm, pml );
+	PM_ClearWallJump( pm, pml );
 }
 
 /*
 * PM_CheckDash -- by Kurim
 */
-static void PM_CheckDash( void ) {
+static void PM_CheckDash( pmove_t *pm, pml_t *pml ) {
 	float actual_velocity;
 	float upspeed;
 	vec3_t dashdir;
@@ -944,54 +944,54 @@ static void PM_CheckDash( void ) {
 		}
 
 		pm->playerState->pmove.pm_flags &= ~PMF_JUMPPAD_TIME;
-		PM_ClearWallJump();
+		PM_ClearWallJump( pm, pml );
 
 		pm->playerState->pmove.pm_flags |= PMF_DASHING;
 		pm->playerState->pmove.pm_flags |= PMF_SPECIAL_HELD;
 		pm->groundentity = -1;
 
 		// clip against the ground when jumping if moving that direction
-		if( pml.groundplane.normal[2] > 0 && pml.velocity[2] < 0 && DotProduct2D( pml.groundplane.normal, pml.velocity ) > 0 ) {
-			GS_ClipVelocity( pml.velocity, pml.groundplane.normal, pml.velocity, PM_OVERBOUNCE );
+		if( pml->groundplane.normal[2] > 0 && pml->velocity[2] < 0 && DotProduct2D( pml->groundplane.normal, pml->velocity ) > 0 ) {
+			GS_ClipVelocity( pml->velocity, pml->groundplane.normal, pml->velocity, PM_OVERBOUNCE );
 		}
 
-		if( pml.velocity[2] <= 0.0f ) {
+		if( pml->velocity[2] <= 0.0f ) {
 			upspeed = pm_dashupspeed;
 		} else {
-			upspeed = pm_dashupspeed + pml.velocity[2];
+			upspeed = pm_dashupspeed + pml->velocity[2];
 		}
 
 		// ch : we should do explicit forwardPush here, and ignore sidePush ?
-		VectorMA( vec3_origin, pml.forwardPush, pml.flatforward, dashdir );
-		VectorMA( dashdir, pml.sidePush, pml.right, dashdir );
+		VectorMA( vec3_origin, pml->forwardPush, pml->flatforward, dashdir );
+		VectorMA( dashdir, pml->sidePush, pml->right, dashdir );
 		dashdir[2] = 0.0;
 
 		if( VectorLength( dashdir ) < 0.01f ) { // if not moving, dash like a "forward dash"
-			VectorCopy( pml.flatforward, dashdir );
+			VectorCopy( pml->flatforward, dashdir );
 		}
 
 		VectorNormalizeFast( dashdir );
 
-		actual_velocity = VectorNormalize2D( pml.velocity );
-		if( actual_velocity <= pml.dashPlayerSpeed ) {
-			VectorScale( dashdir, pml.dashPlayerSpeed, dashdir );
+		actual_velocity = VectorNormalize2D( pml->velocity );
+		if( actual_velocity <= pml->dashPlayerSpeed ) {
+			VectorScale( dashdir, pml->dashPlayerSpeed, dashdir );
 		} else {
 			VectorScale( dashdir, actual_velocity, dashdir );
 		}
 
-		VectorCopy( dashdir, pml.velocity );
-		pml.velocity[2] = upspeed;
+		VectorCopy( dashdir, pml->velocity );
+		pml->velocity[2] = upspeed;
 
 		pm->playerState->pmove.stats[PM_STAT_DASHTIME] = PM_DASHJUMP_TIMEDELAY;
 
 		// return sound events
-		if( fabs( pml.sidePush ) > 10 && fabs( pml.sidePush ) >= fabs( pml.forwardPush ) ) {
-			if( pml.sidePush > 0 ) {
+		if( fabs( pml->sidePush ) > 10 && fabs( pml->sidePush ) >= fabs( pml->forwardPush ) ) {
+			if( pml->sidePush > 0 ) {
 				gs.api.PredictedEvent( pm->playerState->POVnum, EV_DASH, 2 );
 			} else {
 				gs.api.PredictedEvent( pm->playerState->POVnum, EV_DASH, 1 );
 			}
-		} else if( pml.forwardPush < -10 ) {
+		} else if( pml->forwardPush < -10 ) {
 			gs.api.PredictedEvent( pm->playerState->POVnum, EV_DASH, 3 );
 		} else {
 			gs.api.PredictedEvent( pm->playerState->POVnum, EV_DASH, 0 );
@@ -1004,7 +1004,7 @@ static void PM_CheckDash( void ) {
 /*
 * PM_CheckWallJump -- By Kurim
 */
-static void PM_CheckWallJump( void ) {
+static void PM_CheckWallJump( pmove_t *pm, pml_t *pml ) {
 	vec3_t normal;
 	float hspeed;
 
@@ -1017,7 +1017,7 @@ static void PM_CheckWallJump( void ) {
 		pm->playerState->pmove.pm_flags &= ~PMF_WALLJUMPCOUNT;
 	}
 
-	if( pm->playerState->pmove.pm_flags & PMF_WALLJUMPING && pml.velocity[2] < 0.0 ) {
+	if( pm->playerState->pmove.pm_flags & PMF_WALLJUMPING && pml->velocity[2] < 0.0 ) {
 		pm->playerState->pmove.pm_flags &= ~PMF_WALLJUMPING;
 	}
 
@@ -1047,45 +1047,45 @@ static void PM_CheckWallJump( void ) {
 		trace_t trace;
 		vec3_t point;
 
-		point[0] = pml.origin[0];
-		point[1] = pml.origin[1];
-		point[2] = pml.origin[2] - STEPSIZE;
+		point[0] = pml->origin[0];
+		point[1] = pml->origin[1];
+		point[2] = pml->origin[2] - STEPSIZE;
 
 		// don't walljump if our height is smaller than a step
 		// unless jump is pressed or the player is moving faster than dash speed and upwards
-		hspeed = VectorLengthFast( tv( pml.velocity[0], pml.velocity[1], 0 ) );
-		gs.api.Trace( &trace, pml.origin, pm->mins, pm->maxs, point, pm->playerState->POVnum, pm->contentmask, 0 );
+		hspeed = VectorLengthFast( tv( pml->velocity[0], pml->velocity[1], 0 ) );
+		gs.api.Trace( &trace, pml->origin, pm->mins, pm->maxs, point, pm->playerState->POVnum, pm->contentmask, 0 );
 
-		if( pml.upPush >= 10
-			|| ( hspeed > pm->playerState->pmove.stats[PM_STAT_DASHSPEED] && pml.velocity[2] > 8 )
+		if( pml->upPush >= 10
+			|| ( hspeed > pm->playerState->pmove.stats[PM_STAT_DASHSPEED] && pml->velocity[2] > 8 )
 			|| ( trace.fraction == 1 ) || ( !ISWALKABLEPLANE( &trace.plane ) && !trace.startsolid ) ) {
 			VectorClear( normal );
-			PlayerTouchWall( 12, 0.3f, &normal );
+			PlayerTouchWall( pm, pml, 12, 0.3f, &normal );
 			if( !VectorLength( normal ) ) {
 				return;
 			}
 
 			if( !( pm->playerState->pmove.pm_flags & PMF_SPECIAL_HELD )
 				&& !( pm->playerState->pmove.pm_flags & PMF_WALLJUMPING ) ) {
-				float oldupvelocity = pml.velocity[2];
-				pml.velocity[2] = 0.0;
+				float oldupvelocity = pml->velocity[2];
+				pml->velocity[2] = 0.0;
 
-				hspeed = VectorNormalize2D( pml.velocity );
+				hspeed = VectorNormalize2D( pml->velocity );
 
-				GS_ClipVelocity( pml.velocity, normal, pml.velocity, 1.0005f );
-				VectorMA( pml.velocity, pm_wjbouncefactor, normal, pml.velocity );
+				GS_ClipVelocity( pml->velocity, normal, pml->velocity, 1.0005f );
+				VectorMA( pml->velocity, pm_wjbouncefactor, normal, pml->velocity );
 
 				if( hspeed < pm_wjminspeed ) {
 					hspeed = pm_wjminspeed;
 				}
 
-				VectorNormalize( pml.velocity );
+				VectorNormalize( pml->velocity );
 
-				VectorScale( pml.velocity, hspeed, pml.velocity );
-				pml.velocity[2] = ( oldupvelocity > pm_wjupspeed ) ? oldupvelocity : pm_wjupspeed; // jal: if we had a faster upwards speed, keep it
+				VectorScale( pml->velocity, hspeed, pml->velocity );
+				pml->velocity[2] = ( oldupvelocity > pm_wjupspeed ) ? oldupvelocity : pm_wjupspeed; // jal: if we had a faster upwards speed, keep it
 
 				// set the walljumping state
-				PM_ClearDash();
+				PM_ClearDash( pm, pml );
 				pm->playerState->pmove.pm_flags &= ~PMF_JUMPPAD_TIME;
 
 				pm->playerState->pmove.pm_flags |= PMF_WALLJUMPING;
@@ -1107,7 +1107,7 @@ static void PM_CheckWallJump( void ) {
 /*
 * PM_CheckSpecialMovement
 */
-static void PM_CheckSpecialMovement( void ) {
+static void PM_CheckSpecialMovement( pmove_t *pm, pml_t *pml ) {
 	vec3_t spot;
 	int cont;
 	trace_t trace;
@@ -1118,14 +1118,14 @@ static void PM_CheckSpecialMovement( void ) {
 		return;
 	}
 
-	pml.ladder = false;
+	pml->ladder = false;
 
 	// check for ladder
 	if( !pm->skipCollision ) {
-		VectorMA( pml.origin, 1, pml.flatforward, spot );
-		gs.api.Trace( &trace, pml.origin, pm->mins, pm->maxs, spot, pm->playerState->POVnum, pm->contentmask, 0 );
+		VectorMA( pml->origin, 1, pml->flatforward, spot );
+		gs.api.Trace( &trace, pml->origin, pm->mins, pm->maxs, spot, pm->playerState->POVnum, pm->contentmask, 0 );
 		if( ( trace.fraction < 1 ) && ( trace.surfFlags & SURF_LADDER ) ) {
-			pml.ladder = true;
+			pml->ladder = true;
 			pm->ladder = true;
 		}
 	}
@@ -1135,7 +1135,7 @@ static void PM_CheckSpecialMovement( void ) {
 		return;
 	}
 
-	VectorMA( pml.origin, 30, pml.flatforward, spot );
+	VectorMA( pml->origin, 30, pml->flatforward, spot );
 	spot[2] += 4;
 	cont = gs.api.PointContents( spot, 0 );
 	if( !( cont & CONTENTS_SOLID ) ) {
@@ -1148,8 +1148,8 @@ static void PM_CheckSpecialMovement( void ) {
 		return;
 	}
 	// jump out of water
-	VectorScale( pml.flatforward, 50, pml.velocity );
-	pml.velocity[2] = 350;
+	VectorScale( pml->flatforward, 50, pml->velocity );
+	pml->velocity[2] = 350;
 
 	pm->playerState->pmove.pm_flags |= PMF_TIME_WATERJUMP;
 	pm->playerState->pmove.pm_time = 255;
@@ -1158,7 +1158,7 @@ static void PM_CheckSpecialMovement( void ) {
 /*
 * PM_FlyMove
 */
-static void PM_FlyMove( bool doclip ) {
+static void PM_FlyMove( pmove_t *pm, pml_t *pml, bool doclip ) {
 	float speed, drop, friction, control, newspeed;
 	float currentspeed, addspeed, accelspeed, maxspeed;
 	int i;
@@ -1169,22 +1169,22 @@ static void PM_FlyMove( bool doclip ) {
 	vec3_t end;
 	trace_t trace;
 
-	maxspeed = pml.maxPlayerSpeed * 1.5;
+	maxspeed = pml->maxPlayerSpeed * 1.5;
 
 	if( pm->cmd.buttons & BUTTON_SPECIAL ) {
 		maxspeed *= 2;
 	}
 
 	// friction
-	speed = VectorLength( pml.velocity );
+	speed = VectorLength( pml->velocity );
 	if( speed < 1 ) {
-		VectorClear( pml.velocity );
+		VectorClear( pml->velocity );
 	} else {
 		drop = 0;
 
 		friction = pm_friction * 1.5; // extra friction
 		control = speed < pm_decelerate ? pm_decelerate : speed;
-		drop += control * friction * pml.frametime;
+		drop += control * friction * pml->frametime;
 
 		// scale the velocity
 		newspeed = speed - drop;
@@ -1193,24 +1193,24 @@ static void PM_FlyMove( bool doclip ) {
 		}
 		newspeed /= speed;
 
-		VectorScale( pml.velocity, newspeed, pml.velocity );
+		VectorScale( pml->velocity, newspeed, pml->velocity );
 	}
 
 	// accelerate
-	fmove = pml.forwardPush;
-	smove = pml.sidePush;
+	fmove = pml->forwardPush;
+	smove = pml->sidePush;
 
 	if( pm->cmd.buttons & BUTTON_SPECIAL ) {
 		fmove *= 2;
 		smove *= 2;
 	}
 
-	VectorNormalize( pml.forward );
-	VectorNormalize( pml.right );
+	VectorNormalize( pml->forward );
+	VectorNormalize( pml->right );
 
 	for( i = 0; i < 3; i++ )
-		wishvel[i] = pml.forward[i] * fmove + pml.right[i] * smove;
-	wishvel[2] += pml.upPush;
+		wishvel[i] = pml->forward[i] * fmove + pml->right[i] * smove;
+	wishvel[2] += pml->upPush;
 
 	VectorCopy( wishvel, wishdir );
 	wishspeed = VectorNormalize( wishdir );
@@ -1224,32 +1224,32 @@ static void PM_FlyMove( bool doclip ) {
 		wishspeed = maxspeed;
 	}
 
-	currentspeed = DotProduct( pml.velocity, wishdir );
+	currentspeed = DotProduct( pml->velocity, wishdir );
 	addspeed = wishspeed - currentspeed;
 	if( addspeed > 0 ) {
-		accelspeed = pm_accelerate * pml.frametime * wishspeed;
+		accelspeed = pm_accelerate * pml->frametime * wishspeed;
 		if( accelspeed > addspeed ) {
 			accelspeed = addspeed;
 		}
 
 		for( i = 0; i < 3; i++ )
-			pml.velocity[i] += accelspeed * wishdir[i];
+			pml->velocity[i] += accelspeed * wishdir[i];
 	}
 
 	if( doclip ) {
 		for( i = 0; i < 3; i++ )
-			end[i] = pml.origin[i] + pml.frametime * pml.velocity[i];
+			end[i] = pml->origin[i] + pml->frametime * pml->velocity[i];
 
-		gs.api.Trace( &trace, pml.origin, pm->mins, pm->maxs, end, pm->playerState->POVnum, pm->contentmask, 0 );
+		gs.api.Trace( &trace, pml->origin, pm->mins, pm->maxs, end, pm->playerState->POVnum, pm->contentmask, 0 );
 
-		VectorCopy( trace.endpos, pml.origin );
+		VectorCopy( trace.endpos, pml->origin );
 	} else {
 		// move
-		VectorMA( pml.origin, pml.frametime, pml.velocity, pml.origin );
+		VectorMA( pml->origin, pml->frametime, pml->velocity, pml->origin );
 	}
 }
 
-static void PM_CheckZoom( void ) {
+static void PM_CheckZoom( pmove_t *pm, pml_t *pml ) {
 	if( pm->playerState->pmove.pm_type != PM_NORMAL ) {
 		pm->playerState->pmove.stats[PM_STAT_ZOOMTIME] = 0;
 		return;
@@ -1269,7 +1269,7 @@ static void PM_CheckZoom( void ) {
 *
 * Sets mins, maxs, and pm->viewheight
 */
-static void PM_AdjustBBox( void ) {
+static void PM_AdjustBBox( pmove_t *pm, pml_t *pml ) {
 	float crouchFrac;
 	trace_t trace;
 
@@ -1292,7 +1292,7 @@ static void PM_AdjustBBox( void ) {
 		pm->playerState->viewheight = playerbox_stand_viewheight;
 	}
 
-	if( pml.upPush < 0 && ( pm->playerState->pmove.stats[PM_STAT_FEATURES] & PMFEAT_CROUCH ) &&
+	if( pml->upPush < 0 && ( pm->playerState->pmove.stats[PM_STAT_FEATURES] & PMFEAT_CROUCH ) &&
 		pm->playerState->pmove.stats[PM_STAT_WJTIME] < ( PM_WALLJUMP_TIMEDELAY - PM_SPECIAL_CROUCH_INHIBIT ) &&
 		pm->playerState->pmove.stats[PM_STAT_DASHTIME] < ( PM_DASHJUMP_TIMEDELAY - PM_SPECIAL_CROUCH_INHIBIT ) &&
 		( pm->playerState->pmove.pm_flags & PMF_ON_GROUND ) ) {
@@ -1336,7 +1336,7 @@ static void PM_AdjustBBox( void ) {
 		wishviewheight = playerbox_stand_viewheight - ( crouchFrac * ( playerbox_stand_viewheight - playerbox_crouch_viewheight ) );
 
 		// check that the head is not blocked
-		gs.api.Trace( &trace, pml.origin, wishmins, wishmaxs, pml.origin, pm->playerState->POVnum, pm->contentmask, 0 );
+		gs.api.Trace( &trace, pml->origin, wishmins, wishmaxs, pml->origin, pm->playerState->POVnum, pm->contentmask, 0 );
 		if( trace.allsolid || trace.startsolid ) {
 			// can't do the uncrouching, let the time alone and use old position
 			VectorCopy( curmins, pm->mins );
@@ -1359,7 +1359,7 @@ static void PM_AdjustBBox( void ) {
 	pm->playerState->viewheight = playerbox_stand_viewheight;
 }
 
-static void PM_UpdateDeltaAngles( void ) {
+static void PM_UpdateDeltaAngles( pmove_t *pm ) {
 	int i;
 
 	if( gs.module != GS_MODULE_GAME ) {
@@ -1378,7 +1378,7 @@ static void PM_UpdateDeltaAngles( void ) {
 #pragma warning( push )
 #pragma warning( disable : 4310 )   // cast truncates constant value
 #endif
-static void PM_ApplyMouseAnglesClamp( void ) {
+static void PM_ApplyMouseAnglesClamp( pmove_t *pm, pml_t *pml ) {
 	int i;
 	short temp;
 
@@ -1398,11 +1398,11 @@ static void PM_ApplyMouseAnglesClamp( void ) {
 		pm->playerState->viewangles[i] = SHORT2ANGLE( (short)temp );
 	}
 
-	AngleVectors( pm->playerState->viewangles, pml.forward, pml.right, pml.up );
+	AngleVectors( pm->playerState->viewangles, pml->forward, pml->right, pml->up );
 
-	VectorCopy( pml.forward, pml.flatforward );
-	pml.flatforward[2] = 0.0f;
-	VectorNormalize( pml.flatforward );
+	VectorCopy( pml->forward, pml->flatforward );
+	pml->flatforward[2] = 0.0f;
+	VectorNormalize( pml->flatforward );
 }
 #if defined ( _WIN32 ) && ( _MSC_VER >= 1400 )
 #pragma warning( pop )
@@ -1411,7 +1411,7 @@ static void PM_ApplyMouseAnglesClamp( void ) {
 /*
 * PM_BeginMove
 */
-static void PM_BeginMove( void ) {
+static void PM_BeginMove( pmove_t *pm, pml_t *pml ) {
 	// clear results
 	pm->numtouch = 0;
 	pm->groundentity = -1;
@@ -1420,68 +1420,71 @@ static void PM_BeginMove( void ) {
 	pm->step = 0;
 
 	// clear all pmove local vars
-	memset( &pml, 0, sizeof( pml ) );
+	memset( pml, 0, sizeof( *pml ) );
 
-	VectorCopy( pm->playerState->pmove.origin, pml.origin );
-	VectorCopy( pm->playerState->pmove.velocity, pml.velocity );
+	VectorCopy( pm->playerState->pmove.origin, pml->origin );
+	VectorCopy( pm->playerState->pmove.velocity, pml->velocity );
 
 	// save old org in case we get stuck
-	VectorCopy( pm->playerState->pmove.origin, pml.previous_origin );
+	VectorCopy( pm->playerState->pmove.origin, pml->previous_origin );
 }
 
 /*
 * PM_EndMove
 */
-static void PM_EndMove( void ) {
-	VectorCopy( pml.origin, pm->playerState->pmove.origin );
-	VectorCopy( pml.velocity, pm->playerState->pmove.velocity );
+static void PM_EndMove( pmove_t *pm, pml_t *pml ) {
+	VectorCopy( pml->origin, pm->playerState->pmove.origin );
+	VectorCopy( pml->velocity, pm->playerState->pmove.velocity );
 }
 
 /*
-* Pmove
+* Pmove_Move
 *
-* Can be called by either the server or the client
+* The move itself, up to touching triggers. All working state lives in pm,
+* tail and a local pml_t, and the only calls out are traces, point contents,
+* entity states and predicted events, so separate players can be moved
+* concurrently as long as those callbacks are safe to call concurrently.
 */
-void Pmove( pmove_t *pmove ) {
-	float fallvelocity, falldelta;
-	int oldGroundEntity;
+void Pmove_Move( pmove_t *pm, pmove_tail_t *tail ) {
+	pml_t pml_storage;
+	pml_t *pml = &pml_storage;
+
+	memset( tail, 0, sizeof( *tail ) );
 
-	if( !pmove->playerState ) {
+	if( !pm->playerState ) {
 		return;
 	}
 
-	pm = pmove;
-
 	// clear all pmove local vars
-	PM_BeginMove();
+	PM_BeginMove( pm, pml );
 
-	fallvelocity = ( ( pml.velocity[2] < 0.0f ) ? fabs( pml.velocity[2] ) : 0.0f );
+	tail->fallvelocity = ( ( pml->velocity[2] < 0.0f ) ? fabs( pml->velocity[2] ) : 0.0f );
 
-	pml.frametime = pm->cmd.msec * 0.001;
+	pml->frametime = pm->cmd.msec * 0.001;
 
-	pml.maxPlayerSpeed = pm->playerState->pmove.stats[PM_STAT_MAXSPEED];
-	if( pml.maxPlayerSpeed < 0 ) {
-		pml.maxPlayerSpeed = DEFAULT_PLAYERSPEED;
+	pml->maxPlayerSpeed = pm->playerState->pmove.stats[PM_STAT_MAXSPEED];
+	if( pml->maxPlayerSpeed < 0 ) {
+		pml->maxPlayerSpeed = DEFAULT_PLAYERSPEED;
 	}
 
-	pml.jumpPlayerSpeed = (float)pm->playerState->pmove.stats[PM_STAT_JUMPSPEED] * GRAVITY_COMPENSATE;
-	if( pml.jumpPlayerSpeed < 0 ) {
-		pml.jumpPlayerSpeed = DEFAULT_JUMPSPEED * GRAVITY_COMPENSATE;
+	pml->jumpPlayerSpeed = (float)pm->playerState->pmove.stats[PM_STAT_JUMPSPEED] * GRAVITY_COMPENSATE;
+	if( pml->jumpPlayerSpeed < 0 ) {
+		pml->jumpPlayerSpeed = DEFAULT_JUMPSPEED * GRAVITY_COMPENSATE;
 	}
 
-	pml.dashPlayerSpeed = pm->playerState->pmove.stats[PM_STAT_DASHSPEED];
-	if( pml.dashPlayerSpeed < 0 ) {
-		pml.dashPlayerSpeed = DEFAULT_DASHSPEED;
+	pml->dashPlayerSpeed = pm->playerState->pmove.stats[PM_STAT_DASHSPEED];
+	if( pml->dashPlayerSpeed < 0 ) {
+		pml->dashPlayerSpeed = DEFAULT_DASHSPEED;
 	}
 
-	pml.maxWalkSpeed = DEFAULT_WALKSPEED;
-	if( pml.maxWalkSpeed > pml.maxPlayerSpeed * 0.66f ) {
-		pml.maxWalkSpeed = pml.maxPlayerSpeed * 0.66f;
+	pml->maxWalkSpeed = DEFAULT_WALKSPEED;
+	if( pml->maxWalkSpeed > pml->maxPlayerSpeed * 0.66f ) {
+		pml->maxWalkSpeed = pml->maxPlayerSpeed * 0.66f;
 	}
 
-	pml.maxCrouchedSpeed = DEFAULT_CROUCHEDSPEED;
-	if( pml.maxCrouchedSpeed > pml.maxPlayerSpeed * 0.5f ) {
-		pml.maxCrouchedSpeed = pml.maxPlayerSpeed * 0.5f;
+	pml->maxCrouchedSpeed = DEFAULT_CROUCHEDSPEED;
+	if( pml->maxCrouchedSpeed > pml->maxPlayerSpeed * 0.5f ) {
+		pml->maxCrouchedSpeed = pml->maxPlayerSpeed * 0.5f;
 	}
 
 	// assign a contentmask for the movement type
@@ -1551,84 +1554,84 @@ void Pmove( pmove_t *pmove ) {
 		// PM_STAT_ZOOMTIME is handled at PM_CheckZoom
 	}
 
-	pml.forwardPush = pm->cmd.forwardmove * SPEEDKEY / 127.0f;
-	pml.sidePush = pm->cmd.sidemove * SPEEDKEY / 127.0f;
-	pml.upPush = pm->cmd.upmove * SPEEDKEY / 127.0f;
+	pml->forwardPush = pm->cmd.forwardmove * SPEEDKEY / 127.0f;
+	pml->sidePush = pm->cmd.sidemove * SPEEDKEY / 127.0f;
+	pml->upPush = pm->cmd.upmove * SPEEDKEY / 127.0f;
 
 	if( pm->playerState->pmove.stats[PM_STAT_NOUSERCONTROL] > 0 ) {
-		pml.forwardPush = 0;
-		pml.sidePush = 0;
-		pml.upPush = 0;
+		pml->forwardPush = 0;
+		pml->sidePush = 0;
+		pml->upPush = 0;
 		pm->cmd.buttons = 0;
 	}
 
 	if( pm->playerState->pmove.pm_type != PM_NORMAL ) { // includes dead, freeze, chasecam...
 		if( !GS_MatchPaused() ) {
-			PM_ClearDash();
+			PM_ClearDash( pm, pml );
 
-			PM_ClearWallJump();
+			PM_ClearWallJump( pm, pml );
 
 			pm->playerState->pmove.stats[PM_STAT_KNOCKBACK] = 0;
 			pm->playerState->pmove.stats[PM_STAT_CROUCHTIME] = 0;
 			pm->playerState->pmove.stats[PM_STAT_ZOOMTIME] = 0;
 			pm->playerState->pmove.pm_flags &= ~( PMF_JUMPPAD_TIME | PMF_DOUBLEJUMPED | PMF_TIME_WATERJUMP | PMF_TIME_LAND | PMF_TIME_TELEPORT | PMF_SPECIAL_HELD );
 
-			PM_AdjustBBox();
+			PM_AdjustBBox( pm, pml );
 		}
 
 		if( pm->playerState->pmove.pm_type == PM_SPECTATOR ) {
-			PM_ApplyMouseAnglesClamp();
+			PM_ApplyMouseAnglesClamp( pm, pml );
 
-			PM_FlyMove( false );
+			PM_FlyMove( pm, pml, false );
 		} else {
-			pml.forwardPush = 0;
-			pml.sidePush = 0;
-			pml.upPush = 0;
+			pml->forwardPush = 0;
+			pml->sidePush = 0;
+			pml->upPush = 0;
 		}
 
-		PM_EndMove();
+		PM_EndMove( pm, pml );
 		return;
 	}
 
-	PM_ApplyMouseAnglesClamp();
+	PM_ApplyMouseAnglesClamp( pm, pml );
 
 	// set mins, maxs, viewheight amd fov
-	PM_AdjustBBox();
+	PM_AdjustBBox( pm, pml );
 
-	PM_CheckZoom();
+	PM_CheckZoom( pm, pml );
 
 	// set groundentity, watertype, and waterlevel
-	PM_CategorizePosition();
+	PM_CategorizePosition( pm, pml );
 
-	oldGroundEntity = pm->groundentity;
+	tail->oldGroundEntity = pm->groundentity;
 
-	PM_CheckSpecialMovement();
+	PM_CheckSpecialMovement( pm, pml );
 
 	if( pm->playerState->pmove.pm_flags & PMF_TIME_TELEPORT ) {
 		// teleport pause stays exactly in place
 	} else if( pm->playerState->pmove.pm_flags & PMF_TIME_WATERJUMP ) {
 		// waterjump has no control, but falls
-		pml.velocity[2] -= pm->playerState->pmove.gravity * pml.frametime;
-		if( pml.velocity[2] < 0 ) {
+		pml->velocity[2] -= pm->playerState->pmove.gravity * pml->frametime;
+		if( pml->velocity[2] < 0 ) {
 			// cancel as soon as we are falling down again
 			pm->playerState->pmove.pm_flags &= ~( PMF_TIME_WATERJUMP | PMF_TIME_LAND | PMF_TIME_TELEPORT );
 			pm->playerState->pmove.pm_time = 0;
 		}
 
-		PM_StepSlideMove();
+		PM_StepSlideMove( pm, pml );
 	} else {
 		// Kurim
 		// Keep this order !
-		PM_CheckJump();
+		PM_CheckJump( pm, pml );
 
-		PM_CheckDash();
+		PM_CheckDash( pm, pml );
 
-		PM_CheckWallJump();
+		PM_CheckWallJump( pm, pml );
 
-		PM_Friction();
+		PM_Friction( pm, pml );
 
 		if( pm->waterlevel >= 2 ) {
-			PM_WaterMove();
+			PM_WaterMove( pm, pml );
 		} else {
 			vec3_t angles;
 
@@ -1638,28 +1641,49 @@ void Pmove( pmove_t *pmove ) {
 			}
 			angles[PITCH] /= 3;
 
-			AngleVectors( angles, pml.forward, pml.right, pml.up );
+			AngleVectors( angles, pml->forward, pml->right, pml->up );
 
 			// hack to work when looking straight up and straight down
-			if( pml.forward[2] == -1.0f ) {
-				VectorCopy( pml.up, pml.flatforward );
-			} else if( pml.forward[2] == 1.0f ) {
-				VectorCopy( pml.up, pml.flatforward );
-				VectorNegate( pml.flatforward, pml.flatforward );
+			if( pml->forward[2] == -1.0f ) {
+				VectorCopy( pml->up, pml->flatforward );
+			} else if( pml->forward[2] == 1.0f ) {
+				VectorCopy( pml->up, pml->flatforward );
+				VectorNegate( pml->flatforward, pml->flatforward );
 			} else {
-				VectorCopy( pml.forward, pml.flatforward );
+				VectorCopy( pml->forward, pml->flatforward );
 			}
-			pml.flatforward[2] = 0.0f;
-			VectorNormalize( pml.flatforward );
+			pml->flatforward[2] = 0.0f;
+			VectorNormalize( pml->flatforward );
 
-			PM_Move();
+			PM_Move( pm, pml );
 		}
 	}
 
 	// set groundentity, watertype, and waterlevel for final spot
-	PM_CategorizePosition();
+	PM_CategorizePosition( pm, pml );
+
+	PM_EndMove( pm, pml );
+
+	tail->touch = true;
+	VectorCopy( pml->previous_origin, tail->previous_origin );
+	tail->velocity_z = pml->velocity[2];
+}
 
-	PM_EndMove();
+/*
+* Pmove_Finish
+*
+* Touches the triggers along the move and lands it
+*/
+void Pmove_Finish( pmove_t *pm, const pmove_tail_t *tail ) {
+	float velocity_z, falldelta;
+	vec3_t previous_origin;
+
+	if( !tail->touch ) {
+		return;
+	}
+
+	velocity_z = tail->velocity_z;
+	VectorCopy( tail->previous_origin, previous_origin );
 
 	// falling event
 
@@ -1672,14 +1696,14 @@ void Pmove( pmove_t *pmove ) {
 	// We check the entire path between the origin before the pmove and the
 	// current origin to ensure no triggers are missed at high velocity.
 	// Note that this method assumes the movement has been linear.
-	gs.api.PMoveTouchTriggers( pm, pml.previous_origin );
+	gs.api.PMoveTouchTriggers( pm, previous_origin );
 
-	PM_UpdateDeltaAngles(); // in case some trigger action has moved the view angles (like teleported).
+	PM_UpdateDeltaAngles( pm ); // in case some trigger action has moved the view angles (like teleported).
 
 	// touching triggers may force groundentity off
 	if( !( pm->playerState->pmove.pm_flags & PMF_ON_GROUND ) && pm->groundentity != -1 ) {
 		pm->groundentity = -1;
-		pml.velocity[2] = 0;
+		velocity_z = 0;
 	}
 
 	if( pm->groundentity != -1 ) { // remove wall-jump and dash bits when touching ground
@@ -1689,12 +1713,12 @@ void Pmove( pmove_t *pmove ) {
 		}
 
 		if( pm->playerState->pmove.stats[PM_STAT_WJTIME] < ( PM_WALLJUMP_TIMEDELAY - 50 ) ) {
-			PM_ClearWallJump();
+			PM_ClearWallJump( pm, NULL );
 		}
 	}
 
-	if( oldGroundEntity == -1 ) {
-		falldelta = fallvelocity - ( ( pml.velocity[2] < 0.0f ) ? fabs( pml.velocity[2] ) : 0.0f );
+	if( tail->oldGroundEntity == -1 ) {
+		falldelta = tail->fallvelocity - ( ( velocity_z < 0.0f ) ? fabs( velocity_z ) : 0.0f );
 
 		// scale delta if in water
 		if( pm->waterlevel == 3 ) {
@@ -1714,3 +1738,15 @@ void Pmove( pmove_t *pmove ) {
 		pm->playerState->pmove.pm_flags &= ~PMF_JUMPPAD_TIME;
 	}
 }
+
+/*
+* Pmove
+*
+* Can be called by either the server or the client
+*/
+void Pmove( pmove_t *pm ) {
+	pmove_tail_t tail;
+
+	Pmove_Move( pm, &tail );
+	Pmove_Finish( pm, &tail );
+}
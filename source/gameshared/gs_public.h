@@ -221,7 +221,19 @@ void GS_LinearMovementDelta( const entity_state_t *ent, int64_t oldTime, int64_t
 
 #define STEPSIZE 18
 
+// what Pmove_Finish needs from Pmove_Move, so the server can run the moves
+// of several players at once and touch triggers one player at a time after
+typedef struct {
+	bool touch;                 // false if the move type doesn't touch triggers
+	vec3_t previous_origin;
+	int oldGroundEntity;
+	float fallvelocity;
+	float velocity_z;
+} pmove_tail_t;
+
 void Pmove( pmove_t *pmove );
+void Pmove_Move( pmove_t *pmove, pmove_tail_t *tail );
+void Pmove_Finish( pmove_t *pmove, const pmove_tail_t *tail );
 
 //===============================================================
 
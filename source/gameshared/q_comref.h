@@ -241,7 +241,9 @@ typedef enum {
 	WIRE_ANGLE,					// 32-bit float angle value, normalized to [0..360], transmitted at half-precision
 
 	WIRE_BASE128,				// base-128 encoded unsigned integer
-	WIRE_UBASE128				// base-128 encoded signed integer
+	WIRE_UBASE128,				// base-128 encoded signed integer
+
+	WIRE_QUANT_COORD,			// float coordinate quantized to 1/8 unit, bit-packed as a delta from the previous value
 } wireType_t;
 
 //==============================================
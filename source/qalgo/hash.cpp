@@ -29,3 +29,49 @@ uint32_t Hash32( const char * str ) {
 uint64_t Hash64( const char * str ) {
 	return Hash64( str, strlen( str ) );
 }
+
+static uint64_t LowercaseWord( uint64_t w ) {
+	const uint64_t ones = UINT64_C( 0x0101010101010101 );
+
+	// the high bit of each byte ends up set where the byte is in [A-Z],
+	// adding to the low 7 bits of each byte can't carry into the next one
+	uint64_t heptets = w & ( ones * 0x7f );
+	uint64_t above_Z = heptets + ones * ( 0x7f - 'Z' );
+	uint64_t from_A = heptets + ones * ( 0x80 - 'A' );
+	uint64_t upper = ( from_A ^ above_Z ) & ~w & ( ones * 0x80 );
+
+	return w | ( upper >> 2 );
+}
+
+static uint64_t MixWord( uint64_t hash, uint64_t w ) {
+	hash = ( hash ^ w ) * UINT64_C( 0xff51afd7ed558ccd );
+	return hash ^ ( hash >> 32 );
+}
+
+uint32_t Hash32NoCase( const char * str, size_t n ) {
+	uint64_t hash = UINT64_C( 0x9e3779b97f4a7c15 ) ^ n;
+
+	while( n >= sizeof( uint64_t ) ) {
+		uint64_t w;
+		memcpy( &w, str, sizeof( w ) );
+		hash = MixWord( hash, LowercaseWord( w ) );
+		str += sizeof( w );
+		n -= sizeof( w );
+	}
+
+	if( n > 0 ) {
+		uint64_t w = 0;
+		memcpy( &w, str, n );
+		hash = MixWord( hash, LowercaseWord( w ) );
+	}
+
+	hash ^= hash >> 29;
+	hash *= UINT64_C( 0xc4ceb9fe1a85ec53 );
+	hash ^= hash >> 32;
+
+	return uint32_t( hash );
+}
+
+uint32_t Hash32NoCase( const char * str ) {
+	return Hash32NoCase( str, strlen( str ) );
+}
@@ -10,6 +10,11 @@ uint64_t Hash64( const void * data, size_t n, uint64_t basis = UINT64_C( 1469598
 uint32_t Hash32( const char * str );
 uint64_t Hash64( const char * str );
 
+// case-insensitive (ASCII only) string hash that reads 8 bytes at a time
+// not compatible with the fnv hashes above, use it for in-memory lookups only
+uint32_t Hash32NoCase( const char * str, size_t n );
+uint32_t Hash32NoCase( const char * str );
+
 // compile time hashing
 constexpr uint32_t Hash32_CT( const char * str, size_t n, uint32_t basis = UINT32_C( 2166136261 ) ) {
 	return n == 0 ? basis : Hash32_CT( str + 1, n - 1, ( basis ^ str[ 0 ] ) * UINT32_C( 16777619 ) );
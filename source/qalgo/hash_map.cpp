@@ -0,0 +1,129 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "hash_map.h"
+
+// branchless, keys looked up with mixed casing mispredict a compare per character
+static char LowercaseChar( char c ) {
+	return c | ( ( unsigned char )( c - 'A' ) < 26 ) << 5;
+}
+
+static bool KeysEqual( const char * a, const char * b ) {
+	while( true ) {
+		char ca = LowercaseChar( *a++ );
+		char cb = LowercaseChar( *b++ );
+		if( ca != cb )
+			return false;
+		if( ca == '\0' )
+			return true;
+	}
+}
+
+// returns the slot holding key, or the empty slot where it would go
+static uint32_t FindSlot( const HashMap * map, const char * key, uint32_t hash ) {
+	uint32_t mask = map->capacity - 1;
+	for( uint32_t i = hash & mask; ; i = ( i + 1 ) & mask ) {
+		const HashMapSlot * slot = &map->slots[ i ];
+		if( slot->key == NULL || ( slot->hash == hash && KeysEqual( slot->key, key ) ) )
+			return i;
+	}
+}
+
+static void Grow( HashMap * map ) {
+	HashMapSlot * old_slots = map->slots;
+	uint32_t old_capacity = map->capacity;
+
+	map->capacity = old_capacity == 0 ? 16 : old_capacity * 2;
+	map->slots = ( HashMapSlot * ) calloc( map->capacity, sizeof( HashMapSlot ) );
+
+	uint32_t mask = map->capacity - 1;
+	for( uint32_t i = 0; i < old_capacity; i++ ) {
+		if( old_slots[ i ].key == NULL )
+			continue;
+
+		uint32_t j = old_slots[ i ].hash & mask;
+		while( map->slots[ j ].key != NULL ) {
+			j = ( j + 1 ) & mask;
+		}
+		map->slots[ j ] = old_slots[ i ];
+	}
+
+	free( old_slots );
+}
+
+void HashMap_Init( HashMap * map ) {
+	map->slots = NULL;
+	map->capacity = 0;
+	map->size = 0;
+}
+
+void HashMap_Destroy( HashMap * map ) {
+	free( map->slots );
+	HashMap_Init( map );
+}
+
+void HashMap_Clear( HashMap * map ) {
+	if( map->slots != NULL ) {
+		memset( map->slots, 0, map->capacity * sizeof( HashMapSlot ) );
+	}
+	map->size = 0;
+}
+
+void * HashMap_Find( const HashMap * map, const char * key ) {
+	if( map->size == 0 )
+		return NULL;
+
+	uint32_t i = FindSlot( map, key, Hash32NoCase( key ) );
+	return map->slots[ i ].value;
+}
+
+void * HashMap_Set( HashMap * map, const char * key, void * value ) {
+	assert( key != NULL && value != NULL );
+
+	// keep the load factor under 3/4
+	if( ( map->size + 1 ) * 4 > map->capacity * 3 ) {
+		Grow( map );
+	}
+
+	uint32_t hash = Hash32NoCase( key );
+	HashMapSlot * slot = &map->slots[ FindSlot( map, key, hash ) ];
+	void * old_value = slot->value;
+
+	if( slot->key == NULL ) {
+		map->size++;
+	}
+	slot->key = key;
+	slot->value = value;
+	slot->hash = hash;
+
+	return old_value;
+}
+
+void * HashMap_Remove( HashMap * map, const char * key ) {
+	if( map->size == 0 )
+		return NULL;
+
+	uint32_t mask = map->capacity - 1;
+	uint32_t hole = FindSlot( map, key, Hash32NoCase( key ) );
+	void * value = map->slots[ hole ].value;
+	if( map->slots[ hole ].key == NULL )
+		return NULL;
+
+	// backward shift deletion: pull back entries that probed past the hole so
+	// lookups never stop early, and no tombstones are needed
+	for( uint32_t i = ( hole + 1 ) & mask; map->slots[ i ].key != NULL; i = ( i + 1 ) & mask ) {
+		uint32_t home = map->slots[ i ].hash & mask;
+		if( ( ( i - home ) & mask ) >= ( ( i - hole ) & mask ) ) {
+			map->slots[ hole ] = map->slots[ i ];
+			hole = i;
+		}
+	}
+
+	map->slots[ hole ].key = NULL;
+	map->slots[ hole ].value = NULL;
+	map->size--;
+
+	return value;
+}
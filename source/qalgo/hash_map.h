@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// flat open addressing hash table from case-insensitive strings to non-NULL pointers
+// keys aren't copied so they have to outlive their entries, and it's not thread safe
+
+struct HashMapSlot {
+	const char * key; // NULL if the slot is empty
+	void * value;
+	uint32_t hash;
+};
+
+struct HashMap {
+	HashMapSlot * slots;
+	uint32_t capacity; // 0 or a power of two
+	uint32_t size;
+};
+
+void HashMap_Init( HashMap * map );
+void HashMap_Destroy( HashMap * map );
+void HashMap_Clear( HashMap * map );
+
+void * HashMap_Find( const HashMap * map, const char * key );
+
+// inserts or replaces, returns the replaced value or NULL
+void * HashMap_Set( HashMap * map, const char * key, void * value );
+
+// returns the removed value or NULL
+void * HashMap_Remove( HashMap * map, const char * key );
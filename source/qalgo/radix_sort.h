@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Stable LSB radix sort of items by an unsigned 64 bit key, a byte per pass.
+ * Passes over a byte that's the same in every key are skipped, so keys that
+ * leave their high bits empty cost less. scratch must have room for n items,
+ * and the sorted items end up back in items.
+ */
+template< typename T, typename KeyFunc >
+void RadixSort64( T * items, T * scratch, size_t n, KeyFunc key ) {
+	uint32_t counts[ 8 ][ 256 ];
+
+	if( n < 2 ) {
+		return;
+	}
+
+	memset( counts, 0, sizeof( counts ) );
+	for( size_t i = 0; i < n; i++ ) {
+		uint64_t k = key( items[ i ] );
+		for( int b = 0; b < 8; b++ ) {
+			counts[ b ][ ( k >> ( b * 8 ) ) & 255 ]++;
+		}
+	}
+
+	T * src = items;
+	T * dst = scratch;
+	for( int b = 0; b < 8; b++ ) {
+		uint32_t * c = counts[ b ];
+		int shift = b * 8;
+
+		if( c[ ( key( src[ 0 ] ) >> shift ) & 255 ] == n ) {
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for( int d = 0; d < 256; d++ ) {
+			uint32_t count = c[ d ];
+			c[ d ] = offset;
+			offset += count;
+		}
+
+		for( size_t i = 0; i < n; i++ ) {
+			dst[ c[ ( key( src[ i ] ) >> shift ) & 255 ]++ ] = src[ i ];
+		}
+
+		T * t = src;
+		src = dst;
+		dst = t;
+	}
+
+	if( src != items ) {
+		memcpy( items, src, n * sizeof( T ) );
+	}
+}
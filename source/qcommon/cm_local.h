@@ -54,13 +54,27 @@ typedef struct {
 	cbrushside_t *brushsides;
 } cbrush_t;
 
+#define CM_FACET_LEAF_SIZE  4
+#define CM_FACET_TREE_MIN   16      // smaller patches are cheaper to scan
+
+// patch facets are kept in an AABB tree stored depth first, so a subtree
+// covers facets [firstfacet, firstfacet + numfacets) and nodes up to skip
+typedef struct {
+	vec3_t mins, maxs;
+	int firstfacet;
+	int numfacets;
+	int skip;                   // first node after this subtree, this node + 1 for leafs
+} cfacetnode_t;
+
 typedef struct {
 	int contents;
 	int numfacets;
+	int numnodes;               // 0 when the facets are scanned linearly, see cm_patchBVH
 
 	vec3_t mins, maxs;
 
 	cbrush_t *facets;
+	cfacetnode_t *nodes;
 } cface_t;
 
 typedef struct {
@@ -76,6 +90,18 @@ typedef struct {
 	int *markfaces;
 } cleaf_t;
 
+#define CM_FATPVS_RADIUS        9
+#define CM_FATPVS_CACHE_SIZE    64
+#define CM_FATPVS_MAX_CLUSTERS  8
+
+// a merged PVS row, keyed by the sorted clusters it was merged from
+typedef struct {
+	uint32_t hash;
+	int numclusters;            // 0 when the slot is unused
+	int clusters[CM_FATPVS_MAX_CLUSTERS];
+	unsigned lastused;
+} cfatpvs_t;
+
 typedef struct cmodel_s {
 	bool builtin;
 
@@ -103,7 +129,6 @@ typedef struct {
 struct cmodel_state_s {
 	volatile int refcount;
 
-	int checkcount;
 	int floodvalid;
 
 	struct cmodel_state_s *parent;
@@ -163,34 +188,25 @@ struct cmodel_state_s {
 
 	uint8_t nullrow[MAX_CM_LEAFS / 8];
 
+	// CM_MergePVS results shared by all callers, see CM_MergePVS
+	cfatpvs_t *fatpvs_cache;
+	uint8_t *fatpvs_rows;
+	unsigned fatpvs_time;
+
+	// optional rows for every point of a cluster expanded by the fat PVS box
+	uint8_t *map_fatpvs;
+
 	int numentitychars;
 	char map_entitystring_empty;
 	char *map_entitystring;         // = &map_entitystring_empty;
 
 	uint8_t *cmod_base;
-
-	// cm_trace.c
-	cbrushside_t box_brushsides[6];
-	cbrush_t box_brush[1];
-	int box_markbrushes[1];
-	cmodel_t box_cmodel[1];
-	int box_checkcount;
-
-	cbrushside_t oct_brushsides[10];
-	cbrush_t oct_brush[1];
-	int oct_markbrushes[1];
-	cmodel_t oct_cmodel[1];
-	int oct_checkcount;
-
-	int *map_brush_checkcheckouts;
-	int *map_face_checkcheckouts;
 };
 
 //=======================================================================
 
-void    CM_InitBoxHull( cmodel_state_t *cms );
-void    CM_InitOctagonHull( cmodel_state_t *cms );
-
 void    CM_FloodAreaConnections( cmodel_state_t *cms );
 
 void	CM_BoundBrush( cbrush_t *brush );
+
+void	CM_PrecomputeFatPVS( cmodel_state_t *cms, vec3_t *leaf_mins, vec3_t *leaf_maxs );
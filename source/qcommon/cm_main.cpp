@@ -29,6 +29,8 @@ static mempool_t *cmap_mempool;
 
 static cvar_t *cm_noAreas;
 cvar_t *cm_noCurves;
+cvar_t *cm_fatPVSPrecompute;
+cvar_t *cm_patchBVH;
 
 void CM_LoadQ3BrushModel( cmodel_state_t *cms, void *buffer, int buffer_size, const bspFormatDesc_t *format );
 void CM_LoadCompressedBSP( cmodel_state_t *cms, void *compressed, int compressed_size, const bspFormatDesc_t *format );
@@ -42,7 +44,7 @@ static const modelFormatDescr_t cm_supportedformats[] =
 	{ }
 };
 
-static void CM_AllocateCheckCounts( cmodel_state_t *cms );
+static int CM_ClusterRowLongs( cmodel_state_t *cms );
 
 /*
 ===============================================================================
@@ -52,32 +54,6 @@ PATCH LOADING
 ===============================================================================
 */
 
-/*
-* CM_AllocateCheckCounts
-*/
-static void CM_AllocateCheckCounts( cmodel_state_t *cms ) {
-	cms->checkcount = 0;
-	cms->map_brush_checkcheckouts = ( int * ) Mem_Alloc( cms->mempool, cms->numbrushes * sizeof( int ) );
-	cms->map_face_checkcheckouts = ( int * ) Mem_Alloc( cms->mempool, cms->numfaces * sizeof( int ) );
-}
-
-/*
-* CM_FreeCheckCounts
-*/
-static void CM_FreeCheckCounts( cmodel_state_t *cms ) {
-	cms->checkcount = 0;
-
-	if( cms->map_brush_checkcheckouts ) {
-		Mem_Free( cms->map_brush_checkcheckouts );
-		cms->map_brush_checkcheckouts = NULL;
-	}
-
-	if( cms->map_face_checkcheckouts ) {
-		Mem_Free( cms->map_face_checkcheckouts );
-		cms->map_face_checkcheckouts = NULL;
-	}
-}
-
 /*
 * CM_Clear
 */
@@ -167,13 +143,23 @@ static void CM_Clear( cmodel_state_t *cms ) {
 		cms->map_pvs = NULL;
 	}
 
+	if( cms->map_fatpvs ) {
+		Mem_Free( cms->map_fatpvs );
+		cms->map_fatpvs = NULL;
+	}
+
+	if( cms->fatpvs_cache ) {
+		Mem_Free( cms->fatpvs_cache );
+		Mem_Free( cms->fatpvs_rows );
+		cms->fatpvs_cache = NULL;
+		cms->fatpvs_rows = NULL;
+	}
+
 	if( cms->map_entitystring != &cms->map_entitystring_empty ) {
 		Mem_Free( cms->map_entitystring );
 		cms->map_entitystring = &cms->map_entitystring_empty;
 	}
 
-	CM_FreeCheckCounts( cms );
-
 	cms->map_name[0] = 0;
 
 	ClearBounds( cms->world_mins, cms->world_maxs );
@@ -192,7 +178,9 @@ MAP LOADING
 * Loads in the map and all submodels
 */
 cmodel_t *CM_LoadMap( cmodel_state_t *cms, const char *name, bool clientload, unsigned *checksum ) {
-	unsigned *buf;
+	unsigned *buf = NULL;
+	const void *data = NULL;
+	int file;
 	const modelFormatDescr_t *descr;
 	bspFormatDesc_t *bspFormat = NULL;
 
@@ -216,22 +204,37 @@ cmodel_t *CM_LoadMap( cmodel_state_t *cms, const char *name, bool clientload, un
 	//
 	// load the file
 	//
-	int length = FS_LoadFile( name, ( void ** )&buf, NULL, 0 );
-	if( !buf ) {
-		Com_Error( ERR_DROP, "Couldn't load %s", name );
+	// maps stored uncompressed in a mapped pak are read in place, the loaders don't write to the buffer
+	int length = FS_FOpenFile( name, &file, FS_READ );
+	if( file ) {
+		data = FS_FileView( file );
+		FS_FCloseFile( file );
+		if( ( uintptr_t )data & 3 ) {
+			data = NULL;
+		}
 	}
 
-	cms->checksum = Hash32( buf, length );
+	if( !data ) {
+		length = FS_LoadFile( name, ( void ** )&buf, NULL, 0 );
+		if( !buf ) {
+			Com_Error( ERR_DROP, "Couldn't load %s", name );
+		}
+		data = buf;
+	}
+
+	cms->checksum = Hash32( data, length );
 	*checksum = cms->checksum;
 
 	// call the apropriate loader
-	descr = Q_FindFormatDescriptor( cm_supportedformats, ( const uint8_t * )buf, (const bspFormatDesc_t **)&bspFormat );
+	descr = Q_FindFormatDescriptor( cm_supportedformats, ( const uint8_t * )data, (const bspFormatDesc_t **)&bspFormat );
 	if( !descr ) {
 		Com_Error( ERR_DROP, "CM_LoadMap: unknown fileid for %s", name );
 	}
 
-	descr->loader( cms, buf, length, bspFormat );
-	FS_FreeFile( buf );
+	descr->loader( cms, const_cast< void * >( data ), length, bspFormat );
+	if( buf ) {
+		FS_FreeFile( buf );
+	}
 
 	if( cms->numareas ) {
 		cms->map_areas = ( carea_t * ) Mem_Alloc( cms->mempool, cms->numareas * sizeof( *cms->map_areas ) );
@@ -241,10 +244,14 @@ cmodel_t *CM_LoadMap( cmodel_state_t *cms, const char *name, bool clientload, un
 		CM_FloodAreaConnections( cms );
 	}
 
-	CM_AllocateCheckCounts( cms );
-
 	memset( cms->nullrow, 255, MAX_CM_LEAFS / 8 );
 
+	if( cms->map_pvs ) {
+		cms->fatpvs_cache = ( cfatpvs_t * ) Mem_Alloc( cms->mempool, CM_FATPVS_CACHE_SIZE * sizeof( *cms->fatpvs_cache ) );
+		cms->fatpvs_rows = ( uint8_t * ) Mem_Alloc( cms->mempool, CM_FATPVS_CACHE_SIZE * CM_ClusterRowLongs( cms ) * 4 );
+		cms->fatpvs_time = 0;
+	}
+
 	Q_strncpyz( cms->map_name, name, sizeof( cms->map_name ) );
 
 	return cms->map_cmodels;
@@ -632,45 +639,161 @@ bool CM_HeadnodeVisible( cmodel_state_t *cms, int nodenum, uint8_t *visbits ) {
 }
 
 
+/*
+* CM_OrPVSRow
+*/
+static inline void CM_OrPVSRow( uint8_t *out, const uint8_t *src, int longs ) {
+	for( int i = 0; i < longs; i++ )
+		( (int *)out )[i] |= ( (const int *)src )[i];
+}
+
+/*
+* CM_CachedFatPVS
+*
+* Returns the merged rows of a sorted cluster list, merging them into the
+* least recently used cache slot if nobody asked for the same list lately
+*/
+static const uint8_t *CM_CachedFatPVS( cmodel_state_t *cms, const int *clusters, int numclusters ) {
+	int i;
+	int longs = CM_ClusterRowLongs( cms );
+	uint32_t hash = Hash32( clusters, numclusters * sizeof( *clusters ) );
+	cfatpvs_t *oldest = &cms->fatpvs_cache[0];
+	uint8_t *row;
+
+	cms->fatpvs_time++;
+
+	for( i = 0; i < CM_FATPVS_CACHE_SIZE; i++ ) {
+		cfatpvs_t *entry = &cms->fatpvs_cache[i];
+		if( entry->hash == hash && entry->numclusters == numclusters && !memcmp( entry->clusters, clusters, numclusters * sizeof( *clusters ) ) ) {
+			entry->lastused = cms->fatpvs_time;
+			return cms->fatpvs_rows + i * longs * 4;
+		}
+		if( entry->lastused < oldest->lastused ) {
+			oldest = entry;
+		}
+	}
+
+	row = cms->fatpvs_rows + ( oldest - cms->fatpvs_cache ) * longs * 4;
+	memset( row, 0, longs * 4 );
+	for( i = 0; i < numclusters; i++ )
+		CM_OrPVSRow( row, CM_ClusterPVS( cms, clusters[i] ), longs );
+
+	oldest->hash = hash;
+	oldest->numclusters = numclusters;
+	memcpy( oldest->clusters, clusters, numclusters * sizeof( *clusters ) );
+	oldest->lastused = cms->fatpvs_time;
+
+	return row;
+}
+
 /*
 * CM_MergePVS
 * Merge PVS at origin into out
+*
+* Players standing still or near each other touch the same clusters every
+* frame, so merged rows are cached by the set of clusters they came from.
 */
 void CM_MergePVS( cmodel_state_t *cms, const vec3_t org, uint8_t *out ) {
 	int leafs[128];
-	int i, j, count;
+	int clusters[128];
+	int i, j, count, numclusters;
 	int longs;
-	uint8_t *src;
 	vec3_t mins, maxs;
 
+	longs = CM_ClusterRowLongs( cms );
+
+	if( cms->map_fatpvs ) {
+		int cluster = CM_LeafCluster( cms, CM_PointLeafnum( cms, org ) );
+		if( cluster != -1 ) {
+			CM_OrPVSRow( out, cms->map_fatpvs + cluster * longs * 4, longs );
+			return;
+		}
+	}
+
 	for( i = 0; i < 3; i++ ) {
-		mins[i] = org[i] - 9;
-		maxs[i] = org[i] + 9;
+		mins[i] = org[i] - CM_FATPVS_RADIUS;
+		maxs[i] = org[i] + CM_FATPVS_RADIUS;
 	}
 
 	count = CM_BoxLeafnums( cms, mins, maxs, leafs, sizeof( leafs ) / sizeof( int ), NULL );
 	if( count < 1 ) {
 		Com_Error( ERR_FATAL, "CM_MergePVS: count < 1" );
 	}
+
+	// convert leafs to a sorted list of unique clusters
+	numclusters = 0;
+	for( i = 0; i < count; i++ ) {
+		int cluster = CM_LeafCluster( cms, leafs[i] );
+
+		for( j = numclusters; j > 0 && clusters[j - 1] > cluster; j-- ) ;
+		if( j > 0 && clusters[j - 1] == cluster ) {
+			continue; // already have the cluster we want
+		}
+
+		memmove( &clusters[j + 1], &clusters[j], ( numclusters - j ) * sizeof( *clusters ) );
+		clusters[j] = cluster;
+		numclusters++;
+	}
+
+	// the null row has every bit set, -1 sorts first
+	if( clusters[0] == -1 ) {
+		memset( out, 255, longs * 4 );
+		return;
+	}
+
+	// a single row is as cheap to merge as a cached one
+	if( numclusters == 1 || numclusters > CM_FATPVS_MAX_CLUSTERS || !cms->fatpvs_cache ) {
+		for( i = 0; i < numclusters; i++ )
+			CM_OrPVSRow( out, CM_ClusterPVS( cms, clusters[i] ), longs );
+		return;
+	}
+
+	CM_OrPVSRow( out, CM_CachedFatPVS( cms, clusters, numclusters ), longs );
+}
+
+/*
+* CM_PrecomputeFatPVS
+*
+* Merges for every cluster the rows CM_MergePVS could merge anywhere inside
+* its leafs, so CM_MergePVS only has to find the cluster at the origin. Leaf
+* bounds are loose so this is a superset of the exact result. Solid leafs are
+* skipped as a player can't get close enough to a wall to see through it.
+*/
+void CM_PrecomputeFatPVS( cmodel_state_t *cms, vec3_t *leaf_mins, vec3_t *leaf_maxs ) {
+	int i, j, k, count;
+	int longs;
+	int *leafs;
+	vec3_t mins, maxs;
+
+	if( !cms->map_pvs ) {
+		return;
+	}
+
 	longs = CM_ClusterRowLongs( cms );
+	leafs = ( int * ) Mem_TempMalloc( cms->numleafs * sizeof( *leafs ) );
+	cms->map_fatpvs = ( uint8_t * ) Mem_Alloc( cms->mempool, cms->map_pvs->numclusters * longs * 4 );
 
-	// convert leafs to clusters
-	for( i = 0; i < count; i++ )
-		leafs[i] = CM_LeafCluster( cms, leafs[i] );
+	for( i = 0; i < cms->numleafs; i++ ) {
+		int cluster = cms->map_leafs[i].cluster;
+		if( cluster < 0 || cluster >= cms->map_pvs->numclusters ) {
+			continue;
+		}
 
-	// or in all the other leaf bits
-	for( i = 0; i < count; i++ ) {
-		for( j = 0; j < i; j++ )
-			if( leafs[i] == leafs[j] ) {
-				break;
+		for( k = 0; k < 3; k++ ) {
+			mins[k] = leaf_mins[i][k] - CM_FATPVS_RADIUS;
+			maxs[k] = leaf_maxs[i][k] + CM_FATPVS_RADIUS;
+		}
+
+		count = CM_BoxLeafnums( cms, mins, maxs, leafs, cms->numleafs, NULL );
+		for( j = 0; j < count; j++ ) {
+			int touched = CM_LeafCluster( cms, leafs[j] );
+			if( touched != -1 ) {
+				CM_OrPVSRow( cms->map_fatpvs + cluster * longs * 4, CM_ClusterPVS( cms, touched ), longs );
 			}
-		if( j != i ) {
-			continue; // already have the cluster we want
 		}
-		src = CM_ClusterPVS( cms, leafs[i] );
-		for( j = 0; j < longs; j++ )
-			( (int *)out )[j] |= ( (int *)src )[j];
 	}
+
+	Mem_TempFree( leafs );
 }
 
 /*
@@ -750,16 +873,16 @@ static cmodel_state_t *CM_New_( cmodel_state_t *parent, void *mempool ) {
 	if( parent ) {
 		*cms = *parent;
 		CM_AddReference( parent );
+
+		// the fat PVS cache isn't shared between threads
+		cms->fatpvs_cache = NULL;
+		cms->fatpvs_rows = NULL;
 	}
 
 	cms->refcount = 1;
 	cms->parent = parent;
 	cms->mempool = cms_mempool;
 
-	CM_InitBoxHull( cms );
-
-	CM_InitOctagonHull( cms );
-
 	return cms;
 }
 
@@ -776,9 +899,7 @@ cmodel_state_t *CM_New( void *mempool ) {
 static void CM_Free( cmodel_state_t *cms ) {
 	cmodel_state_t *parent = cms->parent;
 
-	if( parent ) {
-		CM_FreeCheckCounts( cms );
-	} else {
+	if( !parent ) {
 		CM_Clear( cms );
 	}
 
@@ -828,6 +949,8 @@ void CM_Init( void ) {
 
 	cm_noAreas =        Cvar_Get( "cm_noAreas", "0", CVAR_CHEAT );
 	cm_noCurves =       Cvar_Get( "cm_noCurves", "0", CVAR_CHEAT );
+	cm_fatPVSPrecompute = Cvar_Get( "cm_fatPVSPrecompute", "0", CVAR_ARCHIVE );
+	cm_patchBVH =       Cvar_Get( "cm_patchBVH", "1", CVAR_CHEAT );
 
 	cm_initialized = true;
 }
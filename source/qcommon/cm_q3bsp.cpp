@@ -187,6 +187,82 @@ static int CM_CreateFacetFromPoints( cmodel_state_t *cms, cbrush_t *facet, vec3_
 	return ( facet->numsides = numbrushplanes );
 }
 
+/*
+* CM_FacetBoundsArea
+*/
+static float CM_FacetBoundsArea( const vec3_t mins, const vec3_t maxs ) {
+	vec3_t size;
+
+	VectorSubtract( maxs, mins, size );
+	return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+}
+
+/*
+* CM_SplitFacets
+*
+* Returns where to split count facets by the surface area heuristic.
+* areas is scratch space for count floats.
+*/
+static int CM_SplitFacets( const cbrush_t *facets, int count, float *areas ) {
+	int i, split;
+	vec3_t mins, maxs;
+	float cost, bestcost;
+
+	// areas[i] is the area of facets i..count-1
+	ClearBounds( mins, maxs );
+	for( i = count - 1; i > 0; i-- ) {
+		AddPointToBounds( facets[i].mins, mins, maxs );
+		AddPointToBounds( facets[i].maxs, mins, maxs );
+		areas[i] = CM_FacetBoundsArea( mins, maxs );
+	}
+
+	split = count / 2;
+	bestcost = -1;
+	ClearBounds( mins, maxs );
+	for( i = 1; i < count; i++ ) {
+		AddPointToBounds( facets[i - 1].mins, mins, maxs );
+		AddPointToBounds( facets[i - 1].maxs, mins, maxs );
+
+		cost = CM_FacetBoundsArea( mins, maxs ) * i + areas[i] * ( count - i );
+		if( bestcost < 0 || cost < bestcost ) {
+			bestcost = cost;
+			split = i;
+		}
+	}
+
+	return split;
+}
+
+/*
+* CM_BuildFacetTree
+*
+* Splits runs of facets in two instead of sorting them, so the tree visits
+* the facets in the same order as a linear scan and traces resolve ties
+* between facets the same way. Patches are built row by row, so the runs
+* are still compact.
+*/
+static int CM_BuildFacetTree( cface_t *patch, int first, int count, int numnodes, float *areas ) {
+	int i;
+	cfacetnode_t *node = &patch->nodes[numnodes++];
+
+	ClearBounds( node->mins, node->maxs );
+	for( i = first; i < first + count; i++ ) {
+		AddPointToBounds( patch->facets[i].mins, node->mins, node->maxs );
+		AddPointToBounds( patch->facets[i].maxs, node->mins, node->maxs );
+	}
+	node->firstfacet = first;
+	node->numfacets = count;
+
+	if( count > CM_FACET_LEAF_SIZE ) {
+		int split = CM_SplitFacets( patch->facets + first, count, areas );
+		numnodes = CM_BuildFacetTree( patch, first, split, numnodes, areas );
+		numnodes = CM_BuildFacetTree( patch, first + split, count - split, numnodes, areas );
+	}
+
+	node->skip = numnodes;
+	return numnodes;
+}
+
 /*
 * CM_CreatePatch
 */
@@ -230,6 +306,8 @@ static void CM_CreatePatch( cmodel_state_t *cms, cface_t *patch, cshaderref_t *s
 	totalsides = 0;
 	patch->numfacets = 0;
 	patch->facets = NULL;
+	patch->numnodes = 0;
+	patch->nodes = NULL;
 	ClearBounds( patch->mins, patch->maxs );
 
 	// create a set of facets
@@ -269,9 +347,11 @@ static void CM_CreatePatch( cmodel_state_t *cms, cface_t *patch, cshaderref_t *s
 	if( patch->numfacets ) {
 		uint8_t *fdata;
 
-		fdata = ( uint8_t * ) Mem_Alloc( cms->mempool, patch->numfacets * sizeof( cbrush_t ) + totalsides * ( sizeof( cbrushside_t ) + sizeof( cplane_t ) ) );
+		fdata = ( uint8_t * ) Mem_Alloc( cms->mempool, patch->numfacets * sizeof( cbrush_t ) + 2 * patch->numfacets * sizeof( cfacetnode_t ) +
+			totalsides * ( sizeof( cbrushside_t ) + sizeof( cplane_t ) ) );
 
 		patch->facets = ( cbrush_t * )fdata; fdata += patch->numfacets * sizeof( cbrush_t );
+		patch->nodes = ( cfacetnode_t * )fdata; fdata += 2 * patch->numfacets * sizeof( cfacetnode_t );
 		memcpy( patch->facets, facets, patch->numfacets * sizeof( cbrush_t ) );
 		for( i = 0, k = 0, facet = patch->facets; i < patch->numfacets; i++, facet++ ) {
 			cbrushside_t *s;
@@ -288,6 +368,12 @@ static void CM_CreatePatch( cmodel_state_t *cms, cface_t *patch, cshaderref_t *s
 
 		patch->contents = shaderref->contents;
 
+		if( cm_patchBVH->integer && patch->numfacets >= CM_FACET_TREE_MIN ) {
+			float *areas = ( float * ) Mem_TempMalloc( patch->numfacets * sizeof( float ) );
+			patch->numnodes = CM_BuildFacetTree( patch, 0, patch->numfacets, 0, areas );
+			Mem_TempFree( areas );
+		}
+
 		for( i = 0; i < 3; i++ ) {
 			// spread the mins / maxs by a pixel
 			patch->mins[i] -= 1;
@@ -470,6 +556,8 @@ static void CMod_LoadFaces( cmodel_state_t *cms, lump_t *l ) {
 		out->contents = 0;
 		out->numfacets = 0;
 		out->facets = NULL;
+		out->numnodes = 0;
+		out->nodes = NULL;
 		if( LittleLong( in->facetype ) != FACETYPE_PATCH ) {
 			continue;
 		}
@@ -501,6 +589,8 @@ static void CMod_LoadFaces_RBSP( cmodel_state_t *cms, lump_t *l ) {
 		out->contents = 0;
 		out->numfacets = 0;
 		out->facets = NULL;
+		out->numnodes = 0;
+		out->nodes = NULL;
 		if( LittleLong( in->facetype ) != FACETYPE_PATCH ) {
 			continue;
 		}
@@ -858,6 +948,31 @@ static void CMod_LoadVisibility( cmodel_state_t *cms, lump_t *l ) {
 	cms->map_pvs->rowsize = LittleLong( cms->map_pvs->rowsize );
 }
 
+/*
+* CMod_PrecomputeFatPVS
+*/
+static void CMod_PrecomputeFatPVS( cmodel_state_t *cms, lump_t *l ) {
+	int i, j;
+	dleaf_t *in;
+	vec3_t *mins, *maxs;
+
+	in = ( dleaf_t * )( cms->cmod_base + l->fileofs );
+	mins = ( vec3_t * ) Mem_TempMalloc( cms->numleafs * sizeof( *mins ) );
+	maxs = ( vec3_t * ) Mem_TempMalloc( cms->numleafs * sizeof( *maxs ) );
+
+	for( i = 0; i < cms->numleafs; i++, in++ ) {
+		for( j = 0; j < 3; j++ ) {
+			mins[i][j] = LittleLong( in->mins[j] );
+			maxs[i][j] = LittleLong( in->maxs[j] );
+		}
+	}
+
+	CM_PrecomputeFatPVS( cms, mins, maxs );
+
+	Mem_TempFree( mins );
+	Mem_TempFree( maxs );
+}
+
 /*
 * CMod_LoadEntityString
 */
@@ -906,6 +1021,9 @@ void CM_LoadQ3BrushModel( cmodel_state_t *cms, void *buf, int bufsize, const bsp
 	CMod_LoadNodes( cms, &header.lumps[LUMP_NODES] );
 	CMod_LoadSubmodels( cms, &header.lumps[LUMP_MODELS] );
 	CMod_LoadVisibility( cms, &header.lumps[LUMP_VISIBILITY] );
+	if( cm_fatPVSPrecompute->integer ) {
+		CMod_PrecomputeFatPVS( cms, &header.lumps[LUMP_LEAFS] );
+	}
 	CMod_LoadEntityString( cms, &header.lumps[LUMP_ENTITIES] );
 
 	if( cms->numvertexes ) {
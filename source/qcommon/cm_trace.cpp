@@ -60,8 +60,40 @@ typedef struct {
 	int *face_checkcounts;
 } traceWork_t;
 
+// everything a trace writes besides its result: the hulls CM_ModelForBBox
+// and CM_OctagonModelForBBox hand out, and marks for the brushes and faces
+// it has already tested. kept per thread so any number of threads can trace
+// the same collision model at once, which also means a hull has to be
+// traced on the thread that set it up
+typedef struct {
+	bool hulls_ready;
+
+	cbrushside_t box_brushsides[6];
+	cbrush_t box_brush[1];
+	int box_markbrushes[1];
+	cmodel_t box_cmodel[1];
+	int box_checkcount;
+
+	cbrushside_t oct_brushsides[10];
+	cbrush_t oct_brush[1];
+	int oct_markbrushes[1];
+	cmodel_t oct_cmodel[1];
+	int oct_checkcount;
+
+	// the count only ever goes up, so marks left by traces of another
+	// model or map never match and the arrays only have to grow
+	int checkcount;
+	int *brush_checkcounts;
+	int max_brushes;
+	int *face_checkcounts;
+	int max_faces;
+} cmTraceThread_t;
+
+static thread_local cmTraceThread_t cm_traceThread;
+
 int c_traces;
 int c_brush_traces;
+int c_patch_bounds;
 int c_pointcontents;
 
 /*
@@ -70,30 +102,30 @@ int c_pointcontents;
 * Set up the planes so that the six floats of a bounding box
 * can just be stored out and get a proper clipping hull structure.
 */
-void CM_InitBoxHull( cmodel_state_t *cms ) {
+static void CM_InitBoxHull( cmTraceThread_t *tt ) {
 	int i;
 	cplane_t *p;
 	cbrushside_t *s;
 
-	cms->box_brush->numsides = 6;
-	cms->box_brush->brushsides = cms->box_brushsides;
-	cms->box_brush->contents = CONTENTS_BODY;
+	tt->box_brush->numsides = 6;
+	tt->box_brush->brushsides = tt->box_brushsides;
+	tt->box_brush->contents = CONTENTS_BODY;
 
 	// Make sure CM_CollideBox() will not reject the brush by its bounds
-	ClearBounds( cms->box_brush->maxs, cms->box_brush->mins );
+	ClearBounds( tt->box_brush->maxs, tt->box_brush->mins );
 
-	cms->box_markbrushes[0] = 0;
+	tt->box_markbrushes[0] = 0;
 
-	cms->box_cmodel->brushes = cms->box_brush;
-	cms->box_cmodel->builtin = true;
-	cms->box_cmodel->nummarkfaces = 0;
-	cms->box_cmodel->markfaces = NULL;
-	cms->box_cmodel->markbrushes = cms->box_markbrushes;
-	cms->box_cmodel->nummarkbrushes = 1;
+	tt->box_cmodel->brushes = tt->box_brush;
+	tt->box_cmodel->builtin = true;
+	tt->box_cmodel->nummarkfaces = 0;
+	tt->box_cmodel->markfaces = NULL;
+	tt->box_cmodel->markbrushes = tt->box_markbrushes;
+	tt->box_cmodel->nummarkbrushes = 1;
 
 	for( i = 0; i < 6; i++ ) {
 		// brush sides
-		s = cms->box_brushsides + i;
+		s = tt->box_brushsides + i;
 		s->surfFlags = 0;
 
 		// planes
@@ -118,7 +150,7 @@ void CM_InitBoxHull( cmodel_state_t *cms ) {
 * Set up the planes so that the six floats of a bounding box
 * can just be stored out and get a proper clipping hull structure.
 */
-void CM_InitOctagonHull( cmodel_state_t *cms ) {
+static void CM_InitOctagonHull( cmTraceThread_t *tt ) {
 	int i;
 	cplane_t *p;
 	cbrushside_t *s;
@@ -129,26 +161,26 @@ void CM_InitOctagonHull( cmodel_state_t *cms ) {
 		{  1, -1, 0 }
 	};
 
-	cms->oct_brush->numsides = 10;
-	cms->oct_brush->brushsides = cms->oct_brushsides;
-	cms->oct_brush->contents = CONTENTS_BODY;
+	tt->oct_brush->numsides = 10;
+	tt->oct_brush->brushsides = tt->oct_brushsides;
+	tt->oct_brush->contents = CONTENTS_BODY;
 
 	// Make sure CM_CollideBox() will not reject the brush by its bounds
-	ClearBounds( cms->oct_brush->maxs, cms->oct_brush->mins );
+	ClearBounds( tt->oct_brush->maxs, tt->oct_brush->mins );
 
-	cms->oct_markbrushes[0] = 0;
+	tt->oct_markbrushes[0] = 0;
 
-	cms->oct_cmodel->brushes = cms->oct_brush;
-	cms->oct_cmodel->builtin = true;
-	cms->oct_cmodel->nummarkfaces = 0;
-	cms->oct_cmodel->markfaces = NULL;
-	cms->oct_cmodel->markbrushes = cms->oct_markbrushes;
-	cms->oct_cmodel->nummarkbrushes = 1;
+	tt->oct_cmodel->brushes = tt->oct_brush;
+	tt->oct_cmodel->builtin = true;
+	tt->oct_cmodel->nummarkfaces = 0;
+	tt->oct_cmodel->markfaces = NULL;
+	tt->oct_cmodel->markbrushes = tt->oct_markbrushes;
+	tt->oct_cmodel->nummarkbrushes = 1;
 
 	// axial planes
 	for( i = 0; i < 6; i++ ) {
 		// brush sides
-		s = cms->oct_brushsides + i;
+		s = tt->oct_brushsides + i;
 		s->surfFlags = 0;
 
 		// planes
@@ -169,7 +201,7 @@ void CM_InitOctagonHull( cmodel_state_t *cms ) {
 	// non-axial planes
 	for( i = 6; i < 10; i++ ) {
 		// brush sides
-		s = cms->oct_brushsides + i;
+		s = tt->oct_brushsides + i;
 		s->surfFlags = 0;
 
 		// planes
@@ -181,23 +213,59 @@ void CM_InitOctagonHull( cmodel_state_t *cms ) {
 	}
 }
 
+/*
+* CM_TraceThread
+*/
+static cmTraceThread_t *CM_TraceThread( void ) {
+	cmTraceThread_t *tt = &cm_traceThread;
+
+	if( !tt->hulls_ready ) {
+		CM_InitBoxHull( tt );
+		CM_InitOctagonHull( tt );
+		tt->hulls_ready = true;
+	}
+
+	return tt;
+}
+
+/*
+* CM_ReserveCheckCounts
+*
+* Makes room for a mark per brush and face of the map
+*/
+static void CM_ReserveCheckCounts( cmTraceThread_t *tt, const cmodel_state_t *cms ) {
+	if( cms->numbrushes > tt->max_brushes ) {
+		tt->brush_checkcounts = ( int * )Q_realloc( tt->brush_checkcounts, cms->numbrushes * sizeof( int ) );
+		memset( tt->brush_checkcounts + tt->max_brushes, 0, ( cms->numbrushes - tt->max_brushes ) * sizeof( int ) );
+		tt->max_brushes = cms->numbrushes;
+	}
+
+	if( cms->numfaces > tt->max_faces ) {
+		tt->face_checkcounts = ( int * )Q_realloc( tt->face_checkcounts, cms->numfaces * sizeof( int ) );
+		memset( tt->face_checkcounts + tt->max_faces, 0, ( cms->numfaces - tt->max_faces ) * sizeof( int ) );
+		tt->max_faces = cms->numfaces;
+	}
+}
+
 /*
 * CM_ModelForBBox
 *
 * To keep everything totally uniform, bounding boxes are turned into inline models
 */
 cmodel_t *CM_ModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs ) {
-	cms->box_brushsides[0].plane.dist = maxs[0];
-	cms->box_brushsides[1].plane.dist = -mins[0];
-	cms->box_brushsides[2].plane.dist = maxs[1];
-	cms->box_brushsides[3].plane.dist = -mins[1];
-	cms->box_brushsides[4].plane.dist = maxs[2];
-	cms->box_brushsides[5].plane.dist = -mins[2];
+	cmTraceThread_t *tt = CM_TraceThread();
 
-	VectorCopy( mins, cms->box_cmodel->mins );
-	VectorCopy( maxs, cms->box_cmodel->maxs );
+	tt->box_brushsides[0].plane.dist = maxs[0];
+	tt->box_brushsides[1].plane.dist = -mins[0];
+	tt->box_brushsides[2].plane.dist = maxs[1];
+	tt->box_brushsides[3].plane.dist = -mins[1];
+	tt->box_brushsides[4].plane.dist = maxs[2];
+	tt->box_brushsides[5].plane.dist = -mins[2];
 
-	return cms->box_cmodel;
+	VectorCopy( mins, tt->box_cmodel->mins );
+	VectorCopy( maxs, tt->box_cmodel->maxs );
+
+	return tt->box_cmodel;
 }
 
 /*
@@ -211,6 +279,7 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs
 	float a, b, d, t;
 	float sina, cosa;
 	vec3_t offset, size[2];
+	cmTraceThread_t *tt = CM_TraceThread();
 
 	for( i = 0; i < 3; i++ ) {
 		offset[i] = ( mins[i] + maxs[i] ) * 0.5;
@@ -218,16 +287,16 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs
 		size[1][i] = maxs[i] - offset[i];
 	}
 
-	VectorCopy( offset, cms->oct_cmodel->cyl_offset );
-	VectorCopy( size[0], cms->oct_cmodel->mins );
-	VectorCopy( size[1], cms->oct_cmodel->maxs );
+	VectorCopy( offset, tt->oct_cmodel->cyl_offset );
+	VectorCopy( size[0], tt->oct_cmodel->mins );
+	VectorCopy( size[1], tt->oct_cmodel->maxs );
 
-	cms->oct_brushsides[0].plane.dist = size[1][0];
-	cms->oct_brushsides[1].plane.dist = -size[0][0];
-	cms->oct_brushsides[2].plane.dist = size[1][1];
-	cms->oct_brushsides[3].plane.dist = -size[0][1];
-	cms->oct_brushsides[4].plane.dist = size[1][2];
-	cms->oct_brushsides[5].plane.dist = -size[0][2];
+	tt->oct_brushsides[0].plane.dist = size[1][0];
+	tt->oct_brushsides[1].plane.dist = -size[0][0];
+	tt->oct_brushsides[2].plane.dist = size[1][1];
+	tt->oct_brushsides[3].plane.dist = -size[0][1];
+	tt->oct_brushsides[4].plane.dist = size[1][2];
+	tt->oct_brushsides[5].plane.dist = -size[0][2];
 
 	a = size[1][0]; // halfx
 	b = size[1][1]; // halfy
@@ -247,19 +316,19 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs
 
 	// the following should match normals and signbits set in CM_InitOctagonHull
 
-	VectorSet( cms->oct_brushsides[6].plane.normal, cosa, sina, 0 );
-	cms->oct_brushsides[6].plane.dist = d;
+	VectorSet( tt->oct_brushsides[6].plane.normal, cosa, sina, 0 );
+	tt->oct_brushsides[6].plane.dist = d;
 
-	VectorSet( cms->oct_brushsides[7].plane.normal, -cosa, sina, 0 );
-	cms->oct_brushsides[7].plane.dist = d;
+	VectorSet( tt->oct_brushsides[7].plane.normal, -cosa, sina, 0 );
+	tt->oct_brushsides[7].plane.dist = d;
 
-	VectorSet( cms->oct_brushsides[8].plane.normal, -cosa, -sina, 0 );
-	cms->oct_brushsides[8].plane.dist = d;
+	VectorSet( tt->oct_brushsides[8].plane.normal, -cosa, -sina, 0 );
+	tt->oct_brushsides[8].plane.dist = d;
 
-	VectorSet( cms->oct_brushsides[9].plane.normal, cosa, -sina, 0 );
-	cms->oct_brushsides[9].plane.dist = d;
+	VectorSet( tt->oct_brushsides[9].plane.normal, cosa, -sina, 0 );
+	tt->oct_brushsides[9].plane.dist = d;
 
-	return cms->oct_cmodel;
+	return tt->oct_cmodel;
 }
 
 /*
@@ -356,11 +425,33 @@ static inline int CM_PatchContents( cface_t *patch, vec3_t p ) {
 	int i, c;
 	cbrush_t *facet;
 
-	for( i = 0, facet = patch->facets; i < patch->numfacets; i++, facet++ )
-		if( ( c = CM_BrushContents( facet, p ) ) ) {
-			return c;
+	if( !patch->numnodes ) {
+		for( i = 0, facet = patch->facets; i < patch->numfacets; i++, facet++ )
+			if( ( c = CM_BrushContents( facet, p ) ) ) {
+				return c;
+			}
+		return 0;
+	}
+
+	// facets are inside their bounds, so only the nodes containing p matter
+	for( i = 0; i < patch->numnodes; ) {
+		const cfacetnode_t *node = patch->nodes + i;
+
+		if( !BoundsOverlap( p, p, node->mins, node->maxs ) ) {
+			i = node->skip;
+			continue;
 		}
 
+		if( node->skip == i + 1 ) {
+			int j;
+			for( j = 0, facet = patch->facets + node->firstfacet; j < node->numfacets; j++, facet++ )
+				if( ( c = CM_BrushContents( facet, p ) ) ) {
+					return c;
+				}
+		}
+		i++;
+	}
+
 	return 0;
 }
 
@@ -795,15 +886,46 @@ static void CM_CollideBox( cmodel_state_t *cms, traceWork_t *tw, const int *mark
 		if( !BoundsOverlap( patch->mins, patch->maxs, tw->absmins, tw->absmaxs ) ) {
 			continue;
 		}
-		facet = patch->facets;
-		for( j = 0; j < patch->numfacets; j++, facet++ ) {
-			if( !BoundsOverlap( facet->mins, facet->maxs, tw->absmins, tw->absmaxs ) ) {
+
+		if( !patch->numnodes ) {
+			facet = patch->facets;
+			for( j = 0; j < patch->numfacets; j++, facet++ ) {
+				c_patch_bounds++;
+				if( !BoundsOverlap( facet->mins, facet->maxs, tw->absmins, tw->absmaxs ) ) {
+					continue;
+				}
+				func( cms, tw, facet );
+				if( !tw->trace->fraction ) {
+					return;
+				}
+			}
+			continue;
+		}
+
+		// the nodes bound their facets, so this tests the same facets in the same order
+		for( j = 0; j < patch->numnodes; ) {
+			const cfacetnode_t *node = patch->nodes + j;
+
+			c_patch_bounds++;
+			if( !BoundsOverlap( node->mins, node->maxs, tw->absmins, tw->absmaxs ) ) {
+				j = node->skip;
 				continue;
 			}
-			func( cms, tw, facet );
-			if( !tw->trace->fraction ) {
-				return;
+
+			if( node->skip == j + 1 ) {
+				const cbrush_t *end = patch->facets + node->firstfacet + node->numfacets;
+				for( facet = patch->facets + node->firstfacet; facet < end; facet++ ) {
+					c_patch_bounds++;
+					if( !BoundsOverlap( facet->mins, facet->maxs, tw->absmins, tw->absmaxs ) ) {
+						continue;
+					}
+					func( cms, tw, facet );
+					if( !tw->trace->fraction ) {
+						return;
+					}
+				}
 			}
+			j++;
 		}
 	}
 }
@@ -941,7 +1063,7 @@ loc0:
 */
 static void CM_BoxTrace( traceWork_t *tw, cmodel_state_t *cms, trace_t *tr, 
 	const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, 
-	cmodel_t *cmodel, const vec3_t origin, int brushmask ) {
+	cmodel_t *cmodel, const vec3_t origin, int brushmask, int headnode ) {
 	bool notworld;
 
 	notworld = ( cmodel != cms->map_cmodels ? true : false );
@@ -960,10 +1082,12 @@ static void CM_BoxTrace( traceWork_t *tw, cmodel_state_t *cms, trace_t *tr,
 		return;
 	}
 
-	cms->checkcount++;  // for multi-check avoidance
+	cmTraceThread_t *tt = CM_TraceThread();
+	CM_ReserveCheckCounts( tt, cms );
+	tt->checkcount++;  // for multi-check avoidance
 
 	memset( tw, 0, sizeof( *tw ) );
-	tw->checkcount = cms->checkcount;
+	tw->checkcount = tt->checkcount;
 	tw->trace = tr;
 	tw->contents = brushmask;
 	VectorCopy( start, tw->start );
@@ -989,15 +1113,15 @@ static void CM_BoxTrace( traceWork_t *tw, cmodel_state_t *cms, trace_t *tr,
 	tw->brushes = cmodel->brushes;
 	tw->faces = cmodel->faces;
 
-	if( cmodel == cms->oct_cmodel ) {
-		tw->brush_checkcounts = &cms->oct_checkcount;
+	if( cmodel == tt->oct_cmodel ) {
+		tw->brush_checkcounts = &tt->oct_checkcount;
 		tw->face_checkcounts = NULL;
-	} else if( cmodel == cms->box_cmodel ) {
-		tw->brush_checkcounts = &cms->box_checkcount;
+	} else if( cmodel == tt->box_cmodel ) {
+		tw->brush_checkcounts = &tt->box_checkcount;
 		tw->face_checkcounts = NULL;
 	} else {
-		tw->brush_checkcounts = cms->map_brush_checkcheckouts;
-		tw->face_checkcounts = cms->map_face_checkcheckouts;
+		tw->brush_checkcounts = tt->brush_checkcounts;
+		tw->face_checkcounts = tt->face_checkcounts;
 	}
 
 	//
@@ -1055,7 +1179,7 @@ static void CM_BoxTrace( traceWork_t *tw, cmodel_state_t *cms, trace_t *tr,
 	// general sweeping through world
 	//
 	if( !notworld ) {
-		CM_RecursiveHullCheck( cms, tw, 0, 0, 1, start, end );
+		CM_RecursiveHullCheck( cms, tw, headnode, 0, 1, start, end );
 	} else if( BoundsOverlap( cmodel->mins, cmodel->maxs, tw->absmins, tw->absmaxs ) ) {
 		CM_ClipBox( cms, tw, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
 	}
@@ -1107,7 +1231,7 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, const vec3_t star
 	}
 
 	// cylinder offset
-	if( cmodel == cms->oct_cmodel ) {
+	if( cmodel == CM_TraceThread()->oct_cmodel ) {
 		VectorSubtract( start, cmodel->cyl_offset, start_l );
 		VectorSubtract( end, cmodel->cyl_offset, end_l );
 	} else {
@@ -1145,7 +1269,7 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, const vec3_t star
 	}
 
 	// sweep the box through the model
-	CM_BoxTrace( &tw, cms, tr, start_l, end_l, mins, maxs, cmodel, origin, brushmask );
+	CM_BoxTrace( &tw, cms, tr, start_l, end_l, mins, maxs, cmodel, origin, brushmask, 0 );
 
 	if( rotated && tr->fraction != 1.0 ) {
 		VectorNegate( angles, a );
@@ -1166,3 +1290,64 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, const vec3_t star
 #endif
 	}
 }
+
+/*
+* CM_BoxHeadnode
+*
+* Returns the deepest node (or -1 - leafnum) above which every plane keeps
+* the box on one side. A world trace that stays inside the box takes the
+* same path down to it, so it can start there instead of at the root.
+*/
+int CM_BoxHeadnode( cmodel_state_t *cms, const vec3_t mins, const vec3_t maxs ) {
+	int s, num;
+	vec3_t padmins, padmaxs;
+	const cnode_t *node;
+
+	if( !cms->numnodes ) {
+		return 0;
+	}
+
+	// pad the box so traces inside it can't touch a plane it was classified against
+	VectorSet( padmins, mins[0] - 1, mins[1] - 1, mins[2] - 1 );
+	VectorSet( padmaxs, maxs[0] + 1, maxs[1] + 1, maxs[2] + 1 );
+
+	num = 0;
+	while( num >= 0 ) {
+		node = &cms->map_nodes[num];
+		s = BOX_ON_PLANE_SIDE( padmins, padmaxs, node->plane );
+		if( s == 3 ) {
+			break;
+		}
+		num = node->children[s - 1];
+	}
+
+	return num;
+}
+
+/*
+* CM_HeadnodeBoxTrace
+*
+* World trace starting at a node from CM_BoxHeadnode. The swept box of the
+* trace must be inside the box that node was found for.
+*/
+void CM_HeadnodeBoxTrace( cmodel_state_t *cms, trace_t *tr, const vec3_t start, const vec3_t end,
+						  const vec3_t mins, const vec3_t maxs, int brushmask, int headnode ) {
+	traceWork_t tw;
+
+	if( !tr ) {
+		return;
+	}
+
+	CM_BoxTrace( &tw, cms, tr, start, end, mins, maxs, cms->map_cmodels, vec3_origin, brushmask, headnode );
+
+	if( tr->fraction == 1 ) {
+		VectorCopy( end, tr->endpos );
+	} else {
+		VectorLerp( start, tr->fraction, end, tr->endpos );
+#ifdef TRACE_NOAXIAL
+		if( PlaneTypeForNormal( tr->plane.normal ) == PLANE_NONAXIAL ) {
+			VectorMA( tr->endpos, TRACE_NOAXIAL_SAFETY_OFFSET, tr->plane.normal, tr->endpos );
+		}
+#endif
+	}
+}
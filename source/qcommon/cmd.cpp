@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // cmd.c -- Quake script command processing module
 
 #include "qcommon.h"
+#include "qalgo/hash_map.h"
 #include "qalgo/q_trie.h"
 #include "client/console.h"
 
@@ -35,7 +36,8 @@ typedef struct cmdalias_s {
 static bool cmd_preinitialized = false;
 static bool cmd_initialized = false;
 
-static trie_t *cmd_alias_trie = NULL;
+static trie_t *cmd_alias_trie = NULL;     // sorted, for listing and completion
+static HashMap cmd_alias_map;              // for exact lookups
 
 static bool cmd_wait;
 static int alias_count;    // for detecting runaway loops
@@ -554,7 +556,7 @@ static void Cmd_Alias_f_( bool archive ) {
 	}
 
 	assert( cmd_alias_trie );
-	Trie_Find( cmd_alias_trie, s, TRIE_EXACT_MATCH, (void **)&a );
+	a = ( cmd_alias_t * )HashMap_Find( &cmd_alias_map, s );
 	if( a ) {
 		if( Cmd_Argc() == 2 ) {
 			if( archive ) {
@@ -569,6 +571,7 @@ static void Cmd_Alias_f_( bool archive ) {
 		a->name = (char *) ( (uint8_t *)a + sizeof( cmd_alias_t ) );
 		strcpy( a->name, s );
 		Trie_Insert( cmd_alias_trie, s, a );
+		HashMap_Set( &cmd_alias_map, a->name, a );
 	}
 
 	if( archive ) {
@@ -624,6 +627,7 @@ static void Cmd_Unalias_f( void ) {
 
 	assert( cmd_alias_trie );
 	if( Trie_Remove( cmd_alias_trie, s, (void **)&a ) == TRIE_OK ) {
+		HashMap_Remove( &cmd_alias_map, s );
 		Mem_ZoneFree( a->value );
 		Mem_ZoneFree( a );
 	} else {
@@ -649,6 +653,7 @@ static void Cmd_UnaliasAll_f( void ) {
 	}
 	Trie_FreeDump( dump );
 	Trie_Clear( cmd_alias_trie );
+	HashMap_Clear( &cmd_alias_map );
 }
 
 /*
@@ -695,7 +700,8 @@ static size_t cmd_argv_sizes[MAX_STRING_TOKENS];
 static char cmd_null_string[ 1 ] = { '\0' };
 static char cmd_args[MAX_STRING_CHARS];
 
-static trie_t *cmd_function_trie = NULL;
+static trie_t *cmd_function_trie = NULL;  // sorted, for listing and completion
+static HashMap cmd_function_map;           // for exact lookups
 
 static int Cmd_PatternMatchesFunction( void *cmd, void *pattern ) {
 	assert( cmd );
@@ -828,7 +834,8 @@ void Cmd_AddCommand( const char *cmd_name, xcommand_t function ) {
 	// fail if the command already exists
 	assert( cmd_function_trie );
 	assert( cmd_name );
-	if( Trie_Find( cmd_function_trie, cmd_name, TRIE_EXACT_MATCH, (void **)&cmd ) == TRIE_OK ) {
+	cmd = ( cmd_function_t * )HashMap_Find( &cmd_function_map, cmd_name );
+	if( cmd ) {
 		cmd->function = function;
 		cmd->completion_func = NULL;
 		Com_DPrintf( "Cmd_AddCommand: %s already defined\n", cmd_name );
@@ -841,6 +848,7 @@ void Cmd_AddCommand( const char *cmd_name, xcommand_t function ) {
 	cmd->function = function;
 	cmd->completion_func = NULL;
 	Trie_Insert( cmd_function_trie, cmd_name, cmd );
+	HashMap_Set( &cmd_function_map, cmd->name, cmd );
 }
 
 /*
@@ -856,6 +864,7 @@ void Cmd_RemoveCommand( const char *cmd_name ) {
 	assert( cmd_function_trie );
 	assert( cmd_name );
 	if( Trie_Remove( cmd_function_trie, cmd_name, (void **)&cmd ) == TRIE_OK ) {
+		HashMap_Remove( &cmd_function_map, cmd_name );
 		Mem_ZoneFree( cmd );
 	} else {
 		Com_Printf( "Cmd_RemoveCommand: %s not added\n", cmd_name );
@@ -867,11 +876,9 @@ void Cmd_RemoveCommand( const char *cmd_name ) {
 * // used by the cvar code to check for cvar / command name overlap
 */
 bool Cmd_Exists( const char *cmd_name ) {
-	cmd_function_t *cmd;
-
 	assert( cmd_function_trie );
 	assert( cmd_name );
-	return Trie_Find( cmd_function_trie, cmd_name, TRIE_EXACT_MATCH, (void **)&cmd ) == TRIE_OK;
+	return HashMap_Find( &cmd_function_map, cmd_name ) != NULL;
 }
 
 /*
@@ -885,7 +892,8 @@ void Cmd_SetCompletionFunc( const char *cmd_name, xcompletionf_t completion_func
 		return;
 	}
 
-	if( Trie_Find( cmd_function_trie, cmd_name, TRIE_EXACT_MATCH, (void **)&cmd ) == TRIE_OK ) {
+	cmd = ( cmd_function_t * )HashMap_Find( &cmd_function_map, cmd_name );
+	if( cmd ) {
 		cmd->completion_func = completion_func;
 		return;
 	}
@@ -946,9 +954,10 @@ char **Cmd_CompleteBuildList( const char *partial ) {
 * Find a possible single matching command
 */
 char **Cmd_CompleteBuildArgListExt( const char *command, const char *arguments ) {
-	cmd_function_t *cmd = NULL;
+	cmd_function_t *cmd;
 
-	if( Trie_Find( cmd_function_trie, command, TRIE_EXACT_MATCH, (void **)&cmd ) != TRIE_OK ) {
+	cmd = ( cmd_function_t * )HashMap_Find( &cmd_function_map, command );
+	if( !cmd ) {
 		return NULL;
 	}
 	if( cmd->completion_func ) {
@@ -1180,7 +1189,6 @@ char **Cmd_CompleteAliasBuildList( const char *partial ) {
 */
 bool Cmd_CheckForCommand( char *text ) {
 	char cmd[MAX_STRING_CHARS];
-	cmd_alias_t *a;
 	int i;
 
 	// this is not exactly what cbuf does when extracting lines
@@ -1200,7 +1208,7 @@ bool Cmd_CheckForCommand( char *text ) {
 	if( Cvar_Find( cmd ) ) {
 		return true;
 	}
-	if( Trie_Find( cmd_alias_trie, cmd, TRIE_EXACT_MATCH, (void **)&a ) == TRIE_OK ) {
+	if( HashMap_Find( &cmd_alias_map, cmd ) ) {
 		return true;
 	}
 
@@ -1236,7 +1244,7 @@ void Cmd_ExecuteString( const char *text ) {
 
 	assert( cmd_function_trie );
 	assert( cmd_alias_trie );
-	if( Trie_Find( cmd_function_trie, str, TRIE_EXACT_MATCH, (void **)&cmd ) == TRIE_OK ) {
+	if( ( cmd = ( cmd_function_t * )HashMap_Find( &cmd_function_map, str ) ) != NULL ) {
 		// check functions
 		if( !cmd->function ) {
 			// forward to server command
@@ -1244,7 +1252,7 @@ void Cmd_ExecuteString( const char *text ) {
 		} else {
 			cmd->function();
 		}
-	} else if( Trie_Find( cmd_alias_trie, str, TRIE_EXACT_MATCH, (void **)&a ) == TRIE_OK ) {
+	} else if( ( a = ( cmd_alias_t * )HashMap_Find( &cmd_alias_map, str ) ) != NULL ) {
 		// check alias
 		if( ++alias_count == ALIAS_LOOP_COUNT ) {
 			Com_Printf( "ALIAS_LOOP_COUNT\n" );
@@ -1297,6 +1305,8 @@ void Cmd_PreInit( void ) {
 
 	Trie_Create( TRIE_CASE_INSENSITIVE, &cmd_alias_trie );
 	Trie_Create( TRIE_CASE_INSENSITIVE, &cmd_function_trie );
+	HashMap_Init( &cmd_alias_map );
+	HashMap_Init( &cmd_function_map );
 
 	cmd_preinitialized = true;
 }
@@ -1379,6 +1389,8 @@ void Cmd_Shutdown( void ) {
 		cmd_alias_trie = NULL;
 		Trie_Destroy( cmd_function_trie );
 		cmd_function_trie = NULL;
+		HashMap_Destroy( &cmd_alias_map );
+		HashMap_Destroy( &cmd_function_map );
 
 		cmd_preinitialized = false;
 	}
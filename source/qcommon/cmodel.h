@@ -21,10 +21,13 @@
 typedef struct cmodel_state_s cmodel_state_t;
 
 extern cvar_t *cm_noCurves;
+extern cvar_t *cm_fatPVSPrecompute;
+extern cvar_t *cm_patchBVH;
 
 // debug/performance counter vars
 extern int c_traces;
 extern int c_brush_traces;
+extern int c_patch_bounds;
 extern int c_pointcontents;
 
 struct cmodel_s *CM_LoadMap( cmodel_state_t *cms, const char *name, bool clientload, unsigned *checksum );
@@ -48,6 +51,11 @@ int CM_TransformedPointContents( cmodel_state_t *cms, const vec3_t p, struct cmo
 void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
 							 struct cmodel_s *cmodel, int brushmask, const vec3_t origin, const vec3_t angles );
 
+// world traces that all stay inside one box can share the descent to its headnode
+int CM_BoxHeadnode( cmodel_state_t *cms, const vec3_t mins, const vec3_t maxs );
+void CM_HeadnodeBoxTrace( cmodel_state_t *cms, trace_t *tr, const vec3_t start, const vec3_t end,
+						  const vec3_t mins, const vec3_t maxs, int brushmask, int headnode );
+
 int CM_ClusterRowSize( cmodel_state_t *cms );
 int CM_AreaRowSize( cmodel_state_t *cms );
 int CM_PointLeafnum( cmodel_state_t *cms, const vec3_t p );
@@ -19,13 +19,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "qcommon.h"
+#include "qalgo/hash_map.h"
 #include "qalgo/q_trie.h"
 #include "client/console.h"
 
 static bool cvar_initialized = false;
 static bool cvar_preinitialized = false;
 
-static trie_t *cvar_trie = NULL;
+static trie_t *cvar_trie = NULL;     // sorted, for listing and completion
+static HashMap cvar_map;             // for exact lookups
 static qmutex_t *cvar_mutex = NULL;
 
 static int Cvar_HasFlags( void *cvar, void *flags ) {
@@ -78,7 +80,7 @@ cvar_t *Cvar_Find( const char *var_name ) {
 	cvar_t *cvar;
 	assert( cvar_trie );
 	QMutex_Lock( cvar_mutex );
-	Trie_Find( cvar_trie, var_name, TRIE_EXACT_MATCH, (void **)&cvar );
+	cvar = ( cvar_t * )HashMap_Find( &cvar_map, var_name );
 	QMutex_Unlock( cvar_mutex );
 	return cvar;
 }
@@ -139,7 +141,7 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, cvar_flag_t flags
 
 	assert( cvar_trie );
 	QMutex_Lock( cvar_mutex );
-	Trie_Find( cvar_trie, var_name, TRIE_EXACT_MATCH, (void **)&var );
+	var = ( cvar_t * )HashMap_Find( &cvar_map, var_name );
 	QMutex_Unlock( cvar_mutex );
 
 	if( !var_value ) {
@@ -206,6 +208,7 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, cvar_flag_t flags
 
 	QMutex_Lock( cvar_mutex );
 	Trie_Insert( cvar_trie, var_name, var );
+	HashMap_Set( &cvar_map, var->name, var );
 	QMutex_Unlock( cvar_mutex );
 
 	return var;
@@ -807,6 +810,7 @@ void Cvar_PreInit( void ) {
 	cvar_mutex = QMutex_Create();
 
 	Trie_Create( TRIE_CASE_INSENSITIVE, &cvar_trie );
+	HashMap_Init( &cvar_map );
 
 	cvar_preinitialized = true;
 }
@@ -882,6 +886,7 @@ void Cvar_Shutdown( void ) {
 
 		QMutex_Lock( cvar_mutex );
 		Trie_Dump( cvar_trie, "", TRIE_DUMP_VALUES, &dump );
+		HashMap_Clear( &cvar_map );
 		QMutex_Unlock( cvar_mutex );
 		for( i = 0; i < dump->size; ++i ) {
 			cvar_t * var = ( cvar_t * ) dump->key_value_vector[i].value;
@@ -904,6 +909,7 @@ void Cvar_Shutdown( void ) {
 
 		QMutex_Lock( cvar_mutex );
 		Trie_Destroy( cvar_trie );
+		HashMap_Destroy( &cvar_map );
 		QMutex_Unlock( cvar_mutex );
 		cvar_trie = NULL;
 
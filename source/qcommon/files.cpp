@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "sys_fs.h"
 
 #include "qalgo/hash.h"
+#include "qalgo/hash_map.h"
 #include "qalgo/q_trie.h"
 
 #include "zlib/zlib.h"
@@ -63,21 +64,21 @@ typedef enum {
 } fs_pure_t;
 
 typedef struct {
-	unsigned char readBuffer[FS_ZIP_BUFSIZE]; // internal buffer for compressed data
 	z_stream zstream;                       // zLib stream structure for inflate
 	size_t compressedSize;
 	size_t restReadCompressed;            // number of bytes to be decompressed
+	unsigned char readBuffer[FS_ZIP_BUFSIZE]; // internal buffer for compressed data, not allocated for mapped paks
 } zipEntry_t;
 
 #define FS_PACKFILE_DEFLATED        1
 #define FS_PACKFILE_COHERENT        2
 #define FS_PACKFILE_DIRECTORY       4
 
-#define FS_PACKFILE_NUM_THREADS     4     // including the main thread
 
 typedef struct packfile_s {
 	char *name;
 	char *pakname;
+	struct pack_s *pack;
 	unsigned flags;
 	unsigned compressedSize;    // compressed size
 	unsigned uncompressedSize;  // uncompressed size
@@ -94,10 +95,14 @@ typedef struct pack_s {
 	bool deferred_load;
 	struct pack_s *deferred_pack;
 	void *sysHandle;
+	void *mapping;      // whole archive mapped read-only, NULL if mapping failed
+	size_t mapping_size;
+	bool indexed;       // set up from its index rather than the zip directory
 	int numFiles;
 	packfile_t *files;
 	char *fileNames;
-	trie_t *trie;
+	trie_t *trie;       // sorted, for listing
+	HashMap map;        // for exact lookups
 } pack_t;
 
 typedef struct filehandle_s {
@@ -110,9 +115,9 @@ typedef struct filehandle_s {
 	gzFile gzstream;
 	int gzlevel;
 
-	void *mapping;
+	void *mapping;                  // set for entries of mapped paks
 	size_t mapping_size;
-	size_t mapping_offset;
+	size_t mapping_offset;          // offset of the entry data in the mapping
 
 	struct filehandle_s *prev, *next;
 } filehandle_t;
@@ -138,6 +143,7 @@ static cvar_t *fs_cdpath;
 static cvar_t *fs_usehomedir;
 static cvar_t *fs_usedownloadsdir;
 static cvar_t *fs_basegame;
+static cvar_t *fs_mmap;
 
 static searchpath_t *fs_basepaths = NULL;       // directories without gamedirs
 static searchpath_t *fs_searchpaths = NULL;     // game search directories, plus paks
@@ -183,21 +189,13 @@ static inline unsigned short LittleShortRaw( const uint8_t *raw ) {
 }
 
 /*
-* FS_PK3CheckFileCoherency
+* FS_PK3CheckLocalHeader
 *
-* Read the local header of the current zipfile
 * Check the coherency of the local header and info in the end of central directory about this file
 */
-static unsigned FS_PK3CheckFileCoherency( FILE *f, packfile_t *file ) {
+static unsigned FS_PK3CheckLocalHeader( const uint8_t *localHeader, const packfile_t *file ) {
 	unsigned flags;
-	unsigned char localHeader[31], compressed;
-
-	if( fseek( f, file->offset, SEEK_SET ) != 0 ) {
-		return 0;
-	}
-	if( fread( localHeader, 1, sizeof( localHeader ), f ) != sizeof( localHeader ) ) {
-		return 0;
-	}
+	unsigned char compressed;
 
 	// check the magic
 	if( LittleLongRaw( &localHeader[0] ) != FS_ZIP_LOCALHEADERMAGIC ) {
@@ -221,6 +219,49 @@ static unsigned FS_PK3CheckFileCoherency( FILE *f, packfile_t *file ) {
 	return FS_ZIP_SIZELOCALHEADER + LittleShortRaw( &localHeader[26] ) + ( unsigned )LittleShortRaw( &localHeader[28] );
 }
 
+/*
+* FS_PK3CheckFileCoherency
+*
+* Read the local header of the current zipfile and check it
+*/
+static unsigned FS_PK3CheckFileCoherency( FILE *f, const packfile_t *file ) {
+	uint8_t localHeader[FS_ZIP_SIZELOCALHEADER];
+
+	if( fseek( f, file->offset, SEEK_SET ) != 0 ) {
+		return 0;
+	}
+	if( fread( localHeader, 1, sizeof( localHeader ), f ) != sizeof( localHeader ) ) {
+		return 0;
+	}
+
+	return FS_PK3CheckLocalHeader( localHeader, file );
+}
+
+/*
+* FS_PK3CheckMappedFileCoherency
+*
+* Same as above, but for mapped paks, also making sure the entry doesn't run past the mapping
+*/
+static unsigned FS_PK3CheckMappedFileCoherency( const pack_t *pack, const packfile_t *file ) {
+	const uint8_t *base = ( const uint8_t * )pack->mapping;
+	unsigned headerSize;
+
+	if( pack->mapping_size < FS_ZIP_SIZELOCALHEADER || file->offset > pack->mapping_size - FS_ZIP_SIZELOCALHEADER ) {
+		return 0;
+	}
+
+	headerSize = FS_PK3CheckLocalHeader( base + file->offset, file );
+	if( !headerSize ) {
+		return 0;
+	}
+
+	if( (size_t)file->offset + headerSize + file->compressedSize > pack->mapping_size ) {
+		return 0;
+	}
+
+	return headerSize;
+}
+
 static int FS_SortStrings( const char **first, const char **second ) {
 	return Q_stricmp( *first, *second );
 }
@@ -289,17 +330,16 @@ static char **FS_ListFiles( char *findname, int *numfiles, unsigned musthave, un
 * FS_SearchPakForFile
 */
 static bool FS_SearchPakForFile( pack_t *pak, const char *filename, packfile_t **pout ) {
-	packfile_t *pakFile = NULL;
-	trie_error_t trie_error;
+	packfile_t *pakFile;
 
 	assert( pak );
 	assert( filename );
 
-	trie_error = Trie_Find( pak->trie, filename, TRIE_EXACT_MATCH, ( void ** )&pakFile );
+	pakFile = ( packfile_t * )HashMap_Find( &pak->map, filename );
 	if( pout ) {
 		*pout = pakFile;
 	}
-	return trie_error == TRIE_OK ? true : false;
+	return pakFile != NULL;
 }
 
 /*
@@ -924,6 +964,7 @@ bool FS_IsUrl( const char *url ) {
 */
 static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum ) {
 	filehandle_t *file;
+	pack_t *pack;
 
 	*filenum = 0;
 
@@ -934,18 +975,28 @@ static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum ) {
 		return -1;
 	}
 
+	pack = pakFile->pack;
+
 	*filenum = FS_OpenFileHandle();
 	file = &fs_filehandles[*filenum - 1];
-	file->fstream = fopen( pakFile->pakname, "rb" );
-	if( !file->fstream ) {
-		Com_Error( ERR_FATAL, "Error opening pak file: %s", pakFile->pakname );
+	if( !pack->mapping ) {
+		file->fstream = fopen( pakFile->pakname, "rb" );
+		if( !file->fstream ) {
+			Com_Error( ERR_FATAL, "Error opening pak file: %s", pakFile->pakname );
+		}
 	}
 	file->uncompressedSize = pakFile->uncompressedSize;
 	file->zipEntry = NULL;
 	file->pakFile = pakFile;
 
 	if( !( pakFile->flags & FS_PACKFILE_COHERENT ) ) {
-		unsigned offset = FS_PK3CheckFileCoherency( file->fstream, pakFile );
+		unsigned offset;
+
+		if( pack->mapping ) {
+			offset = FS_PK3CheckMappedFileCoherency( pack, pakFile );
+		} else {
+			offset = FS_PK3CheckFileCoherency( file->fstream, pakFile );
+		}
 		if( !offset ) {
 			Com_DPrintf( "_FS_FOpenPakFile: can't get proper offset for %s\n", pakFile->name );
 			return -1;
@@ -954,10 +1005,26 @@ static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum ) {
 		pakFile->flags |= FS_PACKFILE_COHERENT;
 	}
 
+	file->pakOffset = pakFile->offset;
+
+	if( pack->mapping ) {
+		file->mapping = pack->mapping;
+		file->mapping_size = pack->mapping_size;
+		file->mapping_offset = pakFile->offset;
+	}
+
 	if( pakFile->flags & FS_PACKFILE_DEFLATED ) {
-		file->zipEntry = ( zipEntry_t* )Mem_Alloc( fs_mempool, sizeof( zipEntry_t ) );
+		if( pack->mapping ) {
+			// inflate straight from the mapping, no need for the staging buffer
+			file->zipEntry = ( zipEntry_t* )Mem_Alloc( fs_mempool, offsetof( zipEntry_t, readBuffer ) );
+			file->zipEntry->zstream.next_in = ( Bytef * )file->mapping + file->mapping_offset;
+			file->zipEntry->zstream.avail_in = (uInt)pakFile->compressedSize;
+			file->zipEntry->restReadCompressed = 0;
+		} else {
+			file->zipEntry = ( zipEntry_t* )Mem_Alloc( fs_mempool, sizeof( zipEntry_t ) );
+			file->zipEntry->restReadCompressed = pakFile->compressedSize;
+		}
 		file->zipEntry->compressedSize = pakFile->compressedSize;
-		file->zipEntry->restReadCompressed = pakFile->compressedSize;
 
 		// windowBits is passed < 0 to tell that there is no zlib header.
 		// Note that in this case inflate *requires* an extra "dummy" byte
@@ -970,7 +1037,7 @@ static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum ) {
 		}
 	}
 
-	if( fseek( file->fstream, file->pakOffset, SEEK_SET ) != 0 ) {
+	if( file->fstream && fseek( file->fstream, file->pakOffset, SEEK_SET ) != 0 ) {
 		Com_DPrintf( "_FS_FOpenPakFile: can't inflate %s\n", pakFile->name );
 		return -1;
 	}
@@ -1184,8 +1251,13 @@ static int FS_ReadPK3File( uint8_t *buf, size_t len, filehandle_t *fh ) {
 	zipEntry->zstream.avail_out = (uInt)len;
 
 	totalOutBefore = zipEntry->zstream.total_out;
-	flush = ( ( len == fh->uncompressedSize )
-			  && ( zipEntry->restReadCompressed <= FS_ZIP_BUFSIZE ) && !zipEntry->zstream.avail_in ? Z_FINISH : Z_SYNC_FLUSH );
+	if( fh->mapping ) {
+		// the whole compressed stream is already available
+		flush = len == fh->uncompressedSize ? Z_FINISH : Z_SYNC_FLUSH;
+	} else {
+		flush = ( ( len == fh->uncompressedSize )
+				  && ( zipEntry->restReadCompressed <= FS_ZIP_BUFSIZE ) && !zipEntry->zstream.avail_in ? Z_FINISH : Z_SYNC_FLUSH );
+	}
 
 	do {
 		// read in chunks but attempt to read the whole file first
@@ -1241,7 +1313,7 @@ int FS_Read( void *buffer, size_t len, int file ) {
 
 	fh = FS_FileHandleForNum( file );
 
-	if( fh->fstream && fh->pakFile && len + fh->offset > fh->uncompressedSize ) {
+	if( fh->pakFile && len + fh->offset > fh->uncompressedSize ) {
 		len = fh->uncompressedSize - fh->offset;
 		if( !len ) {
 			return 0;
@@ -1250,6 +1322,9 @@ int FS_Read( void *buffer, size_t len, int file ) {
 
 	if( fh->zipEntry ) {
 		total = FS_ReadPK3File( ( uint8_t * )buffer, len, fh );
+	} else if( fh->mapping ) {
+		memcpy( buffer, ( const uint8_t * )fh->mapping + fh->mapping_offset + fh->offset, len );
+		total = (int)len;
 	} else if( fh->gzstream ) {
 		total = gzread( fh->gzstream, buffer, len );
 	} else if( fh->fstream ) {
@@ -1381,7 +1456,7 @@ int FS_Seek( int file, int offset, int whence ) {
 		return 0;
 	}
 
-	if( !fh->fstream ) {
+	if( !fh->fstream && !fh->mapping ) {
 		return -1;
 	}
 	if( offset > (int)fh->uncompressedSize ) {
@@ -1390,6 +1465,9 @@ int FS_Seek( int file, int offset, int whence ) {
 
 	if( !fh->zipEntry ) {
 		fh->offset = offset;
+		if( fh->mapping ) {
+			return 0;
+		}
 		return fseek( fh->fstream, fh->pakOffset + offset, SEEK_SET );
 	}
 
@@ -1399,19 +1477,26 @@ int FS_Seek( int file, int offset, int whence ) {
 	if( offset > currentOffset ) {
 		offset -= currentOffset;
 	} else {
-		if( fseek( fh->fstream, fh->pakOffset, SEEK_SET ) != 0 ) {
-			return -1;
+		if( fh->mapping ) {
+			zipEntry->zstream.next_in = ( Bytef * )fh->mapping + fh->mapping_offset;
+			zipEntry->zstream.avail_in = (uInt)zipEntry->compressedSize;
+			zipEntry->restReadCompressed = 0;
+		} else {
+			if( fseek( fh->fstream, fh->pakOffset, SEEK_SET ) != 0 ) {
+				return -1;
+			}
+
+			zipEntry->zstream.next_in = zipEntry->readBuffer;
+			zipEntry->zstream.avail_in = 0;
+			zipEntry->restReadCompressed = zipEntry->compressedSize;
 		}
 
-		zipEntry->zstream.next_in = zipEntry->readBuffer;
-		zipEntry->zstream.avail_in = 0;
 		error = inflateReset( &zipEntry->zstream );
 		if( error != Z_OK ) {
 			Sys_Error( "FS_Seek: can't inflateReset file" );
 		}
 
 		fh->offset = 0;
-		zipEntry->restReadCompressed = zipEntry->compressedSize;
 	}
 
 	remaining = offset;
@@ -1434,14 +1519,14 @@ int FS_Eof( int file ) {
 	filehandle_t *fh;
 
 	fh = FS_FileHandleForNum( file );
-	if( fh->zipEntry ) {
-		return fh->zipEntry->restReadCompressed == 0;
+	if( fh->pakFile ) {
+		return fh->offset >= fh->uncompressedSize;
 	}
 	if( fh->gzstream ) {
 		return gzeof( fh->gzstream );
 	}
 	if( fh->fstream ) {
-		return fh->pakFile ? fh->offset >= fh->uncompressedSize : feof( fh->fstream );
+		return feof( fh->fstream );
 	}
 	return 1;
 }
@@ -1487,6 +1572,23 @@ int FS_FileNo( int file, size_t *offset ) {
 	return -1;
 }
 
+/*
+* FS_FileView
+*
+* Returns a pointer to the contents of a file stored uncompressed in a mapped pak, NULL otherwise.
+* The view stays valid after the file is closed, for as long as the pak stays loaded.
+*/
+const void *FS_FileView( int file ) {
+	filehandle_t *fh;
+
+	fh = FS_FileHandleForNum( file );
+	if( !fh->mapping || fh->zipEntry ) {
+		return NULL;
+	}
+
+	return ( const uint8_t * )fh->mapping + fh->mapping_offset;
+}
+
 /*
 * FS_SetCompressionLevel
 */
@@ -2056,45 +2158,42 @@ static unsigned FS_PK3GetFileInfo( FILE *f, unsigned pos, unsigned byteBeforeThe
 }
 
 /*
-* FS_LoadPK3File
+* FS_AllocPack
 *
-* Takes an explicit (not game tree related) path to a pak file.
+* Allocates a pack with room for its file entries and names in a single block
+*/
+static pack_t *FS_AllocPack( const char *packfilename, int numFiles, size_t namesLen ) {
+	pack_t *pack;
+
+	pack = ( pack_t* )FS_Malloc( (int)( sizeof( pack_t ) + numFiles * sizeof( packfile_t ) + namesLen ) );
+	pack->filename = FS_CopyString( packfilename );
+	pack->files = ( packfile_t * )( ( uint8_t * )pack + sizeof( pack_t ) );
+	pack->fileNames = ( char * )( ( uint8_t * )pack->files + numFiles * sizeof( packfile_t ) );
+	pack->numFiles = numFiles;
+	pack->trie = NULL;
+	pack->mapping = NULL;
+	pack->indexed = false;
+	HashMap_Init( &pack->map );
+
+	return pack;
+}
+
+/*
+* FS_ParsePK3CentralDir
 *
-* Loads the header and directory, adding the files at the beginning
-* of the list so they override previous pack files.
+* Reads the file entries and names from the central directory and computes the pack checksum
 */
-static pack_t *FS_LoadPK3File( const char *packfilename, bool silent ) {
+static pack_t *FS_ParsePK3CentralDir( FILE *fin, const char *packfilename, bool silent, size_t *pnamesLen ) {
 	int i;
 	int *checksums = NULL;
 	int numFiles;
 	size_t namesLen, len;
 	pack_t *pack = NULL;
 	packfile_t *file;
-	FILE *fin = NULL;
 	char *names;
 	unsigned char zipHeader[20]; // we can't use a struct here because of packing
 	unsigned offset, centralPos, sizeCentralDir, offsetCentralDir, byteBeforeTheZipFile;
-	bool modulepack;
-	void *handle = NULL;
 
-	if( FS_AbsoluteFileExists( packfilename ) == -1 ) {
-		// lock the file for reading, but don't throw fatal error
-		handle = Sys_FS_LockFile( packfilename );
-		if( handle == NULL ) {
-			if( !silent ) {
-				Com_Printf( "Error locking PK3 file: %s\n", packfilename );
-			}
-			goto error;
-		}
-	}
-
-	fin = fopen( packfilename, "rb" );
-	if( fin == NULL ) {
-		if( !silent ) {
-			Com_Printf( "Error opening PK3 file: %s\n", packfilename );
-		}
-		goto error;
-	}
 	centralPos = FS_PK3SearchCentralDir( fin );
 	if( centralPos == 0 ) {
 		if( !silent ) {
@@ -2157,36 +2256,324 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent ) {
 
 	namesLen += 1; // add space for a guard
 
-	pack = ( pack_t* )FS_Malloc( (int)( sizeof( pack_t ) + numFiles * sizeof( packfile_t ) + namesLen ) );
-	pack->filename = FS_CopyString( packfilename );
-	pack->files = ( packfile_t * )( ( uint8_t * )pack + sizeof( pack_t ) );
-	pack->fileNames = names = ( char * )( ( uint8_t * )pack->files + numFiles * sizeof( packfile_t ) );
-	pack->numFiles = numFiles;
+	pack = FS_AllocPack( packfilename, numFiles, namesLen );
+
+	// allocate temp memory for files' checksums
+	checksums = ( int* )Mem_TempMallocExt( ( numFiles + 1 ) * sizeof( *checksums ), 0 );
+
+	for( i = 0, file = pack->files, names = pack->fileNames, centralPos = offsetCentralDir + byteBeforeTheZipFile; i < numFiles; i++, file++, centralPos += offset, names += len + 1 ) {
+		file->name = names;
+
+		offset = FS_PK3GetFileInfo( fin, centralPos, byteBeforeTheZipFile, file, &len, &checksums[i] );
+		if( !offset ) {
+			if( !silent ) {
+				Com_Printf( "%s is not a valid pk3 file\n", packfilename );
+			}
+			goto error;
+		}
+	}
+
+	checksums[numFiles] = 0x1234567; // add some pseudo-random stuff
+	pack->checksum = FS_ChecksumPK3File( pack->filename, numFiles + 1, checksums );
+
+	if( !pack->checksum ) {
+		if( !silent ) {
+			Com_Printf( "Couldn't generate checksum for pk3 file: %s\n", packfilename );
+		}
+		goto error;
+	}
+
+	Mem_TempFree( checksums );
+
+	*pnamesLen = namesLen;
+	return pack;
+
+error:
+	if( pack ) {
+		FS_Free( pack->filename );
+		FS_Free( pack );
+	}
+	if( checksums ) {
+		Mem_TempFree( checksums );
+	}
+
+	return NULL;
+}
+
+/*
+* PK3 indexes
+*
+* The parsed central directory and checksum of each pak are cached on disk so unchanged
+* paks can be opened with a single read. An index is only used if the size and
+* modification time of the pak match the ones it was built from, and is rebuilt otherwise.
+*/
+
+#define FS_PAKINDEX_MAGIC       "PIDX"
+#define FS_PAKINDEX_VERSION     2
+
+// followed by the pak filename, numFiles entries and namesLen bytes of names
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	int64_t fileSize;
+	int64_t mtime;
+	uint32_t checksum;
+	uint32_t filenameLen;
+	uint32_t numFiles;
+	uint32_t namesLen;
+	uint32_t hash;              // of the whole index with this set to 0
+	uint32_t pad;
+} pakindex_header_t;
+
+typedef struct {
+	uint32_t flags;
+	uint32_t compressedSize;
+	uint32_t uncompressedSize;
+	uint32_t offset;
+	uint32_t name;              // offset of the name in the names block
+} pakindex_entry_t;
+
+/*
+* FS_PK3IndexName
+*/
+void FS_PK3IndexName( const char *packfilename, char *buf, size_t buf_size ) {
+	Q_snprintfz( buf, buf_size, "%s/cache/paks/%08x.idx", FS_CacheDirectory(), Hash32( packfilename ) );
+}
+
+/*
+* FS_PK3IndexHash
+*/
+static uint32_t FS_PK3IndexHash( const pakindex_header_t *header, const void *body, size_t bodyLen ) {
+	pakindex_header_t unhashed = *header;
+	unhashed.hash = 0;
+	return Hash32( body, bodyLen, Hash32( &unhashed, sizeof( unhashed ) ) );
+}
+
+/*
+* FS_ReadPK3Index
+*
+* Returns NULL if there's no index for the pak or it's stale or corrupt
+*/
+static pack_t *FS_ReadPK3Index( const char *packfilename, int64_t fileSize, int64_t mtime ) {
+	char indexname[FS_MAX_PATH];
+	pakindex_header_t header;
+	const uint8_t *entries;
+	const char *filename, *names;
+	uint8_t *buf;
+	size_t expected;
+	pack_t *pack;
+	FILE *f;
+	int len;
+
+	FS_PK3IndexName( packfilename, indexname, sizeof( indexname ) );
+
+	f = fopen( indexname, "rb" );
+	if( !f ) {
+		return NULL;
+	}
+
+	len = FS_FileLength( f, false );
+	if( len < (int)sizeof( header ) ) {
+		fclose( f );
+		return NULL;
+	}
+
+	buf = ( uint8_t * )Mem_TempMalloc( len );
+	if( fread( buf, 1, len, f ) != (size_t)len ) {
+		fclose( f );
+		Mem_TempFree( buf );
+		return NULL;
+	}
+	fclose( f );
+
+	memcpy( &header, buf, sizeof( header ) );
+	expected = sizeof( header ) + header.filenameLen + (size_t)header.numFiles * sizeof( pakindex_entry_t ) + header.namesLen;
+
+	if( memcmp( header.magic, FS_PAKINDEX_MAGIC, sizeof( header.magic ) ) || header.version != FS_PAKINDEX_VERSION
+		|| header.fileSize != fileSize || header.mtime != mtime
+		|| !header.numFiles || header.numFiles > 0xffff || !header.namesLen || expected != (size_t)len
+		|| header.hash != FS_PK3IndexHash( &header, buf + sizeof( header ), len - sizeof( header ) ) ) {
+		Mem_TempFree( buf );
+		return NULL;
+	}
+
+	filename = ( const char * )buf + sizeof( header );
+	entries = ( const uint8_t * )filename + header.filenameLen;
+	names = ( const char * )entries + header.numFiles * sizeof( pakindex_entry_t );
+
+	if( header.filenameLen != strlen( packfilename ) || memcmp( filename, packfilename, header.filenameLen )
+		|| names[header.namesLen - 1] != '\0' ) {
+		Mem_TempFree( buf );
+		return NULL;
+	}
+
+	pack = FS_AllocPack( packfilename, header.numFiles, header.namesLen );
+	pack->checksum = header.checksum;
+	memcpy( pack->fileNames, names, header.namesLen );
+
+	for( int i = 0; i < pack->numFiles; i++ ) {
+		packfile_t *file = &pack->files[i];
+		pakindex_entry_t entry;
+
+		memcpy( &entry, entries + i * sizeof( entry ), sizeof( entry ) );
+		if( entry.name >= header.namesLen || entry.offset >= fileSize ) {
+			FS_Free( pack->filename );
+			FS_Free( pack );
+			Mem_TempFree( buf );
+			return NULL;
+		}
+
+		file->name = pack->fileNames + entry.name;
+		file->flags = entry.flags & ( FS_PACKFILE_DEFLATED | FS_PACKFILE_DIRECTORY );
+		file->compressedSize = entry.compressedSize;
+		file->uncompressedSize = entry.uncompressedSize;
+		file->offset = entry.offset;
+	}
+
+	Mem_TempFree( buf );
+
+	return pack;
+}
+
+/*
+* FS_WritePK3Index
+*
+* Must be called before any of the pak's files are opened, which adjusts their offsets
+*/
+static void FS_WritePK3Index( const pack_t *pack, size_t namesLen, int64_t fileSize, int64_t mtime ) {
+	char indexname[FS_MAX_PATH], tempname[FS_MAX_PATH];
+	pakindex_header_t header;
+	uint8_t *body;
+	size_t bodyLen;
+	bool ok;
+	FILE *f;
+
+	FS_PK3IndexName( pack->filename, indexname, sizeof( indexname ) );
+	Q_snprintfz( tempname, sizeof( tempname ), "%s.tmp", indexname );
+	FS_CreateAbsolutePath( tempname );
+
+	f = fopen( tempname, "wb" );
+	if( !f ) {
+		return;
+	}
+
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, FS_PAKINDEX_MAGIC, sizeof( header.magic ) );
+	header.version = FS_PAKINDEX_VERSION;
+	header.fileSize = fileSize;
+	header.mtime = mtime;
+	header.checksum = pack->checksum;
+	header.filenameLen = strlen( pack->filename );
+	header.numFiles = pack->numFiles;
+	header.namesLen = namesLen;
+
+	// the body is built in memory first so it can be hashed into the header
+	bodyLen = header.filenameLen + (size_t)header.numFiles * sizeof( pakindex_entry_t ) + namesLen;
+	body = ( uint8_t * )Mem_TempMalloc( bodyLen );
+	memcpy( body, pack->filename, header.filenameLen );
+
+	for( int i = 0; i < pack->numFiles; i++ ) {
+		const packfile_t *file = &pack->files[i];
+		pakindex_entry_t entry;
+
+		entry.flags = file->flags;
+		entry.compressedSize = file->compressedSize;
+		entry.uncompressedSize = file->uncompressedSize;
+		entry.offset = file->offset;
+		entry.name = file->name - pack->fileNames;
+		memcpy( body + header.filenameLen + i * sizeof( entry ), &entry, sizeof( entry ) );
+	}
+
+	memcpy( body + bodyLen - namesLen, pack->fileNames, namesLen );
+	header.hash = FS_PK3IndexHash( &header, body, bodyLen );
+
+	ok = fwrite( &header, sizeof( header ), 1, f ) == 1;
+	ok = ok && fwrite( body, 1, bodyLen, f ) == bodyLen;
+	ok = fclose( f ) == 0 && ok;
+
+	Mem_TempFree( body );
+
+	// readers never see a partially written index
+	if( !ok || rename( tempname, indexname ) != 0 ) {
+		remove( tempname );
+	}
+}
+
+/*
+* FS_LoadPK3File
+*
+* Takes an explicit (not game tree related) path to a pak file.
+*
+* Loads the header and directory, adding the files at the beginning
+* of the list so they override previous pack files.
+*/
+static pack_t *FS_LoadPK3File( const char *packfilename, bool silent ) {
+	int i;
+	size_t namesLen = 0;
+	pack_t *pack = NULL;
+	packfile_t *file;
+	FILE *fin = NULL;
+	int64_t fileSize;
+	time_t mtime;
+	bool modulepack, indexed = false;
+	void *handle = NULL;
+
+	if( FS_AbsoluteFileExists( packfilename ) == -1 ) {
+		// lock the file for reading, but don't throw fatal error
+		handle = Sys_FS_LockFile( packfilename );
+		if( handle == NULL ) {
+			if( !silent ) {
+				Com_Printf( "Error locking PK3 file: %s\n", packfilename );
+			}
+			goto error;
+		}
+	}
+
+	fin = fopen( packfilename, "rb" );
+	if( fin == NULL ) {
+		if( !silent ) {
+			Com_Printf( "Error opening PK3 file: %s\n", packfilename );
+		}
+		goto error;
+	}
+
+	fileSize = FS_FileLength( fin, false );
+	mtime = Sys_FS_FileMTime( packfilename );
+
+	if( mtime != -1 ) {
+		pack = FS_ReadPK3Index( packfilename, fileSize, mtime );
+		indexed = pack != NULL;
+	}
+	if( !pack ) {
+		pack = FS_ParsePK3CentralDir( fin, packfilename, silent, &namesLen );
+		if( !pack ) {
+			goto error;
+		}
+	}
+
+	fclose( fin );
+	fin = NULL;
+
 	pack->sysHandle = handle;
-	pack->trie = NULL;
 	pack->pure = FS_IsExplicitPurePak( packfilename ) ? FS_PURE_EXPLICIT : FS_PURE_NONE;
+	pack->indexed = indexed;
 
 	Trie_Create( TRIE_CASE_INSENSITIVE, &pack->trie );
 
-	// allocate temp memory for files' checksums
-	checksums = ( int* )Mem_TempMallocExt( ( numFiles + 1 ) * sizeof( *checksums ), 0 );
-
 	if( !Q_strnicmp( COM_FileBase( packfilename ), "modules", strlen( "modules" ) ) ) {
 		modulepack = true;
 	} else {
 		modulepack = false;
 	}
 
-	// add all files to the trie
-	for( i = 0, file = pack->files, centralPos = offsetCentralDir + byteBeforeTheZipFile; i < numFiles; i++, file++, centralPos += offset, names += len + 1 ) {
+	// add all files to the trie and the map
+	for( i = 0, file = pack->files; i < pack->numFiles; i++, file++ ) {
 		const char *ext;
 		trie_error_t trie_err;
 		packfile_t *trie_file;
 
-		file->name = names;
 		file->pakname = pack->filename;
-
-		offset = FS_PK3GetFileInfo( fin, centralPos, byteBeforeTheZipFile, file, &len, &checksums[i] );
+		file->pack = pack;
 
 		if( !COM_ValidateRelativeFilename( file->name ) ) {
 			if( !silent ) {
@@ -2210,25 +2597,21 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent ) {
 		if( trie_err == TRIE_KEY_NOT_FOUND ) {
 			Trie_Insert( pack->trie, file->name, file );
 		}
+		HashMap_Set( &pack->map, file->name, file );
 	}
 
-	fclose( fin );
-	fin = NULL;
-
-	checksums[numFiles] = 0x1234567; // add some pseudo-random stuff
-	pack->checksum = FS_ChecksumPK3File( pack->filename, numFiles + 1, checksums );
-
-	if( !pack->checksum ) {
-		if( !silent ) {
-			Com_Printf( "Couldn't generate checksum for pk3 file: %s\n", packfilename );
-		}
-		goto error;
+	if( !indexed && mtime != -1 ) {
+		FS_WritePK3Index( pack, namesLen, fileSize, mtime );
 	}
 
-	Mem_TempFree( checksums );
+	// map the whole archive so entries can be read without going through stdio,
+	// fall back to regular reads if that fails
+	if( fs_mmap->integer ) {
+		pack->mapping = Sys_FS_MMapFile( packfilename, &pack->mapping_size );
+	}
 
 	if( !silent ) {
-		Com_Printf( "Added pk3 file %s (%i files)\n", pack->filename, pack->numFiles );
+		Com_Printf( "Added pk3 file %s (%i files%s)\n", pack->filename, pack->numFiles, indexed ? ", indexed" : "" );
 	}
 
 	return pack;
@@ -2241,14 +2624,10 @@ error:
 		if( pack->trie ) {
 			Trie_Destroy( pack->trie );
 		}
-		if( pack->filename ) {
-			FS_Free( pack->filename );
-		}
+		HashMap_Destroy( &pack->map );
+		FS_Free( pack->filename );
 		FS_Free( pack );
 	}
-	if( checksums ) {
-		Mem_TempFree( checksums );
-	}
 	if( handle != NULL ) {
 		Sys_FS_UnlockFile( handle );
 	}
@@ -2372,7 +2751,11 @@ static void FS_FreePakFile( pack_t *pack ) {
 	if( pack->sysHandle ) {
 		Sys_FS_UnlockFile( pack->sysHandle );
 	}
+	if( pack->mapping ) {
+		Sys_FS_UnMMapFile( pack->mapping, pack->mapping_size );
+	}
 	Trie_Destroy( pack->trie );
+	HashMap_Destroy( &pack->map );
 	FS_Free( pack->filename );
 	FS_Free( pack );
 }
@@ -2400,6 +2783,55 @@ bool FS_IsPakValid( const char *filename, unsigned *checksum ) {
 	return false;
 }
 
+/*
+* FS_InspectPakFile
+*
+* Loads a pak from an absolute filename the way the search paths would, reports
+* its checksum, whether it came from the index and each of its entries, and frees it
+*/
+bool FS_InspectPakFile( const char *packfilename, unsigned *checksum, bool *indexed,
+	void ( *callback )( const fs_pakentry_t *entry, void *data ), void *data ) {
+	pack_t *pakfile;
+
+	pakfile = FS_LoadPackFile( packfilename, true );
+	if( !pakfile ) {
+		return false;
+	}
+
+	if( checksum ) {
+		*checksum = pakfile->checksum;
+	}
+	if( indexed ) {
+		*indexed = pakfile->indexed;
+	}
+
+	if( callback ) {
+		for( int i = 0; i < pakfile->numFiles; i++ ) {
+			const packfile_t *file = &pakfile->files[i];
+			fs_pakentry_t entry;
+
+			entry.name = file->name;
+			entry.deflated = ( file->flags & FS_PACKFILE_DEFLATED ) != 0;
+			entry.directory = ( file->flags & FS_PACKFILE_DIRECTORY ) != 0;
+			entry.compressedSize = file->compressedSize;
+			entry.uncompressedSize = file->uncompressedSize;
+			entry.offset = file->offset;
+			entry.data = NULL;
+			if( pakfile->mapping ) {
+				unsigned headerSize = FS_PK3CheckMappedFileCoherency( pakfile, file );
+				if( headerSize ) {
+					entry.data = ( const uint8_t * )pakfile->mapping + file->offset + headerSize;
+				}
+			}
+			callback( &entry, data );
+		}
+	}
+
+	FS_FreePakFile( pakfile );
+
+	return true;
+}
+
 /*
 * FS_CheckPakExtension
 */
@@ -3032,45 +3464,28 @@ static void FS_ReplaceDeferredPaks( void ) {
 /*
 * FS_LoadDeferredPaks_Job
 */
-typedef struct {
-	volatile int cnt;
-	int maxcnt;
-	pack_t **packs;
-} deferred_pack_arg_t;
-
-static void *FS_LoadDeferredPaks_Job( void *parg ) {
+static void FS_LoadDeferredPaks_Job( void *data, int begin, int end ) {
 	int i;
 	pack_t *pack;
-	deferred_pack_arg_t *arg = ( deferred_pack_arg_t * ) parg;
+	pack_t **packs = ( pack_t ** ) data;
 
-	while( true ) {
-		i = QAtomic_FetchAdd( &arg->cnt, 1 );
-		if( i >= arg->maxcnt ) {
-			break;
-		}
-
-		pack = arg->packs[i];
+	for( i = begin; i < end; i++ ) {
+		pack = packs[i];
 
 		assert( pack != NULL );
 		assert( pack->deferred_load );
 
 		pack->deferred_pack = FS_LoadPackFile( pack->filename, false );
 	}
-
-	return NULL;
 }
 
 /*
 * FS_LoadDeferredPaks
 */
 static void FS_LoadDeferredPaks( int newpaks ) {
-	int i;
 	int cnt;
-	qthread_t *threads[FS_PACKFILE_NUM_THREADS - 1] = { NULL };
-	const int num_threads = min( newpaks, FS_PACKFILE_NUM_THREADS ) - 1;
 	pack_t **packs;
 	searchpath_t *search;
-	deferred_pack_arg_t *arg;
 
 	if( !newpaks ) {
 		return;
@@ -3091,27 +3506,11 @@ static void FS_LoadDeferredPaks( int newpaks ) {
 		}
 	}
 
-	arg = ( deferred_pack_arg_t * ) Mem_TempMalloc( sizeof( *arg ) );
-	arg->cnt = 0;
-	arg->maxcnt = newpaks;
-	arg->packs = packs;
-
-	if( num_threads > 0 ) {
-		for( i = 0; i < num_threads; i++ )
-			threads[i] = QThread_Create( FS_LoadDeferredPaks_Job, arg );
-	}
-
-	FS_LoadDeferredPaks_Job( arg );
-
-	if( num_threads > 0 ) {
-		for( i = 0; i < num_threads; i++ )
-			QThread_Join( threads[i] );
-	}
+	QJob_ParallelFor( cnt, 1, FS_LoadDeferredPaks_Job, packs );
 
 	FS_ReplaceDeferredPaks();
 
-	Mem_TempFree( arg->packs );
-	Mem_TempFree( arg );
+	Mem_TempFree( packs );
 }
 
 /*
@@ -3410,6 +3809,7 @@ void FS_Init( void ) {
 	fs_usehomedir = Cvar_Get( "fs_usehomedir", "0", CVAR_NOSET );
 #endif
 	fs_usedownloadsdir = Cvar_Get( "fs_usedownloadsdir", "1", CVAR_NOSET );
+	fs_mmap = Cvar_Get( "fs_mmap", "1", CVAR_NOSET );
 
 	fs_downloads_searchpath = NULL;
 	if( fs_usedownloadsdir->integer ) {
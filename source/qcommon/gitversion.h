@@ -0,0 +1,5 @@
+#define APP_VERSION "git-25ecf09"
+#define APP_VERSION_A 0
+#define APP_VERSION_B 0
+#define APP_VERSION_C 0
+#define APP_VERSION_D 0
@@ -0,0 +1,275 @@
+#include "qcommon/qcommon.h"
+#include "qcommon/qthreads.h"
+#include "qcommon/sys_threads.h"
+
+#define MAX_JOB_WORKERS 16
+#define JOB_DEQUE_SIZE 1024 // must be a power of two
+
+struct Job {
+	qjobfunc_t func;
+	void * data;
+	volatile int * counter;
+};
+
+/*
+ * the owner pushes and pops at the bottom, thieves take the oldest job from
+ * the top. each deque has its own lock so workers only contend when stealing
+ */
+struct JobDeque {
+	qmutex_t * mutex;
+	Job jobs[ JOB_DEQUE_SIZE ];
+	unsigned int top;
+	unsigned int bottom;
+};
+
+// one deque per worker, plus one shared by every thread that isn't a worker
+static JobDeque job_deques[ MAX_JOB_WORKERS + 1 ];
+static qthread_t * job_threads[ MAX_JOB_WORKERS ];
+static int num_job_workers;
+static int num_job_deques;
+
+static qmutex_t * job_sleep_mutex;
+static qcondvar_t * job_sleep_cond;
+static volatile int job_pending;
+static bool job_quit;
+
+static thread_local int job_deque_index = -1;
+
+static bool JobDeque_Push( JobDeque * deque, const Job & job ) {
+	QMutex_Lock( deque->mutex );
+	bool full = deque->bottom - deque->top == JOB_DEQUE_SIZE;
+	if( !full ) {
+		deque->jobs[ deque->bottom % JOB_DEQUE_SIZE ] = job;
+		deque->bottom++;
+	}
+	QMutex_Unlock( deque->mutex );
+	return !full;
+}
+
+static bool JobDeque_Pop( JobDeque * deque, Job * job ) {
+	QMutex_Lock( deque->mutex );
+	bool empty = deque->bottom == deque->top;
+	if( !empty ) {
+		deque->bottom--;
+		*job = deque->jobs[ deque->bottom % JOB_DEQUE_SIZE ];
+	}
+	QMutex_Unlock( deque->mutex );
+	return !empty;
+}
+
+static bool JobDeque_Steal( JobDeque * deque, Job * job ) {
+	QMutex_Lock( deque->mutex );
+	bool empty = deque->bottom == deque->top;
+	if( !empty ) {
+		*job = deque->jobs[ deque->top % JOB_DEQUE_SIZE ];
+		deque->top++;
+	}
+	QMutex_Unlock( deque->mutex );
+	return !empty;
+}
+
+static int QJob_DequeIndex() {
+	return job_deque_index == -1 ? num_job_workers : job_deque_index;
+}
+
+static void QJob_Run( const Job & job ) {
+	job.func( job.data );
+	if( job.counter != NULL ) {
+		QAtomic_FetchAdd( job.counter, -1 );
+	}
+}
+
+/*
+ * QJob_RunOne
+ *
+ * Runs a job from our own deque, or steals one from another. Returns false
+ * if there was nothing to do.
+ */
+static bool QJob_RunOne( int self ) {
+	if( job_pending == 0 )
+		return false;
+
+	Job job;
+	bool found = JobDeque_Pop( &job_deques[ self ], &job );
+	for( int i = 1; !found && i < num_job_deques; i++ ) {
+		found = JobDeque_Steal( &job_deques[ ( self + i ) % num_job_deques ], &job );
+	}
+
+	if( !found )
+		return false;
+
+	QAtomic_FetchAdd( &job_pending, -1 );
+	QJob_Run( job );
+
+	return true;
+}
+
+static void * QJob_WorkerThread( void * param ) {
+	job_deque_index = ( int ) ( intptr_t ) param;
+
+	while( true ) {
+		if( QJob_RunOne( job_deque_index ) )
+			continue;
+
+		QMutex_Lock( job_sleep_mutex );
+		while( !job_quit && job_pending == 0 ) {
+			QCondVar_Wait( job_sleep_cond, job_sleep_mutex );
+		}
+		bool quit = job_quit;
+		QMutex_Unlock( job_sleep_mutex );
+
+		if( quit )
+			break;
+	}
+
+	return NULL;
+}
+
+/*
+ * QJobs_Init
+ *
+ * num_workers <= 0 starts one worker per core besides this one.
+ */
+void QJobs_Init( int num_workers ) {
+	if( num_workers <= 0 ) {
+		num_workers = Sys_Thread_NumProcessors() - 1;
+	}
+
+	num_job_workers = Clamp( 1, num_workers, MAX_JOB_WORKERS );
+	num_job_deques = num_job_workers + 1;
+	job_pending = 0;
+	job_quit = false;
+
+	job_sleep_mutex = QMutex_Create();
+	job_sleep_cond = QCondVar_Create();
+
+	for( int i = 0; i < num_job_deques; i++ ) {
+		job_deques[ i ].mutex = QMutex_Create();
+		job_deques[ i ].top = 0;
+		job_deques[ i ].bottom = 0;
+	}
+
+	for( int i = 0; i < num_job_workers; i++ ) {
+		job_threads[ i ] = QThread_Create( QJob_WorkerThread, ( void * ) ( intptr_t ) i );
+	}
+}
+
+/*
+ * QJobs_Shutdown
+ */
+void QJobs_Shutdown() {
+	if( num_job_workers == 0 )
+		return;
+
+	QMutex_Lock( job_sleep_mutex );
+	job_quit = true;
+	for( int i = 0; i < num_job_workers; i++ ) {
+		QCondVar_Wake( job_sleep_cond );
+	}
+	QMutex_Unlock( job_sleep_mutex );
+
+	for( int i = 0; i < num_job_workers; i++ ) {
+		QThread_Join( job_threads[ i ] );
+	}
+
+	for( int i = 0; i < num_job_deques; i++ ) {
+		QMutex_Destroy( &job_deques[ i ].mutex );
+	}
+
+	QCondVar_Destroy( &job_sleep_cond );
+	QMutex_Destroy( &job_sleep_mutex );
+
+	num_job_workers = 0;
+	num_job_deques = 0;
+}
+
+int QJobs_NumWorkers() {
+	return num_job_workers;
+}
+
+/*
+ * QJob_Submit
+ */
+void QJob_Submit( qjobfunc_t func, void * data, volatile int * counter ) {
+	Job job = { func, data, counter };
+
+	if( counter != NULL ) {
+		QAtomic_FetchAdd( counter, 1 );
+	}
+
+	// run it right away if the pool isn't up or our deque is full
+	if( num_job_workers == 0 || !JobDeque_Push( &job_deques[ QJob_DequeIndex() ], job ) ) {
+		QJob_Run( job );
+		return;
+	}
+
+	QAtomic_FetchAdd( &job_pending, 1 );
+
+	QMutex_Lock( job_sleep_mutex );
+	QCondVar_Wake( job_sleep_cond );
+	QMutex_Unlock( job_sleep_mutex );
+}
+
+/*
+ * QJob_Wait
+ *
+ * Helps out with other jobs until the counter drops to zero.
+ */
+void QJob_Wait( volatile int * counter ) {
+	int self = QJob_DequeIndex();
+
+	// FetchAdd rather than a plain read so the job's writes are visible once we see zero
+	while( QAtomic_FetchAdd( counter, 0 ) > 0 ) {
+		if( !QJob_RunOne( self ) ) {
+			QThread_Yield();
+		}
+	}
+}
+
+struct ParallelForRange {
+	void ( *func )( void * data, int begin, int end );
+	void * data;
+	int begin;
+	int end;
+};
+
+static void QJob_ParallelForRange( void * data ) {
+	const ParallelForRange * range = ( const ParallelForRange * ) data;
+	range->func( range->data, range->begin, range->end );
+}
+
+/*
+ * QJob_ParallelFor
+ *
+ * Calls func over [0, count) in batches of batch indices and returns once
+ * they are all done. batch <= 0 picks a size that gives every thread a few batches.
+ */
+void QJob_ParallelFor( int count, int batch, void ( *func )( void * data, int begin, int end ), void * data ) {
+	if( count <= 0 )
+		return;
+
+	if( batch <= 0 ) {
+		batch = Max2( 1, count / ( ( num_job_workers + 1 ) * 4 ) );
+	}
+
+	int num_ranges = ( count + batch - 1 ) / batch;
+	if( num_ranges == 1 || num_job_workers == 0 ) {
+		func( data, 0, count );
+		return;
+	}
+
+	ParallelForRange * ranges = ( ParallelForRange * ) Q_malloc( sizeof( ParallelForRange ) * num_ranges );
+	volatile int counter = 0;
+
+	for( int i = 0; i < num_ranges; i++ ) {
+		ranges[ i ].func = func;
+		ranges[ i ].data = data;
+		ranges[ i ].begin = i * batch;
+		ranges[ i ].end = Min2( count, ( i + 1 ) * batch );
+		QJob_Submit( QJob_ParallelForRange, &ranges[ i ], &counter );
+	}
+
+	QJob_Wait( &counter );
+
+	Q_free( ranges );
+}
@@ -42,6 +42,7 @@ void MSG_Init( msg_t *msg, uint8_t *data, size_t length ) {
 void MSG_Clear( msg_t *msg ) {
 	msg->cursize = 0;
 	msg->compressed = false;
+	msg->writebits = 0;
 }
 
 void *MSG_GetSpace( msg_t *msg, size_t length ) {
@@ -165,12 +166,37 @@ void MSG_WriteString( msg_t *msg, const char *s ) {
 	}
 }
 
+/*
+* MSG_WriteBits
+*
+* Packs the low bits of value into the message, LSB first. Consecutive calls
+* share bytes, any byte aligned write in between starts a new byte.
+*/
+void MSG_WriteBits( msg_t *msg, uint32_t value, int bits ) {
+	assert( bits >= 0 && bits <= 32 );
+
+	while( bits > 0 ) {
+		if( msg->writebits == 0 || msg->writebits == 8 || msg->writebitbyte != msg->cursize ) {
+			MSG_WriteUint8( msg, 0 );
+			msg->writebitbyte = msg->cursize;
+			msg->writebits = 0;
+		}
+
+		int n = Min2( 8 - msg->writebits, bits );
+		msg->data[msg->cursize - 1] |= ( value & ( ( 1u << n ) - 1 ) ) << msg->writebits;
+		msg->writebits += n;
+		value = n < 32 ? value >> n : 0;
+		bits -= n;
+	}
+}
+
 //==================================================
 // READ FUNCTIONS
 //==================================================
 
 void MSG_BeginReading( msg_t *msg ) {
 	msg->readcount = 0;
+	msg->readbits = 0;
 }
 
 int MSG_ReadInt8( msg_t *msg ) {
@@ -322,10 +348,76 @@ char *MSG_ReadStringLine( msg_t *msg ) {
 	return MSG_ReadString2( msg, true );
 }
 
+/*
+* MSG_ReadBits
+*/
+uint32_t MSG_ReadBits( msg_t *msg, int bits ) {
+	assert( bits >= 0 && bits <= 32 );
+
+	uint32_t value = 0;
+	int shift = 0;
+	while( bits > 0 ) {
+		if( msg->readbits == 0 || msg->readbits == 8 || msg->readbitbyte != msg->readcount ) {
+			MSG_ReadUint8( msg );
+			msg->readbitbyte = msg->readcount;
+			msg->readbits = 0;
+		}
+
+		int n = Min2( 8 - msg->readbits, bits );
+		uint32_t byte = msg->readcount <= msg->cursize ? msg->data[msg->readcount - 1] : 0;
+		value |= ( ( byte >> msg->readbits ) & ( ( 1u << n ) - 1 ) ) << shift;
+		msg->readbits += n;
+		shift += n;
+		bits -= n;
+	}
+
+	return value;
+}
+
 //==================================================
 // ENCODED FIELDS
 //==================================================
 
+#define COORD_QUANT_SCALE 8.0f
+#define COORD_QUANT_MAX ( 1 << 29 )
+
+static int32_t MSG_QuantizeCoord( float f ) {
+	float q = floorf( f * COORD_QUANT_SCALE + 0.5f );
+	if( !( q > -COORD_QUANT_MAX ) ) { // also catches NaN
+		return -COORD_QUANT_MAX;
+	}
+	if( q > COORD_QUANT_MAX ) {
+		return COORD_QUANT_MAX;
+	}
+	return int32_t( q );
+}
+
+static float MSG_DequantizeCoord( int32_t q ) {
+	return q * ( 1.0f / COORD_QUANT_SCALE );
+}
+
+/*
+* MSG_WriteCoordDelta
+*
+* Zig-zag encodes the delta, then writes its bit length in 5 bits followed by
+* that many bits. Quantized coords are clamped so the delta always fits in 31 bits.
+*/
+static void MSG_WriteCoordDelta( msg_t *msg, int32_t delta ) {
+	uint32_t zz = ( uint32_t( delta ) << 1 ) ^ uint32_t( delta >> 31 );
+	int len = 0;
+	while( len < 31 && ( zz >> len ) != 0 ) {
+		len++;
+	}
+	MSG_WriteBits( msg, len, 5 );
+	MSG_WriteBits( msg, zz, len );
+}
+
+static int32_t MSG_ReadCoordDelta( msg_t *msg ) {
+	int len = MSG_ReadBits( msg, 5 );
+	uint32_t zz = MSG_ReadBits( msg, len );
+	return int32_t( zz >> 1 ) ^ -int32_t( zz & 1 );
+}
+
 /*
 * MSG_FieldBytes
 */
@@ -380,7 +472,7 @@ static bool MSG_CompareField( const uint8_t *from, const uint8_t *to, const msg_
 /*
 * MSG_WriteField
 */
-static void MSG_WriteField( msg_t *msg, const uint8_t *to, const msg_field_t *field ) {
+static void MSG_WriteField( msg_t *msg, const uint8_t *from, const uint8_t *to, const msg_field_t *field ) {
 	switch( field->encoding ) {
 	case WIRE_BOOL:
 		break;
@@ -443,6 +535,11 @@ static void MSG_WriteField( msg_t *msg, const uint8_t *to, const msg_field_t *fi
 			break;
 		}
 		break;
+	case WIRE_QUANT_COORD: {
+		int32_t qfrom = MSG_QuantizeCoord( *((float *)( from + field->offset )) );
+		int32_t qto = MSG_QuantizeCoord( *((float *)( to + field->offset )) );
+		MSG_WriteCoordDelta( msg, qto - qfrom );
+	} break;
 	default:
 		Com_Error( ERR_FATAL, "MSG_WriteField: unknown encoding type %i", field->encoding );
 		break;
@@ -452,7 +549,7 @@ static void MSG_WriteField( msg_t *msg, const uint8_t *to, const msg_field_t *fi
 /*
 * MSG_ReadField
 */
-static void MSG_ReadField( msg_t *msg, uint8_t *to, const msg_field_t *field ) {
+static void MSG_ReadField( msg_t *msg, const uint8_t *from, uint8_t *to, const msg_field_t *field ) {
 	switch( field->encoding ) {
 	case WIRE_BOOL:
 		*((bool *)( to + field->offset )) ^= true;
@@ -516,6 +613,10 @@ static void MSG_ReadField( msg_t *msg, uint8_t *to, const msg_field_t *field ) {
 			break;
 		}
 		break;
+	case WIRE_QUANT_COORD: {
+		int32_t qfrom = MSG_QuantizeCoord( *((const float *)( from + field->offset )) );
+		*((float *)( to + field->offset )) = MSG_DequantizeCoord( qfrom + MSG_ReadCoordDelta( msg ) );
+	} break;
 	default:
 		Com_Error( ERR_FATAL, "MSG_WriteField: unknown encoding type %i", field->encoding );
 		break;
@@ -599,10 +700,11 @@ static unsigned MSG_CompareArrays( const void *from, const void *to, const msg_f
 /*
 * MSG_WriteArrayElems
 */
-static void MSG_WriteArrayElems( msg_t *msg, const void *to, const msg_field_t *field, const uint8_t *elemMask, unsigned byteMask ) {
+static void MSG_WriteArrayElems( msg_t *msg, const void *from, const void *to, const msg_field_t *field, const uint8_t *elemMask, unsigned byteMask ) {
 	size_t b;
 	const size_t bytes = MSG_FieldBytes( field );
 	const size_t maxElems = field->count;
+	const uint8_t *bfrom = ( const uint8_t * ) from;
 	const uint8_t *bto = ( const uint8_t * ) to;
 
 	b = 0;
@@ -616,7 +718,7 @@ static void MSG_WriteArrayElems( msg_t *msg, const void *to, const msg_field_t *
 					return;
 
 				if( fm & 1 ) {
-					MSG_WriteField( msg, bto + f * bytes, field );
+					MSG_WriteField( msg, bfrom + f * bytes, bto + f * bytes, field );
 				}
 				f++;
 				fm >>= 1;
@@ -631,8 +733,9 @@ static void MSG_WriteArrayElems( msg_t *msg, const void *to, const msg_field_t *
 /*
 * MSG_ReadArrayElems
 */
-static void MSG_ReadArrayElems( msg_t *msg, void *to, const msg_field_t *field, const uint8_t *elemMask, size_t maskSize, unsigned byteMask ) {
+static void MSG_ReadArrayElems( msg_t *msg, const void *from, void *to, const msg_field_t *field, const uint8_t *elemMask, size_t maskSize, unsigned byteMask ) {
 	size_t b;
+	const uint8_t *bfrom = ( const uint8_t * ) from;
 	uint8_t *bto = ( uint8_t * ) to;
 	const size_t bytes = MSG_FieldBytes( field );
 	const size_t maxElems = field->count;
@@ -655,7 +758,7 @@ static void MSG_ReadArrayElems( msg_t *msg, void *to, const msg_field_t *field,
 				}
 
 				if( fm & 1 ) {
-					MSG_ReadField( msg, bto + fn * bytes, field );
+					MSG_ReadField( msg, bfrom + fn * bytes, bto + fn * bytes, field );
 				}
 
 				fn++;
@@ -692,7 +795,7 @@ static void MSG_WriteDeltaArray( msg_t *msg, const void *from, const void *to, c
 
 	MSG_WriteFieldMask( msg, elemMask, byteMask );
 
-	MSG_WriteArrayElems( msg, to, field, elemMask, byteMask );
+	MSG_WriteArrayElems( msg, from, to, field, elemMask, byteMask );
 }
 
 /*
@@ -722,7 +825,7 @@ static void MSG_ReadDeltaArray( msg_t *msg, const void *from, void *to, const ms
 
 	MSG_ReadFieldMask( msg, elemMask, sizeof( elemMask ), byteMask );
 
-	MSG_ReadArrayElems( msg, to, field, elemMask, sizeof( elemMask ), byteMask );
+	MSG_ReadArrayElems( msg, from, to, field, elemMask, sizeof( elemMask ), byteMask );
 }
 
 /*
@@ -769,6 +872,7 @@ static unsigned MSG_CompareStructs( const void *from, const void *to, const msg_
 */
 static void MSG_WriteStructFields( msg_t *msg, const void *from, const void *to, const msg_field_t *fields, size_t numFields, const uint8_t *fieldMask, unsigned byteMask ) {
 	size_t b;
+	const uint8_t *bfrom = ( const uint8_t * ) from;
 	const uint8_t *bto = ( const uint8_t * ) to;
 
 	b = 0;
@@ -787,7 +891,7 @@ static void MSG_WriteStructFields( msg_t *msg, const void *from, const void *to,
 					if( f->count > 1 ) {
 						MSG_WriteDeltaArray( msg, from, to, f );
 					} else {
-						MSG_WriteField( msg, bto, f );
+						MSG_WriteField( msg, bfrom, bto, f );
 					}
 				}
 				fn++;
@@ -805,6 +909,7 @@ static void MSG_WriteStructFields( msg_t *msg, const void *from, const void *to,
 */
 static void MSG_ReadStructFields( msg_t *msg, const void *from, void *to, const msg_field_t *fields, size_t numFields, const uint8_t *fieldMask, size_t maskSize, unsigned byteMask ) {
 	size_t b;
+	const uint8_t *bfrom = ( const uint8_t * ) from;
 	uint8_t *bto = ( uint8_t * ) to;
 
 	b = 0;
@@ -829,7 +934,7 @@ static void MSG_ReadStructFields( msg_t *msg, const void *from, void *to, const
 					if( f->count > 1 ) {
 						MSG_ReadDeltaArray( msg, from, to, f );
 					} else {
-						MSG_ReadField( msg, bto, f );
+						MSG_ReadField( msg, bfrom, bto, f );
 					}
 				}
 
@@ -906,9 +1011,9 @@ static const msg_field_t ent_state_fields[] = {
 	{ ESOFS( events[0] ), 32, 1, WIRE_UBASE128 },
 	{ ESOFS( eventParms[0] ), 32, 1, WIRE_BASE128 },
 
-	{ ESOFS( origin[0] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( origin[1] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( origin[2] ), 0, 1, WIRE_FLOAT },
+	{ ESOFS( origin[0] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( origin[1] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( origin[2] ), 0, 1, WIRE_QUANT_COORD },
 
 	{ ESOFS( angles[0] ), 0, 1, WIRE_ANGLE },
 	{ ESOFS( angles[1] ), 0, 1, WIRE_ANGLE },
@@ -936,22 +1041,22 @@ static const msg_field_t ent_state_fields[] = {
 	{ ESOFS( radius ), 32, 1, WIRE_UBASE128 },
 	{ ESOFS( team ), 32, 1, WIRE_FIXED_INT8 },
 
-	{ ESOFS( origin2[0] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( origin2[1] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( origin2[2] ), 0, 1, WIRE_FLOAT },
+	{ ESOFS( origin2[0] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( origin2[1] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( origin2[2] ), 0, 1, WIRE_QUANT_COORD },
 
 	{ ESOFS( linearMovementTimeStamp ), 32, 1, WIRE_UBASE128 },
 	{ ESOFS( linearMovement ), 1, 1, WIRE_BOOL },
 	{ ESOFS( linearMovementDuration ), 32, 1, WIRE_UBASE128 },
-	{ ESOFS( linearMovementVelocity[0] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( linearMovementVelocity[1] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( linearMovementVelocity[2] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( linearMovementBegin[0] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( linearMovementBegin[1] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( linearMovementBegin[2] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( linearMovementEnd[0] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( linearMovementEnd[1] ), 0, 1, WIRE_FLOAT },
-	{ ESOFS( linearMovementEnd[2] ), 0, 1, WIRE_FLOAT },
+	{ ESOFS( linearMovementVelocity[0] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( linearMovementVelocity[1] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( linearMovementVelocity[2] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( linearMovementBegin[0] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( linearMovementBegin[1] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( linearMovementBegin[2] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( linearMovementEnd[0] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( linearMovementEnd[1] ), 0, 1, WIRE_QUANT_COORD },
+	{ ESOFS( linearMovementEnd[2] ), 0, 1, WIRE_QUANT_COORD },
 
 	{ ESOFS( itemNum ), 32, 1, WIRE_UBASE128 },
 
@@ -962,6 +1067,35 @@ static const msg_field_t ent_state_fields[] = {
 	{ ESOFS( light ), 32, 1, WIRE_FIXED_INT32 },
 };
 
+/*
+* MSG_PredictLinearOrigin
+*
+* Linear movers have their origin encoded as a delta from where the client
+* will extrapolate them to. The prediction only uses the quantized values the
+* client receives and integer maths so both ends agree exactly.
+*/
+static bool MSG_PredictLinearOrigin( const entity_state_t *state, int64_t serverTime, int32_t *predicted ) {
+	if( serverTime == 0 || !state->linearMovement ) {
+		return false;
+	}
+
+	int64_t moveTime = Max2( serverTime - state->linearMovementTimeStamp, int64_t( 0 ) );
+
+	for( int i = 0; i < 3; i++ ) {
+		int64_t begin = MSG_QuantizeCoord( state->linearMovementBegin[i] );
+		if( state->linearMovementDuration ) {
+			int64_t duration = state->linearMovementDuration;
+			int64_t end = MSG_QuantizeCoord( state->linearMovementEnd[i] );
+			predicted[i] = int32_t( begin + ( end - begin ) * Min2( moveTime, duration ) / duration );
+		} else {
+			int64_t velocity = MSG_QuantizeCoord( state->linearMovementVelocity[i] );
+			predicted[i] = int32_t( Clamp( int64_t( -COORD_QUANT_MAX ), begin + velocity * moveTime / 1000, int64_t( COORD_QUANT_MAX ) ) );
+		}
+	}
+
+	return true;
+}
+
 /*
 * MSG_WriteEntityNumber
 */
@@ -976,7 +1110,7 @@ static void MSG_WriteEntityNumber( msg_t *msg, int number, bool remove, unsigned
 * Writes part of a packetentities message.
 * Can delta from either a baseline or a previous packet_entity
 */
-void MSG_WriteDeltaEntity( msg_t *msg, const entity_state_t *from, const entity_state_t *to, bool force ) {
+void MSG_WriteDeltaEntity( msg_t *msg, const entity_state_t *from, const entity_state_t *to, bool force, int64_t serverTime ) {
 	int number;
 	unsigned byteMask;
 	uint8_t fieldMask[32] = { 0 };
@@ -1020,7 +1154,17 @@ void MSG_WriteDeltaEntity( msg_t *msg, const entity_state_t *from, const entity_
 
 	MSG_WriteFieldMask( msg, fieldMask, byteMask );
 
-	MSG_WriteStructFields( msg, from, to, fields, numFields, fieldMask, byteMask );
+	// changes are detected against the previous state but linear movers
+	// encode their origin against the predicted position instead
+	entity_state_t base = *from;
+	int32_t predicted[3];
+	if( MSG_PredictLinearOrigin( to, serverTime, predicted ) ) {
+		for( int i = 0; i < 3; i++ ) {
+			base.origin[i] = MSG_DequantizeCoord( predicted[i] );
+		}
+	}
+
+	MSG_WriteStructFields( msg, &base, to, fields, numFields, fieldMask, byteMask );
 }
 
 /*
@@ -1044,7 +1188,7 @@ int MSG_ReadEntityNumber( msg_t *msg, bool *remove, unsigned *byteMask ) {
 *
 * Can go from either a baseline or a previous packet_entity
 */
-void MSG_ReadDeltaEntity( msg_t *msg, const entity_state_t *from, entity_state_t *to, int number, unsigned byteMask ) {
+void MSG_ReadDeltaEntity( msg_t *msg, const entity_state_t *from, entity_state_t *to, int number, unsigned byteMask, int64_t serverTime ) {
 	uint8_t fieldMask[32] = { 0 };
 	const msg_field_t *fields = ent_state_fields;
 	int numFields = ARRAY_COUNT( ent_state_fields );
@@ -1056,6 +1200,21 @@ void MSG_ReadDeltaEntity( msg_t *msg, const entity_state_t *from, entity_state_t
 	MSG_ReadFieldMask( msg, fieldMask, sizeof( fieldMask ), byteMask );
 
 	MSG_ReadStructFields( msg, from, to, fields, numFields, fieldMask, sizeof( fieldMask ), byteMask );
+
+	// the origin was read relative to the previous state, but the linear
+	// movement fields come later on the wire so rebase it on the prediction now
+	int32_t predicted[3];
+	if( MSG_PredictLinearOrigin( to, serverTime, predicted ) ) {
+		for( int i = 0; i < numFields; i++ ) {
+			for( int j = 0; j < 3; j++ ) {
+				if( fields[i].offset != int( ESOFS( origin ) + j * sizeof( float ) ) || ( fieldMask[i >> 3] & ( 1 << ( i & 7 ) ) ) == 0 ) {
+					continue;
+				}
+				int32_t delta = MSG_QuantizeCoord( to->origin[j] ) - MSG_QuantizeCoord( from->origin[j] );
+				to->origin[j] = MSG_DequantizeCoord( predicted[j] + delta );
+			}
+		}
+	}
 }
 
 //==================================================
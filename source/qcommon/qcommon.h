@@ -56,6 +56,12 @@ typedef struct {
 	size_t cursize;
 	size_t readcount;
 	bool compressed;
+
+	// bit packing state, the partially filled byte is data[bitbyte - 1]
+	size_t writebitbyte;
+	int writebits;
+	size_t readbitbyte;
+	int readbits;
 } msg_t;
 
 typedef struct msg_field_s {
@@ -89,9 +95,10 @@ void MSG_WriteIntBase128( msg_t *msg, int64_t c );
 void MSG_WriteFloat( msg_t *sb, float f );
 void MSG_WriteHalfFloat( msg_t *sb, float f );
 void MSG_WriteString( msg_t *sb, const char *s );
+void MSG_WriteBits( msg_t *msg, uint32_t value, int bits );
 #define MSG_WriteAngle16( sb, f ) ( MSG_WriteInt16( ( sb ), ANGLE2SHORT( ( f ) ) ) )
 void MSG_WriteDeltaUsercmd( msg_t *sb, const struct usercmd_s *from, struct usercmd_s *cmd );
-void MSG_WriteDeltaEntity( msg_t *msg, const struct entity_state_s *from, const struct entity_state_s *to, bool force );
+void MSG_WriteDeltaEntity( msg_t *msg, const struct entity_state_s *from, const struct entity_state_s *to, bool force, int64_t serverTime );
 void MSG_WriteDeltaPlayerState( msg_t *msg, const player_state_t *ops, const player_state_t *ps );
 void MSG_WriteDeltaGameState( msg_t *msg, const game_state_t *from, const game_state_t *to );
 void MSG_WriteDir( msg_t *sb, vec3_t vector );
@@ -110,10 +117,11 @@ float MSG_ReadFloat( msg_t *sb );
 float MSG_ReadHalfFloat( msg_t *sb );
 char *MSG_ReadString( msg_t *sb );
 char *MSG_ReadStringLine( msg_t *sb );
+uint32_t MSG_ReadBits( msg_t *msg, int bits );
 #define MSG_ReadAngle16( sb ) ( SHORT2ANGLE( MSG_ReadInt16( ( sb ) ) ) )
 void MSG_ReadDeltaUsercmd( msg_t *sb, const struct usercmd_s *from, struct usercmd_s *cmd );
 int MSG_ReadEntityNumber( msg_t *msg, bool *remove, unsigned *byteMask );
-void MSG_ReadDeltaEntity( msg_t *msg, const entity_state_t *from, entity_state_t *to, int number, unsigned byteMask );
+void MSG_ReadDeltaEntity( msg_t *msg, const entity_state_t *from, entity_state_t *to, int number, unsigned byteMask, int64_t serverTime );
 void MSG_ReadDeltaPlayerState( msg_t *msg, const player_state_t *ops, player_state_t *ps );
 void MSG_ReadDeltaGameState( msg_t *msg, const game_state_t *from, game_state_t *to );
 void MSG_ReadDir( msg_t *sb, vec3_t vector );
@@ -377,6 +385,11 @@ NET
 #define FRAGMENT_LAST       (    1 << 14 )
 #define FRAGMENT_BIT            ( 1 << 31 )
 
+// server downloads are sent in blocks aligned to DOWNLOAD_BLOCK_SIZE, with up to
+// DOWNLOAD_MAX_WINDOW blocks in flight, which is also the width of the selective ack mask
+#define DOWNLOAD_BLOCK_SIZE     ( FRAGMENT_SIZE * 2 )
+#define DOWNLOAD_MAX_WINDOW     32
+
 typedef enum {
 	NA_NOTRANSMIT,      // wsw : jal : fakeclients
 	NA_LOOPBACK,
@@ -602,6 +615,7 @@ int     FS_Eof( int file );
 int     FS_Flush( int file );
 bool    FS_IsUrl( const char *url );
 int     FS_FileNo( int file, size_t *offset );
+const void *FS_FileView( int file );
 
 void    FS_SetCompressionLevel( int file, int level );
 int     FS_GetCompressionLevel( int file );
@@ -647,6 +661,21 @@ int         FS_GetFileListExt( const char *dir, const char *extension, char *buf
 
 // // only for base files
 bool    FS_IsPakValid( const char *filename, unsigned *checksum );
+
+typedef struct {
+	const char *name;
+	bool deflated;
+	bool directory;
+	unsigned compressedSize;
+	unsigned uncompressedSize;
+	unsigned offset;
+	const void *data;   // compressed bytes in the mapped pak, NULL if it isn't mapped
+} fs_pakentry_t;
+
+// for tools that check the pak index, packfilename is absolute
+bool    FS_InspectPakFile( const char *packfilename, unsigned *checksum, bool *indexed,
+						   void ( *callback )( const fs_pakentry_t *entry, void *data ), void *data );
+void    FS_PK3IndexName( const char *packfilename, char *buf, size_t buf_size );
 bool    FS_AddPurePak( unsigned checksum );
 void    FS_RemovePurePaks( void );
 
@@ -59,3 +59,17 @@ void QBufPipe_Wait( qbufPipe_t *queue, int ( *read )( qbufPipe_t *, unsigned( **
 
 int QAtomic_FetchAdd( volatile int *value, int add );
 bool QAtomic_CAS( volatile int *value, int oldval, int newval );
+
+// job system: a fixed pool of workers, each with its own deque that idle workers steal from.
+// counters are plain ints that Submit increments and the job decrements when it's done, so
+// several jobs can share one counter and anything can wait on it. waiting runs other jobs
+// instead of blocking, so jobs may submit and wait on jobs of their own
+typedef void ( *qjobfunc_t )( void *data );
+
+void QJobs_Init( int num_workers = 0 );
+void QJobs_Shutdown( void );
+int QJobs_NumWorkers( void );
+
+void QJob_Submit( qjobfunc_t func, void *data, volatile int *counter );
+void QJob_Wait( volatile int *counter );
+void QJob_ParallelFor( int count, int batch, void ( *func )( void *data, int begin, int end ), void *data );
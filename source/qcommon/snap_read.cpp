@@ -86,7 +86,7 @@ static void SNAP_ParseDeltaEntity( msg_t *msg, snapshot_t *frame, int newnum, en
 
 	state = &frame->parsedEntities[frame->numEntities & ( MAX_PARSE_ENTITIES - 1 )];
 	frame->numEntities++;
-	MSG_ReadDeltaEntity( msg, old, state, newnum, byteMask );
+	MSG_ReadDeltaEntity( msg, old, state, newnum, byteMask, frame->serverTime );
 }
 
 /*
@@ -107,7 +107,7 @@ void SNAP_ParseBaseline( msg_t *msg, entity_state_t *baselines ) {
 		memset( &nullstate, 0, sizeof( nullstate ) );
 
 		es = ( baselines ? &baselines[newnum] : &tmp );
-		MSG_ReadDeltaEntity( msg, &nullstate, es, newnum, byteMask );
+		MSG_ReadDeltaEntity( msg, &nullstate, es, newnum, byteMask, 0 );
 	}
 }
 
@@ -34,7 +34,7 @@ Encode a client frame onto the network channel
 *
 * Writes a delta update of an entity_state_t list to the message.
 */
-static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, client_snapshot_t *to, msg_t *msg, entity_state_t *baselines, entity_state_t *client_entities, int num_client_entities ) {
+static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, client_snapshot_t *to, msg_t *msg, int64_t gameTime, entity_state_t *baselines, entity_state_t *client_entities, int num_client_entities ) {
 	entity_state_t *oldent, *newent;
 	int oldindex, newindex;
 	int oldnum, newnum;
@@ -73,7 +73,7 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 			// in any bytes being emited if the entity has not changed at all
 			// note that players are always 'newentities', this updates their oldorigin always
 			// and prevents warping ( wsw : jal : I removed it from the players )
-			MSG_WriteDeltaEntity( msg, oldent, newent, false );
+			MSG_WriteDeltaEntity( msg, oldent, newent, false, gameTime );
 			oldindex++;
 			newindex++;
 			continue;
@@ -81,14 +81,14 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 
 		if( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( msg, &baselines[newnum], newent, true );
+			MSG_WriteDeltaEntity( msg, &baselines[newnum], newent, true, gameTime );
 			newindex++;
 			continue;
 		}
 
 		if( newnum > oldnum ) {
 			// the old entity isn't present in the new message
-			MSG_WriteDeltaEntity( msg, oldent, NULL, false );
+			MSG_WriteDeltaEntity( msg, oldent, NULL, false, gameTime );
 			oldindex++;
 			continue;
 		}
@@ -375,7 +375,7 @@ void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, int
 	MSG_WriteUint8( msg, 0 );
 
 	// delta encode the entities
-	SNAP_EmitPacketEntities( gi, oldframe, frame, msg, baselines, client_entities ? client_entities->entities : NULL, client_entities ? client_entities->num_entities : 0 );
+	SNAP_EmitPacketEntities( gi, oldframe, frame, msg, gameTime, baselines, client_entities ? client_entities->entities : NULL, client_entities ? client_entities->num_entities : 0 );
 
 	// write length into reserved space
 	length = msg->cursize - pos - 2;
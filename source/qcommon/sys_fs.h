@@ -34,3 +34,8 @@ void        *Sys_FS_LockFile( const char *path );
 void        Sys_FS_UnlockFile( void *handle );
 
 int         Sys_FS_FileNo( FILE *fp );
+
+time_t      Sys_FS_FileMTime( const char *filename );
+
+void        *Sys_FS_MMapFile( const char *path, size_t *size );
+void        Sys_FS_UnMMapFile( void *mapping, size_t size );
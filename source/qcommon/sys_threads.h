@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 int Sys_Thread_Create( qthread_t **pthread, void *( *routine )( void* ), void *param );
 void Sys_Thread_Join( qthread_t *thread );
 void Sys_Thread_Yield( void );
+int Sys_Thread_NumProcessors( void );
 
 int Sys_Mutex_Create( qmutex_t **pmutex );
 void Sys_Mutex_Destroy( qmutex_t *mutex );
@@ -21,6 +21,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "qcommon.h"
 #include "sys_threads.h"
 
+#include <atomic>
+#include <new>
+
 /*
 * QMutex_Create
 */
@@ -133,12 +136,14 @@ void QThread_Yield( void ) {
 * QThreads_Init
 */
 void QThreads_Init( void ) {
+	QJobs_Init();
 }
 
 /*
 * QThreads_Shutdown
 */
 void QThreads_Shutdown( void ) {
+	QJobs_Shutdown();
 }
 
 // ============================================================================
@@ -159,12 +164,35 @@ bool QAtomic_CAS( volatile int *value, int oldval, int newval ) {
 
 // ============================================================================
 
+/*
+* QBufPipe is a single producer, single consumer ring of variable sized
+* commands. The writer and the reader each own a position in the ring and
+* publish how many bytes they've written or consumed, so neither side takes a
+* lock to move commands. The reader only sleeps on the condition variable
+* when the pipe is empty, and the writer only takes the mutex to wake it when
+* it says it's asleep.
+*
+* A command that doesn't fit before the end of the buffer is preceded by a
+* -1 marker (or nothing, if there isn't room for one) and written at the start.
+*/
+
+#define QBUFPIPE_CACHE_LINE 64
+
 struct qbufPipe_s {
-	int blockWrite;
-	volatile int terminated;
+	// written by the producer
+	std::atomic< unsigned > written;
 	unsigned write_pos;
+	unsigned consumed_cache;        // last value of consumed seen by the producer
+	char pad0[QBUFPIPE_CACHE_LINE];
+
+	// written by the consumer
+	std::atomic< unsigned > consumed;
 	unsigned read_pos;
-	volatile int cmdbuf_len;
+	std::atomic< int > sleeping;
+	char pad1[QBUFPIPE_CACHE_LINE];
+
+	std::atomic< int > terminated;
+	int blockWrite;
 	size_t bufSize;
 	qcondvar_t *nonempty_condvar;
 	qmutex_t *nonempty_mutex;
@@ -175,8 +203,14 @@ struct qbufPipe_s {
 * QBufPipe_Create
 */
 qbufPipe_t *QBufPipe_Create( size_t bufSize, int flags ) {
-	qbufPipe_t *pipe = ( qbufPipe_t * ) malloc( sizeof( *pipe ) + bufSize );
-	memset( pipe, 0, sizeof( *pipe ) );
+	qbufPipe_t *pipe = new( malloc( sizeof( *pipe ) + bufSize ) ) qbufPipe_t();
+	pipe->written = 0;
+	pipe->write_pos = 0;
+	pipe->consumed_cache = 0;
+	pipe->consumed = 0;
+	pipe->read_pos = 0;
+	pipe->sleeping = 0;
+	pipe->terminated = 0;
 	pipe->blockWrite = flags & 1;
 	pipe->buf = (char *)( pipe + 1 );
 	pipe->bufSize = bufSize;
@@ -201,61 +235,72 @@ void QBufPipe_Destroy( qbufPipe_t **ppipe ) {
 
 	QMutex_Destroy( &pipe->nonempty_mutex );
 	QCondVar_Destroy( &pipe->nonempty_condvar );
+	pipe->~qbufPipe_t();
 	free( pipe );
 }
 
 /*
-* QBufPipe_Wake
-*
-* Signals the waiting thread to wake up.
+* QBufPipe_IsEmpty
 */
-static void QBufPipe_Wake( qbufPipe_t *pipe ) {
-	QCondVar_Wake( pipe->nonempty_condvar );
+static bool QBufPipe_IsEmpty( qbufPipe_t *pipe ) {
+	return pipe->written.load( std::memory_order_acquire ) == pipe->consumed.load( std::memory_order_acquire );
 }
 
 /*
-* QBufPipe_Finish
+* QBufPipe_Wake
 *
-* Blocks until the reader thread handles all commands
-* or terminates with an error.
+* Signals the reader to wake up if it's waiting for commands.
 */
-void QBufPipe_Finish( qbufPipe_t *pipe ) {
-	while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0 ) == false && !pipe->terminated ) {
+static void QBufPipe_Wake( qbufPipe_t *pipe ) {
+	// written and sleeping are both stored and loaded seq_cst, so either we
+	// see the reader going to sleep or it sees what we wrote before it does.
+	// clear the flag so we only wake it once until it sleeps again
+	if( pipe->sleeping.load( std::memory_order_seq_cst ) && pipe->sleeping.exchange( 0 ) ) {
 		QMutex_Lock( pipe->nonempty_mutex );
-		QBufPipe_Wake( pipe );
+		QCondVar_Wake( pipe->nonempty_condvar );
 		QMutex_Unlock( pipe->nonempty_mutex );
-		QThread_Yield();
 	}
 }
 
 /*
-* QBufPipe_AllocCmd
+* QBufPipe_Sleep
+*
+* Blocks the reader until the writer publishes something.
 */
-static void *QBufPipe_AllocCmd( qbufPipe_t *pipe, unsigned cmd_size ) {
-	void *buf = &pipe->buf[pipe->write_pos];
-	pipe->write_pos += cmd_size;
-	return buf;
+static void QBufPipe_Sleep( qbufPipe_t *pipe ) {
+	QMutex_Lock( pipe->nonempty_mutex );
+	pipe->sleeping.store( 1, std::memory_order_seq_cst );
+	if( pipe->written.load( std::memory_order_seq_cst ) == pipe->consumed.load( std::memory_order_relaxed ) && !pipe->terminated ) {
+		QCondVar_Wait( pipe->nonempty_condvar, pipe->nonempty_mutex );
+	}
+	pipe->sleeping.store( 0, std::memory_order_relaxed );
+	QMutex_Unlock( pipe->nonempty_mutex );
 }
 
 /*
-* QBufPipe_BufLenAdd
+* QBufPipe_Finish
+*
+* Blocks until the reader thread handles all commands
+* or terminates with an error.
 */
-static void QBufPipe_BufLenAdd( qbufPipe_t *pipe, int val ) {
-	Sys_Atomic_FetchAdd( &pipe->cmdbuf_len, val );
+void QBufPipe_Finish( qbufPipe_t *pipe ) {
+	while( !QBufPipe_IsEmpty( pipe ) && !pipe->terminated ) {
+		QBufPipe_Wake( pipe );
+		QThread_Yield();
+	}
 }
 
 /*
 * QBufPipe_WriteCmd
 *
 * Add new command to buffer. Never allow the distance between the reader
-* and the writer to grow beyond the size of the buffer.
-*
-* Note that there are race conditions here but in the worst case we're going
-* to erroneously drop cmd's instead of stepping on the reader's toes.
+* and the writer to grow beyond the size of the buffer, either wait for the
+* reader or drop the command depending on how the pipe was created.
 */
 void QBufPipe_WriteCmd( qbufPipe_t *pipe, const void *pcmd, unsigned cmd_size ) {
-	void *buf;
-	unsigned write_remains;
+	unsigned write_remains, skip;
+	unsigned written;
+	bool wrap;
 
 	if( !pipe ) {
 		return;
@@ -264,60 +309,40 @@ void QBufPipe_WriteCmd( qbufPipe_t *pipe, const void *pcmd, unsigned cmd_size )
 		return;
 	}
 
-	assert( pipe->bufSize >= pipe->write_pos );
-	if( pipe->bufSize < pipe->write_pos ) {
-		pipe->write_pos = 0;
-	}
+	assert( cmd_size <= pipe->bufSize );
 
+	// wrap around if the command doesn't fit before the end of the buffer
 	write_remains = pipe->bufSize - pipe->write_pos;
-
-	if( sizeof( int ) > write_remains ) {
-		while( pipe->cmdbuf_len + cmd_size + write_remains > pipe->bufSize ) {
-			if( pipe->blockWrite ) {
-				QThread_Yield();
-				continue;
-			}
-			return;
+	wrap = sizeof( int ) > write_remains || cmd_size > write_remains;
+	skip = wrap ? write_remains : 0;
+
+	// only look at the reader's cache line when the pipe seems full
+	written = pipe->written.load( std::memory_order_relaxed );
+	while( written - pipe->consumed_cache + skip + cmd_size > pipe->bufSize ) {
+		unsigned consumed = pipe->consumed.load( std::memory_order_acquire );
+		if( consumed != pipe->consumed_cache ) {
+			pipe->consumed_cache = consumed;
+			continue;
 		}
-
-		// not enough space to enpipe even the reset cmd, rewind
-		QBufPipe_BufLenAdd( pipe, write_remains ); // atomic
-		pipe->write_pos = 0;
-	} else if( cmd_size > write_remains ) {
-		int *cmd;
-
-		while( pipe->cmdbuf_len + sizeof( int ) + cmd_size + write_remains > pipe->bufSize ) {
-			if( pipe->blockWrite ) {
-				QThread_Yield();
-				continue;
-			}
+		if( !pipe->blockWrite || pipe->terminated ) {
 			return;
 		}
+		QThread_Yield();
+	}
 
-		// explicit pointer reset cmd
-		cmd = ( int * ) QBufPipe_AllocCmd( pipe, sizeof( int ) );
-		*cmd = -1;
-
-		QBufPipe_BufLenAdd( pipe, sizeof( *cmd ) + write_remains ); // atomic
-		pipe->write_pos = 0;
-	} else {
-		while( pipe->cmdbuf_len + cmd_size > pipe->bufSize ) {
-			if( pipe->blockWrite ) {
-				QThread_Yield();
-				continue;
-			}
-			return;
+	if( wrap ) {
+		if( skip >= sizeof( int ) ) {
+			// explicit pointer reset cmd
+			*( (int *)( pipe->buf + pipe->write_pos ) ) = -1;
 		}
+		pipe->write_pos = 0;
 	}
 
-	buf = QBufPipe_AllocCmd( pipe, cmd_size );
-	memcpy( buf, pcmd, cmd_size );
-	QBufPipe_BufLenAdd( pipe, cmd_size ); // atomic
+	memcpy( pipe->buf + pipe->write_pos, pcmd, cmd_size );
+	pipe->write_pos += cmd_size;
+	pipe->written.store( written + skip + cmd_size, std::memory_order_seq_cst );
 
-	// wake the other thread waiting for signal
-	QMutex_Lock( pipe->nonempty_mutex );
 	QBufPipe_Wake( pipe );
-	QMutex_Unlock( pipe->nonempty_mutex );
 }
 
 /*
@@ -330,29 +355,31 @@ int QBufPipe_ReadCmds( qbufPipe_t *pipe, unsigned( **cmdHandlers )( const void *
 		return -1;
 	}
 
-	while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0 ) == false && !pipe->terminated ) {
-		assert( pipe->bufSize >= pipe->read_pos );
-		if( pipe->bufSize < pipe->read_pos ) {
-			pipe->read_pos = 0;
+	unsigned consumed = pipe->consumed.load( std::memory_order_relaxed );
+	unsigned written = pipe->written.load( std::memory_order_acquire );
+
+	while( !pipe->terminated ) {
+		if( consumed == written ) {
+			// pick up anything written while we were busy
+			written = pipe->written.load( std::memory_order_acquire );
+			if( consumed == written ) {
+				break;
+			}
 		}
 
+		assert( pipe->bufSize >= pipe->read_pos );
 		size_t read_remains = pipe->bufSize - pipe->read_pos;
 
-		if( sizeof( int ) > read_remains ) {
-			// implicit reset
-			pipe->read_pos = 0;
-			QBufPipe_BufLenAdd( pipe, -read_remains );
-		}
-
-		int cmd = *( (int *)( pipe->buf + pipe->read_pos ) );
-		if( cmd == -1 ) {
-			// this cmd is special
+		if( sizeof( int ) > read_remains || *( (int *)( pipe->buf + pipe->read_pos ) ) == -1 ) {
+			// reset to the start of the buffer
 			pipe->read_pos = 0;
-			QBufPipe_BufLenAdd( pipe, -( (int)( sizeof( int ) + read_remains ) ) ); // atomic
+			consumed += read_remains;
+			pipe->consumed.store( consumed, std::memory_order_release );
 			continue;
 		}
 
-		int cmd_size = cmdHandlers[cmd]( pipe->buf + pipe->read_pos );
+		int cmd = *( (int *)( pipe->buf + pipe->read_pos ) );
+		unsigned cmd_size = cmdHandlers[cmd]( pipe->buf + pipe->read_pos );
 		read++;
 
 		if( !cmd_size ) {
@@ -360,14 +387,15 @@ int QBufPipe_ReadCmds( qbufPipe_t *pipe, unsigned( **cmdHandlers )( const void *
 			return -1;
 		}
 
-		if( cmd_size > pipe->cmdbuf_len ) {
+		if( cmd_size > written - consumed ) {
 			assert( 0 );
 			pipe->terminated = 1;
 			return -1;
 		}
 
 		pipe->read_pos += cmd_size;
-		QBufPipe_BufLenAdd( pipe, -cmd_size ); // atomic
+		consumed += cmd_size;
+		pipe->consumed.store( consumed, std::memory_order_release );
 	}
 
 	return read;
@@ -379,18 +407,10 @@ int QBufPipe_ReadCmds( qbufPipe_t *pipe, unsigned( **cmdHandlers )( const void *
 void QBufPipe_Wait( qbufPipe_t *pipe, int ( *read )( qbufPipe_t *, unsigned( ** )( const void * ) ),
 					unsigned( **cmdHandlers )( const void * ) ) {
 	while( !pipe->terminated ) {
-		while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0 ) == true ) {
-			QMutex_Lock( pipe->nonempty_mutex );
-
-			QCondVar_Wait( pipe->nonempty_condvar, pipe->nonempty_mutex );
-
-			// don't hold the mutex, changes to cmdbuf_len are atomic anyway
-			QMutex_Unlock( pipe->nonempty_mutex );
-			break;
+		if( QBufPipe_IsEmpty( pipe ) ) {
+			QBufPipe_Sleep( pipe );
 		}
 
-		// we're guaranteed at this point that either cmdbuf_len is > 0
-		// or that waiting on the condition variable has timed out
 		int res = read( pipe, cmdHandlers );
 		if( res < 0 ) {
 			// done
@@ -102,6 +102,14 @@ typedef struct {
 	int size;               // total bytes (can't use EOF because of paks)
 	int64_t timeout;   // so we can free the file being downloaded
 	                        // if client omits sending success or failure message
+	int filepos;            // so blocks read in order don't seek
+
+	// windowed downloads, see SV_SendDownloads
+	int window;             // blocks in flight, 0 for clients asking for one block at a time
+	int acked;              // bytes the client has written so far
+	unsigned sack;          // bit i is set when the client holds block acked / DOWNLOAD_BLOCK_SIZE + i
+	int sentblock[DOWNLOAD_MAX_WINDOW];     // indexed by block % DOWNLOAD_MAX_WINDOW
+	int64_t senttime[DOWNLOAD_MAX_WINDOW];
 } client_download_t;
 
 typedef struct {
@@ -236,6 +244,13 @@ typedef struct {
 	purelist_t *purelist;               // pure file support
 
 	cmodel_state_t *cms;                // passed to CM-functions
+
+	int frame_count;                    // game frames timed since the last framestats
+	uint64_t frame_usec;
+	uint64_t frame_max_usec;
+
+	int64_t download_budget;            // bytes SV_SendDownloads may still send, see sv_uploads_rate
+	int download_next;                  // client served first next time, so nobody is always last
 } server_static_t;
 
 typedef struct {
@@ -291,6 +306,7 @@ extern cvar_t *sv_uploads_http;
 extern cvar_t *sv_uploads_baseurl;
 extern cvar_t *sv_uploads_demos;
 extern cvar_t *sv_uploads_demos_baseurl;
+extern cvar_t *sv_uploads_rate;
 
 extern cvar_t *sv_pure;
 extern cvar_t *sv_pure_forcemodulepk3;
@@ -326,6 +342,9 @@ void SV_UpdateActivity( void );
 // sv_oob.c
 //
 void SV_ConnectionlessPacket( const socket_t *socket, const netadr_t *address, msg_t *msg );
+void SV_InvalidateInfoStrings( void );
+void SV_ResetOutOfBandRates( void );
+void SV_OutOfBandStats_f( void );
 void SV_InitMaster( void );
 void SV_UpdateMaster( void );
 
@@ -399,9 +418,11 @@ void SV_DropClient( client_t *drop, int type, const char *format, ... ) __attrib
 void SV_DropClient( client_t *drop, int type, _Printf_format_string_ const char *format, ... );
 #endif
 
+bool SV_PeekClientThink( int clientNum, usercmd_t *ucmd );
 void SV_ExecuteClientThinks( int clientNum );
 void SV_ClientResetCommandBuffers( client_t *client );
 void SV_ClientCloseDownload( client_t *client );
+void SV_SendDownloads( unsigned msec );
 
 //
 // sv_ccmds.c
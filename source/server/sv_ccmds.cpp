@@ -224,6 +224,24 @@ static void SV_Serverinfo_f( void ) {
 	Info_Print( Cvar_Serverinfo() );
 }
 
+/*
+* SV_FrameStats_f
+* Print how long game frames took since the last call and reset the counters
+*/
+static void SV_FrameStats_f( void ) {
+	if( !svs.frame_count ) {
+		Com_Printf( "framestats: no frames\n" );
+		return;
+	}
+
+	Com_Printf( "framestats: frames %i avg %.3f max %.3f ms\n", svs.frame_count,
+		svs.frame_usec / ( svs.frame_count * 1000.0 ), svs.frame_max_usec / 1000.0 );
+
+	svs.frame_count = 0;
+	svs.frame_usec = 0;
+	svs.frame_max_usec = 0;
+}
+
 /*
 * SV_DumpUser_f
 * Examine all a users info strings
@@ -304,6 +322,8 @@ void SV_InitOperatorCommands( void ) {
 	Cmd_AddCommand( "heartbeat", SV_Heartbeat_f );
 	Cmd_AddCommand( "status", SV_Status_f );
 	Cmd_AddCommand( "serverinfo", SV_Serverinfo_f );
+	Cmd_AddCommand( "framestats", SV_FrameStats_f );
+	Cmd_AddCommand( "oobstats", SV_OutOfBandStats_f );
 	Cmd_AddCommand( "dumpuser", SV_DumpUser_f );
 
 	Cmd_AddCommand( "map", SV_Map_f );
@@ -332,6 +352,8 @@ void SV_ShutdownOperatorCommands( void ) {
 	Cmd_RemoveCommand( "heartbeat" );
 	Cmd_RemoveCommand( "status" );
 	Cmd_RemoveCommand( "serverinfo" );
+	Cmd_RemoveCommand( "framestats" );
+	Cmd_RemoveCommand( "oobstats" );
 	Cmd_RemoveCommand( "dumpuser" );
 
 	Cmd_RemoveCommand( "map" );
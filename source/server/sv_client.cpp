@@ -198,6 +198,8 @@ void SV_DropClient( client_t *drop, int type, const char *format, ... ) {
 
 	drop->state = CS_ZOMBIE;    // become free in a few seconds
 	drop->name[0] = 0;
+
+	SV_InvalidateInfoStrings();
 }
 
 
@@ -390,7 +392,7 @@ static void SV_Baselines_f( client_t *client ) {
 		base = &sv.baselines[start];
 		if( base->modelindex || base->sound || base->effects ) {
 			MSG_WriteUint8( &tmpMessage, svc_spawnbaseline );
-			MSG_WriteDeltaEntity( &tmpMessage, &nullstate, base, true );
+			MSG_WriteDeltaEntity( &tmpMessage, &nullstate, base, true, 0 );
 		}
 		start++;
 	}
@@ -439,15 +441,49 @@ static void SV_Begin_f( client_t *client ) {
 //=============================================================================
 
 
+/*
+* SV_SendDownloadBlock
+*
+* Sends len bytes of the download starting at offset in an unreliable message
+*/
+static void SV_SendDownloadBlock( client_t *client, int offset, int len ) {
+	uint8_t data[DOWNLOAD_BLOCK_SIZE];
+
+	assert( len >= 0 && len <= DOWNLOAD_BLOCK_SIZE );
+
+	if( len > 0 ) {
+		if( client->download.filepos != offset ) {
+			FS_Seek( client->download.file, offset, FS_SEEK_SET );
+		}
+		len = Max2( FS_Read( data, len, client->download.file ), 0 );
+		client->download.filepos = offset + len;
+	}
+
+	SV_InitClientMessage( client, &tmpMessage, NULL, 0 );
+	SV_AddReliableCommandsToMessage( client, &tmpMessage );
+
+	MSG_WriteUint8( &tmpMessage, svc_download );
+	MSG_WriteString( &tmpMessage, client->download.name );
+	MSG_WriteInt32( &tmpMessage, offset );
+	MSG_WriteInt32( &tmpMessage, len );
+	if( len > 0 ) {
+		MSG_CopyData( &tmpMessage, data, len );
+	}
+	SV_SendMessageToClient( client, &tmpMessage );
+
+	svs.download_budget -= len;
+}
+
 /*
 * SV_NextDownload_f
 *
-* Responds to reliable nextdl packet with unreliable download packet
+* Responds to reliable nextdl packet. "nextdl name offset" asks for one
+* block at offset, which is sent right away. "nextdl name offset window sack"
+* acknowledges everything before offset plus the blocks set in the hex sack
+* mask, and lets SV_SendDownloads keep window blocks in flight.
 * If nextdl packet's offet information is negative, download will be stopped
 */
 static void SV_NextDownload_f( client_t *client ) {
-	uint8_t data[FRAGMENT_SIZE * 2];
-
 	if( !client->download.name ) {
 		Com_Printf( "nextdl message for client with no download active, from: %s\n", client->name );
 		return;
@@ -486,37 +522,102 @@ static void SV_NextDownload_f( client_t *client ) {
 			SV_ClientCloseDownload( client );
 			return;
 		}
+		client->download.filepos = 0;
 	}
 
-	SV_InitClientMessage( client, &tmpMessage, NULL, 0 );
-	SV_AddReliableCommandsToMessage( client, &tmpMessage );
+	client->download.timeout = svs.realtime + 10000;
 
-	int blocksize = client->download.size - offset;
-	if( blocksize > sizeof( data ) ) {
-		blocksize = sizeof( data );
-	}
-	if( offset + blocksize > client->download.size ) {
-		blocksize = client->download.size - offset;
-	}
-	if( blocksize < 0 ) {
-		blocksize = 0;
+	if( Cmd_Argc() < 5 ) {
+		client->download.window = 0;
+		SV_SendDownloadBlock( client, offset, Min2( client->download.size - offset, DOWNLOAD_BLOCK_SIZE ) );
+		return;
 	}
 
-	if( blocksize > 0 ) {
-		FS_Seek( client->download.file, offset, FS_SEEK_SET );
-		blocksize = FS_Read( data, blocksize, client->download.file );
+	if( !client->download.window ) {
+		for( int i = 0; i < DOWNLOAD_MAX_WINDOW; i++ ) {
+			client->download.sentblock[i] = -1;
+		}
 	}
 
-	MSG_WriteUint8( &tmpMessage, svc_download );
-	MSG_WriteString( &tmpMessage, client->download.name );
-	MSG_WriteInt32( &tmpMessage, offset );
-	MSG_WriteInt32( &tmpMessage, blocksize );
-	if( blocksize > 0 ) {
-		MSG_CopyData( &tmpMessage, data, blocksize );
+	client->download.window = Clamp( 1, atoi( Cmd_Argv( 3 ) ), DOWNLOAD_MAX_WINDOW );
+	client->download.acked = offset;
+	client->download.sack = strtoul( Cmd_Argv( 4 ), NULL, 16 );
+}
+
+#define DOWNLOAD_MIN_RTO 200
+
+/*
+* SV_NextDownloadBlock
+*
+* Returns the first block in the client's window that it doesn't hold and
+* that hasn't been sent within the retransmit timeout, or -1
+*/
+static int SV_NextDownloadBlock( client_t *client ) {
+	client_download_t *dl = &client->download;
+	int base = dl->acked / DOWNLOAD_BLOCK_SIZE;
+	int64_t rto = Max2( DOWNLOAD_MIN_RTO, client->ping * 2 );
+
+	for( int i = 0; i < dl->window; i++ ) {
+		int block = base + i;
+		if( (int64_t)block * DOWNLOAD_BLOCK_SIZE >= dl->size ) {
+			break;
+		}
+		if( dl->sack & ( 1u << i ) ) {
+			continue;
+		}
+
+		int slot = block % DOWNLOAD_MAX_WINDOW;
+		if( dl->sentblock[slot] != block || svs.realtime - dl->senttime[slot] >= rto ) {
+			return block;
+		}
 	}
-	SV_SendMessageToClient( client, &tmpMessage );
 
-	client->download.timeout = svs.realtime + 10000;
+	return -1;
+}
+
+/*
+* SV_SendDownloads
+*
+* Sends windowed download blocks, at most sv_uploads_rate bytes a second
+* for all clients together. Clients take turns a block at a time, so the
+* budget is split evenly between everyone who has something to send.
+*/
+void SV_SendDownloads( unsigned msec ) {
+	int64_t rate = Max2( sv_uploads_rate->integer, DOWNLOAD_BLOCK_SIZE );
+
+	// allow a burst of at most 100ms worth of data after idling
+	svs.download_budget = Min2( svs.download_budget + rate * msec / 1000, Max2( rate / 10, (int64_t)DOWNLOAD_BLOCK_SIZE ) );
+
+	int first = svs.download_next;
+	svs.download_next = ( svs.download_next + 1 ) % sv_maxclients->integer;
+
+	bool sent = true;
+	while( sent && svs.download_budget >= DOWNLOAD_BLOCK_SIZE ) {
+		sent = false;
+
+		for( int i = 0; i < sv_maxclients->integer && svs.download_budget >= DOWNLOAD_BLOCK_SIZE; i++ ) {
+			client_t *client = &svs.clients[( first + i ) % sv_maxclients->integer];
+			if( client->state == CS_FREE || client->state == CS_ZOMBIE ) {
+				continue;
+			}
+			if( !client->download.file || !client->download.window ) {
+				continue;
+			}
+
+			int block = SV_NextDownloadBlock( client );
+			if( block < 0 ) {
+				continue;
+			}
+
+			int offset = block * DOWNLOAD_BLOCK_SIZE;
+			SV_SendDownloadBlock( client, offset, Min2( client->download.size - offset, DOWNLOAD_BLOCK_SIZE ) );
+
+			int slot = block % DOWNLOAD_MAX_WINDOW;
+			client->download.sentblock[slot] = block;
+			client->download.senttime[slot] = svs.realtime;
+			sent = true;
+		}
+	}
 }
 
 /*
@@ -846,26 +947,26 @@ usercmd_t *SV_FindNextUserCommand( client_t *client ) {
 }
 
 /*
-* SV_ExecuteClientThinks - Execute all pending usercmd_t
+* SV_ThinkingClient
+*
+* Returns the client if it has usercmds to execute, after holding its
+* command time within a second of the game time
 */
-void SV_ExecuteClientThinks( int clientNum ) {
-	unsigned int msec;
+static client_t *SV_ThinkingClient( int clientNum ) {
 	int64_t minUcmdTime;
-	int timeDelta;
 	client_t *client;
-	usercmd_t *ucmd;
 
 	if( clientNum >= sv_maxclients->integer || clientNum < 0 ) {
-		return;
+		return NULL;
 	}
 
 	client = svs.clients + clientNum;
 	if( client->state < CS_SPAWNED ) {
-		return;
+		return NULL;
 	}
 
 	if( client->edict->r.svflags & SVF_FAKECLIENT ) {
-		return;
+		return NULL;
 	}
 
 	// don't let client command time delay too far away in the past
@@ -874,10 +975,52 @@ void SV_ExecuteClientThinks( int clientNum ) {
 		client->UcmdTime = minUcmdTime;
 	}
 
+	return client;
+}
+
+/*
+* SV_UserCommandMsec
+*/
+static unsigned int SV_UserCommandMsec( const client_t *client, const usercmd_t *ucmd ) {
+	unsigned int msec = ucmd->serverTimeStamp - client->UcmdTime;
+	clamp( msec, 1, 200 );
+	return msec;
+}
+
+/*
+* SV_PeekClientThink
+*
+* Copies out the usercmd_t the next SV_ExecuteClientThinks will execute
+* first, with the same msec, so the game can run its move ahead of time
+*/
+bool SV_PeekClientThink( int clientNum, usercmd_t *ucmd ) {
+	client_t *client = SV_ThinkingClient( clientNum );
+	const usercmd_t *next = client != NULL ? SV_FindNextUserCommand( client ) : NULL;
+
+	if( next == NULL ) {
+		return false;
+	}
+
+	memcpy( ucmd, next, sizeof( *ucmd ) );
+	ucmd->msec = SV_UserCommandMsec( client, next );
+	return true;
+}
+
+/*
+* SV_ExecuteClientThinks - Execute all pending usercmd_t
+*/
+void SV_ExecuteClientThinks( int clientNum ) {
+	int timeDelta;
+	client_t *client;
+	usercmd_t *ucmd;
+
+	client = SV_ThinkingClient( clientNum );
+	if( client == NULL ) {
+		return;
+	}
+
 	while( ( ucmd = SV_FindNextUserCommand( client ) ) != NULL ) {
-		msec = ucmd->serverTimeStamp - client->UcmdTime;
-		clamp( msec, 1, 200 );
-		ucmd->msec = msec;
+		ucmd->msec = SV_UserCommandMsec( client, ucmd );
 		timeDelta = 0;
 		if( client->lastframe > 0 ) {
 			timeDelta = -(int)( svs.gametime - ucmd->serverTimeStamp );
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "server.h"
 #include "qcommon/version.h"
+#include "qcommon/qthreads.h"
 
 game_export_t *ge;
 
@@ -45,6 +46,15 @@ static inline void PF_CM_TransformedBoxTrace( trace_t *tr, const vec3_t start, c
 	CM_TransformedBoxTrace( svs.cms, tr, start, end, mins, maxs, cmodel, brushmask, origin, angles );
 }
 
+static inline int PF_CM_BoxHeadnode( const vec3_t mins, const vec3_t maxs ) {
+	return CM_BoxHeadnode( svs.cms, mins, maxs );
+}
+
+static inline void PF_CM_HeadnodeBoxTrace( trace_t *tr, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+										   int brushmask, int headnode ) {
+	CM_HeadnodeBoxTrace( svs.cms, tr, start, end, mins, maxs, brushmask, headnode );
+}
+
 static inline int PF_CM_NumInlineModels( void ) {
 	return CM_NumInlineModels( svs.cms );
 }
@@ -449,6 +459,8 @@ void SV_InitGameProgs( void ) {
 
 	import.CM_TransformedPointContents = PF_CM_TransformedPointContents;
 	import.CM_TransformedBoxTrace = PF_CM_TransformedBoxTrace;
+	import.CM_BoxHeadnode = PF_CM_BoxHeadnode;
+	import.CM_HeadnodeBoxTrace = PF_CM_HeadnodeBoxTrace;
 	import.CM_NumInlineModels = PF_CM_NumInlineModels;
 	import.CM_InlineModel = PF_CM_InlineModel;
 	import.CM_InlineModelBounds = PF_CM_InlineModelBounds;
@@ -462,6 +474,9 @@ void SV_InitGameProgs( void ) {
 	import.CM_LeafsInPVS = PF_CM_LeafsInPVS;
 
 	import.Milliseconds = Sys_Milliseconds;
+	import.Microseconds = Sys_Microseconds;
+
+	import.ParallelFor = QJob_ParallelFor;
 
 	import.ModelIndex = SV_ModelIndex;
 	import.SoundIndex = SV_SoundIndex;
@@ -513,6 +528,7 @@ void SV_InitGameProgs( void ) {
 	import.FakeClientConnect = SVC_FakeConnect;
 	import.DropClient = PF_DropClient;
 	import.GetClientState = PF_GetClientState;
+	import.PeekClientThink = SV_PeekClientThink;
 	import.ExecuteClientThinks = SV_ExecuteClientThinks;
 
 	import.LocateEntities = SV_LocateEntities;
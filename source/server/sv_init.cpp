@@ -239,6 +239,8 @@ static void SV_SpawnServer( const char *server, bool devmap ) {
 	SV_ResetClientFrameCounters();
 	svs.realtime = 0;
 	svs.gametime = 0;
+	SV_ResetOutOfBandRates();
+	SV_InvalidateInfoStrings();
 	SV_UpdateActivity();
 
 	Q_strncpyz( sv.mapname, server, sizeof( sv.mapname ) );
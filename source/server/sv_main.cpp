@@ -42,6 +42,7 @@ cvar_t *sv_uploads_http;
 cvar_t *sv_uploads_baseurl;
 cvar_t *sv_uploads_demos;
 cvar_t *sv_uploads_demos_baseurl;
+cvar_t *sv_uploads_rate;
 
 cvar_t *sv_pure;
 cvar_t *sv_pure_forcemodulepk3;
@@ -68,6 +69,8 @@ cvar_t *sv_public;         // should heartbeats be sent
 cvar_t *sv_defaultmap;
 
 cvar_t *sv_iplimit;
+cvar_t *sv_oobRate;
+cvar_t *sv_oobBurst;
 
 cvar_t *sv_reconnectlimit; // minimum seconds between connect messages
 
@@ -494,6 +497,7 @@ static void SV_CheckPostUpdateRestart( void ) {
 */
 void SV_Frame( unsigned realmsec, unsigned gamemsec ) {
 	MICROPROFILE_SCOPEI( "Main", "SV_Frame", 0xffffffff );
+	uint64_t frame_start = Sys_Microseconds();
 
 	time_before_game = time_after_game = 0;
 
@@ -515,6 +519,9 @@ void SV_Frame( unsigned realmsec, unsigned gamemsec ) {
 	// apply latched userinfo changes
 	SV_CheckLatchedUserinfoChanges();
 
+	// send download blocks within the upload budget
+	SV_SendDownloads( realmsec );
+
 	// let everything in the world think and move
 	if( SV_RunGameFrame( gamemsec ) ) {
 		// send messages back to the clients that had packets read this frame
@@ -528,6 +535,11 @@ void SV_Frame( unsigned realmsec, unsigned gamemsec ) {
 
 		// clear teleport flags, etc for next frame
 		ge->ClearSnap();
+
+		uint64_t frame_usec = Sys_Microseconds() - frame_start;
+		svs.frame_count++;
+		svs.frame_usec += frame_usec;
+		svs.frame_max_usec = Max2( svs.frame_max_usec, frame_usec );
 	}
 
 	// handle HTTP connections
@@ -578,6 +590,7 @@ void SV_UserinfoChanged( client_t *client ) {
 	}
 	Q_strncpyz( client->name, val, sizeof( client->name ) );
 
+	SV_InvalidateInfoStrings();
 }
 
 
@@ -632,6 +645,7 @@ void SV_Init( void ) {
 	sv_uploads_baseurl =    Cvar_Get( "sv_uploads_baseurl", "", CVAR_ARCHIVE );
 	sv_uploads_demos =      Cvar_Get( "sv_uploads_demos", "1", CVAR_ARCHIVE );
 	sv_uploads_demos_baseurl =  Cvar_Get( "sv_uploads_demos_baseurl", "", CVAR_ARCHIVE );
+	sv_uploads_rate =       Cvar_Get( "sv_uploads_rate", "1048576", CVAR_ARCHIVE );
 	if( is_dedicated_server ) {
 		sv_pure =       Cvar_Get( "sv_pure", "1", CVAR_ARCHIVE | CVAR_LATCH | CVAR_SERVERINFO );
 
@@ -646,6 +660,8 @@ void SV_Init( void ) {
 	}
 
 	sv_iplimit = Cvar_Get( "sv_iplimit", "3", CVAR_ARCHIVE );
+	sv_oobRate = Cvar_Get( "sv_oobRate", "10", CVAR_ARCHIVE );
+	sv_oobBurst = Cvar_Get( "sv_oobBurst", "20", CVAR_ARCHIVE );
 
 	sv_pure_forcemodulepk3 =    Cvar_Get( "sv_pure_forcemodulepk3", "", CVAR_LATCH );
 
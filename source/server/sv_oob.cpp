@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "server.h"
 #include "qcommon/version.h"
+#include "qalgo/hash.h"
 
 typedef struct sv_master_s {
 	netadr_t address;
@@ -32,6 +33,8 @@ extern cvar_t *sv_hostname;
 extern cvar_t *sv_reconnectlimit;     // minimum seconds between connect messages
 extern cvar_t *rcon_password;         // password for remote server commands
 extern cvar_t *sv_iplimit;
+extern cvar_t *sv_oobRate;
+extern cvar_t *sv_oobBurst;
 
 
 //==============================================================================
@@ -181,19 +184,48 @@ void SV_MasterHeartbeat( void ) {
 
 //============================================================================
 
+/*
+* Info strings are built at most once a server frame, so a flood of info
+* queries costs one build a frame instead of one per packet. Frags, pings
+* and teams change inside the game module without telling us, so a string
+* is never kept longer than that. Connects, drops and userinfo changes
+* invalidate them straight away.
+*/
+static int64_t long_info_time[2] = { -1, -1 };
+static int64_t short_info_time = -1;
+
+static uint64_t info_strings_built;
+static uint64_t info_strings_cached;
+
+/*
+* SV_InvalidateInfoStrings
+*/
+void SV_InvalidateInfoStrings( void ) {
+	long_info_time[0] = long_info_time[1] = -1;
+	short_info_time = -1;
+}
+
 /*
 * SV_LongInfoString
 * Builds the string that is sent as heartbeats and status replies
 */
 static char *SV_LongInfoString( bool fullStatus ) {
 	char tempstr[1024] = { 0 };
-	static char status[MAX_MSGLEN - 16];
+	static char statuses[2][MAX_MSGLEN - 16];
+	char *status = statuses[fullStatus ? 1 : 0];
 	int i, bots, count;
 	client_t *cl;
 	size_t statusLength;
 	size_t tempstrLength;
 
-	Q_strncpyz( status, Cvar_Serverinfo(), sizeof( status ) );
+	if( long_info_time[fullStatus ? 1 : 0] == svs.realtime ) {
+		info_strings_cached++;
+		return status;
+	}
+	long_info_time[fullStatus ? 1 : 0] = svs.realtime;
+	info_strings_built++;
+
+	Q_strncpyz( status, Cvar_Serverinfo(), sizeof( statuses[0] ) );
 
 	statusLength = strlen( status );
 
@@ -214,10 +246,10 @@ static char *SV_LongInfoString( bool fullStatus ) {
 	}
 	Q_snprintfz( tempstr + strlen( tempstr ), sizeof( tempstr ) - strlen( tempstr ), "\\clients\\%i%s", count, fullStatus ? "\n" : "" );
 	tempstrLength = strlen( tempstr );
-	if( statusLength + tempstrLength >= sizeof( status ) ) {
+	if( statusLength + tempstrLength >= sizeof( statuses[0] ) ) {
 		return status; // can't hold any more
 	}
-	Q_strncpyz( status + statusLength, tempstr, sizeof( status ) - statusLength );
+	Q_strncpyz( status + statusLength, tempstr, sizeof( statuses[0] ) - statusLength );
 	statusLength += tempstrLength;
 
 	if( fullStatus ) {
@@ -227,10 +259,10 @@ static char *SV_LongInfoString( bool fullStatus ) {
 				Q_snprintfz( tempstr, sizeof( tempstr ), "%i %i \"%s\" %i\n",
 							 cl->edict->r.client->r.frags, cl->ping, cl->name, cl->edict->s.team );
 				tempstrLength = strlen( tempstr );
-				if( statusLength + tempstrLength >= sizeof( status ) ) {
+				if( statusLength + tempstrLength >= sizeof( statuses[0] ) ) {
 					break; // can't hold any more
 				}
-				Q_strncpyz( status + statusLength, tempstr, sizeof( status ) - statusLength );
+				Q_strncpyz( status + statusLength, tempstr, sizeof( statuses[0] ) - statusLength );
 				statusLength += tempstrLength;
 			}
 		}
@@ -254,6 +286,13 @@ static char *SV_ShortInfoString( void ) {
 	int maxcount;
 	const char *password;
 
+	if( short_info_time == svs.realtime ) {
+		info_strings_cached++;
+		return string;
+	}
+	short_info_time = svs.realtime;
+	info_strings_built++;
+
 	bots = 0;
 	count = 0;
 	for( i = 0; i < sv_maxclients->integer; i++ ) {
@@ -775,6 +814,8 @@ static void SVC_RemoteCommand( const socket_t *socket, const netadr_t *address )
 typedef struct {
 	const char *name;
 	void ( *func )( const socket_t *socket, const netadr_t *address );
+	uint64_t accepted;
+	uint64_t limited;
 } connectionless_cmd_t;
 
 connectionless_cmd_t connectionless_cmds[] =
@@ -788,9 +829,115 @@ connectionless_cmd_t connectionless_cmds[] =
 	{ "connect", SVC_DirectConnect },
 	{ "rcon", SVC_RemoteCommand },
 
-	{ NULL, NULL }
+	{ NULL, NULL } // counts unknown commands
 };
 
+/*
+* Every source address gets a token bucket, ignoring ports, which holds up
+* to sv_oobBurst packets and refills at sv_oobRate packets a second. The
+* buckets live in a small hash table and addresses that collide evict the
+* least recently seen one, which just hands it a full bucket again.
+*/
+#define MAX_OOB_BUCKETS     1024        // must be a power of two
+#define OOB_BUCKET_PROBES   4
+
+typedef struct {
+	netadr_t address;
+	int64_t time;
+	float tokens;
+} oob_bucket_t;
+
+static oob_bucket_t oob_buckets[MAX_OOB_BUCKETS];
+
+/*
+* SV_HashBaseAddress
+*/
+static uint32_t SV_HashBaseAddress( const netadr_t *address ) {
+	switch( address->type ) {
+		case NA_IP:
+			return Hash32( address->address.ipv4.ip, sizeof( address->address.ipv4.ip ) );
+		case NA_IP6:
+			return Hash32( address->address.ipv6.ip, sizeof( address->address.ipv6.ip ) );
+		default:
+			return 0;
+	}
+}
+
+/*
+* SV_ResetOutOfBandRates
+*
+* The buckets hold svs.realtime stamps, which restart from 0 on every map
+*/
+void SV_ResetOutOfBandRates( void ) {
+	memset( oob_buckets, 0, sizeof( oob_buckets ) );
+}
+
+/*
+* SV_CheckOutOfBandRate
+*
+* Returns false when the address has used up its bucket
+*/
+static bool SV_CheckOutOfBandRate( const netadr_t *address ) {
+	oob_bucket_t *bucket, *oldest;
+	int64_t elapsed;
+	uint32_t hash;
+	float burst;
+	int i;
+
+	if( sv_oobRate->value <= 0 ) {
+		return true;
+	}
+
+	burst = Max2( sv_oobBurst->value, 1.0f );
+	hash = SV_HashBaseAddress( address );
+
+	bucket = oldest = NULL;
+	for( i = 0; i < OOB_BUCKET_PROBES; i++ ) {
+		oob_bucket_t *b = &oob_buckets[( hash + i ) & ( MAX_OOB_BUCKETS - 1 )];
+		if( b->time != 0 && NET_CompareBaseAddress( &b->address, address ) ) {
+			bucket = b;
+			break;
+		}
+		if( !oldest || b->time < oldest->time ) {
+			oldest = b;
+		}
+	}
+
+	if( !bucket ) {
+		bucket = oldest;
+		bucket->address = *address;
+		bucket->time = svs.realtime;
+		bucket->tokens = burst;
+	}
+
+	elapsed = Max2( svs.realtime - bucket->time, int64_t( 0 ) );
+	bucket->tokens = Min2( burst, bucket->tokens + elapsed * sv_oobRate->value * 0.001f );
+	bucket->time = Max2( svs.realtime, int64_t( 1 ) );
+
+	if( bucket->tokens < 1.0f ) {
+		return false;
+	}
+
+	bucket->tokens -= 1.0f;
+	return true;
+}
+
+/*
+* SV_OutOfBandStats_f
+*/
+void SV_OutOfBandStats_f( void ) {
+	connectionless_cmd_t *cmd;
+
+	Com_Printf( "%-14s %12s %12s\n", "command", "accepted", "limited" );
+	for( cmd = connectionless_cmds; ; cmd++ ) {
+		Com_Printf( "%-14s %12" PRIu64 " %12" PRIu64 "\n", cmd->name ? cmd->name : "(unknown)", cmd->accepted, cmd->limited );
+		if( !cmd->name ) {
+			break;
+		}
+	}
+	Com_Printf( "info strings: %" PRIu64 " built, %" PRIu64 " from cache\n", info_strings_built, info_strings_cached );
+}
+
 /*
 * SV_ConnectionlessPacket
 *
@@ -815,10 +962,20 @@ void SV_ConnectionlessPacket( const socket_t *socket, const netadr_t *address, m
 
 	for( cmd = connectionless_cmds; cmd->name; cmd++ ) {
 		if( !strcmp( c, cmd->name ) ) {
-			cmd->func( socket, address );
-			return;
+			break;
 		}
 	}
 
-	Com_DPrintf( "Bad connectionless packet from %s:\n%s\n", NET_AddressToString( address ), s );
+	if( !SV_CheckOutOfBandRate( address ) ) {
+		cmd->limited++;
+		return;
+	}
+	cmd->accepted++;
+
+	if( !cmd->name ) {
+		Com_DPrintf( "Bad connectionless packet from %s:\n%s\n", NET_AddressToString( address ), s );
+		return;
+	}
+
+	cmd->func( socket, address );
 }
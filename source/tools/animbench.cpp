@@ -0,0 +1,477 @@
+// animbench.cpp -- skeletal animation sampling benchmark
+//
+// usage: animbench [entities] [frames] [groups]
+//
+// Loads the glTF player models with their animation scripts and plays clips
+// on many entities, sampling the lower and upper body, merging them and
+// building matrix palettes every frame like CG_AddPModel does. Entities come
+// in groups that spawn and switch clips together, like players do at the
+// start of a round or idling next to each other.
+//
+// The same frames are run through the linear keyframe scans and scalar
+// matrix code R_SampleAnimation and R_ComputeMatrixPalettes used to have,
+// through binary searches alone, with a cursor per entity like the cgame
+// keeps, and through CG_SamplePlayerPose with the cgame's frame pose cache.
+// Sampled poses must match the old ones exactly, a shared pose must be the
+// one sampled at the times of the entity that filled its cache entry, which
+// may differ from the entity's own by less than a cache step, and palettes
+// must match to within float rounding.
+
+#include "qcommon/qcommon.h"
+#include "qalgo/rng.h"
+#include "cgame/ref.h"
+#include "cgame/cg_posecache.h"
+#include "client/renderer/r_skeleton.h"
+
+#include "cgltf/cgltf.h"
+
+#define DEFAULT_ENTITIES 64
+#define DEFAULT_FRAMES 2000
+#define DEFAULT_GROUP_SIZE 4
+#define FRAME_MSEC 16
+#define CLIP_SWITCH_CHANCE 90   // one in this many frames
+#define MAX_BENCH_MODELS 8
+#define MAX_CLIPS 64
+#define MAX_PALETTE_ERROR 0.001f
+
+//==================================================
+// MODELS
+//==================================================
+
+struct AnimationClip {
+	float start_time;
+	float duration;
+	float loop_from;
+};
+
+struct BenchModel {
+	char name[MAX_QPATH];
+	Skeleton skeleton;
+	u8 upper_root_joint;
+	AnimationClip clips[MAX_CLIPS];
+	int num_clips;
+};
+
+static BenchModel models[MAX_BENCH_MODELS];
+static int num_models;
+
+static bool AB_LoadAnimationScript( BenchModel * model ) {
+	char filename[MAX_QPATH];
+	char upper_root[MAX_QPATH] = "";
+	uint8_t * buffer;
+
+	Q_snprintfz( filename, sizeof( filename ), "models/players/%s/animation.cfg", model->name );
+	if( FS_LoadFile( filename, ( void ** ) &buffer, NULL, 0 ) == -1 ) {
+		return false;
+	}
+
+	const char * ptr = ( const char * ) buffer;
+	while( ptr ) {
+		const char * cmd = COM_ParseExt( &ptr, true );
+		if( !cmd[0] ) {
+			break;
+		}
+
+		if( !Q_stricmp( cmd, "upper_root_joint" ) ) {
+			Q_strncpyz( upper_root, COM_ParseExt( &ptr, false ), sizeof( upper_root ) );
+		} else if( !Q_stricmp( cmd, "clip" ) && model->num_clips < MAX_CLIPS ) {
+			int start_frame = atoi( COM_ParseExt( &ptr, false ) );
+			int end_frame = atoi( COM_ParseExt( &ptr, false ) );
+			int loop_frames = atoi( COM_ParseExt( &ptr, false ) );
+			int fps = atoi( COM_ParseExt( &ptr, false ) );
+
+			AnimationClip * clip = &model->clips[model->num_clips++];
+			clip->start_time = float( start_frame + 1 ) / float( fps );
+			clip->duration = float( end_frame - start_frame ) / float( fps );
+			clip->loop_from = clip->duration - float( loop_frames ) / float( fps );
+		}
+	}
+
+	FS_FreeFile( buffer );
+
+	// the scripts don't always match the case the joints were exported with
+	if( !FindSkeletonJoint( &model->skeleton, upper_root, &model->upper_root_joint ) ) {
+		Q_strlwr( upper_root );
+		if( !FindSkeletonJoint( &model->skeleton, upper_root, &model->upper_root_joint ) ) {
+			return false;
+		}
+	}
+
+	return model->num_clips > 0;
+}
+
+static bool AB_LoadModel( BenchModel * model, const char * name ) {
+	char filename[MAX_QPATH];
+	void * buffer;
+
+	memset( model, 0, sizeof( *model ) );
+	Q_strncpyz( model->name, name, sizeof( model->name ) );
+	COM_StripExtension( model->name );
+
+	Q_snprintfz( filename, sizeof( filename ), "models/players/%s.glb", model->name );
+	int len = FS_LoadFile( filename, &buffer, NULL, 0 );
+	if( len == -1 ) {
+		return false;
+	}
+
+	cgltf_options options = { };
+	options.type = cgltf_file_type_glb;
+
+	cgltf_data * data;
+	if( cgltf_parse( &options, buffer, len, &data ) != cgltf_result_success ) {
+		FS_FreeFile( buffer );
+		return false;
+	}
+
+	if( data->buffers_count && data->buffers[0].data == NULL && data->buffers[0].uri == NULL && data->bin ) {
+		data->buffers[0].data = const_cast< void * >( data->bin );
+	}
+
+	bool ok = data->skins_count == 1 && data->animations_count == 1 && LoadSkeleton( &model->skeleton, &data->skins[0] ) != NULL;
+	if( ok ) {
+		LoadSkeletonAnimation( &model->skeleton, &data->animations[0] );
+	}
+
+	cgltf_free( data );
+	FS_FreeFile( buffer );
+
+	return ok && AB_LoadAnimationScript( model );
+}
+
+//==================================================
+// THE OLD CODE
+//==================================================
+
+static void AB_OldFindSampleAndLerpFrac( const float * times, u32 n, float t, u32 * sample, float * lerp_frac ) {
+	t = Clamp( times[ 0 ], t, times[ n - 1 ] );
+
+	*sample = 0;
+	for( u32 i = 1; i < n; i++ ) {
+		if( times[ i ] >= t ) {
+			*sample = i - 1;
+			break;
+		}
+	}
+
+	*lerp_frac = ( t - times[ *sample ] ) / ( times[ *sample + 1 ] - times[ *sample ] );
+}
+
+static Span< TRS > AB_OldSample( ArenaAllocator * a, const Skeleton * skeleton, float t ) {
+	Span< TRS > local_poses = ALLOC_SPAN( a, TRS, skeleton->num_joints );
+
+	for( u8 i = 0; i < skeleton->num_joints; i++ ) {
+		const Skeleton::AnimationChannel< Quaternion > & rotations = skeleton->rotations[ i ];
+		const Skeleton::AnimationChannel< Vec3 > & translations = skeleton->translations[ i ];
+		const Skeleton::AnimationChannel< float > & scales = skeleton->scales[ i ];
+		const Skeleton::Timeline & rotation_times = skeleton->timelines[ rotations.timeline ];
+		const Skeleton::Timeline & translation_times = skeleton->timelines[ translations.timeline ];
+		const Skeleton::Timeline & scale_times = skeleton->timelines[ scales.timeline ];
+
+		u32 rotation_sample, translation_sample, scale_sample;
+		float rotation_lerp_frac, translation_lerp_frac, scale_lerp_frac;
+
+		AB_OldFindSampleAndLerpFrac( rotation_times.times, rotation_times.num_samples, t, &rotation_sample, &rotation_lerp_frac );
+		AB_OldFindSampleAndLerpFrac( translation_times.times, translation_times.num_samples, t, &translation_sample, &translation_lerp_frac );
+		AB_OldFindSampleAndLerpFrac( scale_times.times, scale_times.num_samples, t, &scale_sample, &scale_lerp_frac );
+
+		local_poses[ i ].rotation = NLerp( rotations.samples[ rotation_sample ], rotation_lerp_frac, rotations.samples[ ( rotation_sample + 1 ) % rotation_times.num_samples ] );
+		local_poses[ i ].translation = Lerp( translations.samples[ translation_sample ], translation_lerp_frac, translations.samples[ ( translation_sample + 1 ) % translation_times.num_samples ] );
+		local_poses[ i ].scale = Lerp( scales.samples[ scale_sample ], scale_lerp_frac, scales.samples[ ( scale_sample + 1 ) % scale_times.num_samples ] );
+	}
+
+	return local_poses;
+}
+
+static Mat4 AB_OldTRSToMat4( const TRS & trs ) {
+	Quaternion q = trs.rotation;
+	Vec3 t = trs.translation;
+	float s = trs.scale;
+
+	return Mat4(
+		( 1.0f - 2 * q.y * q.y - 2.0f * q.z * q.z ) * s,
+		( 2.0f * q.x * q.y - 2.0f * q.z * q.w ) * s,
+		( 2.0f * q.x * q.z + 2.0f * q.y * q.w ) * s,
+		t.x,
+
+		( 2.0f * q.x * q.y + 2.0f * q.z * q.w ) * s,
+		( 1.0f - 2.0f * q.x * q.x - 2.0f * q.z * q.z ) * s,
+		( 2.0f * q.y * q.z - 2.0f * q.x * q.w ) * s,
+		t.y,
+
+		( 2.0f * q.x * q.z - 2.0f * q.y * q.w ) * s,
+		( 2.0f * q.y * q.z + 2.0f * q.x * q.w ) * s,
+		( 1.0f - 2.0f * q.x * q.x - 2.0f * q.y * q.y ) * s,
+		t.z,
+
+		0.0f, 0.0f, 0.0f, 1.0f
+	);
+}
+
+static MatrixPalettes AB_OldPalettes( ArenaAllocator * a, const Skeleton * skeleton, Span< const TRS > local_poses ) {
+	MatrixPalettes palettes;
+	palettes.joint_poses = ALLOC_SPAN( a, Mat4, skeleton->num_joints );
+	palettes.skinning_matrices = ALLOC_SPAN( a, Mat4, skeleton->num_joints );
+
+	for( u8 i = 0; i < skeleton->num_joints; i++ ) {
+		u8 joint_idx = skeleton->order[ i ];
+		u8 parent = skeleton->parents[ joint_idx ];
+		Mat4 local = AB_OldTRSToMat4( local_poses[ joint_idx ] );
+		palettes.joint_poses[ joint_idx ] = parent == U8_MAX ? local : palettes.joint_poses[ parent ] * local;
+	}
+
+	for( u8 i = 0; i < skeleton->num_joints; i++ ) {
+		palettes.skinning_matrices[ i ] = palettes.joint_poses[ i ] * skeleton->joints_to_bind[ i ];
+	}
+
+	return palettes;
+}
+
+//==================================================
+// PLAYBACK
+//==================================================
+
+enum {
+	AB_OLD,
+	AB_SEARCH,
+	AB_CURSOR,
+	AB_CACHED,
+	AB_CHECK,
+
+	AB_NUM_MODES
+};
+
+static const char * const mode_names[] = { "old", "search", "cursor", "cached" };
+
+// players in a group spawn and switch clips together
+struct BenchGroup {
+	const BenchModel * model;
+	int clips[2];
+	int64_t clip_start[2];
+};
+
+struct BenchEntity {
+	const BenchGroup * group;
+	AnimationCursor cursors[2];
+};
+
+struct RunStats {
+	uint64_t usec;
+	int pose_mismatches;
+	int cache_mismatches;
+	float max_palette_error;
+	u32 cache_lookups;
+	u32 cache_hits;
+};
+
+static float AB_ClipTime( const AnimationClip & clip, int64_t now, int64_t start ) {
+	float t = Max2( 0.0f, ( now - start ) / 1000.0f );
+	if( t > clip.loop_from ) {
+		float loop_duration = Max2( clip.duration - clip.loop_from, 0.001f );
+		t = clip.loop_from + fmodf( t - clip.loop_from, loop_duration );
+	}
+	return clip.start_time + t;
+}
+
+static void AB_Pose( ArenaAllocator * a, PoseCache * cache, BenchEntity * ent, int mode, float lower_time, float upper_time ) {
+	const BenchModel * model = ent->group->model;
+	const Skeleton * skeleton = &model->skeleton;
+
+	if( mode == AB_OLD ) {
+		Span< TRS > lower = AB_OldSample( a, skeleton, lower_time );
+		Span< TRS > upper = AB_OldSample( a, skeleton, upper_time );
+		MergeSkeletonPoses( lower, upper, skeleton, model->upper_root_joint );
+		AB_OldPalettes( a, skeleton, lower );
+		return;
+	}
+
+	if( mode == AB_CACHED ) {
+		CachedPose * cached;
+		Span< TRS > pose = CG_SamplePlayerPose( a, cache, skeleton, model->upper_root_joint,
+			lower_time, upper_time, &ent->cursors[0], &ent->cursors[1], true, &cached );
+		ComputeSkeletonPalettes( a, skeleton, pose );
+		return;
+	}
+
+	bool cursors = mode == AB_CURSOR;
+	Span< TRS > lower = SampleSkeleton( a, skeleton, lower_time, cursors ? &ent->cursors[0] : NULL );
+	Span< TRS > upper = SampleSkeleton( a, skeleton, upper_time, cursors ? &ent->cursors[1] : NULL );
+	MergeSkeletonPoses( lower, upper, skeleton, model->upper_root_joint );
+	ComputeSkeletonPalettes( a, skeleton, lower );
+}
+
+static void AB_Check( ArenaAllocator * a, PoseCache * cache, BenchEntity * ent, float lower_time, float upper_time, RunStats * stats ) {
+	const BenchModel * model = ent->group->model;
+	const Skeleton * skeleton = &model->skeleton;
+
+	Span< TRS > old_lower = AB_OldSample( a, skeleton, lower_time );
+	Span< TRS > old_upper = AB_OldSample( a, skeleton, upper_time );
+	Span< TRS > lower = SampleSkeleton( a, skeleton, lower_time, &ent->cursors[0] );
+	Span< TRS > upper = SampleSkeleton( a, skeleton, upper_time, &ent->cursors[1] );
+	if( memcmp( old_lower.ptr, lower.ptr, lower.num_bytes() ) || memcmp( old_upper.ptr, upper.ptr, upper.num_bytes() ) ) {
+		stats->pose_mismatches++;
+	}
+
+	MergeSkeletonPoses( old_lower, old_upper, skeleton, model->upper_root_joint );
+	MergeSkeletonPoses( lower, upper, skeleton, model->upper_root_joint );
+	MatrixPalettes old_palettes = AB_OldPalettes( a, skeleton, old_lower );
+	MatrixPalettes palettes = ComputeSkeletonPalettes( a, skeleton, lower );
+
+	for( size_t j = 0; j < palettes.skinning_matrices.n; j++ ) {
+		const float * x = old_palettes.skinning_matrices[j].ptr();
+		const float * y = palettes.skinning_matrices[j].ptr();
+		for( int k = 0; k < 16; k++ ) {
+			stats->max_palette_error = Max2( stats->max_palette_error, fabsf( x[k] - y[k] ) );
+		}
+	}
+
+	// the first entity to ask gets its own times, later ones the first one's
+	u32 hits = cache->hits;
+	CachedPose * entry;
+	Span< TRS > pose = CG_SamplePlayerPose( a, cache, skeleton, model->upper_root_joint,
+		lower_time, upper_time, NULL, NULL, true, &entry );
+	if( entry == NULL ) {
+		return;
+	}
+
+	bool hit = cache->hits != hits;
+	const float step = 1.0f / POSE_CACHE_STEPS_PER_SECOND;
+	if( hit ? fabsf( entry->lower_time - lower_time ) >= step || fabsf( entry->upper_time - upper_time ) >= step
+		: entry->lower_time != lower_time || entry->upper_time != upper_time ) {
+		stats->cache_mismatches++;
+	}
+
+	Span< TRS > shared_lower = SampleSkeleton( a, skeleton, entry->lower_time, NULL );
+	Span< TRS > shared_upper = SampleSkeleton( a, skeleton, entry->upper_time, NULL );
+	MergeSkeletonPoses( shared_lower, shared_upper, skeleton, model->upper_root_joint );
+	if( pose.ptr == entry->pose.ptr || memcmp( pose.ptr, shared_lower.ptr, pose.num_bytes() ) ) {
+		stats->cache_mismatches++;
+	}
+}
+
+/*
+* AB_Run
+*
+* Every mode replays the same clips and clip switches from the same seed
+*/
+static RunStats AB_Run( ArenaAllocator * arena, int num_entities, int num_groups, int frames, int mode ) {
+	RunStats stats = { };
+	RNG rng = new_rng( 0x5eed, 1 );
+	BenchGroup * groups = ( BenchGroup * ) calloc( num_groups, sizeof( BenchGroup ) );
+	BenchEntity * ents = ( BenchEntity * ) calloc( num_entities, sizeof( BenchEntity ) );
+	PoseCache * cache = ( PoseCache * ) calloc( 1, sizeof( PoseCache ) );
+
+	for( int i = 0; i < num_groups; i++ ) {
+		groups[i].model = &models[i % num_models];
+		for( int p = 0; p < 2; p++ ) {
+			groups[i].clips[p] = random_uniform( &rng, 0, groups[i].model->num_clips );
+			groups[i].clip_start[p] = -int64_t( random_uniform( &rng, 0, 5000 ) );
+		}
+	}
+
+	for( int i = 0; i < num_entities; i++ ) {
+		ents[i].group = &groups[i % num_groups];
+	}
+
+	for( int f = 0; f < frames; f++ ) {
+		int64_t now = int64_t( f ) * FRAME_MSEC;
+
+		for( int i = 0; i < num_groups; i++ ) {
+			BenchGroup * group = &groups[i];
+			for( int p = 0; p < 2; p++ ) {
+				if( random_uniform( &rng, 0, CLIP_SWITCH_CHANCE ) == 0 ) {
+					group->clips[p] = random_uniform( &rng, 0, group->model->num_clips );
+					group->clip_start[p] = now;
+				}
+			}
+		}
+
+		arena->clear();
+		CG_ClearPoseCache( cache );
+
+		for( int i = 0; i < num_entities; i++ ) {
+			BenchEntity * ent = &ents[i];
+			const BenchGroup * group = ent->group;
+			float lower_time = AB_ClipTime( group->model->clips[group->clips[0]], now, group->clip_start[0] );
+			float upper_time = AB_ClipTime( group->model->clips[group->clips[1]], now, group->clip_start[1] );
+
+			if( mode == AB_CHECK ) {
+				AB_Check( arena, cache, ent, lower_time, upper_time, &stats );
+				continue;
+			}
+
+			uint64_t t0 = Sys_Microseconds();
+			AB_Pose( arena, cache, ent, mode, lower_time, upper_time );
+			stats.usec += Sys_Microseconds() - t0;
+		}
+	}
+
+	stats.cache_lookups = cache->lookups;
+	stats.cache_hits = cache->hits;
+
+	free( cache );
+	free( ents );
+	free( groups );
+
+	return stats;
+}
+
+int main( int argc, char **argv ) {
+	int num_entities = argc >= 2 ? atoi( argv[1] ) : DEFAULT_ENTITIES;
+	int frames = argc >= 3 ? atoi( argv[2] ) : DEFAULT_FRAMES;
+	int num_groups = argc >= 4 ? atoi( argv[3] ) : Max2( num_entities / DEFAULT_GROUP_SIZE, 1 );
+
+	if( num_entities < 1 || frames < 1 || num_groups < 1 || num_groups > num_entities ) {
+		printf( "usage: %s [entities] [frames] [groups]\n", argv[0] );
+		return 1;
+	}
+
+	char * qargv[] = { argv[0] };
+	Qcommon_Init( 1, qargv );
+
+	char names[1024];
+	int num_files = FS_GetFileList( "models/players", ".glb", names, sizeof( names ), 0, 0 );
+	const char * name = names;
+	for( int i = 0; i < num_files && num_models < MAX_BENCH_MODELS; i++, name += strlen( name ) + 1 ) {
+		if( AB_LoadModel( &models[num_models], name ) ) {
+			const Skeleton * skeleton = &models[num_models].skeleton;
+			Com_Printf( "%s: %d joints, %d key time tracks, %d clips\n", models[num_models].name,
+				skeleton->num_joints, skeleton->num_timelines, models[num_models].num_clips );
+			num_models++;
+		} else {
+			Com_Printf( "Couldn't load %s\n", name );
+		}
+	}
+
+	if( num_models == 0 ) {
+		Sys_Error( "No player models" );
+	}
+
+	// a frame's worth of poses and palettes
+	size_t arena_size = size_t( num_entities ) * 32 * 1024;
+	ArenaAllocator arena( malloc( arena_size ), arena_size );
+
+	RunStats check = AB_Run( &arena, num_entities, num_groups, Min2( frames, 500 ), AB_CHECK );
+	Com_Printf( "%d mismatched poses, %d mismatched shared poses, max palette error %g\n",
+		check.pose_mismatches, check.cache_mismatches, check.max_palette_error );
+
+	Com_Printf( "%d entities in %d groups x %d frames\n", num_entities, num_groups, frames );
+
+	uint64_t old_usec = 1;
+	for( int mode = AB_OLD; mode < AB_CHECK; mode++ ) {
+		RunStats stats = AB_Run( &arena, num_entities, num_groups, frames, mode );
+		if( mode == AB_OLD ) {
+			old_usec = Max2( stats.usec, uint64_t( 1 ) );
+		}
+		Com_Printf( "%-6s %8.2f us/entity (%.2fx)", mode_names[mode],
+			stats.usec / double( num_entities * frames ), old_usec / double( Max2( stats.usec, uint64_t( 1 ) ) ) );
+		if( mode == AB_CACHED ) {
+			Com_Printf( ", %u/%u hits (%.1f%%)", stats.cache_hits, stats.cache_lookups, 100.0 * stats.cache_hits / Max2( stats.cache_lookups, 1u ) );
+		}
+		Com_Printf( "\n" );
+	}
+
+	Qcommon_Shutdown();
+
+	bool ok = check.pose_mismatches == 0 && check.cache_mismatches == 0 && check.max_palette_error <= MAX_PALETTE_ERROR;
+	return ok ? 0 : 1;
+}
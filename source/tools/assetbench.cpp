@@ -0,0 +1,392 @@
+// assetbench.cpp -- map asset loading benchmark
+//
+// usage: assetbench [map] [passes]
+//
+// Collects every asset a client needs to play maps/<map>.bsp (carentan by
+// default): the map itself, the shader scripts, the images of the shaders
+// the map references, the models and sounds its entities name, and the
+// shared models, sounds, gfx, huds, fonts and glsl directories. Each pass
+// loads all of them through FS_LoadFile.
+//
+// The passes are run on the loose files first, then on the same assets
+// packed into a stored and a deflated pk3 in the write directory, each
+// loaded with fs_mmap 1 and fs_mmap 0. The filesystem is restarted between
+// runs so the cvar takes effect, and every file loaded from a pak must
+// hash the same as the loose one.
+
+#include "qcommon/qcommon.h"
+#include "qcommon/cmodel.h"
+#include "qalgo/hash.h"
+#include "tools/pk3writer.h"
+
+#define DEFAULT_MAP "carentan"
+#define DEFAULT_PASSES 5
+#define MAX_ASSETS 4096
+#define BENCH_PAK "zz_assetbench.pk3"
+
+static const char *shared_dirs[] = { "models", "sounds", "gfx", "huds", "fonts", "glsl" };
+
+static const char *texture_keys[] = { "map", "clampmap", "animmap", "material" };
+
+static const char *sky_suffixes[] = { "_px", "_nx", "_py", "_ny", "_pz", "_nz", "_rt", "_lf", "_ft", "_bk", "_up", "_dn" };
+
+struct Asset {
+	char name[MAX_QPATH];
+	uint64_t hash;
+	int size;
+};
+
+static Asset assets[MAX_ASSETS];
+static int num_assets;
+
+static int mismatches;
+
+//==================================================
+// COLLECTING ASSETS
+//==================================================
+
+static void AB_AddAsset( const char *name ) {
+	if( FS_FOpenFile( name, NULL, FS_READ ) == -1 ) {
+		return;
+	}
+
+	for( int i = 0; i < num_assets; i++ ) {
+		if( !Q_stricmp( assets[i].name, name ) ) {
+			return;
+		}
+	}
+
+	if( num_assets == MAX_ASSETS ) {
+		Com_Error( ERR_FATAL, "Too many assets" );
+	}
+
+	Q_strncpyz( assets[num_assets].name, name, sizeof( assets[num_assets].name ) );
+	num_assets++;
+}
+
+static void AB_AddWithExtension( const char *name, const char * const *extensions, int num_extensions ) {
+	char stripped[MAX_QPATH];
+
+	Q_strncpyz( stripped, name, sizeof( stripped ) );
+	COM_StripExtension( stripped );
+
+	const char *ext = FS_FirstExtension( stripped, extensions, num_extensions );
+	if( ext ) {
+		Q_strncatz( stripped, ext, sizeof( stripped ) );
+		AB_AddAsset( stripped );
+	}
+}
+
+static void AB_AddImage( const char *name ) {
+	if( name[0] != '$' && name[0] != '*' ) {
+		AB_AddWithExtension( name, IMAGE_EXTENSIONS, NUM_IMAGE_EXTENSIONS );
+	}
+}
+
+static void AB_AddDirectory( const char *dir ) {
+	static char files[256 * 1024];
+	char subdirs[16 * 1024];
+	char path[MAX_QPATH];
+
+	// listing with an extension leaves out the subdirectories
+	int count = FS_GetFileList( dir, ".*", files, sizeof( files ), 0, 0 );
+	const char *name = files;
+	for( int i = 0; i < count; i++, name += strlen( name ) + 1 ) {
+		Q_snprintfz( path, sizeof( path ), "%s/%s", dir, name );
+		AB_AddAsset( path );
+	}
+
+	count = FS_GetFileList( dir, "/", subdirs, sizeof( subdirs ), 0, 0 );
+	name = subdirs;
+	for( int i = 0; i < count; i++, name += strlen( name ) + 1 ) {
+		Q_snprintfz( path, sizeof( path ), "%s/%s", dir, name );
+		size_t len = strlen( path );
+		if( path[len - 1] == '/' ) {
+			path[len - 1] = '\0';
+		}
+		AB_AddDirectory( path );
+	}
+}
+
+static bool AB_MapUsesShader( cmodel_state_t *cms, const char *shader ) {
+	for( int i = 0; CM_ShaderrefName( cms, i ) != NULL; i++ ) {
+		if( !Q_stricmp( CM_ShaderrefName( cms, i ), shader ) ) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// adds the images named by the stages of the shaders the map uses
+static void AB_AddShaderImages( cmodel_state_t *cms, const char *script ) {
+	char *buf;
+	if( FS_LoadFile( script, ( void ** )&buf, NULL, 0 ) <= 0 ) {
+		return;
+	}
+
+	const char *ptr = buf;
+	while( ptr ) {
+		char name[MAX_QPATH];
+		Q_strncpyz( name, COM_ParseExt( &ptr, true ), sizeof( name ) );
+		if( !name[0] ) {
+			break;
+		}
+
+		const char *token = COM_ParseExt( &ptr, true );
+		if( strcmp( token, "{" ) ) {
+			continue;
+		}
+
+		bool used = AB_MapUsesShader( cms, name );
+		int depth = 1;
+		while( ptr && depth > 0 ) {
+			token = COM_ParseExt( &ptr, true );
+			if( !token[0] ) {
+				break;
+			}
+
+			if( !strcmp( token, "{" ) ) {
+				depth++;
+			} else if( !strcmp( token, "}" ) ) {
+				depth--;
+			} else if( used && !Q_stricmp( token, "skyparms" ) ) {
+				char sky[MAX_QPATH];
+				Q_strncpyz( sky, COM_ParseExt( &ptr, false ), sizeof( sky ) );
+				for( size_t i = 0; i < ARRAY_COUNT( sky_suffixes ); i++ ) {
+					char face[MAX_QPATH];
+					Q_snprintfz( face, sizeof( face ), "%s%s", sky, sky_suffixes[i] );
+					AB_AddImage( face );
+				}
+			} else if( used ) {
+				for( size_t i = 0; i < ARRAY_COUNT( texture_keys ); i++ ) {
+					if( Q_stricmp( token, texture_keys[i] ) ) {
+						continue;
+					}
+
+					// animmap has a frequency first, and every key can list several images
+					for( token = COM_ParseExt( &ptr, false ); token[0]; token = COM_ParseExt( &ptr, false ) ) {
+						AB_AddImage( token );
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	FS_FreeFile( buf );
+}
+
+static void AB_AddEntityAssets( cmodel_state_t *cms ) {
+	const char *ptr = CM_EntityString( cms );
+
+	while( ptr ) {
+		char key[MAX_QPATH];
+		Q_strncpyz( key, COM_Parse( &ptr ), sizeof( key ) );
+		if( !key[0] ) {
+			break;
+		}
+		if( !strcmp( key, "{" ) || !strcmp( key, "}" ) ) {
+			continue;
+		}
+
+		const char *value = COM_Parse( &ptr );
+		if( !Q_stricmp( key, "model" ) && value[0] != '*' ) {
+			AB_AddAsset( value );
+		} else if( !Q_stricmp( key, "noise" ) ) {
+			AB_AddWithExtension( value, SOUND_EXTENSIONS, NUM_SOUND_EXTENSIONS );
+		}
+	}
+}
+
+static void AB_CollectAssets( const char *map ) {
+	char bsp[MAX_QPATH];
+	unsigned checksum;
+
+	Q_snprintfz( bsp, sizeof( bsp ), "maps/%s.bsp", map );
+	AB_AddAsset( bsp );
+	if( num_assets == 0 ) {
+		Com_Error( ERR_FATAL, "Couldn't find %s", bsp );
+	}
+
+	cmodel_state_t *cms = CM_New( NULL );
+	CM_AddReference( cms );
+	CM_LoadMap( cms, bsp, false, &checksum );
+
+	int map_assets = num_assets;
+
+	static char list[64 * 1024];
+	int count = FS_GetFileList( "scripts", ".shader", list, sizeof( list ), 0, 0 );
+	const char *name = list;
+	for( int i = 0; i < count; i++, name += strlen( name ) + 1 ) {
+		char script[MAX_QPATH];
+		Q_snprintfz( script, sizeof( script ), "scripts/%s", name );
+		AB_AddAsset( script );
+		AB_AddShaderImages( cms, script );
+	}
+
+	// shaders without a script use the image with the same name
+	for( int i = 0; CM_ShaderrefName( cms, i ) != NULL; i++ ) {
+		AB_AddImage( CM_ShaderrefName( cms, i ) );
+	}
+
+	AB_AddEntityAssets( cms );
+
+	CM_ReleaseReference( cms );
+
+	map_assets = num_assets - map_assets;
+
+	for( size_t i = 0; i < ARRAY_COUNT( shared_dirs ); i++ ) {
+		AB_AddDirectory( shared_dirs[i] );
+	}
+
+	Com_Printf( "%s: %d assets, %d of them shader scripts, images and entity assets\n", bsp, num_assets, map_assets );
+}
+
+//==================================================
+// BENCHMARK
+//==================================================
+
+static void AB_RestartFS( const char *mmap ) {
+	FS_Shutdown();
+	Cvar_ForceSet( "fs_mmap", mmap );
+	FS_Init();
+}
+
+// returns the total size, and records or checks the hash of every asset
+static size_t AB_LoadAll( bool record, const char *pak ) {
+	size_t total = 0;
+
+	for( int i = 0; i < num_assets; i++ ) {
+		Asset *asset = &assets[i];
+		void *buf;
+
+		int len = FS_LoadFile( asset->name, &buf, NULL, 0 );
+		uint64_t hash = len >= 0 ? Hash64( buf, len ) : 0;
+		if( buf ) {
+			FS_FreeFile( buf );
+		}
+
+		if( record ) {
+			asset->hash = hash;
+			asset->size = len;
+		} else if( hash != asset->hash || len != asset->size ) {
+			Com_Printf( "FAILED: %s differs when loaded from %s\n", asset->name, pak ? pak : "loose files" );
+			mismatches++;
+		}
+
+		total += Max2( len, 0 );
+	}
+
+	return total;
+}
+
+static void AB_Run( const char *label, const char *pak, int passes ) {
+	int files_from_pak = 0;
+	for( int i = 0; pak && i < num_assets; i++ ) {
+		const char *pakname = FS_PakNameForFile( assets[i].name );
+		if( pakname && !Q_stricmp( COM_FileBase( pakname ), BENCH_PAK ) ) {
+			files_from_pak++;
+		}
+	}
+	if( pak && files_from_pak != num_assets ) {
+		Com_Printf( "FAILED: only %d of %d assets come from %s\n", files_from_pak, num_assets, pak );
+		mismatches++;
+	}
+
+	uint64_t first = 0, best = UINT64_MAX, sum = 0;
+	size_t total = 0;
+
+	for( int p = 0; p < passes; p++ ) {
+		uint64_t start = Sys_Microseconds();
+		total = AB_LoadAll( pak == NULL && p == 0, pak );
+		uint64_t usec = Sys_Microseconds() - start;
+
+		if( p == 0 ) {
+			first = usec;
+		}
+		best = Min2( best, usec );
+		sum += usec;
+	}
+
+	Com_Printf( "%-20s %4d files %7.1f MB  first %8.2f ms  best %8.2f ms  mean %8.2f ms\n",
+		label, num_assets, total / ( 1024.0 * 1024.0 ), first / 1000.0, best / 1000.0, sum / 1000.0 / passes );
+}
+
+static bool AB_WritePaks( const char *stored, const char *deflated ) {
+	PK3Writer storedPak, deflatedPak;
+	memset( &storedPak, 0, sizeof( storedPak ) );
+	memset( &deflatedPak, 0, sizeof( deflatedPak ) );
+
+	for( int i = 0; i < num_assets; i++ ) {
+		void *buf;
+		int len = FS_LoadFile( assets[i].name, &buf, NULL, 0 );
+		PK3_AddFile( &storedPak, assets[i].name, ( const uint8_t * )buf, Max2( len, 0 ), false );
+		PK3_AddFile( &deflatedPak, assets[i].name, ( const uint8_t * )buf, Max2( len, 0 ), true );
+		if( buf ) {
+			FS_FreeFile( buf );
+		}
+	}
+
+	bool ok = PK3_Write( &storedPak, stored );
+	return PK3_Write( &deflatedPak, deflated ) && ok;
+}
+
+static void AB_RemovePak( const char *pak ) {
+	char indexname[1024];
+	FS_PK3IndexName( pak, indexname, sizeof( indexname ) );
+	remove( indexname );
+	remove( pak );
+}
+
+int main( int argc, char **argv ) {
+	const char *map = argc >= 2 ? argv[1] : DEFAULT_MAP;
+	int passes = argc >= 3 ? atoi( argv[2] ) : DEFAULT_PASSES;
+
+	if( passes < 1 ) {
+		printf( "usage: %s [map] [passes]\n", argv[0] );
+		return 1;
+	}
+
+	char *qargv[] = { argv[0] };
+	Qcommon_Init( 1, qargv );
+
+	AB_CollectAssets( map );
+
+	char stored[1024], deflated[1024], pak[1024];
+	Q_snprintfz( stored, sizeof( stored ), "%s/%s/assetbench_stored.tmp", FS_WriteDirectory(), FS_BaseGameDirectory() );
+	Q_snprintfz( deflated, sizeof( deflated ), "%s/%s/assetbench_deflated.tmp", FS_WriteDirectory(), FS_BaseGameDirectory() );
+	Q_snprintfz( pak, sizeof( pak ), "%s/%s/%s", FS_WriteDirectory(), FS_BaseGameDirectory(), BENCH_PAK );
+	FS_CreateAbsolutePath( pak );
+
+	AB_RestartFS( "1" );
+	AB_Run( "loose files", NULL, passes );
+
+	if( !AB_WritePaks( stored, deflated ) ) {
+		Com_Error( ERR_FATAL, "Couldn't write the pk3s" );
+	}
+
+	// only one of them is renamed into place at a time, so the other can't shadow it
+	const char *sources[] = { stored, deflated };
+	const char *labels[][2] = { { "stored, mapped", "stored, read" }, { "deflated, mapped", "deflated, read" } };
+	for( int i = 0; i < 2; i++ ) {
+		FS_Shutdown();
+		rename( sources[i], pak );
+		FS_Init();
+
+		AB_RestartFS( "1" );
+		AB_Run( labels[i][0], pak, passes );
+		AB_RestartFS( "0" );
+		AB_Run( labels[i][1], pak, passes );
+
+		FS_Shutdown();
+		AB_RemovePak( pak );
+		FS_Init();
+	}
+
+	Com_Printf( "%d mismatches\n", mismatches );
+
+	Qcommon_Shutdown();
+
+	return mismatches == 0 ? 0 : 1;
+}
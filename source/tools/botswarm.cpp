@@ -0,0 +1,1118 @@
+// botswarm.cpp -- headless bot-swarm load generator
+//
+// usage: botswarm [-n clients] [-t seconds] [-pps packets] [-rcon password] [-flood packets]
+//                 [-download file] [-window blocks] [-lag msec] [server]
+//
+// Connects a swarm of clients to a server through the real challenge/connect
+// handshake and netchan, then has them join the game, send scripted usercmds
+// and parse every snapshot with SNAP_ParseFrame. Every few seconds it prints
+// traffic per client, dropped packets and lost snapshots, and when given the
+// rcon password it also prints the server's frame times.
+//
+// A server on loopback gets one source address per client out of 127.1/16,
+// so sv_iplimit doesn't have to be raised. Remote servers see every client
+// come from this machine and need sv_iplimit >= the number of clients.
+//
+// -flood additionally sends that many getstatus queries a second from one
+// more address, to check what connectionless floods cost the server.
+//
+// -download has every client download that file from the server over and
+// over once it's in the game, and reports the download throughput. The file
+// has to be something the server lets clients download, like a server demo
+// ("demos/server/name.cddemo"). -window sets how many blocks each client
+// keeps in flight, 0 asks for one block at a time like old clients did.
+// -lag holds every packet the clients receive for that long before parsing
+// it, which adds the same to their round trip time.
+
+#include <deque>
+
+#include "qcommon/qcommon.h"
+#include "qcommon/version.h"
+#include "qalgo/rng.h"
+#include "cgame/cg_public.h"
+
+#define BS_DEFAULT_CLIENTS 64
+#define BS_DEFAULT_SECONDS 30
+#define BS_DEFAULT_PPS 62
+
+#define BS_RESEND_MSEC 1000
+#define BS_CONNECT_ATTEMPTS 5
+#define BS_HANDSHAKE_TIMEOUT 15000
+#define BS_ACTIVE_TIMEOUT 10000
+#define BS_REPORT_MSEC 5000
+#define BS_UCMD_RESEND 3
+#define BS_MAX_CONNECTING 16
+
+// each client keeps its last few valid frames as delta bases, see BS_ParseFrame
+#define BS_SNAP_BACKUP 4
+#define BS_AREABYTES 256
+
+#define BS_DOWNLOAD_RETRY_MSEC 3000
+
+enum BotState {
+	BOT_IDLE,
+	BOT_CHALLENGING,
+	BOT_CONNECTING,
+	BOT_HANDSHAKE,
+	BOT_ACTIVE,
+	BOT_DROPPED,
+};
+
+struct BotStats {
+	uint64_t bytes_in, bytes_out;
+	uint64_t packets_in, packets_out;
+	int dropped;
+	int snaps;
+	int lost_snaps;
+	int bad_snaps;
+	uint64_t download_bytes;
+	int downloads;
+};
+
+// mirrors the client's windowed download, minus keeping the data
+struct BotDownload {
+	char name[MAX_QPATH];
+	int size;
+	int offset;
+	int blockindex[DOWNLOAD_MAX_WINDOW];    // blocks received ahead of offset, -1 for free slots
+	int blocksize[DOWNLOAD_MAX_WINDOW];
+	bool ackpending;
+	int64_t last_progress;
+};
+
+struct DelayedPacket {
+	int64_t time;
+	size_t size;
+	uint8_t data[MAX_PACKETLEN];
+};
+
+struct Bot {
+	int id;
+	BotState state;
+	int64_t state_time;
+	int64_t last_send;
+	int64_t last_receive;
+	int attempts;
+
+	socket_t socket;
+	netchan_t netchan;
+	int qport;
+	int challenge;
+
+	int64_t reliable_sequence;
+	int64_t reliable_ack;
+	int64_t last_server_command;
+	char reliable_commands[MAX_RELIABLE_COMMANDS][MAX_STRING_CHARS];
+
+	usercmd_t cmds[CMD_BACKUP];
+	int64_t cmd_num;
+	int64_t ucmd_ack;
+	int64_t last_cmd_time;
+
+	snapshot_t *snaps;
+	uint8_t areabits[BS_SNAP_BACKUP][BS_AREABYTES];
+	int64_t last_frame;
+	int64_t last_server_time;
+	int64_t last_frame_received;
+
+	RNG rng;
+	float yaw, yaw_speed;
+	int move_time;
+	int8_t forwardmove, sidemove;
+
+	BotDownload download;
+	std::deque< DelayedPacket > *delayed;
+
+	BotStats stats;
+	BotStats reported;
+};
+
+static netadr_t server_address;
+static bool unique_addresses;
+static int pps = BS_DEFAULT_PPS;
+static const char *download_name;
+static int download_window = DOWNLOAD_MAX_WINDOW;
+static int lag;
+
+static Bot *bots;
+static int num_bots;
+
+// scratch frames shared by all clients, only valid for the duration of one BS_ParseFrame
+static snapshot_t *scratch;
+static uint8_t scratch_areabits[UPDATE_BACKUP][BS_AREABYTES];
+static entity_state_t baselines[MAX_EDICTS];
+
+static socket_t rcon_socket;
+static const char *rcon_password;
+
+static socket_t flood_socket;
+static int flood_rate;
+static int64_t flood_sent, flood_answered;
+static int64_t flood_reported_sent, flood_reported_answered;
+
+static uint8_t msg_data[MAX_MSGLEN];
+
+//==================================================
+// CONNECTION
+//==================================================
+
+static void BS_SetState( Bot *bot, BotState state, int64_t now ) {
+	bot->state = state;
+	bot->state_time = now;
+	bot->attempts = 0;
+}
+
+static void BS_Drop( Bot *bot, const char *reason, int64_t now ) {
+	Com_Printf( "client %i dropped: %s\n", bot->id, reason );
+	BS_SetState( bot, BOT_DROPPED, now );
+}
+
+static void BS_AddReliableCommand( Bot *bot, const char *cmd, int64_t now ) {
+	if( bot->reliable_sequence > bot->reliable_ack + MAX_RELIABLE_COMMANDS ) {
+		BS_Drop( bot, "client command overflow", now );
+		return;
+	}
+
+	bot->reliable_sequence++;
+	Q_strncpyz( bot->reliable_commands[bot->reliable_sequence & ( MAX_RELIABLE_COMMANDS - 1 )], cmd, sizeof( bot->reliable_commands[0] ) );
+}
+
+/*
+* BS_ResetConnection
+*
+* Forget everything about the last connection, ready for a new challenge
+*/
+static void BS_ResetConnection( Bot *bot, int64_t now ) {
+	bot->reliable_sequence = 0;
+	bot->reliable_ack = 0;
+	bot->last_server_command = 0;
+	bot->cmd_num = 0;
+	bot->ucmd_ack = 0;
+	bot->last_frame = -1;
+
+	for( int i = 0; i < BS_SNAP_BACKUP; i++ ) {
+		bot->snaps[i].valid = false;
+	}
+
+	BS_SetState( bot, BOT_CHALLENGING, now );
+	bot->last_send = 0;
+}
+
+static void BS_SendOutOfBand( Bot *bot, const char *text, int64_t now ) {
+	Netchan_OutOfBandPrint( &bot->socket, &server_address, "%s", text );
+	bot->stats.bytes_out += strlen( text ) + 4;
+	bot->stats.packets_out++;
+	bot->last_send = now;
+}
+
+static void BS_SendConnectionless( Bot *bot, int64_t now ) {
+	if( now - bot->last_send < BS_RESEND_MSEC ) {
+		return;
+	}
+
+	if( bot->attempts >= BS_CONNECT_ATTEMPTS ) {
+		BS_Drop( bot, "no response from server", now );
+		return;
+	}
+	bot->attempts++;
+
+	if( bot->state == BOT_CHALLENGING ) {
+		BS_SendOutOfBand( bot, "getchallenge\n", now );
+	} else {
+		char userinfo[MAX_INFO_STRING];
+		Q_snprintfz( userinfo, sizeof( userinfo ), "\\name\\swarm%03i", bot->id );
+		BS_SendOutOfBand( bot, va( "connect %i %i %i \"%s\"\n", APP_PROTOCOL_VERSION, bot->qport, bot->challenge, userinfo ), now );
+	}
+}
+
+static void BS_ConnectionlessPacket( Bot *bot, msg_t *msg, int64_t now ) {
+	MSG_BeginReading( msg );
+	MSG_ReadInt32( msg ); // skip the -1
+
+	Cmd_TokenizeString( MSG_ReadStringLine( msg ) );
+	const char *c = Cmd_Argv( 0 );
+
+	if( !strcmp( c, "challenge" ) ) {
+		if( bot->state == BOT_CHALLENGING ) {
+			bot->challenge = atoi( Cmd_Argv( 1 ) );
+			BS_SetState( bot, BOT_CONNECTING, now );
+			bot->last_send = 0;
+			BS_SendConnectionless( bot, now );
+		}
+	} else if( !strcmp( c, "client_connect" ) ) {
+		if( bot->state == BOT_CONNECTING ) {
+			Netchan_Setup( &bot->netchan, &bot->socket, &server_address, bot->qport );
+			BS_SetState( bot, BOT_HANDSHAKE, now );
+			BS_AddReliableCommand( bot, "new", now );
+		}
+	} else if( !strcmp( c, "reject" ) ) {
+		MSG_ReadStringLine( msg ); // reject type
+		MSG_ReadStringLine( msg ); // reject flags
+		BS_Drop( bot, va( "rejected: %s", MSG_ReadStringLine( msg ) ), now );
+	}
+}
+
+//==================================================
+// SERVER MESSAGES
+//==================================================
+
+static void BS_ParseServerData( Bot *bot, msg_t *msg, int64_t now ) {
+	MSG_ReadInt32( msg ); // protocol
+	int servercount = MSG_ReadInt32( msg );
+	MSG_ReadInt16( msg ); // snapFrameTime
+	MSG_ReadString( msg ); // game directory
+	MSG_ReadInt16( msg ); // player number
+	MSG_ReadString( msg ); // level name
+
+	int bitflags = MSG_ReadUint8( msg );
+	if( bitflags & SV_BITFLAGS_RELIABLE ) {
+		BS_Drop( bot, "server wants a reliable connection", now );
+		return;
+	}
+	if( bitflags & SV_BITFLAGS_HTTP ) {
+		if( bitflags & SV_BITFLAGS_HTTP_BASEURL ) {
+			MSG_ReadString( msg );
+		} else {
+			MSG_ReadInt16( msg );
+		}
+	}
+
+	int numpure = MSG_ReadInt16( msg );
+	for( int i = 0; i < numpure; i++ ) {
+		MSG_ReadString( msg );
+		MSG_ReadInt32( msg );
+	}
+
+	// the server resets both command streams when it sends serverdata
+	bot->last_server_command = 0;
+	bot->reliable_sequence = 0;
+	bot->reliable_ack = 0;
+
+	BS_AddReliableCommand( bot, va( "configstrings %i 0", servercount ), now );
+}
+
+//==================================================
+// DOWNLOADS
+//==================================================
+
+static void BS_RequestDownload( Bot *bot, int64_t now ) {
+	BS_AddReliableCommand( bot, va( "download 0 \"%s\"", download_name ), now );
+}
+
+static void BS_SendDownloadAck( Bot *bot, int64_t now ) {
+	BotDownload *dl = &bot->download;
+
+	if( download_window == 0 ) {
+		BS_AddReliableCommand( bot, va( "nextdl \"%s\" %i", dl->name, dl->offset ), now );
+	} else {
+		int base = dl->offset / DOWNLOAD_BLOCK_SIZE;
+		unsigned sack = 0;
+		for( int i = 1; i < download_window; i++ ) {
+			if( dl->blockindex[( base + i ) % DOWNLOAD_MAX_WINDOW] == base + i ) {
+				sack |= 1u << i;
+			}
+		}
+		BS_AddReliableCommand( bot, va( "nextdl \"%s\" %i %i %x", dl->name, dl->offset, download_window, sack ), now );
+	}
+
+	dl->ackpending = false;
+}
+
+static void BS_FinishDownload( Bot *bot, int64_t now ) {
+	BS_AddReliableCommand( bot, va( "nextdl \"%s\" -1", bot->download.name ), now );
+	bot->download.name[0] = '\0';
+	bot->stats.downloads++;
+
+	// and again, to measure sustained throughput
+	BS_RequestDownload( bot, now );
+}
+
+/*
+* BS_InitDownload
+*
+* initdownload name size checksum allow_localhttp url
+*/
+static void BS_InitDownload( Bot *bot, int64_t now ) {
+	BotDownload *dl = &bot->download;
+
+	dl->size = atoi( Cmd_Argv( 2 ) );
+	if( dl->size < 0 ) {
+		BS_Drop( bot, va( "download refused: %s", Cmd_Argv( 5 ) ), now );
+		return;
+	}
+
+	Q_strncpyz( dl->name, Cmd_Argv( 1 ), sizeof( dl->name ) );
+	dl->offset = 0;
+	dl->ackpending = false;
+	dl->last_progress = now;
+	for( int i = 0; i < DOWNLOAD_MAX_WINDOW; i++ ) {
+		dl->blockindex[i] = -1;
+	}
+
+	if( dl->size == 0 ) {
+		BS_FinishDownload( bot, now );
+		return;
+	}
+
+	BS_SendDownloadAck( bot, now );
+}
+
+static void BS_ParseDownload( Bot *bot, msg_t *msg, int64_t now ) {
+	BotDownload *dl = &bot->download;
+
+	const char *name = MSG_ReadString( msg );
+	int offset = MSG_ReadInt32( msg );
+	int size = MSG_ReadInt32( msg );
+	if( size < 0 || msg->readcount + size > msg->cursize ) {
+		BS_Drop( bot, "bad download message", now );
+		return;
+	}
+	MSG_SkipData( msg, size );
+
+	if( !dl->name[0] || Q_stricmp( name, dl->name ) || offset < 0 || offset + size > dl->size ) {
+		return;
+	}
+
+	int before = dl->offset;
+	if( offset > dl->offset ) {
+		int base = dl->offset / DOWNLOAD_BLOCK_SIZE;
+		int block = offset / DOWNLOAD_BLOCK_SIZE;
+		if( download_window > 0 && offset % DOWNLOAD_BLOCK_SIZE == 0 && block - base < download_window ) {
+			dl->blockindex[block % DOWNLOAD_MAX_WINDOW] = block;
+			dl->blocksize[block % DOWNLOAD_MAX_WINDOW] = size;
+		}
+	} else if( offset + size > dl->offset ) {
+		dl->offset = offset + size;
+		while( dl->offset < dl->size ) {
+			int block = dl->offset / DOWNLOAD_BLOCK_SIZE;
+			int slot = block % DOWNLOAD_MAX_WINDOW;
+			if( dl->blockindex[slot] != block ) {
+				break;
+			}
+			dl->offset = block * DOWNLOAD_BLOCK_SIZE + dl->blocksize[slot];
+			dl->blockindex[slot] = -1;
+		}
+	}
+
+	if( dl->offset != before ) {
+		bot->stats.download_bytes += dl->offset - before;
+		dl->last_progress = now;
+	}
+
+	if( dl->offset == dl->size ) {
+		BS_FinishDownload( bot, now );
+	} else if( download_window == 0 ) {
+		if( dl->offset != before ) {
+			BS_SendDownloadAck( bot, now );
+		}
+	} else {
+		// acks go out with the next packet, like the client sends them once a frame
+		dl->ackpending = true;
+	}
+}
+
+static void BS_ExecuteServerCommand( Bot *bot, const char *text, int64_t now ) {
+	Cmd_TokenizeString( text );
+	const char *c = Cmd_Argv( 0 );
+
+	if( !strcmp( c, "cmd" ) ) {
+		BS_AddReliableCommand( bot, Cmd_Args(), now );
+	} else if( !strcmp( c, "precache" ) ) {
+		BS_AddReliableCommand( bot, va( "begin %i", atoi( Cmd_Argv( 1 ) ) ), now );
+	} else if( !strcmp( c, "reconnect" ) || !strcmp( c, "forcereconnect" ) ) {
+		Com_Printf( "client %i reconnecting\n", bot->id );
+		BS_ResetConnection( bot, now );
+	} else if( !strcmp( c, "disconnect" ) ) {
+		BS_Drop( bot, va( "disconnected: %s", Cmd_Argv( 1 ) ), now );
+	} else if( !strcmp( c, "initdownload" ) ) {
+		BS_InitDownload( bot, now );
+	}
+}
+
+/*
+* BS_CopySnapshot
+*
+* Copies the parts of a frame that are in use. Frames are mostly empty
+* arrays, so this is much cheaper than copying the whole thing.
+*/
+static void BS_CopySnapshot( snapshot_t *dst, const snapshot_t *src ) {
+	uint8_t *areabits = dst->areabits;
+	size_t areabytes = dst->areabytes;
+
+	memcpy( dst, src, offsetof( snapshot_t, playerStates ) );
+	memcpy( dst->playerStates, src->playerStates, src->numplayers * sizeof( src->playerStates[0] ) );
+	dst->numEntities = src->numEntities;
+	memcpy( dst->parsedEntities, src->parsedEntities, src->numEntities * sizeof( src->parsedEntities[0] ) );
+	dst->gameState = src->gameState;
+
+	dst->areabits = areabits;
+	dst->areabytes = areabytes;
+	memcpy( dst->areabits, src->areabits, Min2( areabytes, src->areabytes ) );
+}
+
+/*
+* BS_ParseFrame
+*
+* SNAP_ParseFrame wants a full UPDATE_BACKUP ring of frames, which at over
+* 350KB a frame is far too much per client. Instead each client keeps its
+* last few valid frames, and they're restored into a shared scratch ring
+* around each parse. The server deltas from the last frame we acked, which
+* is nearly always the newest one.
+*/
+static void BS_ParseFrame( Bot *bot, msg_t *msg, int64_t now ) {
+	for( int i = 0; i < UPDATE_BACKUP; i++ ) {
+		scratch[i].valid = false;
+	}
+	for( int i = 0; i < BS_SNAP_BACKUP; i++ ) {
+		if( bot->snaps[i].valid ) {
+			BS_CopySnapshot( &scratch[bot->snaps[i].serverFrame & UPDATE_MASK], &bot->snaps[i] );
+		}
+	}
+
+	snapshot_t *last = bot->last_frame >= 0 ? &scratch[bot->last_frame & UPDATE_MASK] : NULL;
+	snapshot_t *snap = SNAP_ParseFrame( msg, last, scratch, baselines, 0 );
+
+	if( !snap->valid ) {
+		bot->stats.bad_snaps++;
+		return;
+	}
+
+	if( bot->last_frame >= 0 && snap->serverFrame > bot->last_frame + 1 ) {
+		bot->stats.lost_snaps += snap->serverFrame - bot->last_frame - 1;
+	}
+	bot->stats.snaps++;
+
+	BS_CopySnapshot( &bot->snaps[snap->serverFrame & ( BS_SNAP_BACKUP - 1 )], snap );
+	bot->last_frame = snap->serverFrame;
+	bot->last_server_time = snap->serverTime;
+	bot->last_frame_received = now;
+
+	if( bot->state == BOT_HANDSHAKE ) {
+		BS_SetState( bot, BOT_ACTIVE, now );
+		BS_AddReliableCommand( bot, "join", now );
+		if( download_name != NULL ) {
+			BS_RequestDownload( bot, now );
+		}
+	}
+}
+
+static void BS_ParseServerMessage( Bot *bot, msg_t *msg, int64_t now ) {
+	while( msg->readcount < msg->cursize && bot->state >= BOT_HANDSHAKE && bot->state != BOT_DROPPED ) {
+		int cmd = MSG_ReadUint8( msg );
+
+		switch( cmd ) {
+			case svc_nop:
+				break;
+
+			case svc_servercmd: {
+				int cmdNum = MSG_ReadInt32( msg );
+				const char *text = MSG_ReadString( msg );
+				if( cmdNum <= bot->last_server_command ) {
+					break;
+				}
+				bot->last_server_command = cmdNum;
+				BS_ExecuteServerCommand( bot, text, now );
+			} break;
+
+			case svc_servercs:
+				BS_ExecuteServerCommand( bot, MSG_ReadString( msg ), now );
+				break;
+
+			case svc_serverdata:
+				if( bot->state != BOT_HANDSHAKE ) {
+					return; // serverdata is always sent alone
+				}
+				BS_ParseServerData( bot, msg, now );
+				break;
+
+			case svc_spawnbaseline:
+				SNAP_ParseBaseline( msg, baselines );
+				break;
+
+			case svc_clcack:
+				bot->reliable_ack = MSG_ReadUintBase128( msg );
+				bot->ucmd_ack = MSG_ReadUintBase128( msg );
+				break;
+
+			case svc_frame:
+				BS_ParseFrame( bot, msg, now );
+				break;
+
+			case svc_download:
+				BS_ParseDownload( bot, msg, now );
+				break;
+
+			case svc_extension: {
+				MSG_ReadUint8( msg ); // extension id
+				MSG_ReadUint8( msg ); // version number
+				int len = MSG_ReadInt16( msg );
+				MSG_SkipData( msg, len );
+			} break;
+
+			default:
+				BS_Drop( bot, va( "illegible server message %i", cmd ), now );
+				return;
+		}
+	}
+
+	if( msg->readcount > msg->cursize ) {
+		BS_Drop( bot, "bad server message", now );
+	}
+}
+
+static void BS_ProcessPacket( Bot *bot, msg_t *msg, int64_t now ) {
+	bot->stats.bytes_in += msg->cursize;
+	bot->stats.packets_in++;
+	bot->last_receive = now;
+
+	if( *(int *)msg->data == -1 ) {
+		BS_ConnectionlessPacket( bot, msg, now );
+		return;
+	}
+
+	if( bot->state < BOT_HANDSHAKE || bot->state == BOT_DROPPED || msg->cursize < 8 ) {
+		return;
+	}
+
+	if( !Netchan_Process( &bot->netchan, msg ) ) {
+		return;
+	}
+	bot->stats.dropped += bot->netchan.dropped;
+
+	MSG_BeginReading( msg );
+	MSG_ReadInt32( msg ); // sequence
+	MSG_ReadInt32( msg ); // sequence_ack
+	if( msg->compressed && Netchan_DecompressMessage( msg ) < 0 ) {
+		return;
+	}
+
+	BS_ParseServerMessage( bot, msg, now );
+}
+
+static void BS_ReadPackets( Bot *bot, int64_t now ) {
+	msg_t msg;
+	netadr_t from;
+
+	while( true ) {
+		MSG_Init( &msg, msg_data, sizeof( msg_data ) );
+		int ret = NET_GetPacket( &bot->socket, &from, &msg );
+		if( ret == 0 ) {
+			break;
+		}
+		if( ret == -1 ) {
+			continue;
+		}
+
+		if( lag > 0 ) {
+			if( msg.cursize <= MAX_PACKETLEN ) {
+				bot->delayed->emplace_back();
+				DelayedPacket *packet = &bot->delayed->back();
+				packet->time = now + lag;
+				packet->size = msg.cursize;
+				memcpy( packet->data, msg.data, msg.cursize );
+			}
+			continue;
+		}
+
+		BS_ProcessPacket( bot, &msg, now );
+	}
+
+	while( lag > 0 && !bot->delayed->empty() && bot->delayed->front().time <= now ) {
+		const DelayedPacket *packet = &bot->delayed->front();
+		MSG_Init( &msg, msg_data, sizeof( msg_data ) );
+		MSG_CopyData( &msg, packet->data, packet->size );
+		bot->delayed->pop_front();
+
+		BS_ProcessPacket( bot, &msg, now );
+	}
+}
+
+//==================================================
+// CLIENT MESSAGES
+//==================================================
+
+/*
+* BS_ScriptUcmd
+*
+* Runs, strafes, turns, jumps and shoots in a pattern that's different for
+* every client but the same from run to run
+*/
+static void BS_ScriptUcmd( Bot *bot, usercmd_t *cmd, int64_t now ) {
+	int msec = bot->last_cmd_time ? now - bot->last_cmd_time : 1000 / pps;
+	bot->last_cmd_time = now;
+
+	bot->move_time -= msec;
+	if( bot->move_time <= 0 ) {
+		bot->move_time = 500 + random_uniform( &bot->rng, 0, 1500 );
+		bot->forwardmove = random_uniform( &bot->rng, 0, 3 ) ? 127 : -127;
+		bot->sidemove = int8_t( random_uniform( &bot->rng, -1, 2 ) * 127 );
+		bot->yaw_speed = random_float11( &bot->rng ) * 180.0f;
+	}
+	bot->yaw = AngleNormalize360( bot->yaw + bot->yaw_speed * msec * 0.001f );
+
+	memset( cmd, 0, sizeof( *cmd ) );
+	cmd->msec = Clamp( 1, msec, 255 );
+	cmd->serverTimeStamp = bot->last_server_time + ( now - bot->last_frame_received );
+	cmd->angles[YAW] = ANGLE2SHORT( bot->yaw );
+	cmd->forwardmove = bot->forwardmove;
+	cmd->sidemove = bot->sidemove;
+	cmd->upmove = random_p( &bot->rng, 0.02f ) ? 127 : 0;
+	if( ( now / 1000 + bot->id ) % 4 == 0 ) {
+		cmd->buttons |= BUTTON_ATTACK;
+	}
+}
+
+static void BS_WriteUcmds( Bot *bot, msg_t *msg, int64_t now ) {
+	bot->cmd_num++;
+	BS_ScriptUcmd( bot, &bot->cmds[bot->cmd_num & CMD_MASK], now );
+
+	int64_t head = bot->cmd_num + 1;
+	int64_t first = Max2( bot->ucmd_ack + 1, head - BS_UCMD_RESEND );
+	if( head - first > CMD_MASK / 2 ) {
+		first = head - 1;
+	}
+
+	MSG_WriteUint8( msg, clc_move );
+	MSG_WriteInt32( msg, bot->last_frame );
+	MSG_WriteInt32( msg, head );
+	MSG_WriteUint8( msg, uint8_t( head - first ) );
+
+	usercmd_t nullcmd;
+	memset( &nullcmd, 0, sizeof( nullcmd ) );
+	const usercmd_t *from = &nullcmd;
+	for( int64_t i = first; i < head; i++ ) {
+		usercmd_t *cmd = &bot->cmds[i & CMD_MASK];
+		MSG_WriteDeltaUsercmd( msg, from, cmd );
+		from = cmd;
+	}
+}
+
+static void BS_SendPacket( Bot *bot, int64_t now ) {
+	msg_t msg;
+	MSG_Init( &msg, msg_data, sizeof( msg_data ) );
+	MSG_Clear( &msg );
+
+	if( bot->download.ackpending ) {
+		BS_SendDownloadAck( bot, now );
+	}
+
+	MSG_WriteUint8( &msg, clc_svcack );
+	MSG_WriteIntBase128( &msg, bot->last_server_command );
+
+	for( int64_t i = bot->reliable_ack + 1; i <= bot->reliable_sequence; i++ ) {
+		MSG_WriteUint8( &msg, clc_clientcommand );
+		MSG_WriteIntBase128( &msg, i );
+		MSG_WriteString( &msg, bot->reliable_commands[i & ( MAX_RELIABLE_COMMANDS - 1 )] );
+	}
+
+	if( bot->state == BOT_ACTIVE ) {
+		BS_WriteUcmds( bot, &msg, now );
+	}
+
+	Netchan_PushAllFragments( &bot->netchan );
+	if( msg.cursize > 60 ) {
+		Netchan_CompressMessage( &msg );
+	}
+	Netchan_Transmit( &bot->netchan, &msg );
+
+	bot->stats.bytes_out += msg.cursize;
+	bot->stats.packets_out++;
+	bot->last_send = now;
+}
+
+static void BS_Disconnect( Bot *bot, int64_t now ) {
+	if( bot->state < BOT_HANDSHAKE || bot->state == BOT_DROPPED ) {
+		return;
+	}
+
+	// the server only acks commands in snapshots, so send it a few times like the client does
+	BS_AddReliableCommand( bot, "disconnect", now );
+	for( int i = 0; i < 3; i++ ) {
+		BS_SendPacket( bot, now );
+	}
+}
+
+//==================================================
+// SWARM
+//==================================================
+
+static void BS_InitBot( Bot *bot, int id ) {
+	bot->id = id;
+	bot->qport = ( Netchan_GamePort() + id ) & 0xffff;
+	bot->rng = new_rng( id, 0 );
+	bot->yaw = random_float01( &bot->rng ) * 360.0f;
+
+	bot->snaps = ( snapshot_t * )Mem_ZoneMalloc( BS_SNAP_BACKUP * sizeof( snapshot_t ) );
+	for( int i = 0; i < BS_SNAP_BACKUP; i++ ) {
+		bot->snaps[i].areabits = bot->areabits[i];
+		bot->snaps[i].areabytes = BS_AREABYTES;
+	}
+
+	netadr_t address;
+	NET_InitAddress( &address, server_address.type );
+	if( unique_addresses ) {
+		address.address.ipv4.ip[0] = 127;
+		address.address.ipv4.ip[1] = 1;
+		address.address.ipv4.ip[2] = ( id + 1 ) >> 8;
+		address.address.ipv4.ip[3] = ( id + 1 ) & 0xff;
+	}
+
+	if( !NET_OpenSocket( &bot->socket, SOCKET_UDP, &address, false ) ) {
+		Com_Error( ERR_FATAL, "Couldn't open a socket for client %i: %s\n", id, NET_ErrorString() );
+	}
+
+	if( lag > 0 ) {
+		bot->delayed = new std::deque< DelayedPacket >();
+	}
+
+	bot->state = BOT_IDLE;
+}
+
+static void BS_Frame( Bot *bot, int64_t now ) {
+	if( bot->state == BOT_IDLE || bot->state == BOT_DROPPED ) {
+		return;
+	}
+
+	BS_ReadPackets( bot, now );
+
+	switch( bot->state ) {
+		case BOT_CHALLENGING:
+		case BOT_CONNECTING:
+			BS_SendConnectionless( bot, now );
+			break;
+
+		case BOT_HANDSHAKE:
+			if( now - bot->state_time > BS_HANDSHAKE_TIMEOUT ) {
+				BS_Drop( bot, "handshake timed out", now );
+			} else if( now - bot->last_send >= 100 ) {
+				BS_SendPacket( bot, now );
+			}
+			break;
+
+		case BOT_ACTIVE:
+			if( now - bot->last_receive > BS_ACTIVE_TIMEOUT ) {
+				BS_Drop( bot, "connection timed out", now );
+				break;
+			}
+
+			// the server only retransmits windowed downloads, so nudge it if nothing's coming
+			if( bot->download.name[0] && now - bot->download.last_progress >= BS_DOWNLOAD_RETRY_MSEC ) {
+				bot->download.last_progress = now;
+				BS_SendDownloadAck( bot, now );
+			}
+
+			if( now - bot->last_send >= 1000 / pps ) {
+				BS_SendPacket( bot, now );
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+* BS_StartConnections
+*
+* Clients sharing an address have to connect one at a time, or the server
+* would mix up their challenges
+*/
+static void BS_StartConnections( int64_t now ) {
+	int max_connecting = unique_addresses ? BS_MAX_CONNECTING : 1;
+	int connecting = 0;
+
+	for( int i = 0; i < num_bots; i++ ) {
+		if( bots[i].state == BOT_CHALLENGING || bots[i].state == BOT_CONNECTING ) {
+			connecting++;
+		}
+	}
+
+	for( int i = 0; i < num_bots && connecting < max_connecting; i++ ) {
+		if( bots[i].state == BOT_IDLE ) {
+			BS_ResetConnection( &bots[i], now );
+			connecting++;
+		}
+	}
+}
+
+//==================================================
+// REPORTING
+//==================================================
+
+static void BS_RequestFrameStats() {
+	if( rcon_password == NULL ) {
+		return;
+	}
+
+	Netchan_OutOfBandPrint( &rcon_socket, &server_address, "rcon %s framestats\n", rcon_password );
+}
+
+static void BS_ReadFrameStats() {
+	msg_t msg;
+	netadr_t from;
+
+	while( true ) {
+		MSG_Init( &msg, msg_data, sizeof( msg_data ) );
+		int ret = NET_GetPacket( &rcon_socket, &from, &msg );
+		if( ret == 0 ) {
+			break;
+		}
+		if( ret == -1 || msg.cursize < 4 || *(int *)msg.data != -1 ) {
+			continue;
+		}
+
+		MSG_BeginReading( &msg );
+		MSG_ReadInt32( &msg );
+		if( strcmp( MSG_ReadStringLine( &msg ), "print" ) ) {
+			continue;
+		}
+
+		// skip the rcon echo the server prints into the reply
+		const char *stats = strstr( MSG_ReadString( &msg ), "framestats:" );
+		if( stats != NULL ) {
+			Com_Printf( "    server %s", stats );
+		}
+	}
+}
+
+static void BS_Flood( int64_t now, int64_t start ) {
+	for( int64_t due = ( now - start ) * flood_rate / 1000; flood_sent < due; flood_sent++ ) {
+		Netchan_OutOfBandPrint( &flood_socket, &server_address, "getstatus %" PRIi64 "\n", flood_sent );
+	}
+
+	msg_t msg;
+	netadr_t from;
+	while( true ) {
+		MSG_Init( &msg, msg_data, sizeof( msg_data ) );
+		int ret = NET_GetPacket( &flood_socket, &from, &msg );
+		if( ret == 0 ) {
+			break;
+		}
+		if( ret == 1 ) {
+			flood_answered++;
+		}
+	}
+}
+
+static void BS_SumStats( BotStats *total, const BotStats *stats ) {
+	total->bytes_in += stats->bytes_in;
+	total->bytes_out += stats->bytes_out;
+	total->packets_in += stats->packets_in;
+	total->packets_out += stats->packets_out;
+	total->dropped += stats->dropped;
+	total->snaps += stats->snaps;
+	total->lost_snaps += stats->lost_snaps;
+	total->bad_snaps += stats->bad_snaps;
+	total->download_bytes += stats->download_bytes;
+	total->downloads += stats->downloads;
+}
+
+static void BS_Report( const BotStats *stats, int active, int64_t msec, const char *label ) {
+	double seconds = Max2( msec, int64_t( 1 ) ) / 1000.0;
+	int clients = Max2( active, 1 );
+
+	Com_Printf( "%s: %i/%i clients active\n", label, active, num_bots );
+	Com_Printf( "    in  %8.2f KB/s per client, %6.1f packets/s per client, %i dropped\n",
+		stats->bytes_in / 1024.0 / seconds / clients, stats->packets_in / seconds / clients, stats->dropped );
+	Com_Printf( "    out %8.2f KB/s per client, %6.1f packets/s per client\n",
+		stats->bytes_out / 1024.0 / seconds / clients, stats->packets_out / seconds / clients );
+	Com_Printf( "    snapshots %.1f/s per client, %i lost, %i invalid\n",
+		stats->snaps / seconds / clients, stats->lost_snaps, stats->bad_snaps );
+	if( download_name != NULL ) {
+		Com_Printf( "    downloads %8.2f KB/s per client, %.2f KB/s total, %i completed\n",
+			stats->download_bytes / 1024.0 / seconds / clients, stats->download_bytes / 1024.0 / seconds, stats->downloads );
+	}
+}
+
+static void BS_ReportInterval( int64_t now, int64_t start, int64_t msec ) {
+	BotStats total = { };
+	int active = 0;
+
+	for( int i = 0; i < num_bots; i++ ) {
+		Bot *bot = &bots[i];
+		BotStats delta = bot->stats;
+		delta.bytes_in -= bot->reported.bytes_in;
+		delta.bytes_out -= bot->reported.bytes_out;
+		delta.packets_in -= bot->reported.packets_in;
+		delta.packets_out -= bot->reported.packets_out;
+		delta.dropped -= bot->reported.dropped;
+		delta.snaps -= bot->reported.snaps;
+		delta.lost_snaps -= bot->reported.lost_snaps;
+		delta.bad_snaps -= bot->reported.bad_snaps;
+		delta.download_bytes -= bot->reported.download_bytes;
+		delta.downloads -= bot->reported.downloads;
+		bot->reported = bot->stats;
+
+		BS_SumStats( &total, &delta );
+		if( bot->state == BOT_ACTIVE ) {
+			active++;
+		}
+	}
+
+	BS_Report( &total, active, msec, va( "%5.1fs", ( now - start ) / 1000.0 ) );
+
+	if( flood_rate > 0 ) {
+		Com_Printf( "    flood %" PRIi64 " queries, %" PRIi64 " answered\n",
+			flood_sent - flood_reported_sent, flood_answered - flood_reported_answered );
+		flood_reported_sent = flood_sent;
+		flood_reported_answered = flood_answered;
+	}
+}
+
+static void BS_ReportTotal( int64_t msec ) {
+	BotStats total = { };
+	int active = 0;
+	int dropped = 0;
+
+	for( int i = 0; i < num_bots; i++ ) {
+		BS_SumStats( &total, &bots[i].stats );
+		if( bots[i].state == BOT_ACTIVE ) {
+			active++;
+		} else if( bots[i].state == BOT_DROPPED ) {
+			dropped++;
+		}
+	}
+
+	Com_Printf( "\n" );
+	BS_Report( &total, active, msec, "total" );
+	Com_Printf( "    %" PRIu64 " bytes in, %" PRIu64 " bytes out per client, %i clients dropped\n",
+		total.bytes_in / Max2( num_bots, 1 ), total.bytes_out / Max2( num_bots, 1 ), dropped );
+}
+
+//==================================================
+// MAIN
+//==================================================
+
+int main( int argc, char **argv ) {
+	int seconds = BS_DEFAULT_SECONDS;
+	const char *server = "localhost";
+
+	num_bots = BS_DEFAULT_CLIENTS;
+
+	for( int i = 1; i < argc; i++ ) {
+		if( !strcmp( argv[i], "-n" ) && i + 1 < argc ) {
+			num_bots = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-t" ) && i + 1 < argc ) {
+			seconds = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-pps" ) && i + 1 < argc ) {
+			pps = Clamp( 1, atoi( argv[++i] ), 1000 );
+		} else if( !strcmp( argv[i], "-rcon" ) && i + 1 < argc ) {
+			rcon_password = argv[++i];
+		} else if( !strcmp( argv[i], "-flood" ) && i + 1 < argc ) {
+			flood_rate = Max2( atoi( argv[++i] ), 0 );
+		} else if( !strcmp( argv[i], "-download" ) && i + 1 < argc ) {
+			download_name = argv[++i];
+		} else if( !strcmp( argv[i], "-window" ) && i + 1 < argc ) {
+			download_window = Clamp( 0, atoi( argv[++i] ), DOWNLOAD_MAX_WINDOW );
+		} else if( !strcmp( argv[i], "-lag" ) && i + 1 < argc ) {
+			lag = Max2( atoi( argv[++i] ), 0 );
+		} else if( argv[i][0] != '-' ) {
+			server = argv[i];
+		} else {
+			printf( "usage: %s [-n clients] [-t seconds] [-pps packets] [-rcon password] [-flood packets] "
+				"[-download file] [-window blocks] [-lag msec] [server]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	if( num_bots < 0 || num_bots > 0xffff ) {
+		printf( "%s: client count must be between 0 and %i\n", argv[0], 0xffff );
+		return 1;
+	}
+
+	char * qargv[] = { argv[0] };
+	Qcommon_Init( 1, qargv );
+
+	if( !NET_StringToAddress( server, &server_address ) ) {
+		Com_Error( ERR_FATAL, "Bad server address: %s\n", server );
+	}
+	if( NET_GetAddressPort( &server_address ) == 0 ) {
+		NET_SetAddressPort( &server_address, PORT_SERVER );
+	}
+	unique_addresses = server_address.type == NA_IP && server_address.address.ipv4.ip[0] == 127;
+
+	scratch = ( snapshot_t * )Mem_ZoneMalloc( UPDATE_BACKUP * sizeof( snapshot_t ) );
+	for( int i = 0; i < UPDATE_BACKUP; i++ ) {
+		scratch[i].areabits = scratch_areabits[i];
+		scratch[i].areabytes = BS_AREABYTES;
+	}
+
+	bots = ( Bot * )Mem_ZoneMalloc( num_bots * sizeof( Bot ) );
+	for( int i = 0; i < num_bots; i++ ) {
+		BS_InitBot( &bots[i], i );
+	}
+
+	netadr_t any;
+	NET_InitAddress( &any, server_address.type );
+	if( rcon_password != NULL && !NET_OpenSocket( &rcon_socket, SOCKET_UDP, &any, false ) ) {
+		Com_Error( ERR_FATAL, "Couldn't open the rcon socket: %s\n", NET_ErrorString() );
+	}
+
+	// keep the flood off the rcon address so it doesn't eat its rate limit
+	netadr_t flood_address = any;
+	if( unique_addresses ) {
+		flood_address.address.ipv4.ip[0] = 127;
+		flood_address.address.ipv4.ip[1] = 2;
+		flood_address.address.ipv4.ip[3] = 1;
+	}
+	if( flood_rate > 0 && !NET_OpenSocket( &flood_socket, SOCKET_UDP, &flood_address, false ) ) {
+		Com_Error( ERR_FATAL, "Couldn't open the flood socket: %s\n", NET_ErrorString() );
+	}
+
+	Com_Printf( "Connecting %i clients to %s for %i seconds\n", num_bots, NET_AddressToString( &server_address ), seconds );
+
+	int64_t start = Sys_Milliseconds();
+	int64_t last_report = start;
+	BS_RequestFrameStats();
+
+	while( true ) {
+		int64_t now = Sys_Milliseconds();
+		if( now - start >= seconds * 1000 ) {
+			break;
+		}
+
+		BS_StartConnections( now );
+		for( int i = 0; i < num_bots; i++ ) {
+			BS_Frame( &bots[i], now );
+		}
+
+		if( rcon_password != NULL ) {
+			BS_ReadFrameStats();
+		}
+
+		if( flood_rate > 0 ) {
+			BS_Flood( now, start );
+		}
+
+		if( now - last_report >= BS_REPORT_MSEC ) {
+			BS_ReportInterval( now, start, now - last_report );
+			BS_RequestFrameStats();
+			last_report = now;
+		}
+
+		Sys_Sleep( 1 );
+	}
+
+	int64_t now = Sys_Milliseconds();
+	BS_ReportTotal( now - start );
+
+	for( int i = 0; i < num_bots; i++ ) {
+		BS_Disconnect( &bots[i], now );
+		NET_CloseSocket( &bots[i].socket );
+		Mem_ZoneFree( bots[i].snaps );
+		delete bots[i].delayed;
+	}
+	if( rcon_password != NULL ) {
+		NET_CloseSocket( &rcon_socket );
+	}
+	if( flood_rate > 0 ) {
+		NET_CloseSocket( &flood_socket );
+	}
+
+	Mem_ZoneFree( bots );
+	Mem_ZoneFree( scratch );
+
+	Qcommon_Shutdown();
+
+	return 0;
+}
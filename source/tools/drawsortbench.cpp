@@ -0,0 +1,166 @@
+// drawsortbench.cpp -- renderer draw list sort benchmark
+//
+// usage: drawsortbench [surfaces]
+//
+// Builds synthetic draw lists shaped like the renderer's: world surfaces in
+// visibility order, then entity models at varying distances, then
+// translucent polys, and sorts them with the qsort and comparison callback
+// R_SortDrawList used to have and with the radix sort on packed keys it
+// uses now. Both must come out in the same order.
+
+#include "qcommon/qcommon.h"
+#include "qalgo/radix_sort.h"
+#include "qalgo/rng.h"
+
+#define SORT_OPAQUE     1
+#define SORT_ADDITIVE   7
+#define WORLDSURF_DIST  1024.0f
+#define DEFAULT_SURFACES 8192
+
+//==================================================
+// DRAW LISTS
+//==================================================
+
+// the layout and comparison R_SortDrawList had before the keys were packed
+typedef struct {
+	unsigned int distKey;
+	uint64_t sortKey;
+	const void *drawSurf;
+} oldDrawSurf_t;
+
+typedef struct {
+	uint64_t sortKey;
+	const void *drawSurf;
+} packedDrawSurf_t;
+
+static int DS_PackDistKey( int shaderSort, float dist, unsigned order ) {
+	return ( shaderSort << 26 ) | ( Max2( 0x400 - (int)dist, 0 ) << 15 ) | ( order & 0x7FFF );
+}
+
+static int DS_OldCompare( const void *a, const void *b ) {
+	const oldDrawSurf_t *sbs1 = (const oldDrawSurf_t *)a;
+	const oldDrawSurf_t *sbs2 = (const oldDrawSurf_t *)b;
+
+	if( sbs1->distKey != sbs2->distKey ) {
+		return sbs1->distKey > sbs2->distKey ? 1 : -1;
+	}
+	if( sbs1->sortKey != sbs2->sortKey ) {
+		return sbs1->sortKey > sbs2->sortKey ? 1 : -1;
+	}
+	if( sbs1->drawSurf != sbs2->drawSurf ) {
+		return sbs1->drawSurf > sbs2->drawSurf ? 1 : -1;
+	}
+	return 0;
+}
+
+static uint64_t DS_PackedKey( const packedDrawSurf_t &ds ) {
+	return ds.sortKey;
+}
+
+/*
+* DS_Build
+*
+* Surface pointers go up with the order surfaces are added in, like the
+* world and model surface arrays the renderer walks in order
+*/
+static void DS_Build( RNG *rng, const char *surfaces, int numsurfs, oldDrawSurf_t *olds, packedDrawSurf_t *packed ) {
+	int numworld = numsurfs / 2;
+	int numpolys = numsurfs / 8;
+	int nummodels = numsurfs - numworld - numpolys;
+	int n = 0;
+
+	for( int i = 0; i < numworld; i++, n++ ) {
+		unsigned shaderNum = random_uniform( rng, 1, 200 );
+		olds[n].distKey = DS_PackDistKey( SORT_OPAQUE, WORLDSURF_DIST, shaderNum );
+		olds[n].sortKey = (uint64_t)shaderNum << 36;
+	}
+
+	for( int i = 0; i < nummodels; i++, n++ ) {
+		unsigned entNum = 1 + i / 8;
+		unsigned shaderNum = random_uniform( rng, 200, 400 );
+		float dist = random_float01( rng ) * 2048.0f;
+		olds[n].distKey = DS_PackDistKey( SORT_OPAQUE, dist, i % 8 );
+		olds[n].sortKey = ( (uint64_t)shaderNum << 36 ) | ( ( entNum & 0xFFF ) << 8 );
+	}
+
+	for( int i = 0; i < numpolys; i++, n++ ) {
+		unsigned shaderNum = random_uniform( rng, 400, 420 );
+		olds[n].distKey = DS_PackDistKey( SORT_ADDITIVE, 0, i );
+		olds[n].sortKey = (uint64_t)shaderNum << 36;
+	}
+
+	for( int i = 0; i < numsurfs; i++ ) {
+		unsigned shaderNum = ( olds[i].sortKey >> 36 ) & 0xFFF;
+		unsigned entNum = ( olds[i].sortKey >> 8 ) & 0xFFF;
+
+		olds[i].drawSurf = surfaces + i;
+		packed[i].sortKey = (uint64_t)olds[i].distKey << 32 | ( shaderNum << 12 ) | entNum;
+		packed[i].drawSurf = olds[i].drawSurf;
+	}
+}
+
+int main( int argc, char **argv ) {
+	int maxsurfs = argc >= 2 ? atoi( argv[1] ) : DEFAULT_SURFACES;
+
+	if( maxsurfs < 1 ) {
+		printf( "usage: %s [surfaces]\n", argv[0] );
+		return 1;
+	}
+
+	RNG rng = new_rng( 0x5eed, 1 );
+
+	oldDrawSurf_t *olds = (oldDrawSurf_t *)malloc( maxsurfs * sizeof( *olds ) );
+	oldDrawSurf_t *oldsorted = (oldDrawSurf_t *)malloc( maxsurfs * sizeof( *oldsorted ) );
+	packedDrawSurf_t *packed = (packedDrawSurf_t *)malloc( maxsurfs * sizeof( *packed ) );
+	packedDrawSurf_t *packedsorted = (packedDrawSurf_t *)malloc( maxsurfs * sizeof( *packedsorted ) );
+	packedDrawSurf_t *scratch = (packedDrawSurf_t *)malloc( maxsurfs * sizeof( *scratch ) );
+	char *surfaces = (char *)malloc( maxsurfs );
+
+	for( int numsurfs = Min2( 256, maxsurfs ); ; numsurfs = Min2( numsurfs * 4, maxsurfs ) ) {
+		int lists = Max2( 1, 2000000 / numsurfs );
+		uint64_t qsort_time = 0, radix_time = 0;
+		int mismatches = 0;
+
+		for( int l = 0; l < lists; l++ ) {
+			DS_Build( &rng, surfaces, numsurfs, olds, packed );
+			memcpy( oldsorted, olds, numsurfs * sizeof( *olds ) );
+			memcpy( packedsorted, packed, numsurfs * sizeof( *packed ) );
+
+			uint64_t t0 = Sys_Microseconds();
+			qsort( oldsorted, numsurfs, sizeof( *oldsorted ), DS_OldCompare );
+			uint64_t t1 = Sys_Microseconds();
+			RadixSort64( packedsorted, scratch, numsurfs, DS_PackedKey );
+			uint64_t t2 = Sys_Microseconds();
+
+			qsort_time += t1 - t0;
+			radix_time += t2 - t1;
+
+			for( int i = 0; i < numsurfs; i++ ) {
+				if( oldsorted[i].drawSurf != packedsorted[i].drawSurf ) {
+					mismatches++;
+					break;
+				}
+			}
+		}
+
+		printf( "%6d surfs %6d lists: qsort %8.2f us/list, radix %8.2f us/list (%.2fx), %d mismatched lists\n",
+			numsurfs, lists, qsort_time / double( lists ), radix_time / double( lists ),
+			qsort_time / double( Max2( radix_time, uint64_t( 1 ) ) ), mismatches );
+
+		if( mismatches ) {
+			Sys_Error( "radix sort order differs from qsort" );
+		}
+		if( numsurfs == maxsurfs ) {
+			break;
+		}
+	}
+
+	free( olds );
+	free( oldsorted );
+	free( packed );
+	free( packedsorted );
+	free( scratch );
+	free( surfaces );
+
+	return 0;
+}
@@ -0,0 +1,268 @@
+// jobstress.cpp -- job pool stress test
+//
+// usage: jobstress [rounds]
+//
+// Restarts the job pool with 1, 2, 4, 8 and 16 workers and hammers it with
+// flat batches that overflow a deque, trees of jobs that submit and wait on
+// their own children, jobs that wait on a counter shared with jobs from
+// another phase, and QJob_ParallelFor over awkward counts and batch sizes,
+// including ParallelFor calls made from inside jobs. Every test checks that
+// each piece of work ran exactly once and that its counter ended at zero.
+
+#include "qcommon/qcommon.h"
+#include "qcommon/qthreads.h"
+
+#define DEFAULT_ROUNDS 20
+#define FLAT_JOBS 5000          // several times a deque
+#define TREE_FANOUT 4
+#define TREE_DEPTH 5
+#define PHASE_JOBS 64
+#define MAX_PARALLELFOR_COUNT 100000
+
+static int failures;
+
+static void JS_Check( bool ok, const char * test, int workers ) {
+	if( !ok ) {
+		printf( "FAILED: %s with %d workers\n", test, workers );
+		failures++;
+	}
+}
+
+//==================================================
+// FLAT
+//==================================================
+
+struct FlatJobs {
+	volatile int runs[ FLAT_JOBS ];
+	volatile int total;
+};
+
+static FlatJobs flat;
+
+static void JS_FlatJob( void * data ) {
+	int i = ( int ) ( intptr_t ) data;
+	QAtomic_FetchAdd( &flat.runs[ i ], 1 );
+	QAtomic_FetchAdd( &flat.total, i );
+}
+
+static bool JS_Flat() {
+	memset( ( void * ) &flat, 0, sizeof( flat ) );
+
+	volatile int counter = 0;
+	for( int i = 0; i < FLAT_JOBS; i++ ) {
+		QJob_Submit( JS_FlatJob, ( void * ) ( intptr_t ) i, &counter );
+	}
+	QJob_Wait( &counter );
+
+	bool ok = counter == 0 && flat.total == FLAT_JOBS * ( FLAT_JOBS - 1 ) / 2;
+	for( int i = 0; i < FLAT_JOBS; i++ ) {
+		ok = ok && flat.runs[ i ] == 1;
+	}
+
+	return ok;
+}
+
+//==================================================
+// NESTED
+//==================================================
+
+// every node submits its children, waits on them and sums their leaves
+struct TreeNode {
+	int depth;
+	int leaves;
+};
+
+static volatile int tree_leaves_run;
+
+static void JS_TreeJob( void * data ) {
+	TreeNode * node = ( TreeNode * ) data;
+
+	if( node->depth == TREE_DEPTH ) {
+		node->leaves = 1;
+		QAtomic_FetchAdd( &tree_leaves_run, 1 );
+		return;
+	}
+
+	TreeNode children[ TREE_FANOUT ];
+	volatile int counter = 0;
+	for( int i = 0; i < TREE_FANOUT; i++ ) {
+		children[ i ].depth = node->depth + 1;
+		children[ i ].leaves = 0;
+		QJob_Submit( JS_TreeJob, &children[ i ], &counter );
+	}
+	QJob_Wait( &counter );
+
+	node->leaves = 0;
+	for( int i = 0; i < TREE_FANOUT; i++ ) {
+		node->leaves += children[ i ].leaves;
+	}
+}
+
+static bool JS_Nested() {
+	int expected = 1;
+	for( int i = 0; i < TREE_DEPTH; i++ ) {
+		expected *= TREE_FANOUT;
+	}
+
+	tree_leaves_run = 0;
+
+	TreeNode root = { 0, 0 };
+	volatile int counter = 0;
+	QJob_Submit( JS_TreeJob, &root, &counter );
+	QJob_Wait( &counter );
+
+	return counter == 0 && root.leaves == expected && tree_leaves_run == expected;
+}
+
+//==================================================
+// SHARED COUNTERS
+//==================================================
+
+// producers all share one counter, and every consumer waits on it from
+// inside the pool before reading what the producers wrote
+struct Phases {
+	int produced[ PHASE_JOBS ];
+	int consumed[ PHASE_JOBS ];
+	volatile int producers;
+};
+
+static Phases phases;
+
+static void JS_ProducerJob( void * data ) {
+	int i = ( int ) ( intptr_t ) data;
+	phases.produced[ i ] = i + 1;
+}
+
+static void JS_ConsumerJob( void * data ) {
+	int i = ( int ) ( intptr_t ) data;
+	QJob_Wait( &phases.producers );
+
+	int sum = 0;
+	for( int j = 0; j < PHASE_JOBS; j++ ) {
+		sum += phases.produced[ j ];
+	}
+	phases.consumed[ i ] = sum;
+}
+
+static bool JS_SharedCounters() {
+	memset( ( void * ) &phases, 0, sizeof( phases ) );
+
+	// consumers go in first so they're waiting while producers are queued
+	volatile int consumers = 0;
+	phases.producers = PHASE_JOBS;
+	for( int i = 0; i < PHASE_JOBS; i++ ) {
+		QJob_Submit( JS_ConsumerJob, ( void * ) ( intptr_t ) i, &consumers );
+	}
+	for( int i = 0; i < PHASE_JOBS; i++ ) {
+		QJob_Submit( JS_ProducerJob, ( void * ) ( intptr_t ) i, &phases.producers );
+	}
+	QAtomic_FetchAdd( &phases.producers, -PHASE_JOBS );
+
+	QJob_Wait( &consumers );
+
+	bool ok = consumers == 0 && phases.producers == 0;
+	for( int i = 0; i < PHASE_JOBS; i++ ) {
+		ok = ok && phases.consumed[ i ] == PHASE_JOBS * ( PHASE_JOBS + 1 ) / 2;
+	}
+
+	return ok;
+}
+
+//==================================================
+// PARALLELFOR
+//==================================================
+
+struct ParallelForTest {
+	volatile int * visits;
+	volatile int calls;
+};
+
+static void JS_ParallelForRange( void * data, int begin, int end ) {
+	ParallelForTest * test = ( ParallelForTest * ) data;
+	QAtomic_FetchAdd( &test->calls, 1 );
+	for( int i = begin; i < end; i++ ) {
+		QAtomic_FetchAdd( &test->visits[ i ], 1 );
+	}
+}
+
+static bool JS_ParallelForOnce( int count, int batch ) {
+	ParallelForTest test;
+	test.visits = ( volatile int * ) calloc( Max2( count, 1 ), sizeof( int ) );
+	test.calls = 0;
+
+	QJob_ParallelFor( count, batch, JS_ParallelForRange, &test );
+
+	bool ok = count > 0 || test.calls == 0;
+	if( count > 0 && batch > 0 ) {
+		ok = ok && test.calls == ( count + batch - 1 ) / batch;
+	}
+	for( int i = 0; i < count; i++ ) {
+		ok = ok && test.visits[ i ] == 1;
+	}
+
+	free( ( void * ) test.visits );
+
+	return ok;
+}
+
+static const int parallelfor_counts[] = { 0, 1, 7, 1000, 4097, MAX_PARALLELFOR_COUNT };
+static const int parallelfor_batches[] = { 0, 1, 13, 1024, MAX_PARALLELFOR_COUNT };
+
+static volatile int nested_parallelfor_failures;
+
+static void JS_NestedParallelForJob( void * data ) {
+	int count = ( int ) ( intptr_t ) data;
+	if( !JS_ParallelForOnce( count, 0 ) ) {
+		QAtomic_FetchAdd( &nested_parallelfor_failures, 1 );
+	}
+}
+
+static bool JS_ParallelFor() {
+	bool ok = true;
+	for( size_t i = 0; i < ARRAY_COUNT( parallelfor_counts ); i++ ) {
+		for( size_t j = 0; j < ARRAY_COUNT( parallelfor_batches ); j++ ) {
+			ok = ok && JS_ParallelForOnce( parallelfor_counts[ i ], parallelfor_batches[ j ] );
+		}
+	}
+
+	nested_parallelfor_failures = 0;
+	volatile int counter = 0;
+	for( int i = 0; i < 16; i++ ) {
+		QJob_Submit( JS_NestedParallelForJob, ( void * ) ( intptr_t ) ( 100 + i * 500 ), &counter );
+	}
+	QJob_Wait( &counter );
+
+	return ok && counter == 0 && nested_parallelfor_failures == 0;
+}
+
+int main( int argc, char **argv ) {
+	int rounds = argc >= 2 ? atoi( argv[1] ) : DEFAULT_ROUNDS;
+
+	if( rounds < 1 ) {
+		printf( "usage: %s [rounds]\n", argv[0] );
+		return 1;
+	}
+
+	static const int worker_counts[] = { 1, 2, 4, 8, 16 };
+
+	for( size_t w = 0; w < ARRAY_COUNT( worker_counts ); w++ ) {
+		QJobs_Init( worker_counts[ w ] );
+		int workers = QJobs_NumWorkers();
+
+		int64_t start = Sys_Milliseconds();
+		for( int r = 0; r < rounds; r++ ) {
+			JS_Check( JS_Flat(), "flat jobs", workers );
+			JS_Check( JS_Nested(), "nested jobs", workers );
+			JS_Check( JS_SharedCounters(), "shared counters", workers );
+			JS_Check( JS_ParallelFor(), "ParallelFor", workers );
+		}
+
+		printf( "%2d workers: %d rounds in %" PRIi64 "ms\n", workers, rounds, Sys_Milliseconds() - start );
+
+		QJobs_Shutdown();
+	}
+
+	printf( "%d failed checks\n", failures );
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+// lookupbench.cpp -- cvar and pak path lookup benchmark
+//
+// usage: lookupbench [lookups] [config]
+//
+// Times exact name lookups through a case insensitive trie, which is how
+// cvars, commands and pak entries used to be found, and through the HashMap
+// that replaced it, with the same keys in both:
+// - the name of every cvar Qcommon_Init registers, plus the ones set by the
+//   optional config, since a dedicated tool registers few of its own
+// - every file path under the base directory
+//
+// The paths are also packed into a generated pk3 so the engine's own lookups,
+// Cvar_Find and FS_PakNameForFile, are timed alongside. Keys are looked up in
+// a random order with random casing and every lookup must find its key.
+
+#include "qcommon/qcommon.h"
+#include "qalgo/hash_map.h"
+#include "qalgo/q_trie.h"
+#include "qalgo/rng.h"
+#include "tools/pk3writer.h"
+
+#define DEFAULT_LOOKUPS 1000000
+#define MAX_KEYS 16384
+#define BENCH_PAK "zz_lookupbench.pk3"
+
+struct KeySet {
+	const char *name;
+	char *keys[MAX_KEYS];       // as registered
+	char *mixed[MAX_KEYS];      // same keys with random casing
+	int num_keys;
+};
+
+static KeySet cvars = { "cvars" };
+static KeySet paths = { "pak paths" };
+
+static int *order;
+static int num_lookups;
+
+static int mismatches;
+
+//==================================================
+// KEYS
+//==================================================
+
+static void LB_AddKey( KeySet *set, const char *key ) {
+	if( set->num_keys == MAX_KEYS ) {
+		return;
+	}
+
+	set->keys[set->num_keys] = ZoneCopyString( key );
+	set->mixed[set->num_keys] = ZoneCopyString( key );
+	set->num_keys++;
+}
+
+static void LB_AddDirectory( const char *dir ) {
+	static char files[256 * 1024];
+	char subdirs[16 * 1024];
+	char path[MAX_QPATH];
+
+	// listing with an extension leaves out the subdirectories
+	int count = dir[0] ? FS_GetFileList( dir, ".*", files, sizeof( files ), 0, 0 ) : 0;
+	const char *name = files;
+	for( int i = 0; i < count; i++, name += strlen( name ) + 1 ) {
+		Q_snprintfz( path, sizeof( path ), "%s/%s", dir, name );
+		LB_AddKey( &paths, path );
+	}
+
+	count = FS_GetFileList( dir, "/", subdirs, sizeof( subdirs ), 0, 0 );
+	name = subdirs;
+	for( int i = 0; i < count; i++, name += strlen( name ) + 1 ) {
+		Q_snprintfz( path, sizeof( path ), dir[0] ? "%s/%s" : "%s%s", dir, name );
+		size_t len = strlen( path );
+		if( path[len - 1] == '/' ) {
+			path[len - 1] = '\0';
+		}
+		LB_AddDirectory( path );
+	}
+}
+
+static void LB_CollectKeys() {
+	char **list = Cvar_CompleteBuildList( "" );
+	for( int i = 0; list[i] != NULL; i++ ) {
+		LB_AddKey( &cvars, list[i] );
+	}
+	Mem_TempFree( list );
+
+	LB_AddDirectory( "" );
+}
+
+static void LB_MixCase( KeySet *set, RNG *rng ) {
+	for( int i = 0; i < set->num_keys; i++ ) {
+		for( char *c = set->mixed[i]; *c; c++ ) {
+			if( random_p( rng, 0.5f ) ) {
+				*c = toupper( *c );
+			}
+		}
+	}
+}
+
+//==================================================
+// PAK
+//==================================================
+
+static bool LB_WritePak( const char *filename ) {
+	PK3Writer pak;
+	memset( &pak, 0, sizeof( pak ) );
+
+	for( int i = 0; i < paths.num_keys; i++ ) {
+		const char *key = paths.keys[i];
+		PK3_AddFile( &pak, key, ( const uint8_t * )key, strlen( key ), false );
+	}
+
+	return PK3_Write( &pak, filename );
+}
+
+static void LB_RemovePak( const char *pak ) {
+	char indexname[1024];
+	FS_PK3IndexName( pak, indexname, sizeof( indexname ) );
+	remove( indexname );
+	remove( pak );
+}
+
+//==================================================
+// BENCHMARKS
+//==================================================
+
+static void LB_Report( const KeySet *set, const char *what, uint64_t usec ) {
+	Com_Printf( "%-10s %-18s %6d keys %8.1f ns/lookup\n", set->name, what, set->num_keys, usec * 1000.0 / num_lookups );
+}
+
+static void LB_Check( bool ok, const KeySet *set, const char *what, int key ) {
+	if( !ok ) {
+		Com_Printf( "%s %s: lookup of %s failed\n", set->name, what, set->mixed[key] );
+		mismatches++;
+	}
+}
+
+static void LB_BenchTrie( const KeySet *set ) {
+	trie_t *trie;
+	Trie_Create( TRIE_CASE_INSENSITIVE, &trie );
+	for( int i = 0; i < set->num_keys; i++ ) {
+		Trie_Insert( trie, set->keys[i], set->keys[i] );
+	}
+
+	int bad = -1;
+	uint64_t start = Sys_Microseconds();
+	for( int i = 0; i < num_lookups; i++ ) {
+		int key = order[i] % set->num_keys;
+		void *value = NULL;
+		Trie_Find( trie, set->mixed[key], TRIE_EXACT_MATCH, &value );
+		if( value != set->keys[key] ) {
+			bad = key;
+		}
+	}
+	LB_Report( set, "trie", Sys_Microseconds() - start );
+
+	LB_Check( bad == -1, set, "trie", bad );
+	Trie_Destroy( trie );
+}
+
+static void LB_BenchHashMap( const KeySet *set ) {
+	HashMap map;
+	HashMap_Init( &map );
+	for( int i = 0; i < set->num_keys; i++ ) {
+		HashMap_Set( &map, set->keys[i], set->keys[i] );
+	}
+
+	int bad = -1;
+	uint64_t start = Sys_Microseconds();
+	for( int i = 0; i < num_lookups; i++ ) {
+		int key = order[i] % set->num_keys;
+		if( HashMap_Find( &map, set->mixed[key] ) != set->keys[key] ) {
+			bad = key;
+		}
+	}
+	LB_Report( set, "hash map", Sys_Microseconds() - start );
+
+	LB_Check( bad == -1, set, "hash map", bad );
+	HashMap_Destroy( &map );
+}
+
+static void LB_BenchCvarFind() {
+	int bad = -1;
+	uint64_t start = Sys_Microseconds();
+	for( int i = 0; i < num_lookups; i++ ) {
+		int key = order[i] % cvars.num_keys;
+		const cvar_t *cvar = Cvar_Find( cvars.mixed[key] );
+		if( cvar == NULL || Q_stricmp( cvar->name, cvars.keys[key] ) ) {
+			bad = key;
+		}
+	}
+	LB_Report( &cvars, "Cvar_Find", Sys_Microseconds() - start );
+
+	LB_Check( bad == -1, &cvars, "Cvar_Find", bad );
+}
+
+static void LB_BenchPakSearch() {
+	int bad = -1;
+	uint64_t start = Sys_Microseconds();
+	for( int i = 0; i < num_lookups; i++ ) {
+		int key = order[i] % paths.num_keys;
+		const char *pakname = FS_PakNameForFile( paths.mixed[key] );
+		if( pakname == NULL || strstr( pakname, BENCH_PAK ) == NULL ) {
+			bad = key;
+		}
+	}
+	LB_Report( &paths, "FS_PakNameForFile", Sys_Microseconds() - start );
+
+	LB_Check( bad == -1, &paths, "FS_PakNameForFile", bad );
+}
+
+int main( int argc, char **argv ) {
+	num_lookups = argc >= 2 ? atoi( argv[1] ) : DEFAULT_LOOKUPS;
+
+	if( num_lookups < 1 ) {
+		printf( "usage: %s [lookups] [config]\n", argv[0] );
+		return 1;
+	}
+
+	char *qargv[] = { argv[0] };
+	Qcommon_Init( 1, qargv );
+
+	if( argc >= 3 ) {
+		Cbuf_ExecuteText( EXEC_NOW, va( "exec \"%s\"\n", argv[2] ) );
+		Cbuf_Execute();
+	}
+
+	LB_CollectKeys();
+	if( cvars.num_keys == 0 || paths.num_keys == 0 ) {
+		Com_Error( ERR_FATAL, "Nothing to look up" );
+	}
+
+	RNG rng = new_rng( 0x6c6f6f6b, 1 );
+	LB_MixCase( &cvars, &rng );
+	LB_MixCase( &paths, &rng );
+
+	// the same random sequence for every table, reduced modulo each key count
+	order = ( int * ) Mem_ZoneMalloc( num_lookups * sizeof( int ) );
+	for( int i = 0; i < num_lookups; i++ ) {
+		order[i] = random_uniform( &rng, 0, MAX_KEYS );
+	}
+
+	char pak[1024];
+	Q_snprintfz( pak, sizeof( pak ), "%s/%s/%s", FS_WriteDirectory(), FS_BaseGameDirectory(), BENCH_PAK );
+	FS_CreateAbsolutePath( pak );
+
+	if( !LB_WritePak( pak ) ) {
+		Com_Error( ERR_FATAL, "Couldn't write %s", pak );
+	}
+
+	FS_Shutdown();
+	FS_Init();
+
+	LB_BenchTrie( &cvars );
+	LB_BenchHashMap( &cvars );
+	LB_BenchCvarFind();
+
+	LB_BenchTrie( &paths );
+	LB_BenchHashMap( &paths );
+	LB_BenchPakSearch();
+
+	FS_Shutdown();
+	LB_RemovePak( pak );
+	FS_Init();
+
+	Com_Printf( "%d mismatches\n", mismatches );
+
+	for( int i = 0; i < cvars.num_keys; i++ ) {
+		Mem_ZoneFree( cvars.keys[i] );
+		Mem_ZoneFree( cvars.mixed[i] );
+	}
+	for( int i = 0; i < paths.num_keys; i++ ) {
+		Mem_ZoneFree( paths.keys[i] );
+		Mem_ZoneFree( paths.mixed[i] );
+	}
+	Mem_ZoneFree( order );
+
+	Qcommon_Shutdown();
+
+	return mismatches == 0 ? 0 : 1;
+}
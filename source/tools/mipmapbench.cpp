@@ -0,0 +1,337 @@
+// mipmapbench.cpp -- texture resampling and mipmap generation benchmark
+//
+// usage: mipmapbench [size]
+//
+// Builds the full mip chain of random images with 1 to 4 samples using the
+// in-place loop R_MipMap used to have, the scalar kernels and the SIMD
+// kernels on one thread and across the job pool, and times them. Without
+// MIP_SRGB every path must give the same bytes. Resampling is checked the same
+// way against the loop R_ResampleTexture used to have, and sRGB mips are
+// checked against a float reference.
+
+#include "qcommon/qcommon.h"
+#include "qcommon/qthreads.h"
+#include "qalgo/rng.h"
+#include "client/renderer/r_mipmap.h"
+
+#define DEFAULT_SIZE 1024
+#define BENCH_PIXELS ( 1 << 24 )
+
+//==================================================
+// THE OLD LOOPS
+//==================================================
+
+static void MB_OldMipMap( uint8_t *in, int width, int height, int samples ) {
+	int outwidth = Max2( width >> 1, 1 );
+	int outheight = Max2( height >> 1, 1 );
+	uint8_t *out = in;
+
+	for( int i = 0; i < outheight; i++, in += width * samples * 2 ) {
+		uint8_t *next = ( ( i << 1 ) + 1 ) < height ? in + width * samples : in;
+		for( int j = 0, inofs = 0; j < outwidth; j++, inofs += samples ) {
+			if( ( ( j << 1 ) + 1 ) < width ) {
+				for( int k = 0; k < samples; ++k, ++inofs )
+					*( out++ ) = ( in[inofs] + in[inofs + samples] + next[inofs] + next[inofs + samples] ) >> 2;
+			} else {
+				for( int k = 0; k < samples; ++k, ++inofs )
+					*( out++ ) = ( in[inofs] + next[inofs] ) >> 1;
+			}
+		}
+	}
+}
+
+static void MB_OldResample( const uint8_t *in, int inwidth, int inheight, uint8_t *out, int outwidth, int outheight, int samples ) {
+	unsigned *p1 = (unsigned *)malloc( outwidth * sizeof( *p1 ) * 2 );
+	unsigned *p2 = p1 + outwidth;
+	unsigned fracstep = inwidth * 0x10000 / outwidth;
+	unsigned frac;
+
+	frac = fracstep >> 2;
+	for( int i = 0; i < outwidth; i++ ) {
+		p1[i] = samples * ( frac >> 16 );
+		frac += fracstep;
+	}
+
+	frac = 3 * ( fracstep >> 2 );
+	for( int i = 0; i < outwidth; i++ ) {
+		p2[i] = samples * ( frac >> 16 );
+		frac += fracstep;
+	}
+
+	for( int i = 0; i < outheight; i++, out += outwidth * samples ) {
+		const uint8_t *inrow = in + inwidth * samples * (int)( ( i + 0.25 ) * inheight / outheight );
+		const uint8_t *inrow2 = in + inwidth * samples * (int)( ( i + 0.75 ) * inheight / outheight );
+		for( int j = 0; j < outwidth; j++ ) {
+			for( int k = 0; k < samples; k++ )
+				out[j * samples + k] = ( inrow[p1[j] + k] + inrow[p2[j] + k] + inrow2[p1[j] + k] + inrow2[p2[j] + k] ) >> 2;
+		}
+	}
+
+	free( p1 );
+}
+
+//==================================================
+// CHAINS
+//==================================================
+
+static size_t MB_ChainSize( int width, int height, int samples ) {
+	size_t size = 0;
+
+	while( true ) {
+		size += width * height * samples;
+		if( width == 1 && height == 1 ) {
+			break;
+		}
+		width = Max2( width >> 1, 1 );
+		height = Max2( height >> 1, 1 );
+	}
+
+	return size;
+}
+
+/*
+* MB_OldChain
+*
+* Every level is copied out before the next one overwrites it
+*/
+static void MB_OldChain( const uint8_t *image, int width, int height, int samples, uint8_t *chain, uint8_t *work ) {
+	memcpy( work, image, width * height * samples );
+
+	while( true ) {
+		memcpy( chain, work, width * height * samples );
+		chain += width * height * samples;
+		if( width == 1 && height == 1 ) {
+			break;
+		}
+		MB_OldMipMap( work, width, height, samples );
+		width = Max2( width >> 1, 1 );
+		height = Max2( height >> 1, 1 );
+	}
+}
+
+static void MB_Chain( const uint8_t *image, int width, int height, int samples, uint8_t *chain, int flags ) {
+	memcpy( chain, image, width * height * samples );
+
+	while( width > 1 || height > 1 ) {
+		uint8_t *next = chain + width * height * samples;
+		R_MipMapImage( chain, width, height, next, samples, 1, flags );
+		chain = next;
+		width = Max2( width >> 1, 1 );
+		height = Max2( height >> 1, 1 );
+	}
+}
+
+static void MB_Random( RNG *rng, uint8_t *image, size_t size ) {
+	for( size_t i = 0; i < size; i++ ) {
+		image[i] = random_u32( rng ) & 255;
+	}
+}
+
+static float MB_ToLinear( int c ) {
+	float f = c / 255.0f;
+	return f <= 0.04045f ? f / 12.92f : powf( ( f + 0.055f ) / 1.055f, 2.4f );
+}
+
+static float MB_ToSRGB( float l ) {
+	return 255.0f * ( l <= 0.0031308f ? l * 12.92f : 1.055f * powf( l, 1.0f / 2.4f ) - 0.055f );
+}
+
+//==================================================
+// CHECKS
+//==================================================
+
+static int MB_CheckMipMaps( RNG *rng ) {
+	const int sizes[][2] = { { 1, 1 }, { 1, 37 }, { 37, 1 }, { 2, 2 }, { 33, 17 }, { 64, 64 }, { 333, 77 }, { 512, 256 }, { 1024, 1024 } };
+	int failures = 0;
+
+	for( size_t s = 0; s < ARRAY_COUNT( sizes ); s++ ) {
+		for( int samples = 1; samples <= 4; samples++ ) {
+			int width = sizes[s][0], height = sizes[s][1];
+			size_t size = width * height * samples;
+			size_t chainsize = MB_ChainSize( width, height, samples );
+			uint8_t *image = (uint8_t *)malloc( size );
+			uint8_t *work = (uint8_t *)malloc( size );
+			uint8_t *ref = (uint8_t *)malloc( chainsize );
+			uint8_t *chain = (uint8_t *)malloc( chainsize );
+			const int paths[] = { MIP_SCALAR | MIP_SERIAL, MIP_SERIAL, 0 };
+
+			MB_Random( rng, image, size );
+			MB_OldChain( image, width, height, samples, ref, work );
+
+			for( size_t p = 0; p < ARRAY_COUNT( paths ); p++ ) {
+				MB_Chain( image, width, height, samples, chain, paths[p] );
+				if( memcmp( ref, chain, chainsize ) ) {
+					printf( "mipmap %dx%dx%d flags %d differs from the old loop\n", width, height, samples, paths[p] );
+					failures++;
+				}
+			}
+
+			free( image );
+			free( work );
+			free( ref );
+			free( chain );
+		}
+	}
+
+	return failures;
+}
+
+static int MB_CheckResample( RNG *rng ) {
+	const int sizes[][4] = { { 64, 64, 32, 32 }, { 1000, 700, 512, 512 }, { 333, 77, 128, 64 }, { 37, 1, 16, 1 }, { 100, 100, 100, 50 } };
+	int failures = 0;
+
+	for( size_t s = 0; s < ARRAY_COUNT( sizes ); s++ ) {
+		for( int samples = 1; samples <= 4; samples++ ) {
+			int inwidth = sizes[s][0], inheight = sizes[s][1], outwidth = sizes[s][2], outheight = sizes[s][3];
+			size_t insize = inwidth * inheight * samples;
+			size_t outsize = outwidth * outheight * samples;
+			uint8_t *image = (uint8_t *)malloc( insize );
+			uint8_t *ref = (uint8_t *)malloc( outsize );
+			uint8_t *out = (uint8_t *)malloc( outsize );
+			const int paths[] = { MIP_SCALAR | MIP_SERIAL, MIP_SERIAL, 0 };
+
+			MB_Random( rng, image, insize );
+			MB_OldResample( image, inwidth, inheight, ref, outwidth, outheight, samples );
+
+			for( size_t p = 0; p < ARRAY_COUNT( paths ); p++ ) {
+				R_ResampleImage( image, inwidth, inheight, out, outwidth, outheight, samples, 1, paths[p] );
+				if( memcmp( ref, out, outsize ) ) {
+					printf( "resample %dx%d to %dx%dx%d flags %d differs from the old loop\n",
+						inwidth, inheight, outwidth, outheight, samples, paths[p] );
+					failures++;
+				}
+			}
+
+			free( image );
+			free( ref );
+			free( out );
+		}
+	}
+
+	return failures;
+}
+
+/*
+* MB_CheckSRGB
+*
+* Color channels must be within one step of averaging in linear light with
+* floats, flat colors must stay exactly the same and alpha is averaged as is
+*/
+static int MB_CheckSRGB( RNG *rng ) {
+	const int width = 64, height = 64, samples = 4;
+	uint8_t image[width * height * samples];
+	uint8_t out[( width / 2 ) * ( height / 2 ) * samples];
+	int failures = 0;
+
+	MB_Random( rng, image, sizeof( image ) );
+	R_MipMapImage( image, width, height, out, samples, 1, MIP_SRGB );
+
+	for( int i = 0; i < height / 2; i++ ) {
+		for( int j = 0; j < width / 2; j++ ) {
+			const uint8_t *a = image + ( i * 2 * width + j * 2 ) * samples;
+			const uint8_t *b = a + width * samples;
+			const uint8_t *o = out + ( i * width / 2 + j ) * samples;
+
+			for( int k = 0; k < samples; k++ ) {
+				float expected;
+				if( k < 3 ) {
+					float l = MB_ToLinear( a[k] ) + MB_ToLinear( a[k + samples] ) + MB_ToLinear( b[k] ) + MB_ToLinear( b[k + samples] );
+					expected = MB_ToSRGB( l * 0.25f );
+				} else {
+					expected = ( a[k] + a[k + samples] + b[k] + b[k + samples] ) >> 2;
+				}
+				if( fabsf( o[k] - expected ) > 1.0f ) {
+					printf( "srgb mipmap pixel %d %d channel %d is %d, expected %.2f\n", j, i, k, o[k], expected );
+					failures++;
+				}
+			}
+		}
+	}
+
+	for( int c = 0; c < 256; c++ ) {
+		memset( image, c, sizeof( image ) );
+		R_MipMapImage( image, width, height, out, samples, 1, MIP_SRGB );
+		for( size_t i = 0; i < sizeof( out ); i++ ) {
+			if( out[i] != c ) {
+				printf( "srgb mipmap of flat %d gave %d\n", c, out[i] );
+				failures++;
+				break;
+			}
+		}
+	}
+
+	return failures;
+}
+
+//==================================================
+// BENCHMARK
+//==================================================
+
+static void MB_Bench( RNG *rng, int size ) {
+	for( int samples = 1; samples <= 4; samples++ ) {
+		size_t imagesize = size * size * samples;
+		size_t chainsize = MB_ChainSize( size, size, samples );
+		uint8_t *image = (uint8_t *)malloc( imagesize );
+		uint8_t *work = (uint8_t *)malloc( imagesize );
+		uint8_t *chain = (uint8_t *)malloc( chainsize );
+		int runs = Max2( 1, BENCH_PIXELS / ( size * size ) );
+		uint64_t old_time = 0, scalar_time = 0, simd_time = 0, jobs_time = 0, srgb_time = 0;
+
+		MB_Random( rng, image, imagesize );
+
+		for( int r = 0; r < runs; r++ ) {
+			uint64_t t0 = Sys_Microseconds();
+			MB_OldChain( image, size, size, samples, chain, work );
+			uint64_t t1 = Sys_Microseconds();
+			MB_Chain( image, size, size, samples, chain, MIP_SCALAR | MIP_SERIAL );
+			uint64_t t2 = Sys_Microseconds();
+			MB_Chain( image, size, size, samples, chain, MIP_SERIAL );
+			uint64_t t3 = Sys_Microseconds();
+			MB_Chain( image, size, size, samples, chain, 0 );
+			uint64_t t4 = Sys_Microseconds();
+			MB_Chain( image, size, size, samples, chain, MIP_SRGB );
+			uint64_t t5 = Sys_Microseconds();
+
+			old_time += t1 - t0;
+			scalar_time += t2 - t1;
+			simd_time += t3 - t2;
+			jobs_time += t4 - t3;
+			srgb_time += t5 - t4;
+		}
+
+		printf( "%4dx%-4d x%d %3d runs: old %8.2f ms, scalar %8.2f ms, simd %8.2f ms (%.2fx), simd+jobs %8.2f ms (%.2fx), srgb+jobs %8.2f ms\n",
+			size, size, samples, runs, old_time / ( 1000.0 * runs ), scalar_time / ( 1000.0 * runs ),
+			simd_time / ( 1000.0 * runs ), old_time / double( Max2( simd_time, uint64_t( 1 ) ) ),
+			jobs_time / ( 1000.0 * runs ), old_time / double( Max2( jobs_time, uint64_t( 1 ) ) ),
+			srgb_time / ( 1000.0 * runs ) );
+
+		free( image );
+		free( work );
+		free( chain );
+	}
+}
+
+int main( int argc, char **argv ) {
+	int size = argc >= 2 ? atoi( argv[1] ) : DEFAULT_SIZE;
+
+	if( size < 1 ) {
+		printf( "usage: %s [size]\n", argv[0] );
+		return 1;
+	}
+
+	QThreads_Init();
+
+	RNG rng = new_rng( 0x5eed, 1 );
+	int failures = MB_CheckMipMaps( &rng ) + MB_CheckResample( &rng ) + MB_CheckSRGB( &rng );
+
+	printf( "%d failed checks (%d job workers)\n", failures, QJobs_NumWorkers() );
+	if( failures ) {
+		return 1;
+	}
+
+	MB_Bench( &rng, size );
+
+	QThreads_Shutdown();
+
+	return 0;
+}
@@ -0,0 +1,435 @@
+// pakindextest.cpp -- pak index consistency test
+//
+// usage: pakindextest [rounds]
+//
+// Opens every pak in the base paths twice, once with its index removed so
+// the zip central directory is parsed, and once from the index that load
+// wrote. The file lists, flags, offsets, sizes, pak checksum and a checksum
+// of every entry's data must be identical. The index is then damaged in
+// several ways (truncated, emptied, single bytes flipped, swapped with the
+// index of another pak) and every load must fall back to the central
+// directory with identical results and rewrite a good index.
+//
+// A few paks are also generated under pakindextest/ in the write directory,
+// with stored and deflated entries and nested directories, so there is
+// always something to test. They are rewritten with different contents to
+// check that a stale index is ignored, and their entries are inflated and
+// compared to what was written.
+
+#include "qcommon/qcommon.h"
+#include "qalgo/rng.h"
+#include "zlib/zlib.h"
+#include "tools/pk3writer.h"
+
+#define TEST_DIR "pakindextest"
+#define DEFAULT_ROUNDS 4
+#define NUM_GENERATED_PAKS 3
+#define MAX_GENERATED_FILES 64
+#define MAX_ENTRY_SIZE ( 256 * 1024 )
+#define MAX_PAKS 256
+#define FLIPS_PER_INDEX 16
+#define PAK_MAX_PATH 1024
+
+static int failures;
+static int checks;
+
+static void PI_Check( bool ok, const char *pak, const char *what ) {
+	checks++;
+	if( !ok ) {
+		printf( "FAILED: %s: %s\n", pak, what );
+		failures++;
+	}
+}
+
+//==================================================
+// LISTINGS
+//==================================================
+
+struct PakEntry {
+	char name[MAX_QPATH];
+	fs_pakentry_t info;
+	uLong crc;              // of the compressed bytes
+	bool mapped;
+};
+
+struct PakListing {
+	bool loaded;
+	bool indexed;
+	unsigned checksum;
+	int numEntries;
+	int maxEntries;
+	PakEntry *entries;
+};
+
+static void PI_FreeListing( PakListing *listing ) {
+	free( listing->entries );
+	memset( listing, 0, sizeof( *listing ) );
+}
+
+static void PI_AddEntry( const fs_pakentry_t *info, void *data ) {
+	PakListing *listing = ( PakListing * )data;
+
+	if( listing->numEntries == listing->maxEntries ) {
+		listing->maxEntries = Max2( 64, listing->maxEntries * 2 );
+		listing->entries = ( PakEntry * )realloc( listing->entries, listing->maxEntries * sizeof( PakEntry ) );
+	}
+
+	PakEntry *entry = &listing->entries[listing->numEntries++];
+	memset( entry, 0, sizeof( *entry ) );
+	Q_strncpyz( entry->name, info->name, sizeof( entry->name ) );
+	entry->info = *info;
+	entry->info.name = NULL;
+	entry->info.data = NULL;
+	entry->mapped = info->data != NULL;
+	if( info->data ) {
+		entry->crc = crc32( 0, ( const Bytef * )info->data, info->compressedSize );
+	}
+}
+
+static PakListing PI_Inspect( const char *packfilename ) {
+	PakListing listing;
+
+	memset( &listing, 0, sizeof( listing ) );
+	listing.loaded = FS_InspectPakFile( packfilename, &listing.checksum, &listing.indexed, PI_AddEntry, &listing );
+
+	return listing;
+}
+
+static bool PI_SameListing( const PakListing *a, const PakListing *b ) {
+	if( !a->loaded || !b->loaded || a->checksum != b->checksum || a->numEntries != b->numEntries ) {
+		return false;
+	}
+
+	for( int i = 0; i < a->numEntries; i++ ) {
+		const PakEntry *ea = &a->entries[i];
+		const PakEntry *eb = &b->entries[i];
+
+		if( strcmp( ea->name, eb->name ) || ea->info.deflated != eb->info.deflated || ea->info.directory != eb->info.directory || ea->info.offset != eb->info.offset
+			|| ea->info.compressedSize != eb->info.compressedSize || ea->info.uncompressedSize != eb->info.uncompressedSize
+			|| ea->mapped != eb->mapped || ea->crc != eb->crc ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//==================================================
+// INDEX FILES
+//==================================================
+
+static uint8_t *PI_ReadFile( const char *filename, size_t *len ) {
+	FILE *f = fopen( filename, "rb" );
+	if( !f ) {
+		return NULL;
+	}
+
+	fseek( f, 0, SEEK_END );
+	*len = ftell( f );
+	fseek( f, 0, SEEK_SET );
+
+	uint8_t *buf = ( uint8_t * )malloc( Max2( *len, ( size_t )1 ) );
+	if( fread( buf, 1, *len, f ) != *len ) {
+		free( buf );
+		buf = NULL;
+	}
+	fclose( f );
+
+	return buf;
+}
+
+static bool PI_WriteFile( const char *filename, const void *data, size_t len ) {
+	FILE *f = fopen( filename, "wb" );
+	if( !f ) {
+		return false;
+	}
+
+	bool ok = fwrite( data, 1, len, f ) == len;
+	return fclose( f ) == 0 && ok;
+}
+
+// the damaged index must be ignored and replaced by a good one
+static void PI_CheckRebuild( const char *packfilename, const PakListing *cold, const char *damage ) {
+	char what[256];
+
+	PakListing rebuilt = PI_Inspect( packfilename );
+	Q_snprintfz( what, sizeof( what ), "%s index wasn't ignored", damage );
+	PI_Check( rebuilt.loaded && !rebuilt.indexed, packfilename, what );
+	Q_snprintfz( what, sizeof( what ), "load with %s index differs", damage );
+	PI_Check( PI_SameListing( cold, &rebuilt ), packfilename, what );
+	PI_FreeListing( &rebuilt );
+
+	PakListing reindexed = PI_Inspect( packfilename );
+	Q_snprintfz( what, sizeof( what ), "index wasn't rebuilt after %s index", damage );
+	PI_Check( reindexed.loaded && reindexed.indexed, packfilename, what );
+	Q_snprintfz( what, sizeof( what ), "rebuilt index after %s index differs", damage );
+	PI_Check( PI_SameListing( cold, &reindexed ), packfilename, what );
+	PI_FreeListing( &reindexed );
+}
+
+// returns the cold listing, which the caller frees
+static PakListing PI_TestPak( const char *packfilename, const char *otherpackfilename, RNG *rng ) {
+	char indexname[PAK_MAX_PATH], otherindexname[PAK_MAX_PATH];
+
+	FS_PK3IndexName( packfilename, indexname, sizeof( indexname ) );
+	remove( indexname );
+
+	PakListing cold = PI_Inspect( packfilename );
+	PI_Check( cold.loaded, packfilename, "cold load failed" );
+	PI_Check( !cold.indexed, packfilename, "cold load used an index" );
+	if( !cold.loaded ) {
+		return cold;
+	}
+
+	PakListing warm = PI_Inspect( packfilename );
+	PI_Check( warm.loaded && warm.indexed, packfilename, "index wasn't used" );
+	PI_Check( PI_SameListing( &cold, &warm ), packfilename, "load from index differs" );
+	PI_FreeListing( &warm );
+
+	size_t len;
+	uint8_t *index = PI_ReadFile( indexname, &len );
+	PI_Check( index != NULL, packfilename, "no index written" );
+	if( !index ) {
+		return cold;
+	}
+
+	PI_WriteFile( indexname, index, len / 2 );
+	PI_CheckRebuild( packfilename, &cold, "truncated" );
+
+	PI_WriteFile( indexname, index, 0 );
+	PI_CheckRebuild( packfilename, &cold, "empty" );
+
+	PI_WriteFile( indexname, "PIDX", 4 );
+	PI_CheckRebuild( packfilename, &cold, "headerless" );
+
+	for( int i = 0; i < FLIPS_PER_INDEX; i++ ) {
+		// first flip is always in the magic
+		size_t pos = i == 0 ? 0 : random_uniform( rng, 0, ( int )len );
+		uint8_t bit = 1 << random_uniform( rng, 0, 8 );
+		index[pos] ^= bit;
+		PI_WriteFile( indexname, index, len );
+		PI_CheckRebuild( packfilename, &cold, "corrupted" );
+		index[pos] ^= bit;
+	}
+
+	// another pak's index is well formed, but for the wrong pak
+	if( otherpackfilename ) {
+		FS_PK3IndexName( otherpackfilename, otherindexname, sizeof( otherindexname ) );
+
+		size_t otherlen;
+		uint8_t *otherindex = PI_ReadFile( otherindexname, &otherlen );
+		if( otherindex ) {
+			PI_WriteFile( indexname, otherindex, otherlen );
+			PI_CheckRebuild( packfilename, &cold, "another pak's" );
+			free( otherindex );
+		}
+	}
+
+	free( index );
+
+	return cold;
+}
+
+//==================================================
+// GENERATED PAKS
+//==================================================
+
+static const char *generated_dirs[] = { "maps", "textures/world", "textures/world/trims", "sounds/weapons", "models/players/rigg" };
+
+static uint8_t *PI_EntryContents( int pak, int file, int generation, size_t *len ) {
+	RNG rng = new_rng( pak * 1000003 + file * 7919 + generation, 0 );
+	*len = random_uniform( &rng, 0, MAX_ENTRY_SIZE );
+
+	// half random, half repetitive so deflate has something to do
+	uint8_t *contents = ( uint8_t * )malloc( Max2( *len, ( size_t )1 ) );
+	for( size_t i = 0; i < *len; i++ ) {
+		contents[i] = i < *len / 2 ? ( uint8_t )random_uniform( &rng, 0, 256 ) : ( uint8_t )( i / 64 );
+	}
+
+	return contents;
+}
+
+static void PI_GeneratedName( int file, char *buf, size_t buf_size ) {
+	Q_snprintfz( buf, buf_size, "%s/file%02d.dat", generated_dirs[file % ARRAY_COUNT( generated_dirs )], file );
+}
+
+static int PI_GeneratedFiles( int pak, int generation ) {
+	return MAX_GENERATED_FILES / 2 + ( pak * 5 + generation ) % ( MAX_GENERATED_FILES / 2 );
+}
+
+static bool PI_GeneratePak( const char *filename, int pak, int generation ) {
+	PK3Writer zip;
+	memset( &zip, 0, sizeof( zip ) );
+
+	PK3_AddFile( &zip, "textures/", NULL, 0, false );
+
+	int numFiles = PI_GeneratedFiles( pak, generation );
+	for( int i = 0; i < numFiles; i++ ) {
+		char name[MAX_QPATH];
+		size_t len;
+
+		PI_GeneratedName( i, name, sizeof( name ) );
+		uint8_t *contents = PI_EntryContents( pak, i, generation, &len );
+		PK3_AddFile( &zip, name, contents, len, i % 3 != 0 );
+		free( contents );
+	}
+
+	return PK3_Write( &zip, filename );
+}
+
+// inflates every entry of a generated pak and compares it to what was written
+static void PI_CheckGeneratedContents( const char *packfilename, int pak, int generation ) {
+	// the data pointers are only valid while the pak is loaded, so go
+	// through the raw file instead
+	size_t pakLen;
+	uint8_t *pakData = PI_ReadFile( packfilename, &pakLen );
+	PakListing listing = PI_Inspect( packfilename );
+
+	int numFiles = PI_GeneratedFiles( pak, generation );
+	PI_Check( listing.loaded && listing.numEntries == numFiles + 1, packfilename, "wrong number of entries" );
+
+	for( int i = 0; pakData && i < listing.numEntries && i <= numFiles; i++ ) {
+		const PakEntry *entry = &listing.entries[i];
+
+		if( i == 0 ) {
+			PI_Check( !strcmp( entry->name, "textures/" ) && entry->info.directory, packfilename, "directory entry missing" );
+			continue;
+		}
+
+		char name[MAX_QPATH];
+		size_t len;
+		PI_GeneratedName( i - 1, name, sizeof( name ) );
+		uint8_t *expected = PI_EntryContents( pak, i - 1, generation, &len );
+
+		PI_Check( !strcmp( entry->name, name ) && entry->info.uncompressedSize == len, packfilename, "entry name or size differs" );
+
+		size_t dataOffset = entry->info.offset + 30 + strlen( name );
+		bool ok = dataOffset + entry->info.compressedSize <= pakLen;
+		if( ok ) {
+			uint8_t *contents = ( uint8_t * )malloc( len + 1 );
+			const uint8_t *stored = pakData + dataOffset;
+
+			if( entry->info.deflated ) {
+				z_stream zs;
+				memset( &zs, 0, sizeof( zs ) );
+				inflateInit2( &zs, -MAX_WBITS );
+				zs.next_in = ( Bytef * )stored;
+				zs.avail_in = entry->info.compressedSize;
+				zs.next_out = contents;
+				zs.avail_out = len + 1;
+				ok = inflate( &zs, Z_FINISH ) == Z_STREAM_END && zs.total_out == len;
+				inflateEnd( &zs );
+			} else {
+				ok = entry->info.compressedSize == len;
+				memcpy( contents, stored, ok ? len : 0 );
+			}
+
+			ok = ok && memcmp( contents, expected, len ) == 0;
+			free( contents );
+		}
+		PI_Check( ok, packfilename, "entry contents differ" );
+
+		free( expected );
+	}
+
+	PI_FreeListing( &listing );
+	free( pakData );
+}
+
+//==================================================
+// MAIN
+//==================================================
+
+static int PI_FindBasePaks( char paks[MAX_PAKS][PAK_MAX_PATH] ) {
+	static char list[64 * 1024];
+	int num = 0;
+
+	int count = FS_GetFileList( "", ".pk3", list, sizeof( list ), 0, 0 );
+	const char *name = list;
+	for( int i = 0; i < count && num < MAX_PAKS; i++, name += strlen( name ) + 1 ) {
+		char pakname[PAK_MAX_PATH];
+
+		Q_snprintfz( pakname, sizeof( pakname ), "%s/%s", FS_BaseGameDirectory(), name );
+		const char *fullname = FS_AbsoluteNameForBaseFile( pakname );
+		if( fullname ) {
+			Q_strncpyz( paks[num++], fullname, PAK_MAX_PATH );
+		}
+	}
+
+	return num;
+}
+
+int main( int argc, char **argv ) {
+	int rounds = argc >= 2 ? atoi( argv[1] ) : DEFAULT_ROUNDS;
+
+	if( rounds < 1 ) {
+		printf( "usage: %s [rounds]\n", argv[0] );
+		return 1;
+	}
+
+	char *qargv[] = { argv[0] };
+	Qcommon_Init( 1, qargv );
+
+	static char paks[MAX_PAKS][PAK_MAX_PATH];
+	int numBasePaks = PI_FindBasePaks( paks );
+
+	char dir[PAK_MAX_PATH];
+	Q_snprintfz( dir, sizeof( dir ), "%s/%s/", FS_WriteDirectory(), TEST_DIR );
+	FS_CreateAbsolutePath( dir );
+
+	int numPaks = numBasePaks;
+	for( int i = 0; i < NUM_GENERATED_PAKS; i++ ) {
+		Q_snprintfz( paks[numPaks], PAK_MAX_PATH, "%s/%s/generated%d.pk3", FS_WriteDirectory(), TEST_DIR, i );
+		if( !PI_GeneratePak( paks[numPaks], i, 0 ) ) {
+			Com_Error( ERR_FATAL, "Couldn't write %s", paks[numPaks] );
+		}
+		numPaks++;
+	}
+
+	printf( "%d paks in %s, %d generated\n", numBasePaks, FS_BaseGameDirectory(), NUM_GENERATED_PAKS );
+
+	RNG rng = new_rng( 1, 0 );
+	int64_t start = Sys_Milliseconds();
+
+	for( int r = 0; r < rounds; r++ ) {
+		for( int i = 0; i < numPaks; i++ ) {
+			const char *other = paks[( i + 1 ) % numPaks];
+			PakListing cold = PI_TestPak( paks[i], other, &rng );
+			PI_FreeListing( &cold );
+		}
+
+		// stale: the pak changes size and contents under its index
+		for( int i = 0; i < NUM_GENERATED_PAKS; i++ ) {
+			const char *pak = paks[numBasePaks + i];
+
+			PakListing old = PI_Inspect( pak );
+			PI_GeneratePak( pak, i, r + 1 );
+
+			PakListing fresh = PI_Inspect( pak );
+			PI_Check( fresh.loaded && !fresh.indexed, pak, "stale index wasn't ignored" );
+			PI_Check( fresh.checksum != old.checksum, pak, "checksum didn't change with the contents" );
+			PI_CheckGeneratedContents( pak, i, r + 1 );
+
+			PakListing reindexed = PI_Inspect( pak );
+			PI_Check( reindexed.loaded && reindexed.indexed, pak, "index wasn't rebuilt after the pak changed" );
+			PI_Check( PI_SameListing( &fresh, &reindexed ), pak, "rebuilt index differs" );
+
+			PI_FreeListing( &old );
+			PI_FreeListing( &fresh );
+			PI_FreeListing( &reindexed );
+		}
+	}
+
+	printf( "%d rounds in %" PRIi64 "ms, %d of %d checks failed\n", rounds, Sys_Milliseconds() - start, failures, checks );
+
+	for( int i = 0; i < NUM_GENERATED_PAKS; i++ ) {
+		char indexname[PAK_MAX_PATH];
+		FS_PK3IndexName( paks[numBasePaks + i], indexname, sizeof( indexname ) );
+		remove( indexname );
+		remove( paks[numBasePaks + i] );
+	}
+
+	Qcommon_Shutdown();
+
+	return failures == 0 ? 0 : 1;
+}
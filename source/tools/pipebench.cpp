@@ -0,0 +1,351 @@
+// pipebench.cpp -- QBufPipe throughput benchmark
+//
+// usage: pipebench [commands]
+//
+// Streams commands of a few sizes from the main thread to a reader thread
+// through QBufPipe and through the mutex/condvar pipe it replaced, and
+// measures a ping-pong where the writer waits for every command to be
+// handled, which is dominated by waking the reader.
+
+#include "qcommon/qcommon.h"
+#include "qcommon/qthreads.h"
+#include "qcommon/sys_threads.h"
+
+#define PIPE_SIZE 0x10000
+#define DEFAULT_COMMANDS 2000000
+#define PINGPONG_COMMANDS 100000
+
+//==================================================
+// LOCKED PIPE
+//==================================================
+
+// the old QBufPipe, which wakes the reader under a mutex on every command
+struct LockedPipe {
+	int blockWrite;
+	volatile int terminated;
+	unsigned write_pos;
+	unsigned read_pos;
+	volatile int cmdbuf_len;
+	size_t bufSize;
+	qcondvar_t *nonempty_condvar;
+	qmutex_t *nonempty_mutex;
+	char *buf;
+};
+
+typedef unsigned ( *PipeCmdHandler )( const void * );
+
+static LockedPipe *LockedPipe_Create( size_t bufSize, int flags ) {
+	LockedPipe *pipe = ( LockedPipe * ) malloc( sizeof( *pipe ) + bufSize );
+	memset( pipe, 0, sizeof( *pipe ) );
+	pipe->blockWrite = flags & 1;
+	pipe->buf = (char *)( pipe + 1 );
+	pipe->bufSize = bufSize;
+	pipe->nonempty_condvar = QCondVar_Create();
+	pipe->nonempty_mutex = QMutex_Create();
+	return pipe;
+}
+
+static void LockedPipe_Destroy( LockedPipe **ppipe ) {
+	LockedPipe *pipe = *ppipe;
+	*ppipe = NULL;
+	QMutex_Destroy( &pipe->nonempty_mutex );
+	QCondVar_Destroy( &pipe->nonempty_condvar );
+	free( pipe );
+}
+
+static void LockedPipe_Finish( LockedPipe *pipe ) {
+	while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0 ) == false && !pipe->terminated ) {
+		QMutex_Lock( pipe->nonempty_mutex );
+		QCondVar_Wake( pipe->nonempty_condvar );
+		QMutex_Unlock( pipe->nonempty_mutex );
+		QThread_Yield();
+	}
+}
+
+static void *LockedPipe_AllocCmd( LockedPipe *pipe, unsigned cmd_size ) {
+	void *buf = &pipe->buf[pipe->write_pos];
+	pipe->write_pos += cmd_size;
+	return buf;
+}
+
+static void LockedPipe_WriteCmd( LockedPipe *pipe, const void *pcmd, unsigned cmd_size ) {
+	void *buf;
+	unsigned write_remains;
+
+	if( pipe->terminated ) {
+		return;
+	}
+
+	write_remains = pipe->bufSize - pipe->write_pos;
+
+	if( sizeof( int ) > write_remains ) {
+		while( pipe->cmdbuf_len + cmd_size + write_remains > pipe->bufSize ) {
+			if( pipe->blockWrite ) {
+				QThread_Yield();
+				continue;
+			}
+			return;
+		}
+
+		Sys_Atomic_FetchAdd( &pipe->cmdbuf_len, write_remains );
+		pipe->write_pos = 0;
+	} else if( cmd_size > write_remains ) {
+		int *cmd;
+
+		while( pipe->cmdbuf_len + sizeof( int ) + cmd_size + write_remains > pipe->bufSize ) {
+			if( pipe->blockWrite ) {
+				QThread_Yield();
+				continue;
+			}
+			return;
+		}
+
+		cmd = ( int * ) LockedPipe_AllocCmd( pipe, sizeof( int ) );
+		*cmd = -1;
+
+		Sys_Atomic_FetchAdd( &pipe->cmdbuf_len, sizeof( *cmd ) + write_remains );
+		pipe->write_pos = 0;
+	} else {
+		while( pipe->cmdbuf_len + cmd_size > pipe->bufSize ) {
+			if( pipe->blockWrite ) {
+				QThread_Yield();
+				continue;
+			}
+			return;
+		}
+	}
+
+	buf = LockedPipe_AllocCmd( pipe, cmd_size );
+	memcpy( buf, pcmd, cmd_size );
+	Sys_Atomic_FetchAdd( &pipe->cmdbuf_len, cmd_size );
+
+	QMutex_Lock( pipe->nonempty_mutex );
+	QCondVar_Wake( pipe->nonempty_condvar );
+	QMutex_Unlock( pipe->nonempty_mutex );
+}
+
+static int LockedPipe_ReadCmds( LockedPipe *pipe, PipeCmdHandler *cmdHandlers ) {
+	int read = 0;
+
+	while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0 ) == false && !pipe->terminated ) {
+		size_t read_remains = pipe->bufSize - pipe->read_pos;
+
+		if( sizeof( int ) > read_remains ) {
+			pipe->read_pos = 0;
+			Sys_Atomic_FetchAdd( &pipe->cmdbuf_len, -read_remains );
+		}
+
+		int cmd = *( (int *)( pipe->buf + pipe->read_pos ) );
+		if( cmd == -1 ) {
+			pipe->read_pos = 0;
+			Sys_Atomic_FetchAdd( &pipe->cmdbuf_len, -( (int)( sizeof( int ) + read_remains ) ) );
+			continue;
+		}
+
+		int cmd_size = cmdHandlers[cmd]( pipe->buf + pipe->read_pos );
+		read++;
+
+		if( !cmd_size ) {
+			pipe->terminated = 1;
+			return -1;
+		}
+
+		pipe->read_pos += cmd_size;
+		Sys_Atomic_FetchAdd( &pipe->cmdbuf_len, -cmd_size );
+	}
+
+	return read;
+}
+
+static void LockedPipe_Wait( LockedPipe *pipe, PipeCmdHandler *cmdHandlers ) {
+	while( !pipe->terminated ) {
+		while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0 ) == true ) {
+			QMutex_Lock( pipe->nonempty_mutex );
+			QCondVar_Wait( pipe->nonempty_condvar, pipe->nonempty_mutex );
+			QMutex_Unlock( pipe->nonempty_mutex );
+			break;
+		}
+
+		if( LockedPipe_ReadCmds( pipe, cmdHandlers ) < 0 ) {
+			return;
+		}
+	}
+}
+
+//==================================================
+// BENCHMARKS
+//==================================================
+
+// both pipes behind one interface so the benchmarks run the same code
+struct PipeImpl {
+	const char *name;
+	void *( *Create )();
+	void ( *Destroy )( void *pipe );
+	void ( *Finish )( void *pipe );
+	void ( *WriteCmd )( void *pipe, const void *cmd, unsigned cmd_size );
+	void ( *Wait )( void *pipe, PipeCmdHandler *cmdHandlers );
+};
+
+static void *PB_QBufPipeCreate() {
+	return QBufPipe_Create( PIPE_SIZE, 1 );
+}
+
+static void PB_QBufPipeDestroy( void *pipe ) {
+	qbufPipe_t *p = ( qbufPipe_t * ) pipe;
+	QBufPipe_Destroy( &p );
+}
+
+static void PB_QBufPipeFinish( void *pipe ) {
+	QBufPipe_Finish( ( qbufPipe_t * ) pipe );
+}
+
+static void PB_QBufPipeWriteCmd( void *pipe, const void *cmd, unsigned cmd_size ) {
+	QBufPipe_WriteCmd( ( qbufPipe_t * ) pipe, cmd, cmd_size );
+}
+
+static void PB_QBufPipeWait( void *pipe, PipeCmdHandler *cmdHandlers ) {
+	QBufPipe_Wait( ( qbufPipe_t * ) pipe, QBufPipe_ReadCmds, cmdHandlers );
+}
+
+static void *PB_LockedPipeCreate() {
+	return LockedPipe_Create( PIPE_SIZE, 1 );
+}
+
+static void PB_LockedPipeDestroy( void *pipe ) {
+	LockedPipe *p = ( LockedPipe * ) pipe;
+	LockedPipe_Destroy( &p );
+}
+
+static void PB_LockedPipeFinish( void *pipe ) {
+	LockedPipe_Finish( ( LockedPipe * ) pipe );
+}
+
+static void PB_LockedPipeWriteCmd( void *pipe, const void *cmd, unsigned cmd_size ) {
+	LockedPipe_WriteCmd( ( LockedPipe * ) pipe, cmd, cmd_size );
+}
+
+static void PB_LockedPipeWait( void *pipe, PipeCmdHandler *cmdHandlers ) {
+	LockedPipe_Wait( ( LockedPipe * ) pipe, cmdHandlers );
+}
+
+static const PipeImpl pipe_impls[] = {
+	{ "locked", PB_LockedPipeCreate, PB_LockedPipeDestroy, PB_LockedPipeFinish, PB_LockedPipeWriteCmd, PB_LockedPipeWait },
+	{ "spsc", PB_QBufPipeCreate, PB_QBufPipeDestroy, PB_QBufPipeFinish, PB_QBufPipeWriteCmd, PB_QBufPipeWait },
+};
+
+enum {
+	CMD_DATA,
+	CMD_QUIT,
+};
+
+struct BenchCmd {
+	int id;
+	unsigned size;
+	unsigned seq;
+	uint8_t payload[1];
+};
+
+struct Reader {
+	const PipeImpl *impl;
+	void *pipe;
+};
+
+// only touched by the reader thread until it's joined
+static unsigned reader_seq;
+static uint64_t reader_bytes;
+static bool reader_out_of_order;
+
+static unsigned PB_HandleData( const void *pcmd ) {
+	const BenchCmd *cmd = ( const BenchCmd * ) pcmd;
+	if( cmd->seq != reader_seq ) {
+		reader_out_of_order = true;
+	}
+	reader_seq++;
+	reader_bytes += cmd->size;
+	return cmd->size;
+}
+
+static unsigned PB_HandleQuit( const void *pcmd ) {
+	return 0;
+}
+
+static void *PB_ReaderThread( void *param ) {
+	Reader *reader = ( Reader * ) param;
+	PipeCmdHandler handlers[] = { PB_HandleData, PB_HandleQuit };
+	reader->impl->Wait( reader->pipe, handlers );
+	return NULL;
+}
+
+/*
+* PB_Run
+*
+* Writes count commands of cmd_size bytes and returns how long it took the
+* reader to handle them all
+*/
+static uint64_t PB_Run( const PipeImpl *impl, int count, unsigned cmd_size, bool pingpong ) {
+	uint8_t data[1024];
+	BenchCmd *cmd = ( BenchCmd * ) data;
+	memset( data, 0, sizeof( data ) );
+	assert( cmd_size <= sizeof( data ) );
+
+	reader_seq = 0;
+	reader_bytes = 0;
+	reader_out_of_order = false;
+
+	Reader reader;
+	reader.impl = impl;
+	reader.pipe = impl->Create();
+	qthread_t *thread = QThread_Create( PB_ReaderThread, &reader );
+
+	uint64_t start = Sys_Microseconds();
+
+	cmd->id = CMD_DATA;
+	cmd->size = cmd_size;
+	for( int i = 0; i < count; i++ ) {
+		cmd->seq = i;
+		impl->WriteCmd( reader.pipe, cmd, cmd_size );
+		if( pingpong ) {
+			impl->Finish( reader.pipe );
+		}
+	}
+
+	int quit = CMD_QUIT;
+	impl->WriteCmd( reader.pipe, &quit, sizeof( quit ) );
+	impl->Finish( reader.pipe );
+	QThread_Join( thread );
+
+	uint64_t usec = Sys_Microseconds() - start;
+
+	impl->Destroy( reader.pipe );
+
+	if( reader_seq != unsigned( count ) || reader_out_of_order || reader_bytes != uint64_t( count ) * cmd_size ) {
+		Sys_Error( "%s pipe lost or reordered commands: %u of %d", impl->name, reader_seq, count );
+	}
+
+	return usec;
+}
+
+int main( int argc, char **argv ) {
+	int count = argc >= 2 ? atoi( argv[1] ) : DEFAULT_COMMANDS;
+	const unsigned sizes[] = { 16, 64, 256 };
+
+	if( count < 1 ) {
+		printf( "usage: %s [commands]\n", argv[0] );
+		return 1;
+	}
+
+	for( size_t s = 0; s < ARRAY_COUNT( sizes ); s++ ) {
+		for( size_t i = 0; i < ARRAY_COUNT( pipe_impls ); i++ ) {
+			uint64_t usec = Max2( PB_Run( &pipe_impls[i], count, sizes[s], false ), uint64_t( 1 ) );
+			printf( "%-8s %4u bytes %8d cmds %8.2f Mcmds/s %8.1f MB/s\n", pipe_impls[i].name, sizes[s], count,
+				count / double( usec ), double( count ) * sizes[s] / usec );
+		}
+	}
+
+	for( size_t i = 0; i < ARRAY_COUNT( pipe_impls ); i++ ) {
+		uint64_t usec = PB_Run( &pipe_impls[i], PINGPONG_COMMANDS, 16, true );
+		printf( "%-8s pingpong %8d cmds %8.2f us/cmd\n", pipe_impls[i].name, PINGPONG_COMMANDS, usec / double( PINGPONG_COMMANDS ) );
+	}
+
+	return 0;
+}
@@ -0,0 +1,109 @@
+// pk3writer.cpp -- minimal pk3 writer for the tools
+
+#include "qcommon/qcommon.h"
+#include "tools/pk3writer.h"
+#include "zlib/zlib.h"
+
+static void PK3_Append( uint8_t **buf, size_t *len, size_t *size, const void *data, size_t n ) {
+	if( *len + n > *size ) {
+		*size = Max2( *len + n, *size * 2 );
+		*buf = ( uint8_t * )realloc( *buf, *size );
+	}
+	memcpy( *buf + *len, data, n );
+	*len += n;
+}
+
+static void PK3_PutShort( uint8_t *p, unsigned v ) {
+	p[0] = v & 0xff;
+	p[1] = ( v >> 8 ) & 0xff;
+}
+
+static void PK3_PutLong( uint8_t *p, unsigned v ) {
+	PK3_PutShort( p, v & 0xffff );
+	PK3_PutShort( p + 2, v >> 16 );
+}
+
+void PK3_AddFile( PK3Writer *zip, const char *name, const uint8_t *contents, size_t len, bool compress ) {
+	uint8_t *stored = ( uint8_t * )contents;
+	size_t storedLen = len;
+
+	if( compress ) {
+		z_stream zs;
+		memset( &zs, 0, sizeof( zs ) );
+		deflateInit2( &zs, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY );
+
+		storedLen = deflateBound( &zs, len );
+		stored = ( uint8_t * )malloc( storedLen );
+		zs.next_in = ( Bytef * )contents;
+		zs.avail_in = len;
+		zs.next_out = stored;
+		zs.avail_out = storedLen;
+		deflate( &zs, Z_FINISH );
+		storedLen = zs.total_out;
+		deflateEnd( &zs );
+	}
+
+	unsigned crc = crc32( 0, contents, len );
+	unsigned nameLen = strlen( name );
+	unsigned offset = zip->len;
+
+	uint8_t local[30];
+	memset( local, 0, sizeof( local ) );
+	PK3_PutLong( &local[0], 0x04034b50 );
+	PK3_PutShort( &local[4], 20 );
+	PK3_PutShort( &local[8], compress ? Z_DEFLATED : 0 );
+	PK3_PutLong( &local[14], crc );
+	PK3_PutLong( &local[18], storedLen );
+	PK3_PutLong( &local[22], len );
+	PK3_PutShort( &local[26], nameLen );
+	PK3_Append( &zip->data, &zip->len, &zip->size, local, sizeof( local ) );
+	PK3_Append( &zip->data, &zip->len, &zip->size, name, nameLen );
+	PK3_Append( &zip->data, &zip->len, &zip->size, stored, storedLen );
+
+	uint8_t central[46];
+	memset( central, 0, sizeof( central ) );
+	PK3_PutLong( &central[0], 0x02014b50 );
+	PK3_PutShort( &central[4], 20 );
+	PK3_PutShort( &central[6], 20 );
+	PK3_PutShort( &central[10], compress ? Z_DEFLATED : 0 );
+	PK3_PutLong( &central[16], crc );
+	PK3_PutLong( &central[20], storedLen );
+	PK3_PutLong( &central[24], len );
+	PK3_PutShort( &central[28], nameLen );
+	PK3_PutLong( &central[42], offset );
+	PK3_Append( &zip->central, &zip->centralLen, &zip->centralSize, central, sizeof( central ) );
+	PK3_Append( &zip->central, &zip->centralLen, &zip->centralSize, name, nameLen );
+
+	zip->numFiles++;
+
+	if( stored != contents ) {
+		free( stored );
+	}
+}
+
+bool PK3_Write( PK3Writer *zip, const char *filename ) {
+	unsigned centralOffset = zip->len;
+
+	PK3_Append( &zip->data, &zip->len, &zip->size, zip->central, zip->centralLen );
+
+	uint8_t end[22];
+	memset( end, 0, sizeof( end ) );
+	PK3_PutLong( &end[0], 0x06054b50 );
+	PK3_PutShort( &end[8], zip->numFiles );
+	PK3_PutShort( &end[10], zip->numFiles );
+	PK3_PutLong( &end[12], zip->centralLen );
+	PK3_PutLong( &end[16], centralOffset );
+	PK3_Append( &zip->data, &zip->len, &zip->size, end, sizeof( end ) );
+
+	FILE *f = fopen( filename, "wb" );
+	bool ok = f != NULL && fwrite( zip->data, 1, zip->len, f ) == zip->len;
+	if( f != NULL ) {
+		ok = fclose( f ) == 0 && ok;
+	}
+
+	free( zip->data );
+	free( zip->central );
+	memset( zip, 0, sizeof( *zip ) );
+
+	return ok;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// builds a pk3 in memory, entries are stored or deflated and written in the
+// order they're added. directories are added as empty entries ending in /
+
+struct PK3Writer {
+	uint8_t *data;
+	size_t len, size;
+	uint8_t *central;
+	size_t centralLen, centralSize;
+	int numFiles;
+};
+
+void PK3_AddFile( PK3Writer *zip, const char *name, const uint8_t *contents, size_t len, bool compress );
+
+// writes the pk3 out and resets the writer
+bool PK3_Write( PK3Writer *zip, const char *filename );
@@ -0,0 +1,751 @@
+// pmovebench.cpp -- headless pmove/collision replay benchmark
+//
+// usage: pmovebench <map> [stream]
+//
+// Loads maps/<map>.bsp through CM_LoadMap and replays a stream of player
+// moves through Pmove and a stream of hitscan traces through
+// CM_TransformedBoxTrace. The recorded player positions are also replayed
+// through CM_MergePVS as PVS_VIEWPOINTS clients per server frame. If the
+// stream file doesn't exist it is generated by walking some bots around
+// the map and saved, so later runs replay exactly the same input.
+//
+// Player sized box traces are cast in random directions from the recorded
+// positions too. The moves and traces are then replayed on the map loaded
+// with cm_patchBVH 0, which scans patch facets linearly, and every trace
+// and point contents result is checked against the facet tree.
+//
+// Finally the moves and box traces are replayed once serially and then on
+// the job pool with 1, 2, 4 and 8 workers, all against the one collision
+// model. Each box trace is also cast into a box or octagon hull set up on
+// the worker running it. Every pmove_t, player state, predicted event and
+// trace result must match the serial replay.
+
+#include "qcommon/qcommon.h"
+#include "qcommon/cmodel.h"
+#include "qcommon/qthreads.h"
+#include "qalgo/hash.h"
+#include "qalgo/rng.h"
+#include "gameshared/gs_public.h"
+
+#define PMOVEBENCH_MAGIC "PMVB"
+#define PMOVEBENCH_VERSION 1
+
+#define GEN_PLAYERS 16
+#define GEN_FRAMES 4000
+#define GEN_MSEC 16
+#define GEN_SHOT_INTERVAL 6
+
+#define PVS_VIEWPOINTS 64
+
+#define MAX_REPLAY_WORKERS 8
+
+#define BOX_TRACE_INTERVAL 4
+#define BOX_TRACE_MIN_LENGTH 32
+#define BOX_TRACE_MAX_LENGTH 1024
+
+struct RecordedMove {
+	player_state_t ps;
+	usercmd_t cmd;
+};
+
+struct RecordedTrace {
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	int brushmask;
+};
+
+static cmodel_state_t *cms;
+
+static RecordedMove *moves;
+static int num_moves;
+static RecordedTrace *traces;
+static int num_traces;
+static RecordedTrace *box_traces;
+static int num_box_traces;
+
+static int pmove_events;
+
+struct PmoveResult {
+	pmove_t pm;                 // with playerState cleared
+	player_state_t ps;
+	int num_events;
+	uint32_t events;            // hash of the predicted events
+};
+
+struct TraceResult {
+	trace_t world;
+	trace_t hull;
+};
+
+static thread_local PmoveResult *thread_result;
+
+//==================================================
+// GS MODULE API
+//==================================================
+
+static void PB_Trace( trace_t *t, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int ignore, int contentmask, int timeDelta ) {
+	CM_TransformedBoxTrace( cms, t, start, end, mins, maxs, NULL, contentmask, NULL, NULL );
+	t->ent = t->fraction < 1.0f ? 0 : -1;
+}
+
+static entity_state_t *PB_GetEntityState( int entNum, int deltaTime ) {
+	static entity_state_t world;
+	return &world;
+}
+
+static int PB_PointContents( const vec3_t point, int timeDelta ) {
+	return CM_TransformedPointContents( cms, point, NULL, NULL, NULL );
+}
+
+static void PB_PredictedEvent( int entNum, int ev, int parm ) {
+	if( thread_result != NULL ) {
+		int event[3] = { entNum, ev, parm };
+		thread_result->events = Hash32( event, sizeof( event ), thread_result->events );
+		thread_result->num_events++;
+		return;
+	}
+
+	pmove_events++;
+}
+
+static void PB_PMoveTouchTriggers( pmove_t *pm, vec3_t previous_origin ) { }
+
+static const char *PB_GetConfigString( int index ) {
+	return "";
+}
+
+static void PB_Printf( const char *format, ... ) {
+	va_list argptr;
+	char msg[1024];
+
+	va_start( argptr, format );
+	Q_vsnprintfz( msg, sizeof( msg ), format, argptr );
+	va_end( argptr );
+
+	Com_Printf( "%s", msg );
+}
+
+static void PB_Error( const char *format, ... ) {
+	va_list argptr;
+	char msg[1024];
+
+	va_start( argptr, format );
+	Q_vsnprintfz( msg, sizeof( msg ), format, argptr );
+	va_end( argptr );
+
+	Com_Error( ERR_FATAL, "%s", msg );
+}
+
+static void PB_InitGS() {
+	gs_module_api_t api;
+	memset( &api, 0, sizeof( api ) );
+
+	api.Printf = PB_Printf;
+	api.Error = PB_Error;
+	api.Trace = PB_Trace;
+	api.GetEntityState = PB_GetEntityState;
+	api.PointContents = PB_PointContents;
+	api.PredictedEvent = PB_PredictedEvent;
+	api.PMoveTouchTriggers = PB_PMoveTouchTriggers;
+	api.GetConfigString = PB_GetConfigString;
+
+	GS_InitModule( GS_MODULE_GAME, GEN_PLAYERS, &api );
+}
+
+//==================================================
+// STREAM GENERATION
+//==================================================
+
+static int PB_FindSpawnPoints( vec3_t *origins, int max, const char *prefix ) {
+	const char *data = CM_EntityString( cms );
+	int num = 0;
+
+	while( num < max ) {
+		char *token = COM_Parse( &data );
+		if( !data || token[0] != '{' ) {
+			break;
+		}
+
+		char classname[MAX_QPATH] = { 0 };
+		vec3_t origin = { 0, 0, 0 };
+		bool has_origin = false;
+
+		while( true ) {
+			char key[MAX_TOKEN_CHARS];
+			Q_strncpyz( key, COM_Parse( &data ), sizeof( key ) );
+			if( !data || key[0] == '}' ) {
+				break;
+			}
+
+			token = COM_Parse( &data );
+			if( !strcmp( key, "classname" ) ) {
+				Q_strncpyz( classname, token, sizeof( classname ) );
+			} else if( !strcmp( key, "origin" ) ) {
+				has_origin = sscanf( token, "%f %f %f", &origin[0], &origin[1], &origin[2] ) == 3;
+			}
+		}
+
+		if( has_origin && !strncmp( classname, prefix, strlen( prefix ) ) ) {
+			VectorCopy( origin, origins[num] );
+			num++;
+		}
+	}
+
+	return num;
+}
+
+static void PB_SetTrace( RecordedTrace *t, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, int brushmask ) {
+	VectorCopy( start, t->start );
+	VectorCopy( end, t->end );
+	VectorCopy( mins, t->mins );
+	VectorCopy( maxs, t->maxs );
+	t->brushmask = brushmask;
+}
+
+static void PB_GenerateStream() {
+	vec3_t spawns[64];
+	int num_spawns = PB_FindSpawnPoints( spawns, ARRAY_COUNT( spawns ), "info_player_" );
+	if( num_spawns == 0 ) {
+		// CTF only maps
+		num_spawns = PB_FindSpawnPoints( spawns, ARRAY_COUNT( spawns ), "team_CTF_" );
+	}
+	if( num_spawns == 0 ) {
+		Com_Error( ERR_FATAL, "Map has no spawn points" );
+	}
+
+	player_state_t players[GEN_PLAYERS];
+	float yaws[GEN_PLAYERS];
+	RNG rng = new_rng( 1, 1 );
+
+	for( int i = 0; i < GEN_PLAYERS; i++ ) {
+		player_state_t *ps = &players[i];
+		memset( ps, 0, sizeof( *ps ) );
+
+		VectorCopy( spawns[i % num_spawns], ps->pmove.origin );
+		ps->pmove.origin[2] += 16;
+		ps->pmove.pm_type = PM_NORMAL;
+		ps->pmove.gravity = GRAVITY;
+		ps->pmove.stats[PM_STAT_FEATURES] = static_cast<unsigned short>( PMFEAT_DEFAULT );
+		ps->pmove.stats[PM_STAT_MAXSPEED] = (short)DEFAULT_PLAYERSPEED;
+		ps->pmove.stats[PM_STAT_JUMPSPEED] = (short)DEFAULT_JUMPSPEED;
+		ps->pmove.stats[PM_STAT_DASHSPEED] = (short)DEFAULT_DASHSPEED;
+		ps->POVnum = i + 1;
+		ps->playerNum = i;
+		ps->viewheight = playerbox_stand_viewheight;
+
+		yaws[i] = random_float01( &rng ) * 360.0f;
+	}
+
+	num_moves = 0;
+	num_traces = 0;
+	moves = ( RecordedMove * ) Mem_ZoneMalloc( GEN_PLAYERS * GEN_FRAMES * sizeof( RecordedMove ) );
+	traces = ( RecordedTrace * ) Mem_ZoneMalloc( GEN_PLAYERS * ( GEN_FRAMES / GEN_SHOT_INTERVAL + 1 ) * sizeof( RecordedTrace ) );
+
+	for( int frame = 0; frame < GEN_FRAMES; frame++ ) {
+		for( int i = 0; i < GEN_PLAYERS; i++ ) {
+			player_state_t *ps = &players[i];
+
+			// wander around, turning sharply now and then and more often when stuck
+			float speed = VectorLengthFast( ps->pmove.velocity );
+			if( random_p( &rng, 0.01f ) || ( speed < 50 && random_p( &rng, 0.1f ) ) ) {
+				yaws[i] = random_float01( &rng ) * 360.0f;
+			}
+			yaws[i] += random_float11( &rng ) * 4.0f;
+
+			usercmd_t cmd;
+			memset( &cmd, 0, sizeof( cmd ) );
+			cmd.msec = GEN_MSEC;
+			cmd.forwardmove = 127;
+			cmd.sidemove = random_p( &rng, 0.3f ) ? ( random_p( &rng, 0.5f ) ? 127 : -127 ) : 0;
+			cmd.upmove = random_p( &rng, 0.05f ) ? 127 : ( random_p( &rng, 0.02f ) ? -127 : 0 );
+			if( random_p( &rng, 0.03f ) ) {
+				cmd.buttons |= BUTTON_SPECIAL;
+			}
+			cmd.angles[YAW] = ANGLE2SHORT( yaws[i] ) - ps->pmove.delta_angles[YAW];
+			cmd.angles[PITCH] = ANGLE2SHORT( random_float11( &rng ) * 30.0f ) - ps->pmove.delta_angles[PITCH];
+
+			RecordedMove *move = &moves[num_moves++];
+			move->ps = *ps;
+			move->cmd = cmd;
+
+			pmove_t pm;
+			memset( &pm, 0, sizeof( pm ) );
+			pm.playerState = ps;
+			pm.cmd = cmd;
+			Pmove( &pm );
+
+			if( frame % GEN_SHOT_INTERVAL == 0 ) {
+				vec3_t start, end, dir;
+				VectorCopy( ps->pmove.origin, start );
+				start[2] += ps->viewheight;
+				AngleVectors( ps->viewangles, dir, NULL, NULL );
+				VectorMA( start, 8192, dir, end );
+				PB_SetTrace( &traces[num_traces++], start, end, vec3_origin, vec3_origin, MASK_SHOT );
+			}
+		}
+	}
+}
+
+/*
+* PB_GenerateBoxTraces
+*
+* These aren't saved with the stream, they're always generated the same way from it
+*/
+static void PB_GenerateBoxTraces() {
+	RNG rng = new_rng( 2, 2 );
+
+	num_box_traces = 0;
+	box_traces = ( RecordedTrace * ) Mem_ZoneMalloc( ( num_moves / BOX_TRACE_INTERVAL + 1 ) * sizeof( RecordedTrace ) );
+
+	for( int i = 0; i < num_moves; i += BOX_TRACE_INTERVAL ) {
+		vec3_t dir, end;
+		do {
+			dir[0] = random_float11( &rng );
+			dir[1] = random_float11( &rng );
+			dir[2] = random_float11( &rng );
+		} while( VectorNormalize( dir ) < 0.1f );
+
+		const float *start = moves[i].ps.pmove.origin;
+		VectorMA( start, random_uniform( &rng, BOX_TRACE_MIN_LENGTH, BOX_TRACE_MAX_LENGTH ), dir, end );
+		PB_SetTrace( &box_traces[num_box_traces++], start, end, playerbox_stand_mins, playerbox_stand_maxs, MASK_PLAYERSOLID );
+	}
+}
+
+//==================================================
+// STREAM IO
+//==================================================
+
+static bool PB_LoadStream( const char *filename ) {
+	int file;
+	int length = FS_FOpenFile( filename, &file, FS_READ );
+	if( length == -1 ) {
+		return false;
+	}
+
+	char magic[4];
+	int version;
+	const size_t header = sizeof( magic ) + sizeof( version ) + sizeof( num_moves ) + sizeof( num_traces );
+	if( (size_t)length < header ) {
+		Com_Printf( "%s is truncated, regenerating\n", filename );
+		FS_FCloseFile( file );
+		return false;
+	}
+
+	FS_Read( magic, sizeof( magic ), file );
+	FS_Read( &version, sizeof( version ), file );
+	if( memcmp( magic, PMOVEBENCH_MAGIC, sizeof( magic ) ) != 0 || version != PMOVEBENCH_VERSION ) {
+		Com_Printf( "%s has the wrong format, regenerating\n", filename );
+		FS_FCloseFile( file );
+		return false;
+	}
+
+	// the counts must account for the rest of the file exactly
+	FS_Read( &num_moves, sizeof( num_moves ), file );
+	FS_Read( &num_traces, sizeof( num_traces ), file );
+	if( num_moves < 0 || num_traces < 0 || (size_t)num_moves > ( length - header ) / sizeof( RecordedMove )
+		|| header + num_moves * sizeof( RecordedMove ) + num_traces * sizeof( RecordedTrace ) != (size_t)length ) {
+		Com_Printf( "%s has bad counts, regenerating\n", filename );
+		FS_FCloseFile( file );
+		return false;
+	}
+
+	size_t moves_size = num_moves * sizeof( RecordedMove );
+	size_t traces_size = num_traces * sizeof( RecordedTrace );
+	moves = ( RecordedMove * ) Mem_ZoneMalloc( moves_size );
+	traces = ( RecordedTrace * ) Mem_ZoneMalloc( traces_size );
+	bool ok = FS_Read( moves, moves_size, file ) == (int)moves_size && FS_Read( traces, traces_size, file ) == (int)traces_size;
+	FS_FCloseFile( file );
+
+	if( !ok ) {
+		Com_Printf( "%s is truncated, regenerating\n", filename );
+		Mem_ZoneFree( moves );
+		Mem_ZoneFree( traces );
+		moves = NULL;
+		traces = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+static void PB_SaveStream( const char *filename ) {
+	int file;
+	if( FS_FOpenFile( filename, &file, FS_WRITE ) == -1 ) {
+		Com_Printf( "Couldn't open %s for writing\n", filename );
+		return;
+	}
+
+	int version = PMOVEBENCH_VERSION;
+	FS_Write( PMOVEBENCH_MAGIC, 4, file );
+	FS_Write( &version, sizeof( version ), file );
+	FS_Write( &num_moves, sizeof( num_moves ), file );
+	FS_Write( &num_traces, sizeof( num_traces ), file );
+	FS_Write( moves, num_moves * sizeof( RecordedMove ), file );
+	FS_Write( traces, num_traces * sizeof( RecordedTrace ), file );
+
+	FS_FCloseFile( file );
+}
+
+//==================================================
+// BENCHMARKS
+//==================================================
+
+static void PB_ResetCounters() {
+	c_traces = 0;
+	c_brush_traces = 0;
+	c_patch_bounds = 0;
+	c_pointcontents = 0;
+	pmove_events = 0;
+}
+
+static void PB_Report( const char *name, int ops, uint64_t usec ) {
+	Com_Printf( "%-8s %8d ops %10.1f ns/op  traces/op %6.2f  brush tests/op %8.2f  patch bounds/op %8.2f  pointcontents/op %6.2f\n",
+		name, ops, usec * 1000.0 / Max2( ops, 1 ), c_traces / float( Max2( ops, 1 ) ), c_brush_traces / float( Max2( ops, 1 ) ),
+		c_patch_bounds / float( Max2( ops, 1 ) ), c_pointcontents / float( Max2( ops, 1 ) ) );
+}
+
+static void PB_RunPmoves( const char *name ) {
+	PB_ResetCounters();
+
+	// checksum the results so optimisations can be checked for divergence
+	uint32_t checksum = 0;
+
+	uint64_t start = Sys_Microseconds();
+	for( int i = 0; i < num_moves; i++ ) {
+		player_state_t ps = moves[i].ps;
+
+		pmove_t pm;
+		memset( &pm, 0, sizeof( pm ) );
+		pm.playerState = &ps;
+		pm.cmd = moves[i].cmd;
+		Pmove( &pm );
+
+		checksum = Hash32( &ps.pmove, sizeof( ps.pmove ), checksum );
+	}
+	uint64_t usec = Sys_Microseconds() - start;
+
+	PB_Report( name, num_moves, usec );
+	Com_Printf( "         events %d  result checksum %08x\n", pmove_events, checksum );
+}
+
+static void PB_RunTraces( const char *name, const RecordedTrace *list, int count ) {
+	PB_ResetCounters();
+
+	uint32_t checksum = 0;
+
+	uint64_t start = Sys_Microseconds();
+	for( int i = 0; i < count; i++ ) {
+		const RecordedTrace *t = &list[i];
+
+		trace_t tr;
+		CM_TransformedBoxTrace( cms, &tr, t->start, t->end, t->mins, t->maxs, NULL, t->brushmask, NULL, NULL );
+
+		checksum = Hash32( &tr.fraction, sizeof( tr.fraction ), checksum );
+	}
+	uint64_t usec = Sys_Microseconds() - start;
+
+	PB_Report( name, count, usec );
+	Com_Printf( "         result checksum %08x\n", checksum );
+}
+
+/*
+* PB_FatPVSViewpoint
+*
+* The recording only has GEN_PLAYERS players, so the extra viewpoints replay
+* the same players from further along the recording
+*/
+static void PB_FatPVSViewpoint( int frame, int viewpoint, vec3_t org ) {
+	int frames = num_moves / GEN_PLAYERS;
+	int move_frame = ( frame + ( viewpoint / GEN_PLAYERS ) * frames / ( PVS_VIEWPOINTS / GEN_PLAYERS ) ) % frames;
+	const player_state_t *ps = &moves[move_frame * GEN_PLAYERS + viewpoint % GEN_PLAYERS].ps;
+
+	VectorCopy( ps->pmove.origin, org );
+	org[2] += ps->viewheight;
+}
+
+/*
+* PB_RunFatPVS
+*
+* Builds a fat PVS for PVS_VIEWPOINTS viewpoints per frame like SNAP_FatPVS
+*/
+static void PB_RunFatPVS( cmodel_state_t *pvs_cms, const char *name ) {
+	int rowsize = CM_ClusterRowSize( pvs_cms );
+	uint8_t *pvs = ( uint8_t * ) Mem_TempMalloc( rowsize );
+	int frames = num_moves / GEN_PLAYERS;
+	int ops = frames * PVS_VIEWPOINTS;
+	vec3_t org;
+
+	uint64_t start = Sys_Microseconds();
+	for( int frame = 0; frame < frames; frame++ ) {
+		for( int i = 0; i < PVS_VIEWPOINTS; i++ ) {
+			PB_FatPVSViewpoint( frame, i, org );
+			memset( pvs, 0, rowsize );
+			CM_MergePVS( pvs_cms, org, pvs );
+		}
+	}
+	uint64_t usec = Sys_Microseconds() - start;
+
+	// checksum separately so hashing the rows doesn't dominate the timing
+	uint32_t checksum = 0;
+	uint64_t visible = 0;
+	for( int frame = 0; frame < frames; frame++ ) {
+		for( int i = 0; i < PVS_VIEWPOINTS; i++ ) {
+			PB_FatPVSViewpoint( frame, i, org );
+			memset( pvs, 0, rowsize );
+			CM_MergePVS( pvs_cms, org, pvs );
+
+			checksum = Hash32( pvs, rowsize, checksum );
+			for( int j = 0; j < rowsize; j++ ) {
+				visible += __builtin_popcount( pvs[j] );
+			}
+		}
+	}
+
+	Com_Printf( "%-8s %8d ops %10.1f ns/op  %8.1f us/frame  visible clusters/op %8.2f\n",
+		name, ops, usec * 1000.0 / Max2( ops, 1 ), usec / float( Max2( frames, 1 ) ), visible / float( Max2( ops, 1 ) ) );
+	Com_Printf( "         result checksum %08x\n", checksum );
+
+	Mem_TempFree( pvs );
+}
+
+static bool PB_SameTrace( const trace_t *a, const trace_t *b ) {
+	return a->allsolid == b->allsolid && a->startsolid == b->startsolid && a->fraction == b->fraction &&
+		VectorCompare( a->endpos, b->endpos ) && VectorCompare( a->plane.normal, b->plane.normal ) &&
+		a->plane.dist == b->plane.dist && a->surfFlags == b->surfFlags && a->contents == b->contents;
+}
+
+static int PB_CompareTraceList( cmodel_state_t *linear_cms, const RecordedTrace *list, int count ) {
+	int mismatches = 0;
+
+	for( int i = 0; i < count; i++ ) {
+		const RecordedTrace *t = &list[i];
+		trace_t tree, linear;
+
+		CM_TransformedBoxTrace( cms, &tree, t->start, t->end, t->mins, t->maxs, NULL, t->brushmask, NULL, NULL );
+		CM_TransformedBoxTrace( linear_cms, &linear, t->start, t->end, t->mins, t->maxs, NULL, t->brushmask, NULL, NULL );
+		if( !PB_SameTrace( &tree, &linear ) ) {
+			mismatches++;
+		}
+
+		if( CM_TransformedPointContents( cms, tree.endpos, NULL, NULL, NULL ) !=
+			CM_TransformedPointContents( linear_cms, tree.endpos, NULL, NULL, NULL ) ) {
+			mismatches++;
+		}
+	}
+
+	return mismatches;
+}
+
+/*
+* PB_ComparePatchBVH
+*
+* Replays everything on the map loaded without patch facet trees, then
+* checks every trace result, and point contents at every trace end, against them
+*/
+static void PB_ComparePatchBVH( cmodel_state_t *linear_cms ) {
+	cmodel_state_t *tree_cms = cms;
+
+	cms = linear_cms;
+	PB_RunPmoves( "pmove-l" );
+	PB_RunTraces( "trace-l", traces, num_traces );
+	PB_RunTraces( "box-l", box_traces, num_box_traces );
+	cms = tree_cms;
+
+	int mismatches = PB_CompareTraceList( linear_cms, traces, num_traces ) +
+		PB_CompareTraceList( linear_cms, box_traces, num_box_traces );
+	Com_Printf( "patch facet tree: %d traces compared, %d mismatches\n", num_traces + num_box_traces, mismatches );
+}
+
+//==================================================
+// CONCURRENT REPLAY
+//==================================================
+
+static void PB_ReplayRange( void *data, int begin, int end ) {
+	PmoveResult *results = ( PmoveResult * ) data;
+
+	for( int i = begin; i < end; i++ ) {
+		PmoveResult *result = &results[i];
+		memset( result, 0, sizeof( *result ) );
+		result->ps = moves[i].ps;
+
+		thread_result = result;
+		result->pm.playerState = &result->ps;
+		result->pm.cmd = moves[i].cmd;
+		Pmove( &result->pm );
+		result->pm.playerState = NULL;
+		thread_result = NULL;
+	}
+}
+
+static void PB_TraceRange( void *data, int begin, int end ) {
+	TraceResult *results = ( TraceResult * ) data;
+
+	for( int i = begin; i < end; i++ ) {
+		const RecordedTrace *t = &box_traces[i];
+		TraceResult *result = &results[i];
+
+		CM_TransformedBoxTrace( cms, &result->world, t->start, t->end, t->mins, t->maxs, NULL, t->brushmask, NULL, NULL );
+
+		// a point cast into a player sized hull halfway along the trace
+		vec3_t mid;
+		VectorAdd( t->start, t->end, mid );
+		VectorScale( mid, 0.5f, mid );
+		vec3_t mins, maxs;
+		VectorCopy( t->mins, mins );
+		VectorCopy( t->maxs, maxs );
+		struct cmodel_s *hull = ( i & 1 ) ? CM_OctagonModelForBBox( cms, mins, maxs ) : CM_ModelForBBox( cms, mins, maxs );
+		CM_TransformedBoxTrace( cms, &result->hull, t->start, t->end, vec3_origin, vec3_origin, hull, t->brushmask, mid, vec3_origin );
+	}
+}
+
+static bool PB_SameResult( const PmoveResult *a, const PmoveResult *b ) {
+	return memcmp( &a->pm, &b->pm, sizeof( a->pm ) ) == 0 && memcmp( &a->ps, &b->ps, sizeof( a->ps ) ) == 0
+		&& a->num_events == b->num_events && a->events == b->events;
+}
+
+/*
+* PB_CompareConcurrentReplays
+*
+* Replays every move and box trace serially and then on the job pool with
+* several worker counts, and checks that each concurrent result matches the
+* serial one
+*/
+static int PB_CompareConcurrentReplays() {
+	PmoveResult *serial = ( PmoveResult * ) Mem_ZoneMalloc( num_moves * sizeof( PmoveResult ) );
+	PmoveResult *concurrent = ( PmoveResult * ) Mem_ZoneMalloc( num_moves * sizeof( PmoveResult ) );
+	TraceResult *serial_traces = ( TraceResult * ) Mem_ZoneMalloc( num_box_traces * sizeof( TraceResult ) );
+	TraceResult *concurrent_traces = ( TraceResult * ) Mem_ZoneMalloc( num_box_traces * sizeof( TraceResult ) );
+
+	uint64_t start = Sys_Microseconds();
+	PB_ReplayRange( serial, 0, num_moves );
+	Com_Printf( "replay   serial     %8.1f ms\n", ( Sys_Microseconds() - start ) / 1000.0 );
+
+	start = Sys_Microseconds();
+	PB_TraceRange( serial_traces, 0, num_box_traces );
+	Com_Printf( "traces   serial     %8.1f ms\n", ( Sys_Microseconds() - start ) / 1000.0 );
+
+	static const int worker_counts[] = { 1, 2, 4, MAX_REPLAY_WORKERS };
+	int total_mismatches = 0;
+
+	for( size_t w = 0; w < ARRAY_COUNT( worker_counts ); w++ ) {
+		QJobs_Shutdown();
+		QJobs_Init( worker_counts[w] );
+
+		start = Sys_Microseconds();
+		QJob_ParallelFor( num_moves, 0, PB_ReplayRange, concurrent );
+		uint64_t usec = Sys_Microseconds() - start;
+
+		int mismatches = 0;
+		for( int i = 0; i < num_moves; i++ ) {
+			if( !PB_SameResult( &serial[i], &concurrent[i] ) ) {
+				if( mismatches == 0 ) {
+					Com_Printf( "first mismatch at move %d (player %d)\n", i, moves[i].ps.playerNum );
+				}
+				mismatches++;
+			}
+		}
+
+		Com_Printf( "replay   %d workers  %8.1f ms  %d moves compared, %d mismatches\n", QJobs_NumWorkers(), usec / 1000.0, num_moves, mismatches );
+		total_mismatches += mismatches;
+
+		start = Sys_Microseconds();
+		QJob_ParallelFor( num_box_traces, 0, PB_TraceRange, concurrent_traces );
+		usec = Sys_Microseconds() - start;
+
+		mismatches = 0;
+		for( int i = 0; i < num_box_traces; i++ ) {
+			if( !PB_SameTrace( &serial_traces[i].world, &concurrent_traces[i].world ) ||
+				!PB_SameTrace( &serial_traces[i].hull, &concurrent_traces[i].hull ) ) {
+				mismatches++;
+			}
+		}
+
+		Com_Printf( "traces   %d workers  %8.1f ms  %d traces compared, %d mismatches\n", QJobs_NumWorkers(), usec / 1000.0, num_box_traces, mismatches );
+		total_mismatches += mismatches;
+	}
+
+	// back to the default pool
+	QJobs_Shutdown();
+	QJobs_Init();
+
+	Mem_ZoneFree( serial );
+	Mem_ZoneFree( concurrent );
+	Mem_ZoneFree( serial_traces );
+	Mem_ZoneFree( concurrent_traces );
+
+	return total_mismatches;
+}
+
+int main( int argc, char **argv ) {
+	if( argc < 2 ) {
+		printf( "usage: %s <map> [stream]\n", argv[0] );
+		return 1;
+	}
+
+	const char *map = argv[1];
+	char stream[MAX_QPATH];
+	if( argc >= 3 ) {
+		Q_strncpyz( stream, argv[2], sizeof( stream ) );
+	} else {
+		Q_snprintfz( stream, sizeof( stream ), "pmovebench/%s.pmv", map );
+	}
+
+	char * qargv[] = { argv[0] };
+	Qcommon_Init( 1, qargv );
+
+	cms = CM_New( NULL );
+	CM_AddReference( cms );
+
+	char bsp[MAX_QPATH];
+	unsigned checksum;
+	Q_snprintfz( bsp, sizeof( bsp ), "maps/%s.bsp", map );
+	CM_LoadMap( cms, bsp, false, &checksum );
+
+	PB_InitGS();
+
+	if( !PB_LoadStream( stream ) ) {
+		Com_Printf( "Generating %s\n", stream );
+		PB_GenerateStream();
+		PB_SaveStream( stream );
+	}
+
+	PB_GenerateBoxTraces();
+
+	Com_Printf( "%s: %d moves, %d traces, %d box traces, %d clusters\n", bsp, num_moves, num_traces, num_box_traces, CM_NumClusters( cms ) );
+
+	PB_RunPmoves( "pmove" );
+	PB_RunTraces( "trace", traces, num_traces );
+	PB_RunTraces( "box", box_traces, num_box_traces );
+	PB_RunFatPVS( cms, "fatpvs" );
+
+	// load the map again with the rows expanded up front
+	Cvar_ForceSet( "cm_fatPVSPrecompute", "1" );
+	cmodel_state_t *precomputed_cms = CM_New( NULL );
+	CM_AddReference( precomputed_cms );
+	uint64_t precompute_start = Sys_Microseconds();
+	CM_LoadMap( precomputed_cms, bsp, false, &checksum );
+	Com_Printf( "fat PVS precomputed in %.1f ms\n", ( Sys_Microseconds() - precompute_start ) / 1000.0 );
+	PB_RunFatPVS( precomputed_cms, "fatpvs-p" );
+	CM_ReleaseReference( precomputed_cms );
+	Cvar_ForceSet( "cm_fatPVSPrecompute", "0" );
+
+	// and once more with the patch facets scanned linearly
+	Cvar_ForceSet( "cm_patchBVH", "0" );
+	cmodel_state_t *linear_cms = CM_New( NULL );
+	CM_AddReference( linear_cms );
+	CM_LoadMap( linear_cms, bsp, false, &checksum );
+	PB_ComparePatchBVH( linear_cms );
+	CM_ReleaseReference( linear_cms );
+	Cvar_ForceSet( "cm_patchBVH", "1" );
+
+	int replay_mismatches = PB_CompareConcurrentReplays();
+
+	Mem_ZoneFree( moves );
+	Mem_ZoneFree( traces );
+	Mem_ZoneFree( box_traces );
+	CM_ReleaseReference( cms );
+
+	Qcommon_Shutdown();
+
+	return replay_mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,375 @@
+// shadercachetest.cpp -- headless shader cache check
+//
+// usage: shadercachetest [-print]
+//
+// Registers every shader defined in scripts/*.shader with every shader type
+// three ways: with r_shadercache 0, which parses each script shader as it's
+// registered, with r_shadercache 1 and no cache file, which compiles all of
+// them at init and writes cache/shaders.cache.bin, and with that file loaded.
+// The shaders are printed field by field, with images as their names and
+// load flags, and all three must come out the same. -print dumps every
+// parsed shader too.
+
+#include "client/renderer/r_local.h"
+
+#define MAX_TEST_SHADERS 4096
+
+#define SHADERCACHE_FILE_NAME "cache/shaders.cache.bin"
+
+enum {
+	SC_PARSED,
+	SC_STORED,
+	SC_LOADED,
+};
+
+ref_import_t ri;
+r_shared_t rsh;
+cvar_t *r_lighting_specular;
+cvar_t *r_shadercache;
+
+mempool_t *r_mempool;
+
+static image_t *sc_images;
+
+static char *sc_names[MAX_TEST_SHADERS];
+static int sc_numnames;
+
+ATTRIBUTE_MALLOC void *R_Malloc_( size_t size, const char *filename, int fileline ) {
+	return _Mem_AllocExt( r_mempool, size, 16, 1, 0, 0, filename, fileline );
+}
+
+char *R_CopyString_( const char *in, const char *filename, int fileline ) {
+	char *out = ( char * ) _Mem_AllocExt( r_mempool, strlen( in ) + 1, 0, 1, 0, 0, filename, fileline );
+	strcpy( out, in );
+	return out;
+}
+
+int R_LoadFile_( const char *path, int flags, void **buffer, const char *filename, int fileline ) {
+	int fhandle;
+	int len = FS_FOpenFile( path, &fhandle, FS_READ | flags );
+
+	if( !fhandle ) {
+		if( buffer ) {
+			*buffer = NULL;
+		}
+		return -1;
+	}
+
+	if( !buffer ) {
+		FS_FCloseFile( fhandle );
+		return len;
+	}
+
+	uint8_t *buf = ( uint8_t * ) _Mem_AllocExt( r_mempool, len + 1, 16, 0, 0, 0, filename, fileline );
+	buf[len] = 0;
+	*buffer = buf;
+
+	FS_Read( buf, len, fhandle );
+	FS_FCloseFile( fhandle );
+
+	return len;
+}
+
+void R_FreeFile_( void *buffer, const char *filename, int fileline ) {
+	_Mem_Free( buffer, 0, 0, filename, fileline );
+}
+
+static image_t *SC_NewImage( const char *name, int flags, int minmipsize, int tags ) {
+	image_t *image = ( image_t * ) Mem_ZoneMalloc( sizeof( image_t ) );
+
+	image->name = ZoneCopyString( name );
+	image->flags = flags;
+	image->minmipsize = minmipsize;
+	image->tags = tags;
+	image->next = sc_images;
+	sc_images = image;
+
+	return image;
+}
+
+/*
+* R_FindImage
+*
+* Images are only looked up on disk, one image_t per name and load flags
+* like the real image cache keeps them
+*/
+image_t *R_FindImage( const char *name, const char *suffix, int flags, int minmipsize, int tags ) {
+	char pathname[MAX_QPATH];
+
+	if( !name || !name[0] ) {
+		return NULL;
+	}
+
+	Q_strncpyz( pathname, name[0] == '/' || name[0] == '\\' ? name + 1 : name, sizeof( pathname ) );
+	Q_strlwr( pathname );
+	COM_StripExtension( pathname );
+	if( suffix ) {
+		Q_strncatz( pathname, suffix, sizeof( pathname ) );
+	}
+	if( strlen( pathname ) < 5 || !FS_FirstExtension( pathname, IMAGE_EXTENSIONS, NUM_IMAGE_EXTENSIONS ) ) {
+		return NULL;
+	}
+
+	for( image_t *image = sc_images; image; image = image->next ) {
+		if( image->flags == flags && image->minmipsize == minmipsize && !strcmp( image->name, pathname ) ) {
+			image->tags |= tags;
+			return image;
+		}
+	}
+
+	return SC_NewImage( pathname, flags, minmipsize, tags );
+}
+
+void R_TouchImage( image_t *image, int tags ) {
+	image->tags |= tags;
+}
+
+image_t *R_LoadImage( const char *name, const uint8_t *pic, int width, int height, int flags, int minmipsize, int tags, int samples ) {
+	return SC_NewImage( name, flags, minmipsize, tags );
+}
+
+void R_ReplaceImage( image_t *image, const uint8_t *pic, int width, int height, int flags, int minmipsize, int samples ) {
+}
+
+void R_ReplaceSubImage( image_t *image, int x, int y, const uint8_t *pic, int width, int height ) {
+}
+
+//==================================================
+// SHADERS
+//==================================================
+
+/*
+* SC_CollectNames
+*/
+static void SC_CollectNames( void ) {
+	char list[16384];
+	int numfiles = FS_GetFileList( "scripts", ".shader", NULL, 0, 0, 0 );
+	numfiles = FS_GetFileList( "scripts", ".shader", list, sizeof( list ), 0, numfiles );
+	const char *filename = list;
+
+	for( int i = 0; i < numfiles; i++, filename += strlen( filename ) + 1 ) {
+		char path[MAX_QPATH];
+		char *buf;
+
+		Q_snprintfz( path, sizeof( path ), "scripts/%s", filename );
+		if( R_LoadFile( path, ( void ** )&buf ) <= 0 ) {
+			continue;
+		}
+
+		for( const char *ptr = buf; ptr; ) {
+			const char *token = COM_ParseExt( &ptr, true );
+			if( !token[0] ) {
+				break;
+			}
+			if( sc_numnames < MAX_TEST_SHADERS ) {
+				sc_names[sc_numnames++] = ZoneCopyString( token );
+			}
+
+			// skip the block
+			int depth = 0;
+			do {
+				token = COM_ParseExt( &ptr, true );
+				if( token[0] == '{' ) {
+					depth++;
+				} else if( token[0] == '}' ) {
+					depth--;
+				}
+			} while( token[0] && depth > 0 );
+		}
+
+		R_FreeFile( buf );
+	}
+}
+
+static void SC_Append( char *out, size_t size, const char *format, ... ) {
+	va_list argptr;
+	size_t len = strlen( out );
+
+	va_start( argptr, format );
+	Q_vsnprintfz( out + len, size - len, format, argptr );
+	va_end( argptr );
+}
+
+static void SC_AppendFunc( char *out, size_t size, const shaderfunc_t *func ) {
+	SC_Append( out, size, " func %u %g %g %g %g", func->type, func->args[0], func->args[1], func->args[2], func->args[3] );
+}
+
+/*
+* SC_PrintShader
+*
+* Only prints the fields the backend reads, parsing leaves whatever was in
+* the scratch arrays in the rest of them
+*/
+static void SC_PrintShader( const shader_t *s, char *out, size_t size ) {
+	static const int tcmodargs[] = { 0, 2, 2, 1, 6, 4, 5 };
+
+	out[0] = '\0';
+	SC_Append( out, size, "%s type %i flags %x vattribs %x sort %u tags %x gloss %g %g\n",
+		s->name, s->type, s->flags, s->vattribs, s->sort, s->imagetags, s->glossIntensity, s->glossExponent );
+
+	for( unsigned i = 0; i < s->numdeforms; i++ ) {
+		const deformv_t *deformv = &s->deforms[i];
+
+		SC_Append( out, size, "  deform %u", deformv->type );
+		if( deformv->type == DEFORMV_WAVE ) {
+			SC_Append( out, size, " %g", deformv->args[0] );
+		} else if( deformv->type == DEFORMV_BULGE || deformv->type == DEFORMV_MOVE ) {
+			SC_Append( out, size, " %g %g %g %g", deformv->args[0], deformv->args[1], deformv->args[2],
+				deformv->type == DEFORMV_BULGE ? deformv->args[3] : 0 );
+		}
+		if( deformv->type == DEFORMV_WAVE || deformv->type == DEFORMV_MOVE ) {
+			SC_AppendFunc( out, size, &deformv->func );
+		}
+		SC_Append( out, size, "\n" );
+	}
+	SC_Append( out, size, "  deformkey \"%s\"\n", s->deformsKey ? s->deformsKey : "" );
+
+	for( unsigned i = 0; i < s->numpasses; i++ ) {
+		const shaderpass_t *pass = &s->passes[i];
+
+		SC_Append( out, size, "  pass flags %x program %u tcgen %u anim %g %u\n",
+			pass->flags, pass->program_type, pass->tcgen, pass->anim_fps, pass->anim_numframes );
+
+		SC_Append( out, size, "    rgbgen %u", pass->rgbgen.type );
+		if( pass->rgbgen.type == RGB_GEN_WAVE || pass->rgbgen.type == RGB_GEN_CONST ) {
+			SC_Append( out, size, " %g %g %g", pass->rgbgen.args[0], pass->rgbgen.args[1], pass->rgbgen.args[2] );
+		}
+		if( pass->rgbgen.type == RGB_GEN_WAVE || pass->rgbgen.type == RGB_GEN_ENTITYWAVE ) {
+			SC_AppendFunc( out, size, &pass->rgbgen.func );
+		}
+		SC_Append( out, size, "\n    alphagen %u", pass->alphagen.type );
+		if( pass->alphagen.type == ALPHA_GEN_CONST ) {
+			SC_Append( out, size, " %g", pass->alphagen.args[0] );
+		}
+		if( pass->alphagen.type == ALPHA_GEN_WAVE ) {
+			SC_AppendFunc( out, size, &pass->alphagen.func );
+		}
+		SC_Append( out, size, "\n" );
+
+		if( pass->tcgen == TC_GEN_VECTOR ) {
+			SC_Append( out, size, "    tcgenvec" );
+			for( int j = 0; j < 8; j++ ) {
+				SC_Append( out, size, " %g", pass->tcgenVec[j] );
+			}
+			SC_Append( out, size, "\n" );
+		}
+
+		for( unsigned j = 0; j < pass->numtcmods; j++ ) {
+			const tcmod_t *tcmod = &pass->tcmods[j];
+
+			SC_Append( out, size, "    tcmod %u", tcmod->type );
+			for( int k = 0; k < tcmodargs[tcmod->type]; k++ ) {
+				SC_Append( out, size, " %g", tcmod->args[k] );
+			}
+			SC_Append( out, size, "\n" );
+		}
+
+		for( int j = 0; j < MAX_SHADER_IMAGES; j++ ) {
+			const image_t *image = pass->images[j];
+			if( image ) {
+				SC_Append( out, size, "    image %i %s flags %x minmip %i\n", j, image->name, image->flags, image->minmipsize );
+			}
+		}
+	}
+}
+
+/*
+* SC_RegisterAll
+*
+* Registers every shader with every type and prints them into one buffer per
+* name and type, in the same order every time
+*/
+static char **SC_RegisterAll( int mode, bool print ) {
+	char **dumps = ( char ** ) Mem_ZoneMalloc( sc_numnames * ( SHADER_TYPE_2D_LINEAR + 1 ) * sizeof( char * ) );
+	static char out[65536];
+
+	Cvar_ForceSet( "r_shadercache", mode == SC_PARSED ? "0" : "1" );
+
+	for( int type = 0; type <= SHADER_TYPE_2D_LINEAR; type++ ) {
+		if( mode == SC_STORED ) {
+			FS_RemoveAbsoluteFile( va( "%s/%s/%s", FS_CacheDirectory(), FS_GameDirectory(), SHADERCACHE_FILE_NAME ) );
+		}
+		R_InitShaders();
+
+		for( int i = 0; i < sc_numnames; i++ ) {
+			shader_t *s = R_RegisterShader( sc_names[i], ( shaderType_e )type );
+			if( !s ) {
+				Sys_Error( "%s didn't register", sc_names[i] );
+			}
+
+			SC_PrintShader( s, out, sizeof( out ) );
+			dumps[type * sc_numnames + i] = ZoneCopyString( out );
+			if( print ) {
+				printf( "%s", out );
+			}
+		}
+
+		R_ShutdownShaders();
+	}
+
+	return dumps;
+}
+
+static int SC_Compare( char **parsed, char **cached, const char *what ) {
+	int mismatches = 0;
+
+	for( int i = 0; i < sc_numnames * ( SHADER_TYPE_2D_LINEAR + 1 ); i++ ) {
+		if( strcmp( parsed[i], cached[i] ) ) {
+			if( !mismatches ) {
+				printf( "parsed:\n%s%s:\n%s", parsed[i], what, cached[i] );
+			}
+			mismatches++;
+		}
+	}
+
+	printf( "%d shaders x %d types: %d mismatches %s\n", sc_numnames, SHADER_TYPE_2D_LINEAR + 1, mismatches, what );
+
+	return mismatches;
+}
+
+int main( int argc, char **argv ) {
+	bool print = argc >= 2 && !strcmp( argv[1], "-print" );
+
+	char * qargv[] = { argv[0] };
+	Qcommon_Init( 1, qargv );
+
+	ri.Com_Error = Com_Error;
+	ri.Com_Printf = Com_Printf;
+	ri.Com_DPrintf = Com_DPrintf;
+	ri.Cvar_Get = Cvar_Get;
+	ri.FS_FOpenFile = FS_FOpenFile;
+	ri.FS_Read = FS_Read;
+	ri.FS_Write = FS_Write;
+	ri.FS_Tell = FS_Tell;
+	ri.FS_Seek = FS_Seek;
+	ri.FS_FCloseFile = FS_FCloseFile;
+	ri.FS_GetFileList = FS_GetFileList;
+	ri.FS_FirstExtension = FS_FirstExtension;
+
+	r_mempool = Mem_AllocPool( NULL, "Renderer" );
+	r_lighting_specular = Cvar_Get( "r_lighting_specular", "1", 0 );
+	r_shadercache = Cvar_Get( "r_shadercache", "1", 0 );
+
+	rsh.noTexture = SC_NewImage( "*notexture", 0, 1, 0 );
+	rsh.whiteTexture = SC_NewImage( "*white", 0, 1, 0 );
+	rsh.blackTexture = SC_NewImage( "*black", 0, 1, 0 );
+	rsh.greyTexture = SC_NewImage( "*grey", 0, 1, 0 );
+	rsh.blankBumpTexture = SC_NewImage( "*blankbump", 0, 1, 0 );
+	rsh.particleTexture = SC_NewImage( "*particle", 0, 1, 0 );
+
+	SC_CollectNames();
+	if( !sc_numnames ) {
+		Sys_Error( "no shaders found in scripts/" );
+	}
+
+	char **parsed = SC_RegisterAll( SC_PARSED, print );
+	char **stored = SC_RegisterAll( SC_STORED, false );
+	char **loaded = SC_RegisterAll( SC_LOADED, false );
+
+	int mismatches = SC_Compare( parsed, stored, "stored" ) + SC_Compare( parsed, loaded, "loaded" );
+
+	Mem_FreePool( &r_mempool );
+	Qcommon_Shutdown();
+
+	return mismatches ? 1 : 0;
+}
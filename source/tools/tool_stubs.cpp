@@ -0,0 +1,45 @@
+// tool_stubs.cpp -- server and system stubs shared by the tools
+//
+// The tools link qcommon without the server or a platform main, so this
+// fills in what qcommon calls back into.
+
+#include <chrono>
+#include <thread>
+
+#include "qcommon/qcommon.h"
+
+const bool is_dedicated_server = true;
+
+void SV_Init() { }
+void SV_Shutdown( const char *finalmsg ) { }
+void SV_Frame( unsigned realmsec, unsigned gamemsec ) { }
+
+// Com_Error( ERR_DROP ) calls this before jumping back into Qcommon_Init,
+// which has long returned by the time a tool does any work, so make it fatal
+void SV_ShutdownGame( const char *finalmsg, bool reconnect ) {
+	fprintf( stderr, "Error: %s", finalmsg );
+	exit( 1 );
+}
+
+void Sys_Init() { }
+void Sys_Quit() {
+	Qcommon_Shutdown();
+	exit( 0 );
+}
+
+void Sys_Error( const char *format, ... ) {
+	va_list argptr;
+	char string[1024];
+
+	va_start( argptr, format );
+	Q_vsnprintfz( string, sizeof( string ), format, argptr );
+	va_end( argptr );
+
+	fprintf( stderr, "Error: %s\n", string );
+	exit( 1 );
+}
+
+// NET_Sleep selects on the sockets, which doesn't scale to hundreds of them
+void Sys_Sleep( unsigned int millis ) {
+	std::this_thread::sleep_for( std::chrono::milliseconds( millis ) );
+}
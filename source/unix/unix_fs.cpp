@@ -29,6 +29,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <linux/limits.h>
 #endif
 
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
@@ -310,3 +311,54 @@ bool Sys_FS_RemoveDirectory( const char *path ) {
 int Sys_FS_FileNo( FILE *fp ) {
 	return fileno( fp );
 }
+
+/*
+* Sys_FS_FileMTime
+*/
+time_t Sys_FS_FileMTime( const char *filename ) {
+	struct stat buffer;
+
+	if( stat( filename, &buffer ) != 0 ) {
+		return -1;
+	}
+
+	return buffer.st_mtime;
+}
+
+/*
+* Sys_FS_MMapFile
+*
+* Maps the whole file read-only. The mapping outlives the descriptor.
+*/
+void *Sys_FS_MMapFile( const char *path, size_t *size ) {
+	int fd;
+	struct stat st;
+	void *mapping;
+
+	*size = 0;
+
+	fd = open( path, O_RDONLY );
+	if( fd == -1 ) {
+		return NULL;
+	}
+	if( fstat( fd, &st ) != 0 || st.st_size <= 0 ) {
+		close( fd );
+		return NULL;
+	}
+
+	mapping = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( mapping == MAP_FAILED ) {
+		return NULL;
+	}
+
+	*size = st.st_size;
+	return mapping;
+}
+
+/*
+* Sys_FS_UnMMapFile
+*/
+void Sys_FS_UnMMapFile( void *mapping, size_t size ) {
+	munmap( mapping, size );
+}
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "qcommon/qcommon.h"
 #include "qcommon/sys_threads.h"
 #include <pthread.h>
+#include <unistd.h>
 
 struct qthread_s {
 	pthread_t t;
@@ -86,6 +87,11 @@ void Sys_Thread_Yield( void ) {
 	sched_yield();
 }
 
+int Sys_Thread_NumProcessors( void ) {
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+	return n > 0 ? n : 1;
+}
+
 int Sys_Atomic_FetchAdd( volatile int *value, int add ) {
 	return __sync_fetch_and_add( value, add );
 }
@@ -287,3 +287,64 @@ bool Sys_FS_RemoveDirectory( const char *path ) {
 int Sys_FS_FileNo( FILE *fp ) {
 	return _fileno( fp );
 }
+
+/*
+* Sys_FS_FileMTime
+*/
+time_t Sys_FS_FileMTime( const char *filename ) {
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	ULARGE_INTEGER time;
+
+	if( !GetFileAttributesEx( filename, GetFileExInfoStandard, &data ) ) {
+		return -1;
+	}
+
+	// FILETIME counts 100ns intervals since 1601
+	time.LowPart = data.ftLastWriteTime.dwLowDateTime;
+	time.HighPart = data.ftLastWriteTime.dwHighDateTime;
+	return (time_t)( ( time.QuadPart - UINT64_C( 116444736000000000 ) ) / 10000000 );
+}
+
+/*
+* Sys_FS_MMapFile
+*
+* Maps the whole file read-only. The view outlives the file handles.
+*/
+void *Sys_FS_MMapFile( const char *path, size_t *size ) {
+	HANDLE file, mapping;
+	LARGE_INTEGER file_size;
+	void *view;
+
+	*size = 0;
+
+	file = CreateFile( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE ) {
+		return NULL;
+	}
+	if( !GetFileSizeEx( file, &file_size ) || file_size.QuadPart <= 0 ) {
+		CloseHandle( file );
+		return NULL;
+	}
+
+	mapping = CreateFileMapping( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+	if( mapping == NULL ) {
+		return NULL;
+	}
+
+	view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	if( view == NULL ) {
+		return NULL;
+	}
+
+	*size = (size_t)file_size.QuadPart;
+	return view;
+}
+
+/*
+* Sys_FS_UnMMapFile
+*/
+void Sys_FS_UnMMapFile( void *mapping, size_t size ) {
+	UnmapViewOfFile( mapping );
+}
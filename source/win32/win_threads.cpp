@@ -77,6 +77,12 @@ void Sys_Thread_Yield( void ) {
 	Sys_Sleep( 0 );
 }
 
+int Sys_Thread_NumProcessors( void ) {
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors;
+}
+
 int Sys_Atomic_FetchAdd( volatile int *value, int add ) {
 	return InterlockedExchangeAdd( (volatile LONG*)value, add );
 }